@@ -7,16 +7,27 @@
 #ifndef CARTA_BACKEND__ANIMATIONOBJECT_H_
 #define CARTA_BACKEND__ANIMATIONOBJECT_H_
 
-#include <tbb/task.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
 #include <carta-protobuf/animation.pb.h>
 #include <carta-protobuf/set_image_channels.pb.h>
 
+#include "Cancellation.h"
+
 namespace CARTA {
 const int InitialAnimationWaitsPerSecond = 3;
 const int InitialWindowScale = 1;
+// Flow window sized from the measured link: frames in flight cover a round trip at the frame rate the link sustains, and no frames
+// are sent while the outgoing queue holds more than MaxQueueDelaySeconds of the measured drain rate
+const int MaxFlowWindow = 60;
+const double MaxQueueDelaySeconds = 0.5;
+const double FlowSmoothing = 0.25; // weight of a new measurement
 } // namespace CARTA
 
 class AnimationObject {
@@ -45,12 +56,31 @@ class AnimationObject {
     int _wait_duration_ms;
     volatile int _file_open;
     volatile bool _waiting_flow_event;
-    tbb::task_group_context _tbb_context;
+    carta::CancellationSlot _cancellation; // child of the session token
+
+    // Frames sent and not yet acknowledged, with the bytes queued by the session when their messages were queued
+    struct SentFrame {
+        CARTA::AnimationFrame frame;
+        std::chrono::steady_clock::time_point time;
+        size_t end_bytes;
+    };
+    std::deque<SentFrame> _sent_frames;
+    double _round_trip_s; // smoothed; 0 until a frame is acknowledged
+    double _drain_rate;   // bytes per second reaching the frontend, smoothed; 0 until measured
+    double _frame_bytes;  // smoothed
+    std::chrono::steady_clock::time_point _last_ack_time;
+    size_t _last_ack_bytes;
+    bool _acknowledged;
+    std::mutex _flow_mutex; // frames are sent by the animation task and acknowledged on the loop thread
+
+    static double Smooth(double average, double value) {
+        return average > 0 ? average + CARTA::FlowSmoothing * (value - average) : value;
+    }
 
 public:
     AnimationObject(int file_id, CARTA::AnimationFrame& start_frame, CARTA::AnimationFrame& first_frame, CARTA::AnimationFrame& last_frame,
         CARTA::AnimationFrame& delta_frame, const google::protobuf::Map<google::protobuf::int32, CARTA::MatchedFrameList>& matched_frames,
-        int frame_rate, bool looping, bool reverse_at_end, bool always_wait)
+        int frame_rate, bool looping, bool reverse_at_end, bool always_wait, const carta::CancellationSlot* session_cancellation)
         : _file_id(file_id),
           _start_frame(start_frame),
           _first_frame(first_frame),
@@ -58,7 +88,8 @@ public:
           _looping(looping),
           _reverse_at_end(reverse_at_end),
           _frame_rate(frame_rate),
-          _always_wait(always_wait) {
+          _always_wait(always_wait),
+          _cancellation(session_cancellation) {
         _current_frame = start_frame;
         _next_frame = start_frame;
 
@@ -89,15 +120,102 @@ public:
         _last_flow_frame = start_frame;
         _waits_per_second = CARTA::InitialAnimationWaitsPerSecond;
         _window_scale = CARTA::InitialWindowScale;
+        _round_trip_s = 0;
+        _drain_rate = 0;
+        _frame_bytes = 0;
+        _last_ack_bytes = 0;
+        _acknowledged = false;
     }
-    int CurrentFlowWindowSize() {
-        return (_frame_rate / _waits_per_second) * _window_scale;
+    // Largest gap between the frame sent and the frame acknowledged before the animation waits, given the bytes still queued to
+    // be sent; a fixed fraction of the frame rate until the link is measured
+    int CurrentFlowWindowSize(size_t queued_bytes = 0) {
+        std::scoped_lock lock(_flow_mutex);
+        if (_round_trip_s <= 0) {
+            return (_frame_rate / _waits_per_second) * _window_scale;
+        }
+        if (_drain_rate > 0 && queued_bytes > _drain_rate * CARTA::MaxQueueDelaySeconds) {
+            return 0;
+        }
+
+        double frame_rate = _frame_rate;
+        if (_drain_rate > 0 && _frame_bytes > 0) {
+            frame_rate = std::min(frame_rate, _drain_rate / _frame_bytes);
+        }
+        int window = (int)std::ceil(_round_trip_s * frame_rate) + 1;
+        return std::clamp(window, 1, CARTA::MaxFlowWindow);
+    }
+    // The session's count of queued bytes before and after the messages of the frame were queued
+    void FrameSent(const CARTA::AnimationFrame& frame, size_t start_bytes, size_t end_bytes) {
+        std::scoped_lock lock(_flow_mutex);
+        _sent_frames.push_back({frame, std::chrono::steady_clock::now(), end_bytes});
+        if (_sent_frames.size() > 2 * CARTA::MaxFlowWindow) {
+            _sent_frames.pop_front();
+        }
+        _frame_bytes = Smooth(_frame_bytes, end_bytes - start_bytes);
+    }
+    // Measures the round trip of the acknowledged frame, and the rate at which the frontend received the bytes since the previous
+    // acknowledgement
+    void FrameReceived(const CARTA::AnimationFrame& frame) {
+        auto now = std::chrono::steady_clock::now();
+        std::scoped_lock lock(_flow_mutex);
+        // Frames arrive in the order sent; earlier frames which were not acknowledged are dropped
+        while (!_sent_frames.empty()) {
+            SentFrame sent = _sent_frames.front();
+            _sent_frames.pop_front();
+            if (sent.frame.channel() != frame.channel() || sent.frame.stokes() != frame.stokes()) {
+                continue;
+            }
+
+            _round_trip_s = Smooth(_round_trip_s, std::chrono::duration<double>(now - sent.time).count());
+            double elapsed_s = std::chrono::duration<double>(now - _last_ack_time).count();
+            if (_acknowledged && elapsed_s > 0 && sent.end_bytes > _last_ack_bytes) {
+                _drain_rate = Smooth(_drain_rate, (sent.end_bytes - _last_ack_bytes) / elapsed_s);
+            }
+            _last_ack_time = now;
+            _last_ack_bytes = sent.end_bytes;
+            _acknowledged = true;
+            break;
+        }
+    }
+    // Channels that will be shown next, starting with the next frame, following the same stepping as Session::ExecuteAnimationFrame
+    std::vector<int> NextChannels(int count) {
+        std::vector<int> channels;
+        int delta = _delta_frame.channel();
+        int first = _first_frame.channel();
+        int last = _last_frame.channel();
+        if (count <= 0 || delta == 0 || first >= last) {
+            return channels;
+        }
+
+        int channel = _next_frame.channel();
+        bool forward = _going_forward;
+        channels.push_back(channel);
+        for (int i = 0; (channels.size() < count) && (i < 2 * count); ++i) {
+            int next = forward ? channel + delta : channel - delta;
+            if (next > last || next < first) {
+                if (_reverse_at_end) {
+                    forward = !forward;
+                    continue;
+                } else if (_looping) {
+                    next = forward ? first : last;
+                } else {
+                    break;
+                }
+            }
+            channel = next;
+            channels.push_back(channel);
+        }
+        return channels;
     }
     void CancelExecution() {
-        _tbb_context.cancel_group_execution();
+        _cancellation.CancelCurrent();
+    }
+    // After the session reconnects, with a new session token
+    void ResetCancellation() {
+        _cancellation.Replace();
     }
-    void ResetContext() {
-        _tbb_context.reset();
+    bool IsCancelled() const {
+        return _cancellation.Current().IsCancelled();
     }
 };
 
@@ -0,0 +1,86 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND__CANCELLATION_H_
+#define CARTA_BACKEND__CANCELLATION_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace carta {
+
+// Shared flag for stopping a calculation, checked by the calculation between blocks of work. A child token is also cancelled with
+// its parent, so that closing a session or file cancels everything started for it.
+class CancellationToken {
+public:
+    CancellationToken() : _state(std::make_shared<State>()) {}
+
+    CancellationToken Child() const {
+        CancellationToken child;
+        child._state->parent = _state;
+        return child;
+    }
+
+    void Cancel() const {
+        _state->cancelled = true;
+    }
+
+    bool IsCancelled() const {
+        for (const State* state = _state.get(); state; state = state->parent.get()) {
+            if (state->cancelled) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::shared_ptr<const State> parent;
+    };
+
+    std::shared_ptr<State> _state;
+};
+
+// Token of the current request of a kind, such as the contours of a file: a new request replaces the token, cancelling the calculation
+// of the request it makes obsolete. Tokens are children of a parent token, or of the current token of a parent slot.
+class CancellationSlot {
+public:
+    CancellationSlot() : CancellationSlot(CancellationToken()) {}
+    explicit CancellationSlot(const CancellationToken& parent) : _parent_slot(nullptr), _parent(parent), _current(parent.Child()) {}
+    explicit CancellationSlot(const CancellationSlot* parent_slot)
+        : _parent_slot(parent_slot), _parent(parent_slot->Current()), _current(_parent.Child()) {}
+
+    CancellationToken Current() const {
+        std::scoped_lock lock(_mutex);
+        return _current;
+    }
+
+    // Cancels the current token and returns its replacement
+    CancellationToken Replace() {
+        CancellationToken parent = _parent_slot ? _parent_slot->Current() : _parent;
+        std::scoped_lock lock(_mutex);
+        _current.Cancel();
+        _current = parent.Child();
+        return _current;
+    }
+
+    void CancelCurrent() const {
+        Current().Cancel();
+    }
+
+private:
+    const CancellationSlot* _parent_slot;
+    CancellationToken _parent;
+    CancellationToken _current;
+    mutable std::mutex _mutex;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__CANCELLATION_H_
@@ -0,0 +1,65 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompressionPolicy.cc: which outgoing messages are compressed with permessage-deflate, by event type and size
+
+#include "CompressionPolicy.h"
+
+#include <sstream>
+
+#include <fmt/format.h>
+
+#include "Constants.h"
+
+namespace carta {
+
+CompressionPolicy::CompressionPolicy() : _methods(CARTA::EventType_MAX + 1, DEFLATE), _threshold(DEFLATE_THRESHOLD) {
+    std::string error;
+    Configure(DEFAULT_COMPRESSION_POLICY, error);
+}
+
+CompressionPolicy& CompressionPolicy::Global() {
+    static CompressionPolicy policy;
+    return policy;
+}
+
+bool CompressionPolicy::Configure(const std::string& policy, std::string& error) {
+    std::vector<Method> methods(CARTA::EventType_MAX + 1, DEFLATE);
+    std::istringstream entries(policy);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry.erase(0, entry.find_first_not_of(' '));
+        entry.erase(entry.find_last_not_of(' ') + 1);
+        if (entry.empty()) {
+            continue;
+        }
+
+        auto separator = entry.find('=');
+        CARTA::EventType event_type;
+        if (separator == std::string::npos || !CARTA::EventType_Parse(entry.substr(0, separator), &event_type)) {
+            error = fmt::format("Invalid compression policy entry {}", entry);
+            return false;
+        }
+        std::string method = entry.substr(separator + 1);
+        if (method == "none") {
+            methods[event_type] = NONE;
+        } else if (method == "deflate") {
+            methods[event_type] = DEFLATE;
+        } else {
+            error = fmt::format("Invalid compression method {} for {}", method, entry.substr(0, separator));
+            return false;
+        }
+    }
+
+    _methods = methods;
+    return true;
+}
+
+CompressionPolicy::Method CompressionPolicy::GetMethod(CARTA::EventType event_type) const {
+    return (event_type >= 0 && event_type < (int)_methods.size()) ? _methods[event_type] : DEFLATE;
+}
+
+} // namespace carta
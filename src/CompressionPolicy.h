@@ -0,0 +1,49 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompressionPolicy.h: which outgoing messages are compressed with permessage-deflate, by event type and size
+
+#ifndef CARTA_BACKEND__COMPRESSIONPOLICY_H_
+#define CARTA_BACKEND__COMPRESSIONPOLICY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <carta-protobuf/enums.pb.h>
+
+namespace carta {
+
+class CompressionPolicy {
+public:
+    enum Method { NONE, DEFLATE };
+
+    // Process-wide policy, set from the program settings before sessions are created
+    static CompressionPolicy& Global();
+
+    // Comma-separated event type names, each with the method for its messages, e.g. "SPATIAL_PROFILE_DATA=none,
+    // REGION_HISTOGRAM_DATA=deflate". Other event types are deflated. False with the error for an invalid policy, which is not applied.
+    bool Configure(const std::string& policy, std::string& error);
+    void SetThreshold(size_t bytes) {
+        _threshold = bytes;
+    }
+
+    Method GetMethod(CARTA::EventType event_type) const;
+    // Whether a message of the event type and size, including its header, is deflated
+    bool Deflate(CARTA::EventType event_type, size_t size) const {
+        return size > _threshold && GetMethod(event_type) == DEFLATE;
+    }
+
+private:
+    CompressionPolicy();
+
+    std::vector<Method> _methods; // by event type
+    size_t _threshold;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__COMPRESSIONPOLICY_H_
@@ -34,9 +34,76 @@
 // stokes
 #define DEFAULT_STOKES 0
 #define CURRENT_STOKES -1
+// computed stokes, indexes after those of the image stokes axis, calculated from its I, Q, U and V planes
+#define COMPUTE_STOKES_PTOTAL 13   // total polarized intensity
+#define COMPUTE_STOKES_PLINEAR 14  // linearly polarized intensity
+#define COMPUTE_STOKES_PFTOTAL 15  // total polarization fraction (%)
+#define COMPUTE_STOKES_PFLINEAR 16 // linear polarization fraction (%)
+#define COMPUTE_STOKES_PANGLE 17   // linear polarization angle (degrees)
 
 // raster image data
 #define MAX_SUBSETS 8
+#define TILE_CACHE_SIZE_MB 64 // per frame
+// Tiles which are all NaN or constant are found from a summary of the NaN count and range of each full-resolution tile footprint of
+// the plane, and their compressed data is reused for tiles of the same size and value
+#define TILE_SUMMARY_BLOCK_SIZE 256
+#define UNIFORM_TILE_CACHE_SIZE 16 // per frame
+// Tiles of several channels for channel-map views: consecutive channels of the tiles' bounding box read at once
+#define CHANNEL_TILES_BLOCK_MB 256
+
+// Image planes shared by frames of the same file
+#define SHARED_PLANE_CACHE_MB 2048 // per process
+
+// Splatalogue line tables shared by sessions, in memory and in the cache folder if set
+#define SPECTRAL_LINE_CACHE_MB 256      // per process
+#define SPECTRAL_LINE_QUERY_TIMEOUT 300 // seconds
+
+// Encoded contours of recent channels
+#define CONTOUR_CACHE_MAX_ENTRIES 32 // per frame
+#define CONTOUR_CACHE_MB 128         // per frame
+
+// Memory ceiling for the images and tile buffers of a moment calculation; larger moment and smoothed images are written to
+// temporary files on disk as their tiles are finished
+#define MOMENT_MEMORY_MB 1024
+
+// Memory ceiling for the caches of all sessions, 0 for no limit beyond the capacity of each cache. Over the limit, the entry unused
+// longest relative to its estimated cost of calculating it again (seconds per MB) is evicted, from any cache.
+#define MEMORY_BUDGET_MB 0
+#define SHARED_PLANE_CACHE_COST 0.5   // read and decompressed from the file
+#define TILE_CACHE_COST 0.05          // cut and compressed from a cached plane
+#define CONTOUR_CACHE_COST 0.2        // traced and encoded from a plane
+#define SMOOTHED_PLANE_CACHE_COST 0.1 // smoothed from a plane
+#define SPECTRAL_LINE_CACHE_COST 10   // read from the cache folder, or queried from Splatalogue again
+#define MIRIAD_FLAG_CACHE_COST 2      // 8 Mpixel of flags per MB, read from the MIRIAD mask file
+
+// HDF5 chunk cache
+#define HDF5_CHUNK_CACHE_MB 32 // per dataset
+// Cursor spectral profiles from swizzled HDF5 data are read for blocks of pixels of at least this size, aligned to its chunks,
+// and kept in an LRU cache
+#define CURSOR_SPECTRAL_BLOCK_SIZE 16
+#define CURSOR_SPECTRAL_CACHE_MB 64
+// Channel statistics of HDF5 cubes are read from the statistics datasets when first used, and the most recently used are kept
+#define CHANNEL_STATS_CACHE_SIZE 256 // per image
+
+// FITS blank pixel masks are read in blocks of pixels and kept with one bit per pixel
+#define FITS_MASK_BLOCK_PIXELS 1048576
+
+// MIRIAD mask flags, one bit per pixel
+#define MIRIAD_FLAG_CACHE_MB 256    // per image
+#define MIRIAD_FLAG_BLOCK_PLANES 16 // planes read together on a miss
+
+// CASA image tile cache
+#define CASA_TILE_CACHE_MB 64 // per image, sized to the tiles of the plane, spectral, region or moment reads
+
+// reads of the same data among the last reads of a file loader are counted as repeated
+#define LOADER_RECENT_READS 32
+
+// evaluated planes of LEL expression images
+#define EXPR_PLANE_CACHE_MB 512 // per image
+
+// animation
+#define ANIMATION_PREFETCH_CHANNELS 4
+#define ANIMATION_PREFETCH_MAX_MB 1024 // per frame
 
 // histograms
 #define AUTO_BIN_SIZE -1
@@ -44,6 +111,16 @@
 #define HISTOGRAM_COMPLETE 1.0
 #define HISTOGRAM_CANCEL -1.0
 #define UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS 2.0
+#define CUBE_HISTOGRAM_CHANNELS 4 // channels read ahead and calculated in parallel
+#define CUBE_HISTOGRAM_MAX_MB 1024
+
+// position-velocity images: spectra of blocks of pixels along the path are read at once, for all channels
+#define PV_TILE_SIZE 16
+#define PV_TILES_MAX_MB 512 // tiles read ahead and sampled in parallel
+
+// file export
+#define EXPORT_CHUNK_MB 64 // pixels read and written at once
+#define EXPORT_CHUNKS 4    // chunks read ahead of the writer
 
 // z profile calculation
 #define INIT_DELTA_Z 10
@@ -51,10 +128,26 @@
 #define TARGET_PARTIAL_CURSOR_TIME 500
 #define TARGET_PARTIAL_REGION_TIME 1000
 #define PROFILE_COMPLETE 1.0
+#define FITS_CURSOR_BOX_SIZE 8 // pixels around the cursor read for all channels at once
+// Region spectral profiles with at least this many channels are calculated coarse to fine: every 2^k-th channel first, with at
+// least SPECTRAL_PROGRESSIVE_FIRST_CHANNELS channels, then the channels halfway between those done, until all are done
+#define SPECTRAL_PROGRESSIVE_MIN_DEPTH 256
+#define SPECTRAL_PROGRESSIVE_FIRST_CHANNELS 64
+#define REGION_SPECTRAL_BLOCK_MB 256 // channels of the region bounding box read at once for masked region stats
+// Region spectral profiles are updated from the pixels that entered or left the region mask if the bounding boxes of those pixels
+// are at most this fraction of the region bounding box
+#define SPECTRAL_INCREMENTAL_MAX_AREA 0.5
+#define SPECTRAL_BATCH_MIN_REGIONS 2 // regions of a file calculated from one read of the image
+// Approximate sum, mean and flux density spectra of large regions are read from the smallest loader mipmap with at most this many
+// pixels in the region bounding box over all channels
+#define APPROXIMATE_SPECTRAL_READ_PIXELS 16000000
 
 // scripting timeouts
 #define SCRIPTING_TIMEOUT 10 // seconds
 
+// gRPC data service
+#define DATA_STREAM_CHUNK_BYTES 1024 * 1024 // array values in each streamed message
+
 // CARTA default region style
 #define REGION_COLOR "#2EE6D6"
 #define REGION_DASH_LENGTH 2
@@ -66,13 +159,47 @@
 // file list
 #define FILE_LIST_FIRST_PROGRESS_AFTER_SECS 5
 #define FILE_LIST_PROGRESS_INTERVAL_SECS 2
+// entries probed at once, and threads probing them to overlap file open latency
+#define FILE_LIST_PROBE_BATCH 64
+#define FILE_LIST_PROBE_THREADS 16
 
 // uWebSockets setting
 #define MAX_BACKPRESSURE 256 * 1024 * 1024
 
+// outgoing message queue
+#define MAX_OUTGOING_QUEUE_MB 128              // producers wait above this queued size
+#define OUTGOING_BUFFER_HIGH_WATER 4194304     // stop sending until the socket drains (Bytes)
+#define OUTGOING_BUFFER_POOL_SIZE 16           // buffers of sent messages kept for new messages
+#define OUTGOING_BUFFER_POOL_MAX_BYTES 1048576 // larger buffers are freed once sent
+
+// permessage-deflate of outgoing messages, by event type; profiles are float arrays which deflate barely shrinks
+#define DEFLATE_THRESHOLD 1024 // smaller messages are not compressed (Bytes)
+#define DEFAULT_COMPRESSION_POLICY "SPATIAL_PROFILE_DATA=none,SPECTRAL_PROFILE_DATA=none"
+
+// slow request log, from the arrival of a request until it is handled (ms)
+#define SLOW_REQUEST_MS 1000
+#define DEFAULT_SLOW_REQUEST_THRESHOLDS "SET_CURSOR=100,SET_REGION=200,ADD_REQUIRED_TILES=500"
+
+// Event types of the backend not yet in the ICD, with messages in carta_data.proto
+#define ADD_REQUIRED_CHANNEL_TILES_EVENT_TYPE 1000
+#define SHARED_MEMORY_REQUEST_EVENT_TYPE 1001
+#define SHARED_MEMORY_ACK_EVENT_TYPE 1002
+#define SHARED_MEMORY_MESSAGE_EVENT_TYPE 1003
+
+// Client and server feature flag of RegisterViewer, not yet in the ICD: the tiles of tile requests are 64-bit keys (Tile::Encode64),
+// each sent as two int32 values
+#define TILE_KEYS_64_FEATURE_FLAG (1 << 24)
+
+// Shared memory transport for frontends on the same host: larger messages are written to a ring of this size per session, with a
+// handle sent on the socket
+#define DEFAULT_SHARED_MEMORY_MB 0    // disabled
+#define SHARED_MEMORY_THRESHOLD 65536 // Bytes
+
 // socket port
 #define DEFAULT_SOCKET_PORT 3002
 #define MAX_SOCKET_PORT_TRIALS 100
+// WebSocket event loop threads; sessions stay on the loop which accepted their connection
+#define DEFAULT_SOCKET_LOOPS 1
 
 // logger
 #define LOG_FILE_SIZE 1024 * 1024 * 5 // (Bytes)
@@ -81,6 +208,10 @@
 #define STDOUT_PATTERN "[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v"
 #define PERF_TAG "performance"
 #define PERF_PATTERN "[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%n] %v"
+// Asynchronous logging: messages queued for the writer thread, by default with --log_performance; debug messages are dropped when
+// the queue is full, others wait
+#define LOG_QUEUE_SIZE 8192
+#define LOG_WRITER_WAIT_MS 10
 
 // User preferences
 #ifndef CARTA_USER_FOLDER_PREFIX
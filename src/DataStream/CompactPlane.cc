@@ -0,0 +1,123 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompactPlane.cc: image plane stored as 16-bit values scaled per block, with a bitmap of NaN pixels
+
+#include "CompactPlane.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "Threading.h"
+
+// The NaN bits of a block fill whole words, so that blocks are encoded in parallel
+static_assert(COMPACT_PLANE_BLOCK_SIZE % 64 == 0, "Compact plane blocks must be whole words of the NaN mask");
+
+CompactPlane::CompactPlane(const std::vector<float>& data) : _size(data.size()) {
+    const int64_t num_blocks = (_size + COMPACT_PLANE_BLOCK_SIZE - 1) / COMPACT_PLANE_BLOCK_SIZE;
+    _values.resize(_size);
+    _blocks.resize(num_blocks);
+    std::vector<uint64_t> nan_mask((_size + 63) / 64, 0);
+    bool any_nan(false);
+
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for reduction(|| : any_nan)
+    for (int64_t block = 0; block < num_blocks; ++block) {
+        size_t start = block * COMPACT_PLANE_BLOCK_SIZE;
+        size_t end = std::min(start + COMPACT_PLANE_BLOCK_SIZE, _size);
+        float min_val = std::numeric_limits<float>::max();
+        float max_val = std::numeric_limits<float>::lowest();
+        for (size_t i = start; i < end; ++i) {
+            float val = data[i];
+            if (std::isfinite(val)) {
+                min_val = std::min(min_val, val);
+                max_val = std::max(max_val, val);
+            } else {
+                nan_mask[i / 64] |= (uint64_t)1 << (i % 64);
+                _blocks[block].has_nan = true;
+            }
+        }
+
+        auto& block_info = _blocks[block];
+        if (min_val > max_val) {
+            // No finite values
+            block_info.offset = 0;
+            block_info.scale = 0;
+        } else {
+            // In double precision, as the range of extreme values overflows a float
+            double scale = ((double)max_val - min_val) / std::numeric_limits<uint16_t>::max();
+            block_info.offset = min_val;
+            block_info.scale = scale;
+            for (size_t i = start; i < end; ++i) {
+                float val = data[i];
+                _values[i] = (scale > 0 && std::isfinite(val)) ? std::lround((val - (double)min_val) / scale) : 0;
+            }
+        }
+        any_nan = any_nan || block_info.has_nan;
+    }
+
+    if (any_nan) {
+        _nan_mask = std::move(nan_mask);
+    }
+}
+
+float CompactPlane::Value(size_t index) const {
+    if (!_nan_mask.empty() && IsNan(index)) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    const auto& block = _blocks[index / COMPACT_PLANE_BLOCK_SIZE];
+    return _values[index] * block.scale + block.offset;
+}
+
+void CompactPlane::Decode(size_t start, size_t count, float* dest) const {
+    while (count > 0) {
+        size_t block = start / COMPACT_PLANE_BLOCK_SIZE;
+        size_t block_count = std::min(count, COMPACT_PLANE_BLOCK_SIZE - start % COMPACT_PLANE_BLOCK_SIZE);
+        DecodeBlock(block, start, block_count, dest);
+        start += block_count;
+        dest += block_count;
+        count -= block_count;
+    }
+}
+
+void CompactPlane::DecodeBlock(size_t block, size_t start, size_t count, float* dest) const {
+    // Widen eight values at a time to 32-bit integers, convert and scale
+    const auto& block_info = _blocks[block];
+    const uint16_t* src = _values.data() + start;
+    const __m128 scale = _mm_set1_ps(block_info.scale);
+    const __m128 offset = _mm_set1_ps(block_info.offset);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero));
+        __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero));
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_mul_ps(low, scale), offset));
+        _mm_storeu_ps(dest + i + 4, _mm_add_ps(_mm_mul_ps(high, scale), offset));
+    }
+    for (; i < count; ++i) {
+        dest[i] = src[i] * block_info.scale + block_info.offset;
+    }
+
+    if (block_info.has_nan) {
+        for (i = 0; i < count; ++i) {
+            if (IsNan(start + i)) {
+                dest[i] = std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+    }
+}
+
+size_t CompactPlane::MemoryUsage() const {
+    return sizeof(uint16_t) * _values.size() + sizeof(Block) * _blocks.size() + sizeof(uint64_t) * _nan_mask.size();
+}
@@ -0,0 +1,52 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CompactPlane.h: image plane stored as 16-bit values scaled per block, with a bitmap of NaN pixels
+
+#ifndef CARTA_BACKEND__COMPACTPLANE_H_
+#define CARTA_BACKEND__COMPACTPLANE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Values in a block of this many pixels share a scale and offset
+#define COMPACT_PLANE_BLOCK_SIZE 256
+
+// Each value is rounded to one of 65536 levels between the minimum and maximum finite values of its block, so the error is at most
+// 1/131070 of the block range. Non-finite pixels decode as NaN. Used for display data (tiles, cursor values and spatial profiles);
+// statistics read exact values from the file.
+class CompactPlane {
+public:
+    explicit CompactPlane(const std::vector<float>& data);
+
+    size_t Size() const {
+        return _size;
+    }
+    float Value(size_t index) const;
+    // Writes count values from index start to the destination
+    void Decode(size_t start, size_t count, float* dest) const;
+    size_t MemoryUsage() const;
+
+private:
+    struct Block {
+        float offset; // minimum finite value
+        float scale;  // value step, 0 for a block of one value
+        bool has_nan; // any set bits in the NaN mask
+    };
+
+    void DecodeBlock(size_t block, size_t start, size_t count, float* dest) const;
+    bool IsNan(size_t index) const {
+        return (_nan_mask[index / 64] >> (index % 64)) & 1;
+    }
+
+    size_t _size;
+    std::vector<uint16_t> _values;
+    std::vector<Block> _blocks;
+    std::vector<uint64_t> _nan_mask; // one bit per pixel, empty if there are no NaN pixels
+};
+
+#endif // CARTA_BACKEND__COMPACTPLANE_H_
@@ -6,10 +6,14 @@
 
 #include "Compression.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 #include <zfp.h>
+#include <zstd.h>
 
 #ifdef _ARM_ARCH_
 #include <sse2neon/sse2neon.h>
@@ -17,6 +21,9 @@
 #include <x86intrin.h>
 #endif
 
+#include "SimdDispatch.h"
+#include "Threading.h"
+
 using namespace std;
 
 int Compress(vector<float>& array, size_t offset, vector<char>& compression_buffer, size_t& compressed_size, uint32_t nx, uint32_t ny,
@@ -59,56 +66,387 @@ int Compress(vector<float>& array, size_t offset, vector<char>& compression_buff
     return status;
 }
 
-// Removes NaNs from an array and returns run-length encoded list of NaNs
-vector<int32_t> GetNanEncodingsSimple(vector<float>& array, int offset, int length) {
-    int32_t prev_index = offset;
+int CompressAccuracy(vector<float>& array, size_t offset, vector<char>& compression_buffer, size_t& compressed_size, uint32_t nx,
+    uint32_t ny, double tolerance) {
+    zfp_field* field = zfp_field_2d(array.data() + offset, zfp_type_float, nx, ny);
+    zfp_stream* zfp = zfp_stream_open(nullptr);
+    zfp_stream_set_accuracy(zfp, tolerance);
+
+    size_t buffer_size = zfp_stream_maximum_size(zfp, field);
+    if (compression_buffer.size() < buffer_size) {
+        compression_buffer.resize(buffer_size);
+    }
+    bitstream* stream = stream_open(compression_buffer.data(), buffer_size);
+    zfp_stream_set_bit_stream(zfp, stream);
+    zfp_stream_rewind(zfp);
+    compressed_size = zfp_compress(zfp, field);
+
+    zfp_field_free(field);
+    zfp_stream_close(zfp);
+    stream_close(stream);
+    return compressed_size ? 0 : 1;
+}
+
+int Decompress(const char* compressed_data, size_t compressed_size, vector<float>& array, uint32_t nx, uint32_t ny, uint32_t precision,
+    double tolerance) {
+    array.resize((size_t)nx * ny);
+    zfp_field* field = zfp_field_2d(array.data(), zfp_type_float, nx, ny);
+    zfp_stream* zfp = zfp_stream_open(nullptr);
+    if (tolerance > 0) {
+        zfp_stream_set_accuracy(zfp, tolerance);
+    } else {
+        zfp_stream_set_precision(zfp, precision);
+    }
+
+    // The stream only reads the compressed data
+    bitstream* stream = stream_open(const_cast<char*>(compressed_data), compressed_size);
+    zfp_stream_set_bit_stream(zfp, stream);
+    zfp_stream_rewind(zfp);
+    size_t decompressed_size = zfp_decompress(zfp, field);
+
+    zfp_field_free(field);
+    zfp_stream_close(zfp);
+    stream_close(stream);
+    return decompressed_size ? 0 : 1;
+}
+
+int CompressAdaptive(vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, uint32_t precision, uint32_t high_precision,
+    const char*& compressed_data, size_t& compressed_size, uint32_t& used_precision) {
+    thread_local vector<char> compression_buffer;
+    thread_local vector<char> sample_buffer;
+    thread_local vector<float> sample;
+
+    const float data_size = sizeof(float) * nx * ny;
+    bool try_high_precision(false);
+
+    if (precision < high_precision) {
+        // Estimate the compression ratios from evenly spaced bands of 4 rows, aligned with the ZFP blocks
+        uint32_t num_blocks_y = (ny + 3) / 4;
+        uint32_t num_bands = min((uint32_t)COMPRESSION_SAMPLE_BANDS, num_blocks_y);
+        uint32_t sample_rows(0);
+        sample.resize(num_bands * 4 * nx);
+        for (uint32_t band = 0; band < num_bands; ++band) {
+            uint32_t start_row = 4 * ((band * num_blocks_y) / num_bands);
+            uint32_t band_rows = min(4u, ny - start_row);
+            copy(array.begin() + offset + start_row * nx, array.begin() + offset + (start_row + band_rows) * nx,
+                sample.begin() + sample_rows * nx);
+            sample_rows += band_rows;
+        }
+
+        // Tiles too small to sample are checked after the full compression instead
+        if (sample_rows < ny) {
+            size_t sample_size, sample_size_hq;
+            const float sample_data_size = sizeof(float) * nx * sample_rows;
+            if (!Compress(sample, 0, sample_buffer, sample_size, nx, sample_rows, precision) &&
+                (sample_data_size / sample_size) > HIGH_PRECISION_RATIO_THRESHOLD &&
+                !Compress(sample, 0, sample_buffer, sample_size_hq, nx, sample_rows, high_precision)) {
+                try_high_precision = (sample_data_size / sample_size_hq) > HIGH_PRECISION_MIN_RATIO;
+            }
+        }
+    }
+
+    int status(0);
+    if (try_high_precision) {
+        status = Compress(array, offset, compression_buffer, compressed_size, nx, ny, high_precision);
+        if (!status && (data_size / compressed_size) > HIGH_PRECISION_MIN_RATIO) {
+            compressed_data = compression_buffer.data();
+            used_precision = high_precision;
+            return status;
+        }
+    }
+
+    status = Compress(array, offset, compression_buffer, compressed_size, nx, ny, precision);
+    used_precision = precision;
+
+    if (!status && !try_high_precision && precision < high_precision && (data_size / compressed_size) > HIGH_PRECISION_RATIO_THRESHOLD) {
+        // Sample underestimated the compression ratio: re-compress with the high precision
+        thread_local vector<char> compression_buffer_hq;
+        size_t compressed_size_hq;
+        if (!Compress(array, offset, compression_buffer_hq, compressed_size_hq, nx, ny, high_precision) &&
+            (data_size / compressed_size_hq) > HIGH_PRECISION_MIN_RATIO) {
+            compression_buffer.swap(compression_buffer_hq);
+            compressed_size = compressed_size_hq;
+            used_precision = high_precision;
+        }
+    }
+
+    compressed_data = compression_buffer.data();
+    return status;
+}
+
+template <typename T>
+static void QuantizeValues(const float* data, size_t length, float min_val, float max_val, T* codes) {
+    const T nan_code = std::numeric_limits<T>::max();
+    const float scale = (max_val > min_val) ? (nan_code - 1) / (max_val - min_val) : 0.0f;
+    for (size_t i = 0; i < length; i++) {
+        float v = data[i];
+        if (isnan(v)) {
+            codes[i] = nan_code;
+        } else {
+            v = std::min(std::max(v, min_val), max_val);
+            codes[i] = static_cast<T>(lround((v - min_val) * scale));
+        }
+    }
+}
+
+int CompressQuantized(const vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, float min_val, float max_val, int bits,
+    vector<char>& compression_buffer, size_t& compressed_size) {
+    thread_local vector<char> codes;
+    const size_t length = (size_t)nx * ny;
+    const size_t code_size = (bits > 8) ? sizeof(uint16_t) : sizeof(uint8_t);
+    codes.resize(length * code_size);
+    if (code_size == sizeof(uint16_t)) {
+        QuantizeValues(array.data() + offset, length, min_val, max_val, reinterpret_cast<uint16_t*>(codes.data()));
+    } else {
+        QuantizeValues(array.data() + offset, length, min_val, max_val, reinterpret_cast<uint8_t*>(codes.data()));
+    }
+
+    const size_t header_size = 2 * sizeof(float);
+    compression_buffer.resize(header_size + ZSTD_compressBound(codes.size()));
+    memcpy(compression_buffer.data(), &min_val, sizeof(float));
+    memcpy(compression_buffer.data() + sizeof(float), &max_val, sizeof(float));
+
+    size_t zstd_size = ZSTD_compress(
+        compression_buffer.data() + header_size, compression_buffer.size() - header_size, codes.data(), codes.size(), QUANTIZED_ZSTD_LEVEL);
+    if (ZSTD_isError(zstd_size)) {
+        compressed_size = 0;
+        return 1;
+    }
+    compressed_size = header_size + zstd_size;
+    return 0;
+}
+
+void ShuffleBytesScalar(const float* data, size_t length, uint8_t* dest) {
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; ++i) {
+        for (size_t k = 0; k < sizeof(float); ++k) {
+            dest[k * length + i] = bytes[i * sizeof(float) + k];
+        }
+    }
+}
+
+void ShuffleBytes(const float* data, size_t length, uint8_t* dest) {
+    // Bytes of each 4 values are grouped by significance, then the 32-bit groups of 4 vectors are transposed
+    alignas(16) const std::array<uint8_t, 16> shuffle_vals = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
+    const __m128i shuffle = _mm_load_si128((const __m128i*)shuffle_vals.data());
+    const size_t blocked_length = 16 * (length / 16);
+    for (size_t i = 0; i < blocked_length; i += 16) {
+        __m128 v0 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i)), shuffle));
+        __m128 v1 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i + 4)), shuffle));
+        __m128 v2 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i + 8)), shuffle));
+        __m128 v3 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i + 12)), shuffle));
+        _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_castps_si128(v0));
+        _mm_storeu_si128((__m128i*)(dest + length + i), _mm_castps_si128(v1));
+        _mm_storeu_si128((__m128i*)(dest + 2 * length + i), _mm_castps_si128(v2));
+        _mm_storeu_si128((__m128i*)(dest + 3 * length + i), _mm_castps_si128(v3));
+    }
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = blocked_length; i < length; ++i) {
+        for (size_t k = 0; k < sizeof(float); ++k) {
+            dest[k * length + i] = bytes[i * sizeof(float) + k];
+        }
+    }
+}
+
+int CompressLossless(const vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, int level, vector<char>& compression_buffer,
+    size_t& compressed_size) {
+    thread_local vector<uint8_t> shuffled;
+    const size_t length = (size_t)nx * ny;
+    shuffled.resize(length * sizeof(float));
+    ShuffleBytes(array.data() + offset, length, shuffled.data());
+
+    compression_buffer.resize(ZSTD_compressBound(shuffled.size()));
+    size_t zstd_size = ZSTD_compress(compression_buffer.data(), compression_buffer.size(), shuffled.data(), shuffled.size(), level);
+    if (ZSTD_isError(zstd_size)) {
+        compressed_size = 0;
+        return 1;
+    }
+    compressed_size = zstd_size;
+    return 0;
+}
+
+int DecompressLossless(const char* compressed_data, size_t compressed_size, vector<float>& array, uint32_t nx, uint32_t ny) {
+    const size_t length = (size_t)nx * ny;
+    vector<uint8_t> shuffled(length * sizeof(float));
+    size_t size = ZSTD_decompress(shuffled.data(), shuffled.size(), compressed_data, compressed_size);
+    if (ZSTD_isError(size) || (size != shuffled.size())) {
+        return 1;
+    }
+    array.resize(length);
+    auto bytes = reinterpret_cast<uint8_t*>(array.data());
+    for (size_t i = 0; i < length; ++i) {
+        for (size_t k = 0; k < sizeof(float); ++k) {
+            bytes[i * sizeof(float) + k] = shuffled[k * length + i];
+        }
+    }
+    return 0;
+}
+
+typedef void (*NanRunLengthsKernel)(const float*, int, vector<int32_t>&);
+
+static NanRunLengthsKernel SelectNanRunLengthsKernel() {
+#ifdef CARTA_X86_SIMD
+    auto level = carta::GetSimdLevel();
+    if (level >= carta::SimdLevel::Avx512) {
+        return GetNanRunLengthsAVX512;
+    } else if (level >= carta::SimdLevel::Avx) {
+        return GetNanRunLengthsAVX;
+    }
+#endif
+    // SSE2 version (NEON through sse2neon on ARM)
+    return GetNanRunLengthsSSE;
+}
+
+void GetNanRunLengths(const float* data, int length, vector<int32_t>& run_lengths) {
+    static const NanRunLengthsKernel kernel = SelectNanRunLengthsKernel();
+    kernel(data, length, run_lengths);
+}
+
+void GetNanRunLengthsScalar(const float* data, int length, vector<int32_t>& run_lengths) {
+    int32_t prev_index = 0;
     bool prev = false;
-    vector<int32_t> encoded_array;
-    // Find first non-NaN number in the array
-    float prev_valid_num = 0;
-    for (auto i = offset; i < offset + length; i++) {
-        if (!isnan(array[i])) {
-            prev_valid_num = array[i];
-            break;
+    run_lengths.clear();
+
+    for (auto i = 0; i < length; i++) {
+        bool current = isnan(data[i]);
+        if (current != prev) {
+            run_lengths.push_back(i - prev_index);
+            prev_index = i;
+            prev = current;
         }
     }
+    run_lengths.push_back(length - prev_index);
+}
+
+// Appends a run boundary for each set bit of the transition mask, where bit k marks a change of NaN state at index i + k
+static inline void AddRunBoundaries(uint32_t transitions, int i, int32_t& prev_index, vector<int32_t>& run_lengths) {
+    while (transitions) {
+        int index = i + __builtin_ctz(transitions);
+        run_lengths.push_back(index - prev_index);
+        prev_index = index;
+        transitions &= transitions - 1;
+    }
+}
+
+void GetNanRunLengthsSSE(const float* data, int length, vector<int32_t>& run_lengths) {
+    int32_t prev_index = 0;
+    uint32_t prev = 0;
+    run_lengths.clear();
 
-    // Generate RLE list and replace NaNs with neighbouring valid values. Ideally, this should take into account
-    // the width and height of the image, and look for neighbouring values in vertical and horizontal directions,
-    // but this is only an issue with NaNs right at the edge of images.
-    for (auto i = offset; i < offset + length; i++) {
-        bool current = isnan(array[i]);
+    const int blocked_length = 4 * (length / 4);
+    int i = 0;
+    for (; i < blocked_length; i += 4) {
+        __m128 v = _mm_loadu_ps(data + i);
+        uint32_t nan_mask = _mm_movemask_ps(_mm_cmpunord_ps(v, v));
+        // Compare each element's NaN state with the previous element's
+        uint32_t transitions = (nan_mask ^ ((nan_mask << 1) | prev)) & 0xF;
+        AddRunBoundaries(transitions, i, prev_index, run_lengths);
+        prev = (nan_mask >> 3) & 1;
+    }
+
+    for (; i < length; i++) {
+        uint32_t current = isnan(data[i]);
         if (current != prev) {
-            encoded_array.push_back(i - prev_index);
+            run_lengths.push_back(i - prev_index);
             prev_index = i;
             prev = current;
         }
-        if (current) {
-            array[i] = prev_valid_num;
-        } else {
-            prev_valid_num = array[i];
+    }
+    run_lengths.push_back(length - prev_index);
+}
+
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX void GetNanRunLengthsAVX(const float* data, int length, vector<int32_t>& run_lengths) {
+    int32_t prev_index = 0;
+    uint32_t prev = 0;
+    run_lengths.clear();
+
+    const int blocked_length = 8 * (length / 8);
+    int i = 0;
+    for (; i < blocked_length; i += 8) {
+        __m256 v = _mm256_loadu_ps(data + i);
+        uint32_t nan_mask = _mm256_movemask_ps(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+        uint32_t transitions = (nan_mask ^ ((nan_mask << 1) | prev)) & 0xFF;
+        AddRunBoundaries(transitions, i, prev_index, run_lengths);
+        prev = (nan_mask >> 7) & 1;
+    }
+
+    for (; i < length; i++) {
+        uint32_t current = isnan(data[i]);
+        if (current != prev) {
+            run_lengths.push_back(i - prev_index);
+            prev_index = i;
+            prev = current;
         }
     }
-    encoded_array.push_back(offset + length - prev_index);
-    return encoded_array;
+    run_lengths.push_back(length - prev_index);
 }
 
-vector<int32_t> GetNanEncodingsBlock(vector<float>& array, int offset, int w, int h) {
-    // Generate RLE NaN list
-    int length = w * h;
-    int32_t prev_index = offset;
-    bool prev = false;
-    vector<int32_t> encoded_array;
+CARTA_TARGET_AVX512 void GetNanRunLengthsAVX512(const float* data, int length, vector<int32_t>& run_lengths) {
+    int32_t prev_index = 0;
+    uint32_t prev = 0;
+    run_lengths.clear();
+
+    const int blocked_length = 16 * (length / 16);
+    int i = 0;
+    for (; i < blocked_length; i += 16) {
+        __m512 v = _mm512_loadu_ps(data + i);
+        uint32_t nan_mask = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+        uint32_t transitions = (nan_mask ^ ((nan_mask << 1) | prev)) & 0xFFFF;
+        AddRunBoundaries(transitions, i, prev_index, run_lengths);
+        prev = (nan_mask >> 15) & 1;
+    }
 
-    for (auto i = offset; i < offset + length; i++) {
-        bool current = isnan(array[i]);
+    for (; i < length; i++) {
+        uint32_t current = isnan(data[i]);
         if (current != prev) {
-            encoded_array.push_back(i - prev_index);
+            run_lengths.push_back(i - prev_index);
             prev_index = i;
             prev = current;
         }
     }
-    encoded_array.push_back(offset + length - prev_index);
+    run_lengths.push_back(length - prev_index);
+}
+#endif
+
+// Removes NaNs from an array and returns run-length encoded list of NaNs
+vector<int32_t> GetNanEncodingsSimple(vector<float>& array, int offset, int length) {
+    vector<int32_t> encoded_array;
+    GetNanRunLengths(array.data() + offset, length, encoded_array);
+
+    // Skip NaN-free images. Runs alternate between valid and NaN values, starting with a (possibly empty) valid run
+    if (encoded_array.size() > 1) {
+        // Find first non-NaN number in the array
+        float prev_valid_num = 0;
+        if (encoded_array[0] > 0) {
+            prev_valid_num = array[offset];
+        } else if (encoded_array.size() > 2) {
+            prev_valid_num = array[offset + encoded_array[1]];
+        }
+
+        // Replace NaNs with neighbouring valid values. Ideally, this should take into account
+        // the width and height of the image, and look for neighbouring values in vertical and horizontal directions,
+        // but this is only an issue with NaNs right at the edge of images.
+        int run_start = offset;
+        for (size_t run = 0; run < encoded_array.size(); run++) {
+            int run_end = run_start + encoded_array[run];
+            if (run % 2) {
+                if (run_start > offset) {
+                    prev_valid_num = array[run_start - 1];
+                }
+                std::fill(array.begin() + run_start, array.begin() + run_end, prev_valid_num);
+            }
+            run_start = run_end;
+        }
+    }
+    return encoded_array;
+}
+
+vector<int32_t> GetNanEncodingsBlock(vector<float>& array, int offset, int w, int h) {
+    // Generate RLE NaN list
+    vector<int32_t> encoded_array;
+    GetNanRunLengths(array.data() + offset, w * h, encoded_array);
 
     // Skip all-NaN images and NaN-free images
     if (encoded_array.size() > 1) {
@@ -151,37 +489,117 @@ vector<int32_t> GetNanEncodingsBlock(vector<float>& array, int offset, int w, in
 
 // This function transforms an array of 2D vertices from contour data in order to improve compression ratios
 void RoundAndEncodeVertices(const std::vector<float>& array, std::vector<int32_t>& dest, float rounding_factor) {
-    const int num_values = array.size();
+    const int64_t num_values = array.size();
     dest.resize(num_values);
-    int i = 0;
 
-    const int blocked_length = 4 * (num_values / 4);
-    // Run through the vertices in groups of 4, rounding to the nearest Nth of a pixel
-    for (i = 0; i < blocked_length; i += 4) {
-        __m128 vertices_vector = _mm_loadu_ps(&array[i]);
-        // If we prefer truncation, then _mm_cvttps_epi32 should be used instead
-        __m128i rounded_vals = _mm_cvtps_epi32(vertices_vector * rounding_factor);
-        _mm_store_si128((__m128i*)&dest[i], rounded_vals);
+    // Groups of 4 values (two vertices) are rounded to the nearest Nth of a pixel, delta-encoded against the vertex before them and
+    // byte-shuffled in one pass. Each chunk only needs the vertex before it, so large arrays are encoded in parallel.
+    const int64_t blocked_length = 4 * (num_values / 4);
+    if (blocked_length >= VERTEX_ENCODING_MIN_PARALLEL) {
+        const int64_t num_chunks = (blocked_length + VERTEX_ENCODING_CHUNK_SIZE - 1) / VERTEX_ENCODING_CHUNK_SIZE;
+        carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+        for (int64_t chunk = 0; chunk < num_chunks; chunk++) {
+            int64_t start = chunk * VERTEX_ENCODING_CHUNK_SIZE;
+            RoundAndEncodeVertexBlocks(array.data(), dest.data(), start, std::min(start + VERTEX_ENCODING_CHUNK_SIZE, blocked_length),
+                rounding_factor);
+        }
+    } else {
+        RoundAndEncodeVertexBlocks(array.data(), dest.data(), 0, blocked_length, rounding_factor);
     }
 
-    // Round the remaining pixels
-    for (i = blocked_length; i < num_values; i++) {
+    // Round and delta-encode the remaining values, which are not shuffled
+    int32_t last_x = blocked_length ? VertexRound(array[blocked_length - 2], rounding_factor) : 0;
+    int32_t last_y = blocked_length ? VertexRound(array[blocked_length - 1], rounding_factor) : 0;
+    for (int64_t i = blocked_length; i < num_values; i++) {
         dest[i] = round(array[i] * rounding_factor);
     }
+    for (int64_t i = blocked_length; i < num_values - 1; i += 2) {
+        int32_t current_x = dest[i];
+        int32_t current_y = dest[i + 1];
+        dest[i] = current_x - last_x;
+        dest[i + 1] = current_y - last_y;
+        last_x = current_x;
+        last_y = current_y;
+    }
+}
+
+void RoundAndEncodeVertexBlocks(const float* array, int32_t* dest, int64_t start, int64_t end, float rounding_factor) {
+    alignas(16) const std::array<uint8_t, 16> shuffle_vals = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
+    const __m128i shuffle = _mm_load_si128((const __m128i*)shuffle_vals.data());
+    const __m128 factor = _mm_set_ps1(rounding_factor);
 
-    EncodeIntegers(dest, true);
+    // If we prefer truncation, then _mm_cvttps_epi32 should be used instead
+    __m128i previous = start ? _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(array + start - 4), factor)) : _mm_setzero_si128();
+    for (int64_t i = start; i < end; i += 4) {
+        __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(array + i), factor));
+        // The vertices before the two in this group: the last vertex of the previous group, then the first of this one
+        __m128i preceding = _mm_alignr_epi8(rounded, previous, 8);
+        __m128i deltas = _mm_sub_epi32(rounded, preceding);
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_shuffle_epi8(deltas, shuffle));
+        previous = rounded;
+    }
+}
+
+void RoundAndEncodeVerticesScalar(const std::vector<float>& array, std::vector<int32_t>& dest, float rounding_factor) {
+    const int64_t num_values = array.size();
+    const int64_t blocked_length = 4 * (num_values / 4);
+    dest.resize(num_values);
+    for (int64_t i = 0; i < num_values; i++) {
+        dest[i] = (i < blocked_length) ? VertexRound(array[i], rounding_factor) : (int32_t)round(array[i] * rounding_factor);
+    }
+
+    int32_t last_x = 0;
+    int32_t last_y = 0;
+    for (int64_t i = 0; i < num_values - 1; i += 2) {
+        int32_t current_x = dest[i];
+        int32_t current_y = dest[i + 1];
+        dest[i] = current_x - last_x;
+        dest[i + 1] = current_y - last_y;
+        last_x = current_x;
+        last_y = current_y;
+    }
+
+    // Shuffle bytes in blocks of 4 values
+    for (int64_t i = 0; i < blocked_length; i += 4) {
+        uint8_t block[16];
+        memcpy(block, &dest[i], 16);
+        uint8_t* shuffled = (uint8_t*)&dest[i];
+        for (int byte = 0; byte < 4; byte++) {
+            for (int value = 0; value < 4; value++) {
+                shuffled[byte * 4 + value] = block[value * 4 + byte];
+            }
+        }
+    }
+}
+
+int32_t VertexRound(float value, float rounding_factor) {
+    return _mm_cvtss_si32(_mm_set_ss(value * rounding_factor));
 }
 
 void EncodeIntegers(std::vector<int32_t>& array, bool strided) {
-    const int num_values = array.size();
-    const int blocked_length = 4 * (num_values / 4);
+    const int64_t num_values = array.size();
+    const int64_t blocked_length = 4 * (num_values / 4);
     alignas(16) const std::array<uint8_t, 16> shuffle_vals = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
+    const __m128i shuffle = _mm_load_si128((const __m128i*)shuffle_vals.data());
+
+    // Delta-encoding of neighbouring integers (or vertices, if strided) to improve compression, followed by shuffling bytes in
+    // blocks of 128 bits (4 integers). The remaining values are delta-encoded but not shuffled
+    __m128i previous = _mm_setzero_si128();
+    for (int64_t i = 0; i < blocked_length; i += 4) {
+        __m128i vals = _mm_loadu_si128((__m128i*)&array[i]);
+        __m128i preceding = strided ? _mm_alignr_epi8(vals, previous, 8) : _mm_alignr_epi8(vals, previous, 12);
+        __m128i deltas = _mm_sub_epi32(vals, preceding);
+        _mm_storeu_si128((__m128i*)&array[i], _mm_shuffle_epi8(deltas, shuffle));
+        previous = vals;
+    }
 
+    alignas(16) int32_t last_values[4];
+    _mm_store_si128((__m128i*)last_values, previous);
     if (strided) {
-        // Delta-encoding of neighbouring vertices to improve compression
-        int last_x = 0;
-        int last_y = 0;
-        for (int64_t i = 0; i < num_values - 1; i += 2) {
+        int last_x = last_values[2];
+        int last_y = last_values[3];
+        for (int64_t i = blocked_length; i < num_values - 1; i += 2) {
             int current_x = array[i];
             int current_y = array[i + 1];
             array[i] = current_x - last_x;
@@ -190,19 +608,11 @@ void EncodeIntegers(std::vector<int32_t>& array, bool strided) {
             last_y = current_y;
         }
     } else {
-        // Delta-encoding of neighbouring integers to improve compression
-        int last = 0;
-        for (int64_t i = 0; i < num_values; i++) {
+        int last = last_values[3];
+        for (int64_t i = blocked_length; i < num_values; i++) {
             int current = array[i];
             array[i] = current - last;
             last = current;
         }
     }
-
-    // Shuffle bytes in blocks of 126 bits (4 floats). The remaining bytes are left along
-    for (int64_t i = 0; i < blocked_length; i += 4) {
-        __m128i vals = _mm_loadu_si128((__m128i*)&array[i]);
-        vals = _mm_shuffle_epi8(vals, *(__m128i*)shuffle_vals.data());
-        _mm_store_si128((__m128i*)&array[i], vals);
-    }
 }
@@ -11,11 +11,73 @@
 #include <cstdint>
 #include <vector>
 
+#include "SimdDispatch.h"
+
+// Adaptive ZFP precision: use the high precision if the default precision compresses better than the first threshold
+// and the high precision still compresses better than the second
+#define HIGH_PRECISION_RATIO_THRESHOLD 20
+#define HIGH_PRECISION_MIN_RATIO 10
+// Number of 4-row bands sampled to estimate the compression ratio of a tile
+#define COMPRESSION_SAMPLE_BANDS 4
+
+// Quantized preview tiles: CARTA::CompressionType value until the enum entry is added to carta-protobuf
+#define QUANTIZED_COMPRESSION_TYPE 3
+#define QUANTIZED_ZSTD_LEVEL 3
+
+// Animation tiles encoded against the same tile of the previous frame: CARTA::CompressionType value of the residual tiles, which
+// are sent between ZFP keyframes
+#define DELTA_COMPRESSION_TYPE 4
+#define DELTA_KEYFRAME_INTERVAL 10
+
+// Lossless tiles: CARTA::CompressionType value of tiles with the exact float values, byte-shuffled and compressed with zstd
+#define LOSSLESS_COMPRESSION_TYPE 5
+#define LOSSLESS_ZSTD_LEVEL 1
+
+// Contour vertex arrays of at least this many values are encoded in parallel chunks (multiples of 4 values)
+#define VERTEX_ENCODING_MIN_PARALLEL 262144
+#define VERTEX_ENCODING_CHUNK_SIZE 65536
+
 int Compress(std::vector<float>& array, size_t offset, std::vector<char>& compression_buffer, std::size_t& compressed_size, uint32_t nx,
     uint32_t ny, uint32_t precision);
+// ZFP fixed-accuracy compression, with absolute errors up to tolerance
+int CompressAccuracy(std::vector<float>& array, size_t offset, std::vector<char>& compression_buffer, std::size_t& compressed_size,
+    uint32_t nx, uint32_t ny, double tolerance);
+// Values of ZFP data compressed with Compress or CompressAccuracy, as the frontend decodes them; tolerance 0 for fixed precision
+int Decompress(const char* compressed_data, std::size_t compressed_size, std::vector<float>& array, uint32_t nx, uint32_t ny,
+    uint32_t precision, double tolerance = 0);
+// Compresses into a per-thread buffer, choosing between precision and high_precision from a sample of the data.
+// The returned data pointer is valid until the next call on the same thread.
+int CompressAdaptive(std::vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, uint32_t precision, uint32_t high_precision,
+    const char*& compressed_data, std::size_t& compressed_size, uint32_t& used_precision);
+// Maps values to 8- or 16-bit codes between min_val and max_val, with the highest code reserved for NaN, then compresses the codes
+// losslessly with zstd. The buffer holds min_val and max_val as floats, followed by the compressed codes.
+int CompressQuantized(const std::vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, float min_val, float max_val, int bits,
+    std::vector<char>& compression_buffer, std::size_t& compressed_size);
+// Lossless compression of the bit patterns of the values, NaNs included: the bytes of the values are grouped by significance
+// (all the lowest bytes, then the next, and so on) as ShuffleBytes, then compressed with zstd at the given level
+int CompressLossless(const std::vector<float>& array, size_t offset, uint32_t nx, uint32_t ny, int level,
+    std::vector<char>& compression_buffer, std::size_t& compressed_size);
+int DecompressLossless(const char* compressed_data, std::size_t compressed_size, std::vector<float>& array, uint32_t nx, uint32_t ny);
+// Byte planes of the values: byte k of value i goes to dest[k * length + i]. The SSE version shuffles blocks of 16 values.
+void ShuffleBytes(const float* data, size_t length, uint8_t* dest);
+void ShuffleBytesScalar(const float* data, size_t length, uint8_t* dest);
+// Run lengths of alternating valid and NaN values, starting with a (possibly empty) run of valid values.
+// The SIMD version is selected at run time.
+void GetNanRunLengths(const float* data, int length, std::vector<int32_t>& run_lengths);
+void GetNanRunLengthsScalar(const float* data, int length, std::vector<int32_t>& run_lengths);
+void GetNanRunLengthsSSE(const float* data, int length, std::vector<int32_t>& run_lengths);
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX void GetNanRunLengthsAVX(const float* data, int length, std::vector<int32_t>& run_lengths);
+CARTA_TARGET_AVX512 void GetNanRunLengthsAVX512(const float* data, int length, std::vector<int32_t>& run_lengths);
+#endif
 std::vector<int32_t> GetNanEncodingsSimple(std::vector<float>& array, int offset, int length);
 std::vector<int32_t> GetNanEncodingsBlock(std::vector<float>& array, int offset, int w, int h);
 
+// Rounds contour vertices to the nearest 1/rounding_factor of a pixel, then delta-encodes and byte-shuffles them as EncodeIntegers
+// with strided set. Large arrays are encoded by several threads.
 void RoundAndEncodeVertices(const std::vector<float>& array, std::vector<int32_t>& dest, float rounding_factor);
+void RoundAndEncodeVertexBlocks(const float* array, int32_t* dest, int64_t start, int64_t end, float rounding_factor);
+void RoundAndEncodeVerticesScalar(const std::vector<float>& array, std::vector<int32_t>& dest, float rounding_factor);
+int32_t VertexRound(float value, float rounding_factor);
 void EncodeIntegers(std::vector<int32_t>& array, bool strided = false);
 #endif // CARTA_BACKEND__COMPRESSION_H_
@@ -0,0 +1,103 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "ContourCache.h"
+
+#include "../Constants.h"
+#include "../Metrics.h"
+
+ContourCache::ContourCache(size_t max_entries, size_t capacity_bytes)
+    : _max_entries(max_entries),
+      _capacity_bytes(capacity_bytes),
+      _memory_usage(0),
+      _memory_account("contours", CONTOUR_CACHE_COST, this) {}
+
+bool ContourCache::Get(int z, int stokes, const ContourSettings& settings, std::vector<CARTA::ContourImageData>& messages) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = Find(z, stokes, settings);
+    carta::Metrics::Global().RecordCacheLookup(carta::CacheType::Contours, it != _entries.end());
+    if (it == _entries.end()) {
+        return false;
+    }
+
+    // Move entry to the front of the LRU list
+    _entries.splice(_entries.begin(), _entries, it);
+    it->last_used = std::chrono::steady_clock::now();
+    messages = it->messages;
+    return true;
+}
+
+bool ContourCache::Contains(int z, int stokes, const ContourSettings& settings) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return Find(z, stokes, settings) != _entries.end();
+}
+
+void ContourCache::Put(int z, int stokes, const ContourSettings& settings, std::vector<CARTA::ContourImageData>&& messages) {
+    size_t num_bytes(0);
+    for (auto& message : messages) {
+        num_bytes += message.ByteSizeLong();
+    }
+    if (num_bytes > _capacity_bytes) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = Find(z, stokes, settings);
+        if (it != _entries.end()) {
+            // Already added by the prefetcher or the session
+            _entries.splice(_entries.begin(), _entries, it);
+            return;
+        }
+
+        _entries.push_front(ContourCacheEntry{z, stokes, settings, std::move(messages), num_bytes, std::chrono::steady_clock::now()});
+        _memory_usage += num_bytes;
+        while (_entries.size() > _max_entries || _memory_usage > _capacity_bytes) {
+            _memory_usage -= _entries.back().num_bytes;
+            _entries.pop_back();
+        }
+        _memory_account.SetUsage(_memory_usage);
+    }
+    _memory_account.Enforce();
+}
+
+void ContourCache::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _entries.clear();
+    _memory_usage = 0;
+    _memory_account.SetUsage(0);
+}
+
+std::list<ContourCache::ContourCacheEntry>::iterator ContourCache::Find(int z, int stokes, const ContourSettings& settings) {
+    // Few entries, so a linear search is enough
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->z == z && it->stokes == stokes && it->settings == settings) {
+            return it;
+        }
+    }
+    return _entries.end();
+}
+
+bool ContourCache::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return false;
+    }
+    last_used = _entries.back().last_used;
+    return true;
+}
+
+size_t ContourCache::EvictOldest() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return 0;
+    }
+    size_t num_bytes = _entries.back().num_bytes;
+    _memory_usage -= num_bytes;
+    _entries.pop_back();
+    _memory_account.SetUsage(_memory_usage);
+    return num_bytes;
+}
@@ -0,0 +1,59 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ContourCache.h: bounded LRU cache of encoded contour messages per channel and contour settings
+
+#ifndef CARTA_BACKEND__CONTOURCACHE_H_
+#define CARTA_BACKEND__CONTOURCACHE_H_
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <carta-protobuf/contour_image.pb.h>
+
+#include "../MemoryBudget.h"
+#include "Contouring.h"
+
+class ContourCache : private carta::MemoryConsumer {
+public:
+    ContourCache(size_t max_entries, size_t capacity_bytes);
+
+    // Charges the contours of a frame to its session in the memory budget
+    void SetSessionId(uint32_t session_id) {
+        _memory_account.SetSessionId(session_id);
+    }
+
+    // Copies the messages of a previous calculation; false on miss
+    bool Get(int z, int stokes, const ContourSettings& settings, std::vector<CARTA::ContourImageData>& messages);
+    bool Contains(int z, int stokes, const ContourSettings& settings);
+    void Put(int z, int stokes, const ContourSettings& settings, std::vector<CARTA::ContourImageData>&& messages);
+    void Reset();
+
+private:
+    struct ContourCacheEntry {
+        int z;
+        int stokes;
+        ContourSettings settings;
+        std::vector<CARTA::ContourImageData> messages;
+        size_t num_bytes;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    std::list<ContourCacheEntry>::iterator Find(int z, int stokes, const ContourSettings& settings);
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
+    std::list<ContourCacheEntry> _entries; // most recently used at the front
+    size_t _max_entries;
+    size_t _capacity_bytes;
+    size_t _memory_usage;
+    std::mutex _mutex;
+    carta::MemoryAccount _memory_account;
+};
+
+#endif // CARTA_BACKEND__CONTOURCACHE_H_
@@ -6,19 +6,27 @@
 
 #include "Contouring.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <iterator>
 #include <limits>
+#include <unordered_map>
 #include <vector>
 
+#include <zstd.h>
+
 #include "../Logger/Logger.h"
+#include "Compression.h"
 #include "Threading.h"
 
 using namespace std;
 
 // Contour tracing code adapted from SAOImage DS9: https://github.com/SAOImageDS9/SAOImageDS9
-void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width, int64_t height, double scale, double offset, double level,
-    int x_cell, int y_cell, int side, vector<float>& vertices) {
+// Returns the edge of the image through which the segment leaves (None for closed segments) and the column of the last cell
+Edge TraceSegment(const float* image, std::vector<bool>& visited, int64_t width, int64_t height, int64_t y_offset, double scale,
+    double offset, double level, int x_cell, int y_cell, int side, vector<float>& vertices, int64_t& exit_column) {
     int64_t i = x_cell;
     int64_t j = y_cell;
     int orig_side = side;
@@ -126,111 +134,279 @@ void TraceSegment(const float* image, std::vector<bool>& visited, int64_t width,
 
         // Shift to pixel center
         double x_val = x + 0.5;
-        double y_val = y + 0.5;
+        double y_val = y + y_offset + 0.5;
         vertices.push_back(scale * x_val + offset);
         vertices.push_back(scale * y_val + offset);
     }
+
+    exit_column = i;
+    if (j < 0) {
+        return Edge::TopEdge;
+    } else if (j >= height - 1) {
+        return Edge::BottomEdge;
+    }
+    return Edge::None;
 }
 
-void TraceLevel(const float* image, int64_t width, int64_t height, double scale, double offset, double level, vector<float>& vertices,
-    vector<int32_t>& indices, int chunk_size, ContourCallback& partial_callback) {
-    const int64_t num_pixels = width * height;
-    const size_t vertex_cutoff = 2 * chunk_size;
+// Part of a contour in one strip which starts or ends on a border shared with another strip. Border b is the row shared by
+// strips b - 1 and b; border and column are -1 for ends which are not on a border.
+struct BorderSegment {
+    std::vector<float> vertices;
+    int64_t start_border;
+    int64_t start_column;
+    int64_t end_border;
+    int64_t end_column;
+};
+
+// Traces one level in rows y_start to y_end of the image (border rows are shared with the neighbouring strips). Segments
+// on a border are added to border_segments; the others are added to vertices and indices, then segment_callback is called
+// with the number of pixels checked. Returns the number of pixels checked.
+int64_t TraceLevel(const float* image, int64_t width, int64_t y_start, int64_t y_end, int64_t strip_index, int64_t num_strips,
+    double scale, double offset, double level, vector<float>& vertices, vector<int32_t>& indices,
+    vector<BorderSegment>& border_segments, const std::function<void(int64_t)>& segment_callback) {
+    const float* strip_image = image + y_start * width;
+    const int64_t height = y_end - y_start + 1;
+    const int64_t top_border = (strip_index > 0 ? strip_index : -1);
+    const int64_t bottom_border = (strip_index < num_strips - 1 ? strip_index + 1 : -1);
     int64_t checked_pixels = 0;
-    vector<bool> visited(num_pixels);
+    vector<bool> visited(width * height);
     int64_t i, j;
 
-    auto test_for_chunk_overflow = [&]() {
-        if (vertex_cutoff && vertices.size() > vertex_cutoff) {
-            double progress = std::min(0.99, checked_pixels / double(num_pixels));
-            partial_callback(level, progress, vertices, indices);
-            vertices.clear();
-            indices.clear();
+    auto trace_segment = [&](int64_t x_cell, int64_t y_cell, Edge side, int64_t start_border, int64_t start_column) {
+        size_t vertex_start = vertices.size();
+        indices.push_back(vertex_start);
+        int64_t exit_column;
+        Edge exit_edge = TraceSegment(
+            strip_image, visited, width, height, y_start, scale, offset, level, x_cell, y_cell, side, vertices, exit_column);
+
+        int64_t end_border = (exit_edge == Edge::TopEdge ? top_border : (exit_edge == Edge::BottomEdge ? bottom_border : -1));
+        if ((start_border < 0) && (end_border < 0)) {
+            segment_callback(checked_pixels);
+            return;
         }
+
+        // Joined with the segments of the neighbouring strips when they are done
+        border_segments.push_back({std::vector<float>(vertices.begin() + vertex_start, vertices.end()), start_border, start_column,
+            end_border, (end_border < 0 ? -1 : exit_column)});
+        vertices.resize(vertex_start);
+        indices.pop_back();
     };
 
     // Search TopEdge
     for (j = 0, i = 0; i < width - 1; i++) {
-        float pt_a = image[(j)*width + i];
-        float pt_b = image[(j)*width + i + 1];
+        float pt_a = strip_image[(j)*width + i];
+        float pt_b = strip_image[(j)*width + i + 1];
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
-            indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j, Edge::TopEdge, vertices);
-            test_for_chunk_overflow();
+            trace_segment(i, j, Edge::TopEdge, top_border, i);
         }
         checked_pixels++;
     }
 
     // Search RightEdge
     for (j = 0; j < height - 1; j++) {
-        float pt_a = image[(j)*width + i];
-        float pt_b = image[(j + 1) * width + i];
+        float pt_a = strip_image[(j)*width + i];
+        float pt_b = strip_image[(j + 1) * width + i];
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
-            indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i - 1, j, Edge::RightEdge, vertices);
-            test_for_chunk_overflow();
+            trace_segment(i - 1, j, Edge::RightEdge, -1, -1);
         }
         checked_pixels++;
     }
 
     // Search Bottom
     for (i--; i >= 0; i--) {
-        float pt_a = image[(j)*width + i + 1];
-        float pt_b = image[(j)*width + i];
+        float pt_a = strip_image[(j)*width + i + 1];
+        float pt_b = strip_image[(j)*width + i];
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
-            indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j - 1, Edge::BottomEdge, vertices);
-            test_for_chunk_overflow();
+            trace_segment(i, j - 1, Edge::BottomEdge, bottom_border, i);
         }
         checked_pixels++;
     }
 
     // Search Left
     for (i = 0, j--; j >= 0; j--) {
-        float pt_a = image[(j + 1) * width + i];
-        float pt_b = image[(j)*width + i];
+        float pt_a = strip_image[(j + 1) * width + i];
+        float pt_b = strip_image[(j)*width + i];
 
         if ((isnan(pt_a) || pt_a < level) && level <= pt_b) {
-            indices.push_back(vertices.size());
-            TraceSegment(image, visited, width, height, scale, offset, level, i, j, Edge::LeftEdge, vertices);
-            test_for_chunk_overflow();
+            trace_segment(i, j, Edge::LeftEdge, -1, -1);
         }
         checked_pixels++;
     }
 
-    // Search each row of the image
+    // Search each row of the strip
     for (j = 1; j < height - 1; j++) {
         for (i = 0; i < width - 1; i++) {
-            float pt_a = image[(j)*width + i];
-            float pt_b = image[(j)*width + i + 1];
+            float pt_a = strip_image[(j)*width + i];
+            float pt_b = strip_image[(j)*width + i + 1];
 
             if (!visited[j * width + i] && (isnan(pt_a) || pt_a < level) && level <= pt_b) {
-                indices.push_back(vertices.size());
-                TraceSegment(image, visited, width, height, scale, offset, level, i, j, TopEdge, vertices);
-                test_for_chunk_overflow();
+                trace_segment(i, j, Edge::TopEdge, -1, -1);
             }
             checked_pixels++;
         }
     }
-    partial_callback(level, 1.0, vertices, indices);
+    return checked_pixels;
+}
+
+void JoinBorderSegments(const vector<BorderSegment>& segments, int64_t width, vector<float>& vertices, vector<int32_t>& indices,
+    const std::function<void()>& segment_callback) {
+    // A segment leaving a strip through a border continues as the segment entering the next strip at the same cell edge,
+    // whose first vertex is the same as the last vertex of this one
+    const size_t num_segments = segments.size();
+    std::unordered_map<int64_t, size_t> segment_starts;
+    for (size_t n = 0; n < num_segments; ++n) {
+        if (segments[n].start_border >= 0) {
+            segment_starts[segments[n].start_border * width + segments[n].start_column] = n;
+        }
+    }
+
+    std::vector<int64_t> next_segment(num_segments, -1);
+    std::vector<int64_t> previous_segment(num_segments, -1);
+    for (size_t n = 0; n < num_segments; ++n) {
+        if (segments[n].end_border >= 0) {
+            auto it = segment_starts.find(segments[n].end_border * width + segments[n].end_column);
+            if (it != segment_starts.end()) {
+                next_segment[n] = it->second;
+                previous_segment[it->second] = n;
+            }
+        }
+    }
+
+    // The first vertex of a segment is replaced by the last vertex of the previous one. (TraceSegment places the first
+    // vertex of a segment entering through the bottom edge at the mirrored position along the edge.)
+    std::vector<bool> used(num_segments, false);
+    auto add_contour = [&](size_t first) {
+        indices.push_back(vertices.size());
+        int64_t previous = previous_segment[first];
+        if (previous >= 0) {
+            auto& previous_vertices = segments[previous].vertices;
+            vertices.insert(vertices.end(), previous_vertices.end() - 2, previous_vertices.end());
+        }
+        int64_t n = first;
+        do {
+            used[n] = true;
+            auto& segment_vertices = segments[n].vertices;
+            size_t skip = ((previous >= 0) && (segment_vertices.size() >= 2) ? 2 : 0);
+            vertices.insert(vertices.end(), segment_vertices.begin() + skip, segment_vertices.end());
+            previous = n;
+            n = next_segment[n];
+        } while ((n >= 0) && !used[n]);
+        segment_callback();
+    };
+
+    // Open contours start at a segment with no previous segment; the rest are closed contours crossing borders
+    for (size_t n = 0; n < num_segments; ++n) {
+        if (previous_segment[n] < 0) {
+            add_contour(n);
+        }
+    }
+    for (size_t n = 0; n < num_segments; ++n) {
+        if (!used[n]) {
+            add_contour(n);
+        }
+    }
 }
 
-void TraceContours(float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
+void TraceContours(const float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
     std::vector<std::vector<float>>& vertex_data, std::vector<std::vector<int32_t>>& index_data, int chunk_size,
-    ContourCallback& partial_callback) {
+    ContourCallback& partial_callback, const carta::CancellationToken& cancel_token) {
     auto t_start_contours = std::chrono::high_resolution_clock::now();
-    vertex_data.resize(levels.size());
-    index_data.resize(levels.size());
+    const int64_t num_levels = levels.size();
+    const int64_t num_pixels = width * height;
+    const size_t vertex_cutoff = 2 * chunk_size;
+    vertex_data.resize(num_levels);
+    index_data.resize(num_levels);
+    if (num_levels == 0) {
+        return;
+    }
 
+    // Split levels into strips only as far as needed to keep all threads busy
     carta::ThreadManager::ApplyThreadLimit();
-#pragma omp parallel for
-    for (int64_t l = 0; l < levels.size(); l++) {
-        vertex_data[l].clear();
-        index_data[l].clear();
-        TraceLevel(image, width, height, scale, offset, levels[l], vertex_data[l], index_data[l], chunk_size, partial_callback);
+    int64_t num_tasks = (int64_t)omp_get_max_threads() * CONTOUR_TASKS_PER_THREAD;
+    int64_t max_strips = std::max(height / CONTOUR_MIN_STRIP_HEIGHT, (int64_t)1);
+    int64_t num_strips = std::min(max_strips, std::max((num_tasks + num_levels - 1) / num_levels, (int64_t)1));
+
+    // Per level: strip results are joined, and the level completed, by the last of its strips to finish
+    struct LevelResults {
+        std::atomic<int64_t> checked_pixels;
+        std::atomic<int64_t> strips_remaining;
+        std::vector<std::vector<BorderSegment>> border_segments;
+        std::vector<std::vector<float>> vertices;
+        std::vector<std::vector<int32_t>> indices;
+    };
+    std::vector<LevelResults> level_results(num_levels);
+    for (auto& results : level_results) {
+        results.checked_pixels = 0;
+        results.strips_remaining = num_strips;
+        results.border_segments.resize(num_strips);
+        results.vertices.resize(num_strips);
+        results.indices.resize(num_strips);
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t task = 0; task < num_levels * num_strips; ++task) {
+        if (cancel_token.IsCancelled()) {
+            continue;
+        }
+        int64_t l = task / num_strips;
+        int64_t strip = task % num_strips;
+        double level = levels[l];
+        auto& results = level_results[l];
+        auto& vertices = results.vertices[strip];
+        auto& indices = results.indices[strip];
+
+        auto progress = [&]() { return std::min(0.99, results.checked_pixels / double(num_pixels)); };
+        auto test_for_chunk_overflow = [&]() {
+            if (vertex_cutoff && vertices.size() > vertex_cutoff && !cancel_token.IsCancelled()) {
+                partial_callback(level, progress(), vertices, indices);
+                vertices.clear();
+                indices.clear();
+            }
+        };
+
+        // Strips share their border rows
+        int64_t y_start = strip * (height - 1) / num_strips;
+        int64_t y_end = (strip + 1) * (height - 1) / num_strips;
+        int64_t reported_pixels = 0;
+        auto segment_callback = [&](int64_t checked_pixels) {
+            results.checked_pixels += checked_pixels - reported_pixels;
+            reported_pixels = checked_pixels;
+            test_for_chunk_overflow();
+        };
+        int64_t checked_pixels = TraceLevel(image, width, y_start, y_end, strip, num_strips, scale, offset, level, vertices, indices,
+            results.border_segments[strip], segment_callback);
+        results.checked_pixels += checked_pixels - reported_pixels;
+
+        if (--results.strips_remaining == 0 && !cancel_token.IsCancelled()) {
+            // Remaining vertices of all strips and the joined border segments, in chunks
+            auto& level_vertices = vertex_data[l];
+            auto& level_indices = index_data[l];
+            level_vertices.clear();
+            level_indices.clear();
+            for (int64_t n = 0; n < num_strips; ++n) {
+                int32_t index_offset = level_vertices.size();
+                level_vertices.insert(level_vertices.end(), results.vertices[n].begin(), results.vertices[n].end());
+                for (auto index : results.indices[n]) {
+                    level_indices.push_back(index + index_offset);
+                }
+            }
+
+            std::vector<BorderSegment> border_segments;
+            for (auto& strip_segments : results.border_segments) {
+                std::move(strip_segments.begin(), strip_segments.end(), std::back_inserter(border_segments));
+            }
+            JoinBorderSegments(border_segments, width, level_vertices, level_indices, [&]() {
+                if (vertex_cutoff && level_vertices.size() > vertex_cutoff) {
+                    partial_callback(level, progress(), level_vertices, level_indices);
+                    level_vertices.clear();
+                    level_indices.clear();
+                }
+            });
+            partial_callback(level, 1.0, level_vertices, level_indices);
+        }
     }
 
     if (spdlog::get(PERF_TAG)) {
@@ -246,7 +422,154 @@ void TraceContours(float* image, int64_t width, int64_t height, double scale, do
             segment_count += indices.size();
         }
 
-        spdlog::performance("Contoured {}x{} image in {:.3f} ms at {:.3f} MPix/s. Found {} vertices in {} segments across {} levels", width,
-            height, dt_contours * 1e-3, rate_contours, vertex_count, segment_count, levels.size());
+        spdlog::performance(
+            "Contoured {}x{} image in {:.3f} ms at {:.3f} MPix/s in {} strips. Found {} vertices in {} segments across {} levels", width,
+            height, dt_contours * 1e-3, rate_contours, num_strips, vertex_count, segment_count, levels.size());
+    }
+}
+
+static std::atomic<int> contour_simplification(0);
+
+void SetContourSimplification(int rounding_steps) {
+    contour_simplification = std::max(rounding_steps, 0);
+}
+
+// Keeps the vertices of one polyline, of num_vertices (x, y) pairs, which are further than tolerance from the simplified line
+static void SimplifyPolyline(const float* vertices, int64_t num_vertices, float tolerance, std::vector<float>& simplified) {
+    simplified.clear();
+    if (num_vertices < 3) {
+        simplified.assign(vertices, vertices + 2 * num_vertices);
+        return;
+    }
+
+    std::vector<char> keep(num_vertices, false);
+    keep[0] = keep[num_vertices - 1] = true;
+    std::vector<std::pair<int64_t, int64_t>> spans = {{0, num_vertices - 1}};
+    const double squared_tolerance = (double)tolerance * tolerance;
+    while (!spans.empty()) {
+        int64_t first = spans.back().first;
+        int64_t last = spans.back().second;
+        spans.pop_back();
+
+        // Vertex furthest from the segment between the ends of the span; a closed polyline has ends at the same point
+        double x0 = vertices[2 * first], y0 = vertices[2 * first + 1];
+        double dx = vertices[2 * last] - x0, dy = vertices[2 * last + 1] - y0;
+        double squared_length = dx * dx + dy * dy;
+        double max_distance = 0;
+        int64_t furthest = first;
+        for (int64_t i = first + 1; i < last; ++i) {
+            double px = vertices[2 * i] - x0, py = vertices[2 * i + 1] - y0;
+            double distance;
+            if (squared_length > 0) {
+                double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / squared_length));
+                double ex = px - t * dx, ey = py - t * dy;
+                distance = ex * ex + ey * ey;
+            } else {
+                distance = px * px + py * py;
+            }
+            if (distance > max_distance) {
+                max_distance = distance;
+                furthest = i;
+            }
+        }
+
+        if (max_distance > squared_tolerance) {
+            keep[furthest] = true;
+            if (furthest - first > 1) {
+                spans.emplace_back(first, furthest);
+            }
+            if (last - furthest > 1) {
+                spans.emplace_back(furthest, last);
+            }
+        }
+    }
+
+    for (int64_t i = 0; i < num_vertices; ++i) {
+        if (keep[i]) {
+            simplified.push_back(vertices[2 * i]);
+            simplified.push_back(vertices[2 * i + 1]);
+        }
+    }
+}
+
+void SimplifyContours(const std::vector<float>& vertices, const std::vector<int32_t>& indices, float tolerance,
+    std::vector<float>& simplified_vertices, std::vector<int32_t>& simplified_indices) {
+    const int64_t num_polylines = indices.size();
+    std::vector<std::vector<float>> polylines(num_polylines);
+
+    // Polylines are simplified in parallel when this is not already in a parallel region of the contouring
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t n = 0; n < num_polylines; ++n) {
+        int64_t start = indices[n];
+        int64_t end = (n + 1 < num_polylines) ? indices[n + 1] : vertices.size();
+        SimplifyPolyline(vertices.data() + start, (end - start) / 2, tolerance, polylines[n]);
+    }
+
+    simplified_vertices.clear();
+    simplified_indices.resize(num_polylines);
+    for (int64_t n = 0; n < num_polylines; ++n) {
+        simplified_indices[n] = simplified_vertices.size();
+        simplified_vertices.insert(simplified_vertices.end(), polylines[n].begin(), polylines[n].end());
+    }
+}
+
+int ContourCompressionLevel(const ContourSettings& settings) {
+#if _DISABLE_CONTOUR_COMPRESSION_
+    return 0;
+#else
+    return std::max(0, std::min(20, settings.compression_level));
+#endif
+}
+
+void FillContourData(CARTA::ContourImageData& message, int z, int stokes, double level, double progress,
+    const std::vector<float>& traced_vertices, const std::vector<int32_t>& traced_indices, const ContourSettings& settings) {
+    // Currently only supports identical reference file IDs
+    message.set_reference_file_id(settings.reference_file_id);
+    message.set_channel(z);
+    message.set_stokes(stokes);
+    message.set_progress(progress);
+
+    const float pixel_rounding = std::max(1, std::min(32, settings.decimation));
+    const int compression_level = ContourCompressionLevel(settings);
+
+    // Fill contour set
+    auto contour_set = message.add_contour_sets();
+    contour_set->set_level(level);
+
+    // Sub-pixel and collinear vertices are dropped, to within a few steps of the rounding set by the decimation
+    std::vector<float> simplified_vertices;
+    std::vector<int32_t> simplified_indices;
+    int simplification_steps = contour_simplification;
+    bool simplify = (simplification_steps > 0) && !traced_vertices.empty();
+    if (simplify) {
+        SimplifyContours(traced_vertices, traced_indices, simplification_steps / pixel_rounding, simplified_vertices, simplified_indices);
+    }
+    const auto& vertices = simplify ? simplified_vertices : traced_vertices;
+    const auto& indices = simplify ? simplified_indices : traced_indices;
+
+    const int N = vertices.size();
+    if (N) {
+        if (compression_level < 1) {
+            contour_set->set_raw_coordinates(vertices.data(), N * sizeof(float));
+            contour_set->set_uncompressed_coordinates_size(N * sizeof(float));
+            contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
+            contour_set->set_decimation_factor(0);
+        } else {
+            std::vector<int32_t> vertices_shuffled;
+            RoundAndEncodeVertices(vertices, vertices_shuffled, pixel_rounding);
+
+            // Compress using Zstd library
+            std::vector<char> compression_buffer;
+            const size_t src_size = N * sizeof(int32_t);
+            compression_buffer.resize(ZSTD_compressBound(src_size));
+            size_t compressed_size =
+                ZSTD_compress(compression_buffer.data(), compression_buffer.size(), vertices_shuffled.data(), src_size, compression_level);
+
+            contour_set->set_raw_coordinates(compression_buffer.data(), compressed_size);
+            contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
+            contour_set->set_uncompressed_coordinates_size(src_size);
+            contour_set->set_decimation_factor(pixel_rounding);
+        }
     }
 }
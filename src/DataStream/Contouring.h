@@ -11,14 +11,78 @@
 #include <functional>
 #include <vector>
 
+#include <carta-protobuf/contour.pb.h>
+#include <carta-protobuf/contour_image.pb.h>
+
+#include "../Cancellation.h"
+
+// Contour levels are traced in horizontal strips of at least this many rows, with enough (level, strip) tasks to keep
+// this many per thread, and the segments crossing strip borders are joined afterwards
+#define CONTOUR_MIN_STRIP_HEIGHT 256
+#define CONTOUR_TASKS_PER_THREAD 4
+
+// Large images are first contoured on a block average about this many pixels across, if that is at least
+// CONTOUR_PREVIEW_MIN_FACTOR times coarser than the requested contours; preview messages have progress 0
+#define CONTOUR_PREVIEW_SIZE 1024
+#define CONTOUR_PREVIEW_MIN_FACTOR 4
+
+struct ContourSettings {
+    std::vector<double> levels;
+    CARTA::SmoothingMode smoothing_mode;
+    int smoothing_factor;
+    int decimation;
+    int compression_level;
+    int chunk_size;
+    uint32_t reference_file_id;
+
+    // Equality operator for checking if contour settings have changed
+    bool operator==(const ContourSettings& rhs) const {
+        if (this->smoothing_mode != rhs.smoothing_mode || this->smoothing_factor != rhs.smoothing_factor ||
+            this->decimation != rhs.decimation || this->compression_level != rhs.compression_level ||
+            this->reference_file_id != rhs.reference_file_id || this->chunk_size != rhs.chunk_size) {
+            return false;
+        }
+        if (this->levels.size() != rhs.levels.size()) {
+            return false;
+        }
+
+        for (auto i = 0; i < this->levels.size(); i++) {
+            if (this->levels[i] != rhs.levels[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const ContourSettings& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
 typedef const std::function<void(double, double, const std::vector<float>&, const std::vector<int32_t>&)> ContourCallback;
 
 enum Edge { TopEdge, RightEdge, BottomEdge, LeftEdge, None };
 
-void TraceContourLevel(float* image, int64_t width, int64_t height, double scale, double offset, double level,
-    std::vector<double>& vertex_data, std::vector<int32_t>& indices);
-void TraceContours(float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
+// Levels are traced in strips; once the token is cancelled, no more strips are traced and no more contours are passed to the callback
+void TraceContours(const float* image, int64_t width, int64_t height, double scale, double offset, const std::vector<double>& levels,
     std::vector<std::vector<float>>& vertex_data, std::vector<std::vector<int32_t>>& index_data, int chunk_size,
-    ContourCallback& partial_callback);
+    ContourCallback& partial_callback, const carta::CancellationToken& cancel_token = carta::CancellationToken());
+
+// Contour polylines are simplified before they are sent, to within this many steps of the vertex rounding (1 / decimation
+// pixels); 0 or less sends all traced vertices
+void SetContourSimplification(int rounding_steps);
+
+// Douglas-Peucker simplification of each polyline, keeping its end points and the vertices further than tolerance pixels from
+// the simplified line; indices are the offsets of the polylines in the vertex values
+void SimplifyContours(const std::vector<float>& vertices, const std::vector<int32_t>& indices, float tolerance,
+    std::vector<float>& simplified_vertices, std::vector<int32_t>& simplified_indices);
+
+// Zstd level for contour vertices; 0 when they are sent uncompressed
+int ContourCompressionLevel(const ContourSettings& settings);
+
+// Fills the contour message for one level, except the file id, simplifying, rounding and compressing vertices as set
+void FillContourData(CARTA::ContourImageData& message, int z, int stokes, double level, double progress, const std::vector<float>& vertices,
+    const std::vector<int32_t>& indices, const ContourSettings& settings);
 
 #endif // CARTA_BACKEND__CONTOURING_H_
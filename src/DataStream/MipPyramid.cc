@@ -0,0 +1,137 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "MipPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Threading.h"
+
+MipPyramid::MipPyramid() : _width(0), _height(0), _num_levels_built(0) {}
+
+void MipPyramid::Reset(int64_t width, int64_t height) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _width = width;
+    _height = height;
+    _num_levels_built = 0;
+
+    // Allocate level descriptors up front so that readers never see the vector reallocate
+    int num_levels = 0;
+    for (int64_t mip = MIP_PYRAMID_BASE_MIP; mip < std::max(width, height) * 2; mip *= 2) {
+        num_levels++;
+    }
+    _levels.clear();
+    _levels.resize(num_levels);
+}
+
+int MipPyramid::MipToLevel(int mip) {
+    // Only powers of two at or above the base mip are stored
+    if (mip < MIP_PYRAMID_BASE_MIP || (mip & (mip - 1)) != 0) {
+        return -1;
+    }
+    int level = 0;
+    for (int level_mip = MIP_PYRAMID_BASE_MIP; level_mip < mip; level_mip *= 2) {
+        level++;
+    }
+    return level;
+}
+
+bool MipPyramid::BlockMean(const float* src_data, float* dest_data, int64_t dest_width, int64_t dest_height, int64_t x_offset,
+    int64_t y_offset, int mip) {
+    int level_index = MipToLevel(mip);
+    if (!src_data || level_index < 0 || level_index >= _levels.size() || (x_offset % mip) || (y_offset % mip)) {
+        return false;
+    }
+
+    if (level_index >= _num_levels_built) {
+        BuildLevels(src_data, level_index + 1);
+    }
+
+    const Level& level = _levels[level_index];
+    int64_t level_x = x_offset / mip;
+    int64_t level_y = y_offset / mip;
+
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t j = 0; j < dest_height; ++j) {
+        for (int64_t i = 0; i < dest_width; ++i) {
+            float value = NAN;
+            if ((level_y + j) < level.height && (level_x + i) < level.width) {
+                size_t index = (level_y + j) * level.width + (level_x + i);
+                if (level.counts[index]) {
+                    value = level.sums[index] / level.counts[index];
+                }
+            }
+            dest_data[j * dest_width + i] = value;
+        }
+    }
+    return true;
+}
+
+void MipPyramid::BuildLevels(const float* src_data, int num_levels) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    carta::ThreadManager::ApplyThreadLimit();
+
+    for (int level_index = _num_levels_built; level_index < num_levels; ++level_index) {
+        Level& level = _levels[level_index];
+
+        if (level_index == 0) {
+            // Base level: sum finite pixels in MIP_PYRAMID_BASE_MIP blocks of the full-resolution plane
+            const int64_t mip = MIP_PYRAMID_BASE_MIP;
+            level.width = (_width + mip - 1) / mip;
+            level.height = (_height + mip - 1) / mip;
+            level.sums.resize(level.width * level.height);
+            level.counts.resize(level.width * level.height);
+
+#pragma omp parallel for
+            for (int64_t j = 0; j < level.height; ++j) {
+                int64_t rows = std::min(mip, _height - j * mip);
+                for (int64_t i = 0; i < level.width; ++i) {
+                    int64_t cols = std::min(mip, _width - i * mip);
+                    float pixel_sum = 0;
+                    float pixel_count = 0;
+                    for (int64_t y = 0; y < rows; ++y) {
+                        const float* ptr = src_data + (j * mip + y) * _width + i * mip;
+                        for (int64_t x = 0; x < cols; ++x) {
+                            if (std::isfinite(ptr[x])) {
+                                pixel_sum += ptr[x];
+                                pixel_count++;
+                            }
+                        }
+                    }
+                    level.sums[j * level.width + i] = pixel_sum;
+                    level.counts[j * level.width + i] = pixel_count;
+                }
+            }
+        } else {
+            // 2x2 reduction of the previous level
+            const Level& previous = _levels[level_index - 1];
+            level.width = (previous.width + 1) / 2;
+            level.height = (previous.height + 1) / 2;
+            level.sums.resize(level.width * level.height);
+            level.counts.resize(level.width * level.height);
+
+#pragma omp parallel for
+            for (int64_t j = 0; j < level.height; ++j) {
+                for (int64_t i = 0; i < level.width; ++i) {
+                    float pixel_sum = 0;
+                    float pixel_count = 0;
+                    for (int64_t y = 2 * j; y < std::min(2 * j + 2, previous.height); ++y) {
+                        for (int64_t x = 2 * i; x < std::min(2 * i + 2, previous.width); ++x) {
+                            pixel_sum += previous.sums[y * previous.width + x];
+                            pixel_count += previous.counts[y * previous.width + x];
+                        }
+                    }
+                    level.sums[j * level.width + i] = pixel_sum;
+                    level.counts[j * level.width + i] = pixel_count;
+                }
+            }
+        }
+
+        _num_levels_built = level_index + 1;
+    }
+}
@@ -0,0 +1,52 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MipPyramid.h: lazily built per-channel pyramid of block sums and counts for mean downsampling
+
+#ifndef CARTA_BACKEND__MIPPYRAMID_H_
+#define CARTA_BACKEND__MIPPYRAMID_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Lowest mip stored in the pyramid; smaller mips are cheap to compute from the full-resolution plane
+#define MIP_PYRAMID_BASE_MIP 4
+
+class MipPyramid {
+public:
+    MipPyramid();
+
+    // Invalidate all levels for a new plane of the given size
+    void Reset(int64_t width, int64_t height);
+
+    // Fill dest_data with NaN-aware block means, as BlockSmooth does, using the pyramid level for this mip.
+    // src_data is the full-resolution plane; levels are built from it on first use.
+    // Returns false if the mip or offsets cannot be served from the pyramid.
+    bool BlockMean(const float* src_data, float* dest_data, int64_t dest_width, int64_t dest_height, int64_t x_offset, int64_t y_offset,
+        int mip);
+
+    static int MipToLevel(int mip);
+
+private:
+    struct Level {
+        int64_t width;
+        int64_t height;
+        std::vector<float> sums;   // sum of finite pixels in each block
+        std::vector<float> counts; // number of finite pixels in each block
+    };
+
+    void BuildLevels(const float* src_data, int num_levels);
+
+    int64_t _width;
+    int64_t _height;
+    std::vector<Level> _levels;
+    std::atomic<int> _num_levels_built;
+    std::mutex _mutex;
+};
+
+#endif // CARTA_BACKEND__MIPPYRAMID_H_
@@ -0,0 +1,119 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SharedPlaneCache.h"
+
+#include <fmt/format.h>
+
+#include "../Constants.h"
+#include "../Metrics.h"
+
+SharedPlaneCache::SharedPlaneCache(size_t capacity_bytes)
+    : _capacity_bytes(capacity_bytes), _memory_usage(0), _memory_account("image planes", SHARED_PLANE_CACHE_COST, this) {}
+
+SharedPlaneCache& SharedPlaneCache::Global() {
+    static SharedPlaneCache cache((size_t)SHARED_PLANE_CACHE_MB * 1024 * 1024);
+    return cache;
+}
+
+SharedPlaneCache::Plane SharedPlaneCache::Get(const std::string& file_key, int z, int stokes) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _index.find(Key(file_key, z, stokes));
+    carta::Metrics::Global().RecordCacheLookup(carta::CacheType::ImagePlanes, it != _index.end());
+    if (it == _index.end()) {
+        return nullptr;
+    }
+
+    // Move entry to the front of the LRU list
+    _entries.splice(_entries.begin(), _entries, it->second);
+    it->second->last_used = std::chrono::steady_clock::now();
+    return it->second->plane;
+}
+
+SharedPlaneCache::Plane SharedPlaneCache::Put(const std::string& file_key, int z, int stokes, std::vector<float>&& data) {
+    size_t num_bytes = data.size() * sizeof(float);
+    std::string key = Key(file_key, z, stokes);
+
+    Plane plane;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            _entries.splice(_entries.begin(), _entries, it->second);
+            it->second->last_used = std::chrono::steady_clock::now();
+            return it->second->plane;
+        }
+
+        plane = std::make_shared<const std::vector<float>>(std::move(data));
+        if (num_bytes > _capacity_bytes) {
+            return plane; // not cached, but usable by the caller
+        }
+
+        _entries.push_front(PlaneCacheEntry{key, plane, num_bytes, std::chrono::steady_clock::now()});
+        _index.emplace(key, _entries.begin());
+        _memory_usage += num_bytes;
+        Evict();
+        _memory_account.SetUsage(_memory_usage);
+    }
+    _memory_account.Enforce();
+    return plane;
+}
+
+void SharedPlaneCache::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _index.clear();
+    _entries.clear();
+    _memory_usage = 0;
+    _memory_account.SetUsage(0);
+}
+
+size_t SharedPlaneCache::Size() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+size_t SharedPlaneCache::MemoryUsage() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _memory_usage;
+}
+
+std::string SharedPlaneCache::Key(const std::string& file_key, int z, int stokes) {
+    return fmt::format("{}:{}:{}", file_key, z, stokes);
+}
+
+void SharedPlaneCache::Evict() {
+    // Caller holds the mutex. Frames keep their own references to evicted planes.
+    while (_memory_usage > _capacity_bytes && !_entries.empty()) {
+        auto& entry = _entries.back();
+        _memory_usage -= entry.num_bytes;
+        _index.erase(entry.key);
+        _entries.pop_back();
+    }
+}
+
+bool SharedPlaneCache::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return false;
+    }
+    last_used = _entries.back().last_used;
+    return true;
+}
+
+size_t SharedPlaneCache::EvictOldest() {
+    // Frames keep their own references to evicted planes
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return 0;
+    }
+    auto& entry = _entries.back();
+    size_t num_bytes = entry.num_bytes;
+    _memory_usage -= num_bytes;
+    _index.erase(entry.key);
+    _entries.pop_back();
+    _memory_account.SetUsage(_memory_usage);
+    return num_bytes;
+}
@@ -0,0 +1,62 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SharedPlaneCache.h: memory-bounded LRU cache of image planes shared read-only by all sessions
+
+#ifndef CARTA_BACKEND__SHAREDPLANECACHE_H_
+#define CARTA_BACKEND__SHAREDPLANECACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../MemoryBudget.h"
+
+class SharedPlaneCache : private carta::MemoryConsumer {
+public:
+    using Plane = std::shared_ptr<const std::vector<float>>;
+
+    explicit SharedPlaneCache(size_t capacity_bytes);
+
+    // Process-wide cache used by all frames
+    static SharedPlaneCache& Global();
+
+    // file_key identifies the image file and HDU; returns nullptr on miss
+    Plane Get(const std::string& file_key, int z, int stokes);
+    // Returns the cached plane, which is an earlier copy if another frame added the same plane first
+    Plane Put(const std::string& file_key, int z, int stokes, std::vector<float>&& data);
+    void Reset();
+
+    size_t Size();
+    size_t MemoryUsage();
+
+private:
+    struct PlaneCacheEntry {
+        std::string key;
+        Plane plane;
+        size_t num_bytes;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    static std::string Key(const std::string& file_key, int z, int stokes);
+    void Evict();
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
+    std::list<PlaneCacheEntry> _entries; // most recently used at the front
+    std::unordered_map<std::string, std::list<PlaneCacheEntry>::iterator> _index;
+    size_t _capacity_bytes;
+    size_t _memory_usage;
+    std::mutex _mutex;
+    carta::MemoryAccount _memory_account;
+};
+
+#endif // CARTA_BACKEND__SHAREDPLANECACHE_H_
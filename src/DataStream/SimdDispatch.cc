@@ -0,0 +1,44 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SimdDispatch.h"
+
+namespace carta {
+
+static SimdLevel DetectSimdLevel() {
+#ifdef CARTA_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx")) {
+        return SimdLevel::Avx;
+    }
+    return SimdLevel::Sse;
+#else
+    return SimdLevel::Neon;
+#endif
+}
+
+SimdLevel GetSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+const char* GetSimdLevelName() {
+    switch (GetSimdLevel()) {
+        case SimdLevel::Avx512:
+            return "AVX-512";
+        case SimdLevel::Avx:
+            return "AVX";
+        case SimdLevel::Sse:
+            return "SSE";
+        default:
+            return "NEON";
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,32 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND__SIMDDISPATCH_H_
+#define CARTA_BACKEND__SIMDDISPATCH_H_
+
+// SSE kernels are built for the compile-time baseline (NEON through sse2neon on ARM). On x86, kernels for wider instruction
+// sets are always compiled with function target attributes and selected at run time from the CPU features.
+#ifdef _ARM_ARCH_
+#define CARTA_TARGET_AVX
+#define CARTA_TARGET_AVX512
+#else
+#define CARTA_X86_SIMD
+#define CARTA_TARGET_AVX __attribute__((target("avx")))
+#define CARTA_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace carta {
+
+// Ordered so that each x86 level includes the levels below it
+enum class SimdLevel { Neon, Sse, Avx, Avx512 };
+
+// Best instruction set supported by both the build and the CPU, detected once
+SimdLevel GetSimdLevel();
+const char* GetSimdLevelName();
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__SIMDDISPATCH_H_
@@ -0,0 +1,75 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SmoothedPlaneCache.h"
+
+#include "../Constants.h"
+#include "../Metrics.h"
+
+SmoothedPlaneCache::SmoothedPlaneCache()
+    : _z(-1),
+      _stokes(-1),
+      _smoothing_mode(CARTA::SmoothingMode::NoSmoothing),
+      _smoothing_factor(0),
+      _plane{nullptr, 0, 0, 1.0, 0},
+      _memory_account("smoothed planes", SMOOTHED_PLANE_CACHE_COST, this) {}
+
+bool SmoothedPlaneCache::Get(int z, int stokes, CARTA::SmoothingMode smoothing_mode, int smoothing_factor, SmoothedPlane& plane) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool hit = _plane.data && (z == _z) && (stokes == _stokes) && (smoothing_mode == _smoothing_mode) &&
+               (smoothing_factor == _smoothing_factor);
+    carta::Metrics::Global().RecordCacheLookup(carta::CacheType::SmoothedPlanes, hit);
+    if (!hit) {
+        return false;
+    }
+    _last_used = std::chrono::steady_clock::now();
+    plane = _plane;
+    return true;
+}
+
+void SmoothedPlaneCache::Put(int z, int stokes, CARTA::SmoothingMode smoothing_mode, int smoothing_factor, const SmoothedPlane& plane) {
+    if (!plane.data) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _z = z;
+        _stokes = stokes;
+        _smoothing_mode = smoothing_mode;
+        _smoothing_factor = smoothing_factor;
+        _plane = plane;
+        _last_used = std::chrono::steady_clock::now();
+        _memory_account.SetUsage(_plane.data->size() * sizeof(float));
+    }
+    _memory_account.Enforce();
+}
+
+void SmoothedPlaneCache::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _plane.data.reset();
+    _memory_account.SetUsage(0);
+}
+
+bool SmoothedPlaneCache::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_plane.data) {
+        return false;
+    }
+    last_used = _last_used;
+    return true;
+}
+
+size_t SmoothedPlaneCache::EvictOldest() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_plane.data) {
+        return 0;
+    }
+    size_t num_bytes = _plane.data->size() * sizeof(float);
+    _plane.data.reset();
+    _memory_account.SetUsage(0);
+    return num_bytes;
+}
@@ -0,0 +1,60 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SmoothedPlaneCache.h: smoothed plane of the current channel, contoured again when only the contour levels change
+
+#ifndef CARTA_BACKEND__SMOOTHEDPLANECACHE_H_
+#define CARTA_BACKEND__SMOOTHEDPLANECACHE_H_
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <carta-protobuf/contour.pb.h>
+
+#include "../MemoryBudget.h"
+
+// Gaussian smoothed or block averaged plane, with the scale and offset of its contour vertices in image pixels
+struct SmoothedPlane {
+    std::shared_ptr<const std::vector<float>> data;
+    size_t width;
+    size_t height;
+    double scale;
+    double offset;
+};
+
+// One plane per frame: the cache is reset when the channel changes. The data is shared, so that an eviction does not free a plane
+// being contoured.
+class SmoothedPlaneCache : private carta::MemoryConsumer {
+public:
+    SmoothedPlaneCache();
+
+    // Charges the smoothed plane of a frame to its session in the memory budget
+    void SetSessionId(uint32_t session_id) {
+        _memory_account.SetSessionId(session_id);
+    }
+
+    // False on miss
+    bool Get(int z, int stokes, CARTA::SmoothingMode smoothing_mode, int smoothing_factor, SmoothedPlane& plane);
+    void Put(int z, int stokes, CARTA::SmoothingMode smoothing_mode, int smoothing_factor, const SmoothedPlane& plane);
+    void Reset();
+
+private:
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
+    int _z;
+    int _stokes;
+    CARTA::SmoothingMode _smoothing_mode;
+    int _smoothing_factor;
+    SmoothedPlane _plane; // null data if empty
+    std::chrono::steady_clock::time_point _last_used;
+    std::mutex _mutex;
+    carta::MemoryAccount _memory_account;
+};
+
+#endif // CARTA_BACKEND__SMOOTHEDPLANECACHE_H_
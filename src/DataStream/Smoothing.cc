@@ -6,11 +6,14 @@
 
 #include "Smoothing.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <complex>
 #include <iostream>
 #include <vector>
 
+#include "../GpuCompute.h"
 #include "../Logger/Logger.h"
 #include "Threading.h"
 
@@ -29,6 +32,17 @@ void MakeKernel(vector<float>& kernel, double sigma) {
 
 bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_data, const int64_t src_width, const int64_t src_height,
     const int64_t dest_width, const int64_t dest_height, const bool vertical) {
+#ifdef CARTA_X86_SIMD
+    static const bool use_avx = carta::GetSimdLevel() >= carta::SimdLevel::Avx;
+    if (use_avx) {
+        return RunKernelAVX(kernel, src_data, dest_data, src_width, src_height, dest_width, dest_height, vertical);
+    }
+#endif
+    return RunKernelSSE(kernel, src_data, dest_data, src_width, src_height, dest_width, dest_height, vertical);
+}
+
+bool RunKernelSSE(const vector<float>& kernel, const float* src_data, float* dest_data, const int64_t src_width,
+    const int64_t src_height, const int64_t dest_width, const int64_t dest_height, const bool vertical) {
     const int64_t kernel_radius = (kernel.size() - 1) / 2;
 
     if (vertical && dest_height < src_height - kernel_radius * 2) {
@@ -40,7 +54,7 @@ bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_d
     }
 
     const int64_t jump_size = vertical ? src_width : 1;
-    const int64_t dest_block_limit = SIMD_WIDTH * ((dest_width) / SIMD_WIDTH);
+    const int64_t dest_block_limit = 4 * ((dest_width) / 4);
     const int64_t x_offset = vertical ? 0 : kernel_radius;
     const int64_t y_offset = vertical ? kernel_radius : 0;
 
@@ -48,26 +62,10 @@ bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_d
 #pragma omp parallel for
     for (int64_t dest_y = 0; dest_y < dest_height; dest_y++) {
         int64_t src_y = dest_y + y_offset;
-        // Handle row in steps of 4 or 8 using SSE or AVX
-        for (int64_t dest_x = 0; dest_x < dest_block_limit; dest_x += SIMD_WIDTH) {
+        // Handle row in steps of 4
+        for (int64_t dest_x = 0; dest_x < dest_block_limit; dest_x += 4) {
             int64_t dest_index = dest_x + dest_width * dest_y;
             int64_t src_x = dest_x + x_offset;
-#ifdef __AVX__
-            __m256 sum = _mm256_setzero_ps();
-            __m256 weight = _mm256_setzero_ps();
-            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
-                int64_t src_index = src_x + i * jump_size + src_width * src_y;
-                __m256 val = _mm256_loadu_ps(src_data + src_index);
-                __m256 w = _mm256_set1_ps(kernel[i + kernel_radius]);
-                __m256 mask = _mm256_andnot_ps(IsInfinity(val), _mm256_cmp_ps(val, val, _CMP_EQ_OQ));
-                w = _mm256_and_ps(w, mask);
-                val = _mm256_and_ps(val, mask);
-                sum += val * w;
-                weight += w;
-            }
-            sum /= weight;
-            _mm256_storeu_ps(dest_data + dest_index, sum);
-#else
             __m128 sum = _mm_setzero_ps();
             __m128 weight = _mm_setzero_ps();
             for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
@@ -82,7 +80,6 @@ bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_d
             }
             sum /= weight;
             _mm_storeu_ps(dest_data + dest_index, sum);
-#endif
         }
 
         // Handle remainder of each block
@@ -112,9 +109,78 @@ bool RunKernel(const vector<float>& kernel, const float* src_data, float* dest_d
     return true;
 }
 
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX bool RunKernelAVX(const vector<float>& kernel, const float* src_data, float* dest_data, const int64_t src_width,
+    const int64_t src_height, const int64_t dest_width, const int64_t dest_height, const bool vertical) {
+    const int64_t kernel_radius = (kernel.size() - 1) / 2;
+
+    if (vertical && dest_height < src_height - kernel_radius * 2) {
+        return false;
+    }
+
+    if (dest_width < src_width - kernel_radius * 2) {
+        return false;
+    }
+
+    const int64_t jump_size = vertical ? src_width : 1;
+    const int64_t dest_block_limit = 8 * ((dest_width) / 8);
+    const int64_t x_offset = vertical ? 0 : kernel_radius;
+    const int64_t y_offset = vertical ? kernel_radius : 0;
+
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t dest_y = 0; dest_y < dest_height; dest_y++) {
+        int64_t src_y = dest_y + y_offset;
+        // Handle row in steps of 8
+        for (int64_t dest_x = 0; dest_x < dest_block_limit; dest_x += 8) {
+            int64_t dest_index = dest_x + dest_width * dest_y;
+            int64_t src_x = dest_x + x_offset;
+            __m256 sum = _mm256_setzero_ps();
+            __m256 weight = _mm256_setzero_ps();
+            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+                int64_t src_index = src_x + i * jump_size + src_width * src_y;
+                __m256 val = _mm256_loadu_ps(src_data + src_index);
+                __m256 w = _mm256_set1_ps(kernel[i + kernel_radius]);
+                __m256 mask = _mm256_andnot_ps(IsInfinity(val), _mm256_cmp_ps(val, val, _CMP_EQ_OQ));
+                w = _mm256_and_ps(w, mask);
+                val = _mm256_and_ps(val, mask);
+                sum += val * w;
+                weight += w;
+            }
+            sum /= weight;
+            _mm256_storeu_ps(dest_data + dest_index, sum);
+        }
+
+        // Handle remainder of each block
+        for (int64_t dest_x = dest_block_limit; dest_x < dest_width; dest_x++) {
+            int64_t dest_index = dest_x + dest_width * dest_y;
+            int64_t src_x = dest_x + x_offset;
+            float sum = 0.0;
+            float weight = 0.0;
+            for (int64_t i = -kernel_radius; i <= kernel_radius; i++) {
+                int64_t src_index = src_x + i * jump_size + src_width * src_y;
+                float val = src_data[src_index];
+                if (!isnan(val)) {
+                    float w = kernel[i + kernel_radius];
+                    sum += val * w;
+                    weight += w;
+                }
+            }
+            if (weight > 0.0) {
+                sum /= weight;
+            } else {
+                sum = NAN;
+            }
+            dest_data[dest_index] = sum;
+        }
+    }
+
+    return true;
+}
+#endif
+
 bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int smoothing_factor) {
-    float sigma = (smoothing_factor - 1) / 2.0f;
     int mask_size = (smoothing_factor - 1) * 2 + 1;
     const int apron_height = smoothing_factor - 1;
     int64_t calculated_dest_width = src_width - 2 * (smoothing_factor - 1);
@@ -126,8 +192,48 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
         return false;
     }
 
+    auto t_start = std::chrono::high_resolution_clock::now();
+    // The recursive filter costs the same for any kernel size, so it is faster for large kernels
+    bool recursive = smoothing_factor >= GAUSSIAN_IIR_MIN_SMOOTHING_FACTOR;
+    if (recursive) {
+        RecursiveGaussianSmooth(src_data, dest_data, src_width, src_height, dest_width, dest_height, smoothing_factor);
+    } else {
+        KernelGaussianSmooth(src_data, dest_data, src_width, src_height, dest_width, dest_height, smoothing_factor);
+    }
+
+    // Fill in original NaNs
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t j = 0; j < dest_height; j++) {
+        for (int64_t i = 0; i < dest_width; i++) {
+            auto src_index = (j + apron_height) * src_width + (i + apron_height);
+            auto origVal = src_data[src_index];
+            if (isnan(origVal)) {
+                dest_data[j * dest_width + i] = NAN;
+            }
+        }
+    }
+
+    auto t_end = std::chrono::high_resolution_clock::now();
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
+    auto rate = dest_width * dest_height / (double)dt;
+    spdlog::performance("Smoothed with smoothing factor of {} and {} in {:.3f} ms at {:.3f} MPix/s", smoothing_factor,
+        recursive ? "recursive filter" : fmt::format("kernel size of {}", mask_size), dt * 1e-3, rate);
+
+    return true;
+}
+
+bool KernelGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int smoothing_factor) {
+    float sigma = (smoothing_factor - 1) / 2.0f;
+    int mask_size = (smoothing_factor - 1) * 2 + 1;
+    const int apron_height = smoothing_factor - 1;
+
     vector<float> kernel(mask_size);
     MakeKernel(kernel, sigma);
+    if (carta::GpuCompute::KernelGaussianSmooth(src_data, dest_data, src_width, src_height, dest_width, dest_height, kernel)) {
+        return true;
+    }
 
     double target_pixels = (SMOOTHING_TEMP_BUFFER_SIZE_MB * 1e6) / sizeof(float);
     int64_t target_buffer_height = target_pixels / dest_width;
@@ -137,7 +243,6 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
     int64_t buffer_height = min(target_buffer_height, src_height);
 
     int64_t line_offset = 0;
-    auto t_start = std::chrono::high_resolution_clock::now();
     unique_ptr<float> temp_array(new float[dest_width * buffer_height]);
     auto source_ptr = src_data;
     auto dest_ptr = dest_data;
@@ -156,34 +261,196 @@ bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width,
         source_ptr += num_lines * src_width;
         dest_ptr += num_lines * dest_width;
     }
+    return true;
+}
 
-    // Fill in original NaNs
-    carta::ThreadManager::ApplyThreadLimit();
-#pragma omp parallel for
-    for (int64_t j = 0; j < dest_height; j++) {
-        for (int64_t i = 0; i < dest_width; i++) {
-            auto src_index = (j + apron_height) * src_width + (i + apron_height);
-            auto origVal = src_data[src_index];
-            if (isnan(origVal)) {
-                dest_data[j * dest_width + i] = NAN;
+// Third-order recursive Gaussian of Young, van Vliet and van Ginkel (2002): y[n] = B x[n] + a1 y[n-1] + a2 y[n-2] + a3 y[n-3],
+// run forwards and then backwards. The poles for sigma 2 are scaled by 1/q, with q chosen to give exactly the variance of sigma.
+struct RecursiveGaussianCoefficients {
+    explicit RecursiveGaussianCoefficients(double sigma) {
+        const std::complex<double> poles[3] = {{1.41650, 1.00829}, {1.41650, -1.00829}, {1.86543, 0.0}};
+        auto variance = [&](double q) {
+            double v = 0.0;
+            for (auto& pole : poles) {
+                auto d = std::pow(pole, 1.0 / q);
+                v += std::real(2.0 * d / ((d - 1.0) * (d - 1.0)));
+            }
+            return v;
+        };
+
+        double q = sigma / 2.0;
+        for (int i = 0; i < 20; ++i) {
+            double v = variance(q);
+            double dv = (variance(q * 1.0001) - v) / (q * 1.0e-4);
+            q -= (v - sigma * sigma) / dv;
+        }
+
+        std::complex<double> p[3];
+        for (int i = 0; i < 3; ++i) {
+            p[i] = 1.0 / std::pow(poles[i], 1.0 / q);
+        }
+        double c1 = std::real(p[0] + p[1] + p[2]);
+        double c2 = -std::real(p[0] * p[1] + p[0] * p[2] + p[1] * p[2]);
+        double c3 = std::real(p[0] * p[1] * p[2]);
+        double c0 = 1.0 - (c1 + c2 + c3);
+        a1 = c1;
+        a2 = c2;
+        a3 = c3;
+        B = c0;
+
+        // As in Triggs and Sdika (2006), the backward pass starts from a linear map M of the last three forward
+        // outputs, relative to the edge value, that matches padding with the edge value. The map is found by running the
+        // filters on each unit state until the response has decayed.
+        double max_pole = std::max(std::abs(p[0]), std::abs(p[2]));
+        int64_t padding = std::ceil(20.0 / (1.0 - max_pole)) + 3;
+        std::vector<double> forward(padding + 3), backward(padding + 6, 0.0);
+        for (int column = 0; column < 3; ++column) {
+            // Forward outputs at n - 1, n - 2, n - 3 are the unit state, followed by the response to zero padding
+            std::fill(forward.begin(), forward.end(), 0.0);
+            forward[2 - column] = 1.0;
+            for (int64_t i = 3; i < padding + 3; ++i) {
+                forward[i] = c1 * forward[i - 1] + c2 * forward[i - 2] + c3 * forward[i - 3];
+            }
+            std::fill(backward.begin(), backward.end(), 0.0);
+            for (int64_t i = padding + 2; i >= 2; --i) {
+                backward[i] = c0 * forward[i] + c1 * backward[i + 1] + c2 * backward[i + 2] + c3 * backward[i + 3];
+            }
+            for (int row = 0; row < 3; ++row) {
+                M[row][column] = backward[2 + row];
             }
         }
     }
 
-    auto t_end = std::chrono::high_resolution_clock::now();
-    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
-    auto rate = dest_width * dest_height / (double)dt;
-    spdlog::performance("Smoothed with smoothing factor of {} and kernel size of {} in {:.3f} ms at {:.3f} MPix/s", smoothing_factor,
-        mask_size, dt * 1e-3, rate);
+    float B, a1, a2, a3;
+    float M[3][3]; // backward outputs at n - 1, n, n + 1
+};
+
+// Filters num_lines interleaved signals in place: element i of line l is at data[i * stride + l]. The lines are
+// contiguous, so the inner loops vectorise across them. Both edges are padded with the edge value.
+static void RecursiveGaussianLines(const RecursiveGaussianCoefficients& c, float* data, int64_t length, int64_t stride, int64_t num_lines) {
+    if (length < 3) {
+        return;
+    }
 
+    float* last = data + (length - 1) * stride;
+    std::vector<float> edge(last, last + num_lines);
+    const float *p1 = data, *p2 = data, *p3 = data;
+    for (int64_t i = 0; i < length; ++i) {
+        float* p = data + i * stride;
+#pragma omp simd
+        for (int64_t l = 0; l < num_lines; ++l) {
+            p[l] = c.B * p[l] + c.a1 * p1[l] + c.a2 * p2[l] + c.a3 * p3[l];
+        }
+        p3 = p2;
+        p2 = p1;
+        p1 = p;
+    }
+
+    // Backward outputs past the end, from the map of the last forward outputs
+    std::vector<float> next1(num_lines), next2(num_lines);
+    const float* y1 = last - stride;
+    const float* y2 = last - 2 * stride;
+    for (int64_t l = 0; l < num_lines; ++l) {
+        float d0 = last[l] - edge[l];
+        float d1 = y1[l] - edge[l];
+        float d2 = y2[l] - edge[l];
+        last[l] = edge[l] + c.M[0][0] * d0 + c.M[0][1] * d1 + c.M[0][2] * d2;
+        next1[l] = edge[l] + c.M[1][0] * d0 + c.M[1][1] * d1 + c.M[1][2] * d2;
+        next2[l] = edge[l] + c.M[2][0] * d0 + c.M[2][1] * d1 + c.M[2][2] * d2;
+    }
+
+    p1 = last;
+    p2 = next1.data();
+    p3 = next2.data();
+    for (int64_t i = length - 2; i >= 0; --i) {
+        float* p = data + i * stride;
+#pragma omp simd
+        for (int64_t l = 0; l < num_lines; ++l) {
+            p[l] = c.B * p[l] + c.a1 * p1[l] + c.a2 * p2[l] + c.a3 * p3[l];
+        }
+        p3 = p2;
+        p2 = p1;
+        p1 = p;
+    }
+}
+
+bool RecursiveGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int smoothing_factor) {
+    // Same sigma and output region as the kernel; NaNs are handled as a normalized convolution, smoothing the finite
+    // values and their mask separately
+    const RecursiveGaussianCoefficients coefficients((smoothing_factor - 1) / 2.0);
+    const int64_t apron = smoothing_factor - 1;
+    std::vector<float> values(dest_width * src_height);
+    std::vector<float> weights(dest_width * src_height);
+
+    // Horizontal pass on blocks of rows, transposed so that the rows are filtered together, with the values of each
+    // column followed by their weights
+    const int64_t num_row_blocks = (src_height + GAUSSIAN_IIR_BLOCK_ROWS - 1) / GAUSSIAN_IIR_BLOCK_ROWS;
+    const int64_t block_stride = 2 * GAUSSIAN_IIR_BLOCK_ROWS;
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel
+    {
+        std::vector<float> block_data(src_width * block_stride);
+#pragma omp for schedule(dynamic)
+        for (int64_t block = 0; block < num_row_blocks; ++block) {
+            int64_t y_start = block * GAUSSIAN_IIR_BLOCK_ROWS;
+            int64_t num_rows = min((int64_t)GAUSSIAN_IIR_BLOCK_ROWS, src_height - y_start);
+            if (num_rows < GAUSSIAN_IIR_BLOCK_ROWS) {
+                std::fill(block_data.begin(), block_data.end(), 0.0f);
+            }
+            for (int64_t l = 0; l < num_rows; ++l) {
+                const float* src_row = src_data + (y_start + l) * src_width;
+                float* column = block_data.data() + l;
+                for (int64_t x = 0; x < src_width; ++x) {
+                    float val = src_row[x];
+                    bool finite = std::isfinite(val);
+                    column[x * block_stride] = finite ? val : 0.0f;
+                    column[x * block_stride + GAUSSIAN_IIR_BLOCK_ROWS] = finite ? 1.0f : 0.0f;
+                }
+            }
+
+            RecursiveGaussianLines(coefficients, block_data.data(), src_width, block_stride, block_stride);
+
+            for (int64_t l = 0; l < num_rows; ++l) {
+                float* value_row = values.data() + (y_start + l) * dest_width;
+                float* weight_row = weights.data() + (y_start + l) * dest_width;
+                const float* column = block_data.data() + apron * block_stride + l;
+                for (int64_t x = 0; x < dest_width; ++x) {
+                    value_row[x] = column[x * block_stride];
+                    weight_row[x] = column[x * block_stride + GAUSSIAN_IIR_BLOCK_ROWS];
+                }
+            }
+        }
+    }
+
+    // Vertical pass on strips of columns, which are contiguous in each row
+    const int64_t num_column_strips = (dest_width + GAUSSIAN_IIR_STRIP_WIDTH - 1) / GAUSSIAN_IIR_STRIP_WIDTH;
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t strip = 0; strip < num_column_strips; ++strip) {
+        int64_t x_start = strip * GAUSSIAN_IIR_STRIP_WIDTH;
+        int64_t num_columns = min((int64_t)GAUSSIAN_IIR_STRIP_WIDTH, dest_width - x_start);
+        RecursiveGaussianLines(coefficients, values.data() + x_start, src_height, dest_width, num_columns);
+        RecursiveGaussianLines(coefficients, weights.data() + x_start, src_height, dest_width, num_columns);
+
+        for (int64_t y = 0; y < dest_height; ++y) {
+            const float* value_row = values.data() + (y + apron) * dest_width;
+            const float* weight_row = weights.data() + (y + apron) * dest_width;
+            float* dest_row = dest_data + y * dest_width;
+            for (int64_t x = x_start; x < x_start + num_columns; ++x) {
+                dest_row[x] = (weight_row[x] > GAUSSIAN_IIR_MIN_WEIGHT) ? value_row[x] / weight_row[x] : NAN;
+            }
+        }
+    }
     return true;
 }
 
 bool BlockSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor) {
-#ifdef __AVX__
+#ifdef CARTA_X86_SIMD
     // AVX version, only for 8x down-sampling and above
-    if (smoothing_factor % 8 == 0) {
+    static const bool use_avx = carta::GetSimdLevel() >= carta::SimdLevel::Avx;
+    if (use_avx && (smoothing_factor % 8 == 0)) {
         return BlockSmoothAVX(src_data, dest_data, src_width, src_height, dest_width, dest_height, x_offset, y_offset, smoothing_factor);
     }
 #endif
@@ -195,8 +462,172 @@ bool BlockSmooth(const float* src_data, float* dest_data, int64_t src_width, int
     }
 }
 
+// For large smoothing factors, the SIMD versions work on tiles of output pixels of one output row, reading each source row of the tile
+// sequentially into per-pixel sums, so that the hardware prefetcher follows one stream rather than one per source row of the blocks.
+// The sums of a pixel are added in the same order as block by block, so the results are identical. Tiles of all rows are shared
+// between the threads, as there are few output rows.
+static bool BlockSmoothTiledSSE(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+    carta::ThreadManager::ApplyThreadLimit();
+    const int64_t num_tiles = (dest_width + BLOCK_SMOOTH_TILE_WIDTH - 1) / BLOCK_SMOOTH_TILE_WIDTH;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t task = 0; task < dest_height * num_tiles; ++task) {
+        int64_t j = task / num_tiles;
+        int64_t tile_start = (task % num_tiles) * BLOCK_SMOOTH_TILE_WIDTH;
+        int64_t tile_width = min((int64_t)BLOCK_SMOOTH_TILE_WIDTH, dest_width - tile_start);
+        size_t image_row = y_offset + (j * smoothing_factor);
+        int rows_left = min(smoothing_factor, (int)(src_height - image_row));
+
+        __m128 v0 = _mm_setzero_ps();
+        __m128 v1 = _mm_set_ps1(1.0f);
+        __m128 totals[BLOCK_SMOOTH_TILE_WIDTH];
+        __m128 counts[BLOCK_SMOOTH_TILE_WIDTH];
+        for (auto t = 0; t < tile_width; t++) {
+            totals[t] = v0;
+            counts[t] = v0;
+        }
+
+        for (auto row_index = 0; row_index < rows_left; row_index++) {
+            const float* row_ptr = src_data + ((image_row + row_index) * src_width) + x_offset;
+            if (row_index + 1 < rows_left) {
+                _mm_prefetch((const char*)(row_ptr + src_width + tile_start * smoothing_factor), _MM_HINT_T0);
+            }
+            for (auto t = 0; t < tile_width; t++) {
+                size_t image_col = x_offset + ((tile_start + t) * smoothing_factor);
+                int columns_left = min(smoothing_factor, (int)(src_width - image_col));
+                int blocks_left = columns_left / 4;
+                const float* ptr = row_ptr + (tile_start + t) * smoothing_factor;
+                __m128 count = counts[t], total = totals[t];
+                for (auto col_index = 0; col_index < blocks_left; col_index++) {
+                    __m128 row = _mm_loadu_ps(ptr);
+                    __m128 mask = _mm_andnot_ps(IsInfinity(row), _mm_cmpeq_ps(row, row));
+                    row = _mm_and_ps(row, mask);
+                    count = _mm_add_ps(count, _mm_and_ps(v1, mask));
+                    total = _mm_add_ps(total, row);
+                    ptr += 4;
+                }
+                counts[t] = count;
+                totals[t] = total;
+            }
+        }
+
+        for (auto t = 0; t < tile_width; t++) {
+            int64_t i = tile_start + t;
+            float pixel_sum = 0;
+            float pixel_count = 0;
+            size_t image_col = x_offset + (i * smoothing_factor);
+            int columns_left = min(smoothing_factor, (int)(src_width - image_col));
+            int blocks_left = columns_left / 4;
+
+            // reduce
+            __m128 total = _mm_hadd_ps(totals[t], totals[t]);
+            total = _mm_hadd_ps(total, total);
+            _mm_store_ss(&pixel_sum, total);
+
+            __m128 count = _mm_hadd_ps(counts[t], counts[t]);
+            count = _mm_hadd_ps(count, count);
+            _mm_store_ss(&pixel_count, count);
+
+            if (columns_left != smoothing_factor) {
+                // Add right edge of block
+                for (auto row_index = 0; row_index < rows_left; row_index++) {
+                    for (auto col_index = blocks_left * 4; col_index < columns_left; col_index++) {
+                        auto pix_val = src_data[(image_row + row_index) * src_width + image_col + col_index];
+                        if (std::isfinite(pix_val)) {
+                            pixel_count++;
+                            pixel_sum += pix_val;
+                        }
+                    }
+                }
+            }
+
+            dest_data[j * dest_width + i] = pixel_count ? pixel_sum / pixel_count : NAN;
+        }
+    }
+    return true;
+}
+
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX static bool BlockSmoothTiledAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height,
+    int64_t dest_width, int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+    carta::ThreadManager::ApplyThreadLimit();
+    const int64_t num_tiles = (dest_width + BLOCK_SMOOTH_TILE_WIDTH - 1) / BLOCK_SMOOTH_TILE_WIDTH;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t task = 0; task < dest_height * num_tiles; ++task) {
+        int64_t j = task / num_tiles;
+        int64_t tile_start = (task % num_tiles) * BLOCK_SMOOTH_TILE_WIDTH;
+        int64_t tile_width = min((int64_t)BLOCK_SMOOTH_TILE_WIDTH, dest_width - tile_start);
+        int64_t image_row = y_offset + (j * smoothing_factor);
+        int rows_left = min(smoothing_factor, (int)(src_height - image_row));
+
+        __m256 v0 = _mm256_setzero_ps();
+        __m256 v1 = _mm256_set1_ps(1.0f);
+        __m256 totals[BLOCK_SMOOTH_TILE_WIDTH];
+        __m256 counts[BLOCK_SMOOTH_TILE_WIDTH];
+        for (auto t = 0; t < tile_width; t++) {
+            totals[t] = v0;
+            counts[t] = v0;
+        }
+
+        for (auto row_index = 0; row_index < rows_left; row_index++) {
+            const float* row_ptr = src_data + ((image_row + row_index) * src_width) + x_offset;
+            if (row_index + 1 < rows_left) {
+                _mm_prefetch((const char*)(row_ptr + src_width + tile_start * smoothing_factor), _MM_HINT_T0);
+            }
+            for (auto t = 0; t < tile_width; t++) {
+                int64_t image_col = x_offset + ((tile_start + t) * smoothing_factor);
+                int columns_left = min(smoothing_factor, (int)(src_width - image_col));
+                int blocks_left = columns_left / 8;
+                const float* ptr = row_ptr + (tile_start + t) * smoothing_factor;
+                __m256 count = counts[t], total = totals[t];
+                for (auto col_index = 0; col_index < blocks_left; col_index++) {
+                    __m256 row = _mm256_loadu_ps(ptr);
+                    __m256 mask = _mm256_andnot_ps(IsInfinity(row), _mm256_cmp_ps(row, row, _CMP_EQ_OQ));
+                    row = _mm256_and_ps(row, mask);
+                    count = _mm256_add_ps(count, _mm256_and_ps(v1, mask));
+                    total = _mm256_add_ps(total, row);
+                    ptr += 8;
+                }
+                counts[t] = count;
+                totals[t] = total;
+            }
+        }
+
+        for (auto t = 0; t < tile_width; t++) {
+            int64_t i = tile_start + t;
+            int64_t image_col = x_offset + (i * smoothing_factor);
+            int columns_left = min(smoothing_factor, (int)(src_width - image_col));
+            int blocks_left = columns_left / 8;
+
+            // reduce
+            float pixel_sum = _mm256_reduce_add_ps(totals[t]);
+            float pixel_count = _mm256_reduce_add_ps(counts[t]);
+
+            if (columns_left != smoothing_factor) {
+                // Add right edge of block
+                for (auto row_index = 0; row_index < rows_left; row_index++) {
+                    for (auto col_index = blocks_left * 8; col_index < columns_left; col_index++) {
+                        auto pix_val = src_data[(image_row + row_index) * src_width + image_col + col_index];
+                        if (std::isfinite(pix_val)) {
+                            pixel_count++;
+                            pixel_sum += pix_val;
+                        }
+                    }
+                }
+            }
+            dest_data[j * dest_width + i] = pixel_count ? pixel_sum / pixel_count : NAN;
+        }
+    }
+    return true;
+}
+#endif
+
 bool BlockSmoothSSE(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+    if (smoothing_factor >= BLOCK_SMOOTH_TILED_MIN_FACTOR) {
+        return BlockSmoothTiledSSE(
+            src_data, dest_data, src_width, src_height, dest_width, dest_height, x_offset, y_offset, smoothing_factor);
+    }
     carta::ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (int64_t j = 0; j < dest_height; ++j) {
@@ -253,9 +684,13 @@ bool BlockSmoothSSE(const float* src_data, float* dest_data, int64_t src_width,
     return true;
 }
 
-#ifdef __AVX__
-bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
-    int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor) {
+    if (smoothing_factor >= BLOCK_SMOOTH_TILED_MIN_FACTOR) {
+        return BlockSmoothTiledAVX(
+            src_data, dest_data, src_width, src_height, dest_width, dest_height, x_offset, y_offset, smoothing_factor);
+    }
     carta::ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (int64_t j = 0; j < dest_height; ++j) {
@@ -344,10 +779,48 @@ void NearestNeighbor(const float* src_data, float* dest_data, int64_t src_width,
     carta::ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for
     for (size_t j = 0; j < dest_height; ++j) {
+        auto image_row = y_offset + j * smoothing_factor;
+        if (smoothing_factor == 1) {
+            std::copy_n(src_data + (image_row * src_width) + x_offset, dest_width, dest_data + j * dest_width);
+            continue;
+        }
         for (auto i = 0; i < dest_width; i++) {
-            auto image_row = y_offset + j * smoothing_factor;
             auto image_col = x_offset + i * smoothing_factor;
             dest_data[j * dest_width + i] = src_data[(image_row * src_width) + image_col];
         }
     }
 }
+
+void MinMaxEnvelope(const float* src_data, int64_t stride, int64_t length, int64_t num_bins, std::vector<float>& envelope) {
+    envelope.resize(2 * num_bins);
+    for (int64_t bin = 0; bin < num_bins; bin++) {
+        int64_t start = bin * length / num_bins;
+        int64_t end = (bin + 1) * length / num_bins;
+        float min_val = std::numeric_limits<float>::max();
+        float max_val = std::numeric_limits<float>::lowest();
+        int64_t min_index(-1), max_index(-1);
+        for (int64_t i = start; i < end; i++) {
+            float val = src_data[i * stride];
+            if (std::isfinite(val)) {
+                if (val < min_val) {
+                    min_val = val;
+                    min_index = i;
+                }
+                if (val > max_val) {
+                    max_val = val;
+                    max_index = i;
+                }
+            }
+        }
+
+        if (min_index < 0) {
+            envelope[2 * bin] = envelope[2 * bin + 1] = NAN;
+        } else if (min_index <= max_index) {
+            envelope[2 * bin] = min_val;
+            envelope[2 * bin + 1] = max_val;
+        } else {
+            envelope[2 * bin] = max_val;
+            envelope[2 * bin + 1] = min_val;
+        }
+    }
+}
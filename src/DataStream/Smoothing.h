@@ -21,12 +21,23 @@
 #include <x86intrin.h>
 #endif
 
+#include "SimdDispatch.h"
+
 #define SMOOTHING_TEMP_BUFFER_SIZE_MB 200
 
-#ifdef __AVX__
-#define SIMD_WIDTH 8
+// From this smoothing factor, the SIMD block smoothing sums tiles of output pixels of a row together, one source row at a time
+#define BLOCK_SMOOTH_TILED_MIN_FACTOR 64
+#define BLOCK_SMOOTH_TILE_WIDTH 64
+
+// Gaussian smoothing uses a recursive filter from this smoothing factor, on blocks of rows filtered together and strips of
+// columns. Pixels with less than the minimum fraction of the Gaussian weight on finite values are NaN.
+#define GAUSSIAN_IIR_MIN_SMOOTHING_FACTOR 16
+#define GAUSSIAN_IIR_BLOCK_ROWS 8
+#define GAUSSIAN_IIR_STRIP_WIDTH 256
+#define GAUSSIAN_IIR_MIN_WEIGHT 0.01f
 
-static inline __m256 IsInfinity(__m256 x) {
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX static inline __m256 IsInfinity(__m256 x) {
     const __m256 sign_mask = _mm256_set1_ps(-0.0);
     const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
     x = _mm256_andnot_ps(sign_mask, x);
@@ -34,15 +45,13 @@ static inline __m256 IsInfinity(__m256 x) {
     return x;
 }
 
-static inline float _mm256_reduce_add_ps(__m256 x) {
+CARTA_TARGET_AVX static inline float _mm256_reduce_add_ps(__m256 x) {
     __m256 t1 = _mm256_hadd_ps(x, x);
     __m256 t2 = _mm256_hadd_ps(t1, t1);
     __m128 t3 = _mm256_extractf128_ps(t2, 1);
     __m128 t4 = _mm_add_ss(_mm256_castps256_ps128(t2), t3);
     return _mm_cvtss_f32(t4);
 }
-#else
-#define SIMD_WIDTH 4
 #endif
 
 static inline __m128 IsInfinity(__m128 x) {
@@ -55,21 +64,37 @@ static inline __m128 IsInfinity(__m128 x) {
 }
 
 void MakeKernel(std::vector<float>& kernel, double sigma);
+// RunKernel and BlockSmooth select the SIMD version at run time
 bool RunKernel(const std::vector<float>& kernel, const float* src_data, float* dest_data, int64_t src_width, int64_t src_height,
     int64_t dest_width, int64_t dest_height, bool vertical);
+bool RunKernelSSE(const std::vector<float>& kernel, const float* src_data, float* dest_data, int64_t src_width, int64_t src_height,
+    int64_t dest_width, int64_t dest_height, bool vertical);
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX bool RunKernelAVX(const std::vector<float>& kernel, const float* src_data, float* dest_data, int64_t src_width,
+    int64_t src_height, int64_t dest_width, int64_t dest_height, bool vertical);
+#endif
+// GaussianSmooth selects the kernel or recursive version from the smoothing factor
 bool GaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int smoothing_factor);
+bool KernelGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int smoothing_factor);
+// Needs temporary buffers of twice dest_width x src_height
+bool RecursiveGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int smoothing_factor);
 bool BlockSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor);
 bool BlockSmoothScalar(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
     int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor);
 bool BlockSmoothSSE(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
     int64_t x_offset, int64_t y_offset, int smoothing_factor);
-#ifdef __AVX__
-bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width, int64_t dest_height,
-    int64_t x_offset, int64_t y_offset, int smoothing_factor);
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX bool BlockSmoothAVX(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, int64_t x_offset, int64_t y_offset, int smoothing_factor);
 #endif
 
 void NearestNeighbor(const float* src_data, float* dest_data, int64_t src_width, int64_t dest_width, int64_t dest_height, int64_t x_offset,
     int64_t y_offset, int smoothing_factor);
+// Min and max of each of num_bins equal bins of length values at the given stride, in the order they occur, so that a line through
+// the 2 * num_bins values has the same extent as one through all values. Bins without finite values give two NaNs.
+void MinMaxEnvelope(const float* src_data, int64_t stride, int64_t length, int64_t num_bins, std::vector<float>& envelope);
 #endif // CARTA_BACKEND__SMOOTHING_H_
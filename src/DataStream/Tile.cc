@@ -4,4 +4,35 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
-#include "Tile.h"
\ No newline at end of file
+#include "Tile.h"
+#include <algorithm>
+
+void Tile::SortByPriority(std::vector<Tile>& tiles) {
+    if (tiles.size() < 2) {
+        return;
+    }
+
+    // Centre of the requested tiles in layer-independent coordinates [0, 1]
+    double centre_x(0), centre_y(0);
+    for (const auto& tile : tiles) {
+        double layer_width = 1 << tile.layer;
+        centre_x += (tile.x + 0.5) / layer_width;
+        centre_y += (tile.y + 0.5) / layer_width;
+    }
+    centre_x /= tiles.size();
+    centre_y /= tiles.size();
+
+    auto distance = [&](const Tile& tile) {
+        double layer_width = 1 << tile.layer;
+        double dx = (tile.x + 0.5) / layer_width - centre_x;
+        double dy = (tile.y + 0.5) / layer_width - centre_y;
+        return dx * dx + dy * dy;
+    };
+
+    std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b) {
+        if (a.layer != b.layer) {
+            return a.layer > b.layer;
+        }
+        return distance(a) < distance(b);
+    });
+}
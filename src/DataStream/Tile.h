@@ -10,6 +10,7 @@
 #include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 struct Tile {
     int32_t x;
@@ -32,6 +33,47 @@ struct Tile {
         return Tile{x, y, layer};
     }
 
+    // 64-bit keys, with 28 bits each for x and y up to layer 28, for images more than 4096 tiles wide. The backend uses them for its
+    // caches; frontends use them if negotiated in RegisterViewer (TILE_KEYS_64_FEATURE_FLAG).
+    static int64_t Encode64(int32_t x, int32_t y, int32_t layer) {
+        if (x < 0 || y < 0 || layer < 0 || layer > 28 || (int64_t)x >= ((int64_t)1 << layer) || (int64_t)y >= ((int64_t)1 << layer)) {
+            return -1;
+        }
+
+        return (((int64_t)layer << 56) | ((int64_t)y << 28) | x);
+    }
+
+    static Tile Decode64(int64_t encoded_value) {
+        int32_t x = encoded_value & 0xFFFFFFF;
+        int32_t y = (encoded_value >> 28) & 0xFFFFFFF;
+        int32_t layer = (encoded_value >> 56) & 0x7F;
+        return Tile{x, y, layer};
+    }
+
+    // Tiles of the int32 tiles field of a request: encoded values, or with 64-bit keys a pair of values for each key, its high
+    // word first. False if a 64-bit key is incomplete.
+    template <typename EncodedTiles>
+    static bool DecodeTiles(const EncodedTiles& encoded, bool keys_64, std::vector<Tile>& tiles) {
+        tiles.clear();
+        if (!keys_64) {
+            tiles.reserve(encoded.size());
+            for (int32_t encoded_value : encoded) {
+                tiles.push_back(Decode(encoded_value));
+            }
+            return true;
+        }
+
+        if (encoded.size() % 2) {
+            return false;
+        }
+        tiles.reserve(encoded.size() / 2);
+        for (int i = 0; i < encoded.size(); i += 2) {
+            tiles.push_back(Decode64(((int64_t)encoded[i] << 32) | (uint32_t)encoded[i + 1]));
+        }
+        return true;
+    }
+
+    // Downsampling factor of a layer, for either encoding
     static int32_t LayerToMip(int32_t layer, int32_t image_width, int32_t image_height, int32_t tile_width, int32_t tile_height) {
         double total_tiles_x = ceil((double)(image_width) / tile_width);
         double total_tiles_y = ceil((double)(image_height) / tile_height);
@@ -39,6 +81,9 @@ struct Tile {
         double total_layers = ceil(log2(max_mip));
         return pow(2.0, total_layers - layer);
     }
+
+    // Order tiles for generation: highest (requested) layer first, then by distance from the centre of the requested tiles
+    static void SortByPriority(std::vector<Tile>& tiles);
 };
 
 #endif // CARTA_BACKEND__TILE_H_
@@ -0,0 +1,104 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "TileCache.h"
+
+#include "../Constants.h"
+#include "../Metrics.h"
+
+TileCache::TileCache(size_t capacity_bytes)
+    : _capacity_bytes(capacity_bytes), _memory_usage(0), _memory_account("tiles", TILE_CACHE_COST, this) {}
+
+bool TileCache::Get(const TileCacheKey& key, CARTA::TileData& tile_data, float& compression_quality) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    carta::Metrics::Global().RecordCacheLookup(carta::CacheType::Tiles, it != _index.end());
+    if (it == _index.end()) {
+        return false;
+    }
+
+    // Move entry to the front of the LRU list
+    _entries.splice(_entries.begin(), _entries, it->second);
+    it->second->last_used = std::chrono::steady_clock::now();
+    tile_data = it->second->tile_data;
+    compression_quality = it->second->compression_quality;
+    return true;
+}
+
+void TileCache::Put(const TileCacheKey& key, const CARTA::TileData& tile_data, float compression_quality) {
+    size_t num_bytes = tile_data.ByteSizeLong();
+    if (num_bytes > _capacity_bytes) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            _memory_usage -= it->second->num_bytes;
+            _entries.erase(it->second);
+            _index.erase(it);
+        }
+
+        _entries.push_front(TileCacheEntry{key, tile_data, compression_quality, num_bytes, std::chrono::steady_clock::now()});
+        _index.emplace(key, _entries.begin());
+        _memory_usage += num_bytes;
+        Evict();
+        _memory_account.SetUsage(_memory_usage);
+    }
+    _memory_account.Enforce();
+}
+
+void TileCache::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _index.clear();
+    _entries.clear();
+    _memory_usage = 0;
+    _memory_account.SetUsage(0);
+}
+
+size_t TileCache::Size() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+size_t TileCache::MemoryUsage() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _memory_usage;
+}
+
+void TileCache::Evict() {
+    // Caller holds the mutex
+    while (_memory_usage > _capacity_bytes && !_entries.empty()) {
+        auto& entry = _entries.back();
+        _memory_usage -= entry.num_bytes;
+        _index.erase(entry.key);
+        _entries.pop_back();
+    }
+}
+
+bool TileCache::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return false;
+    }
+    last_used = _entries.back().last_used;
+    return true;
+}
+
+size_t TileCache::EvictOldest() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_entries.empty()) {
+        return 0;
+    }
+    auto& entry = _entries.back();
+    size_t num_bytes = entry.num_bytes;
+    _memory_usage -= num_bytes;
+    _index.erase(entry.key);
+    _entries.pop_back();
+    _memory_account.SetUsage(_memory_usage);
+    return num_bytes;
+}
@@ -0,0 +1,93 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TileCache.h: memory-bounded LRU cache of compressed raster tiles
+
+#ifndef CARTA_BACKEND__TILECACHE_H_
+#define CARTA_BACKEND__TILECACHE_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <carta-protobuf/defs.pb.h>
+#include <carta-protobuf/raster_tile.pb.h>
+
+#include "../MemoryBudget.h"
+#include "Tile.h"
+
+struct TileCacheKey {
+    int64_t encoded_tile;
+    int32_t z;
+    int32_t stokes;
+    CARTA::CompressionType compression_type;
+    int32_t compression_quality;
+
+    TileCacheKey(const Tile& tile, int z_, int stokes_, CARTA::CompressionType compression_type_, float compression_quality_)
+        : encoded_tile(Tile::Encode64(tile.x, tile.y, tile.layer)),
+          z(z_),
+          stokes(stokes_),
+          compression_type(compression_type_),
+          compression_quality(compression_type_ == CARTA::CompressionType::NONE ? 0 : std::lround(compression_quality_)) {}
+
+    bool operator==(const TileCacheKey& rhs) const {
+        return (encoded_tile == rhs.encoded_tile) && (z == rhs.z) && (stokes == rhs.stokes) &&
+               (compression_type == rhs.compression_type) && (compression_quality == rhs.compression_quality);
+    }
+
+    struct Hash {
+        std::size_t operator()(const TileCacheKey& key) const {
+            std::size_t h = std::hash<int64_t>()(key.encoded_tile);
+            h ^= std::hash<int32_t>()(key.z) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int32_t>()(key.stokes) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int32_t>()((key.compression_type << 8) | key.compression_quality) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+};
+
+class TileCache : private carta::MemoryConsumer {
+public:
+    explicit TileCache(size_t capacity_bytes);
+
+    // Charges the tiles of a frame to its session in the memory budget
+    void SetSessionId(uint32_t session_id) {
+        _memory_account.SetSessionId(session_id);
+    }
+
+    // Copy cached tile into tile_data and set the quality actually used; returns false on miss
+    bool Get(const TileCacheKey& key, CARTA::TileData& tile_data, float& compression_quality);
+    void Put(const TileCacheKey& key, const CARTA::TileData& tile_data, float compression_quality);
+    void Reset();
+
+    size_t Size();
+    size_t MemoryUsage();
+
+private:
+    struct TileCacheEntry {
+        TileCacheKey key;
+        CARTA::TileData tile_data;
+        float compression_quality;
+        size_t num_bytes;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    void Evict();
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
+    std::list<TileCacheEntry> _entries; // most recently used at the front
+    std::unordered_map<TileCacheKey, std::list<TileCacheEntry>::iterator, TileCacheKey::Hash> _index;
+    size_t _capacity_bytes;
+    size_t _memory_usage;
+    std::mutex _mutex;
+    carta::MemoryAccount _memory_account;
+};
+
+#endif // CARTA_BACKEND__TILECACHE_H_
@@ -0,0 +1,120 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "TileDelta.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "Compression.h"
+
+void TileDeltaEncoder::StartFrame(int animation_id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (animation_id != _animation_id) {
+        _references.clear();
+        _animation_id = animation_id;
+    }
+}
+
+void TileDeltaEncoder::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _references.clear();
+    _animation_id = -1;
+}
+
+size_t TileDeltaEncoder::Size() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _references.size();
+}
+
+bool TileDeltaEncoder::Encode(const Tile& tile, int z, int stokes, std::vector<float>& tile_data, int width, int height,
+    const std::vector<int32_t>& nan_encodings, uint32_t precision, TileDeltaResult& result) {
+    std::shared_ptr<Reference> reference;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto& entry = _references[Tile::Encode64(tile.x, tile.y, tile.layer)];
+        if (!entry) {
+            entry = std::make_shared<Reference>();
+        }
+        reference = entry;
+    }
+    std::unique_lock<std::mutex> reference_lock(reference->mutex);
+
+    if (!reference->valid || (reference->stokes != stokes) || (reference->width != width) || (reference->height != height) ||
+        (reference->precision != precision) || (reference->nan_encodings != nan_encodings) ||
+        (reference->frames_since_keyframe + 1 >= DELTA_KEYFRAME_INTERVAL)) {
+        return EncodeKeyframe(*reference, z, stokes, tile_data, width, height, nan_encodings, precision, result);
+    }
+
+    // Residual of the valid pixels; replaced NaNs are compared with the replaced NaNs of the reference
+    thread_local std::vector<float> residual;
+    thread_local std::vector<char> compression_buffer;
+    size_t length = (size_t)width * height;
+    residual.resize(length);
+    for (size_t i = 0; i < length; ++i) {
+        float difference = tile_data[i] - reference->values[i];
+        residual[i] = std::isfinite(difference) ? difference : 0.0f;
+    }
+    size_t compressed_size;
+    if (CompressAccuracy(residual, 0, compression_buffer, compressed_size, width, height, reference->tolerance) ||
+        (sizeof(int32_t) + compressed_size >= reference->keyframe_size) ||
+        Decompress(compression_buffer.data(), compressed_size, residual, width, height, precision, reference->tolerance)) {
+        // Fall back to a keyframe when the residual does not compress better
+        return EncodeKeyframe(*reference, z, stokes, tile_data, width, height, nan_encodings, precision, result);
+    }
+
+    // Update the reference as the frontend does, with the decoded residual
+    for (size_t i = 0; i < length; ++i) {
+        reference->values[i] += residual[i];
+    }
+    int32_t reference_z = reference->z;
+    reference->z = z;
+    ++reference->frames_since_keyframe;
+
+    result.keyframe = false;
+    result.precision = precision;
+    result.tolerance = reference->tolerance;
+    result.data.resize(sizeof(int32_t) + compressed_size);
+    memcpy(result.data.data(), &reference_z, sizeof(int32_t));
+    memcpy(result.data.data() + sizeof(int32_t), compression_buffer.data(), compressed_size);
+    return true;
+}
+
+bool TileDeltaEncoder::EncodeKeyframe(Reference& reference, int z, int stokes, std::vector<float>& tile_data, int width, int height,
+    const std::vector<int32_t>& nan_encodings, uint32_t precision, TileDeltaResult& result) {
+    reference.valid = false;
+    size_t compressed_size;
+    if (Compress(tile_data, 0, result.data, compressed_size, width, height, precision) ||
+        Decompress(result.data.data(), compressed_size, reference.values, width, height, precision)) {
+        return false;
+    }
+    result.data.resize(compressed_size);
+
+    // Residuals are kept to about the relative error of the keyframe precision
+    float max_abs(0);
+    for (float value : reference.values) {
+        if (std::isfinite(value)) {
+            max_abs = std::max(max_abs, std::fabs(value));
+        }
+    }
+    reference.tolerance = std::max(std::ldexp(max_abs, -(int)precision), std::numeric_limits<float>::min());
+    reference.z = z;
+    reference.stokes = stokes;
+    reference.width = width;
+    reference.height = height;
+    reference.precision = precision;
+    reference.frames_since_keyframe = 0;
+    reference.keyframe_size = compressed_size;
+    reference.nan_encodings = nan_encodings;
+    reference.valid = true;
+
+    result.keyframe = true;
+    result.precision = precision;
+    result.tolerance = 0;
+    return true;
+}
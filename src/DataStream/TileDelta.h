@@ -0,0 +1,66 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TileDelta.h: animation tiles encoded as ZFP residuals of the same tile in the previous frame sent to the frontend
+
+#ifndef CARTA_BACKEND__TILEDELTA_H_
+#define CARTA_BACKEND__TILEDELTA_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Tile.h"
+
+// Result of encoding a tile. A keyframe is ZFP data of the given precision, decoded as any ZFP tile. Otherwise the data is the
+// channel of the reference tile (int32) followed by the ZFP fixed-accuracy residual for the tolerance, which the frontend decodes
+// and adds to its previous values of the tile; NaN encodings are the same as those of the reference tile.
+struct TileDeltaResult {
+    bool keyframe;
+    uint32_t precision;
+    float tolerance;
+    std::vector<char> data;
+};
+
+// The reference of each tile is the frontend's reconstruction of the last tile sent, so that lossy residuals do not accumulate errors.
+// A keyframe is sent for the first frame, every DELTA_KEYFRAME_INTERVAL frames, when the stokes, tile size or NaN pixels change, and
+// when the compressed residual is not smaller than the keyframe of the reference. Tiles are encoded concurrently by the tile workers.
+class TileDeltaEncoder {
+public:
+    // Forgets the references if the animation has changed, so that a new animation starts with keyframes
+    void StartFrame(int animation_id);
+    void Reset();
+
+    // Encodes tile data of size width * height, whose NaNs have been replaced for ZFP with GetNanEncodingsBlock
+    bool Encode(const Tile& tile, int z, int stokes, std::vector<float>& tile_data, int width, int height,
+        const std::vector<int32_t>& nan_encodings, uint32_t precision, TileDeltaResult& result);
+
+    size_t Size();
+
+private:
+    struct Reference {
+        std::mutex mutex;
+        bool valid = false;
+        int z, stokes, width, height;
+        int frames_since_keyframe;
+        uint32_t precision;
+        float tolerance;
+        size_t keyframe_size;
+        std::vector<int32_t> nan_encodings;
+        std::vector<float> values;
+    };
+
+    bool EncodeKeyframe(Reference& reference, int z, int stokes, std::vector<float>& tile_data, int width, int height,
+        const std::vector<int32_t>& nan_encodings, uint32_t precision, TileDeltaResult& result);
+
+    int _animation_id = -1;
+    std::unordered_map<int64_t, std::shared_ptr<Reference>> _references; // by encoded tile
+    std::mutex _mutex;
+};
+
+#endif // CARTA_BACKEND__TILEDELTA_H_
@@ -0,0 +1,74 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "TileSummary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Threading.h"
+
+TileSummary::TileSummary(const float* data, int64_t width, int64_t height, int block_size)
+    : _width(width), _height(height), _block_size(block_size) {
+    _blocks_x = (width + block_size - 1) / block_size;
+    _blocks_y = (height + block_size - 1) / block_size;
+    _blocks.resize(_blocks_x * _blocks_y, {0, std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()});
+
+    // One row of blocks per iteration
+    carta::ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t block_y = 0; block_y < _blocks_y; ++block_y) {
+        Block* block_row = _blocks.data() + block_y * _blocks_x;
+        int64_t y_end = std::min(height, (block_y + 1) * block_size);
+        for (int64_t y = block_y * block_size; y < y_end; ++y) {
+            const float* row = data + y * width;
+            for (int64_t block_x = 0; block_x < _blocks_x; ++block_x) {
+                Block& block = block_row[block_x];
+                int64_t x_end = std::min(width, (block_x + 1) * block_size);
+                for (int64_t x = block_x * block_size; x < x_end; ++x) {
+                    float value = row[x];
+                    if (!std::isnan(value)) {
+                        block.min_val = std::min(block.min_val, value);
+                        block.max_val = std::max(block.max_val, value);
+                    } else {
+                        ++block.nan_count;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool TileSummary::UniformValue(int64_t x, int64_t y, int64_t width, int64_t height, float& value) const {
+    int64_t x_end = x + width;
+    int64_t y_end = y + height;
+    if ((x < 0) || (y < 0) || (width <= 0) || (height <= 0) || (x % _block_size) || (y % _block_size) || (x_end > _width) ||
+        (y_end > _height) || ((x_end % _block_size) && (x_end != _width)) || ((y_end % _block_size) && (y_end != _height))) {
+        return false;
+    }
+
+    bool all_nan(true), no_nan(true);
+    float min_val = std::numeric_limits<float>::max();
+    float max_val = std::numeric_limits<float>::lowest();
+    for (int64_t block_y = y / _block_size; block_y < (y_end + _block_size - 1) / _block_size; ++block_y) {
+        for (int64_t block_x = x / _block_size; block_x < (x_end + _block_size - 1) / _block_size; ++block_x) {
+            const Block& block = _blocks[block_y * _blocks_x + block_x];
+            int64_t block_width = std::min(_width, (block_x + 1) * _block_size) - block_x * _block_size;
+            int64_t block_height = std::min(_height, (block_y + 1) * _block_size) - block_y * _block_size;
+            int64_t block_pixels = block_width * block_height;
+            all_nan &= (block.nan_count == block_pixels);
+            no_nan &= (block.nan_count == 0);
+            min_val = std::min(min_val, block.min_val);
+            max_val = std::max(max_val, block.max_val);
+            if (!all_nan && !(no_nan && (min_val == max_val))) {
+                return false;
+            }
+        }
+    }
+    value = all_nan ? NAN : min_val;
+    return true;
+}
@@ -0,0 +1,40 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TileSummary.h: NaN count and range of the other pixels of each tile footprint of a plane
+
+#ifndef CARTA_BACKEND__TILESUMMARY_H_
+#define CARTA_BACKEND__TILESUMMARY_H_
+
+#include <cstdint>
+#include <vector>
+
+// Coarse grid over a plane in blocks of block_size pixels, the footprint of a full-resolution tile, so that tiles of any layer which
+// are all NaN or constant are known without reading the plane
+class TileSummary {
+public:
+    TileSummary(const float* data, int64_t width, int64_t height, int block_size);
+
+    // Whether the pixels of the region are all NaN (value NaN) or all equal to value. The region starts on block boundaries, and ends on
+    // block boundaries or the edge of the plane; false for other regions.
+    bool UniformValue(int64_t x, int64_t y, int64_t width, int64_t height, float& value) const;
+
+private:
+    struct Block {
+        uint32_t nan_count;
+        float min_val; // range of the pixels which are not NaN
+        float max_val;
+    };
+
+    int64_t _width;
+    int64_t _height;
+    int _block_size;
+    int64_t _blocks_x;
+    int64_t _blocks_y;
+    std::vector<Block> _blocks;
+};
+
+#endif // CARTA_BACKEND__TILESUMMARY_H_
@@ -0,0 +1,80 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# FileExtInfoCache.cc: extended file info shared by all sessions
+
+#include "FileExtInfoCache.h"
+
+FileExtInfoCache& FileExtInfoCache::GetInstance() {
+    static FileExtInfoCache cache;
+    return cache;
+}
+
+bool FileExtInfoCache::GetExtInfo(
+    const std::string& filename, const std::string& hdu, int64_t modify_time, int64_t size, CARTA::FileInfoExtended& extended_info) {
+    std::scoped_lock lock(_mutex);
+    auto file = FindFile(filename, modify_time, size, false);
+    if (!file) {
+        return false;
+    }
+    auto it = file->hdu_info.find(hdu);
+    if (it == file->hdu_info.end()) {
+        return false;
+    }
+    extended_info = it->second;
+    return true;
+}
+
+void FileExtInfoCache::PutExtInfo(const std::string& filename, const std::string& hdu, int64_t modify_time, int64_t size,
+    const CARTA::FileInfoExtended& extended_info) {
+    std::scoped_lock lock(_mutex);
+    FindFile(filename, modify_time, size, true)->hdu_info[hdu] = extended_info;
+}
+
+bool FileExtInfoCache::GetHduList(const std::string& filename, int64_t modify_time, int64_t size, std::vector<std::string>& hdu_list) {
+    std::scoped_lock lock(_mutex);
+    auto file = FindFile(filename, modify_time, size, false);
+    if (!file || !file->has_hdu_list) {
+        return false;
+    }
+    hdu_list = file->hdu_list;
+    return true;
+}
+
+void FileExtInfoCache::PutHduList(
+    const std::string& filename, int64_t modify_time, int64_t size, const std::vector<std::string>& hdu_list) {
+    std::scoped_lock lock(_mutex);
+    auto file = FindFile(filename, modify_time, size, true);
+    file->hdu_list = hdu_list;
+    file->has_hdu_list = true;
+}
+
+FileExtInfoCache::File* FileExtInfoCache::FindFile(const std::string& filename, int64_t modify_time, int64_t size, bool add) {
+    auto it = _files.find(filename);
+    if (it != _files.end() && (it->second.modify_time != modify_time || it->second.size != size)) {
+        // Info of an earlier version of the file
+        _files.erase(it);
+        it = _files.end();
+    }
+
+    if (it == _files.end()) {
+        if (!add) {
+            return nullptr;
+        }
+        if (_files.size() >= FILE_EXT_INFO_CACHE_MAX_FILES) {
+            auto oldest = _files.begin();
+            for (auto file = _files.begin(); file != _files.end(); ++file) {
+                if (file->second.last_used < oldest->second.last_used) {
+                    oldest = file;
+                }
+            }
+            _files.erase(oldest);
+        }
+        it = _files.emplace(filename, File{modify_time, size, 0, false, {}, {}}).first;
+    }
+    it->second.last_used = ++_use_count;
+    return &it->second;
+}
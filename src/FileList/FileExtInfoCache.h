@@ -0,0 +1,60 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# FileExtInfoCache.h: extended file info shared by all sessions
+
+#ifndef CARTA_BACKEND__FILELIST_FILEEXTINFOCACHE_H_
+#define CARTA_BACKEND__FILELIST_FILEEXTINFOCACHE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <carta-protobuf/file_info.pb.h>
+
+// Most files with cached info
+#define FILE_EXT_INFO_CACHE_MAX_FILES 128
+
+// Extended info of the HDUs of recently used image files, and the HDU list of FITS files, for the version of each file with a
+// modification time and size. Least recently used files are evicted.
+class FileExtInfoCache {
+public:
+    static FileExtInfoCache& GetInstance();
+
+    bool GetExtInfo(const std::string& filename, const std::string& hdu, int64_t modify_time, int64_t size,
+        CARTA::FileInfoExtended& extended_info);
+    void PutExtInfo(const std::string& filename, const std::string& hdu, int64_t modify_time, int64_t size,
+        const CARTA::FileInfoExtended& extended_info);
+
+    bool GetHduList(const std::string& filename, int64_t modify_time, int64_t size, std::vector<std::string>& hdu_list);
+    void PutHduList(const std::string& filename, int64_t modify_time, int64_t size, const std::vector<std::string>& hdu_list);
+
+    FileExtInfoCache(const FileExtInfoCache&) = delete;
+    FileExtInfoCache& operator=(const FileExtInfoCache&) = delete;
+
+private:
+    FileExtInfoCache() : _use_count(0) {}
+
+    struct File {
+        int64_t modify_time;
+        int64_t size;
+        uint64_t last_used;
+        bool has_hdu_list;
+        std::vector<std::string> hdu_list;
+        std::unordered_map<std::string, CARTA::FileInfoExtended> hdu_info;
+    };
+
+    // Cached file with the modification time and size, added if requested
+    File* FindFile(const std::string& filename, int64_t modify_time, int64_t size, bool add);
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, File> _files;
+    uint64_t _use_count;
+};
+
+#endif // CARTA_BACKEND__FILELIST_FILEEXTINFOCACHE_H_
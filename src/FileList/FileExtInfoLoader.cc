@@ -48,6 +48,7 @@ bool FileExtInfoLoader::FillFileInfoFromImage(CARTA::FileInfoExtended& extended_
     if (_loader) {
         try {
             _loader->OpenFile(hdu);
+            _loader->LoadDeferredHeaders();
             casacore::ImageInterface<float>* image = _loader->GetImage();
             if (image) {
                 casacore::IPosition image_shape(image->shape());
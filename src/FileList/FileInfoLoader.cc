@@ -8,6 +8,8 @@
 
 #include "FileInfoLoader.h"
 
+#include <mutex>
+
 #include <casacore/casa/HDF5/HDF5File.h>
 #include <casacore/casa/HDF5/HDF5Group.h>
 #include <casacore/casa/OS/Directory.h>
@@ -63,7 +65,9 @@ bool FileInfoLoader::FillFileInfo(CARTA::FileInfo& file_info) {
 }
 
 bool FileInfoLoader::GetHdf5HduList(CARTA::FileInfo& file_info, const std::string& filename) {
-    // fill FileInfo hdu list for Hdf5
+    // fill FileInfo hdu list for Hdf5; the HDF5 library is not thread-safe, and file lists probe files in parallel
+    static std::mutex hdf5_mutex;
+    std::scoped_lock lock(hdf5_mutex);
     casacore::HDF5File hdf_file(filename);
     std::vector<casacore::String> hdus(casacore::HDF5Group::linkNames(hdf_file));
     if (hdus.empty()) {
@@ -0,0 +1,156 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# FileListCache.cc: directory listings shared by all sessions
+
+#include "FileListCache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "../Logger/Logger.h"
+
+#ifdef __linux__
+#define FILE_LIST_CACHE_EVENTS                                                                                                  \
+    (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | \
+        IN_ONLYDIR)
+#endif
+
+const FileListCache::Entry* FileListCache::Listing::Find(const std::string& name, int64_t modify_time, int64_t size) const {
+    auto it = name_index.find(name);
+    if (it == name_index.end()) {
+        return nullptr;
+    }
+    const Entry& entry = entries[it->second];
+    return (entry.modify_time == modify_time && entry.size == size) ? &entry : nullptr;
+}
+
+FileListCache& FileListCache::GetInstance() {
+    static FileListCache cache;
+    return cache;
+}
+
+FileListCache::FileListCache() : _inotify_fd(-1), _use_count(0), _generation_count(0) {
+#ifdef __linux__
+    _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify_fd < 0) {
+        spdlog::debug("Directory listings are checked without inotify");
+    }
+#endif
+}
+
+FileListCache::~FileListCache() {
+    if (_inotify_fd >= 0) {
+        close(_inotify_fd);
+    }
+}
+
+bool FileListCache::FileStatus(const std::string& filename, int64_t& modify_time, int64_t& size) {
+    struct stat file_stat;
+    if (stat(filename.c_str(), &file_stat) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    modify_time = (int64_t)file_stat.st_mtimespec.tv_sec * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+    modify_time = (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+    size = file_stat.st_size;
+    return true;
+}
+
+std::shared_ptr<const FileListCache::Listing> FileListCache::Get(
+    const std::string& directory, bool region_list, bool& unchanged, uint64_t& generation) {
+    std::scoped_lock lock(_mutex);
+    ReadEvents();
+
+    auto& cached = _directories[directory];
+    cached.last_used = ++_use_count;
+#ifdef __linux__
+    // Watched before the directory is read, so that later changes are seen
+    if (cached.watch < 0 && _inotify_fd >= 0) {
+        cached.watch = inotify_add_watch(_inotify_fd, directory.c_str(), FILE_LIST_CACHE_EVENTS);
+        if (cached.watch >= 0) {
+            _watched_directories[cached.watch] = directory;
+        }
+        cached.generation = ++_generation_count;
+    }
+#endif
+
+    generation = cached.generation;
+    auto& listing = cached.listings[region_list];
+    unchanged = listing && cached.watch >= 0 && cached.listing_generations[region_list] == generation;
+    auto result = listing;
+    Evict();
+    return result;
+}
+
+void FileListCache::Put(const std::string& directory, bool region_list, std::shared_ptr<const Listing> listing, uint64_t generation) {
+    std::scoped_lock lock(_mutex);
+    auto it = _directories.find(directory);
+    if (it == _directories.end()) {
+        return;
+    }
+    it->second.listings[region_list] = listing;
+    it->second.listing_generations[region_list] = generation;
+}
+
+void FileListCache::ReadEvents() {
+#ifdef __linux__
+    if (_inotify_fd < 0) {
+        return;
+    }
+
+    // Events only mark their directory as changed; its entries are then checked on the next request
+    alignas(struct inotify_event) char buffer[16384];
+    ssize_t length;
+    while ((length = read(_inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto& [name, cached] : _directories) {
+                    cached.generation = ++_generation_count;
+                }
+                continue;
+            }
+            auto watched = _watched_directories.find(event->wd);
+            if (watched == _watched_directories.end()) {
+                continue;
+            }
+            auto& cached = _directories[watched->second];
+            cached.generation = ++_generation_count;
+            if (event->mask & IN_IGNORED) {
+                cached.watch = -1;
+                _watched_directories.erase(watched);
+            }
+        }
+    }
+#endif
+}
+
+void FileListCache::Evict() {
+    while (_directories.size() > FILE_LIST_CACHE_MAX_DIRECTORIES) {
+        auto oldest = _directories.begin();
+        for (auto it = _directories.begin(); it != _directories.end(); ++it) {
+            if (it->second.last_used < oldest->second.last_used) {
+                oldest = it;
+            }
+        }
+#ifdef __linux__
+        if (oldest->second.watch >= 0) {
+            inotify_rm_watch(_inotify_fd, oldest->second.watch);
+            _watched_directories.erase(oldest->second.watch);
+        }
+#endif
+        _directories.erase(oldest);
+    }
+}
@@ -0,0 +1,82 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# FileListCache.h: directory listings shared by all sessions
+
+#ifndef CARTA_BACKEND__FILELIST_FILELISTCACHE_H_
+#define CARTA_BACKEND__FILELIST_FILELISTCACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <carta-protobuf/file_info.pb.h>
+
+// Most directories with cached listings (and inotify watches)
+#define FILE_LIST_CACHE_MAX_DIRECTORIES 256
+
+// Listings of directories as image or region lists, so that an entry is only opened and typed again when its modification time or
+// size changes. On Linux each cached directory is watched with inotify, and a listing with no events since it was read is used
+// without reading the directory; elsewhere, or after an event, the entries are checked against their modification time and size.
+class FileListCache {
+public:
+    struct Entry {
+        std::string name;
+        int64_t modify_time; // nanoseconds
+        int64_t size;
+        bool subdirectory;
+        bool listed;
+        CARTA::FileInfo file_info;
+        std::string message; // for an image type which is not supported
+    };
+
+    struct Listing {
+        std::vector<Entry> entries;
+        std::unordered_map<std::string, size_t> name_index;
+
+        const Entry* Find(const std::string& name, int64_t modify_time, int64_t size) const;
+    };
+
+    static FileListCache& GetInstance();
+
+    // Returns the cached listing of a directory, or null. The listing is unchanged if the directory has not changed since it was
+    // read; the generation is passed back with a new listing, and is later than any change not seen by the new listing.
+    std::shared_ptr<const Listing> Get(const std::string& directory, bool region_list, bool& unchanged, uint64_t& generation);
+    void Put(const std::string& directory, bool region_list, std::shared_ptr<const Listing> listing, uint64_t generation);
+
+    // Modification time in nanoseconds and size of a file, following links
+    static bool FileStatus(const std::string& filename, int64_t& modify_time, int64_t& size);
+
+    FileListCache(const FileListCache&) = delete;
+    FileListCache& operator=(const FileListCache&) = delete;
+
+private:
+    FileListCache();
+    ~FileListCache();
+
+    struct Directory {
+        int watch = -1;
+        uint64_t generation = 0;
+        uint64_t last_used = 0;
+        std::shared_ptr<const Listing> listings[2];
+        uint64_t listing_generations[2] = {0, 0};
+    };
+
+    void ReadEvents();
+    void Evict();
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Directory> _directories;
+    std::unordered_map<int, std::string> _watched_directories;
+    int _inotify_fd;
+    uint64_t _use_count;
+    uint64_t _generation_count; // generations increase across directories, so that a listing read before eviction is not current
+};
+
+#endif // CARTA_BACKEND__FILELIST_FILELISTCACHE_H_
@@ -110,123 +110,74 @@ void FileListHandler::GetFileList(CARTA::FileListResponse& file_list, std::strin
             return;
         }
 
+        // Listing shared by all sessions, used without reading the directory if it has not changed
+        auto& listing_cache = FileListCache::GetInstance();
+        bool unchanged(false);
+        uint64_t generation(0);
+        auto cached_listing = listing_cache.Get(requested_folder, region_list, unchanged, generation);
+        if (unchanged) {
+            for (auto& entry : cached_listing->entries) {
+                AddListEntry(entry, file_list, result_msg);
+            }
+            file_list.set_success(true);
+            return;
+        }
+        auto listing = std::make_shared<FileListCache::Listing>();
+
         // Iterate through directory to generate file list
         casacore::Directory start_dir(folder_path);
         casacore::DirectoryIterator dir_iter(start_dir);
 
         // initialize variables for the progress report and the interruption option
-        _stop_getting_file_list = false;
+        auto cancel_token = _file_list_cancellation.Replace();
         _first_report_made = false;
         ListProgressReporter progress_reporter(start_dir.nEntries(), _progress_callback);
 
-        while (!dir_iter.pastEnd()) {
-            if (_stop_getting_file_list) {
-                file_list.set_cancel(true);
-                break;
+        std::vector<casacore::File> batch;
+        while (!dir_iter.pastEnd() && !file_list.cancel()) {
+            // Entries are probed in parallel, then added in directory order
+            batch.clear();
+            for (; !dir_iter.pastEnd() && batch.size() < FILE_LIST_PROBE_BATCH; dir_iter++) {
+                batch.push_back(dir_iter.file()); // directory is also a File
+            }
+            std::vector<ListProbe> probes(batch.size());
+#pragma omp parallel for num_threads(FILE_LIST_PROBE_THREADS) schedule(dynamic)
+            for (int64_t i = 0; i < (int64_t)batch.size(); i++) {
+                if (!cancel_token.IsCancelled()) {
+                    ProbeListEntry(batch[i], cached_listing.get(), region_list, probes[i]);
+                }
             }
 
-            casacore::File cc_file(dir_iter.file());          // directory is also a File
-            casacore::String name(cc_file.path().baseName()); // to keep link name before resolve
-
-            if (cc_file.isReadable() && cc_file.exists() && name.firstchar() != '.') { // ignore hidden files/folders
-                casacore::String full_path(cc_file.path().absoluteName());
-
-                try {
-                    bool is_region_file(false);
-
-                    if (region_list && cc_file.isRegular(true)) {
-                        CARTA::FileType file_type(GetRegionType(full_path)); // CRTF, DS9, or UNKNOWN
-
-                        if (file_type != CARTA::FileType::UNKNOWN) {
-                            auto& file_info = *file_list.add_files();
-                            FillRegionFileInfo(file_info, full_path, file_type);
-                            is_region_file = true; // Done with file
-                        }
-                    }
+            for (auto& probe : probes) {
+                if (cancel_token.IsCancelled()) {
+                    file_list.set_cancel(true);
+                    break;
+                }
 
-                    if (!is_region_file) {
-                        // Whether to add to file list
-                        bool add_file(false);
-                        CARTA::FileType file_type(CARTA::FileType::UNKNOWN);
-
-                        if (cc_file.isDirectory(true) && cc_file.isExecutable()) {
-                            // Determine if image or directory
-                            auto image_type = CasacoreImageType(full_path);
-                            switch (image_type) {
-                                case casacore::ImageOpener::AIPSPP:
-                                case casacore::ImageOpener::IMAGECONCAT:
-                                case casacore::ImageOpener::IMAGEEXPR:
-                                case casacore::ImageOpener::COMPLISTIMAGE: {
-                                    file_type = CARTA::FileType::CASA;
-                                    add_file = true;
-                                    break;
-                                }
-                                case casacore::ImageOpener::GIPSY:
-                                case casacore::ImageOpener::CAIPS:
-                                case casacore::ImageOpener::NEWSTAR: {
-                                    std::string image_type_msg = fmt::format("{}: image type not supported", name);
-                                    result_msg = {image_type_msg, {"file_list"}, CARTA::ErrorSeverity::DEBUG};
-                                    break;
-                                }
-                                case casacore::ImageOpener::MIRIAD: {
-                                    file_type = CARTA::FileType::MIRIAD;
-                                    add_file = true;
-                                    break;
-                                }
-                                case casacore::ImageOpener::UNKNOWN: {
-                                    // UNKNOWN directories are directories
-                                    casacore::String dir_name(cc_file.path().baseName());
-                                    file_list.add_subdirectories(dir_name);
-                                    break;
-                                }
-                                default:
-                                    break;
-                            }
-                        } else if (cc_file.isRegular(true)) {
-                            // Determine if FITS gz/bz, FITS, or HDF5 file
-                            if (IsCompressedFits(full_path)) { // checks magic number and extension
-                                file_type = CARTA::FileType::FITS;
-                                add_file = true;
-                            } else {
-                                auto magic_number = GetMagicNumber(full_path);
-                                if (magic_number == FITS_MAGIC_NUMBER) {
-                                    file_type = CARTA::FileType::FITS;
-                                    add_file = true;
-                                } else if (magic_number == HDF5_MAGIC_NUMBER) {
-                                    file_type = CARTA::FileType::HDF5;
-                                    add_file = true;
-                                } else if (region_list) {
-                                    // List all regular files in region list
-                                    add_file = true;
-                                }
-                            }
-                        }
-
-                        if (add_file) { // add to file list: name, type, size, date
-                            auto& file_info = *file_list.add_files();
-                            file_info.set_name(name);
-                            FileInfoLoader info_loader = FileInfoLoader(full_path, file_type);
-                            info_loader.FillFileInfo(file_info);
-                        }
+                if (probe.add) {
+                    AddListEntry(probe.entry, file_list, result_msg);
+                    if (probe.cache) {
+                        listing->name_index[probe.entry.name] = listing->entries.size();
+                        listing->entries.push_back(std::move(probe.entry));
                     }
-                } catch (casacore::AipsError& err) { // RegularFileIO error
-                    // skip it
                 }
-            }
 
-            dir_iter++;
+                // update the progress and get the difference between the current time and start time
+                auto dt = progress_reporter.UpdateProgress();
 
-            // update the progress and get the difference between the current time and start time
-            auto dt = progress_reporter.UpdateProgress();
-
-            // report the progress if it fits the conditions
-            if (!_first_report_made && dt > FILE_LIST_FIRST_PROGRESS_AFTER_SECS) {
-                progress_reporter.ReportFileListProgress(CARTA::FileListType::Image);
-                _first_report_made = true;
-            } else if (_first_report_made && dt > FILE_LIST_PROGRESS_INTERVAL_SECS) {
-                progress_reporter.ReportFileListProgress(CARTA::FileListType::Image);
+                // report the progress if it fits the conditions
+                if (!_first_report_made && dt > FILE_LIST_FIRST_PROGRESS_AFTER_SECS) {
+                    progress_reporter.ReportFileListProgress(CARTA::FileListType::Image);
+                    _first_report_made = true;
+                } else if (_first_report_made && dt > FILE_LIST_PROGRESS_INTERVAL_SECS) {
+                    progress_reporter.ReportFileListProgress(CARTA::FileListType::Image);
+                }
             }
         }
+
+        if (!file_list.cancel()) {
+            listing_cache.Put(requested_folder, region_list, listing, generation);
+        }
     } catch (casacore::AipsError& err) {
         result_msg = {err.getMesg(), {"file-list"}, CARTA::ErrorSeverity::ERROR};
         file_list.set_success(false);
@@ -237,6 +188,137 @@ void FileListHandler::GetFileList(CARTA::FileListResponse& file_list, std::strin
     file_list.set_success(true);
 }
 
+void FileListHandler::ProbeListEntry(
+    const casacore::File& cc_file, const FileListCache::Listing* cached_listing, bool region_list, ListProbe& probe) {
+    // Called from parallel workers for the entries of a directory
+    probe.add = false;
+    probe.cache = false;
+    try {
+        casacore::String name(cc_file.path().baseName()); // to keep link name before resolve
+        if (!cc_file.isReadable() || !cc_file.exists() || name.firstchar() == '.') { // ignore hidden files/folders
+            return;
+        }
+        casacore::String full_path(cc_file.path().absoluteName());
+
+        // Entries are typed again only if their modification time or size has changed
+        auto& entry = probe.entry;
+        const FileListCache::Entry* cached_entry(nullptr);
+        bool has_status = FileListCache::FileStatus(full_path, entry.modify_time, entry.size);
+        if (has_status && cached_listing) {
+            cached_entry = cached_listing->Find(name, entry.modify_time, entry.size);
+        }
+
+        if (cached_entry) {
+            entry = *cached_entry;
+            probe.add = true;
+            probe.cache = true;
+        } else if (GetListEntry(cc_file, name, full_path, region_list, entry)) {
+            probe.add = true;
+            probe.cache = has_status;
+        }
+    } catch (casacore::AipsError& err) {
+        // skip it
+        probe.add = false;
+    }
+}
+
+bool FileListHandler::GetListEntry(
+    const casacore::File& cc_file, const std::string& name, const std::string& full_path, bool region_list, FileListCache::Entry& entry) {
+    // Determine how an entry is listed; false if it could not be read
+    entry.name = name;
+    entry.subdirectory = false;
+    entry.listed = false;
+    try {
+        if (region_list && cc_file.isRegular(true)) {
+            CARTA::FileType file_type(GetRegionType(full_path)); // CRTF, DS9, or UNKNOWN
+
+            if (file_type != CARTA::FileType::UNKNOWN) {
+                FillRegionFileInfo(entry.file_info, full_path, file_type);
+                entry.listed = true; // Done with file
+                return true;
+            }
+        }
+
+        // Whether to add to file list
+        bool add_file(false);
+        CARTA::FileType file_type(CARTA::FileType::UNKNOWN);
+
+        if (cc_file.isDirectory(true) && cc_file.isExecutable()) {
+            // Determine if image or directory
+            auto image_type = CasacoreImageType(full_path);
+            switch (image_type) {
+                case casacore::ImageOpener::AIPSPP:
+                case casacore::ImageOpener::IMAGECONCAT:
+                case casacore::ImageOpener::IMAGEEXPR:
+                case casacore::ImageOpener::COMPLISTIMAGE: {
+                    file_type = CARTA::FileType::CASA;
+                    add_file = true;
+                    break;
+                }
+                case casacore::ImageOpener::GIPSY:
+                case casacore::ImageOpener::CAIPS:
+                case casacore::ImageOpener::NEWSTAR: {
+                    entry.message = fmt::format("{}: image type not supported", name);
+                    break;
+                }
+                case casacore::ImageOpener::MIRIAD: {
+                    file_type = CARTA::FileType::MIRIAD;
+                    add_file = true;
+                    break;
+                }
+                case casacore::ImageOpener::UNKNOWN: {
+                    // UNKNOWN directories are directories
+                    entry.subdirectory = true;
+                    break;
+                }
+                default:
+                    break;
+            }
+        } else if (cc_file.isRegular(true)) {
+            // Determine if FITS gz/bz, FITS, or HDF5 file
+            if (IsCompressedFits(full_path)) { // checks magic number and extension
+                file_type = CARTA::FileType::FITS;
+                add_file = true;
+            } else {
+                auto magic_number = GetMagicNumber(full_path);
+                if (magic_number == FITS_MAGIC_NUMBER) {
+                    file_type = CARTA::FileType::FITS;
+                    add_file = true;
+                } else if (magic_number == HDF5_MAGIC_NUMBER) {
+                    file_type = CARTA::FileType::HDF5;
+                    add_file = true;
+                } else if (region_list) {
+                    // List all regular files in region list
+                    add_file = true;
+                }
+            }
+        }
+
+        if (add_file) { // add to file list: name, type, size, date
+            entry.file_info.set_name(name);
+            FileInfoLoader info_loader = FileInfoLoader(full_path, file_type);
+            info_loader.FillFileInfo(entry.file_info);
+            entry.listed = true;
+        }
+    } catch (casacore::AipsError& err) { // RegularFileIO error
+        // skip it
+        return false;
+    }
+    return true;
+}
+
+void FileListHandler::AddListEntry(const FileListCache::Entry& entry, CARTA::FileListResponse& file_list, ResultMsg& result_msg) {
+    if (entry.subdirectory) {
+        file_list.add_subdirectories(entry.name);
+    }
+    if (entry.listed) {
+        *file_list.add_files() = entry.file_info;
+    }
+    if (!entry.message.empty()) {
+        result_msg = {entry.message, {"file_list"}, CARTA::ErrorSeverity::DEBUG};
+    }
+}
+
 void FileListHandler::OnRegionListRequest(
     const CARTA::RegionListRequest& region_request, CARTA::RegionListResponse& region_response, ResultMsg& result_msg) {
     // use tbb scoped lock so that it only processes the file list a time for one user
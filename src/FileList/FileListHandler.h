@@ -14,12 +14,15 @@
 #include <unordered_map>
 
 #include <casacore/casa/aips.h>
+#include <casacore/casa/OS/File.h>
 
 #include <carta-protobuf/file_list.pb.h>
 #include <carta-protobuf/region_file_info.pb.h>
 #include <carta-protobuf/region_list.pb.h>
 
+#include "../Cancellation.h"
 #include "../Util.h"
+#include "FileListCache.h"
 
 class FileListHandler {
 public:
@@ -39,7 +42,7 @@ public:
         const CARTA::RegionFileInfoRequest& request, CARTA::RegionFileInfoResponse& response, ResultMsg& result_msg);
 
     void StopGettingFileList() {
-        _stop_getting_file_list = true;
+        _file_list_cancellation.CancelCurrent();
     }
     void SetProgressCallback(const std::function<void(CARTA::ListProgress)>& progress_callback) {
         _progress_callback = progress_callback;
@@ -49,6 +52,17 @@ private:
     // ICD: File/Region list response
     void GetFileList(CARTA::FileListResponse& file_list, std::string folder, ResultMsg& result_msg, bool region_list = false);
 
+    // Type and file info of a directory entry, and adding it to a response
+    struct ListProbe {
+        FileListCache::Entry entry;
+        bool add;
+        bool cache;
+    };
+    void ProbeListEntry(const casacore::File& cc_file, const FileListCache::Listing* cached_listing, bool region_list, ListProbe& probe);
+    bool GetListEntry(const casacore::File& cc_file, const std::string& name, const std::string& full_path, bool region_list,
+        FileListCache::Entry& entry);
+    void AddListEntry(const FileListCache::Entry& entry, CARTA::FileListResponse& file_list, ResultMsg& result_msg);
+
     bool FillRegionFileInfo(CARTA::FileInfo& file_info, const string& filename, CARTA::FileType type = CARTA::FileType::UNKNOWN);
     void GetRegionFileContents(std::string& full_name, std::vector<std::string>& file_contents);
     void GetRelativePath(std::string& folder);
@@ -61,7 +75,7 @@ private:
     std::string _regionlist_folder;
     std::string _top_level_folder, _starting_folder;
 
-    volatile bool _stop_getting_file_list;
+    carta::CancellationSlot _file_list_cancellation;
     volatile bool _first_report_made;
     std::function<void(CARTA::ListProgress)> _progress_callback;
 };
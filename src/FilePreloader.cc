@@ -0,0 +1,158 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "FilePreloader.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <casacore/measures/Measures/MCDirection.h>
+#include <casacore/measures/Measures/MCFrequency.h>
+#include <casacore/measures/Measures/MeasTable.h>
+
+#include "FileList/FileExtInfoCache.h"
+#include "FileList/FileExtInfoLoader.h"
+#include "FileList/FileInfoLoader.h"
+#include "FileList/FileListCache.h"
+#include "FileList/FitsHduList.h"
+#include "Frame.h"
+#include "Logger/Logger.h"
+#include "Util.h"
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+namespace carta {
+
+// Never destroyed, since the preload threads are detached and may still run at exit
+static std::mutex& PreloadedMutex() {
+    static auto* mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::unordered_map<std::string, std::unique_ptr<FileLoader>>& PreloadedLoaders() {
+    static auto* loaders = new std::unordered_map<std::string, std::unique_ptr<FileLoader>>();
+    return *loaders;
+}
+
+void FilePreloader::Start(const std::string& top_level_folder, const std::vector<std::string>& files) {
+    std::thread(&FilePreloader::WarmUpMeasures).detach();
+    for (const auto& file : files) {
+        std::string full_name = (fs::path(top_level_folder) / file).lexically_normal().string();
+        std::string filename = fs::path(file).filename().string();
+        std::thread(&FilePreloader::PreloadFile, full_name, filename).detach();
+    }
+}
+
+FileLoader* FilePreloader::TakeLoader(const std::string& loader_file_key) {
+    if (loader_file_key.empty()) {
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lock(PreloadedMutex());
+    auto& loaders = PreloadedLoaders();
+    auto it = loaders.find(loader_file_key);
+    if (it == loaders.end()) {
+        return nullptr;
+    }
+    FileLoader* loader = it->second.release();
+    loaders.erase(it);
+    spdlog::debug("Using the preloaded loader of {}", loader_file_key);
+    return loader;
+}
+
+void FilePreloader::WarmUpMeasures() {
+    // The first conversions read the leap second, observatory and IERS tables; spectral and direction conversions of the first
+    // image would otherwise wait for them
+    auto t_start = std::chrono::high_resolution_clock::now();
+    try {
+        casacore::MEpoch epoch(casacore::Quantity(59000.0, "d"), casacore::MEpoch::UTC);
+        casacore::MPosition position;
+        casacore::MeasTable::Observatory(position, "ALMA");
+        casacore::MDirection direction(casacore::Quantity(0.0, "deg"), casacore::Quantity(-30.0, "deg"), casacore::MDirection::J2000);
+        casacore::MeasFrame frame(epoch, position, direction);
+        casacore::MDirection::Convert(direction, casacore::MDirection::Ref(casacore::MDirection::GALACTIC))();
+        casacore::MDirection::Convert(direction, casacore::MDirection::Ref(casacore::MDirection::AZEL, frame))();
+        casacore::MFrequency frequency(casacore::Quantity(1.0e9, "Hz"), casacore::MFrequency::Ref(casacore::MFrequency::TOPO, frame));
+        casacore::MFrequency::Convert(frequency, casacore::MFrequency::Ref(casacore::MFrequency::LSRK, frame))();
+    } catch (const casacore::AipsError& err) {
+        spdlog::debug("Measures warm-up failed: {}", err.getMesg());
+        return;
+    }
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t_start).count();
+    spdlog::performance("Warm up measures tables in {:.3f} ms", dt * 1e-3);
+}
+
+void FilePreloader::PreloadFile(const std::string& full_name, const std::string& filename) {
+    auto t_start = std::chrono::high_resolution_clock::now();
+    try {
+        CARTA::FileInfo file_info;
+        if (!FileInfoLoader(full_name).FillFileInfo(file_info)) {
+            return;
+        }
+
+        // The HDU a session opens by default, as in the file info of the file browser
+        int64_t modify_time(0), size(0);
+        bool has_status = FileListCache::FileStatus(full_name, modify_time, size);
+        auto& ext_info_cache = FileExtInfoCache::GetInstance();
+        std::string message, hdu;
+        if (file_info.type() == CARTA::FileType::FITS) {
+            std::vector<std::string> hdu_list;
+            FitsHduList(full_name).GetHduList(hdu_list, message);
+            if (hdu_list.empty()) {
+                return;
+            }
+            if (has_status) {
+                ext_info_cache.PutHduList(full_name, modify_time, size, hdu_list);
+            }
+            std::vector<std::string> hdunum_extname;
+            SplitString(hdu_list[0], ':', hdunum_extname);
+            hdu = hdunum_extname.empty() ? "" : hdunum_extname[0];
+        } else if (file_info.hdu_list_size() > 0) {
+            hdu = file_info.hdu_list(0);
+        }
+
+        // Header: extended info from the loader a session will take
+        std::unique_ptr<FileLoader> loader(FileLoader::GetLoader(full_name));
+        if (!loader) {
+            return;
+        }
+        CARTA::FileInfoExtended file_info_ext;
+        if (!FileExtInfoLoader(loader.get()).FillFileExtInfo(file_info_ext, filename, hdu, message)) {
+            spdlog::debug("Preloading {} failed: {}", full_name, message);
+            return;
+        }
+        if (has_status) {
+            ext_info_cache.PutExtInfo(full_name, hdu, modify_time, size, file_info_ext);
+        }
+
+        // First channel and its statistics, through a frame with its own loader
+        Frame frame(0, FileLoader::GetLoader(full_name), hdu);
+        if (frame.IsValid()) {
+            BasicStats<float> stats;
+            frame.GetBasicStats(frame.CurrentZ(), frame.CurrentStokes(), stats);
+        }
+
+        if (has_status) {
+            std::unique_lock<std::mutex> lock(PreloadedMutex());
+            PreloadedLoaders()[fmt::format("{}:{}:{}", full_name, modify_time, size)] = std::move(loader);
+        }
+    } catch (const casacore::AipsError& err) {
+        spdlog::debug("Preloading {} failed: {}", full_name, err.getMesg());
+        return;
+    }
+    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t_start).count();
+    spdlog::info("Preloaded {} in {:.3f} ms", filename, dt * 1e-3);
+}
+
+} // namespace carta
@@ -0,0 +1,38 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# FilePreloader.h: warm-up at startup of casacore measures tables and of the files given on the command line
+
+#ifndef CARTA_BACKEND__FILEPRELOADER_H_
+#define CARTA_BACKEND__FILEPRELOADER_H_
+
+#include <string>
+#include <vector>
+
+#include "ImageData/FileLoader.h"
+
+namespace carta {
+
+// The files are opened in parallel before the first session connects: their file info and extended info go to the caches shared by
+// all sessions, and a frame reads the first channel into the shared plane cache and its statistics (kept by the stats sidecar if
+// there is a cache folder). The loader of each file is then kept, with its image and coordinates set up, for the session which opens
+// that version of the file first.
+class FilePreloader {
+public:
+    // Starts the background threads; files are relative to the top-level folder
+    static void Start(const std::string& top_level_folder, const std::vector<std::string>& files);
+
+    // Preloaded loader for a "<full name>:<modify time>:<size>" key, or nullptr; each loader is taken once
+    static FileLoader* TakeLoader(const std::string& loader_file_key);
+
+private:
+    static void WarmUpMeasures();
+    static void PreloadFile(const std::string& full_name, const std::string& filename);
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__FILEPRELOADER_H_
@@ -7,24 +7,38 @@
 #include "Frame.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <thread>
 
+#include <casacore/images/Images/ImageFITSConverter.h>
+#include <casacore/images/Images/PagedImage.h>
 #include <casacore/images/Images/SubImage.h>
 #include <casacore/images/Regions/WCBox.h>
 #include <casacore/images/Regions/WCRegion.h>
 #include <casacore/lattices/LRegions/LCExtension.h>
 #include <casacore/lattices/LRegions/LCSlicer.h>
 #include <casacore/lattices/LRegions/LattRegionHolder.h>
+#include <casacore/lattices/Lattices/LatticeStepper.h>
 #include <casacore/tables/DataMan/TiledFileAccess.h>
+#include <tbb/pipeline.h>
 
 #include "DataStream/Compression.h"
 #include "DataStream/Contouring.h"
 #include "DataStream/Smoothing.h"
+#include "GpuCompute.h"
+#include "GrpcServer/WorkerPool.h"
+#include "ImageData/ComputedStokes.h"
 #include "ImageStats/StatsCalculator.h"
 #include "Logger/Logger.h"
+#include "Metrics.h"
+#include "Threading.h"
+#include "Timer/LatencyHistogram.h"
+#include "Timer/SlowRequestLog.h"
+#include "Timer/TraceEvents.h"
 #include "Util.h"
 
 #ifdef _BOOST_FILESYSTEM_
@@ -37,8 +51,18 @@ namespace fs = std::filesystem;
 
 static const int HIGH_COMPRESSION_QUALITY(32);
 
+// Maximum number of pixels read at a time when downsampling in lazy tile mode
+static const int64_t LAZY_TILE_READ_PIXELS(16 * 1024 * 1024);
+// Images wider or higher than 4096 tiles of 256 pixels, which need 64-bit tile keys, always read tiles on demand
+static const int64_t LAZY_TILE_MIN_SIZE(4096 * 256);
+// Maximum number of pixels decoded at a time when downsampling in compact cache mode
+static const int64_t COMPACT_DECODE_PIXELS(1024 * 1024);
+
 using namespace carta;
 
+int64_t Frame::_lazy_tile_threshold = -1;
+int64_t Frame::_compact_cache_threshold = -1;
+
 Frame::Frame(uint32_t session_id, carta::FileLoader* loader, const std::string& hdu, int default_z)
     : _session_id(session_id),
       _valid(true),
@@ -51,7 +75,26 @@ Frame::Frame(uint32_t session_id, carta::FileLoader* loader, const std::string&
       _stokes_index(DEFAULT_STOKES),
       _depth(1),
       _num_stokes(1),
-      _moment_generator(nullptr) {
+      _contour_cache(CONTOUR_CACHE_MAX_ENTRIES, (size_t)CONTOUR_CACHE_MB * 1024 * 1024),
+      _lazy_tiles(false),
+      _compact_cache(false),
+      _tile_cache(TILE_CACHE_SIZE_MB * 1024 * 1024),
+      _tile_request_id(0),
+      _prefetch_stokes(DEFAULT_STOKES),
+      _max_prefetch_planes(0),
+      _stop_prefetch(false),
+      _moment_generator(nullptr),
+      _hdu(hdu),
+      _remote_jobs(true) {
+    carta::Metrics::Global().AddOpenFrames(1);
+    _contour_cache.SetSessionId(session_id);
+    _smoothed_plane_cache.SetSessionId(session_id);
+    _tile_cache.SetSessionId(session_id);
+
+    if (_loader) {
+        _loader->IoStats().SetSessionId(session_id);
+    }
+
     if (!_loader) {
         _open_image_error = fmt::format("Problem loading image: image type not supported.");
         spdlog::error("Session {}: {}", session_id, _open_image_error);
@@ -89,6 +132,23 @@ Frame::Frame(uint32_t session_id, carta::FileLoader* loader, const std::string&
     _depth = (_z_axis >= 0 ? _image_shape(_z_axis) : 1);
     _num_stokes = (_stokes_axis >= 0 ? _image_shape(_stokes_axis) : 1);
 
+    size_t plane_size_mb = (sizeof(float) * _width * _height) / (1024 * 1024);
+    _max_prefetch_planes = std::min((size_t)ANIMATION_PREFETCH_CHANNELS, ANIMATION_PREFETCH_MAX_MB / std::max(plane_size_mb, (size_t)1));
+
+    _lazy_tiles = ((_lazy_tile_threshold > 0) && ((int64_t)_width * _height > _lazy_tile_threshold)) ||
+                  ((int64_t)std::max(_width, _height) > LAZY_TILE_MIN_SIZE);
+    _compact_cache = !_lazy_tiles && (_compact_cache_threshold > 0) && ((int64_t)_width * _height > _compact_cache_threshold);
+
+    // Frames of the same file share their image planes; in-memory images have no file name
+    if (!_loader->GetFileName().empty()) {
+        _plane_cache_key = fmt::format("{}:{}", _loader->GetFileName(), hdu);
+    }
+    if (_lazy_tiles) {
+        spdlog::info("Session {}: {}x{} image exceeds lazy tile threshold, reading tiles on demand.", session_id, _width, _height);
+    } else if (_compact_cache) {
+        spdlog::info("Session {}: {}x{} image exceeds compact cache threshold, caching 16-bit channel data.", session_id, _width, _height);
+    }
+
     if (!FillImageCache()) {
         _open_image_error = fmt::format("Cannot load image data. Check log.");
         _valid = false;
@@ -111,6 +171,27 @@ Frame::Frame(uint32_t session_id, carta::FileLoader* loader, const std::string&
         _open_image_error = fmt::format("Problem loading statistics from file: {}", err.getMesg());
         spdlog::warn("Session {}: {}", session_id, _open_image_error);
     }
+
+    // Cached channel stats and spectral-major copy of the cube, if enabled and the file has no precomputed data
+    _loader->LoadStatsSidecar(hdu, AutoBinSize());
+    _loader->StartSpectralSidecar(hdu, _image_mutex);
+}
+
+Frame::~Frame() {
+    carta::Metrics::Global().AddOpenFrames(-1);
+    {
+        std::unique_lock<std::mutex> lock(_prefetch_mutex);
+        _stop_prefetch = true;
+        _prefetch_queue.clear();
+    }
+    _prefetch_cv.notify_all();
+    if (_prefetch_thread.joinable()) {
+        _prefetch_thread.join();
+    }
+
+    if (_loader) {
+        _loader->StopSpectralSidecar();
+    }
 }
 
 bool Frame::IsValid() {
@@ -125,7 +206,7 @@ casacore::CoordinateSystem* Frame::CoordinateSystem() {
     // Returns pointer to CoordinateSystem clone; caller must delete
     casacore::CoordinateSystem* csys(nullptr);
     if (IsValid()) {
-        std::lock_guard<std::mutex> guard(_image_mutex);
+        auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
         casacore::CoordinateSystem image_csys;
         _loader->GetCoordinateSystem(image_csys);
         csys = static_cast<casacore::CoordinateSystem*>(image_csys.clone());
@@ -141,6 +222,14 @@ casacore::IPosition Frame::ImageShape() {
     return ipos;
 }
 
+size_t Frame::Width() {
+    return _width;
+}
+
+size_t Frame::Height() {
+    return _height;
+}
+
 size_t Frame::Depth() {
     return _depth;
 }
@@ -212,11 +301,29 @@ casacore::Slicer Frame::GetImageSlicer(const AxisRange& z_range, int stokes) {
     return section;
 }
 
+casacore::Slicer Frame::GetImageSlicer(const AxisRange& x_range, const AxisRange& y_range, const AxisRange& z_range, int stokes) {
+    // Slicer to apply x, y, z range and stokes to image shape
+    casacore::Slicer z_stokes_section = GetImageSlicer(z_range, stokes);
+    casacore::IPosition start(z_stokes_section.start());
+    casacore::IPosition end(z_stokes_section.end());
+
+    start(_x_axis) = x_range.from;
+    end(_x_axis) = (x_range.to == ALL_Z ? _width - 1 : x_range.to);
+    start(_y_axis) = y_range.from;
+    end(_y_axis) = (y_range.to == ALL_Z ? _height - 1 : y_range.to);
+
+    casacore::Slicer section(start, end, casacore::Slicer::endIsLast);
+    return section;
+}
+
 bool Frame::CheckZ(int z) {
     return ((z >= 0) && (z < Depth()));
 }
 
 bool Frame::CheckStokes(int stokes) {
+    if (carta::IsComputedStokes(stokes)) {
+        return _loader->HasComputedStokes(stokes);
+    }
     return ((stokes >= 0) && (stokes < NumStokes()));
 }
 
@@ -225,15 +332,12 @@ bool Frame::ZStokesChanged(int z, int stokes) {
 }
 
 void Frame::WaitForTaskCancellation() {
-    _connected = false;      // file closed
-    if (_moment_generator) { // stop moment calculation
-        _moment_generator->StopCalculation();
-    }
+    _cancel_token.Cancel(); // file closed; also stops contour and moment calculations
     std::unique_lock lock(GetActiveTaskMutex());
 }
 
 bool Frame::IsConnected() {
-    return _connected; // whether file is to be closed
+    return !_cancel_token.IsCancelled(); // whether file is to be closed
 }
 
 // ********************************************************************
@@ -251,6 +355,9 @@ bool Frame::SetImageChannels(int new_z, int new_stokes, std::string& message) {
             if (z_ok && stokes_ok) {
                 _z_index = new_z;
                 _stokes_index = new_stokes;
+                _tile_request_id++;
+                _tile_cache.Reset();
+                _smoothed_plane_cache.Reset();
                 FillImageCache();
                 updated = true;
             } else {
@@ -261,6 +368,113 @@ bool Frame::SetImageChannels(int new_z, int new_stokes, std::string& message) {
     return updated;
 }
 
+void Frame::PrefetchChannels(const std::vector<int>& channels, int stokes) {
+    if (!_valid || _lazy_tiles || (_max_prefetch_planes <= 0 && !channels.empty())) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_prefetch_mutex);
+    if (_stop_prefetch) {
+        return;
+    }
+
+    // Replace the pending requests and drop buffered planes which are no longer wanted
+    _prefetch_queue.clear();
+    _prefetch_stokes = stokes;
+    std::unordered_map<int, std::vector<float>> wanted_planes;
+    for (auto z : channels) {
+        if (_prefetch_queue.size() + wanted_planes.size() >= _max_prefetch_planes) {
+            break;
+        }
+        if (!CheckZ(z) || !CheckStokes(stokes) || (z == _z_index && stokes == _stokes_index)) {
+            continue;
+        }
+        auto key = CacheKey(z, stokes);
+        if (_prefetched_planes.count(key)) {
+            wanted_planes[key] = std::move(_prefetched_planes[key]);
+        } else {
+            _prefetch_queue.push_back(z);
+        }
+    }
+    _prefetched_planes.swap(wanted_planes);
+
+    if (!_prefetch_queue.empty() && !_prefetch_thread.joinable()) {
+        _prefetch_thread = std::thread(&Frame::RunPrefetch, this);
+    }
+    lock.unlock();
+    _prefetch_cv.notify_one();
+}
+
+void Frame::RunPrefetch() {
+    std::unique_lock<std::mutex> lock(_prefetch_mutex);
+    while (!_stop_prefetch) {
+        _prefetch_cv.wait(lock, [&]() { return _stop_prefetch || !_prefetch_queue.empty(); });
+        if (_stop_prefetch) {
+            break;
+        }
+
+        int z = _prefetch_queue.front();
+        int stokes = _prefetch_stokes;
+        _prefetch_queue.pop_front();
+        lock.unlock();
+
+        auto t_start_prefetch = std::chrono::high_resolution_clock::now();
+        std::vector<float> plane;
+        GetZMatrix(plane, z, stokes);
+        auto t_end_prefetch = std::chrono::high_resolution_clock::now();
+        auto dt_prefetch = std::chrono::duration_cast<std::chrono::microseconds>(t_end_prefetch - t_start_prefetch).count();
+        spdlog::performance("Prefetch channel {} in {:.3f} ms", z, dt_prefetch * 1e-3);
+
+        lock.lock();
+        // Only keep the plane if it is still wanted
+        if (!plane.empty() && stokes == _prefetch_stokes && _prefetched_planes.size() < _max_prefetch_planes) {
+            // Contour the channel too, so that both are ready when it is shown
+            ContourSettings contour_settings = _contour_settings;
+            std::vector<float> contour_plane;
+            if (!contour_settings.levels.empty() && !_contour_cache.Contains(z, stokes, contour_settings)) {
+                contour_plane = plane;
+            }
+            _prefetched_planes[CacheKey(z, stokes)] = std::move(plane);
+
+            if (!contour_plane.empty()) {
+                lock.unlock();
+                PrefetchContours(z, stokes, contour_plane, contour_settings);
+                lock.lock();
+            }
+        }
+    }
+}
+
+void Frame::PrefetchContours(int z, int stokes, const std::vector<float>& plane, const ContourSettings& settings) {
+    auto t_start_contours = std::chrono::high_resolution_clock::now();
+    std::vector<CARTA::ContourImageData> messages;
+    std::mutex messages_mutex;
+    auto callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int>& indices) {
+        CARTA::ContourImageData message;
+        FillContourData(message, z, stokes, level, progress, vertices, indices, settings);
+        std::unique_lock<std::mutex> lock(messages_mutex);
+        messages.push_back(std::move(message));
+    };
+
+    if (ContourPlane(plane.data(), settings, callback, nullptr, _cancel_token) && !_cancel_token.IsCancelled()) {
+        _contour_cache.Put(z, stokes, settings, std::move(messages));
+        auto t_end_contours = std::chrono::high_resolution_clock::now();
+        auto dt_contours = std::chrono::duration_cast<std::chrono::microseconds>(t_end_contours - t_start_contours).count();
+        spdlog::performance("Prefetch contours of channel {} in {:.3f} ms", z, dt_contours * 1e-3);
+    }
+}
+
+bool Frame::TakePrefetchedPlane(int z, int stokes, std::vector<float>& plane) {
+    std::unique_lock<std::mutex> lock(_prefetch_mutex);
+    auto it = _prefetched_planes.find(CacheKey(z, stokes));
+    if (it == _prefetched_planes.end()) {
+        return false;
+    }
+    plane.swap(it->second);
+    _prefetched_planes.erase(it);
+    return true;
+}
+
 bool Frame::SetCursor(float x, float y) {
     bool changed = ((x != _cursor.x) || (y != _cursor.y));
     _cursor = PointXy(x, y);
@@ -268,25 +482,109 @@ bool Frame::SetCursor(float x, float y) {
 }
 
 bool Frame::FillImageCache() {
-    // get image data for z, stokes
-    bool write_lock(true);
-    tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, write_lock);
+    // The plane is loaded off to the side and published with one pointer swap, so that readers of the previous plane never wait
+    auto load_lock = carta::TimedLock(_plane_load_mutex, carta::RequestPhase::CacheLock);
+    if (_lazy_tiles) {
+        // Tiles, profiles and stats read from the loader as needed
+        return true;
+    }
+
+    // A later channel change may have loaded the plane already
+    int z(_z_index), stokes(_stokes_index);
+    auto current_plane = std::atomic_load(&_cached_plane);
+    if (current_plane && current_plane->z == z && current_plane->stokes == stokes) {
+        return true;
+    }
+
     auto t_start_set_image_cache = std::chrono::high_resolution_clock::now();
-    casacore::Slicer section = GetImageSlicer(AxisRange(_z_index), _stokes_index);
-    if (!GetSlicerData(section, _image_cache)) {
+    std::vector<float> plane;
+    if (TakePrefetchedPlane(z, stokes, plane)) {
+        spdlog::performance("Swap prefetched image z={} into cache", z);
+        SetCachedPlane(MakeCachedPlane(z, stokes, std::move(plane)));
+        return true;
+    }
+
+    if (!_plane_cache_key.empty() && !_compact_cache) {
+        auto shared_plane = SharedPlaneCache::Global().Get(_plane_cache_key, z, stokes);
+        if (shared_plane) {
+            spdlog::performance("Use shared image z={} in cache", z);
+            auto cached_plane = std::make_shared<CachedPlane>();
+            cached_plane->z = z;
+            cached_plane->stokes = stokes;
+            cached_plane->image = shared_plane;
+            cached_plane->mip_pyramid.Reset(_width, _height);
+            SetCachedPlane(cached_plane);
+            return true;
+        }
+    }
+
+    // Read into the buffer of the released plane, if any, rather than allocate and zero a new one; it does not raise the peak
+    // memory use, since the previous plane is kept while the next is loaded
+    plane.swap(_spare_plane);
+    casacore::Slicer section = GetImageSlicer(AxisRange(z), stokes);
+    if (!GetSlicerData(section, plane)) {
         spdlog::error("Session {}: {}", _session_id, "Loading image cache failed.");
         return false;
     }
+    SetCachedPlane(MakeCachedPlane(z, stokes, std::move(plane)));
 
     auto t_end_set_image_cache = std::chrono::high_resolution_clock::now();
     auto dt_set_image_cache =
         std::chrono::duration_cast<std::chrono::microseconds>(t_end_set_image_cache - t_start_set_image_cache).count();
+    carta::LatencyHistograms::Record(carta::LatencyPoint::ChannelLoad, dt_set_image_cache);
     spdlog::performance("Load {}x{} image to cache in {:.3f} ms at {:.3f} MPix/s", _image_shape(0), _image_shape(1),
         dt_set_image_cache * 1e-3, (float)(_image_shape(0) * _image_shape(1)) / dt_set_image_cache);
 
     return true;
 }
 
+Frame::PlaneSnapshot Frame::MakeCachedPlane(int z, int stokes, std::vector<float>&& plane) {
+    auto cached_plane = std::make_shared<CachedPlane>();
+    cached_plane->z = z;
+    cached_plane->stokes = stokes;
+    cached_plane->tile_summary = std::make_shared<const TileSummary>(plane.data(), _width, _height, TILE_SUMMARY_BLOCK_SIZE);
+    if (_compact_cache) {
+        cached_plane->compact = std::make_shared<const CompactPlane>(plane);
+    } else if (_plane_cache_key.empty()) {
+        // Not const, so that SetCachedPlane may take the buffer back when the plane is released
+        cached_plane->image = std::make_shared<std::vector<float>>(std::move(plane));
+    } else {
+        cached_plane->image = SharedPlaneCache::Global().Put(_plane_cache_key, z, stokes, std::move(plane));
+    }
+    cached_plane->mip_pyramid.Reset(_width, _height);
+    return cached_plane;
+}
+
+void Frame::SetCachedPlane(PlaneSnapshot plane) {
+    auto previous = std::atomic_exchange(&_cached_plane, plane);
+    // Readers copy the snapshot with atomic_load, so a snapshot no longer published with no other owner cannot gain one; planes
+    // shared with other frames belong to the shared cache
+    if (previous && (previous.use_count() == 1) && previous->image && (previous->image.use_count() == 1) && _plane_cache_key.empty()) {
+        _spare_plane = std::move(*std::const_pointer_cast<std::vector<float>>(previous->image));
+    }
+}
+
+Frame::PlaneSnapshot Frame::GetCachedPlane(int z, int stokes) {
+    if (_lazy_tiles) {
+        return nullptr;
+    }
+    auto plane = std::atomic_load(&_cached_plane);
+    if (plane && plane->z == z && plane->stokes == stokes) {
+        return plane;
+    }
+    if (z != CurrentZ() || stokes != CurrentStokes()) {
+        return nullptr;
+    }
+
+    // The current plane is being loaded, or failed to load
+    auto load_lock = carta::TimedLock(_plane_load_mutex, carta::RequestPhase::CacheLock);
+    plane = std::atomic_load(&_cached_plane);
+    if (plane && plane->z == z && plane->stokes == stokes) {
+        return plane;
+    }
+    return nullptr;
+}
+
 void Frame::GetZMatrix(std::vector<float>& z_matrix, size_t z, size_t stokes) {
     // fill matrix for given z and stokes
     casacore::Slicer section = GetImageSlicer(AxisRange(z), stokes);
@@ -296,9 +594,10 @@ void Frame::GetZMatrix(std::vector<float>& z_matrix, size_t z, size_t stokes) {
 // ****************************************************
 // Raster Data
 
-bool Frame::GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bounds, int mip, bool mean_filter) {
+bool Frame::GetRasterData(
+    const CachedPlane& plane, std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int mip, bool mean_filter) {
     // apply bounds and downsample image cache
-    if (!_valid || _image_cache.empty()) {
+    if (!_valid) {
         return false;
     }
 
@@ -326,18 +625,18 @@ bool Frame::GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bo
     int num_image_columns = _width;
     int num_image_rows = _height;
 
-    // read lock imageCache
-    bool write_lock(false);
-    tbb::queuing_rw_mutex::scoped_lock lock(_cache_mutex, write_lock);
-
     auto t_start_raster_data_filter = std::chrono::high_resolution_clock::now();
-    if (mean_filter && mip > 1) {
-        // Perform down-sampling by calculating the mean for each MIPxMIP block
-        BlockSmooth(
-            _image_cache.data(), image_data.data(), num_image_columns, num_image_rows, row_length_region, num_rows_region, x, y, mip);
+    if (plane.compact) {
+        GetCompactRasterData(*plane.compact, image_data.data(), x, y, req_width, req_height, mip, mean_filter);
+    } else if (mean_filter && mip > 1) {
+        // Perform down-sampling by calculating the mean for each MIPxMIP block, from the mip pyramid if the level is available
+        const float* image_cache = plane.image->data();
+        if (!plane.mip_pyramid.BlockMean(image_cache, image_data.data(), row_length_region, num_rows_region, x, y, mip)) {
+            BlockSmooth(image_cache, image_data.data(), num_image_columns, num_image_rows, row_length_region, num_rows_region, x, y, mip);
+        }
     } else {
         // Nearest neighbour filtering
-        NearestNeighbor(_image_cache.data(), image_data.data(), num_image_columns, row_length_region, num_rows_region, x, y, mip);
+        NearestNeighbor(plane.image->data(), image_data.data(), num_image_columns, row_length_region, num_rows_region, x, y, mip);
     }
 
     auto t_end_raster_data_filter = std::chrono::high_resolution_clock::now();
@@ -350,6 +649,38 @@ bool Frame::GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bo
     return true;
 }
 
+void Frame::GetCompactRasterData(
+    const CompactPlane& plane, float* image_data, int x, int y, int req_width, int req_height, int mip, bool mean_filter) {
+    size_t num_rows_region = std::ceil((float)req_height / mip);
+    size_t row_length_region = std::ceil((float)req_width / mip);
+    if (!mean_filter || mip == 1) {
+        // Nearest neighbour filtering; only the first row of each block is decoded
+        std::vector<float> row_data(req_width);
+        for (size_t j = 0; j < num_rows_region; ++j) {
+            plane.Decode((size_t)(y + j * mip) * _width + x, req_width, row_data.data());
+            for (size_t i = 0; i < row_length_region; ++i) {
+                image_data[j * row_length_region + i] = row_data[i * mip];
+            }
+        }
+        return;
+    }
+
+    // Mean of each MIPxMIP block, decoded in row bands which stay in the CPU cache
+    size_t band_rows_region = std::max((int64_t)1, COMPACT_DECODE_PIXELS / ((int64_t)req_width * mip));
+    std::vector<float> band_data;
+    for (size_t row = 0; row < num_rows_region; row += band_rows_region) {
+        size_t band_rows = std::min(band_rows_region, num_rows_region - row);
+        int band_y_start = y + row * mip;
+        int band_height = std::min(y + req_height, (int)(band_y_start + band_rows * mip)) - band_y_start;
+        band_data.resize((size_t)band_height * req_width);
+        for (int j = 0; j < band_height; ++j) {
+            plane.Decode((size_t)(band_y_start + j) * _width + x, req_width, band_data.data() + (size_t)j * req_width);
+        }
+        BlockSmooth(
+            band_data.data(), image_data + row * row_length_region, req_width, band_height, row_length_region, band_rows, 0, 0, mip);
+    }
+}
+
 // Tile data
 bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes,
     CARTA::CompressionType compression_type, float compression_quality) {
@@ -357,7 +688,139 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
     if (ZStokesChanged(z, stokes)) {
         return false;
     }
+    carta::LatencyScope latency(carta::LatencyPoint::TileFill);
+
+    // Blank or constant tiles skip the downsampling and compression of the pixels
+    float uniform_value;
+    if (GetUniformTileValue(tile, z, stokes, uniform_value)) {
+        return FillUniformRasterTileData(raster_tile_data, tile, z, stokes, uniform_value, compression_type, compression_quality);
+    }
 
+    std::vector<float> tile_image_data;
+    int tile_width;
+    int tile_height;
+    if (!GetRasterTileData(tile_image_data, tile, tile_width, tile_height) || ZStokesChanged(z, stokes)) {
+        return false;
+    }
+    if (!EncodeRasterTileData(raster_tile_data, tile, tile_image_data, tile_width, tile_height, z, stokes, compression_type,
+            compression_quality, [&]() { return ZStokesChanged(z, stokes); })) {
+        return false;
+    }
+
+    float cached_quality =
+        (compression_type == CARTA::CompressionType::NONE) ? compression_quality : raster_tile_data.compression_quality();
+    _tile_cache.Put(TileCacheKey(tile, z, stokes, compression_type, compression_quality), raster_tile_data.tiles(0), cached_quality);
+    return true;
+}
+
+bool Frame::GetUniformTileValue(const Tile& tile, int z, int stokes, float& value) {
+    auto plane = std::atomic_load(&_cached_plane);
+    if (!plane || (plane->z != z) || (plane->stokes != stokes) || !plane->tile_summary) {
+        return false;
+    }
+    int mip;
+    CARTA::ImageBounds bounds = GetTileBounds(tile, mip);
+    return plane->tile_summary->UniformValue(
+        bounds.x_min(), bounds.y_min(), bounds.x_max() - bounds.x_min(), bounds.y_max() - bounds.y_min(), value);
+}
+
+bool Frame::FillUniformRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes, float value,
+    CARTA::CompressionType compression_type, float compression_quality) {
+    int mip;
+    CARTA::ImageBounds bounds = GetTileBounds(tile, mip);
+    int tile_width = std::ceil((float)(bounds.x_max() - bounds.x_min()) / mip);
+    int tile_height = std::ceil((float)(bounds.y_max() - bounds.y_min()) / mip);
+
+    // Only ZFP tiles are kept: they are small, and quantized tiles depend on the channel range
+    bool reuse = (compression_type == CARTA::CompressionType::ZFP);
+    uint32_t value_bits;
+    memcpy(&value_bits, &value, sizeof(float));
+    auto key = std::make_tuple(tile_width, tile_height, value_bits, (int)lround(compression_quality));
+    if (reuse) {
+        std::unique_lock<std::mutex> lock(_uniform_tile_mutex);
+        auto uniform_tile = _uniform_tiles.find(key);
+        if (uniform_tile != _uniform_tiles.end()) {
+            raster_tile_data.set_channel(z);
+            raster_tile_data.set_stokes(stokes);
+            raster_tile_data.set_compression_type(compression_type);
+            raster_tile_data.set_compression_quality(uniform_tile->second.second);
+            if (raster_tile_data.tiles_size()) {
+                raster_tile_data.clear_tiles();
+            }
+            CARTA::TileData* tile_ptr = raster_tile_data.add_tiles();
+            *tile_ptr = uniform_tile->second.first;
+            tile_ptr->set_layer(tile.layer);
+            tile_ptr->set_x(tile.x);
+            tile_ptr->set_y(tile.y);
+            return true;
+        }
+    }
+
+    std::vector<float> tile_image_data(tile_width * tile_height, value);
+    if (!EncodeRasterTileData(raster_tile_data, tile, tile_image_data, tile_width, tile_height, z, stokes, compression_type,
+            compression_quality, [&]() { return ZStokesChanged(z, stokes); })) {
+        return false;
+    }
+    if (reuse) {
+        std::unique_lock<std::mutex> lock(_uniform_tile_mutex);
+        if (_uniform_tiles.size() >= UNIFORM_TILE_CACHE_SIZE) {
+            _uniform_tiles.clear();
+        }
+        _uniform_tiles[key] = std::make_pair(raster_tile_data.tiles(0), raster_tile_data.compression_quality());
+    }
+    return true;
+}
+
+bool Frame::FillDeltaRasterTileData(
+    CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes, float compression_quality) {
+    if (ZStokesChanged(z, stokes)) {
+        return false;
+    }
+    carta::LatencyScope latency(carta::LatencyPoint::TileFill);
+
+    std::vector<float> tile_image_data;
+    int tile_width;
+    int tile_height;
+    if (!GetRasterTileData(tile_image_data, tile, tile_width, tile_height) || ZStokesChanged(z, stokes)) {
+        return false;
+    }
+    auto nan_encodings = GetNanEncodingsBlock(tile_image_data, 0, tile_width, tile_height);
+
+    TileDeltaResult delta;
+    {
+        carta::PhaseScope compress_phase(carta::RequestPhase::Compress);
+        if (!_tile_deltas.Encode(tile, z, stokes, tile_image_data, tile_width, tile_height, nan_encodings, lround(compression_quality),
+                delta)) {
+            return false;
+        }
+    }
+
+    raster_tile_data.set_channel(z);
+    raster_tile_data.set_stokes(stokes);
+    if (delta.keyframe) {
+        raster_tile_data.set_compression_type(CARTA::CompressionType::ZFP);
+        raster_tile_data.set_compression_quality(delta.precision);
+    } else {
+        raster_tile_data.set_compression_type(static_cast<CARTA::CompressionType>(DELTA_COMPRESSION_TYPE));
+        raster_tile_data.set_compression_quality(delta.tolerance);
+    }
+    if (raster_tile_data.tiles_size()) {
+        raster_tile_data.clear_tiles();
+    }
+    CARTA::TileData* tile_ptr = raster_tile_data.add_tiles();
+    tile_ptr->set_layer(tile.layer);
+    tile_ptr->set_x(tile.x);
+    tile_ptr->set_y(tile.y);
+    tile_ptr->set_width(tile_width);
+    tile_ptr->set_height(tile_height);
+    tile_ptr->set_nan_encodings(nan_encodings.data(), sizeof(int32_t) * nan_encodings.size());
+    tile_ptr->set_image_data(delta.data.data(), delta.data.size());
+    return true;
+}
+
+bool Frame::EncodeRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, std::vector<float>& tile_image_data,
+    int tile_width, int tile_height, int z, int stokes, CARTA::CompressionType compression_type, float compression_quality,
+    const std::function<bool()>& stale) {
     raster_tile_data.set_channel(z);
     raster_tile_data.set_stokes(stokes);
     raster_tile_data.set_compression_type(compression_type);
@@ -370,83 +833,239 @@ bool Frame::FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Ti
     tile_ptr->set_layer(tile.layer);
     tile_ptr->set_x(tile.x);
     tile_ptr->set_y(tile.y);
+    tile_ptr->set_width(tile_width);
+    tile_ptr->set_height(tile_height);
+    size_t tile_image_data_size = sizeof(float) * tile_image_data.size(); // tile image data size in bytes
 
-    std::vector<float> tile_image_data;
-    int tile_width;
-    int tile_height;
-    if (GetRasterTileData(tile_image_data, tile, tile_width, tile_height)) {
-        size_t tile_image_data_size = sizeof(float) * tile_image_data.size(); // tile image data size in bytes
+    if (compression_type == CARTA::CompressionType::NONE) {
+        tile_ptr->set_image_data(tile_image_data.data(), tile_image_data_size);
+        return true;
+    } else if (compression_type == CARTA::CompressionType::ZFP) {
+        auto nan_encodings = GetNanEncodingsBlock(tile_image_data, 0, tile_width, tile_height);
+        tile_ptr->set_nan_encodings(nan_encodings.data(), sizeof(int32_t) * nan_encodings.size());
 
-        if (ZStokesChanged(z, stokes)) {
+        if (stale()) {
             return false;
         }
-        tile_ptr->set_width(tile_width);
-        tile_ptr->set_height(tile_height);
-        if (compression_type == CARTA::CompressionType::NONE) {
-            tile_ptr->set_image_data(tile_image_data.data(), sizeof(float) * tile_image_data.size());
-            return true;
-        } else if (compression_type == CARTA::CompressionType::ZFP) {
-            auto nan_encodings = GetNanEncodingsBlock(tile_image_data, 0, tile_width, tile_height);
-            tile_ptr->set_nan_encodings(nan_encodings.data(), sizeof(int32_t) * nan_encodings.size());
 
-            if (ZStokesChanged(z, stokes)) {
+        auto t_start_compress_tile_data = std::chrono::high_resolution_clock::now();
+        carta::TraceSpan trace_span("compress tile", "compression");
+        carta::PhaseScope compress_phase(carta::RequestPhase::Compress);
+        if (trace_span.Traced()) {
+            trace_span.SetDetail(fmt::format("{}x{}", tile_width, tile_height));
+        }
+
+        // compress the data, choosing the precision from a sample of the tile
+        const char* compressed_data;
+        size_t compressed_size;
+        uint32_t used_precision;
+        int precision = lround(compression_quality);
+        if (CompressAdaptive(tile_image_data, 0, tile_width, tile_height, precision, HIGH_COMPRESSION_QUALITY, compressed_data,
+                compressed_size, used_precision)) {
+            return false;
+        }
+        float compression_ratio = (float)tile_image_data_size / (float)compressed_size;
+
+        if (used_precision == HIGH_COMPRESSION_QUALITY && precision < HIGH_COMPRESSION_QUALITY) {
+            // set compression data with high precision
+            raster_tile_data.set_compression_quality(HIGH_COMPRESSION_QUALITY);
+            spdlog::debug("Using high compression quality.");
+        } else {
+            // set compression data with default precision
+            raster_tile_data.set_compression_quality(compression_quality);
+        }
+        tile_ptr->set_image_data(compressed_data, compressed_size);
+
+        spdlog::debug("The compression ratio for tile (layer:{}, x:{}, y:{}) is {:.3f}.", tile.layer, tile.x, tile.y, compression_ratio);
+
+        // Measure duration for compress tile data
+        auto t_end_compress_tile_data = std::chrono::high_resolution_clock::now();
+        auto dt_compress_tile_data =
+            std::chrono::duration_cast<std::chrono::microseconds>(t_end_compress_tile_data - t_start_compress_tile_data).count();
+        carta::LatencyHistograms::Record(carta::LatencyPoint::TileCompress, dt_compress_tile_data);
+        spdlog::performance("Compress {}x{} tile data in {:.3f} ms at {:.3f} MPix/s", tile_width, tile_height,
+            dt_compress_tile_data * 1e-3, (float)(tile_width * tile_height) / dt_compress_tile_data);
+
+        return !stale();
+    } else if (compression_type == static_cast<CARTA::CompressionType>(QUANTIZED_COMPRESSION_TYPE)) {
+        // Quantize to the channel range; quality selects 8- or 16-bit codes
+        carta::BasicStats<float> stats;
+        if (!GetBasicStats(z, stokes, stats)) {
+            return false;
+        }
+        int bits = compression_quality > 8 ? 16 : 8;
+        thread_local std::vector<char> compression_buffer;
+        size_t compressed_size;
+        if (CompressQuantized(tile_image_data, 0, tile_width, tile_height, stats.min_val, stats.max_val, bits, compression_buffer,
+                compressed_size)) {
+            return false;
+        }
+        raster_tile_data.set_compression_quality(bits);
+        tile_ptr->set_image_data(compression_buffer.data(), compressed_size);
+
+        return !stale();
+    } else if (compression_type == static_cast<CARTA::CompressionType>(LOSSLESS_COMPRESSION_TYPE)) {
+        // Exact values, NaNs included; the quality is the zstd level
+        carta::PhaseScope compress_phase(carta::RequestPhase::Compress);
+        thread_local std::vector<char> compression_buffer;
+        size_t compressed_size;
+        if (CompressLossless(tile_image_data, 0, tile_width, tile_height, LOSSLESS_ZSTD_LEVEL, compression_buffer, compressed_size)) {
+            return false;
+        }
+        raster_tile_data.set_compression_quality(LOSSLESS_ZSTD_LEVEL);
+        tile_ptr->set_image_data(compression_buffer.data(), compressed_size);
+        spdlog::debug("The lossless compression ratio for tile (layer:{}, x:{}, y:{}) is {:.3f}.", tile.layer, tile.x, tile.y,
+            (float)tile_image_data_size / (float)compressed_size);
+
+        return !stale();
+    }
+
+    return false;
+}
+
+bool Frame::GetCachedRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes,
+    CARTA::CompressionType compression_type, float compression_quality) {
+    if (ZStokesChanged(z, stokes)) {
+        return false;
+    }
+
+    CARTA::TileData cached_tile;
+    float cached_quality;
+    if (!_tile_cache.Get(TileCacheKey(tile, z, stokes, compression_type, compression_quality), cached_tile, cached_quality)) {
+        return false;
+    }
+
+    raster_tile_data.set_channel(z);
+    raster_tile_data.set_stokes(stokes);
+    raster_tile_data.set_compression_type(compression_type);
+    if (compression_type != CARTA::CompressionType::NONE) {
+        raster_tile_data.set_compression_quality(cached_quality);
+    }
+    if (raster_tile_data.tiles_size()) {
+        raster_tile_data.clear_tiles();
+    }
+    *raster_tile_data.add_tiles() = std::move(cached_tile);
+    return true;
+}
+
+std::vector<AxisRange> Frame::GetChannelTileBlocks(std::vector<int> channels, const std::vector<Tile>& tiles) {
+    // Runs of consecutive valid channels, each read at once for the bounding box of the tiles
+    std::vector<AxisRange> blocks;
+    CARTA::ImageBounds box;
+    if (!GetTilesBoundingBox(tiles, box)) {
+        return blocks;
+    }
+    size_t plane_bytes = sizeof(float) * (size_t)(box.x_max() - box.x_min()) * (box.y_max() - box.y_min());
+    int max_depth = std::max((size_t)1, ((size_t)CHANNEL_TILES_BLOCK_MB * 1024 * 1024) / plane_bytes);
+
+    std::sort(channels.begin(), channels.end());
+    channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+    for (int z : channels) {
+        if (!CheckZ(z)) {
+            continue;
+        }
+        if (!blocks.empty() && (z == blocks.back().to + 1) && (z - blocks.back().from < max_depth)) {
+            blocks.back().to = z;
+        } else {
+            blocks.emplace_back(z, z);
+        }
+    }
+    return blocks;
+}
+
+bool Frame::FillChannelTiles(const AxisRange& z_range, int stokes, const std::vector<Tile>& tiles, CARTA::CompressionType compression_type,
+    float compression_quality, const ChannelTileCallback& tile_callback, const carta::CancellationToken& cancel_token) {
+    // Tiles of channels other than the current one; the image cache, tile cache and current channel are not changed
+    CARTA::ImageBounds box;
+    if (!CheckZ(z_range.from) || !CheckZ(z_range.to) || !CheckStokes(stokes) || !GetTilesBoundingBox(tiles, box)) {
+        return false;
+    }
+    auto stale = [&]() { return cancel_token.IsCancelled() || !IsConnected(); };
+
+    int box_width = box.x_max() - box.x_min();
+    int box_height = box.y_max() - box.y_min();
+    size_t plane_size = (size_t)box_width * box_height;
+    std::vector<float> block_data;
+    casacore::Slicer slicer =
+        GetImageSlicer(AxisRange(box.x_min(), box.x_max() - 1), AxisRange(box.y_min(), box.y_max() - 1), z_range, stokes);
+    if (!GetSlicerData(slicer, block_data) || stale()) {
+        return false;
+    }
+
+    if (compression_type == static_cast<CARTA::CompressionType>(QUANTIZED_COMPRESSION_TYPE)) {
+        // Channel ranges for quantizing, cached before the tiles are encoded in parallel; from the block if it is the whole channel
+        bool whole_plane = (plane_size == (size_t)_width * _height);
+        for (int z = z_range.from; z <= z_range.to; ++z) {
+            carta::BasicStats<float> stats;
+            if (whole_plane && !GetCachedBasicStats(z, stokes, stats)) {
+                auto plane_start = block_data.begin() + (z - z_range.from) * plane_size;
+                CalcBasicStats(std::vector<float>(plane_start, plane_start + plane_size), stats);
+                _image_basic_stats[CacheKey(z, stokes)] = stats;
+            } else if (!GetBasicStats(z, stokes, stats)) {
                 return false;
             }
+        }
+    }
 
-            auto t_start_compress_tile_data = std::chrono::high_resolution_clock::now();
-
-            // compress the data with the default precision
-            std::vector<char> compression_buffer;
-            size_t compressed_size;
-            int precision = lround(compression_quality);
-            Compress(tile_image_data, 0, compression_buffer, compressed_size, tile_width, tile_height, precision);
-            float compression_ratio = (float)tile_image_data_size / (float)compressed_size;
-            bool use_high_precision(false);
-
-            if (precision < HIGH_COMPRESSION_QUALITY && compression_ratio > 20) {
-                // re-compress the data with a higher precision
-                std::vector<char> compression_buffer_hq;
-                size_t compressed_size_hq;
-                Compress(tile_image_data, 0, compression_buffer_hq, compressed_size_hq, tile_width, tile_height, HIGH_COMPRESSION_QUALITY);
-                float compression_ratio_hq = (float)tile_image_data_size / (float)compressed_size_hq;
-
-                if (compression_ratio_hq > 10) {
-                    // set compression data with high precision
-                    raster_tile_data.set_compression_quality(HIGH_COMPRESSION_QUALITY);
-                    tile_ptr->set_image_data(compression_buffer_hq.data(), compressed_size_hq);
-
-                    spdlog::debug("Using high compression quality. Previous compression ratio: {:.3f}", compression_ratio);
-                    compression_ratio = compression_ratio_hq;
-                    use_high_precision = true;
+    // Tiles of each channel in turn, so that the first channels of the block are complete first
+    int num_channel_tiles = tiles.size();
+    int num_tiles = num_channel_tiles * (z_range.to - z_range.from + 1);
+    std::atomic<int> next_tile(0);
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel
+    {
+        int num_threads = omp_get_num_threads();
+        int num_workers = std::min(num_tiles, std::min(num_threads, MAX_TILING_TASKS));
+#pragma omp for
+        for (int j = 0; j < num_workers; j++) {
+            int i;
+            while (((i = next_tile++) < num_tiles) && !stale()) {
+                int z = z_range.from + i / num_channel_tiles;
+                const Tile& tile = tiles[i % num_channel_tiles];
+                int mip;
+                CARTA::ImageBounds bounds = GetTileBounds(tile, mip);
+                int tile_width = std::ceil((float)(bounds.x_max() - bounds.x_min()) / mip);
+                int tile_height = std::ceil((float)(bounds.y_max() - bounds.y_min()) / mip);
+                std::vector<float> tile_data((size_t)tile_width * tile_height);
+                const float* plane = block_data.data() + (z - z_range.from) * plane_size;
+                int x_offset = bounds.x_min() - box.x_min();
+                int y_offset = bounds.y_min() - box.y_min();
+                if (mip > 1) {
+                    BlockSmooth(plane, tile_data.data(), box_width, box_height, tile_width, tile_height, x_offset, y_offset, mip);
+                } else {
+                    NearestNeighbor(plane, tile_data.data(), box_width, tile_width, tile_height, x_offset, y_offset, 1);
                 }
-            }
 
-            if (!use_high_precision) {
-                // set compression data with default precision
-                raster_tile_data.set_compression_quality(compression_quality);
-                tile_ptr->set_image_data(compression_buffer.data(), compressed_size);
+                CARTA::RasterTileData raster_tile_data;
+                if (EncodeRasterTileData(raster_tile_data, tile, tile_data, tile_width, tile_height, z, stokes, compression_type,
+                        compression_quality, stale)) {
+                    tile_callback(raster_tile_data);
+                }
             }
-
-            spdlog::debug(
-                "The compression ratio for tile (layer:{}, x:{}, y:{}) is {:.3f}.", tile.layer, tile.x, tile.y, compression_ratio);
-
-            // Measure duration for compress tile data
-            auto t_end_compress_tile_data = std::chrono::high_resolution_clock::now();
-            auto dt_compress_tile_data =
-                std::chrono::duration_cast<std::chrono::microseconds>(t_end_compress_tile_data - t_start_compress_tile_data).count();
-            spdlog::performance("Compress {}x{} tile data in {:.3f} ms at {:.3f} MPix/s", tile_width, tile_height,
-                dt_compress_tile_data * 1e-3, (float)(tile_width * tile_height) / dt_compress_tile_data);
-
-            return !(ZStokesChanged(z, stokes));
         }
     }
+    return !stale();
+}
 
-    return false;
+bool Frame::GetTilesBoundingBox(const std::vector<Tile>& tiles, CARTA::ImageBounds& box) {
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        int mip;
+        CARTA::ImageBounds bounds = GetTileBounds(tiles[i], mip);
+        if (i == 0) {
+            box = bounds;
+        } else {
+            box.set_x_min(std::min(box.x_min(), bounds.x_min()));
+            box.set_x_max(std::max(box.x_max(), bounds.x_max()));
+            box.set_y_min(std::min(box.y_min(), bounds.y_min()));
+            box.set_y_max(std::max(box.y_max(), bounds.y_max()));
+        }
+    }
+    return !tiles.empty() && (box.x_max() > box.x_min()) && (box.y_max() > box.y_min());
 }
 
-bool Frame::GetRasterTileData(std::vector<float>& tile_data, const Tile& tile, int& width, int& height) {
+CARTA::ImageBounds Frame::GetTileBounds(const Tile& tile, int& mip) {
     int tile_size = 256;
-    int mip = Tile::LayerToMip(tile.layer, _width, _height, tile_size, tile_size);
+    mip = Tile::LayerToMip(tile.layer, _width, _height, tile_size, tile_size);
     int tile_size_original = tile_size * mip;
 
     // crop to image size
@@ -455,12 +1074,100 @@ bool Frame::GetRasterTileData(std::vector<float>& tile_data, const Tile& tile, i
     bounds.set_x_max(std::min((int)_width, (tile.x + 1) * tile_size_original));
     bounds.set_y_min(std::max(0, tile.y * tile_size_original));
     bounds.set_y_max(std::min((int)_height, (tile.y + 1) * tile_size_original));
+    return bounds;
+}
+
+bool Frame::GetRasterTileData(std::vector<float>& tile_data, const Tile& tile, int& width, int& height) {
+    int mip;
+    CARTA::ImageBounds bounds = GetTileBounds(tile, mip);
 
     const int req_height = bounds.y_max() - bounds.y_min();
     const int req_width = bounds.x_max() - bounds.x_min();
     width = std::ceil((float)req_width / mip);
     height = std::ceil((float)req_height / mip);
-    return GetRasterData(tile_data, bounds, mip, true);
+    auto plane = GetCachedPlane(CurrentZ(), CurrentStokes());
+    if (!plane) {
+        return GetLazyRasterData(tile_data, bounds, mip);
+    }
+    return GetRasterData(*plane, tile_data, bounds, mip, true);
+}
+
+bool Frame::GetLazyRasterData(std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int mip, int z, int stokes) {
+    // Read only the tile footprint from the loader, in row bands so that memory use is bounded for low-resolution tiles
+    if (!_valid || mip <= 0) {
+        return false;
+    }
+
+    const int x = bounds.x_min();
+    const int y = bounds.y_min();
+    const int req_height = bounds.y_max() - y;
+    const int req_width = bounds.x_max() - x;
+    if ((req_height <= 0) || (req_width <= 0) || (_height < (y + req_height)) || (_width < (x + req_width))) {
+        return false;
+    }
+
+    bool current_plane(z == CURRENT_Z && stokes == CURRENT_STOKES);
+    z = (z == CURRENT_Z ? CurrentZ() : z);
+    stokes = (stokes == CURRENT_STOKES ? CurrentStokes() : stokes);
+    size_t num_rows_region = std::ceil((float)req_height / mip);
+    size_t row_length_region = std::ceil((float)req_width / mip);
+    AxisRange x_range(x, x + req_width - 1);
+
+    auto t_start_lazy_tile = std::chrono::high_resolution_clock::now();
+    if (mip == 1) {
+        casacore::Slicer section = GetImageSlicer(x_range, AxisRange(y, y + req_height - 1), AxisRange(z), stokes);
+        if (!GetSlicerData(section, image_data)) {
+            return false;
+        }
+    } else if (!carta::IsComputedStokes(stokes) && _loader->HasMip(mip) && (x % mip == 0) && (y % mip == 0)) {
+        // Read the downsampled tile from the file; bounds are aligned to the mip
+        if (!_loader->GetMipData(image_data, mip, x / mip, y / mip, row_length_region, num_rows_region, z, stokes, _image_mutex)) {
+            return false;
+        }
+    } else {
+        image_data.resize(num_rows_region * row_length_region);
+        size_t band_rows_region = std::max((int64_t)1, LAZY_TILE_READ_PIXELS / ((int64_t)req_width * mip));
+        std::vector<float> band_data;
+
+        for (size_t row = 0; row < num_rows_region; row += band_rows_region) {
+            if (!IsConnected() || (current_plane && ZStokesChanged(z, stokes))) {
+                return false;
+            }
+
+            size_t band_rows = std::min(band_rows_region, num_rows_region - row);
+            int band_y_start = y + row * mip;
+            int band_y_end = std::min(y + req_height, (int)(band_y_start + band_rows * mip)) - 1;
+            casacore::Slicer section = GetImageSlicer(x_range, AxisRange(band_y_start, band_y_end), AxisRange(z), stokes);
+            if (!GetSlicerData(section, band_data)) {
+                return false;
+            }
+
+            BlockSmooth(band_data.data(), image_data.data() + row * row_length_region, req_width, band_y_end - band_y_start + 1,
+                row_length_region, band_rows, 0, 0, mip);
+        }
+    }
+
+    auto t_end_lazy_tile = std::chrono::high_resolution_clock::now();
+    auto dt_lazy_tile = std::chrono::duration_cast<std::chrono::microseconds>(t_end_lazy_tile - t_start_lazy_tile).count();
+    spdlog::performance("Read and filter {}x{} lazy tile data to {}x{} in {:.3f} ms", req_width, req_height, row_length_region,
+        num_rows_region, dt_lazy_tile * 1e-3);
+
+    return true;
+}
+
+bool Frame::GetPlaneRasterData(std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int z, int stokes, int mip) {
+    z = (z == CURRENT_Z ? CurrentZ() : z);
+    stokes = (stokes == CURRENT_STOKES ? CurrentStokes() : stokes);
+    if (!CheckZ(z) || !CheckStokes(stokes)) {
+        return false;
+    }
+
+    // The cached plane is kept if the channel changes while it is read
+    auto plane = GetCachedPlane(z, stokes);
+    if (plane && GetRasterData(*plane, image_data, bounds, mip)) {
+        return true;
+    }
+    return GetLazyRasterData(image_data, bounds, mip, z, stokes);
 }
 
 // ****************************************************
@@ -472,71 +1179,165 @@ bool Frame::SetContourParameters(const CARTA::SetContourParameters& message) {
         message.reference_file_id()};
 
     if (_contour_settings != new_settings) {
+        // The prefetcher reads the settings on its own thread
+        std::unique_lock<std::mutex> lock(_prefetch_mutex);
         _contour_settings = new_settings;
         return true;
     }
     return false;
 }
 
-bool Frame::ContourImage(ContourCallback& partial_contour_callback) {
-    double scale = 1.0;
-    double offset = 0;
-    bool smooth_successful = false;
+bool Frame::ContourImage(
+    const carta::CancellationToken& cancel_token, ContourCallback& partial_contour_callback, ContourCallback* preview_callback) {
+    carta::LatencyScope latency(carta::LatencyPoint::Contour);
+
+    // When only the levels changed, the smoothed plane of the previous contours is traced again
+    int z = CurrentZ();
+    int stokes = CurrentStokes();
+    ContourSettings settings = _contour_settings;
+    bool smoothing = UseContourSmoothing(settings);
+    SmoothedPlane smoothed_plane;
+    if (smoothing && _smoothed_plane_cache.Get(z, stokes, settings.smoothing_mode, settings.smoothing_factor, smoothed_plane)) {
+        TraceSmoothedContours(smoothed_plane, settings, partial_contour_callback, cancel_token);
+        return true;
+    }
+
+    // The cached plane is kept for the duration of the contour calculation. A compact plane is decoded, and in lazy tile mode the
+    // plane is read, to a temporary buffer.
+    auto cached_plane = GetCachedPlane(z, stokes);
+    std::vector<float> plane;
+    if (cached_plane && cached_plane->compact) {
+        plane.resize(cached_plane->compact->Size());
+        cached_plane->compact->Decode(0, plane.size(), plane.data());
+    } else if (!cached_plane) {
+        GetZMatrix(plane, z, stokes);
+    }
+    const CachedPlane* full_plane = (cached_plane && cached_plane->image) ? cached_plane.get() : nullptr;
+    if (!full_plane && plane.empty()) {
+        return false;
+    }
+    const float* image_data = full_plane ? full_plane->image->data() : plane.data();
+    if (preview_callback) {
+        ContourPreview(image_data, settings, full_plane, *preview_callback, cancel_token);
+    }
+    if (!smoothing) {
+        return ContourPlane(image_data, settings, partial_contour_callback, full_plane, cancel_token);
+    }
+
+    if (!SmoothContourPlane(image_data, settings, full_plane, smoothed_plane)) {
+        return false;
+    }
+    _smoothed_plane_cache.Put(z, stokes, settings.smoothing_mode, settings.smoothing_factor, smoothed_plane);
+    TraceSmoothedContours(smoothed_plane, settings, partial_contour_callback, cancel_token);
+    return true;
+}
+
+void Frame::ContourPreview(const float* image_data, const ContourSettings& settings, const CachedPlane* cached_plane,
+    ContourCallback& callback, const carta::CancellationToken& cancel_token) {
+    // Only worthwhile if the preview is much coarser than the requested contours
+    int factor = std::ceil(double(std::max(_width, _height)) / CONTOUR_PREVIEW_SIZE);
+    int requested_factor = (settings.smoothing_mode == CARTA::SmoothingMode::NoSmoothing) ? 1 : std::max(settings.smoothing_factor, 1);
+    if (factor < CONTOUR_PREVIEW_MIN_FACTOR * requested_factor) {
+        return;
+    }
+
+    auto t_start_preview = std::chrono::high_resolution_clock::now();
+    std::vector<float> preview_data;
+    if (!BlockAveragePlane(image_data, factor, cached_plane, preview_data)) {
+        return;
+    }
+
     std::vector<std::vector<float>> vertex_data;
     std::vector<std::vector<int>> index_data;
-    tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, false);
+    size_t preview_width = ceil(double(_width) / factor);
+    size_t preview_height = ceil(double(_height) / factor);
+    TraceContours(preview_data.data(), preview_width, preview_height, factor, 0, settings.levels, vertex_data, index_data,
+        settings.chunk_size, callback, cancel_token);
+    auto t_end_preview = std::chrono::high_resolution_clock::now();
+    auto dt_preview = std::chrono::duration_cast<std::chrono::microseconds>(t_end_preview - t_start_preview).count();
+    spdlog::performance("Contour preview with block size {} in {:.3f} ms", factor, dt_preview * 1e-3);
+}
+
+bool Frame::BlockAveragePlane(const float* image_data, int factor, const CachedPlane* cached_plane, std::vector<float>& dest_vector) {
+    if (cached_plane) {
+        // Uses the mip pyramid when it has the level
+        CARTA::ImageBounds image_bounds;
+        image_bounds.set_x_min(0);
+        image_bounds.set_y_min(0);
+        image_bounds.set_x_max(_width);
+        image_bounds.set_y_max(_height);
+        return GetRasterData(*cached_plane, dest_vector, image_bounds, factor, true);
+    }
 
-    if (_contour_settings.smoothing_mode == CARTA::SmoothingMode::NoSmoothing || _contour_settings.smoothing_factor <= 1) {
-        TraceContours(_image_cache.data(), _width, _height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-            _contour_settings.chunk_size, partial_contour_callback);
+    size_t block_width = ceil(double(_width) / factor);
+    size_t block_height = ceil(double(_height) / factor);
+    dest_vector.resize(block_width * block_height);
+    return BlockSmooth(image_data, dest_vector.data(), _width, _height, block_width, block_height, 0, 0, factor);
+}
+
+bool Frame::ContourPlane(const float* image_data, const ContourSettings& settings, ContourCallback& partial_contour_callback,
+    const CachedPlane* cached_plane, const carta::CancellationToken& cancel_token) {
+    if (!UseContourSmoothing(settings)) {
+        std::vector<std::vector<float>> vertex_data;
+        std::vector<std::vector<int>> index_data;
+        TraceContours(image_data, _width, _height, 1.0, 0, settings.levels, vertex_data, index_data, settings.chunk_size,
+            partial_contour_callback, cancel_token);
         return true;
-    } else if (_contour_settings.smoothing_mode == CARTA::SmoothingMode::GaussianBlur) {
+    }
+
+    SmoothedPlane smoothed_plane;
+    if (!SmoothContourPlane(image_data, settings, cached_plane, smoothed_plane)) {
+        return false;
+    }
+    TraceSmoothedContours(smoothed_plane, settings, partial_contour_callback, cancel_token);
+    return true;
+}
+
+bool Frame::UseContourSmoothing(const ContourSettings& settings) {
+    return (settings.smoothing_mode != CARTA::SmoothingMode::NoSmoothing) && (settings.smoothing_factor > 1);
+}
+
+bool Frame::SmoothContourPlane(
+    const float* image_data, const ContourSettings& settings, const CachedPlane* cached_plane, SmoothedPlane& smoothed_plane) {
+    auto dest_vector = std::make_shared<std::vector<float>>();
+    if (settings.smoothing_mode == CARTA::SmoothingMode::GaussianBlur) {
         // Smooth the image from cache
-        int mask_size = (_contour_settings.smoothing_factor - 1) * 2 + 1;
+        int mask_size = (settings.smoothing_factor - 1) * 2 + 1;
         int64_t kernel_width = (mask_size - 1) / 2;
 
         int64_t source_width = _width;
         int64_t source_height = _height;
         int64_t dest_width = _width - (2 * kernel_width);
         int64_t dest_height = _height - (2 * kernel_width);
-        std::unique_ptr<float[]> dest_array(new float[dest_width * dest_height]);
-        smooth_successful = GaussianSmooth(_image_cache.data(), dest_array.get(), source_width, source_height, dest_width, dest_height,
-            _contour_settings.smoothing_factor);
-        // Can release lock early, as we're no longer using the image cache
-        cache_lock.release();
-        if (smooth_successful) {
-            // Perform contouring with an offset based on the Gaussian smoothing apron size
-            offset = _contour_settings.smoothing_factor - 1;
-            TraceContours(dest_array.get(), dest_width, dest_height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-                _contour_settings.chunk_size, partial_contour_callback);
-            return true;
+        dest_vector->resize(dest_width * dest_height);
+        carta::GpuCompute::PlaneScope gpu_plane(cached_plane ? cached_plane->image : nullptr, image_data);
+        if (!GaussianSmooth(
+                image_data, dest_vector->data(), source_width, source_height, dest_width, dest_height, settings.smoothing_factor)) {
+            return false;
         }
-    } else {
-        // Block averaging
-        CARTA::ImageBounds image_bounds;
-        image_bounds.set_x_min(0);
-        image_bounds.set_y_min(0);
-        image_bounds.set_x_max(_width);
-        image_bounds.set_y_max(_height);
+        // Contours are offset by the Gaussian smoothing apron size
+        smoothed_plane = SmoothedPlane{dest_vector, (size_t)dest_width, (size_t)dest_height, 1.0, settings.smoothing_factor - 1.0};
+        return true;
+    }
 
-        std::vector<float> dest_vector;
-        smooth_successful = GetRasterData(dest_vector, image_bounds, _contour_settings.smoothing_factor, true);
-        cache_lock.release();
-        if (smooth_successful) {
-            // Perform contouring with an offset based on the block size, and a scale factor equal to block size
-            offset = 0;
-            scale = _contour_settings.smoothing_factor;
-            size_t dest_width = ceil(double(image_bounds.x_max()) / _contour_settings.smoothing_factor);
-            size_t dest_height = ceil(double(image_bounds.y_max()) / _contour_settings.smoothing_factor);
-            TraceContours(dest_vector.data(), dest_width, dest_height, scale, offset, _contour_settings.levels, vertex_data, index_data,
-                _contour_settings.chunk_size, partial_contour_callback);
-            return true;
-        }
+    // Block averaging
+    if (!BlockAveragePlane(image_data, settings.smoothing_factor, cached_plane, *dest_vector)) {
         spdlog::warn("Smoothing mode not implemented yet!");
         return false;
     }
+    // Contours are scaled by the block size
+    size_t dest_width = ceil(double(_width) / settings.smoothing_factor);
+    size_t dest_height = ceil(double(_height) / settings.smoothing_factor);
+    smoothed_plane = SmoothedPlane{dest_vector, dest_width, dest_height, (double)settings.smoothing_factor, 0};
+    return true;
+}
 
-    return false;
+void Frame::TraceSmoothedContours(const SmoothedPlane& smoothed_plane, const ContourSettings& settings,
+    ContourCallback& partial_contour_callback, const carta::CancellationToken& cancel_token) {
+    std::vector<std::vector<float>> vertex_data;
+    std::vector<std::vector<int>> index_data;
+    TraceContours(smoothed_plane.data->data(), smoothed_plane.width, smoothed_plane.height, smoothed_plane.scale, smoothed_plane.offset,
+        settings.levels, vertex_data, index_data, settings.chunk_size, partial_contour_callback, cancel_token);
 }
 
 // ****************************************************
@@ -612,20 +1413,19 @@ bool Frame::FillRegionHistogramData(int region_id, CARTA::RegionHistogramData& h
                 return false;
             }
 
-            // calculate image histogram
+            // calculate image histogram, with the stats if they are not cached
             BasicStats<float> stats;
-            if (GetBasicStats(z, stokes, stats)) {
-                carta::Histogram hist;
-                histogram_filled = CalculateHistogram(region_id, z, stokes, num_bins, stats, hist);
-                if (histogram_filled) {
-                    FillHistogramFromResults(histogram, stats, hist);
-                }
+            carta::Histogram hist;
+            histogram_filled = CalculateStatsAndHistogram(z, stokes, num_bins, stats, hist);
+            if (histogram_filled) {
+                FillHistogramFromResults(histogram, stats, hist);
             }
 
             if (histogram_filled) {
                 auto t_end_image_histogram = std::chrono::high_resolution_clock::now();
                 auto dt_image_histogram =
                     std::chrono::duration_cast<std::chrono::microseconds>(t_end_image_histogram - t_start_image_histogram).count();
+                carta::LatencyHistograms::Record(carta::LatencyPoint::Histogram, dt_image_histogram);
                 spdlog::performance("Fill image histogram in {:.3f} ms at {:.3f} MPix/s", dt_image_histogram * 1e-3,
                     (float)stats.num_pixels / dt_image_histogram);
             }
@@ -651,20 +1451,33 @@ bool Frame::FillHistogramFromCache(int z, int stokes, int num_bins, CARTA::Histo
 
 bool Frame::FillHistogramFromLoaderCache(int z, int stokes, int num_bins, CARTA::Histogram* histogram) {
     // Fill the Histogram submessage from the loader cache
-    auto& current_stats = _loader->GetImageStats(stokes, z);
+    auto current_stats = _loader->GetImageStats(stokes, z, _image_mutex);
     if (current_stats.valid) {
         int image_num_bins(current_stats.histogram_bins.size());
-        if ((num_bins == AUTO_BIN_SIZE) || (num_bins == image_num_bins)) {
+        if (num_bins == AUTO_BIN_SIZE) {
+            num_bins = image_num_bins;
+        }
+        // A coarser histogram is derived when its bins are groups of the stored bins
+        if ((num_bins > 0) && (image_num_bins > 0) && (image_num_bins % num_bins == 0)) {
             double min_val(current_stats.basic_stats[CARTA::StatsType::Min]);
             double max_val(current_stats.basic_stats[CARTA::StatsType::Max]);
             double mean(current_stats.basic_stats[CARTA::StatsType::Mean]);
             double std_dev(current_stats.basic_stats[CARTA::StatsType::Sigma]);
 
             // fill message
-            histogram->set_num_bins(image_num_bins);
-            histogram->set_bin_width((max_val - min_val) / image_num_bins);
+            histogram->set_num_bins(num_bins);
+            histogram->set_bin_width((max_val - min_val) / num_bins);
             histogram->set_first_bin_center(min_val + (histogram->bin_width() / 2.0));
-            *histogram->mutable_bins() = {current_stats.histogram_bins.begin(), current_stats.histogram_bins.end()};
+            if (num_bins == image_num_bins) {
+                *histogram->mutable_bins() = {current_stats.histogram_bins.begin(), current_stats.histogram_bins.end()};
+            } else {
+                int group_size(image_num_bins / num_bins);
+                auto bins = histogram->mutable_bins();
+                bins->Resize(num_bins, 0);
+                for (int i = 0; i < image_num_bins; ++i) {
+                    bins->Set(i / group_size, bins->Get(i / group_size) + current_stats.histogram_bins[i]);
+                }
+            }
             histogram->set_mean(mean);
             histogram->set_std_dev(std_dev);
             // histogram cached in loader
@@ -707,19 +1520,16 @@ bool Frame::GetBasicStats(int z, int stokes, carta::BasicStats<float>& stats) {
         }
         return false; // calculate and cache in Session
     } else {
-        int cache_key(CacheKey(z, stokes));
-        if (_image_basic_stats.count(cache_key)) {
-            stats = _image_basic_stats[cache_key]; // get from cache
+        if (GetCachedBasicStats(z, stokes, stats)) {
             return true;
         }
 
-        if ((z == CurrentZ()) && (stokes == CurrentStokes())) {
+        int cache_key(CacheKey(z, stokes));
+        auto plane = GetCachedPlane(z, stokes);
+        if (plane && plane->image) {
             // calculate histogram from image cache
-            if (_image_cache.empty() && !FillImageCache()) {
-                // cannot calculate
-                return false;
-            }
-            CalcBasicStats(_image_cache, stats);
+            carta::GpuCompute::PlaneScope gpu_plane(plane->image, plane->image->data());
+            CalcBasicStats(*plane->image, stats);
             _image_basic_stats[cache_key] = stats;
             return true;
         }
@@ -736,19 +1546,32 @@ bool Frame::GetBasicStats(int z, int stokes, carta::BasicStats<float>& stats) {
     return false;
 }
 
+bool Frame::GetCachedBasicStats(int z, int stokes, carta::BasicStats<float>& stats) {
+    // Return basic stats for a single z from frame or loader cache
+    int cache_key(CacheKey(z, stokes));
+    if (_image_basic_stats.count(cache_key)) {
+        stats = _image_basic_stats[cache_key]; // get from cache
+        return true;
+    }
+
+    auto loader_stats = _loader->GetImageStats(stokes, z, _image_mutex);
+    if (loader_stats.valid && loader_stats.full) {
+        // get from loader cache
+        auto& basic_stats = loader_stats.basic_stats;
+        stats = BasicStats<float>(basic_stats[CARTA::StatsType::NumPixels], basic_stats[CARTA::StatsType::Sum],
+            basic_stats[CARTA::StatsType::Mean], basic_stats[CARTA::StatsType::Sigma], basic_stats[CARTA::StatsType::Min],
+            basic_stats[CARTA::StatsType::Max], basic_stats[CARTA::StatsType::RMS], basic_stats[CARTA::StatsType::SumSq]);
+        _image_basic_stats[cache_key] = stats;
+        return true;
+    }
+    return false;
+}
+
 bool Frame::GetCachedImageHistogram(int z, int stokes, int num_bins, carta::Histogram& hist) {
     // Get image histogram results from cache
     int cache_key(CacheKey(z, stokes));
     if (_image_histograms.count(cache_key)) {
-        // get from cache if correct num_bins
-        auto results_for_key = _image_histograms[cache_key];
-
-        for (auto& result : results_for_key) {
-            if (result.GetNbins() == num_bins) {
-                hist = result;
-                return true;
-            }
-        }
+        return FindCachedHistogram(_image_histograms[cache_key], num_bins, hist);
     }
     return false;
 }
@@ -756,12 +1579,22 @@ bool Frame::GetCachedImageHistogram(int z, int stokes, int num_bins, carta::Hist
 bool Frame::GetCachedCubeHistogram(int stokes, int num_bins, Histogram& hist) {
     // Get cube histogram results from cache
     if (_cube_histograms.count(stokes)) {
-        for (auto& result : _cube_histograms[stokes]) {
-            // get from cache if correct num_bins
-            if (result.GetNbins() == num_bins) {
-                hist = result;
-                return true;
-            }
+        return FindCachedHistogram(_cube_histograms[stokes], num_bins, hist);
+    }
+    return false;
+}
+
+bool Frame::FindCachedHistogram(const std::vector<carta::Histogram>& results, int num_bins, carta::Histogram& hist) {
+    // Histogram with num_bins, else one derived from a histogram with a multiple of num_bins over the same stats range
+    for (auto& result : results) {
+        if (result.GetNbins() == num_bins) {
+            hist = result;
+            return true;
+        }
+    }
+    for (auto& result : results) {
+        if (result.Rebin(num_bins, hist)) {
+            return true;
         }
     }
     return false;
@@ -781,14 +1614,11 @@ bool Frame::CalculateHistogram(int region_id, int z, int stokes, int num_bins, B
         num_bins = AutoBinSize();
     }
 
-    if ((z == CurrentZ()) && (stokes == CurrentStokes())) {
-        // calculate histogram from current image cache
-        if (_image_cache.empty() && !FillImageCache()) {
-            return false;
-        }
-        bool write_lock(false);
-        tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, write_lock);
-        hist = CalcHistogram(num_bins, stats, _image_cache);
+    auto plane = GetCachedPlane(z, stokes);
+    if (plane && plane->image) {
+        // calculate histogram from image cache
+        carta::GpuCompute::PlaneScope gpu_plane(plane->image, plane->image->data());
+        hist = CalcHistogram(num_bins, stats, *plane->image);
     } else {
         // calculate histogram for z/stokes data
         std::vector<float> data;
@@ -802,6 +1632,41 @@ bool Frame::CalculateHistogram(int region_id, int z, int stokes, int num_bins, B
         _image_histograms[cache_key].push_back(hist);
     }
 
+    // share channel stats and histogram with later sessions; cube histograms use cube stats for the bounds
+    if (region_id == IMAGE_REGION_ID) {
+        _loader->SaveImageStats(stokes, z, stats, hist);
+    }
+
+    return true;
+}
+
+bool Frame::CalculateStatsAndHistogram(int z, int stokes, int num_bins, BasicStats<float>& stats, Histogram& hist) {
+    // Calculate image histogram; stats which are not cached are calculated in the same pass over the data
+    int cache_key(CacheKey(z, stokes));
+    if (GetCachedBasicStats(z, stokes, stats)) {
+        return CalculateHistogram(IMAGE_REGION_ID, z, stokes, num_bins, stats, hist);
+    }
+
+    if (num_bins == AUTO_BIN_SIZE) {
+        num_bins = AutoBinSize();
+    }
+
+    auto plane = GetCachedPlane(z, stokes);
+    if (plane && plane->image) {
+        // calculate from image cache
+        carta::GpuCompute::PlaneScope gpu_plane(plane->image, plane->image->data());
+        CalcStatsAndHistogram(*plane->image, num_bins, stats, hist);
+    } else {
+        // calculate for z/stokes data
+        std::vector<float> data;
+        GetZMatrix(data, z, stokes);
+        CalcStatsAndHistogram(data, num_bins, stats, hist);
+    }
+
+    // cache results, and share them with later sessions
+    _image_basic_stats[cache_key] = stats;
+    _image_histograms[cache_key].push_back(hist);
+    _loader->SaveImageStats(stokes, z, stats, hist);
     return true;
 }
 
@@ -819,6 +1684,208 @@ void Frame::CacheCubeStats(int stokes, carta::BasicStats<float>& stats) {
 
 void Frame::CacheCubeHistogram(int stokes, carta::Histogram& hist) {
     _cube_histograms[stokes].push_back(hist);
+
+    // share cube stats and histogram with later sessions
+    if (_cube_basic_stats.count(stokes)) {
+        _loader->SaveImageStats(stokes, ALL_Z, _cube_basic_stats[stokes], hist);
+    }
+}
+
+// Channel data, and its results, in flight in the cube stats and histogram pipelines
+struct CubeChannel {
+    size_t z;
+    std::vector<float> data;
+    BasicStats<float> stats;
+    carta::QuantileSketch sketch;
+    carta::Histogram histogram;
+};
+using CubeChannelPtr = std::shared_ptr<CubeChannel>;
+
+size_t Frame::CubeHistogramChannels() {
+    // Number of planes in memory at once
+    size_t plane_size_mb = (sizeof(float) * _width * _height) / (1024 * 1024);
+    return std::max(std::min((size_t)CUBE_HISTOGRAM_CHANNELS, CUBE_HISTOGRAM_MAX_MB / std::max(plane_size_mb, (size_t)1)), (size_t)1);
+}
+
+bool Frame::CalculateCubeStats(int stokes, BasicStats<float>& cube_stats, const CubeProgressCallback& progress_callback) {
+    // Join cached channel stats, and calculate the others; each channel calculated is cached, so a cancelled calculation resumes
+    // Cube quantile sketch is complete only if every channel sketch is available
+    std::vector<size_t> uncached_z;
+    cube_stats = BasicStats<float>();
+    carta::QuantileSketch cube_sketch;
+    bool have_sketches(true);
+    for (size_t z = 0; z < _depth; ++z) {
+        BasicStats<float> z_stats;
+        if (GetCachedBasicStats(z, stokes, z_stats)) {
+            cube_stats.join(z_stats);
+            auto sketch_iter = _image_quantile_sketches.find(CacheKey(z, stokes));
+            if (sketch_iter != _image_quantile_sketches.end()) {
+                cube_sketch.join(sketch_iter->second);
+            } else {
+                have_sketches = false;
+            }
+        } else {
+            uncached_z.push_back(z);
+        }
+    }
+
+    size_t num_z_done(_depth - uncached_z.size());
+    std::atomic<bool> cancelled(!progress_callback(num_z_done));
+    size_t next_index(0);
+
+    // Read channels in order, calculate in parallel, then cache and join in order
+    auto read_channel = [&](tbb::flow_control& fc) -> CubeChannelPtr {
+        if (cancelled || (next_index == uncached_z.size())) {
+            fc.stop();
+            return nullptr;
+        }
+        auto channel = std::make_shared<CubeChannel>();
+        channel->z = uncached_z[next_index++];
+        GetZMatrix(channel->data, channel->z, stokes);
+        return channel;
+    };
+    auto calculate_stats = [&](CubeChannelPtr channel) {
+        CalcBasicStats(channel->data, channel->stats);
+        channel->sketch.Add(channel->data.data(), channel->data.size());
+        std::vector<float>().swap(channel->data);
+        return channel;
+    };
+    auto add_stats = [&](CubeChannelPtr channel) {
+        _image_basic_stats[CacheKey(channel->z, stokes)] = channel->stats;
+        cube_stats.join(channel->stats);
+        cube_sketch.join(channel->sketch);
+        _image_quantile_sketches[CacheKey(channel->z, stokes)] = std::move(channel->sketch);
+        if (!progress_callback(++num_z_done)) {
+            cancelled = true;
+        }
+    };
+    tbb::parallel_pipeline(CubeHistogramChannels(),
+        tbb::make_filter<void, CubeChannelPtr>(tbb::filter::serial_in_order, read_channel) &
+            tbb::make_filter<CubeChannelPtr, CubeChannelPtr>(tbb::filter::parallel, calculate_stats) &
+            tbb::make_filter<CubeChannelPtr, void>(tbb::filter::serial_in_order, add_stats));
+
+    bool completed = !cancelled && (num_z_done == _depth);
+    if (completed && have_sketches) {
+        _cube_quantile_sketches[stokes] = std::move(cube_sketch);
+    }
+    return completed;
+}
+
+bool Frame::CalculateCubeHistogram(int stokes, int num_bins, const BasicStats<float>& cube_stats, Histogram& cube_histogram,
+    const CubeHistogramCallback& progress_callback) {
+    // Accumulate channel histograms using the cube stats; channels done are kept, so a cancelled calculation resumes
+    if (num_bins == AUTO_BIN_SIZE) {
+        num_bins = AutoBinSize();
+    }
+
+    auto& progress = _cube_histogram_progress[stokes];
+    if (progress.num_bins != num_bins) {
+        progress.num_bins = num_bins;
+        progress.next_z = 0;
+        progress.histogram = carta::Histogram();
+    }
+
+    std::atomic<bool> cancelled(false);
+    size_t next_z(progress.next_z);
+
+    // Read channels in order, calculate in parallel, then add in order
+    auto read_channel = [&](tbb::flow_control& fc) -> CubeChannelPtr {
+        if (cancelled || (next_z == _depth)) {
+            fc.stop();
+            return nullptr;
+        }
+        auto channel = std::make_shared<CubeChannel>();
+        channel->z = next_z++;
+        GetZMatrix(channel->data, channel->z, stokes);
+        return channel;
+    };
+    auto calculate_histogram = [&](CubeChannelPtr channel) {
+        channel->histogram = CalcHistogram(num_bins, cube_stats, channel->data);
+        std::vector<float>().swap(channel->data);
+        return channel;
+    };
+    auto add_histogram = [&](CubeChannelPtr channel) {
+        if (channel->z == 0) {
+            progress.histogram = std::move(channel->histogram);
+        } else {
+            progress.histogram.Add(channel->histogram);
+        }
+        progress.next_z = channel->z + 1;
+        if (_depth == 1) {
+            // cube stats are the image stats
+            _image_histograms[CacheKey(channel->z, stokes)].push_back(progress.histogram);
+        }
+        if (!progress_callback(progress.next_z, progress.histogram)) {
+            cancelled = true;
+        }
+    };
+    tbb::parallel_pipeline(CubeHistogramChannels(),
+        tbb::make_filter<void, CubeChannelPtr>(tbb::filter::serial_in_order, read_channel) &
+            tbb::make_filter<CubeChannelPtr, CubeChannelPtr>(tbb::filter::parallel, calculate_histogram) &
+            tbb::make_filter<CubeChannelPtr, void>(tbb::filter::serial_in_order, add_histogram));
+
+    if (cancelled || (progress.next_z < _depth)) {
+        return false;
+    }
+
+    cube_histogram = progress.histogram;
+    _cube_histogram_progress.erase(stokes);
+    return true;
+}
+
+carta::RemoteJob Frame::CalculateRemoteCubeHistogram(int stokes, int num_bins, BasicStats<float>& cube_stats, Histogram& cube_histogram,
+    const std::function<bool(float progress)>& progress_callback) {
+    if (!_remote_jobs || GetFileName().empty()) {
+        return carta::RemoteJob::Unavailable;
+    }
+    if (num_bins == AUTO_BIN_SIZE) {
+        num_bins = AutoBinSize();
+    }
+    return carta::WorkerPool::Global().CalculateCubeHistogram(
+        GetFileName(), _hdu, stokes, num_bins, progress_callback, cube_stats, cube_histogram);
+}
+
+bool Frame::GetPercentiles(int z, int stokes, const std::vector<float>& ranks, std::vector<float>& percentiles) {
+    // Use percentiles from the file if it has all the ranks requested
+    auto loader_stats = _loader->GetImageStats(stokes, z, _image_mutex);
+    if (loader_stats.valid && !loader_stats.percentile_ranks.empty()) {
+        percentiles.clear();
+        for (auto rank : ranks) {
+            auto& file_ranks = loader_stats.percentile_ranks;
+            auto it = std::find(file_ranks.begin(), file_ranks.end(), rank);
+            if (it == file_ranks.end()) {
+                break;
+            }
+            percentiles.push_back(loader_stats.percentiles[it - file_ranks.begin()]);
+        }
+        if (percentiles.size() == ranks.size()) {
+            return true;
+        }
+    }
+
+    if (z == ALL_Z) {
+        if (_cube_quantile_sketches.count(stokes)) {
+            percentiles = _cube_quantile_sketches[stokes].Percentiles(ranks);
+            return true;
+        }
+        return false; // calculated with cube stats
+    }
+
+    int cache_key(CacheKey(z, stokes));
+    if (!_image_quantile_sketches.count(cache_key)) {
+        carta::QuantileSketch sketch;
+        auto plane = GetCachedPlane(z, stokes);
+        if (plane && plane->image) {
+            sketch.Add(plane->image->data(), plane->image->size());
+        } else {
+            std::vector<float> data;
+            GetZMatrix(data, z, stokes);
+            sketch.Add(data.data(), data.size());
+        }
+        _image_quantile_sketches[cache_key] = std::move(sketch);
+    }
+    percentiles = _image_quantile_sketches[cache_key].Percentiles(ranks);
+    return true;
 }
 
 // ****************************************************
@@ -848,7 +1915,7 @@ bool Frame::FillRegionStatsData(int region_id, CARTA::RegionStatsData& stats_dat
     stats_data.set_stokes(stokes);
 
     // Use loader image stats
-    auto& image_stats = _loader->GetImageStats(stokes, z);
+    auto image_stats = _loader->GetImageStats(stokes, z, _image_mutex);
     if (image_stats.full) {
         FillStatisticsValuesFromMap(stats_data, _image_required_stats, image_stats.basic_stats);
         return true;
@@ -883,6 +1950,7 @@ bool Frame::FillRegionStatsData(int region_id, CARTA::RegionStatsData& stats_dat
 
         auto t_end_image_stats = std::chrono::high_resolution_clock::now();
         auto dt_image_stats = std::chrono::duration_cast<std::chrono::microseconds>(t_end_image_stats - t_start_image_stats).count();
+        carta::LatencyHistograms::Record(carta::LatencyPoint::RegionStats, dt_image_stats);
         spdlog::performance("Fill image stats in {:.3f} ms", dt_image_stats * 1e-3);
 
         return true;
@@ -901,7 +1969,7 @@ bool Frame::SetSpatialRequirements(int region_id, const std::vector<std::string>
 
     _cursor_spatial_configs.clear();
     for (auto& profile : spatial_profiles) {
-        _cursor_spatial_configs.push_back(profile);
+        _cursor_spatial_configs.push_back(SpatialConfig(profile));
     }
     return true;
 }
@@ -923,58 +1991,91 @@ bool Frame::FillSpatialProfileData(int region_id, CARTA::SpatialProfileData& spa
     ssize_t num_image_cols(_width), num_image_rows(_height);
     int x, y;
     _cursor.ToIndex(x, y); // convert float to index into image array
+
+    // The cached plane is kept so that the value and profiles are of one channel, even if it changes meanwhile
+    int z(CurrentZ()), stokes(CurrentStokes());
+    auto plane = GetCachedPlane(z, stokes);
     float cursor_value(0.0);
-    if (!_image_cache.empty()) {
-        bool write_lock(false);
-        tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, write_lock);
-        cursor_value = _image_cache[(y * num_image_cols) + x];
-        cache_lock.release();
+    if (!plane) {
+        std::vector<float> cursor_data;
+        if (GetSlicerData(GetImageSlicer(AxisRange(x), AxisRange(y), AxisRange(z), stokes), cursor_data)) {
+            cursor_value = cursor_data[0];
+        }
+    } else if (plane->compact) {
+        cursor_value = plane->compact->Value((y * num_image_cols) + x);
+    } else {
+        cursor_value = (*plane->image)[(y * num_image_cols) + x];
     }
 
     // set message fields
     spatial_data.set_x(x);
     spatial_data.set_y(y);
-    spatial_data.set_channel(CurrentZ());
-    spatial_data.set_stokes(CurrentStokes());
+    spatial_data.set_channel(z);
+    spatial_data.set_stokes(stokes);
     spatial_data.set_value(cursor_value);
 
     // add profiles
-    int end(0);
     std::vector<float> profile;
-    bool write_lock(false);
-    for (auto& coordinate : _cursor_spatial_configs) { // string coordinate
+    for (auto& config : _cursor_spatial_configs) {
+        const std::string& coordinate = config.coordinate;
+        if (coordinate != "x" && coordinate != "y") {
+            continue;
+        }
+
+        // Viewport range, and whether to send a min/max envelope instead of every pixel
+        int length = (coordinate == "x" ? _width : _height);
+        int start = std::min(config.start, length);
+        int end = (config.end > start) ? std::min(config.end, length) : length;
+        bool envelope = (config.width > 0) && (end - start > 2 * config.width);
+
         bool have_profile(false);
         // can no longer select stokes, so can use image cache
-        if (coordinate == "x") {
-            tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, write_lock);
-            auto x_start = y * num_image_cols;
-            profile.clear();
-            profile.reserve(_width);
-            for (unsigned int j = 0; j < _width; ++j) {
-                auto idx = x_start + j;
-                profile.push_back(_image_cache[idx]);
+        if (!plane) {
+            AxisRange x_range = (coordinate == "x" ? AxisRange(start, end - 1) : AxisRange(x));
+            AxisRange y_range = (coordinate == "x" ? AxisRange(y) : AxisRange(start, end - 1));
+            std::vector<float> slicer_data;
+            have_profile = GetSlicerData(GetImageSlicer(x_range, y_range, AxisRange(z), stokes), slicer_data);
+            if (have_profile && envelope) {
+                MinMaxEnvelope(slicer_data.data(), 1, slicer_data.size(), config.width, profile);
+            } else {
+                profile.swap(slicer_data);
+            }
+        } else if (plane->compact) {
+            // Row decoded, or column gathered, from the compact plane
+            std::vector<float> line_data(end - start);
+            if (coordinate == "x") {
+                plane->compact->Decode(y * num_image_cols + start, end - start, line_data.data());
+            } else {
+                for (int i = 0; i < end - start; ++i) {
+                    line_data[i] = plane->compact->Value((start + i) * num_image_cols + x);
+                }
+            }
+            if (envelope) {
+                MinMaxEnvelope(line_data.data(), 1, line_data.size(), config.width, profile);
+            } else {
+                profile.swap(line_data);
             }
-            cache_lock.release();
-            end = _width;
             have_profile = true;
-        } else if (coordinate == "y") {
-            tbb::queuing_rw_mutex::scoped_lock cache_lock(_cache_mutex, write_lock);
-            profile.clear();
-            profile.reserve(_height);
-            for (unsigned int j = 0; j < _height; ++j) {
-                auto idx = (j * num_image_cols) + x;
-                profile.push_back(_image_cache[idx]);
+        } else {
+            // Row or column of the image cache, read in place
+            int64_t stride = (coordinate == "x" ? 1 : num_image_cols);
+            const float* data = plane->image->data() + (coordinate == "x" ? y * num_image_cols + start : start * num_image_cols + x);
+            if (envelope) {
+                MinMaxEnvelope(data, stride, end - start, config.width, profile);
+            } else {
+                profile.resize(end - start);
+                for (int i = 0; i < end - start; ++i) {
+                    profile[i] = data[i * stride];
+                }
             }
-            cache_lock.release();
-            end = _height;
             have_profile = true;
         }
 
         if (have_profile) {
-            // add SpatialProfile to message
+            // add SpatialProfile to message; an envelope has two values per bin rather than one per pixel
             auto spatial_profile = spatial_data.add_profiles();
             spatial_profile->set_coordinate(coordinate);
-            spatial_profile->set_start(0);
+            spatial_profile->set_start(start);
             spatial_profile->set_end(end);
             spatial_profile->set_raw_values_fp32(profile.data(), profile.size() * sizeof(float));
         }
@@ -1025,7 +2126,7 @@ bool Frame::SetSpectralRequirements(int region_id, const std::vector<CARTA::SetS
     }
 
     // Set cursor spectral config
-    std::lock_guard<std::mutex> guard(_spectral_mutex);
+    auto guard = carta::TimedLock(_spectral_mutex, carta::RequestPhase::SpectralLock);
     _cursor_spectral_configs = new_configs;
     return true;
 }
@@ -1054,10 +2155,13 @@ bool Frame::FillSpectralProfileData(std::function<void(CARTA::SpectralProfileDat
     auto t_start_spectral_profile = std::chrono::high_resolution_clock::now();
 
     std::vector<SpectralConfig> current_configs;
-    std::unique_lock<std::mutex> ulock(_spectral_mutex);
+    auto ulock = carta::TimedLock(_spectral_mutex, carta::RequestPhase::SpectralLock);
     current_configs.insert(current_configs.begin(), _cursor_spectral_configs.begin(), _cursor_spectral_configs.end());
     ulock.unlock();
 
+    // Profiles to send, with their stokes index
+    bool in_image = start_cursor.InImage(_image_shape(0), _image_shape(1));
+    std::vector<std::pair<SpectralConfig, int>> profiles;
     for (auto& config : current_configs) {
         if (!(_cursor == start_cursor) || !IsConnected()) {
             // cursor changed or file closed, cancel profiles
@@ -1073,137 +2177,198 @@ bool Frame::FillSpectralProfileData(std::function<void(CARTA::SpectralProfileDat
             continue; // do not send fixed stokes profile when stokes changes
         }
 
-        // Create final profile message for callback
-        CARTA::SpectralProfileData profile_message;
-        profile_message.set_stokes(CurrentStokes());
-        profile_message.set_progress(1.0);
-        auto spectral_profile = profile_message.add_profiles();
-        spectral_profile->set_coordinate(config.coordinate);
-        // point spectral profiles only have one stats type
-        spectral_profile->set_stats_type(config.all_stats[0]);
+        if (!in_image) {
+            // Profile without data when the cursor is outside the image
+            cb(CursorSpectralProfileMessage(config, 1.0));
+            continue;
+        }
+        int stokes;
+        if (!GetStokesTypeIndex(coordinate, stokes)) {
+            continue;
+        }
+        if (stokes < 0) {
+            stokes = CurrentStokes();
+        }
+        profiles.emplace_back(config, stokes);
+    }
+
+    // Loader data for all stokes in one read, else image slices for the range of the stokes in one pass; computed stokes are
+    // sliced separately
+    std::vector<int> loader_stokes;
+    for (auto& profile : profiles) {
+        if (!carta::IsComputedStokes(profile.second) &&
+            (std::find(loader_stokes.begin(), loader_stokes.end(), profile.second) == loader_stokes.end())) {
+            loader_stokes.push_back(profile.second);
+        }
+    }
+    std::vector<std::vector<float>> loader_spectra;
+    if (!loader_stokes.empty() && !_loader->GetCursorStokesSpectra(loader_spectra, loader_stokes, (start_cursor.x + 0.5),
+                                      (start_cursor.y + 0.5), _image_mutex)) {
+        loader_spectra.clear();
+    }
 
-        // Send spectral profile data if cursor inside image
-        if (start_cursor.InImage(_image_shape(0), _image_shape(1))) {
-            int stokes;
-            if (!GetStokesTypeIndex(coordinate, stokes)) {
-                continue;
+    std::vector<std::pair<SpectralConfig, int>> sliced_profiles;
+    for (auto& profile : profiles) {
+        if (carta::IsComputedStokes(profile.second)) {
+            if (!FillCursorSpectralSlices(cb, start_cursor, {profile})) {
+                return false;
             }
-            if (stokes < 0) {
-                stokes = CurrentStokes();
+        } else if (loader_spectra.empty()) {
+            sliced_profiles.push_back(profile);
+        } else {
+            if (!(_cursor == start_cursor) || !IsConnected()) {
+                return false;
             }
-
-            std::vector<float> spectral_data;
-            int xy_count(1);
-            if (_loader->GetCursorSpectralData(
-                    spectral_data, stokes, (start_cursor.x + 0.5), xy_count, (start_cursor.y + 0.5), xy_count, _image_mutex)) {
-                // Use loader data
-                spectral_profile->set_raw_values_fp32(spectral_data.data(), spectral_data.size() * sizeof(float));
-                cb(profile_message);
-            } else {
-                // Send image slices
-                // Set up slicer
-                int x_index, y_index;
-                start_cursor.ToIndex(x_index, y_index);
-                casacore::IPosition start(_image_shape.size());
-                start(0) = x_index;
-                start(1) = y_index;
-                start(_z_axis) = 0;
-                if (_stokes_axis >= 0) {
-                    start(_stokes_axis) = stokes;
-                }
-                casacore::IPosition count(_image_shape.size(), 1); // will adjust count for z axis
-
-                // Send incremental spectral profile when reach delta z or delta time
-                size_t delta_z = INIT_DELTA_Z;                         // the increment of channels for each slice (to be adjusted)
-                size_t dt_slice_target = TARGET_DELTA_TIME;            // target time elapse for each slice, in milliseconds
-                size_t dt_partial_update = TARGET_PARTIAL_CURSOR_TIME; // time increment to send an update
-                size_t profile_size = Depth();                         // profile vector size
-                spectral_data.resize(profile_size, NAN);
-                float progress(0.0);
-
-                auto t_start_profile = std::chrono::high_resolution_clock::now();
-
-                while (progress < PROFILE_COMPLETE) {
-                    // start timer for slice
-                    auto t_start_slice = std::chrono::high_resolution_clock::now();
-
-                    // Slice image to get next delta_z (not to exceed depth in image)
-                    size_t nz = (start(_z_axis) + delta_z < profile_size ? delta_z : profile_size - start(_z_axis));
-                    count(_z_axis) = nz;
-                    casacore::Slicer slicer(start, count);
-                    std::vector<float> buffer;
-                    if (!GetSlicerData(slicer, buffer)) {
-                        return false;
-                    }
-
-                    // copy buffer to spectral_data
-                    memcpy(&spectral_data[start(_z_axis)], buffer.data(), nz * sizeof(float));
-
-                    // update start z and determine progress
-                    start(_z_axis) += nz;
-                    progress = (float)start(_z_axis) / profile_size;
-
-                    // get the time elapse for this slice
-                    auto t_end_slice = std::chrono::high_resolution_clock::now();
-                    auto dt_slice = std::chrono::duration<double, std::milli>(t_end_slice - t_start_slice).count();
-                    auto dt_profile = std::chrono::duration<double, std::milli>(t_end_slice - t_start_profile).count();
-
-                    // adjust delta z per slice according to the time elapse,
-                    // to achieve target elapsed time per slice TARGET_DELTA_TIME (used to check for cancel)
-                    if (delta_z == INIT_DELTA_Z) {
-                        delta_z *= dt_slice_target / dt_slice;
-                        if (delta_z < 1) {
-                            delta_z = 1;
-                        }
-                        if (delta_z > profile_size) {
-                            delta_z = profile_size;
-                        }
-                    }
-
-                    // Check for cancel before sending
-                    if (!(_cursor == start_cursor) || !IsConnected()) { // cursor changed or file closed, cancel all profiles
-                        return false;
-                    }
-                    if (!HasSpectralConfig(config)) {
-                        // requirements changed, cancel this profile
-                        break;
-                    }
-
-                    if (progress >= PROFILE_COMPLETE) {
-                        spectral_profile->set_raw_values_fp32(spectral_data.data(), spectral_data.size() * sizeof(float));
-                        // send final profile message
-                        cb(profile_message);
-                    } else if (dt_profile > dt_partial_update) {
-                        // reset profile timer and send partial profile message
-                        t_start_profile = t_end_slice;
-
-                        CARTA::SpectralProfileData partial_data;
-                        partial_data.set_stokes(CurrentStokes());
-                        partial_data.set_progress(progress);
-                        auto partial_profile = partial_data.add_profiles();
-                        partial_profile->set_stats_type(config.all_stats[0]);
-                        partial_profile->set_coordinate(config.coordinate);
-                        partial_profile->set_raw_values_fp32(spectral_data.data(), spectral_data.size() * sizeof(float));
-                        cb(partial_data);
-                    }
-                }
+            if (!HasSpectralConfig(profile.first)) {
+                continue;
             }
+            // Use loader data
+            auto& spectral_data =
+                loader_spectra[std::find(loader_stokes.begin(), loader_stokes.end(), profile.second) - loader_stokes.begin()];
+            auto profile_message = CursorSpectralProfileMessage(profile.first, 1.0);
+            profile_message.mutable_profiles(0)->set_raw_values_fp32(spectral_data.data(), spectral_data.size() * sizeof(float));
+            cb(profile_message);
         }
     }
+    if (!sliced_profiles.empty() && !FillCursorSpectralSlices(cb, start_cursor, sliced_profiles)) {
+        return false;
+    }
 
     auto t_end_spectral_profile = std::chrono::high_resolution_clock::now();
     auto dt_spectral_profile =
         std::chrono::duration_cast<std::chrono::microseconds>(t_end_spectral_profile - t_start_spectral_profile).count();
+    carta::LatencyHistograms::Record(carta::LatencyPoint::SpectralProfile, dt_spectral_profile);
     spdlog::performance("Fill cursor spectral profile in {:.3f} ms", dt_spectral_profile * 1e-3);
 
     return true;
 }
 
+CARTA::SpectralProfileData Frame::CursorSpectralProfileMessage(const SpectralConfig& config, float progress) {
+    CARTA::SpectralProfileData profile_message;
+    profile_message.set_stokes(CurrentStokes());
+    profile_message.set_progress(progress);
+    auto spectral_profile = profile_message.add_profiles();
+    spectral_profile->set_coordinate(config.coordinate);
+    // point spectral profiles only have one stats type
+    spectral_profile->set_stats_type(config.all_stats[0]);
+    return profile_message;
+}
+
+bool Frame::FillCursorSpectralSlices(std::function<void(CARTA::SpectralProfileData profile_data)> cb, PointXy start_cursor,
+    const std::vector<std::pair<SpectralConfig, int>>& profiles) {
+    // Send image slices of the range of the stokes of the profiles (one computed stokes, or any others)
+    int min_stokes(profiles[0].second), max_stokes(profiles[0].second);
+    for (auto& profile : profiles) {
+        min_stokes = std::min(min_stokes, profile.second);
+        max_stokes = std::max(max_stokes, profile.second);
+    }
+    size_t num_stokes = max_stokes - min_stokes + 1;
+
+    // Set up slicer
+    int x_index, y_index;
+    start_cursor.ToIndex(x_index, y_index);
+    casacore::IPosition start(_image_shape.size());
+    start(0) = x_index;
+    start(1) = y_index;
+    start(_z_axis) = 0;
+    casacore::IPosition count(_image_shape.size(), 1); // will adjust count for z axis
+    if (_stokes_axis >= 0) {
+        start(_stokes_axis) = min_stokes;
+        count(_stokes_axis) = num_stokes;
+    }
+    // Slice offset of a stokes index and z
+    bool z_first = (_stokes_axis < 0) || (_z_axis < _stokes_axis);
+
+    // Send incremental spectral profile when reach delta z or delta time
+    size_t delta_z = INIT_DELTA_Z;                         // the increment of channels for each slice (to be adjusted)
+    size_t dt_slice_target = TARGET_DELTA_TIME;            // target time elapse for each slice, in milliseconds
+    size_t dt_partial_update = TARGET_PARTIAL_CURSOR_TIME; // time increment to send an update
+    size_t profile_size = Depth();                         // profile vector size
+    std::vector<std::vector<float>> spectral_data(num_stokes, std::vector<float>(profile_size, NAN));
+    std::vector<bool> active(profiles.size(), true);
+    float progress(0.0);
+
+    auto t_start_profile = std::chrono::high_resolution_clock::now();
+
+    while (progress < PROFILE_COMPLETE) {
+        // start timer for slice
+        auto t_start_slice = std::chrono::high_resolution_clock::now();
+
+        // Slice image to get next delta_z (not to exceed depth in image)
+        size_t z_start = start(_z_axis);
+        size_t nz = (z_start + delta_z < profile_size ? delta_z : profile_size - z_start);
+        count(_z_axis) = nz;
+        casacore::Slicer slicer(start, count);
+        std::vector<float> buffer;
+        if (!GetSlicerData(slicer, buffer)) {
+            return false;
+        }
+
+        // copy buffer to spectral_data of each stokes
+        for (size_t s = 0; s < num_stokes; ++s) {
+            for (size_t z = 0; z < nz; ++z) {
+                spectral_data[s][z_start + z] = buffer[z_first ? (s * nz + z) : (z * num_stokes + s)];
+            }
+        }
+
+        // update start z and determine progress
+        start(_z_axis) += nz;
+        progress = (float)start(_z_axis) / profile_size;
+
+        // get the time elapse for this slice
+        auto t_end_slice = std::chrono::high_resolution_clock::now();
+        auto dt_slice = std::chrono::duration<double, std::milli>(t_end_slice - t_start_slice).count();
+        auto dt_profile = std::chrono::duration<double, std::milli>(t_end_slice - t_start_profile).count();
+
+        // adjust delta z per slice according to the time elapse,
+        // to achieve target elapsed time per slice TARGET_DELTA_TIME (used to check for cancel)
+        if (delta_z == INIT_DELTA_Z) {
+            delta_z *= dt_slice_target / dt_slice;
+            if (delta_z < 1) {
+                delta_z = 1;
+            }
+            if (delta_z > profile_size) {
+                delta_z = profile_size;
+            }
+        }
+
+        // Check for cancel before sending
+        if (!(_cursor == start_cursor) || !IsConnected()) { // cursor changed or file closed, cancel all profiles
+            return false;
+        }
+        bool send_partial = (progress < PROFILE_COMPLETE) && (dt_profile > dt_partial_update);
+        if (send_partial) {
+            // reset profile timer before sending partial profile messages
+            t_start_profile = t_end_slice;
+        }
+        bool any_active(false);
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            if (!active[i] || !HasSpectralConfig(profiles[i].first)) {
+                // requirements changed, cancel this profile
+                active[i] = false;
+                continue;
+            }
+            any_active = true;
+            if ((progress >= PROFILE_COMPLETE) || send_partial) {
+                // send final or partial profile message
+                auto& stokes_data = spectral_data[profiles[i].second - min_stokes];
+                auto profile_message = CursorSpectralProfileMessage(profiles[i].first, std::min(progress, 1.0f));
+                profile_message.mutable_profiles(0)->set_raw_values_fp32(stokes_data.data(), stokes_data.size() * sizeof(float));
+                cb(profile_message);
+            }
+        }
+        if (!any_active) {
+            break;
+        }
+    }
+    return true;
+}
+
 bool Frame::HasSpectralConfig(const SpectralConfig& config) {
     // Check if requirement is still set.
     // Currently can only set stokes for cursor, do not check stats type
     std::vector<SpectralConfig> current_configs;
-    std::unique_lock<std::mutex> ulock(_spectral_mutex);
+    auto ulock = carta::TimedLock(_spectral_mutex, carta::RequestPhase::SpectralLock);
     current_configs.insert(current_configs.begin(), _cursor_spectral_configs.begin(), _cursor_spectral_configs.end());
     ulock.unlock();
     for (auto& current_config : current_configs) {
@@ -1252,16 +2417,32 @@ casacore::IPosition Frame::GetRegionShape(const casacore::LattRegionHolder& regi
 
 bool Frame::GetRegionData(const casacore::LattRegionHolder& region, std::vector<float>& data) {
     // Get image data with a region applied
-    auto t_start_get_subimage_data = std::chrono::high_resolution_clock::now();
     casacore::SubImage<float> sub_image;
-    std::unique_lock<std::mutex> ulock(_image_mutex);
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
     bool subimage_ok = _loader->GetSubImage(region, sub_image);
     ulock.unlock();
+    return subimage_ok && GetSubImageData(sub_image, data);
+}
 
-    if (!subimage_ok) {
+bool Frame::GetRegionData(const carta::RegionSpans& spans, int z, int stokes, std::vector<float>& data) {
+    // Read the bounding box and apply the spans, rather than read the mask of a casacore subimage
+    if ((spans.Width() == 0) || (spans.Height() == 0)) {
+        return false;
+    }
+    AxisRange x_range(spans.X(), spans.X() + spans.Width() - 1);
+    AxisRange y_range(spans.Y(), spans.Y() + spans.Height() - 1);
+    if (!GetSlicerData(GetImageSlicer(x_range, y_range, AxisRange(z), stokes), data)) {
         return false;
     }
+    for (int y = 0; y < spans.Height(); ++y) {
+        spans.MaskRow(y, data.data() + (size_t)y * spans.Width());
+    }
+    return true;
+}
 
+bool Frame::GetSubImageData(casacore::SubImage<float>& sub_image, std::vector<float>& data) {
+    // Get data in the subimage bounding box, NaN outside the region
+    auto t_start_get_subimage_data = std::chrono::high_resolution_clock::now();
     casacore::IPosition subimage_shape = sub_image.shape();
     if (subimage_shape.empty()) {
         return false;
@@ -1273,22 +2454,12 @@ bool Frame::GetRegionData(const casacore::LattRegionHolder& region, std::vector<
         casacore::IPosition start(subimage_shape.size(), 0);
         casacore::IPosition count(subimage_shape);
         casacore::Slicer slicer(start, count); // entire subimage
-        std::unique_lock<std::mutex> ulock(_image_mutex);
-        sub_image.doGetSlice(tmp, slicer);
-
-        // Get mask that defines region in subimage bounding box
-        casacore::Array<bool> tmpmask;
-        sub_image.doGetMaskSlice(tmpmask, slicer);
+        auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+        _loader->SetReadPattern(carta::FileLoader::ReadPattern::Region, subimage_shape);
+        // Data with the region mask applied, read into the data vector
+        carta::FileLoader::ReadLatticeSlice(sub_image, tmp, slicer);
         ulock.unlock();
 
-        // Apply mask to data
-        std::vector<bool> datamask = tmpmask.tovector();
-        for (size_t i = 0; i < data.size(); ++i) {
-            if (!datamask[i]) {
-                data[i] = NAN;
-            }
-        }
-
         auto t_end_get_subimage_data = std::chrono::high_resolution_clock::now();
         auto dt_get_subimage_data =
             std::chrono::duration_cast<std::chrono::microseconds>(t_end_get_subimage_data - t_start_get_subimage_data).count();
@@ -1302,71 +2473,330 @@ bool Frame::GetRegionData(const casacore::LattRegionHolder& region, std::vector<
     return false;
 }
 
+bool Frame::GetRegionPixels(const casacore::LattRegionHolder& region, const carta::RegionSpans* spans, int z, int stokes,
+    std::vector<float>& data, casacore::IPosition& shape, casacore::IPosition& blc) {
+    if (spans) {
+        if (!GetRegionData(*spans, z, stokes, data)) {
+            return false;
+        }
+        size_t ndim = ImageShape().size();
+        shape = casacore::IPosition(ndim, 1);
+        shape(0) = spans->Width();
+        shape(1) = spans->Height();
+        blc = casacore::IPosition(ndim, 0);
+        blc(0) = spans->X();
+        blc(1) = spans->Y();
+        if (_z_axis >= 0) {
+            blc(_z_axis) = z;
+        }
+        if (_stokes_axis >= 0) {
+            blc(_stokes_axis) = stokes;
+        }
+        return true;
+    }
+
+    casacore::SubImage<float> sub_image;
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    bool subimage_ok = _loader->GetSubImage(region, sub_image);
+    ulock.unlock();
+    if (!subimage_ok) {
+        return false;
+    }
+    shape = sub_image.shape();
+    blc = sub_image.region().slicer().start();
+    return GetSubImageData(sub_image, data);
+}
+
 bool Frame::GetSlicerData(const casacore::Slicer& slicer, std::vector<float>& data) {
     // Get image data with a slicer applied
     data.resize(slicer.length().product()); // must have vector the right size before share it with Array
     casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
-    std::unique_lock<std::mutex> ulock(_image_mutex);
-    bool data_ok = _loader->GetSlice(tmp, slicer);
-    ulock.unlock();
-    return data_ok;
+    // Loaders with independent read handles do not need to serialise disk access
+    std::unique_lock<std::mutex> ulock;
+    if (!_loader->HasConcurrentReads()) {
+        ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    }
+    return _loader->GetSlice(tmp, slicer);
+}
+
+static bool UseNativeStats(
+    const std::vector<CARTA::StatsType>& required_stats, bool per_z, const casacore::IPosition& shape, double beam_area) {
+    // Native stats give the same results, except for flux density without a single beam or summed over channels
+    if (std::find(required_stats.begin(), required_stats.end(), CARTA::StatsType::FluxDensity) == required_stats.end()) {
+        return true;
+    }
+    return !std::isnan(beam_area) && (per_z || (shape.size() < 3) || (shape.product() == shape(0) * shape(1)));
 }
 
 bool Frame::GetRegionStats(const casacore::LattRegionHolder& region, std::vector<CARTA::StatsType>& required_stats, bool per_z,
     std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
     // Get stats for image data with a region applied
     casacore::SubImage<float> sub_image;
-    std::unique_lock<std::mutex> ulock(_image_mutex);
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
     bool subimage_ok = _loader->GetSubImage(region, sub_image);
+    double beam_area = _loader->CalculateBeamArea();
     ulock.unlock();
-    if (subimage_ok) {
-        std::lock_guard<std::mutex> guard(_image_mutex);
-        return CalcStatsValues(stats_values, required_stats, sub_image, per_z);
+    if (!subimage_ok) {
+        return false;
     }
-    return subimage_ok;
+
+    if (UseNativeStats(required_stats, per_z, sub_image.shape(), beam_area)) {
+        std::vector<float> data;
+        casacore::IPosition blc(sub_image.region().slicer().start());
+        return GetSubImageData(sub_image, data) &&
+               CalcStatsValues(stats_values, required_stats, data, sub_image.shape(), blc, beam_area, per_z);
+    }
+
+    auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    return CalcStatsValues(stats_values, required_stats, sub_image, per_z);
+}
+
+bool Frame::UseNativeChannelStats(const std::vector<CARTA::StatsType>& required_stats) {
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    double beam_area = _loader->CalculateBeamArea();
+    ulock.unlock();
+    return UseNativeStats(required_stats, true, ImageShape(), beam_area); // one channel
+}
+
+bool Frame::GetRegionStats(const std::vector<float>& data, const casacore::IPosition& data_shape, const casacore::IPosition& blc,
+    const std::vector<CARTA::StatsType>& required_stats, std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    double beam_area = _loader->CalculateBeamArea();
+    ulock.unlock();
+    return CalcStatsValues(stats_values, required_stats, data, data_shape, blc, beam_area, false);
 }
 
 bool Frame::GetSlicerStats(const casacore::Slicer& slicer, std::vector<CARTA::StatsType>& required_stats, bool per_z,
     std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
     // Get stats for image data with a slicer applied
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    double beam_area = _loader->CalculateBeamArea();
+    ulock.unlock();
+    if (UseNativeStats(required_stats, per_z, slicer.length(), beam_area)) {
+        std::vector<float> data;
+        return GetSlicerData(slicer, data) &&
+               CalcStatsValues(stats_values, required_stats, data, slicer.length(), slicer.start(), beam_area, per_z);
+    }
+
     casacore::SubImage<float> sub_image;
-    std::unique_lock<std::mutex> ulock(_image_mutex);
+    ulock.lock();
     bool subimage_ok = _loader->GetSubImage(slicer, sub_image);
     ulock.unlock();
     if (subimage_ok) {
-        std::lock_guard<std::mutex> guard(_image_mutex);
+        auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
         return CalcStatsValues(stats_values, required_stats, sub_image, per_z);
     }
     return subimage_ok;
 }
 
-bool Frame::UseLoaderSpectralData(const casacore::IPosition& region_shape) {
-    // Check if loader has swizzled data and more efficient than image data
-    return _loader->UseRegionSpectralData(region_shape, _image_mutex);
+bool Frame::UseMaskedRegionStats(const std::vector<CARTA::StatsType>& required_stats) {
+    return UseNativeStats(required_stats, true, ImageShape(), BeamArea());
+}
+
+double Frame::BeamArea() {
+    auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    return _loader->CalculateBeamArea();
+}
+
+bool Frame::GetMaskedRegionStats(const carta::RegionSpans& spans, const AxisRange& z_range, int stokes,
+    std::vector<CARTA::StatsType>& required_stats, std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
+    // Read blocks of channels in the spans bounding box, set pixels outside the spans to NaN, then calculate all stats per z
+    if (z_range.from > z_range.to) {
+        return false;
+    }
+
+    double beam_area = BeamArea();
+    const size_t width = spans.Width();
+    const size_t height = spans.Height();
+    const size_t plane_size = width * height;
+    if (plane_size == 0) {
+        return false;
+    }
+    int block_depth = std::max((size_t)1, (size_t)REGION_SPECTRAL_BLOCK_MB * 1024 * 1024 / (plane_size * sizeof(float)));
+
+    AxisRange x_range(spans.X(), spans.X() + width - 1);
+    AxisRange y_range(spans.Y(), spans.Y() + height - 1);
+    std::vector<float> data;
+    bool ok(true);
+    for (int block_start = z_range.from; ok && (block_start <= z_range.to); block_start += block_depth) {
+        AxisRange block_range(block_start, std::min(block_start + block_depth - 1, z_range.to));
+        casacore::Slicer slicer = GetImageSlicer(x_range, y_range, block_range, stokes);
+        if (!GetSlicerData(slicer, data)) {
+            ok = false;
+            break;
+        }
+
+        int64_t num_rows = data.size() / width;
+        ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+        for (int64_t row = 0; row < num_rows; ++row) {
+            spans.MaskRow(row % height, data.data() + row * width);
+        }
+
+        std::map<CARTA::StatsType, std::vector<double>> block_values;
+        ok = CalcStatsValues(block_values, required_stats, data, slicer.length(), slicer.start(), beam_area);
+        for (auto& values : block_values) {
+            auto& z_values = stats_values[values.first];
+            z_values.insert(z_values.end(), values.second.begin(), values.second.end());
+        }
+    }
+
+    return ok;
+}
+
+bool Frame::GetApproximateRegionSpectra(const carta::RegionSpans& spans, int stokes,
+    std::map<CARTA::StatsType, std::vector<double>>& stats_values, std::vector<double>& sum_errors) {
+    // Each block mean of the mipmap is weighted by the region pixels in the block, so that blocks inside the region are exact. The
+    // region pixels of an edge block are not its mean: that error is estimated from the scatter of the edge block means.
+    if (carta::IsComputedStokes(stokes) || (spans.NumPixels() == 0)) {
+        return false;
+    }
+    size_t depth = Depth();
+    size_t box_pixels = (size_t)spans.Width() * spans.Height();
+    int mip(0);
+    for (int next_mip = 2; _loader->HasMip(next_mip); next_mip *= 2) {
+        mip = next_mip;
+        if (box_pixels / (mip * mip) * depth <= APPROXIMATE_SPECTRAL_READ_PIXELS) {
+            break;
+        }
+    }
+    if (mip == 0) {
+        return false;
+    }
+
+    // Region pixels of each block of the mipmap box
+    int x0 = spans.X() / mip;
+    int y0 = spans.Y() / mip;
+    int mip_width = (spans.X() + spans.Width() - 1) / mip - x0 + 1;
+    int mip_height = (spans.Y() + spans.Height() - 1) / mip - y0 + 1;
+    std::vector<double> covered((size_t)mip_width * mip_height, 0);
+    for (const auto& span : spans.Spans()) {
+        size_t row_start = (size_t)((spans.Y() + span.y) / mip - y0) * mip_width;
+        int x_end = spans.X() + span.x_end;
+        for (int x = spans.X() + span.x_start; x < x_end;) {
+            int block_end = std::min(x_end, (x / mip + 1) * mip);
+            covered[row_start + x / mip - x0] += block_end - x;
+            x = block_end;
+        }
+    }
+
+    // Blocks at the region edge, with the weight of their error in the sum: the variance of the mean of n of the N block pixels
+    // (without replacement) is sigma^2 / n * (1 - n / N), times n^2 for the sum
+    std::vector<size_t> edge_blocks;
+    double edge_weight(0);
+    for (int y = 0; y < mip_height; ++y) {
+        double block_height = std::min(mip, (int)_height - (y0 + y) * mip);
+        for (int x = 0; x < mip_width; ++x) {
+            size_t block = (size_t)y * mip_width + x;
+            double block_pixels = block_height * std::min(mip, (int)_width - (x0 + x) * mip);
+            if ((covered[block] > 0) && (covered[block] < block_pixels)) {
+                edge_blocks.push_back(block);
+                edge_weight += covered[block] * (1.0 - covered[block] / block_pixels);
+            }
+        }
+    }
+
+    std::vector<CARTA::StatsType> approximate_stats{
+        CARTA::StatsType::NumPixels, CARTA::StatsType::Sum, CARTA::StatsType::Mean, CARTA::StatsType::FluxDensity};
+    for (auto stats_type : approximate_stats) {
+        stats_values[stats_type].assign(depth, NAN);
+    }
+    sum_errors.assign(depth, NAN);
+
+    double beam_area = BeamArea();
+    std::vector<float> data;
+    for (size_t z = 0; z < depth; ++z) {
+        if (!IsConnected()) {
+            return false;
+        }
+        if (!_loader->GetMipData(data, mip, x0, y0, mip_width, mip_height, z, stokes, _image_mutex)) {
+            return false;
+        }
+
+        double num_pixels(0), sum(0);
+        for (size_t block = 0; block < covered.size(); ++block) {
+            if ((covered[block] > 0) && std::isfinite(data[block])) {
+                num_pixels += covered[block];
+                sum += covered[block] * data[block];
+            }
+        }
+        double num_edge(0), edge_sum(0), edge_sum_sq(0);
+        for (auto block : edge_blocks) {
+            if (std::isfinite(data[block])) {
+                ++num_edge;
+                edge_sum += data[block];
+                edge_sum_sq += (double)data[block] * data[block];
+            }
+        }
+        double edge_variance = (num_edge > 1) ? std::max(0.0, (edge_sum_sq - edge_sum * edge_sum / num_edge) / (num_edge - 1)) : 0;
+        sum_errors[z] = (num_pixels > 0) ? std::sqrt(edge_variance * edge_weight) : NAN;
+
+        for (auto stats_type : approximate_stats) {
+            stats_values[stats_type][z] = RegionStatsValue(stats_type, num_pixels, sum, 0, NAN, NAN, beam_area);
+        }
+    }
+    spdlog::debug("Approximate region spectra from mip {} of {}x{} blocks, {} at the region edge", mip, mip_width, mip_height,
+        edge_blocks.size());
+    return true;
+}
+
+bool Frame::UseLoaderSpectralData(const casacore::IPosition& region_shape, int stokes) {
+    // Check if loader has swizzled data and more efficient than image data; computed stokes are calculated from image slices
+    return !carta::IsComputedStokes(stokes) && _loader->UseRegionSpectralData(region_shape, _image_mutex);
 }
 
 bool Frame::GetLoaderPointSpectralData(std::vector<float>& profile, int stokes, CARTA::Point& point) {
-    return _loader->GetCursorSpectralData(profile, stokes, point.x(), 1, point.y(), 1, _image_mutex);
+    return !carta::IsComputedStokes(stokes) && _loader->GetCursorSpectralData(profile, stokes, point.x(), 1, point.y(), 1, _image_mutex);
 }
 
-bool Frame::GetLoaderSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
-    const casacore::IPosition& origin, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
+bool Frame::GetLoaderSpectralData(int region_id, int stokes, const carta::BitMask& mask, const casacore::IPosition& origin,
+    std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
     // Get spectral data from loader (add image mutex for swizzled data)
-    return _loader->GetRegionSpectralData(region_id, stokes, mask, origin, _image_mutex, results, progress);
+    return !carta::IsComputedStokes(stokes) &&
+           _loader->GetRegionSpectralData(region_id, stokes, mask, origin, _image_mutex, results, progress);
 }
 
 bool Frame::CalculateMoments(int file_id, MomentProgressCallback progress_callback, const casacore::ImageRegion& image_region,
     const CARTA::MomentRequest& moment_request, CARTA::MomentResponse& moment_response,
     std::vector<carta::CollapseResult>& collapse_results) {
+    auto cancel_token = _moment_cancel.Replace(); // a new request stops the calculation of the previous one
     std::shared_lock lock(GetActiveTaskMutex());
 
+    // Images of files may be calculated by a worker, which reads the file itself
+    if (_remote_jobs && !GetFileName().empty()) {
+        auto remote_progress = [&](float progress) {
+            progress_callback(progress);
+            return !cancel_token.IsCancelled();
+        };
+        auto remote_job = carta::WorkerPool::Global().CalculateMoments(
+            GetFileName(), _hdu, file_id, image_region, moment_request, remote_progress, moment_response, collapse_results);
+        if (remote_job != carta::RemoteJob::Unavailable) {
+            return !collapse_results.empty();
+        }
+    }
+
     if (!_moment_generator) {
+        {
+            auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+            _loader->LoadDeferredHeaders();
+        }
         _moment_generator = std::make_unique<MomentGenerator>(GetFileName(), GetImage());
     }
     if (_moment_generator) {
-        std::unique_lock<std::mutex> ulock(_image_mutex); // Must lock the image while doing moment calculations
-        _moment_generator->CalculateMoments(
-            file_id, image_region, _z_axis, _stokes_axis, progress_callback, moment_request, moment_response, collapse_results);
+        // Read spectra for moment tiles when the loader has spectral-major data
+        MomentGenerator::SpectralTileReader spectral_tile_reader;
+        if (_loader->CanReadSpectralTiles(_image_mutex)) {
+            spectral_tile_reader = [this](std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) {
+                return _loader->GetSpectralTile(data, stokes, x, count_x, y, count_y);
+            };
+        }
+        _moment_generator->SetSpectralTileReader(spectral_tile_reader);
+
+        auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock); // Must lock the image while doing moment calculations
+        casacore::IPosition moment_shape = image_region.isLCRegion() ? image_region.asLCRegion().boundingBox().length() : ImageShape();
+        _loader->SetReadPattern(carta::FileLoader::ReadPattern::Moments, moment_shape);
+        _moment_generator->CalculateMoments(file_id, image_region, _z_axis, _stokes_axis, progress_callback, moment_request,
+            moment_response, collapse_results, cancel_token);
         ulock.unlock();
     }
 
@@ -1374,9 +2804,73 @@ bool Frame::CalculateMoments(int file_id, MomentProgressCallback progress_callba
 }
 
 void Frame::StopMomentCalc() {
-    if (_moment_generator) {
-        _moment_generator->StopCalculation();
+    _moment_cancel.CancelCurrent();
+}
+
+bool Frame::CalculatePv(const std::vector<PointXy>& path, int line_width, carta::PvInterpolation interpolation, const AxisRange& z_range,
+    int stokes, const std::function<bool(float progress)>& progress_callback,
+    std::shared_ptr<casacore::ImageInterface<casacore::Float>>& pv_image, std::string& message) {
+    std::shared_lock lock(GetActiveTaskMutex());
+    if (!CheckZ(z_range.from) || !CheckZ(z_range.to) || (z_range.from > z_range.to) || !CheckStokes(stokes)) {
+        message = fmt::format("Invalid channel range {}-{} or stokes {}.", z_range.from, z_range.to, stokes);
+        return false;
+    }
+
+    // Tiles of spectral-major data have all channels; otherwise the tiles are read from the image for the z range only
+    bool spectral_tiles = !carta::IsComputedStokes(stokes) && _loader->CanReadSpectralTiles(_image_mutex);
+    int tile_depth = spectral_tiles ? _depth : z_range.to - z_range.from + 1;
+    carta::PvGenerator pv_generator(_width, _height, tile_depth);
+    if (!pv_generator.SetPath(path, line_width, interpolation)) {
+        message = "The path is outside the image.";
+        return false;
+    }
+
+    carta::PvGenerator::SpectralTileReader read_tile;
+    if (spectral_tiles) {
+        read_tile = [&](std::vector<float>& data, int x, int count_x, int y, int count_y) {
+            auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+            return _loader->GetSpectralTile(data, stokes, x, count_x, y, count_y);
+        };
+    } else {
+        read_tile = [&](std::vector<float>& data, int x, int count_x, int y, int count_y) {
+            std::vector<float> slicer_data;
+            casacore::Slicer slicer = GetImageSlicer(AxisRange(x, x + count_x - 1), AxisRange(y, y + count_y - 1), z_range, stokes);
+            if (!GetSlicerData(slicer, slicer_data)) {
+                return false;
+            }
+            // x fastest to z fastest
+            data.resize(slicer_data.size());
+            size_t index(0);
+            for (int i = 0; i < count_x; ++i) {
+                for (int j = 0; j < count_y; ++j) {
+                    for (int z = 0; z < tile_depth; ++z) {
+                        data[index++] = slicer_data[((size_t)z * count_y + j) * count_x + i];
+                    }
+                }
+            }
+            return true;
+        };
     }
+
+    auto pv_progress = [&](float progress) {
+        return (!progress_callback || progress_callback(progress)) && !_cancel_token.IsCancelled();
+    };
+    std::vector<float> pv_data;
+    AxisRange tile_z_range = spectral_tiles ? z_range : AxisRange(0, tile_depth - 1);
+    if (!pv_generator.Calculate(read_tile, tile_z_range, pv_progress, pv_data)) {
+        message = _cancel_token.IsCancelled() ? "The file was closed." : "Reading the spectra along the path failed or was cancelled.";
+        return false;
+    }
+
+    auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+    try {
+        _loader->LoadDeferredHeaders();
+        pv_image = carta::PvGenerator::MakeImage(*GetImage(), _z_axis, z_range.from, pv_generator.NumSamples(), pv_data);
+    } catch (const casacore::AipsError& err) {
+        message = fmt::format("The position-velocity image could not be made: {}", err.getMesg());
+        return false;
+    }
+    return pv_image != nullptr;
 }
 
 // Export modified image to file, for changed range of channels/stokes and chopped region
@@ -1387,6 +2881,21 @@ void Frame::StopMomentCalc() {
 // Return void
 void Frame::SaveFile(const std::string& root_folder, const CARTA::SaveFile& save_file_msg, CARTA::SaveFileAck& save_file_ack,
     std::shared_ptr<Region> region) {
+    casacore::LCRegion* image_region(nullptr);
+    if (region) {
+        image_region = GetImageRegion(save_file_msg.file_id(), region);
+        if (!image_region) {
+            save_file_ack.set_file_id(save_file_msg.file_id());
+            save_file_ack.set_success(false);
+            save_file_ack.set_message("The region is outside the image.");
+            return;
+        }
+    }
+    SaveFile(root_folder, save_file_msg, save_file_ack, image_region);
+}
+
+void Frame::SaveFile(const std::string& root_folder, const CARTA::SaveFile& save_file_msg, CARTA::SaveFileAck& save_file_ack,
+    const casacore::LCRegion* image_region, const std::function<bool(float progress)>& progress_callback) {
     // Input file info
     std::string in_file = GetFileName();
 
@@ -1413,28 +2922,54 @@ void Frame::SaveFile(const std::string& root_folder, const CARTA::SaveFile& save
         return;
     }
 
-    // Modify image to export
+    std::shared_lock task_lock(GetActiveTaskMutex()); // closing the file cancels the export
+
+    // A worker reads the file and writes the output file itself, so the output folder must be shared with the workers
+    if (_remote_jobs && !GetFileName().empty()) {
+        CARTA::SaveFile remote_save_file_msg(save_file_msg);
+        remote_save_file_msg.set_output_file_directory(abs_path.string());
+        auto remote_progress = [&](float progress) {
+            return (!progress_callback || progress_callback(progress)) && !_cancel_token.IsCancelled();
+        };
+        auto remote_job = carta::WorkerPool::Global().SaveFile(
+            GetFileName(), _hdu, remote_save_file_msg, image_region, remote_progress, save_file_ack);
+        if (remote_job != carta::RemoteJob::Unavailable) {
+            if (remote_job == carta::RemoteJob::Done) {
+                spdlog::info("Exported a {} file \'{}\' on a worker.", FileTypeString[output_file_type], output_filename.string());
+            }
+            message = save_file_ack.message();
+            if (!root_folder.empty() && (message.find(root_folder) != std::string::npos)) {
+                message.replace(message.find(root_folder), root_folder.size(), "");
+                save_file_ack.set_message(message);
+            }
+            return;
+        }
+    }
+
+    // Modify image to export, with its full header
+    {
+        auto guard = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock);
+        _loader->LoadDeferredHeaders();
+    }
     auto image = GetImage();
     auto image_shape = image->shape();
 
     casacore::SubImage<float> sub_image;
-    casacore::LCRegion* image_region;
     casacore::IPosition region_shape;
-    if (region) {
-        image_region = GetImageRegion(file_id, region);
+    if (image_region) {
         region_shape = image_region->shape();
     }
 
     if (image_shape.size() == 2) {
-        if (region) {
-            _loader->GetSubImage(LattRegionHolder(image_region), sub_image);
+        if (image_region) {
+            _loader->GetSubImage(LattRegionHolder(*image_region), sub_image);
             image = sub_image.cloneII();
         }
     } else if (image_shape.size() > 2 && image_shape.size() < 5) {
         try {
             // If apply region
-            if (region) {
-                auto latt_region_holder = LattRegionHolder(image_region);
+            if (image_region) {
+                auto latt_region_holder = LattRegionHolder(*image_region);
                 auto slice_sub_image = GetExportRegionSlicer(save_file_msg, image_shape, region_shape, image_region, latt_region_holder);
                 _loader->GetSubImage(slice_sub_image, latt_region_holder, sub_image);
             } else {
@@ -1458,16 +2993,31 @@ void Frame::SaveFile(const std::string& root_folder, const CARTA::SaveFile& save
         return;
     }
 
+    // Log progress every tenth of the pixels
+    size_t num_pixels(image->shape().product());
+    int logged_percent(0);
+    auto progress_callback = [&](size_t num_pixels_done) {
+        int percent = num_pixels ? (int)(100.0 * num_pixels_done / num_pixels) : 100;
+        if (percent >= logged_percent + 10) {
+            logged_percent = percent - (percent % 10);
+            spdlog::info("Exporting a {} file \'{}\': {}%", FileTypeString[output_file_type], output_filename.string(), logged_percent);
+        }
+        if (progress_callback && !progress_callback(num_pixels ? (float)num_pixels_done / num_pixels : 1.0f)) {
+            return false;
+        }
+        return !_cancel_token.IsCancelled();
+    };
+
     // Export image data to file
     try {
-        std::unique_lock<std::mutex> ulock(_image_mutex); // Lock the image while saving the file
+        auto ulock = carta::TimedLock(_image_mutex, carta::RequestPhase::ImageLock); // Lock the image while saving the file
         {
             switch (output_file_type) {
                 case CARTA::FileType::CASA:
-                    success = ExportCASAImage(*image, output_filename, message);
+                    success = ExportCASAImage(*image, output_filename, message, progress_callback);
                     break;
                 case CARTA::FileType::FITS:
-                    success = ExportFITSImage(*image, output_filename, message);
+                    success = ExportFITSImage(*image, output_filename, message, progress_callback);
                     break;
                 default:
                     message = fmt::format("Could not export file. Unknown file type {}.", FileTypeString[output_file_type]);
@@ -1497,12 +3047,67 @@ void Frame::SaveFile(const std::string& root_folder, const CARTA::SaveFile& save
     save_file_ack.set_message(message);
 }
 
+namespace {
+
+// Cursor of whole rows, planes and then blocks of planes, up to the export chunk size
+casacore::IPosition ExportCursorShape(const casacore::IPosition& image_shape) {
+    size_t max_pixels((size_t)EXPORT_CHUNK_MB * 1024 * 1024 / sizeof(float));
+    casacore::IPosition cursor_shape(image_shape.size(), 1);
+    size_t num_pixels(1);
+    for (size_t i = 0; i < image_shape.size(); ++i) {
+        size_t length = (i == 0) ? image_shape[0] : std::min((size_t)image_shape[i], std::max(max_pixels / num_pixels, (size_t)1));
+        cursor_shape[i] = length;
+        num_pixels *= length;
+        if (length < image_shape[i]) {
+            break;
+        }
+    }
+    return cursor_shape;
+}
+
+struct ExportChunk {
+    casacore::IPosition start;
+    casacore::Array<casacore::Float> data;
+    casacore::Array<casacore::Bool> mask;
+};
+using ExportChunkPtr = std::shared_ptr<ExportChunk>;
+
+// Source of a FITS export, which counts the pixels read by the converter and stops it when the callback returns false
+class ExportSourceImage : public casacore::SubImage<casacore::Float> {
+public:
+    ExportSourceImage(const casacore::ImageInterface<casacore::Float>& image, const std::function<bool(size_t)>& progress_callback)
+        : casacore::SubImage<casacore::Float>(image), _progress_callback(progress_callback), _num_pixels_read(0), _cancelled(false) {}
+
+    casacore::Bool doGetSlice(casacore::Array<casacore::Float>& buffer, const casacore::Slicer& section) override {
+        if (_cancelled || !_progress_callback(_num_pixels_read)) {
+            _cancelled = true;
+            throw casacore::AipsError("Export cancelled.");
+        }
+        auto is_reference = casacore::SubImage<casacore::Float>::doGetSlice(buffer, section);
+        _num_pixels_read += section.length().product();
+        return is_reference;
+    }
+
+    bool Cancelled() const {
+        return _cancelled;
+    }
+
+private:
+    const std::function<bool(size_t)>& _progress_callback;
+    size_t _num_pixels_read;
+    bool _cancelled;
+};
+
+} // namespace
+
 // Export carta::FileLoader::ImageRef image to CASA file
 // Input casacore::ImageInterface<casacore::Float> image as source data
 // Input output_filename as file path
 // Input message as a return message, which may contain error message
+// Input progress_callback with the number of pixels written, which returns false to stop the export
 // Return a bool if this functionality success
-bool Frame::ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message) {
+bool Frame::ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message,
+    const ExportProgressCallback& progress_callback) {
     bool success(false);
 
     // Remove the old image file if it has a same file name
@@ -1510,14 +3115,8 @@ bool Frame::ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs
         fs::remove_all(output_filename);
     }
 
-    // Get a copy of all pixel data
-    casacore::IPosition start(image.shape().size(), 0);
-    casacore::IPosition count(image.shape());
-    casacore::Slicer slice(start, count);
-    casacore::Array<casacore::Float> temp_array;
-    image.doGetSlice(temp_array, slice);
-
     // Construct a new CASA image
+    std::atomic<bool> cancelled(false);
     try {
         auto out_image =
             std::make_unique<casacore::PagedImage<casacore::Float>>(image.shape(), image.coordinates(), output_filename.string());
@@ -1525,21 +3124,59 @@ bool Frame::ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs
         out_image->setImageInfo(image.imageInfo());
         out_image->appendLog(image.logger());
         out_image->setUnits(image.units());
-        out_image->putSlice(temp_array, start);
 
         // Create the mask for region
-        if (image.hasPixelMask()) {
-            casacore::Array<casacore::Bool> image_mask;
-            image.getMaskSlice(image_mask, slice);
+        bool has_mask(image.hasPixelMask());
+        casacore::Lattice<casacore::Bool>* out_image_mask(nullptr);
+        if (has_mask) {
             out_image->makeMask("mask0", true, true);
-            casacore::Lattice<casacore::Bool>& out_image_mask = out_image->pixelMask();
-            out_image_mask.putSlice(image_mask, start);
+            out_image_mask = &out_image->pixelMask();
         }
-        success = true;
-    } catch (casacore::AipsError error) {
-        message = error.getMesg();
+
+        // Read chunks in order, and write each with its mask while the next are read
+        casacore::LatticeStepper stepper(image.shape(), ExportCursorShape(image.shape()), casacore::LatticeStepper::RESIZE);
+        size_t num_pixels_done(0);
+        auto read_chunk = [&](tbb::flow_control& fc) -> ExportChunkPtr {
+            if (cancelled || stepper.atEnd()) {
+                fc.stop();
+                return nullptr;
+            }
+            auto chunk = std::make_shared<ExportChunk>();
+            chunk->start = stepper.position();
+            casacore::Slicer slicer(stepper.position(), stepper.endPosition(), casacore::Slicer::endIsLast);
+            image.getSlice(chunk->data, slicer);
+            if (has_mask) {
+                image.getMaskSlice(chunk->mask, slicer);
+            }
+            stepper++;
+            return chunk;
+        };
+        auto write_chunk = [&](ExportChunkPtr chunk) {
+            if (cancelled) {
+                return;
+            }
+            out_image->putSlice(chunk->data, chunk->start);
+            if (has_mask) {
+                out_image_mask->putSlice(chunk->mask, chunk->start);
+            }
+            num_pixels_done += chunk->data.nelements();
+            if (!progress_callback(num_pixels_done)) {
+                cancelled = true;
+            }
+        };
+        tbb::parallel_pipeline(EXPORT_CHUNKS,
+            tbb::make_filter<void, ExportChunkPtr>(tbb::filter::serial_in_order, read_chunk) &
+                tbb::make_filter<ExportChunkPtr, void>(tbb::filter::serial_in_order, write_chunk));
+        success = !cancelled;
+    } catch (const std::exception& error) {
+        message = error.what();
     }
 
+    if (cancelled) {
+        // Remove the partial image
+        fs::remove_all(output_filename);
+        message = "Export cancelled.";
+    }
     return success;
 }
 
@@ -1547,8 +3184,10 @@ bool Frame::ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs
 // Input casacore::ImageInterface<casacore::Float> image as source data
 // Input output_filename as file path
 // Input message as a return message, which may contain error message
+// Input progress_callback with the number of pixels read, which returns false to stop the export
 // Return a bool if this functionality success
-bool Frame::ExportFITSImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message) {
+bool Frame::ExportFITSImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message,
+    const ExportProgressCallback& progress_callback) {
     bool success = false;
     bool prefer_velocity;
     bool optical_velocity;
@@ -1566,9 +3205,24 @@ bool Frame::ExportFITSImage(casacore::ImageInterface<casacore::Float>& image, fs
     const int bit_pix(-32);
     const float min_pix(1.0);
     const float max_pix(-1.0);
-    if (casacore::ImageFITSConverter::ImageToFITS(error_string, image, output_filename.string(), 64, prefer_velocity, optical_velocity,
-            bit_pix, min_pix, max_pix, allow_overwrite, degenerate_last, verbose, stokes_last, prefer_wavelength, air_wavelength,
-            origin_string, history)) {
+
+    // The converter reads and writes the image in chunks of the export chunk size
+    ExportSourceImage source_image(image, progress_callback);
+    bool converted(false);
+    try {
+        converted = casacore::ImageFITSConverter::ImageToFITS(error_string, source_image, output_filename.string(), EXPORT_CHUNK_MB,
+            prefer_velocity, optical_velocity, bit_pix, min_pix, max_pix, allow_overwrite, degenerate_last, verbose, stokes_last,
+            prefer_wavelength, air_wavelength, origin_string, history);
+    } catch (const casacore::AipsError& error) {
+        error_string = error.getMesg();
+    }
+
+    if (source_image.Cancelled()) {
+        // Remove the partial file
+        fs::remove(output_filename);
+        message = "Export cancelled.";
+    } else if (converted) {
+        progress_callback(image.shape().product());
         success = true;
     } else {
         message = error_string;
@@ -1675,7 +3329,7 @@ casacore::Slicer Frame::GetExportImageSlicer(const CARTA::SaveFile& save_file_ms
 //   If dimension of region does not match the source image, will modify latt_region_holder.
 // Return casacore::Slicer(start, end, stride) for apply subImage()
 casacore::Slicer Frame::GetExportRegionSlicer(const CARTA::SaveFile& save_file_msg, casacore::IPosition image_shape,
-    casacore::IPosition region_shape, casacore::LCRegion* image_region, casacore::LattRegionHolder& latt_region_holder) {
+    casacore::IPosition region_shape, const casacore::LCRegion* image_region, casacore::LattRegionHolder& latt_region_holder) {
     auto channels = std::vector<int>();
     auto stokes = std::vector<int>();
     ValidateChannelStokes(channels, stokes, save_file_msg);
@@ -1743,7 +3397,12 @@ casacore::Slicer Frame::GetExportRegionSlicer(const CARTA::SaveFile& save_file_m
 }
 
 bool Frame::GetStokesTypeIndex(const string& coordinate, int& stokes_index) {
-    if (coordinate.size() == 2) {
+    if (carta::ComputedStokesCoordinate(coordinate, stokes_index)) {
+        if (!CheckStokes(stokes_index)) {
+            spdlog::error("Spectral requirement {} failed: image has no stokes planes to compute it.", coordinate);
+            return false;
+        }
+    } else if (coordinate.size() == 2) {
         bool stokes_ok(false);
         char stokes_char(coordinate.front());
         switch (stokes_char) {
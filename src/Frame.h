@@ -12,13 +12,17 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 
-#include <tbb/queuing_rw_mutex.h>
-
 #include <carta-protobuf/contour.pb.h>
 #include <carta-protobuf/defs.pb.h>
 #include <carta-protobuf/raster_tile.pb.h>
@@ -29,13 +33,24 @@
 #include <carta-protobuf/spectral_profile.pb.h>
 #include <carta-protobuf/tiles.pb.h>
 
+#include "Cancellation.h"
 #include "Constants.h"
+#include "DataStream/ContourCache.h"
+#include "DataStream/CompactPlane.h"
 #include "DataStream/Contouring.h"
+#include "DataStream/MipPyramid.h"
 #include "DataStream/Tile.h"
+#include "DataStream/SharedPlaneCache.h"
+#include "DataStream/SmoothedPlaneCache.h"
+#include "DataStream/TileCache.h"
+#include "DataStream/TileDelta.h"
+#include "DataStream/TileSummary.h"
 #include "ImageData/FileLoader.h"
 #include "ImageStats/BasicStatsCalculator.h"
 #include "ImageStats/Histogram.h"
+#include "ImageStats/QuantileSketch.h"
 #include "Moment/MomentGenerator.h"
+#include "Pv/PvGenerator.h"
 #include "Region/Region.h"
 #include "RequirementsCache.h"
 
@@ -47,44 +62,14 @@ namespace fs = boost::filesystem;
 namespace fs = std::filesystem;
 #endif
 
-struct ContourSettings {
-    std::vector<double> levels;
-    CARTA::SmoothingMode smoothing_mode;
-    int smoothing_factor;
-    int decimation;
-    int compression_level;
-    int chunk_size;
-    uint32_t reference_file_id;
-
-    // Equality operator for checking if contour settings have changed
-    bool operator==(const ContourSettings& rhs) const {
-        if (this->smoothing_mode != rhs.smoothing_mode || this->smoothing_factor != rhs.smoothing_factor ||
-            this->decimation != rhs.decimation || this->compression_level != rhs.compression_level ||
-            this->reference_file_id != rhs.reference_file_id || this->chunk_size != rhs.chunk_size) {
-            return false;
-        }
-        if (this->levels.size() != rhs.levels.size()) {
-            return false;
-        }
-
-        for (auto i = 0; i < this->levels.size(); i++) {
-            if (this->levels[i] != rhs.levels[i]) {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-    bool operator!=(const ContourSettings& rhs) const {
-        return !(*this == rhs);
-    }
-};
+namespace carta {
+enum class RemoteJob; // in GrpcServer/WorkerPool.h
+} // namespace carta
 
 class Frame {
 public:
     Frame(uint32_t session_id, carta::FileLoader* loader, const std::string& hdu, int default_z = DEFAULT_Z);
-    ~Frame(){};
+    ~Frame();
 
     bool IsValid();
     std::string GetErrorMessage();
@@ -94,6 +79,8 @@ public:
 
     // Image/Frame info
     casacore::IPosition ImageShape();
+    size_t Width();     // length of x axis
+    size_t Height();    // length of y axis
     size_t Depth();     // length of z axis
     size_t NumStokes(); // if no stokes axis, nstokes=1
     int CurrentZ();
@@ -103,6 +90,17 @@ public:
 
     // Slicer to set z and stokes ranges with full xy plane
     casacore::Slicer GetImageSlicer(const AxisRange& z_range, int stokes);
+    // Slicer to set x, y, z and stokes ranges
+    casacore::Slicer GetImageSlicer(const AxisRange& x_range, const AxisRange& y_range, const AxisRange& z_range, int stokes);
+
+    // Images with more pixels than the threshold read tiles on demand rather than caching the whole plane
+    static void SetLazyTileThreshold(int64_t num_pixels) {
+        _lazy_tile_threshold = num_pixels;
+    }
+    // Images with more pixels than the threshold cache planes as 16-bit values; statistics are still calculated from exact values
+    static void SetCompactCacheThreshold(int64_t num_pixels) {
+        _compact_cache_threshold = num_pixels;
+    }
 
     // Image view for z index
     inline void SetAnimationViewSettings(const CARTA::AddRequiredTiles& required_animation_tiles) {
@@ -113,19 +111,62 @@ public:
     };
     bool SetImageChannels(int new_z, int new_stokes, std::string& message);
 
+    // Read upcoming animation channels in the background so that SetImageChannels can swap them in;
+    // an empty list stops prefetching and releases the buffered planes
+    void PrefetchChannels(const std::vector<int>& channels, int stokes);
+
     // Cursor
     bool SetCursor(float x, float y);
+    PointXy GetCursor() {
+        return _cursor;
+    }
 
-    // Raster data
+    // Raster data; tiles of LOSSLESS_COMPRESSION_TYPE hold the exact values, for reading pixel values off the tiles
     bool FillRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes,
         CARTA::CompressionType compression_type, float compression_quality);
+    bool GetCachedRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes,
+        CARTA::CompressionType compression_type, float compression_quality);
+    // Animation tiles encoded against the tiles of the previous frame sent (see TileDeltaEncoder): ZFP keyframes, else residual
+    // tiles of compression type DELTA_COMPRESSION_TYPE. Not cached, since each depends on the tile sent before it.
+    void StartDeltaTiles(int animation_id) {
+        _tile_deltas.StartFrame(animation_id);
+    }
+    void ResetDeltaTiles() {
+        _tile_deltas.Reset();
+    }
+    bool FillDeltaRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes, float compression_quality);
+    // Tiles of several channels for channel-map views, without changing the current channel: the channels are grouped into blocks
+    // of consecutive channels read at once, then the tiles of each block are generated in parallel and passed to the callback
+    // as they are encoded, from any thread
+    using ChannelTileCallback = std::function<void(CARTA::RasterTileData& raster_tile_data)>;
+    std::vector<AxisRange> GetChannelTileBlocks(std::vector<int> channels, const std::vector<Tile>& tiles);
+    bool FillChannelTiles(const AxisRange& z_range, int stokes, const std::vector<Tile>& tiles, CARTA::CompressionType compression_type,
+        float compression_quality, const ChannelTileCallback& tile_callback, const carta::CancellationToken& cancel_token);
+    // Cutout of any z and stokes downsampled by mip: from the image cache if it holds the plane, else read from the loader
+    bool GetPlaneRasterData(std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int z, int stokes, int mip);
+    // A newer tile request or channel change makes the tiles still queued for older requests obsolete
+    inline int StartTileRequest() {
+        return ++_tile_request_id;
+    }
+    inline bool IsTileRequestCurrent(int tile_request_id) {
+        return tile_request_id == _tile_request_id;
+    }
 
     // Functions used for smoothing and contouring
     bool SetContourParameters(const CARTA::SetContourParameters& message);
     inline ContourSettings& GetContourParameters() {
         return _contour_settings;
     };
-    bool ContourImage(ContourCallback& partial_contour_callback);
+    // Token for a new contour request, which cancels the calculation of the previous one
+    carta::CancellationToken NewContourRequest() {
+        return _contour_cancel.Replace();
+    }
+    // The preview callback, if any, first gets contours of a coarse block average, for large images
+    bool ContourImage(const carta::CancellationToken& cancel_token, ContourCallback& partial_contour_callback,
+        ContourCallback* preview_callback = nullptr);
+    inline ContourCache& GetContourCache() {
+        return _contour_cache;
+    }
 
     // Histograms: image and cube
     bool SetHistogramRequirements(int region_id, const std::vector<CARTA::SetHistogramRequirements_HistogramConfig>& histogram_configs);
@@ -133,10 +174,27 @@ public:
     bool FillHistogram(int z, int stokes, int num_bins, carta::BasicStats<float>& stats, CARTA::Histogram* histogram);
     bool GetBasicStats(int z, int stokes, carta::BasicStats<float>& stats);
     bool CalculateHistogram(int region_id, int z, int stokes, int num_bins, carta::BasicStats<float>& stats, carta::Histogram& hist);
+    bool CalculateStatsAndHistogram(int z, int stokes, int num_bins, carta::BasicStats<float>& stats, carta::Histogram& hist);
     bool GetCubeHistogramConfig(HistogramConfig& config);
     void CacheCubeStats(int stokes, carta::BasicStats<float>& stats);
     void CacheCubeHistogram(int stokes, carta::Histogram& hist);
 
+    // Cube stats and histogram: channels are read in order, a few at a time, and calculated in parallel. The callback is
+    // called with the number of channels done and returns false to cancel; channels done are kept for the next call.
+    using CubeProgressCallback = std::function<bool(size_t num_z_done)>;
+    using CubeHistogramCallback = std::function<bool(size_t num_z_done, const carta::Histogram& partial_histogram)>;
+    bool CalculateCubeStats(int stokes, carta::BasicStats<float>& cube_stats, const CubeProgressCallback& progress_callback);
+    bool CalculateCubeHistogram(int stokes, int num_bins, const carta::BasicStats<float>& cube_stats, carta::Histogram& cube_histogram,
+        const CubeHistogramCallback& progress_callback);
+    // Cube stats and histogram from a worker of the worker pool; the callback is called with the fraction done and returns false to
+    // cancel. Unavailable if the job should run locally.
+    carta::RemoteJob CalculateRemoteCubeHistogram(int stokes, int num_bins, carta::BasicStats<float>& cube_stats,
+        carta::Histogram& cube_histogram, const std::function<bool(float progress)>& progress_callback);
+
+    // Percentiles at ranks in percent for z or ALL_Z: from the file if it has them for these ranks, else approximated by the
+    // quantile sketch (built from the channel data if needed; for the cube, filled by CalculateCubeStats)
+    bool GetPercentiles(int z, int stokes, const std::vector<float>& ranks, std::vector<float>& percentiles);
+
     // Stats: image
     bool SetStatsRequirements(int region_id, const std::vector<CARTA::StatsType>& stats_types);
     bool FillRegionStatsData(int region_id, CARTA::RegionStatsData& stats_data);
@@ -149,7 +207,7 @@ public:
     bool SetSpectralRequirements(int region_id, const std::vector<CARTA::SetSpectralRequirements_SpectralConfig>& spectral_configs);
     bool FillSpectralProfileData(std::function<void(CARTA::SpectralProfileData profile_data)> cb, int region_id, bool stokes_changed);
 
-    // Set the flag connected = false, in order to stop the jobs and wait for jobs finished
+    // Cancel the jobs of the frame, and wait for jobs finished
     void WaitForTaskCancellation();
     // Check flag if Frame is to be destroyed
     bool IsConnected();
@@ -160,17 +218,37 @@ public:
     casacore::IPosition GetRegionShape(const casacore::LattRegionHolder& region);
     // Returns data vector
     bool GetRegionData(const casacore::LattRegionHolder& region, std::vector<float>& data);
+    // Data in the bounding box of the row spans of a 2D region for one z and stokes, NaN outside the spans
+    bool GetRegionData(const carta::RegionSpans& spans, int z, int stokes, std::vector<float>& data);
     bool GetSlicerData(const casacore::Slicer& slicer, std::vector<float>& data);
+    bool GetSubImageData(casacore::SubImage<float>& sub_image, std::vector<float>& data);
+    // Data of a region for one z and stokes as above, from its row spans if not null, with the shape and blc of the bounding box
+    bool GetRegionPixels(const casacore::LattRegionHolder& region, const carta::RegionSpans* spans, int z, int stokes,
+        std::vector<float>& data, casacore::IPosition& shape, casacore::IPosition& blc);
     // Returns stats_values map for spectral profiles and stats data
     bool GetRegionStats(const casacore::LattRegionHolder& region, std::vector<CARTA::StatsType>& required_stats, bool per_z,
         std::map<CARTA::StatsType, std::vector<double>>& stats_values);
+    // Stats of the region pixels of one channel from GetRegionPixels, for the stats which UseNativeChannelStats allows
+    bool UseNativeChannelStats(const std::vector<CARTA::StatsType>& required_stats);
+    bool GetRegionStats(const std::vector<float>& data, const casacore::IPosition& data_shape, const casacore::IPosition& blc,
+        const std::vector<CARTA::StatsType>& required_stats, std::map<CARTA::StatsType, std::vector<double>>& stats_values);
     bool GetSlicerStats(const casacore::Slicer& slicer, std::vector<CARTA::StatsType>& required_stats, bool per_z,
         std::map<CARTA::StatsType, std::vector<double>>& stats_values);
+    // Per-z stats from blocks of channels in the bounding box of the row spans of a 2D region, without a casacore subimage;
+    // not used for flux density without a single beam
+    bool UseMaskedRegionStats(const std::vector<CARTA::StatsType>& required_stats);
+    double BeamArea(); // in pixels, NaN without a single beam
+    bool GetMaskedRegionStats(const carta::RegionSpans& spans, const AxisRange& z_range, int stokes,
+        std::vector<CARTA::StatsType>& required_stats, std::map<CARTA::StatsType, std::vector<double>>& stats_values);
+    // Per-z NumPixels, Sum, Mean and FluxDensity of the row spans of a 2D region from the loader mipmaps, with an error estimate of
+    // the sum; false if the loader has no mipmaps
+    bool GetApproximateRegionSpectra(const carta::RegionSpans& spans, int stokes,
+        std::map<CARTA::StatsType, std::vector<double>>& stats_values, std::vector<double>& sum_errors);
     // Spectral profiles from loader
-    bool UseLoaderSpectralData(const casacore::IPosition& region_shape);
+    bool UseLoaderSpectralData(const casacore::IPosition& region_shape, int stokes);
     bool GetLoaderPointSpectralData(std::vector<float>& profile, int stokes, CARTA::Point& point);
-    bool GetLoaderSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
-        const casacore::IPosition& origin, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress);
+    bool GetLoaderSpectralData(int region_id, int stokes, const carta::BitMask& mask, const casacore::IPosition& origin,
+        std::map<CARTA::StatsType, std::vector<double>>& results, float& progress);
 
     // Moments calculation
     bool CalculateMoments(int file_id, MomentProgressCallback progress_callback, const casacore::ImageRegion& image_region,
@@ -178,9 +256,24 @@ public:
         std::vector<carta::CollapseResult>& collapse_results);
     void StopMomentCalc();
 
+    // Position-velocity image sampled along a path in image pixel coords, for the z range and stokes, from spectral-major data when
+    // the loader has it; the progress callback returns false to cancel
+    bool CalculatePv(const std::vector<PointXy>& path, int line_width, carta::PvInterpolation interpolation, const AxisRange& z_range,
+        int stokes, const std::function<bool(float progress)>& progress_callback,
+        std::shared_ptr<casacore::ImageInterface<casacore::Float>>& pv_image, std::string& message);
+
     // Save as a new file or export sub-image to CASA/FITS format
     void SaveFile(const std::string& root_folder, const CARTA::SaveFile& save_file_msg, CARTA::SaveFileAck& save_file_ack,
         std::shared_ptr<Region> image_region);
+    // Export of the image region, or of the whole image if it is null; the callback is called with the fraction of the pixels done
+    // and returns false to cancel
+    void SaveFile(const std::string& root_folder, const CARTA::SaveFile& save_file_msg, CARTA::SaveFileAck& save_file_ack,
+        const casacore::LCRegion* image_region, const std::function<bool(float progress)>& progress_callback = nullptr);
+
+    // Moments, cube histograms and exports are sent to the worker pool unless this is a frame of a worker job
+    void SetRemoteJobs(bool remote_jobs) {
+        _remote_jobs = remote_jobs;
+    }
 
     bool GetStokesTypeIndex(const string& coordinate, int& stokes_index);
 
@@ -194,12 +287,64 @@ protected:
     // Check whether z or stokes has changed
     bool ZStokesChanged(int z, int stokes);
 
+    // Image data of one z and stokes, published whole so that a reader keeps the version it started with
+    struct CachedPlane {
+        int z;
+        int stokes;
+        SharedPlaneCache::Plane image;               // full precision; null in compact cache mode
+        std::shared_ptr<const CompactPlane> compact; // 16-bit data in compact cache mode
+        mutable MipPyramid mip_pyramid;              // downsampled levels of image, built on demand
+        std::shared_ptr<const TileSummary> tile_summary;
+    };
+    using PlaneSnapshot = std::shared_ptr<const CachedPlane>;
+
     // Cache image plane data for current z, stokes
     bool FillImageCache();
-
-    // Downsampled data from image cache
-    bool GetRasterData(std::vector<float>& image_data, CARTA::ImageBounds& bounds, int mip, bool mean_filter = true);
+    PlaneSnapshot MakeCachedPlane(int z, int stokes, std::vector<float>&& plane);
+    // Publish the plane, keeping the buffer of the previous plane for the next load if nothing else uses it
+    void SetCachedPlane(PlaneSnapshot plane);
+    // Cached plane of z and stokes, waiting for it if it is the current plane being loaded; null if not cached
+    PlaneSnapshot GetCachedPlane(int z, int stokes);
+
+    // Animation prefetch
+    void RunPrefetch();
+    bool TakePrefetchedPlane(int z, int stokes, std::vector<float>& plane);
+    void PrefetchContours(int z, int stokes, const std::vector<float>& plane, const ContourSettings& settings);
+
+    // Contours of a plane with the frame dimensions; cached_plane is the full-precision cached plane of the data, if any, for its
+    // mip pyramid
+    bool ContourPlane(const float* image_data, const ContourSettings& settings, ContourCallback& partial_contour_callback,
+        const CachedPlane* cached_plane, const carta::CancellationToken& cancel_token);
+    static bool UseContourSmoothing(const ContourSettings& settings);
+    bool SmoothContourPlane(
+        const float* image_data, const ContourSettings& settings, const CachedPlane* cached_plane, SmoothedPlane& smoothed_plane);
+    void TraceSmoothedContours(const SmoothedPlane& smoothed_plane, const ContourSettings& settings,
+        ContourCallback& partial_contour_callback, const carta::CancellationToken& cancel_token);
+    void ContourPreview(const float* image_data, const ContourSettings& settings, const CachedPlane* cached_plane,
+        ContourCallback& callback, const carta::CancellationToken& cancel_token);
+    bool BlockAveragePlane(const float* image_data, int factor, const CachedPlane* cached_plane, std::vector<float>& dest_vector);
+
+    // Downsampled data from a cached plane
+    bool GetRasterData(
+        const CachedPlane& plane, std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int mip, bool mean_filter = true);
+    CARTA::ImageBounds GetTileBounds(const Tile& tile, int& mip);
+    bool GetTilesBoundingBox(const std::vector<Tile>& tiles, CARTA::ImageBounds& box);
     bool GetRasterTileData(std::vector<float>& tile_data, const Tile& tile, int& width, int& height);
+    // Value of a tile of the cached plane which is all NaN or constant, from its tile summary; false if the tile has other pixels or
+    // the plane is not cached
+    bool GetUniformTileValue(const Tile& tile, int z, int stokes, float& value);
+    bool FillUniformRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, int z, int stokes, float value,
+        CARTA::CompressionType compression_type, float compression_quality);
+    // Tile message of downsampled tile data, compressed; false if stale() becomes true while encoding
+    bool EncodeRasterTileData(CARTA::RasterTileData& raster_tile_data, const Tile& tile, std::vector<float>& tile_image_data,
+        int tile_width, int tile_height, int z, int stokes, CARTA::CompressionType compression_type, float compression_quality,
+        const std::function<bool()>& stale);
+    // Downsampled data read directly from the loader, for lazy tile mode; a read of the current plane stops if the channel changes
+    bool GetLazyRasterData(
+        std::vector<float>& image_data, const CARTA::ImageBounds& bounds, int mip, int z = CURRENT_Z, int stokes = CURRENT_STOKES);
+    // Downsampled data decoded from a compact plane in row bands
+    void GetCompactRasterData(
+        const CompactPlane& plane, float* image_data, int x, int y, int req_width, int req_height, int mip, bool mean_filter);
 
     // Fill vector for given z and stokes
     void GetZMatrix(std::vector<float>& z_matrix, size_t z, size_t stokes);
@@ -211,21 +356,32 @@ protected:
     bool FillHistogramFromFrameCache(int z, int stokes, int num_bins, CARTA::Histogram* histogram);  // histogram message
     bool GetCachedImageHistogram(int z, int stokes, int num_bins, carta::Histogram& hist);           // internal histogram
     bool GetCachedCubeHistogram(int stokes, int num_bins, carta::Histogram& hist);                   // internal histogram
+    static bool FindCachedHistogram(const std::vector<carta::Histogram>& results, int num_bins, carta::Histogram& hist);
+    bool GetCachedBasicStats(int z, int stokes, carta::BasicStats<float>& stats);
+    size_t CubeHistogramChannels();
+
+    // Cursor spectral profiles: message for one config, and profiles from image slices read for all their stokes at once
+    CARTA::SpectralProfileData CursorSpectralProfileMessage(const SpectralConfig& config, float progress);
+    bool FillCursorSpectralSlices(std::function<void(CARTA::SpectralProfileData profile_data)> cb, PointXy start_cursor,
+        const std::vector<std::pair<SpectralConfig, int>>& profiles);
 
     // Check for cancel
     bool HasSpectralConfig(const SpectralConfig& config);
 
-    // Export image
-    bool ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message);
-    bool ExportFITSImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message);
+    // Export image, in chunks; the progress callback returns false to stop the export
+    using ExportProgressCallback = std::function<bool(size_t num_pixels_done)>;
+    bool ExportCASAImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message,
+        const ExportProgressCallback& progress_callback);
+    bool ExportFITSImage(casacore::ImageInterface<casacore::Float>& image, fs::path output_filename, casacore::String& message,
+        const ExportProgressCallback& progress_callback);
     void ValidateChannelStokes(std::vector<int>& channels, std::vector<int>& stokes, const CARTA::SaveFile& save_file_msg);
     casacore::Slicer GetExportImageSlicer(const CARTA::SaveFile& save_file_msg, casacore::IPosition image_shape);
     casacore::Slicer GetExportRegionSlicer(const CARTA::SaveFile& save_file_msg, casacore::IPosition image_shape,
-        casacore::IPosition region_shape, casacore::LCRegion* image_region, casacore::LattRegionHolder& latt_region_holder);
+        casacore::IPosition region_shape, const casacore::LCRegion* image_region, casacore::LattRegionHolder& latt_region_holder);
 
     // For convenience, create int map key for storing cache by z and stokes
     inline int CacheKey(int z, int stokes) {
-        return (z * 10) + stokes;
+        return (z * (COMPUTE_STOKES_PANGLE + 1)) + stokes;
     }
     // Get the full name of image file
     std::string GetFileName() {
@@ -242,8 +398,10 @@ protected:
     bool _valid;
     std::string _open_image_error;
 
-    // Trigger job cancellation when false
-    volatile bool _connected = true;
+    // Cancelled when the file is closed, with the contour and moment requests made for it
+    carta::CancellationToken _cancel_token;
+    carta::CancellationSlot _contour_cancel{_cancel_token};
+    carta::CancellationSlot _moment_cancel{_cancel_token};
 
     // Image loader for image type
     std::unique_ptr<carta::FileLoader> _loader;
@@ -260,14 +418,43 @@ protected:
     // Current cursor position
     PointXy _cursor;
 
-    // Contour settings
+    // Contour settings, encoded contours of recent channels from the session or the prefetcher, and the smoothed plane of the current
+    // channel for level changes
     ContourSettings _contour_settings;
+    ContourCache _contour_cache;
+    SmoothedPlaneCache _smoothed_plane_cache;
 
     // Image data cache and mutex
-    std::vector<float> _image_cache;    // image data for current z, stokes
-    tbb::queuing_rw_mutex _cache_mutex; // allow concurrent reads but lock for write
+    static int64_t _lazy_tile_threshold;
+    static int64_t _compact_cache_threshold;
+    bool _lazy_tiles;                   // image cache not used; tiles read from loader on demand
+    bool _compact_cache;                // cached planes are compact rather than full precision
+    // Plane of the last loaded z, stokes, read and swapped with std::atomic_load/store; the image data is shared read-only with
+    // other frames of the file. Null in lazy tile mode.
+    PlaneSnapshot _cached_plane;
+    std::string _plane_cache_key;        // file and hdu, empty if planes are not shared
+    std::mutex _plane_load_mutex;       // held while a plane is loaded, so that only one is loaded at a time
+    std::vector<float> _spare_plane;    // buffer of a released plane, read into by the next load; used with the plane load mutex
     std::mutex _image_mutex;            // only one disk access at a time
 
+    // Compressed raster tiles for current z, stokes
+    TileCache _tile_cache;
+    // Compressed ZFP tiles which are all NaN or constant, with their compression quality; key is width, height, value bits and precision
+    std::map<std::tuple<int, int, uint32_t, int>, std::pair<CARTA::TileData, float>> _uniform_tiles;
+    std::mutex _uniform_tile_mutex;
+    std::atomic<int> _tile_request_id;
+    TileDeltaEncoder _tile_deltas;
+
+    // Planes prefetched for animation, keyed by cache key (z/stokes)
+    std::unordered_map<int, std::vector<float>> _prefetched_planes;
+    std::deque<int> _prefetch_queue; // channels still to read
+    int _prefetch_stokes;
+    int _max_prefetch_planes;
+    bool _stop_prefetch;
+    std::thread _prefetch_thread;
+    std::mutex _prefetch_mutex;
+    std::condition_variable _prefetch_cv;
+
     // Use a shared lock for long time calculations, use an exclusive lock for the object destruction
     mutable std::shared_mutex _active_task_mutex;
 
@@ -275,7 +462,7 @@ protected:
     std::vector<HistogramConfig> _image_histogram_configs;
     std::vector<HistogramConfig> _cube_histogram_configs;
     std::vector<CARTA::StatsType> _image_required_stats;
-    std::vector<std::string> _cursor_spatial_configs;
+    std::vector<SpatialConfig> _cursor_spatial_configs;
     std::vector<SpectralConfig> _cursor_spectral_configs;
     std::mutex _spectral_mutex;
 
@@ -284,9 +471,21 @@ protected:
     std::unordered_map<int, std::vector<carta::Histogram>> _image_histograms, _cube_histograms;
     std::unordered_map<int, carta::BasicStats<float>> _image_basic_stats, _cube_basic_stats;
     std::unordered_map<int, std::map<CARTA::StatsType, double>> _image_stats;
+    std::unordered_map<int, carta::QuantileSketch> _image_quantile_sketches, _cube_quantile_sketches;
+
+    // Cube histogram accumulated over the channels done so far, key is stokes; kept when the calculation is cancelled
+    struct CubeHistogramProgress {
+        int num_bins = 0;
+        size_t next_z = 0;
+        carta::Histogram histogram;
+    };
+    std::unordered_map<int, CubeHistogramProgress> _cube_histogram_progress;
 
     // Moment generator
     std::unique_ptr<MomentGenerator> _moment_generator;
+
+    std::string _hdu;
+    bool _remote_jobs;
 };
 
 #endif // CARTA_BACKEND__FRAME_H_
@@ -0,0 +1,168 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "GpuCompute.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "Logger/Logger.h"
+
+#ifdef CARTA_CUDA
+#include "GpuKernels.h"
+#endif
+
+namespace carta {
+
+static std::atomic<int64_t> gpu_min_pixels(-1);
+
+// Plane of the PlaneScope of this thread
+static thread_local std::shared_ptr<const void> scope_owner;
+static thread_local const float* scope_data = nullptr;
+
+GpuCompute::PlaneScope::PlaneScope(std::shared_ptr<const void> owner, const float* data)
+    : _previous_owner(std::move(scope_owner)), _previous_data(scope_data) {
+    scope_owner = std::move(owner);
+    scope_data = data;
+}
+
+GpuCompute::PlaneScope::~PlaneScope() {
+    scope_owner = std::move(_previous_owner);
+    scope_data = _previous_data;
+}
+
+bool GpuCompute::Enabled() {
+    return gpu_min_pixels >= 0;
+}
+
+bool GpuCompute::Use(int64_t num_pixels) {
+    int64_t min_pixels = gpu_min_pixels;
+    return (min_pixels >= 0) && (num_pixels >= min_pixels);
+}
+
+#ifdef CARTA_CUDA
+
+// Device buffer which grows to the largest length used
+struct DeviceBuffer {
+    float* data = nullptr;
+    size_t capacity = 0;
+
+    bool Reserve(size_t length) {
+        if (length <= capacity) {
+            return true;
+        }
+        gpu::Free(data);
+        data = gpu::Allocate(length);
+        capacity = data ? length : 0;
+        return data != nullptr;
+    }
+};
+
+// Device state, used under the device mutex
+static std::mutex device_mutex;
+static DeviceBuffer input_buffer, temp_buffer, output_buffer;
+static DeviceBuffer plane_buffer;
+static std::weak_ptr<const void> plane_owner;
+static const float* plane_data = nullptr;
+static size_t plane_length = 0;
+
+// Device copy of the host data: the cached plane when the data is that of the plane scope, else the input buffer
+static const float* DeviceInput(const float* data, size_t length) {
+    if (scope_owner && (data == scope_data)) {
+        if ((plane_owner.lock() == scope_owner) && (plane_data == data) && (length <= plane_length)) {
+            return plane_buffer.data;
+        }
+        plane_owner.reset();
+        plane_data = nullptr;
+        if (!plane_buffer.Reserve(length) || !gpu::Upload(plane_buffer.data, data, length)) {
+            return nullptr;
+        }
+        plane_owner = scope_owner;
+        plane_data = data;
+        plane_length = length;
+        return plane_buffer.data;
+    }
+
+    if (!input_buffer.Reserve(length) || !gpu::Upload(input_buffer.data, data, length)) {
+        return nullptr;
+    }
+    return input_buffer.data;
+}
+
+bool GpuCompute::Enable(int64_t min_pixels) {
+    if (min_pixels < 0) {
+        gpu_min_pixels = -1;
+        return true;
+    }
+    int num_devices = gpu::DeviceCount();
+    if (num_devices < 1) {
+        gpu_min_pixels = -1;
+        return false;
+    }
+    spdlog::info("Offloading smoothing, statistics and histograms of at least {} pixels to the GPU ({} devices found)", min_pixels,
+        num_devices);
+    gpu_min_pixels = min_pixels;
+    return true;
+}
+
+bool GpuCompute::KernelGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+    int64_t dest_height, const std::vector<float>& kernel) {
+    size_t src_length = src_width * src_height;
+    if (!Use(src_length)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(device_mutex);
+    auto device_src = DeviceInput(src_data, src_length);
+    if (!device_src || !temp_buffer.Reserve(dest_width * src_height) || !output_buffer.Reserve(dest_width * dest_height) ||
+        !gpu::SeparableConvolve(device_src, temp_buffer.data, output_buffer.data, src_width, src_height, dest_width, dest_height,
+            kernel.data(), kernel.size())) {
+        return false;
+    }
+    return gpu::Download(dest_data, output_buffer.data, dest_width * dest_height);
+}
+
+bool GpuCompute::FillBins(
+    const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins) {
+    if (!Use(length)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(device_mutex);
+    auto device_data = DeviceInput(data, length);
+    return device_data && gpu::FillBins(device_data, length, min_val, max_val, bin_width, num_bins, bins);
+}
+
+bool GpuCompute::FiniteStats(
+    const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    if (!Use(length)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(device_mutex);
+    auto device_data = DeviceInput(data, length);
+    return device_data && gpu::FiniteStats(device_data, length, min_val, max_val, num_pixels, sum, sum_squares);
+}
+
+#else
+
+bool GpuCompute::Enable(int64_t min_pixels) {
+    gpu_min_pixels = -1;
+    return min_pixels < 0;
+}
+
+bool GpuCompute::KernelGaussianSmooth(const float*, float*, int64_t, int64_t, int64_t, int64_t, const std::vector<float>&) {
+    return false;
+}
+
+bool GpuCompute::FillBins(const float*, int64_t, float, float, float, size_t, int64_t*) {
+    return false;
+}
+
+bool GpuCompute::FiniteStats(const float*, size_t, float&, float&, size_t&, double&, double&) {
+    return false;
+}
+
+#endif
+
+} // namespace carta
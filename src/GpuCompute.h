@@ -0,0 +1,58 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# GpuCompute.h: optional offload of the Gaussian smoothing, histogram and statistics kernels to a CUDA device
+
+#ifndef CARTA_BACKEND__GPUCOMPUTE_H_
+#define CARTA_BACKEND__GPUCOMPUTE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace carta {
+
+// The kernels give the same results as the CPU versions, up to the order of floating-point sums. Each returns false when the
+// backend is built without CUDA (EnableCuda), has no device or is not enabled, when the data is below the size threshold, or on a
+// device error; the caller then runs the CPU version. Calls from all threads share the device, one at a time.
+class GpuCompute {
+public:
+    // Offloads data of at least min_pixels values; -1 disables. Returns false if there is no device to enable.
+    static bool Enable(int64_t min_pixels);
+    static bool Enabled();
+    // Whether data of this many values is offloaded
+    static bool Use(int64_t num_pixels);
+
+    // While in scope, the kernels called by this thread on the data of the plane reuse its device copy, which is kept until the
+    // owner (the shared plane data) is released or another plane is used, so that the current channel is copied to the device once
+    // for its statistics, histogram and smoothing.
+    class PlaneScope {
+    public:
+        PlaneScope(std::shared_ptr<const void> owner, const float* data);
+        ~PlaneScope();
+        PlaneScope(const PlaneScope&) = delete;
+        PlaneScope& operator=(const PlaneScope&) = delete;
+
+    private:
+        std::shared_ptr<const void> _previous_owner;
+        const float* _previous_data;
+    };
+
+    // As KernelGaussianSmooth, with the separable kernel from MakeKernel
+    static bool KernelGaussianSmooth(const float* src_data, float* dest_data, int64_t src_width, int64_t src_height, int64_t dest_width,
+        int64_t dest_height, const std::vector<float>& kernel);
+    // Adds the counts of the values between min_val and max_val to bins, as Histogram::FillBins
+    static bool FillBins(
+        const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins);
+    // Count, sums, min and max of the finite values, as AccumulateFiniteStats from empty stats
+    static bool FiniteStats(
+        const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__GPUCOMPUTE_H_
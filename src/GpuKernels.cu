@@ -0,0 +1,239 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "GpuKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include <cuda_runtime.h>
+#include <spdlog/spdlog.h>
+
+// Largest smoothing kernel, in constant memory, and histogram kept in shared memory per block
+#define GPU_MAX_KERNEL_SIZE 64
+#define GPU_SHARED_BINS 8192
+
+namespace carta {
+namespace gpu {
+
+__constant__ float convolution_kernel[GPU_MAX_KERNEL_SIZE];
+
+static bool Check(cudaError_t error, const char* operation) {
+    if (error != cudaSuccess) {
+        spdlog::warn("GPU {} failed: {}", operation, cudaGetErrorString(error));
+        return false;
+    }
+    return true;
+}
+
+int DeviceCount() {
+    int count(0);
+    if (cudaGetDeviceCount(&count) != cudaSuccess) {
+        return 0;
+    }
+    return count;
+}
+
+float* Allocate(size_t length) {
+    float* device_data(nullptr);
+    if (!Check(cudaMalloc(&device_data, length * sizeof(float)), "allocation")) {
+        return nullptr;
+    }
+    return device_data;
+}
+
+void Free(float* device_data) {
+    if (device_data) {
+        cudaFree(device_data);
+    }
+}
+
+bool Upload(float* device_data, const float* host_data, size_t length) {
+    return Check(cudaMemcpy(device_data, host_data, length * sizeof(float), cudaMemcpyHostToDevice), "upload");
+}
+
+bool Download(float* host_data, const float* device_data, size_t length) {
+    return Check(cudaMemcpy(host_data, device_data, length * sizeof(float), cudaMemcpyDeviceToHost), "download");
+}
+
+// One output pixel per thread; jump is 1 for the horizontal pass and the row length for the vertical pass
+__global__ void ConvolveKernel(const float* src, float* dest, int64_t src_width, int64_t dest_width, int64_t dest_height, int64_t x_offset,
+    int64_t y_offset, int64_t jump, int radius) {
+    int64_t dest_x = blockIdx.x * (int64_t)blockDim.x + threadIdx.x;
+    int64_t dest_y = blockIdx.y;
+    if (dest_x >= dest_width || dest_y >= dest_height) {
+        return;
+    }
+    const float* center = src + (dest_y + y_offset) * src_width + dest_x + x_offset;
+    float sum(0), weight(0);
+    for (int i = -radius; i <= radius; ++i) {
+        float val = center[i * jump];
+        if (isfinite(val)) {
+            float w = convolution_kernel[i + radius];
+            sum += val * w;
+            weight += w;
+        }
+    }
+    dest[dest_y * dest_width + dest_x] = weight > 0 ? sum / weight : NAN;
+}
+
+bool SeparableConvolve(const float* device_src, float* device_temp, float* device_dest, int64_t src_width, int64_t src_height,
+    int64_t dest_width, int64_t dest_height, const float* kernel, int kernel_size) {
+    if (kernel_size > GPU_MAX_KERNEL_SIZE || src_height > 65535 || !(kernel_size % 2)) {
+        return false;
+    }
+    if (!Check(cudaMemcpyToSymbol(convolution_kernel, kernel, kernel_size * sizeof(float)), "kernel upload")) {
+        return false;
+    }
+    int radius = (kernel_size - 1) / 2;
+    unsigned int num_blocks_x = (dest_width + GPU_BLOCK_SIZE - 1) / GPU_BLOCK_SIZE;
+    ConvolveKernel<<<dim3(num_blocks_x, src_height), GPU_BLOCK_SIZE>>>(
+        device_src, device_temp, src_width, dest_width, src_height, radius, 0, 1, radius);
+    ConvolveKernel<<<dim3(num_blocks_x, dest_height), GPU_BLOCK_SIZE>>>(
+        device_temp, device_dest, dest_width, dest_width, dest_height, 0, radius, dest_width, radius);
+    return Check(cudaGetLastError(), "smoothing") && Check(cudaDeviceSynchronize(), "smoothing");
+}
+
+// Bin number of a value in range, as the CPU kernels: a NaN bin number (zero bin width) goes to the last bin
+__device__ inline size_t BinNumber(float val, float min_val, float bin_width, size_t num_bins) {
+    float bin = (val - min_val) / bin_width;
+    float last_bin = num_bins - 1;
+    bin = isnan(bin) ? last_bin : fminf(fmaxf(bin, 0.0f), last_bin);
+    return (size_t)bin;
+}
+
+__global__ void SharedFillBinsKernel(
+    const float* data, size_t length, float min_val, float max_val, float bin_width, size_t num_bins, unsigned long long* bins) {
+    __shared__ unsigned int block_bins[GPU_SHARED_BINS];
+    for (size_t i = threadIdx.x; i < num_bins; i += blockDim.x) {
+        block_bins[i] = 0;
+    }
+    __syncthreads();
+    for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < length; i += (size_t)gridDim.x * blockDim.x) {
+        float val = data[i];
+        if (min_val <= val && val <= max_val) {
+            atomicAdd(&block_bins[BinNumber(val, min_val, bin_width, num_bins)], 1u);
+        }
+    }
+    __syncthreads();
+    for (size_t i = threadIdx.x; i < num_bins; i += blockDim.x) {
+        if (block_bins[i]) {
+            atomicAdd(&bins[i], (unsigned long long)block_bins[i]);
+        }
+    }
+}
+
+__global__ void GlobalFillBinsKernel(
+    const float* data, size_t length, float min_val, float max_val, float bin_width, size_t num_bins, unsigned long long* bins) {
+    for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < length; i += (size_t)gridDim.x * blockDim.x) {
+        float val = data[i];
+        if (min_val <= val && val <= max_val) {
+            atomicAdd(&bins[BinNumber(val, min_val, bin_width, num_bins)], 1ull);
+        }
+    }
+}
+
+bool FillBins(const float* device_data, size_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins) {
+    unsigned long long* device_bins(nullptr);
+    if (!Check(cudaMalloc(&device_bins, num_bins * sizeof(unsigned long long)), "allocation")) {
+        return false;
+    }
+    std::vector<unsigned long long> host_bins(num_bins);
+    bool ok = Check(cudaMemset(device_bins, 0, num_bins * sizeof(unsigned long long)), "histogram");
+    if (ok) {
+        unsigned int num_blocks = std::min((length + GPU_BLOCK_SIZE - 1) / GPU_BLOCK_SIZE, (size_t)GPU_STATS_BLOCKS);
+        if (num_bins <= GPU_SHARED_BINS) {
+            SharedFillBinsKernel<<<num_blocks, GPU_BLOCK_SIZE>>>(device_data, length, min_val, max_val, bin_width, num_bins, device_bins);
+        } else {
+            GlobalFillBinsKernel<<<num_blocks, GPU_BLOCK_SIZE>>>(device_data, length, min_val, max_val, bin_width, num_bins, device_bins);
+        }
+        ok = Check(cudaGetLastError(), "histogram") &&
+             Check(cudaMemcpy(host_bins.data(), device_bins, num_bins * sizeof(unsigned long long), cudaMemcpyDeviceToHost), "histogram");
+    }
+    cudaFree(device_bins);
+    if (ok) {
+        for (size_t i = 0; i < num_bins; ++i) {
+            bins[i] += host_bins[i];
+        }
+    }
+    return ok;
+}
+
+struct PartialStats {
+    float min_val;
+    float max_val;
+    unsigned long long num_pixels;
+    double sum;
+    double sum_squares;
+};
+
+// Partial stats of each block, reduced on the host; squares are computed in single precision as in the CPU kernels
+__global__ void FiniteStatsKernel(const float* data, size_t length, PartialStats* partials) {
+    __shared__ PartialStats thread_stats[GPU_BLOCK_SIZE];
+    PartialStats stats{FLT_MAX, -FLT_MAX, 0, 0, 0};
+    for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < length; i += (size_t)gridDim.x * blockDim.x) {
+        float val = data[i];
+        if (isfinite(val)) {
+            stats.min_val = fminf(stats.min_val, val);
+            stats.max_val = fmaxf(stats.max_val, val);
+            ++stats.num_pixels;
+            stats.sum += val;
+            stats.sum_squares += val * val;
+        }
+    }
+    thread_stats[threadIdx.x] = stats;
+    __syncthreads();
+    for (unsigned int stride = blockDim.x / 2; stride > 0; stride /= 2) {
+        if (threadIdx.x < stride) {
+            PartialStats& a = thread_stats[threadIdx.x];
+            const PartialStats& b = thread_stats[threadIdx.x + stride];
+            a.min_val = fminf(a.min_val, b.min_val);
+            a.max_val = fmaxf(a.max_val, b.max_val);
+            a.num_pixels += b.num_pixels;
+            a.sum += b.sum;
+            a.sum_squares += b.sum_squares;
+        }
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) {
+        partials[blockIdx.x] = thread_stats[0];
+    }
+}
+
+bool FiniteStats(
+    const float* device_data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    unsigned int num_blocks = std::min((length + GPU_BLOCK_SIZE - 1) / GPU_BLOCK_SIZE, (size_t)GPU_STATS_BLOCKS);
+    PartialStats* device_partials(nullptr);
+    if (!num_blocks || !Check(cudaMalloc(&device_partials, num_blocks * sizeof(PartialStats)), "allocation")) {
+        return false;
+    }
+    std::vector<PartialStats> partials(num_blocks);
+    FiniteStatsKernel<<<num_blocks, GPU_BLOCK_SIZE>>>(device_data, length, device_partials);
+    bool ok = Check(cudaGetLastError(), "statistics") &&
+              Check(cudaMemcpy(partials.data(), device_partials, num_blocks * sizeof(PartialStats), cudaMemcpyDeviceToHost), "statistics");
+    cudaFree(device_partials);
+    if (!ok) {
+        return false;
+    }
+
+    min_val = FLT_MAX;
+    max_val = -FLT_MAX;
+    num_pixels = 0;
+    sum = 0;
+    sum_squares = 0;
+    for (const auto& partial : partials) {
+        min_val = std::min(min_val, partial.min_val);
+        max_val = std::max(max_val, partial.max_val);
+        num_pixels += partial.num_pixels;
+        sum += partial.sum;
+        sum_squares += partial.sum_squares;
+    }
+    return true;
+}
+
+} // namespace gpu
+} // namespace carta
@@ -0,0 +1,46 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# GpuKernels.h: CUDA kernels of GpuCompute, built with EnableCuda; device pointers are float arrays allocated here
+
+#ifndef CARTA_BACKEND__GPUKERNELS_H_
+#define CARTA_BACKEND__GPUKERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Threads per block of the kernels, and blocks of the statistics reduction
+#define GPU_BLOCK_SIZE 256
+#define GPU_STATS_BLOCKS 1024
+
+namespace carta {
+namespace gpu {
+
+int DeviceCount();
+
+// Return nullptr or false on a device error, which is logged
+float* Allocate(size_t length);
+void Free(float* device_data);
+bool Upload(float* device_data, const float* host_data, size_t length);
+bool Download(float* host_data, const float* device_data, size_t length);
+
+// Horizontal pass from src (src_width x src_height) into temp (dest_width x src_height), then vertical pass into dest (dest_width
+// x dest_height), offset by the kernel radius. Pixels are the normalized sums of the finite values under the kernel, or NaN if it
+// covers none.
+bool SeparableConvolve(const float* device_src, float* device_temp, float* device_dest, int64_t src_width, int64_t src_height,
+    int64_t dest_width, int64_t dest_height, const float* kernel, int kernel_size);
+
+// Adds to the host bins
+bool FillBins(const float* device_data, size_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins);
+
+// Statistics of the finite values, from empty stats
+bool FiniteStats(
+    const float* device_data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+
+} // namespace gpu
+} // namespace carta
+
+#endif // CARTA_BACKEND__GPUKERNELS_H_
@@ -0,0 +1,94 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ArrayChunks.h: arrays of values streamed as messages of consecutive little-endian values
+
+#ifndef CARTA_BACKEND_GRPCSERVER_ARRAYCHUNKS_H_
+#define CARTA_BACKEND_GRPCSERVER_ARRAYCHUNKS_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <carta-data/carta_data.pb.h>
+
+#include "../Constants.h"
+
+namespace carta {
+
+// Array in chunks of DATA_STREAM_CHUNK_BYTES, passed to the write function in order; false if a write fails
+template <typename T, typename WriteChunk>
+bool WriteArrayChunks(const std::string& name, const std::vector<int64_t>& shape, const std::vector<T>& values, WriteChunk write_chunk) {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Arrays are float32 or float64");
+    const size_t chunk_values = std::max((size_t)1, (size_t)(DATA_STREAM_CHUNK_BYTES) / sizeof(T));
+
+    size_t offset(0);
+    do {
+        size_t count = std::min(chunk_values, values.size() - offset);
+        CARTA::data::ArrayChunk chunk;
+        chunk.set_name(name);
+        if (offset == 0) {
+            chunk.mutable_shape()->Add(shape.begin(), shape.end());
+        }
+        chunk.set_type(std::is_same_v<T, float> ? CARTA::data::FLOAT32 : CARTA::data::FLOAT64);
+        chunk.set_offset(offset);
+
+        std::string* data = chunk.mutable_data();
+        data->resize(count * sizeof(T));
+        if (count) {
+            memcpy(data->data(), values.data() + offset, count * sizeof(T));
+        }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        for (size_t i = 0; i < count; ++i) {
+            char* value = data->data() + i * sizeof(T);
+            std::reverse(value, value + sizeof(T));
+        }
+#endif
+
+        if (!write_chunk(chunk)) {
+            return false;
+        }
+        offset += count;
+    } while (offset < values.size());
+    return true;
+}
+
+// Copies a chunk of float32 values to the array, which is sized by the shape in the first chunk; false if the chunk does not fit
+inline bool ReadArrayChunk(const CARTA::data::ArrayChunk& chunk, std::vector<int64_t>& shape, std::vector<float>& values) {
+    if (chunk.type() != CARTA::data::FLOAT32) {
+        return false;
+    }
+    if (chunk.offset() == 0) {
+        shape.assign(chunk.shape().begin(), chunk.shape().end());
+        size_t size(1);
+        for (auto length : shape) {
+            size *= length;
+        }
+        values.resize(size);
+    }
+
+    size_t count = chunk.data().size() / sizeof(float);
+    if (chunk.offset() + count > values.size()) {
+        return false;
+    }
+    float* dest = values.data() + chunk.offset();
+    if (count) {
+        memcpy(dest, chunk.data().data(), count * sizeof(float));
+    }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; ++i) {
+        char* value = (char*)(dest + i);
+        std::reverse(value, value + sizeof(float));
+    }
+#endif
+    return true;
+}
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_GRPCSERVER_ARRAYCHUNKS_H_
@@ -0,0 +1,414 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CartaDataService.cc: grpc service streaming rasters, profiles, stats, moments and PV images of the images open in a session
+
+#include "CartaDataService.h"
+
+#include <algorithm>
+#include <cmath>
+#include <shared_mutex>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <carta-protobuf/defs.pb.h>
+#include <carta-protobuf/enums.pb.h>
+#include <carta-protobuf/moment_request.pb.h>
+
+#include "../Constants.h"
+#include "../Frame.h"
+#include "../Util.h"
+#include "ArrayChunks.h"
+
+using ArrayWriter = grpc::ServerWriter<CARTA::data::ArrayChunk>;
+
+namespace {
+
+// Session and frame of an open file, held until the call is done
+class OpenFile {
+public:
+    OpenFile(CartaGrpcService& sessions, uint32_t session_id, int file_id) : _session(sessions.AcquireSession(session_id)) {
+        if (!_session) {
+            status = grpc::Status(grpc::StatusCode::OUT_OF_RANGE, fmt::format("Invalid session ID {}.", session_id));
+            return;
+        }
+        frame = _session->GetFrame(file_id);
+        if (!frame || !frame->IsValid()) {
+            status = grpc::Status(grpc::StatusCode::NOT_FOUND, fmt::format("File id {} not open in session {}.", file_id, session_id));
+        }
+    }
+    ~OpenFile() {
+        frame.reset();
+        if (_session) {
+            CartaGrpcService::ReleaseSession(_session);
+        }
+    }
+    OpenFile(const OpenFile&) = delete;
+    OpenFile& operator=(const OpenFile&) = delete;
+
+    Session* operator->() {
+        return _session;
+    }
+
+    std::shared_ptr<Frame> frame;
+    grpc::Status status;
+
+private:
+    Session* _session;
+};
+
+grpc::Status InvalidArgument(const std::string& message) {
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
+}
+
+grpc::Status FileClosed(int file_id) {
+    return grpc::Status(grpc::StatusCode::ABORTED, fmt::format("File id {} was closed.", file_id));
+}
+
+grpc::Status StreamCancelled() {
+    return grpc::Status(grpc::StatusCode::CANCELLED, "Stream cancelled by the client.");
+}
+
+// Array in chunks of DATA_STREAM_CHUNK_BYTES; false if the client has gone
+template <typename T>
+bool WriteArray(ArrayWriter* writer, const std::string& name, const std::vector<int64_t>& shape, const std::vector<T>& values) {
+    return carta::WriteArrayChunks(name, shape, values, [&](const CARTA::data::ArrayChunk& chunk) { return writer->Write(chunk); });
+}
+
+// Stats types by name, in request order; the defaults if none
+bool ParseStatsTypes(const google::protobuf::RepeatedPtrField<std::string>& names, const std::vector<CARTA::StatsType>& defaults,
+    std::vector<CARTA::StatsType>& stats_types, std::string& message) {
+    stats_types.clear();
+    for (auto& name : names) {
+        CARTA::StatsType stats_type;
+        if (!CARTA::StatsType_Parse(name, &stats_type)) {
+            message = fmt::format("Invalid stats type {}.", name);
+            return false;
+        }
+        stats_types.push_back(stats_type);
+    }
+    if (stats_types.empty()) {
+        stats_types = defaults;
+    }
+    return true;
+}
+
+bool WriteStats(ArrayWriter* writer, const std::vector<CARTA::StatsType>& stats_types,
+    std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
+    for (auto stats_type : stats_types) {
+        auto& values = stats_values[stats_type];
+        if (!WriteArray(writer, CARTA::StatsType_Name(stats_type), {(int64_t)values.size()}, values)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ValidStokes(Frame& frame, int& stokes) {
+    stokes = (stokes == CURRENT_STOKES ? frame.CurrentStokes() : stokes);
+    return (stokes >= 0) && ((size_t)stokes < frame.NumStokes());
+}
+
+bool ValidZ(Frame& frame, int& z) {
+    z = (z == CURRENT_Z ? frame.CurrentZ() : z);
+    return (z >= 0) && ((size_t)z < frame.Depth());
+}
+
+} // namespace
+
+CartaDataService::CartaDataService(CartaGrpcService& sessions) : _sessions(sessions) {}
+
+grpc::Status CartaDataService::GetRaster(
+    grpc::ServerContext* context, const CARTA::data::RasterRequest* request, ArrayWriter* writer) {
+    OpenFile file(_sessions, request->session_id(), request->file_id());
+    if (!file.status.ok()) {
+        return file.status;
+    }
+    auto& frame = file.frame;
+
+    int z(request->channel()), stokes(request->stokes());
+    if (!ValidZ(*frame, z) || !ValidStokes(*frame, stokes)) {
+        return InvalidArgument(fmt::format("Invalid channel {} or stokes {}.", request->channel(), request->stokes()));
+    }
+
+    CARTA::ImageBounds bounds;
+    if (!request->x_min() && !request->x_max() && !request->y_min() && !request->y_max()) {
+        bounds.set_x_max(frame->Width());
+        bounds.set_y_max(frame->Height());
+    } else {
+        bounds.set_x_min(request->x_min());
+        bounds.set_x_max(request->x_max());
+        bounds.set_y_min(request->y_min());
+        bounds.set_y_max(request->y_max());
+    }
+    int mip = std::max(request->mip(), 1);
+    int width(frame->Width()), height(frame->Height());
+    if ((bounds.x_min() < 0) || (bounds.y_min() < 0) || (bounds.x_max() > width) || (bounds.y_max() > height) ||
+        (bounds.x_min() >= bounds.x_max()) || (bounds.y_min() >= bounds.y_max())) {
+        return InvalidArgument(fmt::format("Invalid bounds x {}-{}, y {}-{} for image {}x{}.", bounds.x_min(), bounds.x_max(),
+            bounds.y_min(), bounds.y_max(), width, height));
+    }
+
+    std::vector<float> raster;
+    {
+        std::shared_lock lock(frame->GetActiveTaskMutex()); // closing the file waits for the read
+        if (!frame->IsConnected()) {
+            return FileClosed(request->file_id());
+        }
+        if (!frame->GetPlaneRasterData(raster, bounds, z, stokes, mip)) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Reading raster data failed.");
+        }
+    }
+
+    int64_t raster_width = std::ceil((float)(bounds.x_max() - bounds.x_min()) / mip);
+    int64_t raster_height = std::ceil((float)(bounds.y_max() - bounds.y_min()) / mip);
+    return WriteArray(writer, "", {raster_width, raster_height}, raster) ? grpc::Status::OK : StreamCancelled();
+}
+
+grpc::Status CartaDataService::GetSpectralProfile(
+    grpc::ServerContext* context, const CARTA::data::SpectralProfileRequest* request, ArrayWriter* writer) {
+    OpenFile file(_sessions, request->session_id(), request->file_id());
+    if (!file.status.ok()) {
+        return file.status;
+    }
+    auto& frame = file.frame;
+
+    int file_id(request->file_id()), region_id(request->region_id()), stokes(request->stokes());
+    if (!ValidStokes(*frame, stokes)) {
+        return InvalidArgument(fmt::format("Invalid stokes {}.", request->stokes()));
+    }
+
+    if (region_id == CURSOR_REGION_ID) {
+        int x(request->x()), y(request->y());
+        if ((x < 0) || (y < 0) || ((size_t)x >= frame->Width()) || ((size_t)y >= frame->Height())) {
+            return InvalidArgument(fmt::format("Invalid point ({}, {}).", x, y));
+        }
+
+        std::vector<float> profile;
+        {
+            std::shared_lock lock(frame->GetActiveTaskMutex());
+            if (!frame->IsConnected()) {
+                return FileClosed(file_id);
+            }
+            CARTA::Point point;
+            point.set_x(x);
+            point.set_y(y);
+            if (!frame->GetLoaderPointSpectralData(profile, stokes, point)) {
+                casacore::Slicer slicer = frame->GetImageSlicer(AxisRange(x), AxisRange(y), AxisRange(ALL_Z), stokes);
+                if (!frame->GetSlicerData(slicer, profile)) {
+                    return grpc::Status(grpc::StatusCode::INTERNAL, "Reading spectral profile failed.");
+                }
+            }
+        }
+        return WriteArray(writer, "", {(int64_t)profile.size()}, profile) ? grpc::Status::OK : StreamCancelled();
+    }
+
+    std::vector<CARTA::StatsType> stats_types;
+    std::string message;
+    if (!ParseStatsTypes(request->stats(), {CARTA::StatsType::Mean}, stats_types, message)) {
+        return InvalidArgument(message);
+    }
+
+    // The region is applied before the frame is locked, since closing the file holds the session's frames while it waits
+    casacore::ImageRegion image_region;
+    if ((region_id < 0) || !file->GetRegionImage(file_id, region_id, AxisRange(0, frame->Depth() - 1), stokes, image_region)) {
+        return grpc::Status(
+            grpc::StatusCode::NOT_FOUND, fmt::format("Region {} is not set or is outside the image of file {}.", region_id, file_id));
+    }
+
+    std::map<CARTA::StatsType, std::vector<double>> stats_values;
+    {
+        std::shared_lock lock(frame->GetActiveTaskMutex());
+        if (!frame->IsConnected()) {
+            return FileClosed(file_id);
+        }
+        if (!frame->GetRegionStats(image_region, stats_types, true, stats_values)) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Calculating spectral profiles failed.");
+        }
+    }
+    return WriteStats(writer, stats_types, stats_values) ? grpc::Status::OK : StreamCancelled();
+}
+
+grpc::Status CartaDataService::GetRegionStats(
+    grpc::ServerContext* context, const CARTA::data::RegionStatsRequest* request, ArrayWriter* writer) {
+    OpenFile file(_sessions, request->session_id(), request->file_id());
+    if (!file.status.ok()) {
+        return file.status;
+    }
+    auto& frame = file.frame;
+
+    int file_id(request->file_id()), region_id(request->region_id()), z(request->channel()), stokes(request->stokes());
+    AxisRange z_range(0, frame->Depth() - 1);
+    if (z != ALL_Z) {
+        if (!ValidZ(*frame, z)) {
+            return InvalidArgument(fmt::format("Invalid channel {}.", request->channel()));
+        }
+        z_range = AxisRange(z);
+    }
+    if (!ValidStokes(*frame, stokes)) {
+        return InvalidArgument(fmt::format("Invalid stokes {}.", request->stokes()));
+    }
+
+    std::vector<CARTA::StatsType> stats_types;
+    std::string message;
+    if (!ParseStatsTypes(request->stats(),
+            {CARTA::StatsType::Sum, CARTA::StatsType::Mean, CARTA::StatsType::RMS, CARTA::StatsType::Min, CARTA::StatsType::Max},
+            stats_types, message)) {
+        return InvalidArgument(message);
+    }
+
+    casacore::ImageRegion image_region;
+    if ((region_id == CURSOR_REGION_ID) || !file->GetRegionImage(file_id, region_id, z_range, stokes, image_region)) {
+        return grpc::Status(
+            grpc::StatusCode::NOT_FOUND, fmt::format("Region {} is not set or is outside the image of file {}.", region_id, file_id));
+    }
+
+    std::map<CARTA::StatsType, std::vector<double>> stats_values;
+    {
+        std::shared_lock lock(frame->GetActiveTaskMutex());
+        if (!frame->IsConnected()) {
+            return FileClosed(file_id);
+        }
+        if (!frame->GetRegionStats(image_region, stats_types, false, stats_values)) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Calculating region stats failed.");
+        }
+    }
+    return WriteStats(writer, stats_types, stats_values) ? grpc::Status::OK : StreamCancelled();
+}
+
+grpc::Status CartaDataService::GetMoments(
+    grpc::ServerContext* context, const CARTA::data::MomentsRequest* request, ArrayWriter* writer) {
+    OpenFile file(_sessions, request->session_id(), request->file_id());
+    if (!file.status.ok()) {
+        return file.status;
+    }
+    auto& frame = file.frame;
+
+    int file_id(request->file_id()), region_id(request->region_id()), stokes(request->stokes());
+    int z_min(request->channel_min());
+    int depth(frame->Depth());
+    int z_max(request->channel_max() < 0 ? depth - 1 : request->channel_max());
+    if ((z_min < 0) || (z_min > z_max) || (z_max >= depth)) {
+        return InvalidArgument(fmt::format("Invalid channel range {}-{}.", request->channel_min(), request->channel_max()));
+    }
+    if (!ValidStokes(*frame, stokes)) {
+        return InvalidArgument(fmt::format("Invalid stokes {}.", request->stokes()));
+    }
+
+    CARTA::MomentRequest moment_request;
+    moment_request.set_file_id(file_id);
+    for (auto& name : request->moments()) {
+        CARTA::Moment moment;
+        if (!CARTA::Moment_Parse(name, &moment)) {
+            return InvalidArgument(fmt::format("Invalid moment {}.", name));
+        }
+        moment_request.add_moments(moment);
+    }
+    if (!moment_request.moments_size()) {
+        return InvalidArgument("No moments requested.");
+    }
+    CARTA::MomentMask mask(CARTA::MomentMask::None);
+    if (!request->mask().empty() && !CARTA::MomentMask_Parse(request->mask(), &mask)) {
+        return InvalidArgument(fmt::format("Invalid moment mask {}.", request->mask()));
+    }
+    moment_request.set_axis(CARTA::MomentAxis::SPECTRAL);
+    moment_request.set_region_id(region_id);
+    moment_request.mutable_spectral_range()->set_min(z_min);
+    moment_request.mutable_spectral_range()->set_max(z_max);
+    moment_request.set_mask(mask);
+    moment_request.mutable_pixel_range()->set_min(request->pixel_min());
+    moment_request.mutable_pixel_range()->set_max(request->pixel_max());
+
+    casacore::ImageRegion image_region;
+    if ((region_id == CURSOR_REGION_ID) || !file->GetRegionImage(file_id, region_id, AxisRange(z_min, z_max), stokes, image_region)) {
+        return grpc::Status(
+            grpc::StatusCode::NOT_FOUND, fmt::format("Region {} is not set or is outside the image of file {}.", region_id, file_id));
+    }
+
+    // The client going away stops the calculation at the next progress update; the frame locks itself for moments
+    auto progress_callback = [&](float progress) {
+        if (context->IsCancelled()) {
+            frame->StopMomentCalc();
+        }
+    };
+    CARTA::MomentResponse moment_response;
+    std::vector<carta::CollapseResult> collapse_results;
+    if (!frame->CalculateMoments(file_id, progress_callback, image_region, moment_request, moment_response, collapse_results)) {
+        if (moment_response.cancel()) {
+            return context->IsCancelled() ? StreamCancelled() : FileClosed(file_id);
+        }
+        return grpc::Status(grpc::StatusCode::INTERNAL, fmt::format("Calculating moments failed: {}", moment_response.message()));
+    }
+
+    for (auto& collapse_result : collapse_results) {
+        casacore::Array<float> data = collapse_result.image->get(true);
+        std::vector<int64_t> shape(data.shape().begin(), data.shape().end());
+        if (!WriteArray(writer, collapse_result.name, shape, data.tovector())) {
+            return StreamCancelled();
+        }
+    }
+    return grpc::Status::OK;
+}
+
+grpc::Status CartaDataService::GetPvImage(grpc::ServerContext* context, const CARTA::data::PvRequest* request, ArrayWriter* writer) {
+    OpenFile file(_sessions, request->session_id(), request->file_id());
+    if (!file.status.ok()) {
+        return file.status;
+    }
+    auto& frame = file.frame;
+
+    int file_id(request->file_id()), region_id(request->region_id()), stokes(request->stokes());
+    int z_min(request->channel_min());
+    int depth(frame->Depth());
+    int z_max(request->channel_max() < 0 ? depth - 1 : request->channel_max());
+    if ((z_min < 0) || (z_min > z_max) || (z_max >= depth)) {
+        return InvalidArgument(fmt::format("Invalid channel range {}-{}.", request->channel_min(), request->channel_max()));
+    }
+    if (!ValidStokes(*frame, stokes)) {
+        return InvalidArgument(fmt::format("Invalid stokes {}.", request->stokes()));
+    }
+    carta::PvInterpolation interpolation(carta::PvInterpolation::Bilinear);
+    if (request->interpolation() == "Nearest") {
+        interpolation = carta::PvInterpolation::Nearest;
+    } else if (!request->interpolation().empty() && (request->interpolation() != "Bilinear")) {
+        return InvalidArgument(fmt::format("Invalid interpolation {}.", request->interpolation()));
+    }
+    int width = std::max(request->width(), 1);
+
+    // The region is applied before the frame is locked, as for region stats
+    std::vector<PointXy> path;
+    if (region_id > 0) {
+        if (!file->GetRegionPath(file_id, region_id, path)) {
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, fmt::format("Region {} is not a line or polyline region.", region_id));
+        }
+    } else {
+        auto& vertices = request->vertices();
+        if ((vertices.size() < 4) || (vertices.size() % 2)) {
+            return InvalidArgument("The path needs at least two vertices.");
+        }
+        for (int i = 0; i < vertices.size(); i += 2) {
+            path.emplace_back(vertices[i], vertices[i + 1]);
+        }
+    }
+
+    // The client going away or the file closing stops the calculation; the frame locks itself for PV images
+    auto progress_callback = [&](float progress) { return !context->IsCancelled(); };
+    std::shared_ptr<casacore::ImageInterface<casacore::Float>> pv_image;
+    std::string message;
+    if (!frame->CalculatePv(path, width, interpolation, AxisRange(z_min, z_max), stokes, progress_callback, pv_image, message)) {
+        if (context->IsCancelled()) {
+            return StreamCancelled();
+        }
+        if (!frame->IsConnected()) {
+            return FileClosed(file_id);
+        }
+        return grpc::Status(grpc::StatusCode::INTERNAL, fmt::format("Calculating the PV image failed: {}", message));
+    }
+
+    casacore::Array<float> data = pv_image->get(true);
+    std::vector<int64_t> shape(data.shape().begin(), data.shape().end());
+    return WriteArray(writer, "", shape, data.tovector()) ? grpc::Status::OK : StreamCancelled();
+}
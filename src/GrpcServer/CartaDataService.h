@@ -0,0 +1,39 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CartaDataService.h: grpc service streaming rasters, profiles, stats, moments and PV images of the images open in a session
+
+#ifndef CARTA_BACKEND_GRPCSERVER_CARTADATASERVICE_H_
+#define CARTA_BACKEND_GRPCSERVER_CARTADATASERVICE_H_
+
+#include <grpc++/grpc++.h>
+
+#include <carta-data/carta_data.grpc.pb.h>
+
+#include "CartaGrpcService.h"
+
+// The calculations run on the grpc thread of the call with the frame and loader of the open file, so they share the image
+// cache and loader caches with the session, but not its region requirements or data streams.
+class CartaDataService : public CARTA::data::CartaData::Service {
+public:
+    explicit CartaDataService(CartaGrpcService& sessions);
+
+    grpc::Status GetRaster(
+        grpc::ServerContext* context, const CARTA::data::RasterRequest* request, grpc::ServerWriter<CARTA::data::ArrayChunk>* writer);
+    grpc::Status GetSpectralProfile(grpc::ServerContext* context, const CARTA::data::SpectralProfileRequest* request,
+        grpc::ServerWriter<CARTA::data::ArrayChunk>* writer);
+    grpc::Status GetRegionStats(grpc::ServerContext* context, const CARTA::data::RegionStatsRequest* request,
+        grpc::ServerWriter<CARTA::data::ArrayChunk>* writer);
+    grpc::Status GetMoments(grpc::ServerContext* context, const CARTA::data::MomentsRequest* request,
+        grpc::ServerWriter<CARTA::data::ArrayChunk>* writer);
+    grpc::Status GetPvImage(grpc::ServerContext* context, const CARTA::data::PvRequest* request,
+        grpc::ServerWriter<CARTA::data::ArrayChunk>* writer);
+
+private:
+    CartaGrpcService& _sessions;
+};
+
+#endif // CARTA_BACKEND_GRPCSERVER_CARTADATASERVICE_H_
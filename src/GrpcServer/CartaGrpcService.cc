@@ -8,6 +8,7 @@
 
 #include "CartaGrpcService.h"
 
+#include <algorithm>
 #include <chrono>
 
 #include <spdlog/fmt/fmt.h>
@@ -19,7 +20,7 @@
 #include "../Constants.h"
 #include "../Util.h"
 
-uint32_t CartaGrpcService::_scripting_request_id = 0;
+std::atomic<uint32_t> CartaGrpcService::_scripting_request_id(0);
 
 CartaGrpcService::CartaGrpcService() {}
 
@@ -27,17 +28,36 @@ void CartaGrpcService::AddSession(Session* session) {
     // Map session to its ID, set connected to false
     auto session_id = session->GetId();
     std::pair<Session*, bool> session_info(session, false);
+    std::scoped_lock lock(_sessions_mutex);
     _sessions[session_id] = session_info;
 }
 
 void CartaGrpcService::RemoveSession(Session* session) {
     // Remove Session from map
     auto session_id = session->GetId();
+    std::scoped_lock lock(_sessions_mutex);
     if (_sessions.count(session_id)) {
         _sessions.erase(session_id);
     }
 }
 
+Session* CartaGrpcService::AcquireSession(uint32_t session_id) {
+    std::scoped_lock lock(_sessions_mutex);
+    auto it = _sessions.find(session_id);
+    if (it == _sessions.end()) {
+        return nullptr;
+    }
+    auto session = it->second.first;
+    session->IncreaseRefCount();
+    return session;
+}
+
+void CartaGrpcService::ReleaseSession(Session* session) {
+    if (!session->DecreaseRefCount()) {
+        delete session;
+    }
+}
+
 grpc::Status CartaGrpcService::CallAction(
     grpc::ServerContext* context, const CARTA::script::ActionRequest* request, CARTA::script::ActionReply* reply) {
     auto session_id = request->session_id();
@@ -49,25 +69,31 @@ grpc::Status CartaGrpcService::CallAction(
 
     grpc::Status status(grpc::Status::OK);
 
-    if (_sessions.find(session_id) == _sessions.end()) {
+    Session* session = AcquireSession(session_id);
+    if (!session) {
         status = grpc::Status(grpc::StatusCode::OUT_OF_RANGE, fmt::format("Invalid session ID {}.", session_id));
     } else {
-        _scripting_request_id++;
-        _scripting_request_id = std::max(_scripting_request_id, 1u);
+        // protect against overflow
+        uint32_t scripting_request_id = ++_scripting_request_id;
+        if (!scripting_request_id) {
+            scripting_request_id = ++_scripting_request_id;
+        }
 
-        auto session = _sessions[session_id].first;
-        session->SendScriptingRequest(_scripting_request_id, path, action, parameters, async);
+        session->SendScriptingRequest(scripting_request_id, path, action, parameters, async);
 
-        auto t_start = std::chrono::system_clock::now();
-        while (!session->GetScriptingResponse(_scripting_request_id, reply)) {
-            auto t_end = std::chrono::system_clock::now();
-            std::chrono::duration<double> elapsed_sec = t_end - t_start;
-            if (elapsed_sec.count() > SCRIPTING_TIMEOUT) {
+        // The thread of the call sleeps until the response arrives, the client's deadline if sooner, or the session disconnects
+        auto deadline = std::min(std::chrono::system_clock::now() + std::chrono::seconds(SCRIPTING_TIMEOUT), context->deadline());
+        if (!session->WaitForScriptingResponse(scripting_request_id, deadline, reply)) {
+            if (std::chrono::system_clock::now() >= deadline) {
                 // TODO: more specific error
-                return grpc::Status(
+                status = grpc::Status(
                     grpc::StatusCode::DEADLINE_EXCEEDED, fmt::format("Scripting request to session {} timed out.", session_id));
+            } else {
+                status = grpc::Status(grpc::StatusCode::UNAVAILABLE, fmt::format("Session {} disconnected.", session_id));
             }
         }
+
+        ReleaseSession(session);
     }
 
     return status;
@@ -9,7 +9,8 @@
 #ifndef CARTA_BACKEND_GRPCSERVER_CARTAGRPCSERVICE_H_
 #define CARTA_BACKEND_GRPCSERVER_CARTAGRPCSERVICE_H_
 
-// #include <condition_variable>
+#include <atomic>
+#include <mutex>
 
 #include <grpc++/grpc++.h>
 
@@ -22,14 +23,18 @@ public:
     CartaGrpcService();
     void AddSession(Session* session);
     void RemoveSession(Session* session);
+    // A session is held, like a task, until it is released, in case it disconnects meanwhile; null for an invalid ID
+    Session* AcquireSession(uint32_t session_id);
+    static void ReleaseSession(Session* session);
 
     grpc::Status CallAction(grpc::ServerContext* context, const CARTA::script::ActionRequest* request, CARTA::script::ActionReply* reply);
 
 private:
     // Map session_id to <Session*, connected>
     std::unordered_map<int, std::pair<Session*, bool>> _sessions;
+    std::mutex _sessions_mutex; // sessions are added and removed by each event loop
 
-    static uint32_t _scripting_request_id;
+    static std::atomic<uint32_t> _scripting_request_id;
 };
 
 #endif // CARTA_BACKEND_GRPCSERVER_CARTAGRPCSERVICE_H_
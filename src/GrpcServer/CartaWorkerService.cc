@@ -0,0 +1,268 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CartaWorkerService.cc: grpc service running the moments, cube histograms and exports sent by the worker pool of other backends
+
+#include "CartaWorkerService.h"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <carta-protobuf/moment_request.pb.h>
+#include <carta-protobuf/save_file.pb.h>
+#include <casacore/images/Regions/ImageRegion.h>
+#include <casacore/lattices/LRegions/LCRegion.h>
+
+#include "../Frame.h"
+#include "../Util.h"
+#include "ArrayChunks.h"
+#include "WorkerPool.h"
+
+using JobWriter = grpc::ServerWriter<CARTA::worker::JobUpdate>;
+
+namespace {
+
+grpc::Status InvalidArgument(const std::string& message) {
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
+}
+
+grpc::Status StreamCancelled() {
+    return grpc::Status(grpc::StatusCode::CANCELLED, "Job cancelled by the client.");
+}
+
+// Progress sent at most every WORKER_PROGRESS_INTERVAL_MS; false when the client has cancelled the job or gone
+class JobProgress {
+public:
+    JobProgress(grpc::ServerContext* context, JobWriter* writer)
+        : _context(context), _writer(writer), _last_update(std::chrono::steady_clock::now()) {}
+
+    bool Update(float progress) {
+        if (_context->IsCancelled()) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now - _last_update < std::chrono::milliseconds(WORKER_PROGRESS_INTERVAL_MS)) {
+            return true;
+        }
+        _last_update = now;
+        CARTA::worker::JobUpdate update;
+        update.set_progress(progress);
+        return _writer->Write(update);
+    }
+
+private:
+    grpc::ServerContext* _context;
+    JobWriter* _writer;
+    std::chrono::steady_clock::time_point _last_update;
+};
+
+grpc::Status WriteResult(JobWriter* writer, bool success, const std::string& message) {
+    CARTA::worker::JobUpdate update;
+    update.mutable_result()->set_success(success);
+    update.mutable_result()->set_message(message);
+    return writer->Write(update) ? grpc::Status::OK : StreamCancelled();
+}
+
+// Metadata of the image, then its pixels with NaN for masked pixels
+bool WriteMomentImage(JobWriter* writer, const carta::CollapseResult& collapse_result) {
+    auto& image = *collapse_result.image;
+    casacore::TableRecord metadata;
+    image.coordinates().save(metadata, "coordinates");
+    metadata.define("units", image.units().getName());
+    casacore::TableRecord image_info;
+    casacore::String info_error;
+    if (image.imageInfo().toRecord(info_error, image_info)) {
+        metadata.defineRecord("imageinfo", image_info);
+    }
+
+    CARTA::worker::JobUpdate header;
+    auto* moment_image = header.mutable_moment_image();
+    moment_image->set_file_id(collapse_result.file_id);
+    moment_image->set_name(collapse_result.name);
+    moment_image->set_metadata(carta::RecordToBytes(metadata));
+    if (!writer->Write(header)) {
+        return false;
+    }
+
+    std::vector<float> values = image.get().tovector();
+    if (image.isMasked()) {
+        std::vector<bool> mask = image.getMask().tovector();
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (!mask[i]) {
+                values[i] = std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+    }
+    std::vector<int64_t> shape(image.shape().begin(), image.shape().end());
+    return carta::WriteArrayChunks(collapse_result.name, shape, values, [&](const CARTA::data::ArrayChunk& chunk) {
+        CARTA::worker::JobUpdate update;
+        *update.mutable_pixels() = chunk;
+        return writer->Write(update);
+    });
+}
+
+// Frame of the file for the job, or null with the status; its jobs run here rather than on other workers
+std::unique_ptr<Frame> OpenJobFrame(const CARTA::worker::ImageFile& file, grpc::Status& status) {
+    auto* loader = carta::FileLoader::GetLoader(file.path());
+    if (!loader) {
+        status = grpc::Status(grpc::StatusCode::NOT_FOUND, fmt::format("Could not open {}.", file.path()));
+        return nullptr;
+    }
+    auto frame = std::make_unique<Frame>(0, loader, file.hdu());
+    if (!frame->IsValid()) {
+        status = grpc::Status(grpc::StatusCode::NOT_FOUND, fmt::format("Could not open {}: {}", file.path(), frame->GetErrorMessage()));
+        return nullptr;
+    }
+    frame->SetRemoteJobs(false);
+    return frame;
+}
+
+} // namespace
+
+CartaWorkerService::CartaWorkerService(const std::string& top_level_folder, bool read_only_mode)
+    : _top_level_folder(top_level_folder), _read_only_mode(read_only_mode) {}
+
+bool CartaWorkerService::InTopLevelFolder(const std::string& path) {
+    return !path.empty() && (path[0] == '/') && IsSubdirectory(path, _top_level_folder);
+}
+
+grpc::Status CartaWorkerService::CalculateMoments(grpc::ServerContext* context, const CARTA::worker::MomentsJob* job, JobWriter* writer) {
+    if (!InTopLevelFolder(job->file().path())) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, fmt::format("{} is not in the top-level folder.", job->file().path()));
+    }
+    casacore::TableRecord region_record;
+    CARTA::MomentRequest moment_request;
+    if (!carta::RecordFromBytes(job->region(), region_record) || !moment_request.ParseFromString(job->moment_request())) {
+        return InvalidArgument("Invalid moments job.");
+    }
+    std::unique_ptr<casacore::ImageRegion> image_region;
+    try {
+        image_region.reset(casacore::ImageRegion::fromRecord(region_record, ""));
+    } catch (const casacore::AipsError& err) {
+        return InvalidArgument(fmt::format("Invalid region of moments job: {}", err.getMesg()));
+    }
+
+    grpc::Status status;
+    auto frame = OpenJobFrame(job->file(), status);
+    if (!frame) {
+        return status;
+    }
+
+    // The client going away stops the calculation at the next progress update
+    JobProgress progress(context, writer);
+    auto progress_callback = [&](float fraction) {
+        if (!progress.Update(fraction)) {
+            frame->StopMomentCalc();
+        }
+    };
+    CARTA::MomentResponse moment_response;
+    std::vector<carta::CollapseResult> collapse_results;
+    frame->CalculateMoments(job->file_id(), progress_callback, *image_region, moment_request, moment_response, collapse_results);
+    if (context->IsCancelled()) {
+        return StreamCancelled();
+    }
+
+    for (auto& collapse_result : collapse_results) {
+        if (!WriteMomentImage(writer, collapse_result)) {
+            return StreamCancelled();
+        }
+    }
+    return WriteResult(writer, moment_response.success(), moment_response.message());
+}
+
+grpc::Status CartaWorkerService::CalculateCubeHistogram(
+    grpc::ServerContext* context, const CARTA::worker::CubeHistogramJob* job, JobWriter* writer) {
+    if (!InTopLevelFolder(job->file().path())) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, fmt::format("{} is not in the top-level folder.", job->file().path()));
+    }
+    grpc::Status status;
+    auto frame = OpenJobFrame(job->file(), status);
+    if (!frame) {
+        return status;
+    }
+    int stokes(job->stokes());
+    if ((stokes < 0) || ((size_t)stokes >= frame->NumStokes())) {
+        return InvalidArgument(fmt::format("Invalid stokes {}.", stokes));
+    }
+
+    // Progress through the channels twice, for the stats then the histogram
+    JobProgress progress(context, writer);
+    float total_z = frame->Depth() * 2;
+    carta::BasicStats<float> cube_stats;
+    carta::Histogram cube_histogram;
+    auto stats_progress = [&](size_t num_z_done) { return progress.Update(num_z_done / total_z); };
+    auto histogram_progress = [&](size_t num_z_done, const carta::Histogram&) { return progress.Update(0.5 + num_z_done / total_z); };
+    bool have_histogram = frame->CalculateCubeStats(stokes, cube_stats, stats_progress) &&
+                          frame->CalculateCubeHistogram(stokes, job->num_bins(), cube_stats, cube_histogram, histogram_progress);
+    if (context->IsCancelled()) {
+        return StreamCancelled();
+    }
+    if (!have_histogram) {
+        return WriteResult(writer, false, "Cube histogram could not be calculated.");
+    }
+
+    CARTA::worker::JobUpdate update;
+    auto* message = update.mutable_cube_histogram();
+    message->set_num_pixels(cube_stats.num_pixels);
+    message->set_sum(cube_stats.sum);
+    message->set_mean(cube_stats.mean);
+    message->set_std_dev(cube_stats.stdDev);
+    message->set_min_val(cube_stats.min_val);
+    message->set_max_val(cube_stats.max_val);
+    message->set_rms(cube_stats.rms);
+    message->set_sum_sq(cube_stats.sumSq);
+    message->set_histogram_min(cube_histogram.GetMinVal());
+    message->set_histogram_max(cube_histogram.GetMaxVal());
+    auto& bins = cube_histogram.GetHistogramBins();
+    *message->mutable_bins() = {bins.begin(), bins.end()};
+    if (!writer->Write(update)) {
+        return StreamCancelled();
+    }
+    return WriteResult(writer, true, "");
+}
+
+grpc::Status CartaWorkerService::SaveFile(grpc::ServerContext* context, const CARTA::worker::SaveFileJob* job, JobWriter* writer) {
+    if (_read_only_mode) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Saving files is not allowed in read-only mode.");
+    }
+    CARTA::SaveFile save_file_msg;
+    if (!save_file_msg.ParseFromString(job->save_file())) {
+        return InvalidArgument("Invalid export job.");
+    }
+    if (!InTopLevelFolder(job->file().path()) || !InTopLevelFolder(save_file_msg.output_file_directory())) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "The file or output folder is not in the top-level folder.");
+    }
+    std::unique_ptr<casacore::LCRegion> image_region;
+    if (!job->region().empty()) {
+        casacore::TableRecord region_record;
+        if (!carta::RecordFromBytes(job->region(), region_record)) {
+            return InvalidArgument("Invalid region of export job.");
+        }
+        try {
+            image_region.reset(casacore::LCRegion::fromRecord(region_record, ""));
+        } catch (const casacore::AipsError& err) {
+            return InvalidArgument(fmt::format("Invalid region of export job: {}", err.getMesg()));
+        }
+    }
+
+    grpc::Status status;
+    auto frame = OpenJobFrame(job->file(), status);
+    if (!frame) {
+        return status;
+    }
+
+    JobProgress progress(context, writer);
+    CARTA::SaveFileAck save_file_ack;
+    frame->SaveFile("", save_file_msg, save_file_ack, image_region.get(), [&](float fraction) { return progress.Update(fraction); });
+    if (context->IsCancelled()) {
+        return StreamCancelled();
+    }
+    return WriteResult(writer, save_file_ack.success(), save_file_ack.message());
+}
@@ -0,0 +1,38 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# CartaWorkerService.h: grpc service running the moments, cube histograms and exports sent by the worker pool of other backends
+
+#ifndef CARTA_BACKEND_GRPCSERVER_CARTAWORKERSERVICE_H_
+#define CARTA_BACKEND_GRPCSERVER_CARTAWORKERSERVICE_H_
+
+#include <string>
+
+#include <grpc++/grpc++.h>
+
+#include <carta-data/carta_worker.grpc.pb.h>
+
+// Each job opens its file with a new frame on the grpc thread of the call, and runs the calculation of the frame locally. Files and
+// export folders must be in the top-level folder of this backend; exports are refused in read-only mode.
+class CartaWorkerService : public CARTA::worker::CartaWorker::Service {
+public:
+    CartaWorkerService(const std::string& top_level_folder, bool read_only_mode);
+
+    grpc::Status CalculateMoments(grpc::ServerContext* context, const CARTA::worker::MomentsJob* job,
+        grpc::ServerWriter<CARTA::worker::JobUpdate>* writer);
+    grpc::Status CalculateCubeHistogram(grpc::ServerContext* context, const CARTA::worker::CubeHistogramJob* job,
+        grpc::ServerWriter<CARTA::worker::JobUpdate>* writer);
+    grpc::Status SaveFile(grpc::ServerContext* context, const CARTA::worker::SaveFileJob* job,
+        grpc::ServerWriter<CARTA::worker::JobUpdate>* writer);
+
+private:
+    bool InTopLevelFolder(const std::string& path);
+
+    std::string _top_level_folder;
+    bool _read_only_mode;
+};
+
+#endif // CARTA_BACKEND_GRPCSERVER_CARTAWORKERSERVICE_H_
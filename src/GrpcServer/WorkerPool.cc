@@ -0,0 +1,349 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# WorkerPool.cc: heavy cube jobs sent to the gRPC services of headless worker backends, with their progress and results
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <casacore/casa/IO/AipsIO.h>
+#include <casacore/casa/IO/MemoryIO.h>
+#include <casacore/coordinates/Coordinates/CoordinateSystem.h>
+#include <casacore/images/Images/ImageInfo.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/lattices/Lattices/ArrayLattice.h>
+
+#include "../Logger/Logger.h"
+#include "ArrayChunks.h"
+
+namespace carta {
+
+std::string RecordToBytes(const casacore::TableRecord& record) {
+    casacore::MemoryIO memory_io;
+    {
+        casacore::AipsIO aipsio(&memory_io);
+        aipsio << record;
+    }
+    return std::string((const char*)memory_io.getBuffer(), memory_io.length());
+}
+
+bool RecordFromBytes(const std::string& bytes, casacore::TableRecord& record) {
+    try {
+        casacore::MemoryIO memory_io(bytes.data(), bytes.size());
+        casacore::AipsIO aipsio(&memory_io);
+        aipsio >> record;
+        return true;
+    } catch (const casacore::AipsError& err) {
+        spdlog::debug("Could not read a record from a worker: {}", err.getMesg());
+        return false;
+    }
+}
+
+namespace {
+
+// Moment image sent by a worker: its metadata, then its pixels with NaN for masked pixels
+struct RemoteImage {
+    int file_id;
+    std::string name;
+    std::string metadata;
+    std::vector<int64_t> shape;
+    std::vector<float> values;
+};
+
+std::shared_ptr<casacore::ImageInterface<float>> MakeImage(const RemoteImage& remote_image, std::string& error) {
+    casacore::TableRecord metadata;
+    if (!RecordFromBytes(remote_image.metadata, metadata) || !metadata.isDefined("coordinates")) {
+        error = fmt::format("Invalid metadata of moment image {}.", remote_image.name);
+        return nullptr;
+    }
+    std::unique_ptr<casacore::CoordinateSystem> coordinates(casacore::CoordinateSystem::restore(metadata, "coordinates"));
+    casacore::IPosition shape(remote_image.shape.size());
+    for (size_t i = 0; i < remote_image.shape.size(); ++i) {
+        shape[i] = remote_image.shape[i];
+    }
+    if (!coordinates || shape.empty() || (shape.product() != remote_image.values.size())) {
+        error = fmt::format("Invalid coordinates or pixels of moment image {}.", remote_image.name);
+        return nullptr;
+    }
+
+    auto image = std::make_shared<casacore::TempImage<float>>(casacore::TiledShape(shape), *coordinates);
+    image->put(casacore::Array<float>(shape, const_cast<float*>(remote_image.values.data()), casacore::SHARE));
+    auto& values = remote_image.values;
+    if (std::any_of(values.begin(), values.end(), [](float value) { return !std::isfinite(value); })) {
+        casacore::Array<casacore::Bool> mask(shape);
+        std::transform(values.begin(), values.end(), mask.begin(), [](float value) { return std::isfinite(value); });
+        image->attachMask(casacore::ArrayLattice<casacore::Bool>(mask));
+    }
+    if (metadata.isDefined("units")) {
+        image->setUnits(casacore::Unit(metadata.asString("units")));
+    }
+    if (metadata.isDefined("imageinfo")) {
+        casacore::ImageInfo image_info;
+        casacore::String info_error;
+        if (image_info.fromRecord(info_error, metadata.subRecord("imageinfo"))) {
+            image->setImageInfo(image_info);
+        }
+    }
+    return image;
+}
+
+} // namespace
+
+WorkerPool& WorkerPool::Global() {
+    static WorkerPool pool;
+    return pool;
+}
+
+bool WorkerPool::SetWorkers(const std::string& addresses, std::string& error) {
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::istringstream entries(addresses);
+    std::string address;
+    while (std::getline(entries, address, ',')) {
+        address.erase(0, address.find_first_not_of(' '));
+        address.erase(address.find_last_not_of(' ') + 1);
+        if (address.empty()) {
+            continue;
+        }
+
+        auto separator = address.rfind(':');
+        if ((separator == std::string::npos) || (separator == 0) || (separator + 1 == address.size()) ||
+            (address.find_first_not_of("0123456789", separator + 1) != std::string::npos)) {
+            error = fmt::format("Invalid worker address {}; expected host:port", address);
+            return false;
+        }
+        auto worker = std::make_unique<Worker>();
+        worker->address = address;
+        worker->stub = CARTA::worker::CartaWorker::NewStub(grpc::CreateChannel(address, grpc::InsecureChannelCredentials()));
+        worker->num_jobs = 0;
+        workers.push_back(std::move(worker));
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _workers = std::move(workers);
+    return true;
+}
+
+bool WorkerPool::HasWorkers() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return !_workers.empty();
+}
+
+RemoteJob WorkerPool::CalculateMoments(const std::string& path, const std::string& hdu, int file_id,
+    const casacore::ImageRegion& image_region, const CARTA::MomentRequest& moment_request, const ProgressCallback& progress_callback,
+    CARTA::MomentResponse& moment_response, std::vector<CollapseResult>& collapse_results) {
+    if (!HasWorkers()) {
+        return RemoteJob::Unavailable;
+    }
+
+    CARTA::worker::MomentsJob job;
+    job.mutable_file()->set_path(path);
+    job.mutable_file()->set_hdu(hdu);
+    job.set_file_id(file_id);
+    job.set_region(RecordToBytes(image_region.toRecord("")));
+    moment_request.SerializeToString(job.mutable_moment_request());
+
+    std::vector<RemoteImage> images;
+    bool cancelled(false);
+    std::string error;
+    auto update_callback = [&](const CARTA::worker::JobUpdate& update) {
+        switch (update.update_case()) {
+            case CARTA::worker::JobUpdate::kProgress:
+                cancelled = !progress_callback(update.progress());
+                return !cancelled;
+            case CARTA::worker::JobUpdate::kMomentImage:
+                images.push_back({update.moment_image().file_id(), update.moment_image().name(), update.moment_image().metadata()});
+                return true;
+            case CARTA::worker::JobUpdate::kPixels:
+                if (images.empty() || !ReadArrayChunk(update.pixels(), images.back().shape, images.back().values)) {
+                    error = "Invalid moment image pixels from the worker.";
+                    return false;
+                }
+                return true;
+            default:
+                return true;
+        }
+    };
+
+    CARTA::worker::JobResult result;
+    auto remote_job = Run(
+        "Moments",
+        [&](CARTA::worker::CartaWorker::Stub& stub, grpc::ClientContext* context) { return stub.CalculateMoments(context, job); },
+        update_callback, result);
+    if (remote_job == RemoteJob::Unavailable) {
+        return remote_job;
+    }
+
+    if (remote_job == RemoteJob::Done) {
+        for (auto& remote_image : images) {
+            auto image = MakeImage(remote_image, error);
+            if (!image) {
+                collapse_results.clear();
+                remote_job = RemoteJob::Failed;
+                break;
+            }
+            collapse_results.push_back(CollapseResult(remote_image.file_id, remote_image.name, image));
+        }
+    }
+    moment_response.set_success(remote_job == RemoteJob::Done);
+    moment_response.set_cancel(cancelled);
+    moment_response.set_message(error.empty() ? result.message() : error);
+    return remote_job;
+}
+
+RemoteJob WorkerPool::CalculateCubeHistogram(const std::string& path, const std::string& hdu, int stokes, int num_bins,
+    const ProgressCallback& progress_callback, BasicStats<float>& cube_stats, Histogram& cube_histogram) {
+    if (!HasWorkers()) {
+        return RemoteJob::Unavailable;
+    }
+
+    CARTA::worker::CubeHistogramJob job;
+    job.mutable_file()->set_path(path);
+    job.mutable_file()->set_hdu(hdu);
+    job.set_stokes(stokes);
+    job.set_num_bins(num_bins);
+
+    bool have_histogram(false);
+    auto update_callback = [&](const CARTA::worker::JobUpdate& update) {
+        if (update.has_cube_histogram()) {
+            auto& message = update.cube_histogram();
+            cube_stats = BasicStats<float>(message.num_pixels(), message.sum(), message.mean(), message.std_dev(), message.min_val(),
+                message.max_val(), message.rms(), message.sum_sq());
+            std::vector<int> bins(message.bins().begin(), message.bins().end());
+            cube_histogram = Histogram(std::max((int)bins.size(), 1), message.histogram_min(), message.histogram_max(), {});
+            cube_histogram.SetHistogramBins(bins);
+            have_histogram = true;
+            return true;
+        }
+        return !update.has_progress() || progress_callback(update.progress());
+    };
+
+    CARTA::worker::JobResult result;
+    auto remote_job = Run(
+        "Cube histogram",
+        [&](CARTA::worker::CartaWorker::Stub& stub, grpc::ClientContext* context) { return stub.CalculateCubeHistogram(context, job); },
+        update_callback, result);
+    if ((remote_job == RemoteJob::Done) && !have_histogram) {
+        remote_job = RemoteJob::Failed;
+    }
+    if (remote_job == RemoteJob::Failed && !result.message().empty()) {
+        spdlog::warn(result.message());
+    }
+    return remote_job;
+}
+
+RemoteJob WorkerPool::SaveFile(const std::string& path, const std::string& hdu, const CARTA::SaveFile& save_file_msg,
+    const casacore::LCRegion* image_region, const ProgressCallback& progress_callback, CARTA::SaveFileAck& save_file_ack) {
+    if (!HasWorkers()) {
+        return RemoteJob::Unavailable;
+    }
+
+    CARTA::worker::SaveFileJob job;
+    job.mutable_file()->set_path(path);
+    job.mutable_file()->set_hdu(hdu);
+    save_file_msg.SerializeToString(job.mutable_save_file());
+    if (image_region) {
+        job.set_region(RecordToBytes(image_region->toRecord("")));
+    }
+
+    auto update_callback = [&](const CARTA::worker::JobUpdate& update) {
+        return !update.has_progress() || progress_callback(update.progress());
+    };
+
+    CARTA::worker::JobResult result;
+    auto remote_job = Run(
+        "Export",
+        [&](CARTA::worker::CartaWorker::Stub& stub, grpc::ClientContext* context) { return stub.SaveFile(context, job); },
+        update_callback, result);
+    if (remote_job != RemoteJob::Unavailable) {
+        save_file_ack.set_file_id(save_file_msg.file_id());
+        save_file_ack.set_success(remote_job == RemoteJob::Done);
+        save_file_ack.set_message(result.message());
+    }
+    return remote_job;
+}
+
+RemoteJob WorkerPool::Run(
+    const std::string& job_name, const StartJob& start_job, const UpdateCallback& update_callback, CARTA::worker::JobResult& result) {
+    std::vector<Worker*> tried;
+    while (auto* worker = AcquireWorker(tried)) {
+        tried.push_back(worker);
+
+        grpc::ClientContext context;
+        auto reader = start_job(*worker->stub, &context);
+        CARTA::worker::JobUpdate update;
+        bool started(false), cancelled(false), have_result(false);
+        while (reader->Read(&update)) {
+            started = true;
+            if (update.has_result()) {
+                result = update.result();
+                have_result = true;
+            } else if (!update_callback(update)) {
+                context.TryCancel();
+                cancelled = true;
+                break;
+            }
+        }
+        grpc::Status status = reader->Finish();
+        auto code = status.error_code();
+        ReleaseWorker(worker, started || (code != grpc::StatusCode::UNAVAILABLE));
+
+        if (cancelled) {
+            result.set_success(false);
+            result.set_message(fmt::format("{} cancelled.", job_name));
+            return RemoteJob::Failed;
+        }
+        if (status.ok() && have_result) {
+            return result.success() ? RemoteJob::Done : RemoteJob::Failed;
+        }
+        // The next worker may see the file, or be reachable
+        if (!started && ((code == grpc::StatusCode::UNAVAILABLE) || (code == grpc::StatusCode::UNIMPLEMENTED) ||
+                            (code == grpc::StatusCode::NOT_FOUND) || (code == grpc::StatusCode::PERMISSION_DENIED) ||
+                            (code == grpc::StatusCode::RESOURCE_EXHAUSTED))) {
+            spdlog::debug("Worker {} did not run a {} job: {}", worker->address, job_name, status.error_message());
+            continue;
+        }
+        result.set_success(false);
+        result.set_message(
+            fmt::format("{} failed on worker {}: {}", job_name, worker->address, status.ok() ? "no result" : status.error_message()));
+        return RemoteJob::Failed;
+    }
+    return RemoteJob::Unavailable;
+}
+
+WorkerPool::Worker* WorkerPool::AcquireWorker(const std::vector<Worker*>& tried) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto now = std::chrono::steady_clock::now();
+    Worker* selected(nullptr);
+    for (auto& worker : _workers) {
+        if ((worker->retry_time > now) || (std::find(tried.begin(), tried.end(), worker.get()) != tried.end())) {
+            continue;
+        }
+        if (!selected || (worker->num_jobs < selected->num_jobs)) {
+            selected = worker.get();
+        }
+    }
+    if (selected) {
+        ++selected->num_jobs;
+    }
+    return selected;
+}
+
+void WorkerPool::ReleaseWorker(Worker* worker, bool reachable) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    --worker->num_jobs;
+    if (!reachable) {
+        worker->retry_time = std::chrono::steady_clock::now() + std::chrono::seconds(WORKER_RETRY_SECONDS);
+        spdlog::warn("Worker {} is unreachable; its jobs go to other workers or run locally for {} s.", worker->address,
+            WORKER_RETRY_SECONDS);
+    }
+}
+
+} // namespace carta
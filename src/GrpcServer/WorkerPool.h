@@ -0,0 +1,94 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# WorkerPool.h: heavy cube jobs sent to the gRPC services of headless worker backends, with their progress and results
+
+#ifndef CARTA_BACKEND_GRPCSERVER_WORKERPOOL_H_
+#define CARTA_BACKEND_GRPCSERVER_WORKERPOOL_H_
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <grpc++/grpc++.h>
+
+#include <carta-data/carta_worker.grpc.pb.h>
+#include <carta-protobuf/moment_request.pb.h>
+#include <carta-protobuf/save_file.pb.h>
+#include <casacore/images/Regions/ImageRegion.h>
+#include <casacore/lattices/LRegions/LCRegion.h>
+#include <casacore/tables/Tables/TableRecord.h>
+
+#include "../ImageStats/BasicStatsCalculator.h"
+#include "../ImageStats/Histogram.h"
+#include "../Moment/MomentGenerator.h"
+
+#define WORKER_RETRY_SECONDS 30        // an unreachable worker is not sent jobs for this long
+#define WORKER_PROGRESS_INTERVAL_MS 200 // workers send progress at most this often, and notice cancellation as often
+
+namespace carta {
+
+enum class RemoteJob {
+    Unavailable, // no worker could run the job, so it is run locally
+    Done,        // the results are set
+    Failed       // failed or cancelled on the worker, with the error in the response
+};
+
+// casacore records in AipsIO format, for the regions and image metadata of jobs
+std::string RecordToBytes(const casacore::TableRecord& record);
+bool RecordFromBytes(const std::string& bytes, casacore::TableRecord& record);
+
+// A job goes to the worker with the fewest jobs of this backend. The worker opens the file by its full path, so the workers must
+// see the files at the same paths, e.g. on a shared filesystem. A job which a worker refuses before it starts, because the worker
+// is unreachable or cannot open the file, is tried on the next worker, and then runs locally.
+class WorkerPool {
+public:
+    // Fraction of the job done; returns false to cancel the job
+    using ProgressCallback = std::function<bool(float progress)>;
+
+    static WorkerPool& Global();
+
+    // Comma-separated host:port addresses of the gRPC services of the workers; false with an error if an address is invalid
+    bool SetWorkers(const std::string& addresses, std::string& error);
+    bool HasWorkers();
+
+    RemoteJob CalculateMoments(const std::string& path, const std::string& hdu, int file_id, const casacore::ImageRegion& image_region,
+        const CARTA::MomentRequest& moment_request, const ProgressCallback& progress_callback, CARTA::MomentResponse& moment_response,
+        std::vector<CollapseResult>& collapse_results);
+    RemoteJob CalculateCubeHistogram(const std::string& path, const std::string& hdu, int stokes, int num_bins,
+        const ProgressCallback& progress_callback, BasicStats<float>& cube_stats, Histogram& cube_histogram);
+    // The output folder of the message is a full path; the image region is null for the whole image
+    RemoteJob SaveFile(const std::string& path, const std::string& hdu, const CARTA::SaveFile& save_file_msg,
+        const casacore::LCRegion* image_region, const ProgressCallback& progress_callback, CARTA::SaveFileAck& save_file_ack);
+
+private:
+    struct Worker {
+        std::string address;
+        std::unique_ptr<CARTA::worker::CartaWorker::Stub> stub;
+        int num_jobs;
+        std::chrono::steady_clock::time_point retry_time; // unreachable until then
+    };
+    using JobReader = std::unique_ptr<grpc::ClientReader<CARTA::worker::JobUpdate>>;
+    using StartJob = std::function<JobReader(CARTA::worker::CartaWorker::Stub& stub, grpc::ClientContext* context)>;
+    // Called with each update before the job result; returns false to cancel the job
+    using UpdateCallback = std::function<bool(const CARTA::worker::JobUpdate& update)>;
+
+    WorkerPool() = default;
+    RemoteJob Run(const std::string& job_name, const StartJob& start_job, const UpdateCallback& update_callback,
+        CARTA::worker::JobResult& result);
+    Worker* AcquireWorker(const std::vector<Worker*>& tried);
+    void ReleaseWorker(Worker* worker, bool reachable);
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Worker>> _workers;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_GRPCSERVER_WORKERPOOL_H_
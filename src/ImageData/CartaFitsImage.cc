@@ -8,6 +8,13 @@
 
 #include "CartaFitsImage.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <casacore/casa/BasicSL/Constants.h>
 #include <casacore/casa/OS/File.h>
 #include <casacore/casa/Quanta/UnitMap.h>
@@ -25,6 +32,14 @@
 #include <wcslib/wcshdr.h>
 #include <wcslib/wcsmath.h>
 
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "../Threading.h"
+
 using namespace carta;
 
 CartaFitsImage::CartaFitsImage(const std::string& filename, unsigned int hdu)
@@ -35,6 +50,9 @@ CartaFitsImage::CartaFitsImage(const std::string& filename, unsigned int hdu)
       _is_compressed(false),
       _datatype(casacore::TpOther),
       _has_blanks(false),
+      _data_offset(-1),
+      _mapped_data(nullptr),
+      _mapped_size(0),
       _pixel_mask(nullptr) {
     casacore::File ccfile(filename);
     if (!ccfile.exists() || !ccfile.isReadable()) {
@@ -42,6 +60,7 @@ CartaFitsImage::CartaFitsImage(const std::string& filename, unsigned int hdu)
     }
 
     SetUpImage();
+    MapData();
 }
 
 CartaFitsImage::CartaFitsImage(const CartaFitsImage& other)
@@ -51,16 +70,23 @@ CartaFitsImage::CartaFitsImage(const CartaFitsImage& other)
       _fptr(other._fptr),
       _shape(other._shape),
       _is_compressed(other._is_compressed),
+      _compressed_tile_shape(other._compressed_tile_shape),
       _datatype(other._datatype),
       _has_blanks(other._has_blanks),
+      _data_offset(other._data_offset),
+      _mapped_data(nullptr),
+      _mapped_size(0),
       _pixel_mask(nullptr),
       _tiled_shape(other._tiled_shape) {
     if (other._pixel_mask != nullptr) {
         _pixel_mask = other._pixel_mask->clone();
     }
+    MapData();
 }
 
 CartaFitsImage::~CartaFitsImage() {
+    UnmapData();
+    CloseReadHandles();
     CloseFile();
     delete _pixel_mask;
 }
@@ -112,39 +138,24 @@ casacore::DataType CartaFitsImage::internalDataType() const {
 }
 
 casacore::Bool CartaFitsImage::doGetSlice(casacore::Array<float>& buffer, const casacore::Slicer& section) {
-    // Read section of data using cfitsio implicit data type conversion.
-    // cfitsio scales the data by BSCALE and BZERO
-    fitsfile* fptr = OpenFile();
+    // Read uncompressed, unscaled float data directly from the file mapping
+    if (_mapped_data && GetMappedDataSubset(section, buffer)) {
+        return true;
+    }
 
-    // Read data subset from image
+    // Decompress bands of tiles in parallel, each through its own handle
     bool ok(false);
-    switch (_datatype) {
-        case 8: {
-            ok = GetDataSubset<unsigned char>(fptr, _datatype, section, buffer);
-            break;
-        }
-        case 16: {
-            ok = GetDataSubset<short>(fptr, _datatype, section, buffer);
-            break;
-        }
-        case 32: {
-            ok = GetDataSubset<int>(fptr, _datatype, section, buffer);
-            break;
-        }
-        case 64: {
-            ok = GetDataSubset<LONGLONG>(fptr, _datatype, section, buffer);
-            break;
-        }
-        case -32: {
-            ok = GetDataSubset<float>(fptr, _datatype, section, buffer);
-            break;
-        }
-        case -64: {
-            ok = GetDataSubset<double>(fptr, _datatype, section, buffer);
-            break;
+    if (_is_compressed && GetCompressedDataSubset(section, buffer, ok)) {
+        if (!ok) {
+            spdlog::error("FITS read compressed data failed.");
         }
+        return ok;
     }
 
+    fitsfile* fptr = AcquireReadHandle();
+    ok = ReadDataSubset(fptr, section, buffer);
+    ReleaseReadHandle(fptr);
+
     if (!ok) {
         spdlog::error("FITS read data failed.");
         return false;
@@ -198,9 +209,11 @@ casacore::Lattice<bool>& CartaFitsImage::pixelMask() {
         throw(casacore::AipsError("CartaFitsImage::pixelMask - no pixel mask used"));
     }
 
+    std::unique_lock<std::mutex> ulock(_pixel_mask_mutex);
     if (!_pixel_mask) {
         SetPixelMask();
     }
+    ulock.unlock();
 
     return *_pixel_mask;
 }
@@ -213,9 +226,11 @@ casacore::Bool CartaFitsImage::doGetMaskSlice(casacore::Array<bool>& buffer, con
         return false;
     }
 
+    std::unique_lock<std::mutex> ulock(_pixel_mask_mutex);
     if (!_pixel_mask) {
         SetPixelMask();
     }
+    ulock.unlock();
 
     if (_pixel_mask) {
         return _pixel_mask->getSlice(buffer, section);
@@ -226,6 +241,229 @@ casacore::Bool CartaFitsImage::doGetMaskSlice(casacore::Array<bool>& buffer, con
 
 // private
 
+bool CartaFitsImage::ReadDataSubset(fitsfile* fptr, const casacore::Slicer& section, casacore::Array<float>& buffer) {
+    // Read section of data using cfitsio implicit data type conversion.
+    // cfitsio scales the data by BSCALE and BZERO, and decompresses tile-compressed data
+    switch (_datatype) {
+        case 8:
+            return GetDataSubset<unsigned char>(fptr, _datatype, section, buffer);
+        case 16:
+            return GetDataSubset<short>(fptr, _datatype, section, buffer);
+        case 32:
+            return GetDataSubset<int>(fptr, _datatype, section, buffer);
+        case 64:
+            return GetDataSubset<LONGLONG>(fptr, _datatype, section, buffer);
+        case -32:
+            return GetDataSubset<float>(fptr, _datatype, section, buffer);
+        case -64:
+            return GetDataSubset<double>(fptr, _datatype, section, buffer);
+    }
+    return false;
+}
+
+bool CartaFitsImage::GetCompressedDataSubset(const casacore::Slicer& section, casacore::Array<float>& buffer, bool& ok) {
+    // Split the section into bands of whole compressed tiles along its slowest axis spanning several tiles, and read the
+    // bands concurrently. Returns false if the section is not split, so the caller reads it with a single handle.
+    if (_compressed_tile_shape.empty() || (section.stride().product() != 1)) {
+        return false;
+    }
+
+    casacore::IPosition start = section.start();
+    casacore::IPosition length = section.length();
+    int split_axis(-1);
+    int64_t first_tile(0), num_tiles(0), tile_length(0);
+    for (int i = length.size() - 1; i >= 0; --i) {
+        tile_length = _compressed_tile_shape(i);
+        first_tile = start(i) / tile_length;
+        num_tiles = (start(i) + length(i) - 1) / tile_length - first_tile + 1;
+        if (num_tiles > 1) {
+            split_axis = i;
+            break;
+        }
+    }
+
+    ThreadManager::ApplyThreadLimit();
+    int64_t num_bands = std::min(num_tiles, (int64_t)omp_get_max_threads());
+    if ((split_axis < 0) || (num_bands < 2)) {
+        return false;
+    }
+
+    buffer.resize(length);
+    int64_t tiles_per_band = (num_tiles + num_bands - 1) / num_bands;
+    std::vector<char> band_ok(num_bands, false);
+
+#pragma omp parallel for
+    for (int64_t band = 0; band < num_bands; ++band) {
+        // Band pixel range on the split axis, clipped to the section
+        int64_t band_start = std::max((first_tile + band * tiles_per_band) * tile_length, (int64_t)start(split_axis));
+        int64_t band_end =
+            std::min((first_tile + (band + 1) * tiles_per_band) * tile_length, (int64_t)(start(split_axis) + length(split_axis)));
+        if (band_start >= band_end) {
+            band_ok[band] = true;
+            continue;
+        }
+
+        casacore::IPosition band_file_start(start), band_length(length), band_buffer_start(length.size(), 0);
+        band_file_start(split_axis) = band_start;
+        band_length(split_axis) = band_end - band_start;
+        band_buffer_start(split_axis) = band_start - start(split_axis);
+
+        try {
+            casacore::Array<float> band_buffer(band_length);
+            fitsfile* fptr = AcquireReadHandle();
+            band_ok[band] = ReadDataSubset(fptr, casacore::Slicer(band_file_start, band_length), band_buffer);
+            ReleaseReadHandle(fptr);
+            if (band_ok[band]) {
+                buffer(casacore::Slicer(band_buffer_start, band_length)) = band_buffer;
+            }
+        } catch (const casacore::AipsError& err) {
+            spdlog::debug("FITS compressed data read error: {}", err.getMesg());
+        }
+    }
+
+    ok = std::all_of(band_ok.begin(), band_ok.end(), [](char band_read) { return band_read; });
+    return true;
+}
+
+fitsfile* CartaFitsImage::AcquireReadHandle() {
+    // Reuse an idle handle, or open a new one positioned at the image hdu
+    std::unique_lock<std::mutex> ulock(_read_handle_mutex);
+    if (!_read_handles.empty()) {
+        fitsfile* fptr = _read_handles.back();
+        _read_handles.pop_back();
+        return fptr;
+    }
+    ulock.unlock();
+
+    fitsfile* fptr;
+    int status(0);
+    fits_open_file(&fptr, _filename.c_str(), READONLY, &status);
+    if (status) {
+        throw(casacore::AipsError("Error opening FITS file."));
+    }
+
+    int hdu(_hdu + 1);
+    int* hdutype(nullptr);
+    fits_movabs_hdu(fptr, hdu, hdutype, &status);
+    if (status) {
+        int close_status(0);
+        fits_close_file(fptr, &close_status);
+        throw(casacore::AipsError("Error advancing FITS file to requested HDU."));
+    }
+
+    return fptr;
+}
+
+void CartaFitsImage::ReleaseReadHandle(fitsfile* fptr) {
+    std::unique_lock<std::mutex> ulock(_read_handle_mutex);
+    if (_read_handles.size() < MAX_IDLE_FITS_READ_HANDLES) {
+        _read_handles.push_back(fptr);
+        return;
+    }
+    ulock.unlock();
+
+    int status(0);
+    fits_close_file(fptr, &status);
+}
+
+void CartaFitsImage::CloseReadHandles() {
+    std::unique_lock<std::mutex> ulock(_read_handle_mutex);
+    for (auto fptr : _read_handles) {
+        int status(0);
+        fits_close_file(fptr, &status);
+    }
+    _read_handles.clear();
+}
+
+void CartaFitsImage::MapData() {
+    // Map the whole file read-only; on failure, data is read with cfitsio
+    if (_data_offset < 0) {
+        return;
+    }
+
+    int fd = open(_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    size_t data_size = sizeof(float) * _shape.product();
+    if ((file_size > 0) && (_data_offset + data_size <= (size_t)file_size)) {
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            _mapped_data = static_cast<char*>(mapping);
+            _mapped_size = file_size;
+        } else {
+            spdlog::debug("Could not map FITS file {}, using cfitsio.", _filename);
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+void CartaFitsImage::UnmapData() {
+    if (_mapped_data) {
+        munmap(_mapped_data, _mapped_size);
+        _mapped_data = nullptr;
+        _mapped_size = 0;
+    }
+}
+
+static void CopyBigEndianFloats(const char* src, float* dest, size_t count) {
+    // Convert FITS big-endian floats to native byte order
+    size_t i(0);
+    const __m128i shuffle_mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    for (; i + 4 <= count; i += 4) {
+        __m128i vals = _mm_loadu_si128((const __m128i*)(src + sizeof(float) * i));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_shuffle_epi8(vals, shuffle_mask));
+    }
+    for (; i < count; ++i) {
+        uint32_t val;
+        memcpy(&val, src + sizeof(float) * i, sizeof(uint32_t));
+        val = __builtin_bswap32(val);
+        memcpy(dest + i, &val, sizeof(float));
+    }
+}
+
+bool CartaFitsImage::GetMappedDataSubset(const casacore::Slicer& section, casacore::Array<float>& buffer) {
+    // Copy rows of the section from the mapping; strided reads use cfitsio
+    casacore::IPosition start = section.start();
+    casacore::IPosition length = section.length();
+    if (!allEQ(section.stride(), 1) || (length.product() == 0)) {
+        return false;
+    }
+
+    size_t ndim = _shape.size();
+    std::vector<int64_t> file_stride(ndim, 1);
+    for (size_t i = 1; i < ndim; ++i) {
+        file_stride[i] = file_stride[i - 1] * _shape(i - 1);
+    }
+
+    buffer.resize(length);
+    bool delete_storage;
+    float* dest = buffer.getStorage(delete_storage);
+    const char* data = _mapped_data + _data_offset;
+    int64_t row_length = length(0);
+    int64_t num_rows = length.product() / row_length;
+
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t row = 0; row < num_rows; ++row) {
+        // Position of the row in the file
+        int64_t index = start(0);
+        int64_t remainder = row;
+        for (size_t i = 1; i < ndim; ++i) {
+            index += (start(i) + remainder % length(i)) * file_stride[i];
+            remainder /= length(i);
+        }
+        CopyBigEndianFloats(data + sizeof(float) * index, dest + row * row_length, row_length);
+    }
+
+    buffer.putStorage(dest, delete_storage);
+    return true;
+}
+
 fitsfile* CartaFitsImage::OpenFile() {
     // Open file and return file pointer
     if (!_fptr) {
@@ -397,6 +635,35 @@ void CartaFitsImage::GetFitsHeaders(int& nkeys, std::string& hdrstr) {
     _is_compressed = fits_is_compressed_image(fptr, &status);
     CloseFileIfError(status, "Error detecting image compression.");
 
+    // Compressed tile shape; tiles are single rows unless ZTILEn is set
+    _compressed_tile_shape.resize(0);
+    if (_is_compressed) {
+        _compressed_tile_shape.resize(_shape.size());
+        for (size_t i = 0; i < _shape.size(); ++i) {
+            long tile_length = (i == 0 ? _shape(0) : 1);
+            status = 0;
+            fits_read_key(fptr, TLONG, fmt::format("ZTILE{}", i + 1).c_str(), &tile_length, nullptr, &status);
+            _compressed_tile_shape(i) = std::max(tile_length, 1L);
+        }
+    }
+
+    // Plain float data can be read from a file mapping if it is not scaled
+    _data_offset = -1;
+    if ((bitpix == -32) && !_is_compressed) {
+        double bscale(1.0), bzero(0.0);
+        status = 0;
+        fits_read_key(fptr, TDOUBLE, "BSCALE", &bscale, nullptr, &status);
+        status = 0;
+        fits_read_key(fptr, TDOUBLE, "BZERO", &bzero, nullptr, &status);
+
+        LONGLONG header_start, data_start, data_end;
+        status = 0;
+        fits_get_hduaddrll(fptr, &header_start, &data_start, &data_end, &status);
+        if (!status && (bscale == 1.0) && (bzero == 0.0)) {
+            _data_offset = data_start;
+        }
+    }
+
     // Number of headers (keys).  nkeys is function parameter.
     nkeys = 0;
     int* more_keys(nullptr);
@@ -1232,30 +1499,30 @@ void CartaFitsImage::SetPixelMask() {
 
     // Read blanked mask from image
     bool ok(false);
-    casacore::ArrayLattice<bool> mask_lattice;
+    auto mask = std::make_shared<BitMask>();
     switch (_datatype) {
         case 8: {
-            ok = GetPixelMask<unsigned char>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<unsigned char>(fptr, _datatype, _shape, *mask);
             break;
         }
         case 16: {
-            ok = GetPixelMask<short>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<short>(fptr, _datatype, _shape, *mask);
             break;
         }
         case 32: {
-            ok = GetPixelMask<int>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<int>(fptr, _datatype, _shape, *mask);
             break;
         }
         case 64: {
-            ok = GetPixelMask<LONGLONG>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<LONGLONG>(fptr, _datatype, _shape, *mask);
             break;
         }
         case -32: {
-            ok = GetPixelMask<float>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<float>(fptr, _datatype, _shape, *mask);
             break;
         }
         case -64: {
-            ok = GetPixelMask<double>(fptr, _datatype, _shape, mask_lattice);
+            ok = GetPixelMask<double>(fptr, _datatype, _shape, *mask);
             break;
         }
     }
@@ -1264,7 +1531,7 @@ void CartaFitsImage::SetPixelMask() {
         spdlog::error("FITS read pixel mask failed.");
         _pixel_mask = nullptr;
     } else {
-        _pixel_mask = new casacore::ArrayLattice<bool>(mask_lattice);
+        _pixel_mask = new BitMaskLattice(mask);
     }
 
     CloseFile();
@@ -10,14 +10,21 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_CARTAFITSIMAGE_H_
 #define CARTA_BACKEND_IMAGEDATA_CARTAFITSIMAGE_H_
 
+#include <mutex>
+#include <vector>
+
 #include <casacore/casa/Utilities/DataType.h>
 #include <casacore/images/Images/ImageInterface.h>
 #include <casacore/lattices/Lattices/TiledShape.h>
 
 #include <fitsio.h>
 
+#include "../ImageStats/BitMask.h"
 #include "../Logger/Logger.h"
 
+// Idle read handles kept open for reuse; more are opened while more threads read at once
+#define MAX_IDLE_FITS_READ_HANDLES 8
+
 namespace carta {
 
 class CartaFitsImage : public casacore::ImageInterface<float> {
@@ -57,6 +64,11 @@ private:
     void CloseFile();
     void CloseFileIfError(const int& status, const std::string& error);
 
+    // Pool of independently opened handles for data reads, one per reading thread
+    fitsfile* AcquireReadHandle();
+    void ReleaseReadHandle(fitsfile* fptr);
+    void CloseReadHandles();
+
     void SetUpImage();
     void GetFitsHeaders(int& nkeys, std::string& hdrstr);
 
@@ -77,10 +89,18 @@ private:
     // Pixel mask
     void SetPixelMask();
 
+    // Memory-mapped reads of uncompressed, unscaled float data
+    void MapData();
+    void UnmapData();
+    bool GetMappedDataSubset(const casacore::Slicer& section, casacore::Array<float>& buffer);
+
+    // Reads through cfitsio
+    bool ReadDataSubset(fitsfile* fptr, const casacore::Slicer& section, casacore::Array<float>& buffer);
+    bool GetCompressedDataSubset(const casacore::Slicer& section, casacore::Array<float>& buffer, bool& ok);
     template <typename T>
     bool GetDataSubset(fitsfile* fptr, int datatype, const casacore::Slicer& section, casacore::Array<float>& buffer);
     template <typename T>
-    bool GetPixelMask(fitsfile* fptr, int datatype, const casacore::IPosition& shape, casacore::ArrayLattice<bool>& mask);
+    bool GetPixelMask(fitsfile* fptr, int datatype, const casacore::IPosition& shape, BitMask& mask);
 
     std::string _filename;
     unsigned int _hdu;
@@ -88,12 +108,23 @@ private:
     // File pointer for open file; nullptr when closed
     fitsfile* _fptr;
 
+    // Idle read handles; cfitsio allows concurrent reads of a file through separately opened handles
+    std::vector<fitsfile*> _read_handles;
+    std::mutex _read_handle_mutex;
+    std::mutex _pixel_mask_mutex;
+
     // FITS header values
     bool _is_compressed;
+    casacore::IPosition _compressed_tile_shape; // empty if not compressed
     casacore::IPosition _shape;
     int _datatype; // bitpix value
     bool _has_blanks;
 
+    // Byte offset of the data unit in the file, or -1 if the data cannot be read from a mapping
+    int64_t _data_offset;
+    char* _mapped_data;
+    size_t _mapped_size;
+
     casacore::Lattice<bool>* _pixel_mask;
     casacore::TiledShape _tiled_shape;
 };
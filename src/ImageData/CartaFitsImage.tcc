@@ -9,8 +9,12 @@
 
 #include "CartaFitsImage.h"
 
+#include <algorithm>
+
 #include <casacore/casa/Arrays/ArrayMath.h>
 
+#include "../Constants.h"
+
 namespace carta {
 
 template <typename T>
@@ -74,15 +78,15 @@ bool CartaFitsImage::GetDataSubset(fitsfile* fptr, int datatype, const casacore:
 }
 
 template <typename T>
-bool CartaFitsImage::GetPixelMask(fitsfile* fptr, int datatype, const casacore::IPosition& shape, casacore::ArrayLattice<bool>& mask) {
-    // Return mask for entire image
-    auto mask_size = shape.product();
-    std::vector<char> mask_buffer(mask_size);
-    casacore::Array<char> marray(shape, mask_buffer.data(), casacore::StorageInitPolicy::SHARE);
-    std::vector<T> data_buffer(mask_size);
+bool CartaFitsImage::GetPixelMask(fitsfile* fptr, int datatype, const casacore::IPosition& shape, BitMask& mask) {
+    // Return mask for entire image, read in blocks of pixels so that only the bit mask is kept for the whole image
+    size_t mask_size = shape.product();
+    size_t block_size = std::min(mask_size, (size_t)FITS_MASK_BLOCK_PIXELS);
+    std::vector<char> mask_buffer(block_size);
+    std::vector<T> data_buffer(block_size);
+    mask = BitMask(shape);
 
     // cfitsio params
-    std::vector<long> start(shape.size(), 1);
     int anynul(0), status(0);
     int dtype(TFLOAT);
 
@@ -107,16 +111,28 @@ bool CartaFitsImage::GetPixelMask(fitsfile* fptr, int datatype, const casacore::
             break;
     }
 
-    fits_read_pixnull(fptr, dtype, start.data(), mask_size, data_buffer.data(), mask_buffer.data(), &anynul, &status);
-    if (status > 0) {
-        spdlog::debug("fits_read_pixnull exited with status {}", status);
-        return false;
+    std::vector<long> start(shape.size());
+    for (size_t block_start = 0; block_start < mask_size; block_start += block_size) {
+        // 1-based pixel of the first value of the block
+        size_t index = block_start;
+        for (size_t axis = 0; axis < shape.size(); ++axis) {
+            start[axis] = index % shape(axis) + 1;
+            index /= shape(axis);
+        }
+        size_t num_pixels = std::min(block_size, mask_size - block_start);
+        fits_read_pixnull(fptr, dtype, start.data(), num_pixels, data_buffer.data(), mask_buffer.data(), &anynul, &status);
+        if (status > 0) {
+            spdlog::debug("fits_read_pixnull exited with status {}", status);
+            return false;
+        }
+
+        // Convert <char> to bits
+        for (size_t i = 0; i < num_pixels; ++i) {
+            if (mask_buffer[i]) {
+                mask.Set(block_start + i, true);
+            }
+        }
     }
-
-    // Convert <char> to <bool>
-    casacore::Array<bool> mask_array(marray.shape());
-    convertArray(mask_array, marray);
-    mask = casacore::ArrayLattice<bool>(mask_array);
     return true;
 }
 
@@ -40,6 +40,10 @@ CartaHdf5Image::CartaHdf5Image(const CartaHdf5Image& other)
       _mask_spec(other._mask_spec),
       _lattice(other._lattice),
       _shape(other._shape) {
+    {
+        std::unique_lock<std::mutex> lock(other._deferred_headers_mutex);
+        _deferred_headers = other._deferred_headers;
+    }
     if (other._pixel_mask != nullptr) {
         _pixel_mask = other._pixel_mask->clone();
     }
@@ -239,9 +243,29 @@ void CartaHdf5Image::SetUpImage() {
 }
 
 casacore::Vector<casacore::String> CartaHdf5Image::Hdf5ToFITSHeaderStrings() {
-    // Convert specified Hdf5 attributes to FITS-format strings.
+    // Convert Hdf5 attributes used for image setup to FITS-format strings; others are deferred.
     casacore::CountedPtr<casacore::HDF5Group> hdf5_group(_lattice.group());
-    return Hdf5Attributes::ReadAttributes(hdf5_group.get()->getHid());
+    return Hdf5Attributes::ReadAttributes(hdf5_group.get()->getHid(), &_deferred_headers);
+}
+
+void CartaHdf5Image::LoadDeferredHeaders() {
+    std::unique_lock<std::mutex> lock(_deferred_headers_mutex);
+    if (_deferred_headers.empty()) {
+        return;
+    }
+
+    try {
+        casacore::Record deferred_headers_rec;
+        casacore::CountedPtr<casacore::HDF5Group> hdf5_group(_lattice.group());
+        Hdf5Attributes::ReadRecord(hdf5_group.get()->getHid(), _deferred_headers, deferred_headers_rec);
+
+        casacore::Record misc_info(miscInfo());
+        casacore::ImageFITSConverter::extractMiscInfo(misc_info, deferred_headers_rec);
+        setMiscInfo(misc_info);
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Error reading HDF5 image headers: {}", err.getMesg());
+    }
+    _deferred_headers.clear();
 }
 
 casacore::uInt CartaHdf5Image::advisedMaxPixels() const {
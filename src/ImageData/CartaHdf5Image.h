@@ -9,6 +9,9 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_CARTAHDF5IMAGE_H_
 #define CARTA_BACKEND_IMAGEDATA_CARTAHDF5IMAGE_H_
 
+#include <mutex>
+#include <vector>
+
 #include <casacore/casa/Containers/Record.h>
 #include <casacore/casa/HDF5/HDF5File.h>
 #include <casacore/casa/HDF5/HDF5Group.h>
@@ -57,6 +60,10 @@ public:
     casacore::Lattice<bool>& pixelMask() override;
     casacore::Bool doGetMaskSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) override;
 
+    // Headers not used for the coordinate system, units or image info (such as history) are read when the image is set up only by
+    // name; add them to the misc info, once, before using the full header.
+    void LoadDeferredHeaders();
+
 private:
     // Function to return the internal HDF5File object to the RegionHandlerHDF5
     inline static const casacore::CountedPtr<casacore::HDF5File>& GetHdf5File(void* image) {
@@ -71,6 +78,9 @@ private:
     casacore::HDF5Lattice<float> _lattice;
     casacore::Lattice<bool>* _pixel_mask;
     casacore::IPosition _shape;
+
+    mutable std::mutex _deferred_headers_mutex;
+    std::vector<int> _deferred_headers; // attribute indices
 };
 
 } // namespace carta
@@ -8,28 +8,69 @@
 
 #include "CartaMiriadImage.h"
 
+#include <algorithm>
+
 #include <casacore/casa/OS/Path.h>
+#include <casacore/lattices/Lattices/Lattice.h>
 #include <casacore/mirlib/maxdimc.h>
 #include <casacore/mirlib/miriad.h>
 
+#include "../Constants.h"
+
 using namespace carta;
 
+namespace {
+
+// Pixel mask which gets its slices from the image, from the cached plane flags
+class MiriadFlagLattice : public casacore::Lattice<bool> {
+public:
+    MiriadFlagLattice(CartaMiriadImage* image) : _image(image) {}
+
+    casacore::Lattice<bool>* clone() const override {
+        return new MiriadFlagLattice(_image);
+    }
+    casacore::IPosition shape() const override {
+        return _image->shape();
+    }
+    casacore::Bool isWritable() const override {
+        return false;
+    }
+    casacore::Bool doGetSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) override {
+        return _image->doGetMaskSlice(buffer, section);
+    }
+    void doPutSlice(const casacore::Array<bool>& /*buffer*/, const casacore::IPosition& /*where*/,
+        const casacore::IPosition& /*stride*/) override {
+        throw(casacore::AipsError("CartaMiriadImage::pixelMask - mask is not writable"));
+    }
+
+private:
+    CartaMiriadImage* _image;
+};
+
+} // namespace
+
 CartaMiriadImage::CartaMiriadImage(const std::string& filename, casacore::MaskSpecifier mask_spec)
     : casacore::MIRIADImage(filename, mask_spec),
       _filename(filename),
       _mask_spec(mask_spec),
       _is_open(false),
       _has_mask(false),
-      _pixel_mask(nullptr) {
+      _pixel_mask(nullptr),
+      _flag_capacity_bytes((size_t)MIRIAD_FLAG_CACHE_MB * 1024 * 1024),
+      _flag_usage_bytes(0),
+      _flag_account("MIRIAD mask flags", MIRIAD_FLAG_CACHE_COST, this) {
     SetUp();
 }
 
 CartaMiriadImage::CartaMiriadImage(const CartaMiriadImage& other)
-    : casacore::MIRIADImage(other), _filename(other._filename), _mask_spec(other._mask_spec), _pixel_mask(nullptr) {
+    : casacore::MIRIADImage(other),
+      _filename(other._filename),
+      _mask_spec(other._mask_spec),
+      _pixel_mask(nullptr), // the pixel mask of the copy reads through the copy
+      _flag_capacity_bytes(other._flag_capacity_bytes),
+      _flag_usage_bytes(0),
+      _flag_account("MIRIAD mask flags", MIRIAD_FLAG_CACHE_COST, this) {
     SetUp();
-    if (other._pixel_mask != nullptr) {
-        _pixel_mask = other._pixel_mask->clone();
-    }
 }
 
 CartaMiriadImage::~CartaMiriadImage() {
@@ -130,7 +171,7 @@ const casacore::Lattice<bool>& CartaMiriadImage::pixelMask() const {
     if (!_has_mask) {
         throw(casacore::AipsError("CartaMiriadImage::pixelMask - no pixelmask used"));
     }
-    return pixelMask();
+    return const_cast<CartaMiriadImage*>(this)->pixelMask();
 }
 
 casacore::Lattice<bool>& CartaMiriadImage::pixelMask() {
@@ -138,16 +179,10 @@ casacore::Lattice<bool>& CartaMiriadImage::pixelMask() {
         throw(casacore::AipsError("CartaMiriadImage::pixelMask - no pixelmask used"));
     }
 
+    std::unique_lock<std::mutex> ulock(_flag_mutex);
     if (_pixel_mask == nullptr) {
-        // fill pixel mask with slicer for entire image shape
-        casacore::IPosition data_shape(shape());
-        casacore::IPosition start(data_shape.size(), 0);
-        casacore::IPosition end(data_shape);
-        casacore::Slicer slicer(start, end);
-        casacore::Array<bool> array_mask;
-        doGetMaskSlice(array_mask, slicer);
-        // set pixel mask
-        _pixel_mask = new casacore::ArrayLattice<bool>(array_mask);
+        // slices of the pixel mask are read like mask slices of the image, instead of reading the entire mask into memory
+        _pixel_mask = new MiriadFlagLattice(this);
     }
     return *_pixel_mask;
 }
@@ -162,42 +197,68 @@ casacore::Bool CartaMiriadImage::doGetMaskSlice(casacore::Array<bool>& buffer, c
         return false;
     }
 
+    std::unique_lock<std::mutex> ulock(_flag_mutex);
     if (!_is_open) {
         OpenImage();
     }
 
-    // set each image plane and read flags
+    // image planes of the section; z and w are -1 for axes which the image does not have
     int naxis_plane(slicer_shape.size() - 2); // num axes needed to select image plane
     casacore::IPosition start_pos(section.start()), end_pos(section.end()), stride(section.stride());
-    switch (naxis_plane) {
-        case 0: { // xy 2D mask
-            GetPlaneFlags(buffer, section);
-            break;
-        }
-        case 1: { // xyz 3D mask
-            for (int z = start_pos(2); z <= end_pos(2); z += stride(2)) {
-                // set 1-based image plane for z and get flags
-                int plane_axes[] = {z + 1};
-                xysetpl_c(_file_handle, naxis_plane, plane_axes);
-                GetPlaneFlags(buffer, section, z);
+    int z_start = naxis_plane > 0 ? start_pos(2) : -1, z_end = naxis_plane > 0 ? end_pos(2) : -1;
+    int z_stride = naxis_plane > 0 ? stride(2) : 1;
+    int w_start = naxis_plane > 1 ? start_pos(3) : -1, w_end = naxis_plane > 1 ? end_pos(3) : -1;
+    int w_stride = naxis_plane > 1 ? stride(3) : 1;
+
+    // Sections over more planes than the cache holds, such as spectra of large cubes, read their rows of each plane instead
+    size_t num_planes = (naxis_plane > 0 ? slicer_shape(2) : 1) * (naxis_plane > 1 ? slicer_shape(3) : 1);
+    if (num_planes * PlaneFlagsBytes() > _flag_capacity_bytes) {
+        for (int w = w_start; w <= w_end; w += w_stride) {
+            for (int z = z_start; z <= z_end; z += z_stride) {
+                SetPlane(z, w);
+                GetPlaneFlags(buffer, section, z, w);
             }
-            break;
         }
-        case 2: { // xyzw 4D mask
-            for (int w = start_pos(3); w <= end_pos(3); w += stride(3)) {
-                for (int z = start_pos(2); z <= end_pos(2); z += stride(2)) {
-                    // set 1-based image plane for zw and get flags
-                    int plane_axes[] = {z + 1, w + 1};
-                    xysetpl_c(_file_handle, naxis_plane, plane_axes);
-                    GetPlaneFlags(buffer, section, z, w);
+        return false;
+    }
+
+    // Copy the section from the bit-packed planes
+    size_t width = shape()(0);
+    size_t length_x = slicer_shape(0), length_y = slicer_shape(1);
+    bool delete_storage;
+    bool* buffer_data = buffer.getStorage(delete_storage);
+    bool* plane_data = buffer_data;
+    for (int w = w_start; w <= w_end; w += w_stride) {
+        for (int z = z_start; z <= z_end; z += z_stride) {
+            PlaneFlags flags = GetCachedPlaneFlags(z, w);
+            for (size_t j = 0; j < length_y; ++j) {
+                size_t row_start = (start_pos(1) + j * stride(1)) * width + start_pos(0);
+                for (size_t i = 0; i < length_x; ++i) {
+                    size_t index = row_start + i * stride(0);
+                    plane_data[j * length_x + i] = ((*flags)[index >> 6] >> (index & 63)) & 1;
                 }
             }
-            break;
+            plane_data += length_x * length_y;
         }
     }
+    buffer.putStorage(buffer_data, delete_storage);
+    ulock.unlock();
+
+    _flag_account.Enforce();
     return false;
 }
 
+void CartaMiriadImage::SetPlane(int z, int w) {
+    // set 1-based image plane for z, or zw
+    if (w >= 0) {
+        int plane_axes[] = {z + 1, w + 1};
+        xysetpl_c(_file_handle, 2, plane_axes);
+    } else if (z >= 0) {
+        int plane_axes[] = {z + 1};
+        xysetpl_c(_file_handle, 1, plane_axes);
+    }
+}
+
 void CartaMiriadImage::GetPlaneFlags(casacore::Array<bool>& buffer, const casacore::Slicer& section, int z, int w) {
     // Get flag rows in plane from miriad mask.
     // Assumes plane has been set (xysetpl_c) and buffer is sized to slicer shape
@@ -224,3 +285,88 @@ void CartaMiriadImage::GetPlaneFlags(casacore::Array<bool>& buffer, const casaco
         }
     }
 }
+
+CartaMiriadImage::PlaneFlags CartaMiriadImage::GetCachedPlaneFlags(int z, int w) {
+    int depth = z >= 0 ? shape()(2) : 1;
+    int plane = std::max(z, 0) + std::max(w, 0) * depth;
+    auto it = _flag_index.find(plane);
+    if (it != _flag_index.end()) {
+        _flag_planes.splice(_flag_planes.begin(), _flag_planes, it->second);
+        it->second->last_used = std::chrono::steady_clock::now();
+        return it->second->flags;
+    }
+
+    // Read the block of planes which contains z, so that spectral and cube sections over the next planes do not go back to the file
+    PlaneFlags flags;
+    int block_start = z >= 0 ? (z / MIRIAD_FLAG_BLOCK_PLANES) * MIRIAD_FLAG_BLOCK_PLANES : z;
+    int block_end = z >= 0 ? std::min(block_start + MIRIAD_FLAG_BLOCK_PLANES, depth) - 1 : z;
+    for (int block_z = block_end; block_z >= block_start; --block_z) {
+        int block_plane = std::max(block_z, 0) + std::max(w, 0) * depth;
+        if ((block_z != z) && _flag_index.count(block_plane)) {
+            continue;
+        }
+        SetPlane(block_z, w);
+        PlaneFlags block_flags = ReadPlaneFlags(block_z, w);
+        if (block_z == z) {
+            flags = block_flags;
+        }
+        _flag_planes.push_front(FlagCacheEntry{block_plane, block_flags, std::chrono::steady_clock::now()});
+        _flag_index[block_plane] = _flag_planes.begin();
+        _flag_usage_bytes += PlaneFlagsBytes();
+    }
+    EvictPlaneFlags();
+    _flag_account.SetUsage(_flag_usage_bytes);
+    return flags;
+}
+
+CartaMiriadImage::PlaneFlags CartaMiriadImage::ReadPlaneFlags(int z, int w) {
+    // Assumes plane has been set (xysetpl_c)
+    size_t width = shape()(0), height = shape()(1);
+    auto flags = std::make_shared<std::vector<uint64_t>>((width * height + 63) / 64, 0);
+    std::vector<int> flag_row(width);
+    for (size_t y = 0; y < height; ++y) {
+        xyflgrd_c(_file_handle, y + 1, flag_row.data()); // 1-based row (y) index in mask file
+        size_t index = y * width;
+        for (size_t x = 0; x < width; ++x, ++index) {
+            if (flag_row[x]) {
+                (*flags)[index >> 6] |= (uint64_t)1 << (index & 63);
+            }
+        }
+    }
+    return flags;
+}
+
+size_t CartaMiriadImage::PlaneFlagsBytes() const {
+    return sizeof(uint64_t) * ((shape()(0) * shape()(1) + 63) / 64);
+}
+
+void CartaMiriadImage::EvictPlaneFlags() {
+    // Caller holds the flag mutex. Mask slices being copied keep their own references to evicted planes.
+    while ((_flag_usage_bytes > _flag_capacity_bytes) && !_flag_planes.empty()) {
+        _flag_index.erase(_flag_planes.back().plane);
+        _flag_planes.pop_back();
+        _flag_usage_bytes -= PlaneFlagsBytes();
+    }
+}
+
+bool CartaMiriadImage::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> ulock(_flag_mutex);
+    if (_flag_planes.empty()) {
+        return false;
+    }
+    last_used = _flag_planes.back().last_used;
+    return true;
+}
+
+size_t CartaMiriadImage::EvictOldest() {
+    std::unique_lock<std::mutex> ulock(_flag_mutex);
+    if (_flag_planes.empty()) {
+        return 0;
+    }
+    size_t num_bytes = PlaneFlagsBytes();
+    _flag_index.erase(_flag_planes.back().plane);
+    _flag_planes.pop_back();
+    _flag_usage_bytes -= num_bytes;
+    _flag_account.SetUsage(_flag_usage_bytes);
+    return num_bytes;
+}
@@ -9,13 +9,23 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_CARTAMIRIADIMAGE_H_
 #define CARTA_BACKEND_IMAGEDATA_CARTAMIRIADIMAGE_H_
 
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <casacore/coordinates/Coordinates/SpectralCoordinate.h>
 #include <casacore/images/Images/MIRIADImage.h>
 #include <casacore/images/Images/MaskSpecifier.h>
 
+#include "../MemoryBudget.h"
+
 namespace carta {
 
-class CartaMiriadImage : public casacore::MIRIADImage {
+class CartaMiriadImage : public casacore::MIRIADImage, private MemoryConsumer {
 public:
     // Construct an image from a pre-existing file.
     CartaMiriadImage(const std::string& filename, casacore::MaskSpecifier = casacore::MaskSpecifier());
@@ -40,6 +50,14 @@ public:
     casacore::Bool doGetMaskSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) override;
 
 private:
+    // Flags of a plane, one bit per pixel in row order
+    using PlaneFlags = std::shared_ptr<const std::vector<uint64_t>>;
+    struct FlagCacheEntry {
+        int plane;
+        PlaneFlags flags;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
     void SetUp();
     void OpenImage();
     void CloseImage();
@@ -47,8 +65,17 @@ private:
     void SetNativeType();
 
     // for doGetMaskSlice, read flag rows from mask file using mirlib
+    void SetPlane(int z, int w);
     void GetPlaneFlags(casacore::Array<bool>& buffer, const casacore::Slicer& section, int z = -1, int w = -1);
 
+    // Flags of a plane from the cache, reading the block of planes which contains it on a miss; caller holds the flag mutex
+    PlaneFlags GetCachedPlaneFlags(int z, int w);
+    PlaneFlags ReadPlaneFlags(int z, int w);
+    size_t PlaneFlagsBytes() const;
+    void EvictPlaneFlags();
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
     casacore::String _filename;
     casacore::MaskSpecifier _mask_spec;
     bool _is_open;
@@ -58,6 +85,14 @@ private:
     bool _has_mask;
     casacore::String _mask_name; // full path to mask file
     casacore::Lattice<casacore::Bool>* _pixel_mask;
+
+    // Bit-packed flags of recently read planes, most recently used at the front; the mutex also serialises mirlib calls
+    std::list<FlagCacheEntry> _flag_planes;
+    std::unordered_map<int, std::list<FlagCacheEntry>::iterator> _flag_index;
+    size_t _flag_capacity_bytes;
+    size_t _flag_usage_bytes;
+    std::mutex _flag_mutex;
+    MemoryAccount _flag_account;
 };
 
 } // namespace carta
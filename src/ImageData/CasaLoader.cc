@@ -0,0 +1,90 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "CasaLoader.h"
+
+#include <algorithm>
+
+#include "../Constants.h"
+#include "../Logger/Logger.h"
+
+namespace carta {
+
+int CasaLoader::_tile_cache_mb = CASA_TILE_CACHE_MB;
+
+CasaLoader::CasaLoader(const std::string& filename)
+    : FileLoader(filename), _cache_tiles(0), _cache_account("CASA image tiles", SHARED_PLANE_CACHE_COST) {}
+
+void CasaLoader::OpenFile(const std::string& /*hdu*/) {
+    if (!_image) {
+        _image.reset(new casacore::PagedImage<float>(_filename));
+        if (!_image) {
+            throw(casacore::AipsError("Error opening image"));
+        }
+        _num_dims = _image->shape().size();
+        _tile_shape = _image->niceCursorShape(); // the tile shape of paged images
+    }
+}
+
+bool CasaLoader::HasData(FileInfo::Data dl) const {
+    switch (dl) {
+        case FileInfo::Data::Image:
+            return true;
+        case FileInfo::Data::XY:
+            return _num_dims >= 2;
+        case FileInfo::Data::XYZ:
+            return _num_dims >= 3;
+        case FileInfo::Data::XYZW:
+            return _num_dims >= 4;
+        case FileInfo::Data::MASK:
+            return ((_image != nullptr) && _image->hasPixelMask());
+        default:
+            break;
+    }
+    return false;
+}
+
+typename CasaLoader::ImageRef CasaLoader::GetImage() {
+    return _image.get(); // nullptr if image not opened
+}
+
+void CasaLoader::SetReadPattern(ReadPattern pattern, const IPos& read_shape) {
+    // Size the tile cache to hold the tiles which the reads of the pattern revisit: all tiles of a plane (read again for the next
+    // channels of tiles deeper than one channel), the column of tiles of a spectrum (for the next cursor positions in the tiles),
+    // the tiles of a region box, or one row of tiles across the box for the spectra of a moment traversal along x
+    if (!_image || (_tile_cache_mb <= 0) || (read_shape.size() != _tile_shape.size())) {
+        return;
+    }
+
+    IPos traversal_shape(read_shape);
+    if ((pattern == ReadPattern::Moments) && (traversal_shape.size() > 1)) {
+        traversal_shape(1) = 1;
+    }
+
+    size_t num_tiles(1);
+    for (size_t i = 0; i < traversal_shape.size(); ++i) {
+        num_tiles *= (traversal_shape(i) + _tile_shape(i) - 1) / _tile_shape(i);
+    }
+
+    size_t tile_size = sizeof(float) * _tile_shape.product();
+    size_t max_size = (size_t)_tile_cache_mb * 1024 * 1024;
+    auto& budget = MemoryBudget::Global();
+    if (budget.Limit() > 0) {
+        size_t others = budget.Usage() - std::min(budget.Usage(), _cache_account.Usage());
+        max_size = std::min(max_size, budget.Limit() - std::min(budget.Limit(), others));
+    }
+    num_tiles = std::max((size_t)1, std::min(num_tiles, max_size / tile_size));
+    if (num_tiles == _cache_tiles) {
+        return;
+    }
+
+    _image->setCacheSizeInTiles(num_tiles);
+    _cache_tiles = num_tiles;
+    _cache_account.SetUsage(num_tiles * tile_size);
+    spdlog::debug("CASA tile cache for {}: {} tiles of shape {}", _image->name(true), num_tiles, _tile_shape.toString());
+}
+
+} // namespace carta
@@ -9,6 +9,7 @@
 
 #include <casacore/images/Images/PagedImage.h>
 
+#include "../MemoryBudget.h"
 #include "FileLoader.h"
 
 namespace carta {
@@ -22,43 +23,21 @@ public:
     bool HasData(FileInfo::Data ds) const override;
     ImageRef GetImage() override;
 
-private:
-    std::unique_ptr<casacore::PagedImage<float>> _image;
-};
-
-CasaLoader::CasaLoader(const std::string& filename) : FileLoader(filename) {}
+    void SetReadPattern(ReadPattern pattern, const IPos& read_shape) override;
 
-void CasaLoader::OpenFile(const std::string& /*hdu*/) {
-    if (!_image) {
-        _image.reset(new casacore::PagedImage<float>(_filename));
-        if (!_image) {
-            throw(casacore::AipsError("Error opening image"));
-        }
-        _num_dims = _image->shape().size();
+    // Maximum tile cache per image in MB; 0 leaves the casacore default
+    static void SetTileCacheSize(int megabytes) {
+        _tile_cache_mb = megabytes;
     }
-}
 
-bool CasaLoader::HasData(FileInfo::Data dl) const {
-    switch (dl) {
-        case FileInfo::Data::Image:
-            return true;
-        case FileInfo::Data::XY:
-            return _num_dims >= 2;
-        case FileInfo::Data::XYZ:
-            return _num_dims >= 3;
-        case FileInfo::Data::XYZW:
-            return _num_dims >= 4;
-        case FileInfo::Data::MASK:
-            return ((_image != nullptr) && _image->hasPixelMask());
-        default:
-            break;
-    }
-    return false;
-}
+private:
+    static int _tile_cache_mb;
 
-typename CasaLoader::ImageRef CasaLoader::GetImage() {
-    return _image.get(); // nullptr if image not opened
-}
+    std::unique_ptr<casacore::PagedImage<float>> _image;
+    IPos _tile_shape;
+    size_t _cache_tiles;
+    MemoryAccount _cache_account; // tiles are not evictable, but the cache is sized within the memory left by the other caches
+};
 
 } // namespace carta
 
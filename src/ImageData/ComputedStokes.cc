@@ -0,0 +1,160 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "ComputedStokes.h"
+
+#include <cmath>
+
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "../Constants.h"
+#include "../DataStream/SimdDispatch.h"
+
+namespace carta {
+
+namespace {
+
+// Polarized intensity of Q, U and optionally V, as a percentage of I if given; the SIMD kernels add and divide in the same order
+void PolarizedIntensityScalar(const float* i, const float* q, const float* u, const float* v, float* result, size_t length) {
+    for (size_t n = 0; n < length; ++n) {
+        float sum = q[n] * q[n] + u[n] * u[n];
+        if (v) {
+            sum += v[n] * v[n];
+        }
+        float p = std::sqrt(sum);
+        result[n] = i ? (p * 100.0f) / i[n] : p;
+    }
+}
+
+void PolarizedIntensitySSE(const float* i, const float* q, const float* u, const float* v, float* result, size_t length) {
+    const __m128 percent = _mm_set1_ps(100.0f);
+    size_t n = 0;
+    for (; n + 4 <= length; n += 4) {
+        __m128 q_values = _mm_loadu_ps(q + n);
+        __m128 u_values = _mm_loadu_ps(u + n);
+        __m128 sum = _mm_add_ps(_mm_mul_ps(q_values, q_values), _mm_mul_ps(u_values, u_values));
+        if (v) {
+            __m128 v_values = _mm_loadu_ps(v + n);
+            sum = _mm_add_ps(sum, _mm_mul_ps(v_values, v_values));
+        }
+        __m128 p = _mm_sqrt_ps(sum);
+        if (i) {
+            p = _mm_div_ps(_mm_mul_ps(p, percent), _mm_loadu_ps(i + n));
+        }
+        _mm_storeu_ps(result + n, p);
+    }
+    PolarizedIntensityScalar(i ? i + n : nullptr, q + n, u + n, v ? v + n : nullptr, result + n, length - n);
+}
+
+#ifdef CARTA_X86_SIMD
+CARTA_TARGET_AVX void PolarizedIntensityAVX(
+    const float* i, const float* q, const float* u, const float* v, float* result, size_t length) {
+    const __m256 percent = _mm256_set1_ps(100.0f);
+    size_t n = 0;
+    for (; n + 8 <= length; n += 8) {
+        __m256 q_values = _mm256_loadu_ps(q + n);
+        __m256 u_values = _mm256_loadu_ps(u + n);
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(q_values, q_values), _mm256_mul_ps(u_values, u_values));
+        if (v) {
+            __m256 v_values = _mm256_loadu_ps(v + n);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(v_values, v_values));
+        }
+        __m256 p = _mm256_sqrt_ps(sum);
+        if (i) {
+            p = _mm256_div_ps(_mm256_mul_ps(p, percent), _mm256_loadu_ps(i + n));
+        }
+        _mm256_storeu_ps(result + n, p);
+    }
+    PolarizedIntensityScalar(i ? i + n : nullptr, q + n, u + n, v ? v + n : nullptr, result + n, length - n);
+}
+#endif
+
+void PolarizedIntensity(const float* i, const float* q, const float* u, const float* v, float* result, size_t length) {
+#ifdef CARTA_X86_SIMD
+    static const bool use_avx = GetSimdLevel() >= SimdLevel::Avx;
+    if (use_avx) {
+        PolarizedIntensityAVX(i, q, u, v, result, length);
+        return;
+    }
+#endif
+    PolarizedIntensitySSE(i, q, u, v, result, length);
+}
+
+void PolarizationAngle(const float* q, const float* u, float* result, size_t length) {
+    // No vector atan2; the loop is left to the compiler
+    const float half_radians_to_degrees = 90.0 / M_PI;
+    for (size_t n = 0; n < length; ++n) {
+        result[n] = std::atan2(u[n], q[n]) * half_radians_to_degrees;
+    }
+}
+
+} // namespace
+
+bool IsComputedStokes(int stokes) {
+    return (stokes >= COMPUTE_STOKES_PTOTAL) && (stokes <= COMPUTE_STOKES_PANGLE);
+}
+
+std::vector<CARTA::StokesType> ComputedStokesComponents(int stokes) {
+    using CARTA::StokesType;
+    switch (stokes) {
+        case COMPUTE_STOKES_PTOTAL:
+            return {StokesType::Q, StokesType::U, StokesType::V};
+        case COMPUTE_STOKES_PLINEAR:
+        case COMPUTE_STOKES_PANGLE:
+            return {StokesType::Q, StokesType::U};
+        case COMPUTE_STOKES_PFTOTAL:
+            return {StokesType::I, StokesType::Q, StokesType::U, StokesType::V};
+        case COMPUTE_STOKES_PFLINEAR:
+            return {StokesType::I, StokesType::Q, StokesType::U};
+        default:
+            return {};
+    }
+}
+
+bool ComputedStokesCoordinate(const std::string& coordinate, int& stokes) {
+    if (coordinate == "Ptotalz") {
+        stokes = COMPUTE_STOKES_PTOTAL;
+    } else if (coordinate == "Plinearz") {
+        stokes = COMPUTE_STOKES_PLINEAR;
+    } else if (coordinate == "PFtotalz") {
+        stokes = COMPUTE_STOKES_PFTOTAL;
+    } else if (coordinate == "PFlinearz") {
+        stokes = COMPUTE_STOKES_PFLINEAR;
+    } else if (coordinate == "Panglez") {
+        stokes = COMPUTE_STOKES_PANGLE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ComputeStokes(int stokes, const std::vector<const float*>& components, float* result, size_t length) {
+    switch (stokes) {
+        case COMPUTE_STOKES_PTOTAL:
+            PolarizedIntensity(nullptr, components[0], components[1], components[2], result, length);
+            break;
+        case COMPUTE_STOKES_PLINEAR:
+            PolarizedIntensity(nullptr, components[0], components[1], nullptr, result, length);
+            break;
+        case COMPUTE_STOKES_PFTOTAL:
+            PolarizedIntensity(components[0], components[1], components[2], components[3], result, length);
+            break;
+        case COMPUTE_STOKES_PFLINEAR:
+            PolarizedIntensity(components[0], components[1], components[2], nullptr, result, length);
+            break;
+        case COMPUTE_STOKES_PANGLE:
+            PolarizationAngle(components[0], components[1], result, length);
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,37 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ComputedStokes.h: polarization planes calculated from the I, Q, U and V planes of an image
+
+#ifndef CARTA_BACKEND_IMAGEDATA_COMPUTEDSTOKES_H_
+#define CARTA_BACKEND_IMAGEDATA_COMPUTEDSTOKES_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <carta-protobuf/enums.pb.h>
+
+namespace carta {
+
+// Computed stokes are requested with indexes after those of any image stokes axis, COMPUTE_STOKES_PTOTAL to COMPUTE_STOKES_PANGLE
+bool IsComputedStokes(int stokes);
+
+// Stokes planes used by a computed stokes, in the order ComputeStokes takes them; empty if not a computed stokes
+std::vector<CARTA::StokesType> ComputedStokesComponents(int stokes);
+
+// Computed stokes of a spectral profile coordinate such as "Ptotalz" or "Panglez"; false for other coordinates
+bool ComputedStokesCoordinate(const std::string& coordinate, int& stokes);
+
+// Values of the computed stokes from its component values, each of length values; NaN where any component is NaN:
+//   Ptotal = sqrt(Q^2 + U^2 + V^2), Plinear = sqrt(Q^2 + U^2), PFtotal and PFlinear = 100 * Ptotal or Plinear / I (%),
+//   Pangle = atan2(U, Q) / 2 (degrees)
+// Intensities and fractions use SSE or AVX kernels, with the same results as the scalar calculation.
+void ComputeStokes(int stokes, const std::vector<const float*>& components, float* result, size_t length);
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_COMPUTEDSTOKES_H_
@@ -7,6 +7,11 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_EXPRLOADER_H_
 #define CARTA_BACKEND_IMAGEDATA_EXPRLOADER_H_
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <casacore/casa/Json/JsonKVMap.h>
 #include <casacore/casa/Json/JsonParser.h>
 #include <casacore/images/Images/ImageExpr.h>
@@ -26,12 +31,26 @@ public:
     bool HasData(FileInfo::Data ds) const override;
     ImageRef GetImage() override;
 
+    // Serve planes from the evaluated plane cache where possible
+    bool GetSlice(casacore::Array<float>& data, const casacore::Slicer& slicer) override;
+    bool GetCursorSpectralData(
+        std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) override;
+
 private:
-    std::string _filename;
     std::unique_ptr<casacore::ImageExpr<float>> _image;
+
+    // LRU cache of evaluated planes (with mask applied), keyed by z and stokes
+    bool GetSlicePlanes(const casacore::Slicer& slicer, int& z_start, int& z_count, int& stokes) const;
+    const std::vector<float>* FindPlane(int z, int stokes);
+    void AddPlane(int z, int stokes, std::vector<float>&& plane);
+
+    std::mutex _plane_cache_mutex;
+    std::list<int64_t> _plane_keys; // most recently used at the front
+    std::unordered_map<int64_t, std::pair<std::vector<float>, std::list<int64_t>::iterator>> _planes;
+    size_t _max_planes;
 };
 
-ExprLoader::ExprLoader(const std::string& filename) : FileLoader(filename) {}
+ExprLoader::ExprLoader(const std::string& filename) : FileLoader(filename), _max_planes(0) {}
 
 void ExprLoader::OpenFile(const std::string& /*hdu*/) {
     if (!_image) {
@@ -44,6 +63,9 @@ void ExprLoader::OpenFile(const std::string& /*hdu*/) {
             throw(casacore::AipsError("Error opening image"));
         }
         _num_dims = _image->shape().size();
+
+        size_t plane_size_mb = (sizeof(float) * _image->shape()(0) * _image->shape()(1)) / (1024 * 1024);
+        _max_planes = EXPR_PLANE_CACHE_MB / std::max(plane_size_mb, (size_t)1);
     }
 }
 
@@ -69,6 +91,146 @@ typename ExprLoader::ImageRef ExprLoader::GetImage() {
     return _image.get(); // nullptr if image not opened
 }
 
+bool ExprLoader::GetSlice(casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    // Each read re-evaluates the expression over its operand images, so keep full planes once evaluated.
+    // Sections of cached planes are copied from the cache; other sections evaluate only the requested pixels.
+    int z_start, z_count, stokes;
+    if (!GetSlicePlanes(slicer, z_start, z_count, stokes)) {
+        return FileLoader::GetSlice(data, slicer);
+    }
+
+    IPos shape = _image->shape();
+    IPos start = slicer.start();
+    IPos length = slicer.length();
+    bool full_plane = (z_count == 1) && (length(0) == shape(0)) && (length(1) == shape(1));
+
+    std::unique_lock<std::mutex> ulock(_plane_cache_mutex);
+    std::vector<const std::vector<float>*> planes(z_count);
+    for (int i = 0; i < z_count; ++i) {
+        planes[i] = FindPlane(z_start + i, stokes);
+        if (!planes[i]) {
+            if (!full_plane) {
+                ulock.unlock();
+                return FileLoader::GetSlice(data, slicer);
+            }
+
+            // Evaluate and cache the plane
+            if (!FileLoader::GetSlice(data, slicer)) {
+                return false;
+            }
+            AddPlane(z_start, stokes, data.tovector());
+            return true;
+        }
+    }
+
+    if (data.shape() != length) {
+        data.resize(length);
+    }
+
+    // A unit stokes axis does not change the layout, x fastest then y then z
+    bool delete_storage;
+    float* out = data.getStorage(delete_storage);
+    size_t width = shape(0);
+    size_t index(0);
+    for (int i = 0; i < z_count; ++i) {
+        const float* plane = planes[i]->data();
+        for (size_t y = start(1); y < start(1) + length(1); ++y) {
+            const float* row = plane + y * width + start(0);
+            std::copy(row, row + length(0), out + index);
+            index += length(0);
+        }
+    }
+    data.putStorage(out, delete_storage);
+    return true;
+}
+
+bool ExprLoader::GetCursorSpectralData(
+    std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) {
+    // Evaluate the expression only for the cursor pixels, over all channels at once
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::CursorSpectral);
+    if (FileLoader::GetCursorSpectralData(data, stokes, cursor_x, count_x, cursor_y, count_y, image_mutex)) {
+        io_stats.AddBytes(data.size() * sizeof(float));
+        return true;
+    }
+
+    if (!_image || (count_x != 1) || (count_y != 1) || (_z_axis < 0) || (_render_axes.size() < 2) || (_render_axes[0] != 0) ||
+        (_render_axes[1] != 1)) {
+        return false;
+    }
+
+    IPos shape = _image->shape();
+    if ((cursor_x < 0) || (cursor_y < 0) || (cursor_x >= shape(0)) || (cursor_y >= shape(1)) || (stokes < 0) ||
+        (stokes >= (int)_num_stokes)) {
+        return false;
+    }
+
+    IPos start(shape.size(), 0);
+    IPos count(shape);
+    start(0) = cursor_x;
+    start(1) = cursor_y;
+    count(0) = 1;
+    count(1) = 1;
+    if (_stokes_axis >= 0) {
+        start(_stokes_axis) = stokes;
+        count(_stokes_axis) = 1;
+    }
+
+    data.resize(_depth);
+    casacore::Array<float> tmp(count, data.data(), casacore::StorageInitPolicy::SHARE);
+    std::lock_guard<std::mutex> guard(image_mutex);
+    if (!GetSlice(tmp, casacore::Slicer(start, count))) {
+        return false;
+    }
+    io_stats.AddBytes(data.size() * sizeof(float));
+    return true;
+}
+
+bool ExprLoader::GetSlicePlanes(const casacore::Slicer& slicer, int& z_start, int& z_count, int& stokes) const {
+    // Whether the slicer is a contiguous section of one stokes, as planes on render axes 0 and 1
+    if (!_image || (_max_planes == 0) || (_render_axes.size() < 2) || (_render_axes[0] != 0) || (_render_axes[1] != 1) ||
+        (slicer.stride().product() != 1)) {
+        return false;
+    }
+
+    IPos start = slicer.start();
+    IPos length = slicer.length();
+    for (size_t i = 2; i < length.size(); ++i) {
+        if (((int)i != _z_axis) && (length(i) != 1)) {
+            return false; // other axes (e.g. stokes) must be a single plane
+        }
+    }
+
+    z_start = (_z_axis >= 0 ? start(_z_axis) : 0);
+    z_count = (_z_axis >= 0 ? length(_z_axis) : 1);
+    stokes = (_stokes_axis >= 0 ? start(_stokes_axis) : 0);
+    return true;
+}
+
+const std::vector<float>* ExprLoader::FindPlane(int z, int stokes) {
+    // Caller holds the plane cache mutex
+    auto it = _planes.find((int64_t)stokes * _depth + z);
+    if (it == _planes.end()) {
+        return nullptr;
+    }
+    _plane_keys.splice(_plane_keys.begin(), _plane_keys, it->second.second);
+    return &it->second.first;
+}
+
+void ExprLoader::AddPlane(int z, int stokes, std::vector<float>&& plane) {
+    // Caller holds the plane cache mutex
+    int64_t key = (int64_t)stokes * _depth + z;
+    if (_planes.count(key)) {
+        return;
+    }
+
+    while (_planes.size() >= _max_planes) {
+        _planes.erase(_plane_keys.back());
+        _plane_keys.pop_back();
+    }
+    _plane_keys.push_front(key);
+    _planes.emplace(key, std::make_pair(std::move(plane), _plane_keys.begin()));
+}
+
 } // namespace carta
 
 #endif // CARTA_BACKEND_IMAGEDATA_EXPRLOADER_H_
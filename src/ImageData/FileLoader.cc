@@ -6,21 +6,28 @@
 
 #include "FileLoader.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include <casacore/images/Images/SubImage.h>
-#include <casacore/lattices/Lattices/MaskedLatticeIterator.h>
 
 #include "../Logger/Logger.h"
+#include "../Metrics.h"
+#include "../Threading.h"
+#include "../Timer/SlowRequestLog.h"
+#include "../Timer/TraceEvents.h"
 #include "../Util.h"
 #include "CasaLoader.h"
 #include "CompListLoader.h"
+#include "ComputedStokes.h"
 #include "ConcatLoader.h"
 #include "ExprLoader.h"
 #include "FitsLoader.h"
 #include "Hdf5Loader.h"
 #include "ImagePtrLoader.h"
 #include "MiriadLoader.h"
+#include "SidecarCache.h"
 
 using namespace carta;
 
@@ -65,12 +72,22 @@ FileLoader* FileLoader::GetLoader(std::shared_ptr<casacore::ImageInterface<float
     }
 }
 
-FileLoader::FileLoader(const std::string& filename) : _filename(filename) {}
+FileLoader::FileLoader(const std::string& filename)
+    : _filename(filename),
+      _parallel_stokes_slices(false),
+      _io_stats(filename),
+      _lazy_z_stats(false),
+      _lazy_z_stats_full(false),
+      _lazy_z_stats_beam_area(NAN),
+      _lazy_z_stats_bins(0),
+      _lazy_z_stats_ranks(0) {}
 
 bool FileLoader::CanOpenFile(std::string& /*error*/) {
     return true;
 }
 
+void FileLoader::LoadDeferredHeaders() {}
+
 bool FileLoader::GetShape(IPos& shape) {
     ImageRef image = GetImage();
     if (image) {
@@ -201,6 +218,16 @@ bool FileLoader::FindCoordinateAxes(IPos& shape, int& spectral_axis, int& z_axis
             _stokes_indices[GetStokesType(stokes_value)] = i;
         }
     }
+    if (_stokes_indices.empty() && (stokes_axis >= 0) && coord_sys.hasPolarizationCoordinate()) {
+        // Stokes types of images without them in the header keywords, such as CASA images
+        casacore::Vector<casacore::Int> stokes_values = coord_sys.stokesCoordinate().stokes();
+        for (int i = 0; i < std::min((int)stokes_values.size(), (int)_num_stokes); ++i) {
+            auto stokes_type = GetStokesType(stokes_values(i));
+            if (stokes_type != CARTA::StokesType::STOKES_TYPE_NONE) {
+                _stokes_indices[stokes_type] = i;
+            }
+        }
+    }
     return true;
 }
 
@@ -247,52 +274,163 @@ void FileLoader::GetRenderAxes(std::vector<int>& axes) {
 }
 
 bool FileLoader::GetSlice(casacore::Array<float>& data, const casacore::Slicer& slicer) {
-    ImageRef image = GetImage();
-    if (!image) {
-        return false;
+    TraceSpan trace_span("read slice", "io");
+    PhaseScope io_phase(RequestPhase::Io);
+    if (trace_span.Traced()) {
+        trace_span.SetDetail(slicer.length().toString());
     }
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::Slice);
+    io_stats.SetShape(GetSliceShape(slicer.length()));
+    std::vector<int64_t> key(slicer.start().begin(), slicer.start().end());
+    key.insert(key.end(), slicer.length().begin(), slicer.length().end());
+    io_stats.SetKey(key);
+
+    bool ok;
+    if ((_stokes_axis >= 0) && IsComputedStokes(slicer.start()(_stokes_axis))) {
+        ok = GetComputedStokesSlice(data, slicer);
+    } else if (_parallel_stokes_slices && (_stokes_axis >= 0) && (slicer.length()(_stokes_axis) > 1)) {
+        ok = GetStokesSlices(data, slicer);
+    } else {
+        ok = ReadSlice(data, slicer);
+    }
+    if (ok) {
+        io_stats.AddBytes(slicer.length().product() * sizeof(float));
+    }
+    return ok;
+}
 
-    try {
-        if (data.shape() != slicer.length()) {
-            data.resize(slicer.length());
-        }
+SliceShape FileLoader::GetSliceShape(const IPos& length) const {
+    int x_axis = _render_axes.size() == 2 ? _render_axes[0] : 0;
+    int y_axis = _render_axes.size() == 2 ? _render_axes[1] : 1;
+    bool x = (x_axis < (int)length.size()) && (length(x_axis) > 1);
+    bool y = (y_axis < (int)length.size()) && (length(y_axis) > 1);
+    bool z = (_z_axis >= 0) && (_z_axis < (int)length.size()) && (length(_z_axis) > 1);
+    if (z) {
+        return (x || y) ? SliceShape::Cube : SliceShape::Spectrum;
+    }
+    if (x && y) {
+        return SliceShape::Plane;
+    }
+    return x ? SliceShape::Row : (y ? SliceShape::Column : SliceShape::Point);
+}
 
-        // Get data slice with mask applied.
-        // Apply slicer to image first to get appropriate cursor, and use read-only iterator
-        casacore::SubImage<float> subimage(*image, slicer);
-        casacore::RO_MaskedLatticeIterator<float> lattice_iter(subimage);
+bool FileLoader::GetStokesSlices(casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    // Read each stokes of the slice concurrently; each stokes is a separate member image with its own file
+    if (data.shape() != slicer.length()) {
+        data.resize(slicer.length());
+    }
 
-        for (lattice_iter.reset(); !lattice_iter.atEnd(); ++lattice_iter) {
-            casacore::Array<float> cursor_data = lattice_iter.cursor();
+    int num_stokes = slicer.length()(_stokes_axis);
+    std::vector<char> stokes_ok(num_stokes, false);
+
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int i = 0; i < num_stokes; ++i) {
+        IPos start(slicer.start());
+        IPos length(slicer.length());
+        start(_stokes_axis) += i * slicer.stride()(_stokes_axis);
+        length(_stokes_axis) = 1;
+
+        // Read straight into the stokes block of data when it is contiguous, as when the stokes axis is the last axis
+        IPos data_start(length.size(), 0);
+        data_start(_stokes_axis) = i;
+        casacore::Array<float> data_block(data(casacore::Slicer(data_start, length)));
+        bool in_place = data_block.contiguousStorage();
+        casacore::Array<float> stokes_data(in_place ? data_block : casacore::Array<float>(length));
+        if (ReadSlice(stokes_data, casacore::Slicer(start, length, slicer.stride(), casacore::Slicer::endIsLength))) {
+            if (!in_place) {
+                data_block = stokes_data;
+            }
+            stokes_ok[i] = true;
+        }
+    }
 
-            if (image->isMasked()) {
-                casacore::Array<float> masked_data(cursor_data); // reference the same storage
-                const casacore::Array<bool> cursor_mask = lattice_iter.getMask();
+    return std::all_of(stokes_ok.begin(), stokes_ok.end(), [](char ok) { return ok; });
+}
 
-                // Apply cursor mask to cursor data: set masked values to NaN.
-                // booleans are used to delete copy of data if necessary
-                bool del_mask_ptr;
-                const bool* pCursorMask = cursor_mask.getStorage(del_mask_ptr);
+bool FileLoader::GetComputedStokesSlice(casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    // Component planes are read at once over the range of their stokes, which is the whole range for PFtotal of an IQUV image
+    int stokes = slicer.start()(_stokes_axis);
+    if ((slicer.length()(_stokes_axis) != 1) || !HasComputedStokes(stokes)) {
+        return false;
+    }
+    std::vector<int> component_indices;
+    for (auto stokes_type : ComputedStokesComponents(stokes)) {
+        component_indices.push_back(_stokes_indices.at(stokes_type));
+    }
+    auto index_range = std::minmax_element(component_indices.begin(), component_indices.end());
+    int first_index = *index_range.first;
+    int num_read_stokes = *index_range.second - first_index + 1;
+
+    IPos start(slicer.start());
+    IPos length(slicer.length());
+    IPos stride(slicer.stride());
+    start(_stokes_axis) = first_index;
+    length(_stokes_axis) = num_read_stokes;
+    stride(_stokes_axis) = 1;
+    casacore::Slicer read_slicer(start, length, stride, casacore::Slicer::endIsLength);
+    std::vector<float> read_data(length.product());
+    casacore::Array<float> read_array(length, read_data.data(), casacore::StorageInitPolicy::SHARE);
+    bool read_ok = (_parallel_stokes_slices && (num_read_stokes > 1)) ? GetStokesSlices(read_array, read_slicer)
+                                                                      : ReadSlice(read_array, read_slicer);
+    if (!read_ok) {
+        return false;
+    }
 
-                bool del_data_ptr;
-                float* pMaskedData = masked_data.getStorage(del_data_ptr);
+    // The read data has the stokes of each block of the axes below the stokes axis in turn, for each position of the axes above it
+    if (data.shape() != slicer.length()) {
+        data.resize(slicer.length());
+    }
+    size_t block_size(1), num_blocks(1);
+    for (int axis = 0; axis < _stokes_axis; ++axis) {
+        block_size *= length(axis);
+    }
+    for (int axis = _stokes_axis + 1; axis < length.size(); ++axis) {
+        num_blocks *= length(axis);
+    }
+    bool delete_storage;
+    float* result = data.getStorage(delete_storage);
+    std::vector<const float*> components(component_indices.size());
+    for (size_t block = 0; block < num_blocks; ++block) {
+        const float* read_block = read_data.data() + block * num_read_stokes * block_size;
+        for (size_t i = 0; i < component_indices.size(); ++i) {
+            components[i] = read_block + (component_indices[i] - first_index) * block_size;
+        }
+        ComputeStokes(stokes, components, result + block * block_size, block_size);
+    }
+    data.putStorage(result, delete_storage);
+    return true;
+}
 
-                for (size_t i = 0; i < cursor_data.nelements(); ++i) {
-                    if (!pCursorMask[i]) {
-                        pMaskedData[i] = NAN;
-                    }
-                }
+bool FileLoader::HasComputedStokes(int stokes) {
+    auto components = ComputedStokesComponents(stokes);
+    return !components.empty() && std::all_of(components.begin(), components.end(), [&](CARTA::StokesType stokes_type) {
+        return _stokes_indices.count(stokes_type);
+    });
+}
 
-                // free storage for cursor arrays
-                cursor_mask.freeStorage(pCursorMask, del_mask_ptr);
-                masked_data.putStorage(pMaskedData, del_data_ptr);
-            }
+bool FileLoader::ReadSlice(casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    ImageRef image = GetImage();
+    if (!image) {
+        return false;
+    }
 
-            casacore::IPosition cursor_shape(lattice_iter.cursorShape());
-            casacore::IPosition cursor_position(lattice_iter.position());
-            casacore::Slicer cursor_slicer(cursor_position, cursor_shape); // where to put the data
-            data(cursor_slicer) = cursor_data;
+    SliceShape slice_shape = GetSliceShape(slicer.length());
+    if (slice_shape == SliceShape::Plane) {
+        SetReadPattern(ReadPattern::Plane, slicer.length());
+    } else if (slice_shape == SliceShape::Spectrum) {
+        SetReadPattern(ReadPattern::Spectrum, slicer.length());
+    } else {
+        SetReadPattern(ReadPattern::Region, slicer.length());
+    }
+
+    try {
+        if (data.shape() != slicer.length()) {
+            data.resize(slicer.length());
         }
+
+        ReadLatticeSlice(*image, data, slicer);
+        Metrics::Global().AddBytesRead(data.nelements() * sizeof(float));
         return true;
     } catch (casacore::AipsError& err) {
         spdlog::error("Error loading image data: {}", err.getMesg());
@@ -300,6 +438,42 @@ bool FileLoader::GetSlice(casacore::Array<float>& data, const casacore::Slicer&
     }
 }
 
+void FileLoader::ReadLatticeSlice(casacore::MaskedLattice<float>& lattice, casacore::Array<float>& data, const casacore::Slicer& slicer) {
+    if (data.shape() != slicer.length()) {
+        data.resize(slicer.length());
+    }
+
+    // Lattices read into a buffer of the slice shape, except those which reference their own storage, which are copied
+    casacore::Array<float> buffer;
+    buffer.reference(data);
+    lattice.doGetSlice(buffer, slicer);
+    if (buffer.data() != data.data()) {
+        data = buffer;
+    }
+
+    if (lattice.isMasked()) {
+        // Set masked values to NaN
+        casacore::Array<bool> mask;
+        lattice.getMaskSlice(mask, slicer);
+        bool delete_mask, delete_data;
+        const bool* mask_data = mask.getStorage(delete_mask);
+        float* slice_data = data.getStorage(delete_data);
+        for (size_t i = 0; i < data.nelements(); ++i) {
+            if (!mask_data[i]) {
+                slice_data[i] = NAN;
+            }
+        }
+        mask.freeStorage(mask_data, delete_mask);
+        data.putStorage(slice_data, delete_data);
+    }
+}
+
+bool FileLoader::HasConcurrentReads() const {
+    return false;
+}
+
+void FileLoader::SetReadPattern(ReadPattern /*pattern*/, const IPos& /*read_shape*/) {}
+
 bool FileLoader::GetSubImage(const casacore::Slicer& slicer, casacore::SubImage<float>& sub_image) {
     // Get SubImage from Slicer
     ImageRef image = GetImage();
@@ -384,6 +558,10 @@ casacore::ArrayBase* FileLoader::GetStatsData(FileInfo::Data ds) {
     throw casacore::AipsError("getStatsData not implemented in this loader");
 }
 
+casacore::ArrayBase* FileLoader::GetStatsData(FileInfo::Data ds, const casacore::Slicer& slicer) {
+    throw casacore::AipsError("getStatsData not implemented in this loader");
+}
+
 void FileLoader::LoadStats2DBasic(FileInfo::Data ds) {
     if (HasData(ds)) {
         const IPos& stat_dims = GetStatsDataShape(ds);
@@ -628,20 +806,24 @@ void FileLoader::LoadStats3DPercent() {
 }
 
 void FileLoader::LoadImageStats(bool load_percentiles) {
-    _z_stats.resize(_num_stokes);
-    for (size_t s = 0; s < _num_stokes; s++) {
-        _z_stats[s].resize(_depth);
+    // Channel statistics of cubes are read from the file when first used, so that opening does not depend on the depth
+    _lazy_z_stats = HasData(FileInfo::Data::STATS) && HasData(FileInfo::Data::STATS_2D) && (_num_dims > 2);
+    if (!_lazy_z_stats) {
+        _z_stats.resize(_num_stokes);
+        for (size_t s = 0; s < _num_stokes; s++) {
+            _z_stats[s].resize(_depth);
+        }
     }
     _cube_stats.resize(_num_stokes);
 
     // Remove this check when we drop support for the old schema.
     // We assume that checking for only one of these datasets is sufficient.
     bool full(HasData(FileInfo::Data::STATS_2D_SUM));
-    double sum, sum_sq, min, max;
-    uint64_t num_pixels;
 
     if (HasData(FileInfo::Data::STATS)) {
-        if (HasData(FileInfo::Data::STATS_2D)) {
+        if (_lazy_z_stats) {
+            SetUpLazyChannelStats(full, load_percentiles);
+        } else if (HasData(FileInfo::Data::STATS_2D)) {
             LoadStats2DBasic(FileInfo::Data::STATS_2D_MAX);
             LoadStats2DBasic(FileInfo::Data::STATS_2D_MIN);
             if (full) {
@@ -657,31 +839,11 @@ void FileLoader::LoadImageStats(bool load_percentiles) {
             }
 
             double beam_area = CalculateBeamArea();
-            bool has_flux = !std::isnan(beam_area);
 
             // If we loaded all the 2D stats successfully, assume all channel stats are valid
             for (size_t s = 0; s < _num_stokes; s++) {
                 for (size_t z = 0; z < _depth; z++) {
-                    auto& stats = _z_stats[s][z].basic_stats;
-                    if (full) {
-                        num_pixels = _image_plane_size - stats[CARTA::StatsType::NanCount];
-                        sum = stats[CARTA::StatsType::Sum];
-                        sum_sq = stats[CARTA::StatsType::SumSq];
-                        min = stats[CARTA::StatsType::Min];
-                        max = stats[CARTA::StatsType::Max];
-
-                        stats[CARTA::StatsType::NumPixels] = num_pixels;
-                        stats[CARTA::StatsType::Mean] = sum / num_pixels;
-                        stats[CARTA::StatsType::Sigma] = sqrt((sum_sq - (sum * sum / num_pixels)) / (num_pixels - 1));
-                        stats[CARTA::StatsType::RMS] = sqrt(sum_sq / num_pixels);
-                        stats[CARTA::StatsType::Extrema] = (abs(min) > abs(max) ? min : max);
-                        if (has_flux) {
-                            stats[CARTA::StatsType::FluxDensity] = sum / beam_area;
-                        }
-
-                        _z_stats[s][z].full = true;
-                    }
-                    _z_stats[s][z].valid = true;
+                    SetDerivedStats(_z_stats[s][z], _image_plane_size, full, beam_area);
                 }
             }
         }
@@ -702,56 +864,506 @@ void FileLoader::LoadImageStats(bool load_percentiles) {
             }
 
             double beam_area = CalculateBeamArea();
-            bool has_flux = !std::isnan(beam_area);
 
             // If we loaded all the 3D stats successfully, assume all cube stats are valid
             for (size_t s = 0; s < _num_stokes; s++) {
-                auto& stats = _cube_stats[s].basic_stats;
-                if (full) {
-                    num_pixels = (_image_plane_size * _depth) - stats[CARTA::StatsType::NanCount];
-                    sum = stats[CARTA::StatsType::Sum];
-                    sum_sq = stats[CARTA::StatsType::SumSq];
-                    min = stats[CARTA::StatsType::Min];
-                    max = stats[CARTA::StatsType::Max];
-
-                    stats[CARTA::StatsType::NumPixels] = num_pixels;
-                    stats[CARTA::StatsType::Mean] = sum / num_pixels;
-                    stats[CARTA::StatsType::Sigma] = sqrt((sum_sq - (sum * sum / num_pixels)) / (num_pixels - 1));
-                    stats[CARTA::StatsType::RMS] = sqrt(sum_sq / num_pixels);
-                    stats[CARTA::StatsType::Extrema] = (abs(min) > abs(max) ? min : max);
-                    if (has_flux) {
-                        stats[CARTA::StatsType::FluxDensity] = sum / beam_area;
-                    }
+                SetDerivedStats(_cube_stats[s], _image_plane_size * _depth, full, beam_area);
+            }
+        }
+    }
+}
 
-                    _cube_stats[s].full = true;
-                }
-                _cube_stats[s].valid = true;
+void FileLoader::SetDerivedStats(FileInfo::ImageStats& image_stats, size_t num_values, bool full, double beam_area) {
+    if (full) {
+        auto& stats = image_stats.basic_stats;
+        uint64_t num_pixels = num_values - stats[CARTA::StatsType::NanCount];
+        double sum = stats[CARTA::StatsType::Sum];
+        double sum_sq = stats[CARTA::StatsType::SumSq];
+        double min = stats[CARTA::StatsType::Min];
+        double max = stats[CARTA::StatsType::Max];
+
+        stats[CARTA::StatsType::NumPixels] = num_pixels;
+        stats[CARTA::StatsType::Mean] = sum / num_pixels;
+        stats[CARTA::StatsType::Sigma] = sqrt((sum_sq - (sum * sum / num_pixels)) / (num_pixels - 1));
+        stats[CARTA::StatsType::RMS] = sqrt(sum_sq / num_pixels);
+        stats[CARTA::StatsType::Extrema] = (abs(min) > abs(max) ? min : max);
+        if (!std::isnan(beam_area)) {
+            stats[CARTA::StatsType::FluxDensity] = sum / beam_area;
+        }
+
+        image_stats.full = true;
+    }
+    image_stats.valid = true;
+}
+
+void FileLoader::SetUpLazyChannelStats(bool full, bool load_percentiles) {
+    // Only the dataset shapes are read; the channel axis is followed by the stokes axis in 4D images
+    auto channel_shape = [&](size_t length) {
+        IPos shape(_num_dims == 3 ? IPos(1, _depth) : IPos(2, _depth, _num_stokes));
+        return (length > 0) ? IPos(1, length).concatenate(shape) : shape;
+    };
+
+    _lazy_z_stats_full = full;
+    _lazy_z_stats_beam_area = CalculateBeamArea();
+    _lazy_z_stats_datasets.clear();
+    std::vector<FileInfo::Data> datasets = {FileInfo::Data::STATS_2D_MAX, FileInfo::Data::STATS_2D_MIN, FileInfo::Data::STATS_2D_NANS};
+    if (full) {
+        datasets.push_back(FileInfo::Data::STATS_2D_SUM);
+        datasets.push_back(FileInfo::Data::STATS_2D_SUMSQ);
+    }
+    for (auto ds : datasets) {
+        if (HasData(ds) && GetStatsDataShape(ds).isEqual(channel_shape(0))) {
+            _lazy_z_stats_datasets.push_back(ds);
+        }
+    }
+
+    _lazy_z_stats_bins = 0;
+    if (HasData(FileInfo::Data::STATS_2D_HIST)) {
+        const IPos& stat_dims = GetStatsDataShape(FileInfo::Data::STATS_2D_HIST);
+        if (stat_dims.size() && stat_dims.isEqual(channel_shape(stat_dims[0]))) {
+            _lazy_z_stats_bins = stat_dims[0];
+        }
+    }
+
+    _lazy_z_stats_ranks = 0;
+    if (load_percentiles && HasData(FileInfo::Data::STATS_2D_PERCENT) && HasData(FileInfo::Data::RANKS)) {
+        size_t num_ranks = GetStatsDataShape(FileInfo::Data::RANKS)[0];
+        if (GetStatsDataShape(FileInfo::Data::STATS_2D_PERCENT).isEqual(channel_shape(num_ranks))) {
+            _lazy_z_stats_ranks = num_ranks;
+        }
+    }
+}
+
+bool FileLoader::ReadChannelStats(int stokes, int z, FileInfo::ImageStats& z_stats) {
+    auto channel_slicer = [&](size_t length) {
+        IPos start(_num_dims == 3 ? IPos(1, z) : IPos(2, z, stokes));
+        IPos count(start.size(), 1);
+        if (length > 0) {
+            start = IPos(1, 0).concatenate(start);
+            count = IPos(1, length).concatenate(count);
+        }
+        return casacore::Slicer(start, count);
+    };
+
+    try {
+        for (auto ds : _lazy_z_stats_datasets) {
+            std::unique_ptr<casacore::ArrayBase> data(GetStatsData(ds, channel_slicer(0)));
+            switch (ds) {
+                case FileInfo::Data::STATS_2D_MAX:
+                    z_stats.basic_stats[CARTA::StatsType::Max] = *static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    break;
+                case FileInfo::Data::STATS_2D_MIN:
+                    z_stats.basic_stats[CARTA::StatsType::Min] = *static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    break;
+                case FileInfo::Data::STATS_2D_SUM:
+                    z_stats.basic_stats[CARTA::StatsType::Sum] = *static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    break;
+                case FileInfo::Data::STATS_2D_SUMSQ:
+                    z_stats.basic_stats[CARTA::StatsType::SumSq] = *static_cast<casacore::Array<casacore::Float>*>(data.get())->begin();
+                    break;
+                case FileInfo::Data::STATS_2D_NANS:
+                    z_stats.basic_stats[CARTA::StatsType::NanCount] = *static_cast<casacore::Array<casacore::Int64>*>(data.get())->begin();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (_lazy_z_stats_bins > 0) {
+            std::unique_ptr<casacore::ArrayBase> data(GetStatsData(FileInfo::Data::STATS_2D_HIST, channel_slicer(_lazy_z_stats_bins)));
+            auto bins = static_cast<casacore::Array<casacore::Int64>*>(data.get());
+            z_stats.histogram_bins.assign(bins->begin(), bins->end());
+        }
+
+        if (_lazy_z_stats_ranks > 0) {
+            std::unique_ptr<casacore::ArrayBase> ranks(GetStatsData(FileInfo::Data::RANKS));
+            std::unique_ptr<casacore::ArrayBase> data(GetStatsData(FileInfo::Data::STATS_2D_PERCENT, channel_slicer(_lazy_z_stats_ranks)));
+            auto rank_values = static_cast<casacore::Array<casacore::Float>*>(ranks.get());
+            auto percentiles = static_cast<casacore::Array<casacore::Float>*>(data.get());
+            z_stats.percentile_ranks.assign(rank_values->begin(), rank_values->end());
+            z_stats.percentiles.assign(percentiles->begin(), percentiles->end());
+        }
+    } catch (const casacore::AipsError& err) {
+        spdlog::warn("Could not read the statistics of channel {} stokes {}: {}", z, stokes, err.getMesg());
+        return false;
+    }
+
+    SetDerivedStats(z_stats, _image_plane_size, _lazy_z_stats_full, _lazy_z_stats_beam_area);
+    return true;
+}
+
+FileInfo::ImageStats FileLoader::GetImageStats(int current_stokes, int z, std::mutex& image_mutex) {
+    // Stats of computed stokes are not stored
+    FileInfo::ImageStats no_stats;
+    no_stats.valid = no_stats.full = false;
+    if (!_lazy_z_stats || (z < 0)) {
+        auto stored_stats = StoredImageStats(current_stokes, z < 0 ? ALL_Z : z);
+        return stored_stats ? *stored_stats : no_stats;
+    }
+    if ((current_stokes < 0) || (current_stokes >= (int)_num_stokes) || (z >= (int)_depth)) {
+        return no_stats;
+    }
+
+    int64_t key = (int64_t)current_stokes * _depth + z;
+    std::unique_lock<std::mutex> lock(_z_stats_mutex);
+    for (auto it = _z_stats_cache.begin(); it != _z_stats_cache.end(); ++it) {
+        if (it->first == key) {
+            _z_stats_cache.splice(_z_stats_cache.begin(), _z_stats_cache, it);
+            return it->second;
+        }
+    }
+    lock.unlock();
+
+    FileInfo::ImageStats z_stats;
+    z_stats.valid = z_stats.full = false;
+    auto ulock = TimedLock(image_mutex, RequestPhase::ImageLock);
+    bool read_ok = ReadChannelStats(current_stokes, z, z_stats);
+    ulock.unlock();
+    if (!read_ok) {
+        return no_stats;
+    }
+
+    lock.lock();
+    _z_stats_cache.emplace_front(key, z_stats);
+    if (_z_stats_cache.size() > CHANNEL_STATS_CACHE_SIZE) {
+        _z_stats_cache.pop_back();
+    }
+    return z_stats;
+}
+
+FileInfo::ImageStats* FileLoader::StoredImageStats(int stokes, int z) {
+    if ((stokes < 0) || (stokes >= (int)_cube_stats.size())) {
+        return nullptr;
+    }
+    if (z == ALL_Z) {
+        return &_cube_stats[stokes];
+    }
+    if ((stokes >= (int)_z_stats.size()) || (z < 0) || (z >= (int)_z_stats[stokes].size())) {
+        return nullptr;
+    }
+    return &_z_stats[stokes][z];
+}
+
+void FileLoader::LoadStatsSidecar(const std::string& hdu, int num_bins) {
+    // Call after LoadImageStats; precomputed statistics in the file take precedence
+    if (!SidecarCache::Enabled() || _filename.empty() || HasData(FileInfo::Data::STATS) || (_z_stats.size() != _num_stokes)) {
+        return;
+    }
+
+    _stats_sidecar.reset(new StatsSidecar(_filename, hdu, _depth, _num_stokes, num_bins));
+    if (!_stats_sidecar->Open()) {
+        _stats_sidecar.reset();
+        return;
+    }
+
+    StatsSidecar::ChannelStats channel_stats;
+    for (size_t s = 0; s < _num_stokes; s++) {
+        for (size_t z = 0; z < _depth; z++) {
+            if (_stats_sidecar->Read(s, z, channel_stats)) {
+                SetChannelStats(s, z, channel_stats);
             }
         }
+        if (_stats_sidecar->ReadCube(s, channel_stats)) {
+            SetChannelStats(s, ALL_Z, channel_stats);
+        }
     }
 }
 
-FileInfo::ImageStats& FileLoader::GetImageStats(int current_stokes, int z) {
-    return (z >= 0 ? _z_stats[current_stokes][z] : _cube_stats[current_stokes]);
+void FileLoader::SaveImageStats(int stokes, int z, const BasicStats<float>& stats, const Histogram& histogram) {
+    // Add channel (or cube, for ALL_Z) stats calculated by the frame to the sidecar, for the histogram size it was opened with
+    if (!_stats_sidecar || (stokes < 0) || (stokes >= (int)_num_stokes) || ((z < 0) && (z != ALL_Z)) ||
+        (histogram.GetNbins() != _stats_sidecar->NumBins()) || !StoredImageStats(stokes, z) || StoredImageStats(stokes, z)->valid) {
+        return;
+    }
+
+    StatsSidecar::ChannelStats channel_stats;
+    channel_stats.num_pixels = stats.num_pixels;
+    channel_stats.sum = stats.sum;
+    channel_stats.sum_sq = stats.sumSq;
+    channel_stats.min = stats.min_val;
+    channel_stats.max = stats.max_val;
+    channel_stats.histogram_bins = histogram.GetHistogramBins();
+    bool written = (z == ALL_Z ? _stats_sidecar->WriteCube(stokes, channel_stats) : _stats_sidecar->Write(stokes, z, channel_stats));
+    if (written) {
+        SetChannelStats(stokes, z, channel_stats);
+    }
+}
+
+void FileLoader::SetChannelStats(int stokes, int z, const StatsSidecar::ChannelStats& channel_stats) {
+    // Fill the same basic stats as the full HDF5 statistics schema
+    auto z_stats = StoredImageStats(stokes, z);
+    if (!z_stats) {
+        return;
+    }
+    auto& stats = z_stats->basic_stats;
+    size_t num_values = (z == ALL_Z ? _image_plane_size * _depth : _image_plane_size);
+    stats[CARTA::StatsType::NanCount] = num_values - channel_stats.num_pixels;
+    stats[CARTA::StatsType::Sum] = channel_stats.sum;
+    stats[CARTA::StatsType::SumSq] = channel_stats.sum_sq;
+    stats[CARTA::StatsType::Min] = channel_stats.min;
+    stats[CARTA::StatsType::Max] = channel_stats.max;
+    SetDerivedStats(*z_stats, num_values, true, CalculateBeamArea());
+    z_stats->histogram_bins = channel_stats.histogram_bins;
+}
+
+void FileLoader::StartSpectralSidecar(const std::string& hdu, std::mutex& image_mutex) {
+    if (!SidecarCache::Enabled() || _filename.empty() || HasData(FileInfo::Data::SWIZZLED) || (_z_axis < 0) || (_depth <= 1)) {
+        return;
+    }
+
+    // Sidecar layout assumes the image is rendered on axes 0 and 1
+    std::vector<int> render_axes;
+    GetRenderAxes(render_axes);
+    IPos shape;
+    if ((render_axes[0] != 0) || (render_axes[1] != 1) || !GetShape(shape)) {
+        return;
+    }
+
+    _spectral_sidecar.reset(new SpectralSidecar(_filename, hdu, shape, _z_axis, _stokes_axis));
+    std::mutex* mutex = &image_mutex;
+    _spectral_sidecar->OpenOrGenerate([this, mutex](casacore::Array<float>& data, const casacore::Slicer& slicer) {
+        std::unique_lock<std::mutex> ulock(*mutex, std::defer_lock);
+        if (!HasConcurrentReads()) {
+            ulock.lock();
+        }
+        return GetSlice(data, slicer);
+    });
+}
+
+void FileLoader::StopSpectralSidecar() {
+    if (_spectral_sidecar) {
+        _spectral_sidecar->Stop();
+    }
+}
+
+bool FileLoader::HasSpectralData(std::mutex& image_mutex) {
+    return _spectral_sidecar && _spectral_sidecar->IsReady();
 }
 
 bool FileLoader::GetCursorSpectralData(
     std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) {
-    // Must be implemented in subclasses
-    return false;
+    // Subclasses with their own spectral data should fall back to the sidecar
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::CursorSpectral);
+    if (!FileLoader::HasSpectralData(image_mutex) ||
+        !_spectral_sidecar->GetSpectralData(data, stokes, cursor_x, count_x, cursor_y, count_y)) {
+        return false;
+    }
+    io_stats.AddBytes(data.size() * sizeof(float));
+    return true;
+}
+
+bool FileLoader::GetCursorStokesSpectra(
+    std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int cursor_x, int cursor_y, std::mutex& image_mutex) {
+    data.resize(stokes.size());
+    for (size_t i = 0; i < stokes.size(); ++i) {
+        if (!GetCursorSpectralData(data[i], stokes[i], cursor_x, 1, cursor_y, 1, image_mutex)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileLoader::CanReadSpectralTiles(std::mutex& image_mutex) {
+    return HasSpectralData(image_mutex);
+}
+
+bool FileLoader::GetSpectralTile(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) {
+    if (!_spectral_sidecar || !_spectral_sidecar->IsReady()) {
+        return false;
+    }
+    return _spectral_sidecar->GetSpectralData(data, stokes, x, count_x, y, count_y);
 }
 
 bool FileLoader::UseRegionSpectralData(const casacore::IPosition& region_shape, std::mutex& image_mutex) {
-    // Must be implemented in subclasses; should call before GetRegionSpectralData
-    return false;
+    // Should call before GetRegionSpectralData
+    if (!HasSpectralData(image_mutex)) {
+        return false;
+    }
+
+    int width = region_shape(0);
+    int height = region_shape(1);
+    int depth = _depth;
+
+    // Using the normal dataset may be faster if the region is wider than it is deep.
+    // This is an initial estimate; we need to examine casacore's algorithm in more detail.
+    if (height * depth < width) {
+        return false;
+    }
+
+    return true;
 }
 
-bool FileLoader::GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
-    const casacore::IPosition& origin, std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
+bool FileLoader::GetRegionSpectralData(int region_id, int stokes, const BitMask& mask, const casacore::IPosition& origin,
+    std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
+    // Return calculated stats if valid and complete,
+    // or return accumulated stats for the next incomplete "x" slice of swizzled data (chan vs y).
+    // Calling function should check for complete progress when x-range of region is complete
+    // Mask is 2D mask for region only
+
+    if (!HasSpectralData(image_mutex)) {
+        return false;
+    }
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::RegionSpectral);
+
+    // Check if region stats calculated
+    auto region_stats_id = FileInfo::RegionStatsId(region_id, stokes);
+    IPos mask_shape(mask.Shape());
+    if (_region_stats.count(region_stats_id) && _region_stats[region_stats_id].IsValid(origin, mask_shape) &&
+        _region_stats[region_stats_id].IsCompleted()) {
+        results = _region_stats[region_stats_id].stats;
+        progress = PROFILE_COMPLETE;
+        return true;
+    }
+
+    int width = mask_shape(0);
+    int height = mask_shape(1);
+    int depth = _depth;
+    double beam_area = CalculateBeamArea();
+    bool has_flux = !std::isnan(beam_area);
+
+    if (_region_stats.find(region_stats_id) == _region_stats.end()) { // region stats never calculated
+        _region_stats.emplace(
+            std::piecewise_construct, std::forward_as_tuple(region_id, stokes), std::forward_as_tuple(origin, mask_shape, depth, has_flux));
+    } else if (!_region_stats[region_stats_id].IsValid(origin, mask_shape)) { // region stats expired
+        _region_stats[region_stats_id].origin = origin;
+        _region_stats[region_stats_id].shape = mask_shape;
+        _region_stats[region_stats_id].completed = false;
+        _region_stats[region_stats_id].latest_x = 0;
+    }
+
+    int x_min = origin(0);
+    int y_min = origin(1);
+
+    auto& stats = _region_stats[region_stats_id].stats;
+    auto& num_pixels = stats[CARTA::StatsType::NumPixels];
+    auto& nan_count = stats[CARTA::StatsType::NanCount];
+    auto& sum = stats[CARTA::StatsType::Sum];
+    auto& mean = stats[CARTA::StatsType::Mean];
+    auto& rms = stats[CARTA::StatsType::RMS];
+    auto& sigma = stats[CARTA::StatsType::Sigma];
+    auto& sum_sq = stats[CARTA::StatsType::SumSq];
+    auto& min = stats[CARTA::StatsType::Min];
+    auto& max = stats[CARTA::StatsType::Max];
+    auto& extrema = stats[CARTA::StatsType::Extrema];
+    double* flux = has_flux ? stats[CARTA::StatsType::FluxDensity].data() : nullptr;
+
+    // get the start of X
+    size_t x_start = _region_stats[region_stats_id].latest_x;
+
+    // Set initial values of stats, or those set to NAN in previous iterations
+    for (size_t z = 0; z < depth; z++) {
+        if ((x_start == 0) || (num_pixels[z] == 0)) {
+            min[z] = std::numeric_limits<float>::max();
+            max[z] = std::numeric_limits<float>::lowest();
+            num_pixels[z] = 0;
+            nan_count[z] = 0;
+            sum[z] = 0;
+            sum_sq[z] = 0;
+        }
+    }
+
+    // Lambda to calculate additional stats
+    auto calculate_stats = [&]() {
+        double sum_z, sum_sq_z;
+        uint64_t num_pixels_z;
+
+        for (size_t z = 0; z < depth; z++) {
+            if (num_pixels[z]) {
+                sum_z = sum[z];
+                sum_sq_z = sum_sq[z];
+                num_pixels_z = num_pixels[z];
+
+                mean[z] = sum_z / num_pixels_z;
+                rms[z] = sqrt(sum_sq_z / num_pixels_z);
+                sigma[z] = num_pixels_z > 1 ? sqrt((sum_sq_z - (sum_z * sum_z / num_pixels_z)) / (num_pixels_z - 1)) : 0;
+                extrema[z] = (abs(min[z]) > abs(max[z]) ? min[z] : max[z]);
+
+                if (has_flux) {
+                    flux[z] = sum_z / beam_area;
+                }
+            } else {
+                // if there are no valid values, set all stats to NaN except the value and NaN counts
+                for (auto& kv : stats) {
+                    switch (kv.first) {
+                        case CARTA::StatsType::NanCount:
+                        case CARTA::StatsType::NumPixels:
+                            break;
+                        default:
+                            kv.second[z] = NAN;
+                            break;
+                    }
+                }
+            }
+        }
+    };
+
+    size_t delta_x = INIT_DELTA_Z; // since data is swizzled, third axis is x not z
+    size_t max_x = x_start + delta_x;
+    if (max_x > width) {
+        max_x = width;
+    }
+    std::vector<float> slice_data;
+
+    for (size_t x = x_start; x < max_x; ++x) {
+        if (!GetCursorSpectralData(slice_data, stokes, x + x_min, 1, y_min, height, image_mutex)) {
+            return false;
+        }
+        io_stats.AddBytes(slice_data.size() * sizeof(float));
+
+        for (size_t y = 0; y < height; y++) {
+            // skip all Z values for masked pixels
+            if (!mask.Get(y * width + x)) {
+                continue;
+            }
+
+            for (size_t z = 0; z < depth; z++) {
+                double v = slice_data[y * depth + z];
+
+                // skip all NaN pixels
+                if (std::isfinite(v)) {
+                    num_pixels[z] += 1;
+                    sum[z] += v;
+                    sum_sq[z] += v * v;
+                    min[z] = std::min(min[z], v);
+                    max[z] = std::max(max[z], v);
+                }
+            }
+        }
+    }
+
+    // Calculate partial stats
+    calculate_stats();
+
+    results = _region_stats[region_stats_id].stats;
+    if (max_x == width) {
+        progress = PROFILE_COMPLETE;
+    } else {
+        progress = (float)max_x / width;
+    }
+
+    // Update starting x for next time
+    _region_stats[region_stats_id].latest_x = max_x;
+
+    if (progress >= PROFILE_COMPLETE) {
+        // the stats calculation is completed
+        _region_stats[region_stats_id].completed = true;
+    }
+
+    return true;
+}
+
+
+bool FileLoader::HasMip(int mip) const {
     // Must be implemented in subclasses
     return false;
 }
 
+bool FileLoader::GetMipData(
+    std::vector<float>& data, int mip, int x, int y, int width, int height, int z, int stokes, std::mutex& image_mutex) {
+    // Must be implemented in subclasses; should call HasMip first
+    return false;
+}
+
 std::string FileLoader::GetFileName() {
     return _filename;
 }
@@ -7,7 +7,9 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_FILELOADER_H_
 #define CARTA_BACKEND_IMAGEDATA_FILELOADER_H_
 
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include <casacore/images/Images/ImageInterface.h>
@@ -16,7 +18,13 @@
 #include <carta-protobuf/defs.pb.h>
 #include <carta-protobuf/enums.pb.h>
 
+#include "../ImageStats/BasicStatsCalculator.h"
+#include "../ImageStats/BitMask.h"
+#include "../ImageStats/Histogram.h"
 #include "../Util.h"
+#include "LoaderIoStats.h"
+#include "SpectralSidecar.h"
+#include "StatsSidecar.h"
 
 class Frame;
 
@@ -113,6 +121,8 @@ enum class Data : uint32_t {
     STATS_3D_NANS,
     STATS_3D_HIST,
     STATS_3D_PERCENT,
+    // Downsampled copies of the main dataset, one per mip level
+    MIP,
     // Mask
     MASK
 };
@@ -148,6 +158,9 @@ public:
 
     // Return the opened casacore image
     virtual ImageRef GetImage() = 0;
+    // Complete the image misc info for loaders which read only the headers needed for the image setup when opened; call before
+    // using the full header (file info, export, derived images)
+    virtual void LoadDeferredHeaders();
 
     // read beam subtable
     bool GetBeams(std::vector<CARTA::Beam>& beams, std::string& error);
@@ -162,8 +175,17 @@ public:
     // Image Data
     // Check to see if the file has a particular HDU/group/table/etc
     virtual bool HasData(FileInfo::Data ds) const = 0;
-    // Slice image data (with mask applied)
-    bool GetSlice(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    // Slice image data (with mask applied); a computed stokes index at the stokes axis gives the computed plane
+    virtual bool GetSlice(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    // Read a slice of the lattice, NaN where masked, into data: a SHARE array over a caller buffer of the slice shape keeps its
+    // storage, so that there is no intermediate copy
+    static void ReadLatticeSlice(casacore::MaskedLattice<float>& lattice, casacore::Array<float>& data, const casacore::Slicer& slicer);
+    // Whether GetSlice may be called from several threads at once without the image mutex
+    virtual bool HasConcurrentReads() const;
+    // Hint of the access pattern of the reads which follow, for loaders with a tile cache: the shape is that of one read, the
+    // bounding box of a region, or the extent of the spectra of a moment traversal
+    enum class ReadPattern { Plane, Spectrum, Region, Moments };
+    virtual void SetReadPattern(ReadPattern pattern, const IPos& read_shape);
 
     // SubImage
     bool GetSubImage(const casacore::Slicer& slicer, casacore::SubImage<float>& sub_image);
@@ -171,32 +193,63 @@ public:
     bool GetSubImage(const casacore::Slicer& slicer, const casacore::LattRegionHolder& region, casacore::SubImage<float>& sub_image);
 
     // Image Statistics
-    // Load image statistics, if they exist, from the file
+    // Load image statistics, if they exist, from the file. Channel statistics of cubes are read later, for each channel used.
     virtual void LoadImageStats(bool load_percentiles = false);
-    // Retrieve stats for a particular channel or all channels
-    virtual FileInfo::ImageStats& GetImageStats(int current_stokes, int channel);
+    // Retrieve stats for a particular channel or all channels; channel stats may be read from the file, with the image mutex
+    virtual FileInfo::ImageStats GetImageStats(int current_stokes, int channel, std::mutex& image_mutex);
+    // Channel stats and histograms in the sidecar cache, for images without precomputed statistics
+    void LoadStatsSidecar(const std::string& hdu, int num_bins);
+    void SaveImageStats(int stokes, int z, const BasicStats<float>& stats, const Histogram& histogram);
+    // Beam area in pixels for basic flux density calculation, NaN without a single beam
+    double CalculateBeamArea();
 
     // Spectral profiles for cursor and region
     virtual bool GetCursorSpectralData(
         std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex);
+    // Spectra of the cursor pixel for each of the stokes, in the order given; one read where the format allows it
+    virtual bool GetCursorStokesSpectra(std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int cursor_x, int cursor_y,
+        std::mutex& image_mutex);
     // Check if one can apply swizzled data under such image format and region condition
     virtual bool UseRegionSpectralData(const casacore::IPosition& region_shape, std::mutex& image_mutex);
-    virtual bool GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask,
-        const casacore::IPosition& origin, std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results,
-        float& progress);
+    virtual bool GetRegionSpectralData(int region_id, int stokes, const BitMask& mask, const casacore::IPosition& origin,
+        std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress);
+
+    // Spectra of a block of pixels, from swizzled data or the sidecar, with z fastest then y then x. The caller holds the image mutex.
+    bool CanReadSpectralTiles(std::mutex& image_mutex);
+    virtual bool GetSpectralTile(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y);
+
+    // Spectral-major sidecar file for images without swizzled data; stop before the image is closed
+    void StartSpectralSidecar(const std::string& hdu, std::mutex& image_mutex);
+    virtual void StopSpectralSidecar();
+
+    // Precomputed mean-downsampled data; x, y, width and height are in downsampled pixels
+    virtual bool HasMip(int mip) const;
+    virtual bool GetMipData(std::vector<float>& data, int mip, int x, int y, int width, int height, int z, int stokes,
+        std::mutex& image_mutex);
 
     // Get the full name of image file
     virtual std::string GetFileName();
+    LoaderIoStats& IoStats() {
+        return _io_stats;
+    }
 
     // Handle stokes type index
     virtual void SetFirstStokesType(int stokes_value);
     virtual void SetDeltaStokesIndex(int delta_stokes_index);
     virtual bool GetStokesTypeIndex(const CARTA::StokesType& stokes_type, int& stokes_index);
+    // Whether the image has the stokes planes of a computed stokes (see ComputedStokes.h)
+    bool HasComputedStokes(int stokes);
 
 protected:
     // Full name of the image file
     std::string _filename;
 
+    // Image is a concatenation of separate images along the stokes axis, which can be read concurrently
+    bool _parallel_stokes_slices;
+
+    // Reads of the loader, for the metrics
+    LoaderIoStats _io_stats;
+
     // Axes, dimension values
     size_t _num_dims, _image_plane_size;
     size_t _depth, _num_stokes;
@@ -207,6 +260,21 @@ protected:
     std::vector<std::vector<carta::FileInfo::ImageStats>> _z_stats;
     std::vector<carta::FileInfo::ImageStats> _cube_stats;
 
+    // Channel statistics read on demand instead of stored in _z_stats: the basic stats datasets with the expected shape, histogram
+    // bins and percentile ranks (0 if not read), and the most recently used channels, keyed by stokes * depth + z
+    bool _lazy_z_stats;
+    bool _lazy_z_stats_full;
+    double _lazy_z_stats_beam_area;
+    std::vector<FileInfo::Data> _lazy_z_stats_datasets;
+    size_t _lazy_z_stats_bins, _lazy_z_stats_ranks;
+    std::list<std::pair<int64_t, FileInfo::ImageStats>> _z_stats_cache; // most recently used at the front
+    std::mutex _z_stats_mutex;
+
+    // Region spectral stats accumulated from spectral data, see GetRegionSpectralData
+    std::map<FileInfo::RegionStatsId, FileInfo::RegionSpectralStats> _region_stats;
+    std::unique_ptr<SpectralSidecar> _spectral_sidecar;
+    std::unique_ptr<StatsSidecar> _stats_sidecar;
+
     // Storage for the stokes type vs. stokes index
     std::unordered_map<CARTA::StokesType, int> _stokes_indices;
     int _delta_stokes_index;
@@ -216,6 +284,8 @@ protected:
 
     // Return stats data as a casacore::Array of type casacore::Float or casacore::Int64
     virtual casacore::ArrayBase* GetStatsData(FileInfo::Data ds);
+    // The same for a slice of a (non-scalar) dataset
+    virtual casacore::ArrayBase* GetStatsData(FileInfo::Data ds, const casacore::Slicer& slicer);
 
     // Functions for loading individual types of statistics
     virtual void LoadStats2DBasic(FileInfo::Data ds);
@@ -224,9 +294,24 @@ protected:
     virtual void LoadStats3DBasic(FileInfo::Data ds);
     virtual void LoadStats3DHist();
     virtual void LoadStats3DPercent();
-
-    // Basic flux density calculation
-    double CalculateBeamArea();
+    void SetChannelStats(int stokes, int z, const StatsSidecar::ChannelStats& channel_stats);
+    // Statistics stored for the channel (or the cube, for ALL_Z), or nullptr
+    FileInfo::ImageStats* StoredImageStats(int stokes, int z);
+    // Stats calculated from the count, sums, min and max of the full schema; marks the stats valid
+    void SetDerivedStats(FileInfo::ImageStats& image_stats, size_t num_values, bool full, double beam_area);
+    // On-demand channel statistics: the datasets to read, then the statistics of one channel (the caller holds the image mutex)
+    void SetUpLazyChannelStats(bool full, bool load_percentiles);
+    bool ReadChannelStats(int stokes, int z, FileInfo::ImageStats& z_stats);
+
+    // Shape of a slice in the histogram of read shapes
+    SliceShape GetSliceShape(const IPos& length) const;
+    // Slice image data without splitting by stokes
+    bool ReadSlice(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    bool GetStokesSlices(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    // Computed stokes of the slice from one read of the range of its component stokes
+    bool GetComputedStokesSlice(casacore::Array<float>& data, const casacore::Slicer& slicer);
+    // Whether spectral data is available for GetCursorSpectralData
+    virtual bool HasSpectralData(std::mutex& image_mutex);
 };
 
 } // namespace carta
@@ -7,6 +7,9 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_FITSLOADER_H_
 #define CARTA_BACKEND_IMAGEDATA_FITSLOADER_H_
 
+#include <mutex>
+#include <vector>
+
 #include <casacore/images/Images/FITSImage.h>
 
 #include "CartaFitsImage.h"
@@ -22,14 +25,33 @@ public:
 
     bool HasData(FileInfo::Data ds) const override;
     ImageRef GetImage() override;
+    bool HasConcurrentReads() const override;
+
+    bool GetCursorSpectralData(
+        std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) override;
 
 private:
     bool _is_compressed;
     casacore::uInt _hdu;
     std::unique_ptr<casacore::ImageInterface<float>> _image;
+    bool _concurrent_reads;
+
+    // Spectra for the box of pixels around the last cursor, z slowest
+    std::mutex _cursor_box_mutex;
+    std::vector<float> _cursor_box_data;
+    int _cursor_box_x, _cursor_box_y, _cursor_box_width, _cursor_box_height, _cursor_box_stokes;
 };
 
-FitsLoader::FitsLoader(const std::string& filename, bool is_compressed) : FileLoader(filename), _is_compressed(is_compressed), _hdu(-1) {}
+FitsLoader::FitsLoader(const std::string& filename, bool is_compressed)
+    : FileLoader(filename),
+      _is_compressed(is_compressed),
+      _hdu(-1),
+      _concurrent_reads(false),
+      _cursor_box_x(-1),
+      _cursor_box_y(-1),
+      _cursor_box_width(0),
+      _cursor_box_height(0),
+      _cursor_box_stokes(-1) {}
 
 void FitsLoader::OpenFile(const std::string& hdu) {
     // Convert string to FITS hdu number
@@ -40,12 +62,14 @@ void FitsLoader::OpenFile(const std::string& hdu) {
             throw(casacore::AipsError("Compressed FITS gz/bz format not supported yet."));
         }
 
+        _concurrent_reads = false;
         try {
             _image.reset(new casacore::FITSImage(_filename, 0, hdu_num));
         } catch (const casacore::AipsError& err) {
             try {
                 // casacore::FITSImage failed, try CartaFitsImage
                 _image.reset(new carta::CartaFitsImage(_filename, hdu_num));
+                _concurrent_reads = true; // reads use a pool of cfitsio handles
             } catch (const casacore::AipsError& err) {
                 spdlog::error(err.getMesg());
             }
@@ -57,6 +81,10 @@ void FitsLoader::OpenFile(const std::string& hdu) {
 
         _hdu = hdu_num;
         _num_dims = _image->shape().size();
+
+        std::lock_guard<std::mutex> guard(_cursor_box_mutex);
+        _cursor_box_data.clear();
+        _cursor_box_stokes = -1;
     }
 }
 
@@ -82,6 +110,77 @@ typename FitsLoader::ImageRef FitsLoader::GetImage() {
     return _image.get(); // nullptr if image not opened
 }
 
+bool FitsLoader::HasConcurrentReads() const {
+    return _concurrent_reads;
+}
+
+bool FitsLoader::GetCursorSpectralData(
+    std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) {
+    // Use the spectral sidecar if it is ready
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::CursorSpectral);
+    if (FileLoader::GetCursorSpectralData(data, stokes, cursor_x, count_x, cursor_y, count_y, image_mutex)) {
+        io_stats.AddBytes(data.size() * sizeof(float));
+        return true;
+    }
+
+    // Reading one pixel per channel makes a tiny read for each channel, so read the spectra for a box of pixels
+    // around the cursor in one call, and keep them for the next cursor position nearby.
+    if (!_image || (count_x != 1) || (count_y != 1) || (_z_axis < 0) || (_render_axes.size() < 2) || (_render_axes[0] != 0) ||
+        (_render_axes[1] != 1)) {
+        return false;
+    }
+
+    IPos shape = _image->shape();
+    if ((cursor_x < 0) || (cursor_y < 0) || (cursor_x >= shape(0)) || (cursor_y >= shape(1)) || (stokes < 0) ||
+        (stokes >= (int)_num_stokes)) {
+        return false;
+    }
+
+    int box_x = (cursor_x / FITS_CURSOR_BOX_SIZE) * FITS_CURSOR_BOX_SIZE;
+    int box_y = (cursor_y / FITS_CURSOR_BOX_SIZE) * FITS_CURSOR_BOX_SIZE;
+
+    std::lock_guard<std::mutex> guard(_cursor_box_mutex);
+    if ((box_x != _cursor_box_x) || (box_y != _cursor_box_y) || (stokes != _cursor_box_stokes) || _cursor_box_data.empty()) {
+        IPos start(shape.size(), 0);
+        IPos count(shape);
+        start(0) = box_x;
+        start(1) = box_y;
+        count(0) = std::min<int>(FITS_CURSOR_BOX_SIZE, shape(0) - box_x);
+        count(1) = std::min<int>(FITS_CURSOR_BOX_SIZE, shape(1) - box_y);
+        if (_stokes_axis >= 0) {
+            start(_stokes_axis) = stokes;
+            count(_stokes_axis) = 1;
+        }
+
+        _cursor_box_data.resize(count.product());
+        casacore::Array<float> tmp(count, _cursor_box_data.data(), casacore::StorageInitPolicy::SHARE);
+        std::unique_lock<std::mutex> ulock(image_mutex, std::defer_lock);
+        if (!HasConcurrentReads()) {
+            ulock.lock();
+        }
+        if (!GetSlice(tmp, casacore::Slicer(start, count))) {
+            _cursor_box_data.clear();
+            return false;
+        }
+
+        _cursor_box_x = box_x;
+        _cursor_box_y = box_y;
+        _cursor_box_width = count(0);
+        _cursor_box_height = count(1);
+        _cursor_box_stokes = stokes;
+    }
+
+    // A unit stokes axis does not change the layout, x fastest then y then z
+    size_t plane_size = _cursor_box_width * _cursor_box_height;
+    size_t offset = (cursor_x - _cursor_box_x) + _cursor_box_width * (cursor_y - _cursor_box_y);
+    data.resize(_depth);
+    for (size_t z = 0; z < _depth; ++z) {
+        data[z] = _cursor_box_data[offset + plane_size * z];
+    }
+    io_stats.AddBytes(data.size() * sizeof(float));
+    return true;
+}
+
 } // namespace carta
 
 #endif // CARTA_BACKEND_IMAGEDATA_FITSLOADER_H_
@@ -8,13 +8,21 @@
 #include "Hdf5Attributes.h"
 
 #include <cstring>
+#include <limits>
 
 #include <spdlog/fmt/fmt.h>
 
 #include <casacore/casa/HDF5/HDF5DataType.h>
 #include <casacore/casa/HDF5/HDF5Error.h>
 
-casacore::Vector<casacore::String> Hdf5Attributes::ReadAttributes(hid_t group_hid) {
+// Prefixes of the keywords used by the coordinate system, units, image info and HDF5 schema info
+static const std::vector<std::string> COORDINATE_KEYWORD_PREFIXES = {"SIMPLE", "BITPIX", "EXTEND", "NAXIS", "WCSAXES", "WCSNAME", "CTYPE",
+    "CRVAL", "CDELT", "CRPIX", "CUNIT", "CROTA", "CRDER", "CSYER", "CNAME", "PC", "CD", "PV", "PS", "LONPOLE", "LATPOLE", "EQUINOX",
+    "EPOCH", "RADESYS", "RADECSYS", "RESTFRQ", "RESTFREQ", "RESTWAV", "SPECSYS", "SSYSOBS", "SSYSSRC", "VELOSYS", "VELREF", "ZSOURCE",
+    "ALTR", "DATE", "MJD", "TIMESYS", "OBSGEO", "OBSRA", "OBSDEC", "TELESCOP", "OBSERVER", "OBJECT", "BUNIT", "BTYPE", "BMAJ", "BMIN",
+    "BPA", "CASAMBM", "SCHEMA_VERSION", "HDF5_CONVERTER"};
+
+casacore::Vector<casacore::String> Hdf5Attributes::ReadAttributes(hid_t group_hid, std::vector<int>* deferred) {
     // Reads attributes into FITS-format "name = value" strings
     char cname[512];
     // Iterate through the attributes in order of index, so we're sure they are read back in the same order as written.
@@ -28,6 +36,12 @@ casacore::Vector<casacore::String> Hdf5Attributes::ReadAttributes(hid_t group_hi
         unsigned int name_size = H5Aget_name(id, sizeof(cname), cname);
         AlwaysAssert(name_size < sizeof(cname), casacore::AipsError);
         std::string name(cname);
+        if (deferred && !IsCoordinateKeyword(name)) {
+            // Decoded later by ReadRecord
+            deferred->push_back(index);
+            H5Aclose(id);
+            continue;
+        }
         // Get rank and shape from the dataspace info.
         casacore::HDF5HidDataSpace dsid(H5Aget_space(id));
         int rank = H5Sget_simple_extent_ndims(dsid);
@@ -48,6 +62,81 @@ casacore::Vector<casacore::String> Hdf5Attributes::ReadAttributes(hid_t group_hi
     return headers;
 }
 
+void Hdf5Attributes::ReadRecord(hid_t group_hid, const std::vector<int>& indices, casacore::RecordInterface& header_rec) {
+    // Each attribute is a subrecord with its value, named by the lowercase attribute name
+    char cname[512];
+    for (int index : indices) {
+        casacore::HDF5HidAttribute id(H5Aopen_idx(group_hid, index));
+        if (id.getHid() < 0) {
+            continue;
+        }
+        unsigned int name_size = H5Aget_name(id, sizeof(cname), cname);
+        casacore::HDF5HidDataSpace dsid(H5Aget_space(id));
+        if ((name_size >= sizeof(cname)) || (H5Sget_simple_extent_ndims(dsid) != 0)) {
+            H5Aclose(id);
+            continue;
+        }
+        casacore::String name(cname);
+        name.downcase();
+
+        casacore::Record sub_record;
+        casacore::HDF5HidDataType dtid(H5Aget_type(id));
+        int sz = H5Tget_size(dtid);
+        switch (H5Tget_class(dtid)) {
+            case H5T_INTEGER: {
+                if ((sz == 1) && (H5Tget_sign(dtid) == H5T_SGN_NONE)) {
+                    casacore::Bool value;
+                    casacore::HDF5DataType data_type((casacore::Bool*)0);
+                    H5Aread(id, data_type.getHidMem(), &value);
+                    sub_record.define("value", value);
+                } else {
+                    casacore::Int64 value;
+                    casacore::HDF5DataType data_type((casacore::Int64*)0);
+                    H5Aread(id, data_type.getHidMem(), &value);
+                    if ((value >= std::numeric_limits<casacore::Int>::min()) && (value <= std::numeric_limits<casacore::Int>::max())) {
+                        sub_record.define("value", (casacore::Int)value);
+                    } else {
+                        sub_record.define("value", value);
+                    }
+                }
+                break;
+            }
+            case H5T_FLOAT: {
+                casacore::Double value;
+                casacore::HDF5DataType data_type((casacore::Double*)0);
+                H5Aread(id, data_type.getHidMem(), &value);
+                sub_record.define("value", value);
+                break;
+            }
+            case H5T_STRING: {
+                casacore::String value;
+                value.resize(sz + 1);
+                casacore::HDF5DataType data_type(value);
+                H5Aread(id, data_type.getHidMem(), const_cast<char*>(value.c_str()));
+                value.resize(std::strlen(value.c_str()));
+                sub_record.define("value", value);
+                break;
+            }
+            default:
+                break;
+        }
+        H5Aclose(id);
+
+        if (sub_record.isDefined("value") && !header_rec.isDefined(name)) {
+            header_rec.defineRecord(name, sub_record);
+        }
+    }
+}
+
+bool Hdf5Attributes::IsCoordinateKeyword(const std::string& name) {
+    for (auto& prefix : COORDINATE_KEYWORD_PREFIXES) {
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::string Hdf5Attributes::ReadScalar(hid_t attr_id, hid_t data_type_id, const std::string& name) {
     // Handle a scalar field.
     int sz = H5Tget_size(data_type_id);
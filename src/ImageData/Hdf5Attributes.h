@@ -10,15 +10,22 @@
 
 #pragma once
 
+#include <vector>
+
 #include <casacore/casa/Containers/Record.h>
 #include <casacore/casa/HDF5/HDF5HidMeta.h>
 
 class Hdf5Attributes {
 public:
     // casacore::HDF5Record::doReadRecord modified to not iterate through links
-    static casacore::Vector<casacore::String> ReadAttributes(hid_t group_hid);
+    // If deferred is set, only the attributes used to set up the image coordinates, units and info are read; the indices of the
+    // others are added to deferred, to be read with ReadRecord when the full header is needed.
+    static casacore::Vector<casacore::String> ReadAttributes(hid_t group_hid, std::vector<int>* deferred = nullptr);
+    // Read the scalar attributes at the indices into header_rec, as the unused headers record of the FITS coordinate conversion
+    static void ReadRecord(hid_t group_hid, const std::vector<int>& indices, casacore::RecordInterface& header_rec);
 
 private:
+    static bool IsCoordinateKeyword(const std::string& name);
     // Read a scalar value (int, float, string) and add it to the record.
     static std::string ReadScalar(hid_t attr_id, hid_t data_type_id, const std::string& name);
 };
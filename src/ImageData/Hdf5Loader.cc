@@ -6,10 +6,17 @@
 
 #include "Hdf5Loader.h"
 
+#include <algorithm>
+#include <memory>
+
 #include "../Logger/Logger.h"
+#include "../Metrics.h"
+#include "../Timer/SlowRequestLog.h"
 
 namespace carta {
 
+int Hdf5Loader::_chunk_cache_mb = HDF5_CHUNK_CACHE_MB;
+
 Hdf5Loader::Hdf5Loader(const std::string& filename) : FileLoader(filename), _hdu("0") {}
 
 void Hdf5Loader::OpenFile(const std::string& hdu) {
@@ -28,12 +35,29 @@ void Hdf5Loader::OpenFile(const std::string& hdu) {
         // We need this immediately because dataSetToString uses it to find the name of the swizzled dataset
         _num_dims = _image->shape().size();
 
+        // Image plane reads (FillImageCache, tiles)
+        IPos image_shape = _image->shape();
+        IPos plane_shape(_num_dims, 1);
+        plane_shape(0) = image_shape(0);
+        plane_shape(1) = image_shape(1);
+        casacore::HDF5Lattice<float> image_lattice = _image->Lattice(); // shares the dataset
+        SetChunkCache(image_lattice, plane_shape);
+
         // Load swizzled image lattice
         if (HasData(FileInfo::Data::SWIZZLED)) {
             _swizzled_image = std::unique_ptr<casacore::HDF5Lattice<float>>(
                 new casacore::HDF5Lattice<float>(casacore::CountedPtr<casacore::HDF5File>(new casacore::HDF5File(_filename)),
                     DataSetToString(FileInfo::Data::SWIZZLED), selected_hdu));
+
+            // Spectral reads of a column of y for one x (cursor and region spectral profiles)
+            IPos swizzled_shape = _swizzled_image->shape();
+            IPos column_shape(_num_dims, 1);
+            column_shape(0) = swizzled_shape(0);
+            column_shape(1) = swizzled_shape(1);
+            SetChunkCache(*_swizzled_image, column_shape);
         }
+
+        LoadMipMaps();
     }
 }
 
@@ -51,6 +75,8 @@ bool Hdf5Loader::HasData(FileInfo::Data ds) const {
             return _num_dims >= 4;
         case FileInfo::Data::MASK:
             return ((_image != nullptr) && _image->hasPixelMask());
+        case FileInfo::Data::MIP:
+            return !_mipmaps.empty();
         default:
             auto group_ptr = _image->Group();
             std::string data(DataSetToString(ds));
@@ -67,12 +93,115 @@ typename Hdf5Loader::ImageRef Hdf5Loader::GetImage() {
     return _image.get();
 }
 
+void Hdf5Loader::LoadDeferredHeaders() {
+    if (_image) {
+        _image->LoadDeferredHeaders();
+    }
+}
+
 casacore::Lattice<float>* Hdf5Loader::LoadSwizzledData() {
     // swizzled data returns a Lattice
     return _swizzled_image.get();
 }
 
-std::string Hdf5Loader::DataSetToString(FileInfo::Data ds) const {
+void Hdf5Loader::SetChunkCache(casacore::HDF5Lattice<float>& lattice, const IPos& read_shape) {
+    if (_chunk_cache_mb <= 0) {
+        return;
+    }
+
+    IPos chunk_shape = lattice.tileShape();
+    if (chunk_shape.size() != read_shape.size()) {
+        return;
+    }
+
+    size_t num_chunks(1);
+    for (size_t i = 0; i < read_shape.size(); ++i) {
+        num_chunks *= (read_shape(i) + chunk_shape(i) - 1) / chunk_shape(i);
+    }
+
+    size_t chunk_size = sizeof(float) * chunk_shape.product();
+    size_t max_chunks = std::max((size_t)1, ((size_t)_chunk_cache_mb * 1024 * 1024) / chunk_size);
+    num_chunks = std::min(num_chunks, max_chunks);
+
+    lattice.setCacheSizeInTiles(num_chunks);
+    spdlog::debug("HDF5 chunk cache for {}: {} chunks of shape {}", lattice.name(true), num_chunks, chunk_shape.toString());
+}
+
+void Hdf5Loader::LoadMipMaps() {
+    // Open the mipmap datasets written by the converter, for mips 2, 4, 8, ... until one is missing
+    _mipmaps.clear();
+    auto group_ptr = _image->Group();
+    if (!casacore::HDF5Group::exists(*group_ptr, "MipMaps") || !casacore::HDF5Group::exists(*group_ptr, "MipMaps/DATA")) {
+        return;
+    }
+
+    IPos image_shape = _image->shape();
+    for (int mip = 2;; mip *= 2) {
+        std::string data_set = DataSetToString(FileInfo::Data::MIP, mip);
+        if (!casacore::HDF5Group::exists(*group_ptr, data_set)) {
+            break;
+        }
+
+        auto mipmap = std::make_unique<casacore::HDF5Lattice<float>>(
+            casacore::CountedPtr<casacore::HDF5File>(new casacore::HDF5File(_filename)), data_set, _hdu);
+        IPos mip_shape = mipmap->shape();
+        if ((mip_shape.size() != _num_dims) || (mip_shape(0) != (image_shape(0) + mip - 1) / mip) ||
+            (mip_shape(1) != (image_shape(1) + mip - 1) / mip)) {
+            spdlog::warn("Ignoring HDF5 mipmap dataset {} with unexpected shape {}", data_set, mip_shape.toString());
+            break;
+        }
+
+        IPos plane_shape(_num_dims, 1);
+        plane_shape(0) = mip_shape(0);
+        plane_shape(1) = mip_shape(1);
+        SetChunkCache(*mipmap, plane_shape);
+        _mipmaps[mip] = std::move(mipmap);
+    }
+}
+
+bool Hdf5Loader::HasMip(int mip) const {
+    return _mipmaps.count(mip);
+}
+
+bool Hdf5Loader::GetMipData(
+    std::vector<float>& data, int mip, int x, int y, int width, int height, int z, int stokes, std::mutex& image_mutex) {
+    auto mipmap = _mipmaps.find(mip);
+    if (mipmap == _mipmaps.end()) {
+        return false;
+    }
+
+    IPos start(_num_dims, 0);
+    IPos count(_num_dims, 1);
+    start(0) = x;
+    start(1) = y;
+    count(0) = width;
+    count(1) = height;
+    if (_z_axis >= 0) {
+        start(_z_axis) = z;
+    }
+    if (_stokes_axis >= 0) {
+        start(_stokes_axis) = stokes;
+    }
+
+    casacore::Slicer slicer(start, count);
+    data.resize(width * height);
+    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
+    auto lguard = TimedLock(image_mutex, RequestPhase::ImageLock);
+    PhaseScope io_phase(RequestPhase::Io);
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::Mip);
+    io_stats.SetKey({mip, x, y, width, height, z, stokes});
+    try {
+        mipmap->second->doGetSlice(tmp, slicer);
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not load mip {} data from HDF5 mipmap dataset. AIPS ERROR: {}", mip, err.getMesg());
+        return false;
+    }
+    io_stats.AddBytes(data.size() * sizeof(float));
+    Metrics::Global().AddBytesRead(data.size() * sizeof(float));
+    return true;
+}
+
+std::string Hdf5Loader::DataSetToString(FileInfo::Data ds, int mip) const {
     static std::unordered_map<FileInfo::Data, std::string, EnumClassHash> um = {
         {FileInfo::Data::Image, "DATA"},
         {FileInfo::Data::YX, "SwizzledData/YX"},
@@ -116,6 +245,17 @@ std::string Hdf5Loader::DataSetToString(FileInfo::Data ds) const {
                 default:
                     return "";
             }
+        case FileInfo::Data::MIP:
+            switch (_num_dims) {
+                case 2:
+                    return fmt::format("MipMaps/DATA/DATA_XY_{}", mip);
+                case 3:
+                    return fmt::format("MipMaps/DATA/DATA_XYZ_{}", mip);
+                case 4:
+                    return fmt::format("MipMaps/DATA/DATA_XYZW_{}", mip);
+                default:
+                    return "";
+            }
         default:
             return (um.find(ds) != um.end()) ? um[ds] : "";
     }
@@ -169,212 +309,162 @@ casacore::ArrayBase* Hdf5Loader::GetStatsData(FileInfo::Data ds) {
     }
 }
 
+casacore::ArrayBase* Hdf5Loader::GetStatsData(FileInfo::Data ds, const casacore::Slicer& slicer) {
+    auto data_type = casacore::HDF5DataSet::getDataType(_image->Group()->getHid(), DataSetToString(ds));
+
+    switch (data_type) {
+        case casacore::TpInt: {
+            return GetStatsDataTyped<casacore::Int, casacore::Int64>(ds, slicer);
+        }
+        case casacore::TpInt64: {
+            return GetStatsDataTyped<casacore::Int64, casacore::Int64>(ds, slicer);
+        }
+        case casacore::TpFloat: {
+            return GetStatsDataTyped<casacore::Float, casacore::Float>(ds, slicer);
+        }
+        case casacore::TpDouble: {
+            return GetStatsDataTyped<casacore::Double, casacore::Float>(ds, slicer);
+        }
+        default:
+            throw casacore::HDF5Error("Dataset " + DataSetToString(ds) + " has an unsupported datatype.");
+    }
+}
+
 bool Hdf5Loader::GetCursorSpectralData(
     std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) {
-    bool data_ok(false);
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::CursorSpectral);
     std::unique_lock<std::mutex> ulock(image_mutex);
     bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
     ulock.unlock();
+    bool ok;
     if (has_swizzled) {
-        casacore::Slicer slicer;
-        if (_num_dims == 4) {
-            slicer = casacore::Slicer(IPos(4, 0, cursor_y, cursor_x, stokes), IPos(4, _depth, count_y, count_x, 1));
-        } else if (_num_dims == 3) {
-            slicer = casacore::Slicer(IPos(3, 0, cursor_y, cursor_x), IPos(3, _depth, count_y, count_x));
-        }
-
-        data.resize(_depth * count_y * count_x);
-        casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
-        std::lock_guard<std::mutex> lguard(image_mutex);
-        try {
-            LoadSwizzledData()->doGetSlice(tmp, slicer);
-            data_ok = true;
-        } catch (casacore::AipsError& err) {
-            spdlog::warn("Could not load cursor spectral data from swizzled HDF5 dataset. AIPS ERROR: {}", err.getMesg());
-        }
+        // Nearby cursor positions are usually in a cached block
+        std::call_once(_spectral_blocks_flag, [&]() { InitSpectralBlocks(image_mutex); });
+        ok = (_spectral_blocks && _spectral_blocks->GetSpectralData(data, stokes, cursor_x, count_x, cursor_y, count_y)) ||
+             ReadSwizzledData(data, stokes, 1, cursor_x, count_x, cursor_y, count_y, image_mutex);
+    } else {
+        ok = FileLoader::GetCursorSpectralData(data, stokes, cursor_x, count_x, cursor_y, count_y, image_mutex);
     }
-    return data_ok;
+    if (ok) {
+        io_stats.AddBytes(data.size() * sizeof(float));
+    }
+    return ok;
 }
 
-bool Hdf5Loader::UseRegionSpectralData(const IPos& region_shape, std::mutex& image_mutex) {
+bool Hdf5Loader::GetCursorStokesSpectra(std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int cursor_x, int cursor_y,
+    std::mutex& image_mutex) {
     std::unique_lock<std::mutex> ulock(image_mutex);
     bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
     ulock.unlock();
-    if (!has_swizzled) {
-        return false;
+    if (!has_swizzled || (stokes.size() < 2)) {
+        return FileLoader::GetCursorStokesSpectra(data, stokes, cursor_x, cursor_y, image_mutex);
     }
 
-    int width = region_shape(0);
-    int height = region_shape(1);
-    int depth = _depth;
-
-    // Using the normal dataset may be faster if the region is wider than it is deep.
-    // This is an initial estimate; we need to examine casacore's algorithm in more detail.
-    if (height * depth < width) {
-        return false;
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::CursorSpectral);
+    std::call_once(_spectral_blocks_flag, [&]() { InitSpectralBlocks(image_mutex); });
+    if (!_spectral_blocks || !_spectral_blocks->GetSpectralData(data, stokes, cursor_x, cursor_y)) {
+        // One hyperslab over the range of the stokes
+        auto stokes_range = std::minmax_element(stokes.begin(), stokes.end());
+        int min_stokes = *stokes_range.first;
+        int num_stokes = *stokes_range.second - min_stokes + 1;
+        std::vector<float> range_data;
+        if (!ReadSwizzledData(range_data, min_stokes, num_stokes, cursor_x, 1, cursor_y, 1, image_mutex)) {
+            return false;
+        }
+        data.resize(stokes.size());
+        for (size_t i = 0; i < stokes.size(); ++i) {
+            auto spectrum = range_data.begin() + (size_t)(stokes[i] - min_stokes) * _depth;
+            data[i].assign(spectrum, spectrum + _depth);
+        }
+    }
+    for (auto& spectrum : data) {
+        io_stats.AddBytes(spectrum.size() * sizeof(float));
     }
-
     return true;
 }
 
-bool Hdf5Loader::GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask, const IPos& origin,
-    std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) {
-    // Return calculated stats if valid and complete,
-    // or return accumulated stats for the next incomplete "x" slice of swizzled data (chan vs y).
-    // Calling function should check for complete progress when x-range of region is complete
-    // Mask is 2D mask for region only
-
-    std::unique_lock<std::mutex> ulock(image_mutex);
-    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
-    ulock.unlock();
-    if (!has_swizzled) {
-        return false;
-    }
+void Hdf5Loader::StopSpectralSidecar() {
+    _spectral_blocks.reset();
+    FileLoader::StopSpectralSidecar();
+}
 
-    // Check if region stats calculated
-    auto region_stats_id = FileInfo::RegionStatsId(region_id, stokes);
-    IPos mask_shape(mask.shape());
-    if (_region_stats.count(region_stats_id) && _region_stats[region_stats_id].IsValid(origin, mask_shape) &&
-        _region_stats[region_stats_id].IsCompleted()) {
-        results = _region_stats[region_stats_id].stats;
-        progress = PROFILE_COMPLETE;
-        return true;
+bool Hdf5Loader::GetSpectralTile(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) {
+    if (HasData(FileInfo::Data::SWIZZLED)) {
+        return ReadSwizzledSlice(data, stokes, 1, x, count_x, y, count_y);
     }
+    return FileLoader::GetSpectralTile(data, stokes, x, count_x, y, count_y);
+}
 
-    int width = mask_shape(0);
-    int height = mask_shape(1);
-    int depth = _depth;
-    double beam_area = CalculateBeamArea();
-    bool has_flux = !std::isnan(beam_area);
-
-    if (_region_stats.find(region_stats_id) == _region_stats.end()) { // region stats never calculated
-        _region_stats.emplace(
-            std::piecewise_construct, std::forward_as_tuple(region_id, stokes), std::forward_as_tuple(origin, mask_shape, depth, has_flux));
-    } else if (!_region_stats[region_stats_id].IsValid(origin, mask_shape)) { // region stats expired
-        _region_stats[region_stats_id].origin = origin;
-        _region_stats[region_stats_id].shape = mask_shape;
-        _region_stats[region_stats_id].completed = false;
-        _region_stats[region_stats_id].latest_x = 0;
+bool Hdf5Loader::ReadSwizzledData(
+    std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y, std::mutex& image_mutex) {
+    auto lguard = TimedLock(image_mutex, RequestPhase::ImageLock);
+    PhaseScope io_phase(RequestPhase::Io);
+    LoaderIoStats::Scope io_stats(_io_stats, LoaderRead::Swizzled);
+    io_stats.SetKey({stokes, num_stokes, x, count_x, y, count_y});
+    if (!ReadSwizzledSlice(data, stokes, num_stokes, x, count_x, y, count_y)) {
+        return false;
     }
+    io_stats.AddBytes(data.size() * sizeof(float));
+    Metrics::Global().AddBytesRead(data.size() * sizeof(float));
+    return true;
+}
 
-    int x_min = origin(0);
-    int y_min = origin(1);
-
-    auto& stats = _region_stats[region_stats_id].stats;
-    auto& num_pixels = stats[CARTA::StatsType::NumPixels];
-    auto& nan_count = stats[CARTA::StatsType::NanCount];
-    auto& sum = stats[CARTA::StatsType::Sum];
-    auto& mean = stats[CARTA::StatsType::Mean];
-    auto& rms = stats[CARTA::StatsType::RMS];
-    auto& sigma = stats[CARTA::StatsType::Sigma];
-    auto& sum_sq = stats[CARTA::StatsType::SumSq];
-    auto& min = stats[CARTA::StatsType::Min];
-    auto& max = stats[CARTA::StatsType::Max];
-    auto& extrema = stats[CARTA::StatsType::Extrema];
-    double* flux = has_flux ? stats[CARTA::StatsType::FluxDensity].data() : nullptr;
-
-    // get the start of X
-    size_t x_start = _region_stats[region_stats_id].latest_x;
-
-    // Set initial values of stats, or those set to NAN in previous iterations
-    for (size_t z = 0; z < depth; z++) {
-        if ((x_start == 0) || (num_pixels[z] == 0)) {
-            min[z] = std::numeric_limits<float>::max();
-            max[z] = std::numeric_limits<float>::lowest();
-            num_pixels[z] = 0;
-            nan_count[z] = 0;
-            sum[z] = 0;
-            sum_sq[z] = 0;
-        }
+bool Hdf5Loader::ReadSwizzledSlice(std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y) {
+    casacore::Slicer slicer;
+    if (_num_dims == 4) {
+        slicer = casacore::Slicer(IPos(4, 0, y, x, stokes), IPos(4, _depth, count_y, count_x, num_stokes));
+    } else if ((_num_dims == 3) && (num_stokes == 1)) {
+        slicer = casacore::Slicer(IPos(3, 0, y, x), IPos(3, _depth, count_y, count_x));
+    } else {
+        return false;
     }
 
-    // Lambda to calculate additional stats
-    auto calculate_stats = [&]() {
-        double sum_z, sum_sq_z;
-        uint64_t num_pixels_z;
-
-        for (size_t z = 0; z < depth; z++) {
-            if (num_pixels[z]) {
-                sum_z = sum[z];
-                sum_sq_z = sum_sq[z];
-                num_pixels_z = num_pixels[z];
-
-                mean[z] = sum_z / num_pixels_z;
-                rms[z] = sqrt(sum_sq_z / num_pixels_z);
-                sigma[z] = num_pixels_z > 1 ? sqrt((sum_sq_z - (sum_z * sum_z / num_pixels_z)) / (num_pixels_z - 1)) : 0;
-                extrema[z] = (abs(min[z]) > abs(max[z]) ? min[z] : max[z]);
-
-                if (has_flux) {
-                    flux[z] = sum_z / beam_area;
-                }
-            } else {
-                // if there are no valid values, set all stats to NaN except the value and NaN counts
-                for (auto& kv : stats) {
-                    switch (kv.first) {
-                        case CARTA::StatsType::NanCount:
-                        case CARTA::StatsType::NumPixels:
-                            break;
-                        default:
-                            kv.second[z] = NAN;
-                            break;
-                    }
-                }
-            }
-        }
-    };
-
-    size_t delta_x = INIT_DELTA_Z; // since data is swizzled, third axis is x not z
-    size_t max_x = x_start + delta_x;
-    if (max_x > width) {
-        max_x = width;
+    data.resize((size_t)_depth * count_y * count_x * num_stokes);
+    casacore::Array<float> tmp(slicer.length(), data.data(), casacore::StorageInitPolicy::SHARE);
+    try {
+        LoadSwizzledData()->doGetSlice(tmp, slicer);
+        return true;
+    } catch (casacore::AipsError& err) {
+        spdlog::warn("Could not load spectral data from swizzled HDF5 dataset. AIPS ERROR: {}", err.getMesg());
     }
-    std::vector<float> slice_data;
-
-    for (size_t x = x_start; x < max_x; ++x) {
-        if (!GetCursorSpectralData(slice_data, stokes, x + x_min, 1, y_min, height, image_mutex)) {
-            return false;
-        }
-
-        for (size_t y = 0; y < height; y++) {
-            // skip all Z values for masked pixels
-            if (!mask.getAt(IPos(2, x, y))) {
-                continue;
-            }
+    return false;
+}
 
-            for (size_t z = 0; z < depth; z++) {
-                double v = slice_data[y * depth + z];
-
-                // skip all NaN pixels
-                if (std::isfinite(v)) {
-                    num_pixels[z] += 1;
-                    sum[z] += v;
-                    sum_sq[z] += v * v;
-                    min[z] = std::min(min[z], v);
-                    max[z] = std::max(max[z], v);
-                }
-            }
-        }
+void Hdf5Loader::InitSpectralBlocks(std::mutex& image_mutex) {
+    // Blocks are whole chunks of the swizzled dataset (z, y, x), and are not cached if less than two fit in the cache
+    std::unique_lock<std::mutex> ulock(image_mutex);
+    if (!_swizzled_image) {
+        return;
     }
+    IPos swizzled_shape = _swizzled_image->shape();
+    IPos chunk_shape = _swizzled_image->tileShape();
+    ulock.unlock();
 
-    // Calculate partial stats
-    calculate_stats();
-
-    results = _region_stats[region_stats_id].stats;
-    if (max_x == width) {
-        progress = PROFILE_COMPLETE;
-    } else {
-        progress = (float)max_x / width;
+    auto block_size = [](int chunk_size) {
+        chunk_size = std::max(chunk_size, 1);
+        return ((CURSOR_SPECTRAL_BLOCK_SIZE + chunk_size - 1) / chunk_size) * chunk_size;
+    };
+    int block_width = block_size(chunk_shape(2));
+    int block_height = block_size(chunk_shape(1));
+    size_t block_bytes = sizeof(float) * _depth * block_width * block_height;
+    size_t max_blocks = ((size_t)CURSOR_SPECTRAL_CACHE_MB * 1024 * 1024) / block_bytes;
+    if (max_blocks < 2) {
+        return;
     }
 
-    // Update starting x for next time
-    _region_stats[region_stats_id].latest_x = max_x;
-
-    if (progress >= PROFILE_COMPLETE) {
-        // the stats calculation is completed
-        _region_stats[region_stats_id].completed = true;
-    }
+    auto reader = [this, &image_mutex](std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y) {
+        return ReadSwizzledData(data, stokes, num_stokes, x, count_x, y, count_y, image_mutex);
+    };
+    _spectral_blocks = std::make_unique<SpectralBlockCache>(
+        reader, swizzled_shape(2), swizzled_shape(1), _depth, block_width, block_height, max_blocks);
+    spdlog::debug("Cursor spectral data cached in {} blocks of {}x{} pixels", max_blocks, block_width, block_height);
+}
 
-    return true;
+bool Hdf5Loader::HasSpectralData(std::mutex& image_mutex) {
+    std::unique_lock<std::mutex> ulock(image_mutex);
+    bool has_swizzled = HasData(FileInfo::Data::SWIZZLED);
+    ulock.unlock();
+    return has_swizzled || FileLoader::HasSpectralData(image_mutex);
 }
 
 } // namespace carta
@@ -7,6 +7,7 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_HDF5LOADER_H_
 #define CARTA_BACKEND_IMAGEDATA_HDF5LOADER_H_
 
+#include <mutex>
 #include <unordered_map>
 
 #include <casacore/lattices/Lattices/HDF5Lattice.h>
@@ -16,6 +17,7 @@
 #include "CartaHdf5Image.h"
 #include "FileLoader.h"
 #include "Hdf5Attributes.h"
+#include "SpectralBlockCache.h"
 
 namespace carta {
 
@@ -27,31 +29,59 @@ public:
 
     bool HasData(FileInfo::Data ds) const override;
     ImageRef GetImage() override;
+    void LoadDeferredHeaders() override;
 
     bool GetCursorSpectralData(
         std::vector<float>& data, int stokes, int cursor_x, int count_x, int cursor_y, int count_y, std::mutex& image_mutex) override;
-    bool UseRegionSpectralData(const IPos& region_shape, std::mutex& image_mutex) override;
-    bool GetRegionSpectralData(int region_id, int stokes, const casacore::ArrayLattice<casacore::Bool>& mask, const IPos& origin,
-        std::mutex& image_mutex, std::map<CARTA::StatsType, std::vector<double>>& results, float& progress) override;
+    bool GetCursorStokesSpectra(std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int cursor_x, int cursor_y,
+        std::mutex& image_mutex) override;
+    void StopSpectralSidecar() override;
+    bool GetSpectralTile(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) override;
+
+    bool HasMip(int mip) const override;
+    bool GetMipData(std::vector<float>& data, int mip, int x, int y, int width, int height, int z, int stokes,
+        std::mutex& image_mutex) override;
+
+    // Maximum chunk cache per dataset in MB; 0 leaves the HDF5 default
+    static void SetChunkCacheSize(int megabytes) {
+        _chunk_cache_mb = megabytes;
+    }
 
 private:
+    static int _chunk_cache_mb;
+
     std::string _hdu;
     std::unique_ptr<CartaHdf5Image> _image;
     std::unique_ptr<casacore::HDF5Lattice<float>> _swizzled_image;
-    std::map<FileInfo::RegionStatsId, FileInfo::RegionSpectralStats> _region_stats;
+    std::map<int, std::unique_ptr<casacore::HDF5Lattice<float>>> _mipmaps; // key is mip
+    std::unique_ptr<SpectralBlockCache> _spectral_blocks; // swizzled data near the cursor
+    std::once_flag _spectral_blocks_flag;
     Frame* _frame;
 
-    std::string DataSetToString(FileInfo::Data ds) const;
+    bool HasSpectralData(std::mutex& image_mutex) override;
+    // Spectra of num_stokes consecutive stokes, z fastest then y then x then stokes
+    bool ReadSwizzledData(
+        std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y, std::mutex& image_mutex);
+    bool ReadSwizzledSlice(std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y);
+    void InitSpectralBlocks(std::mutex& image_mutex);
+    std::string DataSetToString(FileInfo::Data ds, int mip = 0) const;
+    void LoadMipMaps();
 
     template <typename T>
     const IPos GetStatsDataShapeTyped(FileInfo::Data ds);
     template <typename S, typename D>
     casacore::ArrayBase* GetStatsDataTyped(FileInfo::Data ds);
+    template <typename S, typename D>
+    casacore::ArrayBase* GetStatsDataTyped(FileInfo::Data ds, const casacore::Slicer& slicer);
 
     const IPos GetStatsDataShape(FileInfo::Data ds) override;
     casacore::ArrayBase* GetStatsData(FileInfo::Data ds) override;
+    casacore::ArrayBase* GetStatsData(FileInfo::Data ds, const casacore::Slicer& slicer) override;
 
     casacore::Lattice<float>* LoadSwizzledData();
+
+    // Size the chunk cache to hold all chunks intersecting a read of the given shape
+    void SetChunkCache(casacore::HDF5Lattice<float>& lattice, const IPos& read_shape);
 };
 
 } // namespace carta
@@ -49,6 +49,14 @@ casacore::ArrayBase* Hdf5Loader::GetStatsDataTyped(FileInfo::Data ds) {
     return data;
 }
 
+template <typename S, typename D>
+casacore::ArrayBase* Hdf5Loader::GetStatsDataTyped(FileInfo::Data ds, const casacore::Slicer& slicer) {
+    casacore::HDF5DataSet data_set(*(_image->Group()), DataSetToString(ds), (const S*)0);
+    casacore::ArrayBase* data = new casacore::Array<D>();
+    data_set.get(slicer, *data);
+    return data;
+}
+
 } // namespace carta
 
 #endif // CARTA_BACKEND_IMAGEDATA_HDF5LOADER_TCC_
@@ -7,6 +7,8 @@
 #ifndef CARTA_BACKEND_IMAGEDATA_IMAGEPTRLOADER_H_
 #define CARTA_BACKEND_IMAGEDATA_IMAGEPTRLOADER_H_
 
+#include <casacore/images/Images/ImageConcat.h>
+
 #include "FileLoader.h"
 
 namespace carta {
@@ -27,6 +29,9 @@ private:
 ImagePtrLoader::ImagePtrLoader(std::shared_ptr<casacore::ImageInterface<float>> image) : FileLoader("") {
     _image = image;
     _num_dims = _image->shape().size();
+
+    // Concatenated stokes files from StokesFilesConnector
+    _parallel_stokes_slices = (dynamic_cast<casacore::ImageConcat<float>*>(_image.get()) != nullptr);
 }
 
 void ImagePtrLoader::OpenFile(const std::string& /*hdu*/) {}
@@ -0,0 +1,189 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LoaderIoStats.cc: counts of file loader reads by read path and slice shape, per file and per session
+
+#include "LoaderIoStats.h"
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+namespace carta {
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::set<LoaderIoStats*> loaders;
+    LoaderIoStats::Totals closed;                           // of all loaders which were destroyed
+    std::map<uint32_t, LoaderIoStats::Totals> closed_files; // by session
+    std::set<uint32_t> sessions;                            // which have not ended
+
+    static Registry& Global() {
+        // Never destroyed, since loaders may be destroyed after static destruction
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+};
+
+thread_local LoaderIoStats::Scope* current_scope = nullptr;
+
+uint64_t HashKey(const int64_t* values, size_t count) {
+    // FNV-1a; zero is no key
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; ++i) {
+        for (int byte = 0; byte < 8; ++byte) {
+            hash ^= (values[i] >> (8 * byte)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash ? hash : 1;
+}
+
+} // namespace
+
+void LoaderIoStats::Totals::Add(const Totals& other) {
+    for (int i = 0; i < (int)LoaderRead::Count; ++i) {
+        reads[i].calls += other.reads[i].calls;
+        reads[i].bytes += other.reads[i].bytes;
+        reads[i].time_us += other.reads[i].time_us;
+        reads[i].repeated += other.reads[i].repeated;
+    }
+    for (int i = 0; i < (int)SliceShape::Count; ++i) {
+        shapes[i] += other.shapes[i];
+    }
+}
+
+LoaderIoStats::Scope::Scope(LoaderIoStats& stats, LoaderRead read)
+    : _stats(&stats), _read(read), _parent(current_scope), _bytes(0), _shape(SliceShape::Count), _key(0) {
+    for (auto scope = current_scope; scope; scope = scope->_parent) {
+        if (scope->_stats == _stats && scope->_read == _read) {
+            _stats = nullptr;
+            return;
+        }
+    }
+    current_scope = this;
+    _start = std::chrono::steady_clock::now();
+}
+
+LoaderIoStats::Scope::~Scope() {
+    if (_stats) {
+        current_scope = _parent;
+        _stats->Record(_read, _bytes, std::chrono::steady_clock::now() - _start, _shape, _key);
+    }
+}
+
+void LoaderIoStats::Scope::SetKey(std::initializer_list<int64_t> values) {
+    _key = HashKey(values.begin(), values.size());
+}
+
+void LoaderIoStats::Scope::SetKey(const std::vector<int64_t>& values) {
+    _key = HashKey(values.data(), values.size());
+}
+
+LoaderIoStats::LoaderIoStats(const std::string& filename) : _filename(filename), _session_id(0), _recent_keys(), _next_key(0) {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    registry.loaders.insert(this);
+}
+
+LoaderIoStats::~LoaderIoStats() {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex, _mutex);
+    registry.loaders.erase(this);
+    registry.closed.Add(_totals);
+    // Frames may outlive the end of their session
+    if (registry.sessions.count(_session_id)) {
+        registry.closed_files[_session_id].Add(_totals);
+    }
+}
+
+void LoaderIoStats::SetSessionId(uint32_t session_id) {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    _session_id = session_id;
+    registry.sessions.insert(session_id);
+}
+
+void LoaderIoStats::Record(LoaderRead read, uint64_t bytes, std::chrono::steady_clock::duration duration, SliceShape shape, uint64_t key) {
+    std::scoped_lock lock(_mutex);
+    auto& counts = _totals.reads[(int)read];
+    counts.calls++;
+    counts.bytes += bytes;
+    counts.time_us += std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    if (shape != SliceShape::Count) {
+        _totals.shapes[(int)shape]++;
+    }
+    if (key) {
+        auto recent_end = _recent_keys + LOADER_RECENT_READS;
+        if (std::find(_recent_keys, recent_end, key) != recent_end) {
+            counts.repeated++;
+        } else {
+            _recent_keys[_next_key] = key;
+            _next_key = (_next_key + 1) % LOADER_RECENT_READS;
+        }
+    }
+}
+
+LoaderIoStats::Totals LoaderIoStats::Process() {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    Totals totals = registry.closed;
+    for (auto loader : registry.loaders) {
+        std::scoped_lock loader_lock(loader->_mutex);
+        totals.Add(loader->_totals);
+    }
+    return totals;
+}
+
+std::vector<LoaderIoStats::FileTotals> LoaderIoStats::Files() {
+    std::vector<FileTotals> files;
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    for (auto loader : registry.loaders) {
+        if (loader->_session_id) {
+            std::scoped_lock loader_lock(loader->_mutex);
+            files.push_back({loader->_session_id, loader->_filename, loader->_totals});
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const FileTotals& a, const FileTotals& b) {
+        return std::tie(a.session_id, a.filename) < std::tie(b.session_id, b.filename);
+    });
+
+    // A file opened twice in a session is reported once
+    std::vector<FileTotals> merged;
+    for (auto& file : files) {
+        if (!merged.empty() && merged.back().session_id == file.session_id && merged.back().filename == file.filename) {
+            merged.back().totals.Add(file.totals);
+        } else {
+            merged.push_back(std::move(file));
+        }
+    }
+    return merged;
+}
+
+std::map<uint32_t, LoaderIoStats::Totals> LoaderIoStats::Sessions() {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    auto sessions = registry.closed_files;
+    for (auto loader : registry.loaders) {
+        if (loader->_session_id) {
+            std::scoped_lock loader_lock(loader->_mutex);
+            sessions[loader->_session_id].Add(loader->_totals);
+        }
+    }
+    return sessions;
+}
+
+void LoaderIoStats::EndSession(uint32_t session_id) {
+    auto& registry = Registry::Global();
+    std::scoped_lock lock(registry.mutex);
+    registry.closed_files.erase(session_id);
+    registry.sessions.erase(session_id);
+}
+
+} // namespace carta
@@ -0,0 +1,107 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LoaderIoStats.h: counts of file loader reads by read path and slice shape, per file and per session
+
+#ifndef CARTA_BACKEND_IMAGEDATA_LOADERIOSTATS_H_
+#define CARTA_BACKEND_IMAGEDATA_LOADERIOSTATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Constants.h"
+
+namespace carta {
+
+// Spectral reads include the slice and swizzled reads they make
+enum class LoaderRead { Slice, CursorSpectral, RegionSpectral, Swizzled, Mip, Count };
+// Slices by the render and z axes longer than one pixel
+enum class SliceShape { Point, Row, Column, Plane, Spectrum, Cube, Count };
+
+class LoaderIoStats {
+public:
+    struct ReadCounts {
+        uint64_t calls = 0;
+        uint64_t bytes = 0;
+        uint64_t time_us = 0;
+        uint64_t repeated = 0;
+    };
+    struct Totals {
+        ReadCounts reads[(int)LoaderRead::Count];
+        uint64_t shapes[(int)SliceShape::Count] = {};
+        void Add(const Totals& other);
+    };
+    struct FileTotals {
+        uint32_t session_id;
+        std::string filename;
+        Totals totals;
+    };
+
+    // Times a read until the scope ends. A read within a read of the same path of the same loader, such as the fallback of an
+    // override to the base loader, is not counted again.
+    class Scope {
+    public:
+        Scope(LoaderIoStats& stats, LoaderRead read);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void AddBytes(uint64_t bytes) {
+            _bytes += bytes;
+        }
+        // Of a slice, for the shape histogram
+        void SetShape(SliceShape shape) {
+            _shape = shape;
+        }
+        // Identifies the data read, e.g. by the slice start and shape, for counting repeated reads
+        void SetKey(std::initializer_list<int64_t> values);
+        void SetKey(const std::vector<int64_t>& values);
+
+    private:
+        LoaderIoStats* _stats; // nullptr if nested
+        LoaderRead _read;
+        Scope* _parent;
+        std::chrono::steady_clock::time_point _start;
+        uint64_t _bytes;
+        SliceShape _shape;
+        uint64_t _key;
+    };
+
+    explicit LoaderIoStats(const std::string& filename);
+    ~LoaderIoStats();
+    LoaderIoStats(const LoaderIoStats&) = delete;
+    LoaderIoStats& operator=(const LoaderIoStats&) = delete;
+
+    // Session of the frame which opened the file; reads of loaders without one only count towards the process totals
+    void SetSessionId(uint32_t session_id);
+
+    // Totals of each read path over all loaders since the start
+    static Totals Process();
+    // Totals of each open file, and of each session including its closed files
+    static std::vector<FileTotals> Files();
+    static std::map<uint32_t, Totals> Sessions();
+    // Drops the totals of the closed files of the session
+    static void EndSession(uint32_t session_id);
+
+private:
+    void Record(LoaderRead read, uint64_t bytes, std::chrono::steady_clock::duration duration, SliceShape shape, uint64_t key);
+
+    std::string _filename;
+    uint32_t _session_id;
+    std::mutex _mutex;
+    Totals _totals;
+    uint64_t _recent_keys[LOADER_RECENT_READS];
+    int _next_key;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_LOADERIOSTATS_H_
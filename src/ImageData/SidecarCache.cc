@@ -0,0 +1,42 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SidecarCache.h"
+
+#include <cstdint>
+#include <functional>
+
+#include <sys/stat.h>
+
+#include <fmt/format.h>
+
+using namespace carta;
+
+std::string SidecarCache::_folder;
+
+void SidecarCache::SetFolder(const std::string& folder) {
+    _folder = folder;
+}
+
+bool SidecarCache::Enabled() {
+    return !_folder.empty();
+}
+
+std::string SidecarCache::Folder() {
+    return _folder;
+}
+
+std::string SidecarCache::Filename(const std::string& image_filename, const std::string& hdu, const std::string& extension) {
+    // CASA and MIRIAD images are directories; their modification time changes when the data is rewritten.
+    struct stat image_stat;
+    int64_t mtime(0), size(0);
+    if (stat(image_filename.c_str(), &image_stat) == 0) {
+        mtime = image_stat.st_mtime;
+        size = image_stat.st_size;
+    }
+    std::string key = fmt::format("{}:{}:{}:{}", image_filename, hdu, mtime, size);
+    return fmt::format("{}/{:016x}.{}", _folder, std::hash<std::string>()(key), extension);
+}
@@ -0,0 +1,33 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SidecarCache.h: folder of derived data files shared by all sessions, keyed by image file
+
+#ifndef CARTA_BACKEND_IMAGEDATA_SIDECARCACHE_H_
+#define CARTA_BACKEND_IMAGEDATA_SIDECARCACHE_H_
+
+#include <string>
+
+namespace carta {
+
+class SidecarCache {
+public:
+    // Sidecar files are only used when a cache folder is set
+    static void SetFolder(const std::string& folder);
+    static bool Enabled();
+    static std::string Folder();
+
+    // Name of the sidecar file with this extension for the image and HDU.
+    // The name changes when the image file is modified, so that stale sidecars are not used.
+    static std::string Filename(const std::string& image_filename, const std::string& hdu, const std::string& extension);
+
+private:
+    static std::string _folder;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_SIDECARCACHE_H_
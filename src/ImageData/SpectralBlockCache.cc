@@ -0,0 +1,213 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralBlockCache.cc: LRU cache of spectra for blocks of pixels near the cursor, prefetched in the direction of motion
+
+#include "SpectralBlockCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace carta;
+
+SpectralBlockCache::SpectralBlockCache(
+    BlockReader reader, int width, int height, int depth, int block_width, int block_height, size_t max_blocks)
+    : _reader(reader),
+      _width(width),
+      _height(height),
+      _depth(depth),
+      _block_width(block_width),
+      _block_height(block_height),
+      _max_blocks(std::max(max_blocks, (size_t)1)),
+      _last_stokes(-1),
+      _last_x(-1),
+      _last_y(-1),
+      _has_prefetch(false),
+      _stop_prefetch(false),
+      _prefetch_stokes(0),
+      _prefetch_x(0),
+      _prefetch_y(0) {
+    _prefetch_thread = std::thread(&SpectralBlockCache::RunPrefetch, this);
+}
+
+SpectralBlockCache::~SpectralBlockCache() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop_prefetch = true;
+    }
+    _prefetch_cv.notify_all();
+    if (_prefetch_thread.joinable()) {
+        _prefetch_thread.join();
+    }
+}
+
+bool SpectralBlockCache::GetSpectralData(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) {
+    int block_x = x / _block_width;
+    int block_y = y / _block_height;
+    if ((x < 0) || (y < 0) || (count_x < 1) || (count_y < 1) || ((x + count_x - 1) / _block_width != block_x) ||
+        ((y + count_y - 1) / _block_height != block_y) || (x + count_x > _width) || (y + count_y > _height)) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto block = Find(stokes, block_x, block_y);
+    if (block == _blocks.end()) {
+        lock.unlock();
+        Block new_block;
+        if (!ReadBlock(stokes, block_x, block_y, new_block)) {
+            return false;
+        }
+        lock.lock();
+        Insert(std::move(new_block));
+        block = _blocks.begin();
+    }
+
+    // Spectra for consecutive y of one x are contiguous in the block and in the result
+    int block_height = std::min(_block_height, _height - block_y * _block_height);
+    int x_offset = x - block_x * _block_width;
+    int y_offset = y - block_y * _block_height;
+    size_t column_size = (size_t)count_y * _depth;
+    data.resize(column_size * count_x);
+    for (int i = 0; i < count_x; ++i) {
+        const float* column = block->data.data() + ((size_t)(x_offset + i) * block_height + y_offset) * _depth;
+        memcpy(data.data() + i * column_size, column, column_size * sizeof(float));
+    }
+
+    // Prefetch the next block in the direction of cursor motion
+    if ((count_x == 1) && (count_y == 1)) {
+        if ((stokes == _last_stokes) && ((x != _last_x) || (y != _last_y))) {
+            int next_x = block_x + (x > _last_x) - (x < _last_x);
+            int next_y = block_y + (y > _last_y) - (y < _last_y);
+            bool in_image = (next_x >= 0) && (next_x * _block_width < _width) && (next_y >= 0) && (next_y * _block_height < _height);
+            if (in_image && ((next_x != block_x) || (next_y != block_y)) && (Find(stokes, next_x, next_y) == _blocks.end())) {
+                _prefetch_stokes = stokes;
+                _prefetch_x = next_x;
+                _prefetch_y = next_y;
+                _has_prefetch = true;
+                _prefetch_cv.notify_one();
+            }
+        }
+        _last_stokes = stokes;
+        _last_x = x;
+        _last_y = y;
+    }
+    return true;
+}
+
+bool SpectralBlockCache::GetSpectralData(std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int x, int y) {
+    if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height) || stokes.empty()) {
+        return false;
+    }
+    int block_x = x / _block_width;
+    int block_y = y / _block_height;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    int min_missing(-1), max_missing(-1);
+    for (int s : stokes) {
+        if (Find(s, block_x, block_y) == _blocks.end()) {
+            min_missing = (min_missing < 0) ? s : std::min(min_missing, s);
+            max_missing = std::max(max_missing, s);
+        }
+    }
+    if (min_missing >= 0) {
+        lock.unlock();
+        std::vector<Block> new_blocks;
+        if (!ReadBlocks(min_missing, max_missing - min_missing + 1, block_x, block_y, new_blocks)) {
+            return false;
+        }
+        lock.lock();
+        for (auto& block : new_blocks) {
+            Insert(std::move(block));
+        }
+    }
+
+    int block_height = std::min(_block_height, _height - block_y * _block_height);
+    size_t offset = ((size_t)(x - block_x * _block_width) * block_height + (y - block_y * _block_height)) * _depth;
+    data.resize(stokes.size());
+    for (size_t i = 0; i < stokes.size(); ++i) {
+        // Evicted by the insertion of the other blocks if the cache is small
+        auto block = Find(stokes[i], block_x, block_y);
+        if (block == _blocks.end()) {
+            return false;
+        }
+        data[i].assign(block->data.begin() + offset, block->data.begin() + offset + _depth);
+    }
+    return true;
+}
+
+std::list<SpectralBlockCache::Block>::iterator SpectralBlockCache::Find(int stokes, int block_x, int block_y) {
+    return std::find_if(_blocks.begin(), _blocks.end(), [&](const Block& block) {
+        return (block.stokes == stokes) && (block.block_x == block_x) && (block.block_y == block_y);
+    });
+}
+
+void SpectralBlockCache::Insert(Block&& block) {
+    // Replaces a copy read by the other thread
+    auto existing = Find(block.stokes, block.block_x, block.block_y);
+    if (existing != _blocks.end()) {
+        _blocks.erase(existing);
+    }
+    _blocks.push_front(std::move(block));
+    while (_blocks.size() > _max_blocks) {
+        _blocks.pop_back();
+    }
+}
+
+bool SpectralBlockCache::ReadBlock(int stokes, int block_x, int block_y, Block& block) {
+    // Blocks at the right and top edges are smaller
+    int x = block_x * _block_width;
+    int y = block_y * _block_height;
+    block.stokes = stokes;
+    block.block_x = block_x;
+    block.block_y = block_y;
+    return _reader(block.data, stokes, 1, x, std::min(_block_width, _width - x), y, std::min(_block_height, _height - y));
+}
+
+bool SpectralBlockCache::ReadBlocks(int stokes, int num_stokes, int block_x, int block_y, std::vector<Block>& blocks) {
+    int x = block_x * _block_width;
+    int y = block_y * _block_height;
+    std::vector<float> data;
+    if (!_reader(data, stokes, num_stokes, x, std::min(_block_width, _width - x), y, std::min(_block_height, _height - y))) {
+        return false;
+    }
+    size_t block_size = data.size() / num_stokes;
+    blocks.resize(num_stokes);
+    for (int i = 0; i < num_stokes; ++i) {
+        blocks[i].stokes = stokes + i;
+        blocks[i].block_x = block_x;
+        blocks[i].block_y = block_y;
+        blocks[i].data.assign(data.begin() + i * block_size, data.begin() + (i + 1) * block_size);
+    }
+    return true;
+}
+
+void SpectralBlockCache::RunPrefetch() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _prefetch_cv.wait(lock, [&]() { return _stop_prefetch || _has_prefetch; });
+        if (_stop_prefetch) {
+            return;
+        }
+
+        int stokes(_prefetch_stokes), block_x(_prefetch_x), block_y(_prefetch_y);
+        _has_prefetch = false;
+        if (Find(stokes, block_x, block_y) != _blocks.end()) {
+            continue;
+        }
+
+        lock.unlock();
+        Block block;
+        bool block_ok = ReadBlock(stokes, block_x, block_y, block);
+        lock.lock();
+        if (block_ok) {
+            // Keep the block in use ahead of the prefetched block
+            Insert(std::move(block));
+            if (_blocks.size() > 1) {
+                std::swap(*_blocks.begin(), *std::next(_blocks.begin()));
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralBlockCache.h: LRU cache of spectra for blocks of pixels near the cursor, prefetched in the direction of motion
+
+#ifndef CARTA_BACKEND_IMAGEDATA_SPECTRALBLOCKCACHE_H_
+#define CARTA_BACKEND_IMAGEDATA_SPECTRALBLOCKCACHE_H_
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace carta {
+
+class SpectralBlockCache {
+public:
+    // Reads spectra of num_stokes consecutive stokes for a block of pixels, z fastest then y then x then stokes; called from the
+    // prefetch thread too
+    using BlockReader =
+        std::function<bool(std::vector<float>& data, int stokes, int num_stokes, int x, int count_x, int y, int count_y)>;
+
+    // Blocks of block_width x block_height pixels are aligned to multiples of their size
+    SpectralBlockCache(BlockReader reader, int width, int height, int depth, int block_width, int block_height, size_t max_blocks);
+    ~SpectralBlockCache();
+
+    // Spectra for pixels inside one block, in the reader order; false if they span blocks or the block cannot be read.
+    // Single pixel requests also prefetch the next block in the direction the cursor moved.
+    bool GetSpectralData(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y);
+    // Spectra of one pixel for several stokes, in the order given. The blocks which are not cached are read together, for the range
+    // of their stokes.
+    bool GetSpectralData(std::vector<std::vector<float>>& data, const std::vector<int>& stokes, int x, int y);
+
+private:
+    struct Block {
+        int stokes, block_x, block_y;
+        std::vector<float> data;
+    };
+
+    // Find and Insert require the lock; Insert moves the block to the front
+    std::list<Block>::iterator Find(int stokes, int block_x, int block_y);
+    void Insert(Block&& block);
+    bool ReadBlock(int stokes, int block_x, int block_y, Block& block);
+    // Blocks of stokes to stokes + num_stokes - 1, from one read
+    bool ReadBlocks(int stokes, int num_stokes, int block_x, int block_y, std::vector<Block>& blocks);
+    void RunPrefetch();
+
+    BlockReader _reader;
+    int _width, _height, _depth;
+    int _block_width, _block_height;
+    size_t _max_blocks;
+
+    std::list<Block> _blocks; // most recently used at the front
+    std::mutex _mutex;
+
+    // Last single pixel request, for the direction of motion
+    int _last_stokes, _last_x, _last_y;
+
+    // Block to prefetch, if any
+    bool _has_prefetch, _stop_prefetch;
+    int _prefetch_stokes, _prefetch_x, _prefetch_y;
+    std::condition_variable _prefetch_cv;
+    std::thread _prefetch_thread;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_SPECTRALBLOCKCACHE_H_
@@ -0,0 +1,221 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralSidecar.cc: spectral-major copy of an image cube cached on disk, for fast spectral profiles
+
+#include "SpectralSidecar.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Logger/Logger.h"
+#include "SidecarCache.h"
+
+#define SPECTRAL_SIDECAR_MAGIC "CARTAZYX"
+#define SPECTRAL_SIDECAR_VERSION 1
+
+using namespace carta;
+
+SpectralSidecar::SpectralSidecar(const std::string& image_filename, const std::string& hdu, const casacore::IPosition& image_shape,
+    int z_axis, int stokes_axis)
+    : _image_shape(image_shape), _z_axis(z_axis), _stokes_axis(stokes_axis), _fd(-1), _ready(false), _stop(false) {
+    _width = image_shape(0);
+    _height = image_shape(1);
+    _depth = image_shape(z_axis);
+    _num_stokes = (stokes_axis >= 0 ? image_shape(stokes_axis) : 1);
+    _sidecar_filename = SidecarCache::Filename(image_filename, hdu, "zyx");
+}
+
+SpectralSidecar::~SpectralSidecar() {
+    Stop();
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+void SpectralSidecar::OpenOrGenerate(SliceReader reader) {
+    if (Open()) {
+        spdlog::debug("Using spectral sidecar {}", _sidecar_filename);
+        return;
+    }
+    _generate_thread = std::thread(&SpectralSidecar::Generate, this, std::move(reader));
+}
+
+void SpectralSidecar::Stop() {
+    _stop = true;
+    if (_generate_thread.joinable()) {
+        _generate_thread.join();
+    }
+}
+
+bool SpectralSidecar::IsReady() const {
+    return _ready;
+}
+
+bool SpectralSidecar::Open() {
+    // Open and validate an existing sidecar file
+    int fd = open(_sidecar_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    Header header;
+    struct stat sidecar_stat;
+    off_t expected_size = DataOffset(0, 0, _num_stokes);
+    if ((pread(fd, &header, sizeof(Header), 0) != (ssize_t)sizeof(Header)) || (strncmp(header.magic, SPECTRAL_SIDECAR_MAGIC, 8) != 0) ||
+        (header.version != SPECTRAL_SIDECAR_VERSION) || (header.width != _width) || (header.height != _height) ||
+        (header.depth != _depth) || (header.num_stokes != _num_stokes) || (fstat(fd, &sidecar_stat) != 0) ||
+        (sidecar_stat.st_size != expected_size)) {
+        spdlog::warn("Ignoring invalid spectral sidecar {}", _sidecar_filename);
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _ready = true;
+    return true;
+}
+
+void SpectralSidecar::Generate(SliceReader reader) {
+    // Only one process writes a given sidecar; others wait for it to appear.
+    std::string tmp_filename = _sidecar_filename + ".tmp";
+    while (!_stop) {
+        int fd = open(tmp_filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            spdlog::warn("Could not create spectral sidecar {}: {}", tmp_filename, strerror(errno));
+            return;
+        }
+
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            // Another writer holds the lock
+            close(fd);
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (Open()) {
+                return;
+            }
+            continue;
+        }
+
+        // The previous writer may have finished between our open and flock
+        if (Open()) {
+            close(fd);
+            return;
+        }
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        bool write_ok = WriteData(fd, reader);
+        if (write_ok && !_stop && (rename(tmp_filename.c_str(), _sidecar_filename.c_str()) == 0)) {
+            auto t_end = std::chrono::high_resolution_clock::now();
+            auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_start).count();
+            spdlog::performance("Wrote spectral sidecar {} in {} ms", _sidecar_filename, dt);
+
+            // Reopen read-only to release the write lock
+            close(fd);
+            Open();
+        } else {
+            unlink(tmp_filename.c_str());
+            close(fd);
+        }
+        return;
+    }
+}
+
+bool SpectralSidecar::WriteData(int fd, SliceReader& reader) {
+    // Read blocks of full spectra from the image and write them with z as the fastest axis
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, DataOffset(0, 0, _num_stokes)) != 0) {
+        return false;
+    }
+
+    Header header;
+    memcpy(header.magic, SPECTRAL_SIDECAR_MAGIC, 8);
+    header.version = SPECTRAL_SIDECAR_VERSION;
+    header.reserved = 0;
+    header.width = _width;
+    header.height = _height;
+    header.depth = _depth;
+    header.num_stokes = _num_stokes;
+    if (pwrite(fd, &header, sizeof(Header), 0) != (ssize_t)sizeof(Header)) {
+        return false;
+    }
+
+    int64_t block_width = std::max(std::min(_width, (int64_t)SPECTRAL_SIDECAR_BLOCK_PIXELS / _depth), (int64_t)1);
+    int64_t block_height = std::max(std::min(_height, (int64_t)SPECTRAL_SIDECAR_BLOCK_PIXELS / (_depth * block_width)), (int64_t)1);
+    std::vector<float> block_data, column_data;
+
+    for (int64_t stokes = 0; stokes < _num_stokes; ++stokes) {
+        for (int64_t y = 0; y < _height; y += block_height) {
+            for (int64_t x = 0; x < _width; x += block_width) {
+                if (_stop) {
+                    return false;
+                }
+
+                int64_t nx = std::min(block_width, _width - x);
+                int64_t ny = std::min(block_height, _height - y);
+                casacore::IPosition start(_image_shape.size(), 0);
+                casacore::IPosition count(_image_shape);
+                start(0) = x;
+                start(1) = y;
+                count(0) = nx;
+                count(1) = ny;
+                if (_stokes_axis >= 0) {
+                    start(_stokes_axis) = stokes;
+                    count(_stokes_axis) = 1;
+                }
+
+                // Block is stored with x fastest, then y, then z; a unit stokes axis does not change the layout
+                block_data.resize(nx * ny * _depth);
+                casacore::Array<float> tmp(count, block_data.data(), casacore::StorageInitPolicy::SHARE);
+                if (!reader(tmp, casacore::Slicer(start, count))) {
+                    return false;
+                }
+
+                // One contiguous spectrum column (all z, ny rows) per x
+                column_data.resize(ny * _depth);
+                for (int64_t i = 0; i < nx; ++i) {
+                    for (int64_t j = 0; j < ny; ++j) {
+                        for (int64_t z = 0; z < _depth; ++z) {
+                            column_data[z + _depth * j] = block_data[i + nx * (j + ny * z)];
+                        }
+                    }
+                    size_t num_bytes = column_data.size() * sizeof(float);
+                    if (pwrite(fd, column_data.data(), num_bytes, DataOffset(x + i, y, stokes)) != (ssize_t)num_bytes) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+off_t SpectralSidecar::DataOffset(int64_t x, int64_t y, int64_t stokes) const {
+    // Layout is z fastest, then y, then x, then stokes
+    return sizeof(Header) + sizeof(float) * _depth * (y + _height * (x + _width * stokes));
+}
+
+bool SpectralSidecar::GetSpectralData(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y) {
+    if (!_ready || (stokes < 0) || (stokes >= _num_stokes) || (x < 0) || (y < 0) || (x + count_x > _width) ||
+        (y + count_y > _height)) {
+        return false;
+    }
+
+    data.resize(_depth * count_y * count_x);
+    size_t num_bytes = sizeof(float) * _depth * count_y;
+    for (int i = 0; i < count_x; ++i) {
+        if (pread(_fd, data.data() + i * _depth * count_y, num_bytes, DataOffset(x + i, y, stokes)) != (ssize_t)num_bytes) {
+            spdlog::warn("Could not read spectral sidecar {}: {}", _sidecar_filename, strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
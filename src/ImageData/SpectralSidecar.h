@@ -0,0 +1,77 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralSidecar.h: spectral-major copy of an image cube cached on disk, for fast spectral profiles
+
+#ifndef CARTA_BACKEND_IMAGEDATA_SPECTRALSIDECAR_H_
+#define CARTA_BACKEND_IMAGEDATA_SPECTRALSIDECAR_H_
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <casacore/casa/Arrays/Array.h>
+#include <casacore/casa/Arrays/IPosition.h>
+#include <casacore/casa/Arrays/Slicer.h>
+
+// Maximum number of pixels read from the image at a time while writing the sidecar
+#define SPECTRAL_SIDECAR_BLOCK_PIXELS 16 * 1024 * 1024
+
+namespace carta {
+
+class SpectralSidecar {
+public:
+    // Reads a section of the image with the mask applied; called from the sidecar thread
+    using SliceReader = std::function<bool(casacore::Array<float>& data, const casacore::Slicer& slicer)>;
+
+    // x and y are image axes 0 and 1; stokes_axis is -1 if there is no stokes axis
+    SpectralSidecar(const std::string& image_filename, const std::string& hdu, const casacore::IPosition& image_shape, int z_axis,
+        int stokes_axis);
+    ~SpectralSidecar();
+
+    // Use an existing sidecar file, or write one in a background thread
+    void OpenOrGenerate(SliceReader reader);
+    void Stop();
+    bool IsReady() const;
+
+    // Spectra for a block of pixels, z fastest then y then x, as in the swizzled HDF5 dataset
+    bool GetSpectralData(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y);
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        int64_t width;
+        int64_t height;
+        int64_t depth;
+        int64_t num_stokes;
+    };
+
+    bool Open();
+    void Generate(SliceReader reader);
+    bool WriteData(int fd, SliceReader& reader);
+    off_t DataOffset(int64_t x, int64_t y, int64_t stokes) const;
+
+    std::string _sidecar_filename;
+    casacore::IPosition _image_shape;
+    int _z_axis, _stokes_axis;
+    int64_t _width, _height, _depth, _num_stokes;
+
+    int _fd; // sidecar file descriptor, valid when ready
+    std::atomic<bool> _ready;
+    std::atomic<bool> _stop;
+    std::thread _generate_thread;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_SPECTRALSIDECAR_H_
@@ -0,0 +1,143 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# StatsSidecar.cc: per-channel basic stats and histograms cached on disk and shared by sessions
+
+#include "StatsSidecar.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Logger/Logger.h"
+#include "SidecarCache.h"
+
+#define STATS_SIDECAR_MAGIC "CARTASTA"
+#define STATS_SIDECAR_VERSION 2
+
+using namespace carta;
+
+StatsSidecar::StatsSidecar(const std::string& image_filename, const std::string& hdu, size_t depth, size_t num_stokes, int num_bins)
+    : _depth(depth), _num_stokes(num_stokes), _num_bins(num_bins), _fd(-1) {
+    _sidecar_filename = SidecarCache::Filename(image_filename, hdu, "stats");
+}
+
+StatsSidecar::~StatsSidecar() {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+bool StatsSidecar::Open() {
+    int fd = open(_sidecar_filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        spdlog::warn("Could not open stats sidecar {}: {}", _sidecar_filename, strerror(errno));
+        return false;
+    }
+
+    // Serialise creation of the header between sessions
+    flock(fd, LOCK_EX);
+    off_t expected_size = RecordOffset(_num_stokes, 0);
+    struct stat sidecar_stat;
+    bool ok = (fstat(fd, &sidecar_stat) == 0);
+    if (ok && (sidecar_stat.st_size == 0)) {
+        // New file: all records are invalid (zero) until written
+        Header header;
+        memcpy(header.magic, STATS_SIDECAR_MAGIC, 8);
+        header.version = STATS_SIDECAR_VERSION;
+        header.num_bins = _num_bins;
+        header.depth = _depth;
+        header.num_stokes = _num_stokes;
+        ok = (pwrite(fd, &header, sizeof(Header), 0) == (ssize_t)sizeof(Header)) && (ftruncate(fd, expected_size) == 0);
+    } else if (ok) {
+        Header header;
+        ok = (pread(fd, &header, sizeof(Header), 0) == (ssize_t)sizeof(Header)) && (strncmp(header.magic, STATS_SIDECAR_MAGIC, 8) == 0) &&
+             (header.version == STATS_SIDECAR_VERSION) && (header.num_bins == _num_bins) && (header.depth == (int64_t)_depth) &&
+             (header.num_stokes == (int64_t)_num_stokes) && (sidecar_stat.st_size == expected_size);
+        if (!ok) {
+            spdlog::warn("Ignoring invalid stats sidecar {}", _sidecar_filename);
+        }
+    }
+    flock(fd, LOCK_UN);
+
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    _fd = fd;
+    return true;
+}
+
+bool StatsSidecar::Read(size_t stokes, size_t z, ChannelStats& stats) {
+    return (z < _depth) && ReadRecord(stokes, z, stats);
+}
+
+bool StatsSidecar::Write(size_t stokes, size_t z, const ChannelStats& stats) {
+    return (z < _depth) && WriteRecord(stokes, z, stats);
+}
+
+bool StatsSidecar::ReadCube(size_t stokes, ChannelStats& stats) {
+    return ReadRecord(stokes, _depth, stats);
+}
+
+bool StatsSidecar::WriteCube(size_t stokes, const ChannelStats& stats) {
+    return WriteRecord(stokes, _depth, stats);
+}
+
+bool StatsSidecar::ReadRecord(size_t stokes, size_t index, ChannelStats& stats) {
+    if ((_fd < 0) || (stokes >= _num_stokes) || (index > _depth)) {
+        return false;
+    }
+
+    Record record;
+    off_t offset = RecordOffset(stokes, index);
+    if ((pread(_fd, &record, sizeof(Record), offset) != (ssize_t)sizeof(Record)) || !record.valid) {
+        return false;
+    }
+
+    stats.num_pixels = record.num_pixels;
+    stats.sum = record.sum;
+    stats.sum_sq = record.sum_sq;
+    stats.min = record.min;
+    stats.max = record.max;
+    stats.histogram_bins.resize(_num_bins);
+    ssize_t num_bytes = _num_bins * sizeof(int);
+    return pread(_fd, stats.histogram_bins.data(), num_bytes, offset + sizeof(Record)) == num_bytes;
+}
+
+bool StatsSidecar::WriteRecord(size_t stokes, size_t index, const ChannelStats& stats) {
+    if ((_fd < 0) || (stokes >= _num_stokes) || (index > _depth) || ((int)stats.histogram_bins.size() != _num_bins)) {
+        return false;
+    }
+
+    // Write the bins before the record, so that a valid record is never read with incomplete bins
+    off_t offset = RecordOffset(stokes, index);
+    ssize_t num_bytes = _num_bins * sizeof(int);
+    if (pwrite(_fd, stats.histogram_bins.data(), num_bytes, offset + sizeof(Record)) != num_bytes) {
+        return false;
+    }
+
+    Record record;
+    record.valid = 1;
+    record.num_pixels = stats.num_pixels;
+    record.sum = stats.sum;
+    record.sum_sq = stats.sum_sq;
+    record.min = stats.min;
+    record.max = stats.max;
+    return pwrite(_fd, &record, sizeof(Record), offset) == (ssize_t)sizeof(Record);
+}
+
+off_t StatsSidecar::RecordOffset(size_t stokes, size_t index) const {
+    // Channel records for each stokes are followed by its cube record
+    return sizeof(Header) + RecordSize() * (index + (_depth + 1) * stokes);
+}
+
+size_t StatsSidecar::RecordSize() const {
+    return sizeof(Record) + _num_bins * sizeof(int);
+}
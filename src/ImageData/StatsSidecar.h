@@ -0,0 +1,80 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# StatsSidecar.h: per-channel basic stats and histograms cached on disk and shared by sessions
+
+#ifndef CARTA_BACKEND_IMAGEDATA_STATSSIDECAR_H_
+#define CARTA_BACKEND_IMAGEDATA_STATSSIDECAR_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace carta {
+
+class StatsSidecar {
+public:
+    struct ChannelStats {
+        uint64_t num_pixels;
+        double sum;
+        double sum_sq;
+        double min;
+        double max;
+        std::vector<int> histogram_bins;
+    };
+
+    // Histograms are stored for a fixed number of bins, the frame's automatic bin size
+    StatsSidecar(const std::string& image_filename, const std::string& hdu, size_t depth, size_t num_stokes, int num_bins);
+    ~StatsSidecar();
+
+    // Opens or creates the file; returns false if the sidecar cannot be used
+    bool Open();
+
+    // Channel and cube stats are written once, when first calculated, and never change
+    bool Read(size_t stokes, size_t z, ChannelStats& stats);
+    bool Write(size_t stokes, size_t z, const ChannelStats& stats);
+    bool ReadCube(size_t stokes, ChannelStats& stats);
+    bool WriteCube(size_t stokes, const ChannelStats& stats);
+
+    int NumBins() const {
+        return _num_bins;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        int32_t num_bins;
+        int64_t depth;
+        int64_t num_stokes;
+    };
+
+    // Fixed-size record per channel, and one for the cube after the channels of each stokes: valid flag, stats, then histogram bins
+    struct Record {
+        uint64_t valid;
+        uint64_t num_pixels;
+        double sum;
+        double sum_sq;
+        double min;
+        double max;
+    };
+
+    bool ReadRecord(size_t stokes, size_t index, ChannelStats& stats);
+    bool WriteRecord(size_t stokes, size_t index, const ChannelStats& stats);
+    off_t RecordOffset(size_t stokes, size_t index) const;
+    size_t RecordSize() const;
+
+    std::string _sidecar_filename;
+    size_t _depth, _num_stokes;
+    int _num_bins;
+    int _fd;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGEDATA_STATSSIDECAR_H_
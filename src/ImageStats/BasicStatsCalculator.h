@@ -8,12 +8,21 @@
 #define CARTA_BACKEND_IMAGESTATS_BASICSTATSCALCULATOR_H_
 
 #include <algorithm>
+#include <type_traits>
+#include <vector>
 
 #include <tbb/blocked_range2d.h>
 #include <tbb/blocked_range3d.h>
 
+// Number of values accumulated per call to the float stats kernel
+#define BASIC_STATS_BLOCK_SIZE 4096
+
 namespace carta {
 
+// Adds the finite values of a float array to the running stats, using the SIMD version selected at run time
+void AccumulateFiniteStats(
+    const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares);
+
 template <typename T>
 struct BasicStats {
     size_t num_pixels;
@@ -58,6 +58,11 @@ BasicStatsCalculator<T>::BasicStatsCalculator(BasicStatsCalculator<T>& mm, tbb::
 
 template <typename T>
 void BasicStatsCalculator<T>::operator()(const tbb::blocked_range<size_t>& r) {
+    if constexpr (std::is_same<T, float>::value) {
+        AccumulateFiniteStats(_data.data() + r.begin(), r.size(), _min_val, _max_val, _num_pixels, _sum, _sum_squares);
+        return;
+    }
+
     T t_min = _min_val;
     T t_max = _max_val;
     for (size_t i = r.begin(); i != r.end(); ++i) {
@@ -80,6 +85,17 @@ void BasicStatsCalculator<T>::operator()(const tbb::blocked_range<size_t>& r) {
 
 template <typename T>
 void BasicStatsCalculator<T>::reduce(const size_t start, const size_t end) {
+    if constexpr (std::is_same<T, float>::value) {
+        const int64_t num_blocks = (end - start + BASIC_STATS_BLOCK_SIZE - 1) / BASIC_STATS_BLOCK_SIZE;
+#pragma omp parallel for reduction(min: _min_val) reduction(max:_max_val) reduction(+:_num_pixels) reduction(+:_sum) reduction(+:_sum_squares)
+        for (int64_t block = 0; block < num_blocks; block++) {
+            size_t block_start = start + block * BASIC_STATS_BLOCK_SIZE;
+            size_t block_length = std::min((size_t)BASIC_STATS_BLOCK_SIZE, end - block_start);
+            AccumulateFiniteStats(_data.data() + block_start, block_length, _min_val, _max_val, _num_pixels, _sum, _sum_squares);
+        }
+        return;
+    }
+
     size_t i;
 #pragma omp parallel for private(i) shared(_data) reduction(min: _min_val) reduction(max:_max_val) reduction(+:_num_pixels) reduction(+:_sum) reduction(+:_sum_squares)
     for (i = start; i < end; i++) {
@@ -0,0 +1,129 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "BitMask.h"
+
+#include <algorithm>
+
+#include <casacore/casa/Exceptions/Error.h>
+
+using namespace carta;
+
+BitMask::BitMask(const casacore::IPosition& shape, bool value)
+    : _shape(shape), _size(shape.empty() ? 0 : shape.product()), _words((_size + 63) / 64, value ? ~(uint64_t)0 : 0) {
+    if (value && (_size & 63)) {
+        _words.back() = ((uint64_t)1 << (_size & 63)) - 1;
+    }
+}
+
+BitMask BitMask::FromArray(const casacore::Array<bool>& array) {
+    BitMask mask(array.shape());
+    bool delete_storage;
+    const bool* data = array.getStorage(delete_storage);
+    for (size_t word = 0; word < mask._words.size(); ++word) {
+        size_t begin = word << 6;
+        size_t end = std::min(begin + 64, mask._size);
+        uint64_t bits(0);
+        for (size_t i = begin; i < end; ++i) {
+            bits |= (uint64_t)data[i] << (i - begin);
+        }
+        mask._words[word] = bits;
+    }
+    array.freeStorage(data, delete_storage);
+    return mask;
+}
+
+casacore::Array<bool> BitMask::ToArray() const {
+    casacore::Array<bool> array(_shape);
+    bool* data = array.data(); // new arrays are contiguous
+    for (size_t i = 0; i < _size; ++i) {
+        data[i] = Get(i);
+    }
+    return array;
+}
+
+void BitMask::GetSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) const {
+    casacore::IPosition start(section.start()), length(section.length()), stride(section.stride());
+    buffer.resize(length);
+    if (length.empty() || (length.product() == 0)) {
+        return;
+    }
+
+    // Rows along the first axis; position is the row of the buffer, with its first axis unused
+    bool delete_storage;
+    bool* data = buffer.getStorage(delete_storage);
+    size_t ndim = length.size();
+    size_t row_length = length(0);
+    size_t num_rows = length.product() / row_length;
+    casacore::IPosition position(ndim, 0);
+    for (size_t row = 0; row < num_rows; ++row) {
+        size_t index(0), step(1);
+        for (size_t axis = 0; axis < ndim; ++axis) {
+            index += (start(axis) + position(axis) * stride(axis)) * step;
+            step *= _shape(axis);
+        }
+        bool* row_data = data + row * row_length;
+        for (size_t i = 0; i < row_length; ++i) {
+            row_data[i] = Get(index + i * stride(0));
+        }
+
+        for (size_t axis = 1; axis < ndim; ++axis) {
+            if (++position(axis) < length(axis)) {
+                break;
+            }
+            position(axis) = 0;
+        }
+    }
+    buffer.putStorage(data, delete_storage);
+}
+
+void BitMask::SetRange(size_t begin, size_t end) {
+    if (begin >= end) {
+        return;
+    }
+    size_t first = begin >> 6, last = (end - 1) >> 6;
+    uint64_t first_bits = ~(uint64_t)0 << (begin & 63);
+    uint64_t last_bits = ~(uint64_t)0 >> (63 - ((end - 1) & 63));
+    if (first == last) {
+        _words[first] |= first_bits & last_bits;
+        return;
+    }
+    _words[first] |= first_bits;
+    std::fill(_words.begin() + first + 1, _words.begin() + last, ~(uint64_t)0);
+    _words[last] |= last_bits;
+}
+
+size_t BitMask::Count() const {
+    size_t count(0);
+    for (uint64_t word : _words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+BitMaskLattice::BitMaskLattice(std::shared_ptr<const BitMask> mask) : _mask(mask) {}
+
+casacore::Lattice<bool>* BitMaskLattice::clone() const {
+    return new BitMaskLattice(_mask);
+}
+
+casacore::IPosition BitMaskLattice::shape() const {
+    return _mask->Shape();
+}
+
+casacore::Bool BitMaskLattice::isWritable() const {
+    return false;
+}
+
+casacore::Bool BitMaskLattice::doGetSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) {
+    _mask->GetSlice(buffer, section);
+    return false;
+}
+
+void BitMaskLattice::doPutSlice(
+    const casacore::Array<bool>& /*buffer*/, const casacore::IPosition& /*where*/, const casacore::IPosition& /*stride*/) {
+    throw(casacore::AipsError("BitMaskLattice is not writable"));
+}
@@ -0,0 +1,107 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# BitMask.h: pixel mask with one bit per pixel, and its conversions to casacore masks
+
+#ifndef CARTA_BACKEND_IMAGESTATS_BITMASK_H_
+#define CARTA_BACKEND_IMAGESTATS_BITMASK_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <casacore/casa/Arrays/Array.h>
+#include <casacore/casa/Arrays/IPosition.h>
+#include <casacore/casa/Arrays/Slicer.h>
+#include <casacore/lattices/Lattices/Lattice.h>
+
+namespace carta {
+
+// Pixels in array order (x fastest) packed into 64-bit words, bit i % 64 of word i / 64. Bits past the last pixel are zero, so
+// that loops over the words need no tail handling.
+class BitMask {
+public:
+    BitMask() = default;
+    BitMask(const casacore::IPosition& shape, bool value = false);
+
+    // Conversions at casacore boundaries
+    static BitMask FromArray(const casacore::Array<bool>& array);
+    casacore::Array<bool> ToArray() const;
+    // Section of the mask, as for Lattice::getSlice
+    void GetSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) const;
+
+    const casacore::IPosition& Shape() const {
+        return _shape;
+    }
+    size_t Size() const {
+        return _size;
+    }
+    bool Empty() const {
+        return _size == 0;
+    }
+
+    bool Get(size_t index) const {
+        return (_words[index >> 6] >> (index & 63)) & 1;
+    }
+    void Set(size_t index, bool value) {
+        uint64_t bit = (uint64_t)1 << (index & 63);
+        _words[index >> 6] = value ? (_words[index >> 6] | bit) : (_words[index >> 6] & ~bit);
+    }
+    // Sets the pixels [begin, end), a word at a time
+    void SetRange(size_t begin, size_t end);
+    // Number of pixels set
+    size_t Count() const;
+
+    const std::vector<uint64_t>& Words() const {
+        return _words;
+    }
+    std::vector<uint64_t>& Words() {
+        return _words;
+    }
+
+    // Calls f(index) for each pixel set in [begin, end), in order, skipping empty words
+    template <typename F>
+    void ForEachSet(size_t begin, size_t end, F f) const {
+        for (size_t word = begin >> 6; (word << 6) < end; ++word) {
+            uint64_t bits = _words[word];
+            if (word == (begin >> 6)) {
+                bits &= ~(uint64_t)0 << (begin & 63);
+            }
+            while (bits) {
+                size_t index = (word << 6) + __builtin_ctzll(bits);
+                if (index >= end) {
+                    return;
+                }
+                f(index);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    casacore::IPosition _shape;
+    size_t _size = 0;
+    std::vector<uint64_t> _words;
+};
+
+// Read-only lattice of a shared bit mask, for casacore image pixel masks
+class BitMaskLattice : public casacore::Lattice<bool> {
+public:
+    BitMaskLattice(std::shared_ptr<const BitMask> mask);
+
+    casacore::Lattice<bool>* clone() const override;
+    casacore::IPosition shape() const override;
+    casacore::Bool isWritable() const override;
+    casacore::Bool doGetSlice(casacore::Array<bool>& buffer, const casacore::Slicer& section) override;
+    void doPutSlice(const casacore::Array<bool>& buffer, const casacore::IPosition& where, const casacore::IPosition& stride) override;
+
+private:
+    std::shared_ptr<const BitMask> _mask;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGESTATS_BITMASK_H_
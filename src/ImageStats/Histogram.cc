@@ -10,11 +10,84 @@
 #include <algorithm>
 #include <cmath>
 
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "DataStream/SimdDispatch.h"
+#include "GpuCompute.h"
 #include "Logger/Logger.h"
 #include "Threading.h"
 
+// Number of values binned per call to the fill kernel
+#define HISTOGRAM_FILL_BLOCK_SIZE 4096
+
 using namespace carta;
 
+typedef void (*FillBinsKernel)(const float*, int64_t, float, float, float, size_t, int64_t*);
+
+static void FillBinsScalar(
+    const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins) {
+    for (int64_t i = 0; i < length; i++) {
+        auto val = data[i];
+        if (min_val <= val && val <= max_val) {
+            size_t bin_number = std::clamp((size_t)((val - min_val) / bin_width), (size_t)0, num_bins - 1);
+            bins[bin_number]++;
+        }
+    }
+}
+
+#ifdef CARTA_X86_SIMD
+// Computes the bin numbers of eight values at a time, with the same rounding and clamping as the scalar version
+CARTA_TARGET_AVX static void FillBinsAVX(
+    const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins) {
+    const __m256 v_min = _mm256_set1_ps(min_val);
+    const __m256 v_max = _mm256_set1_ps(max_val);
+    const __m256 v_width = _mm256_set1_ps(bin_width);
+    const __m256 v_zero = _mm256_setzero_ps();
+    const __m256 v_last_bin = _mm256_set1_ps(num_bins - 1);
+    alignas(32) int32_t bin_numbers[8];
+
+    const int64_t blocked_length = 8 * (length / 8);
+    int64_t i = 0;
+    for (; i < blocked_length; i += 8) {
+        __m256 val = _mm256_loadu_ps(data + i);
+        // Ordered comparisons exclude NaNs
+        __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(v_min, val, _CMP_LE_OQ), _mm256_cmp_ps(val, v_max, _CMP_LE_OQ));
+        uint32_t mask = _mm256_movemask_ps(in_range);
+        if (!mask) {
+            continue;
+        }
+        // A NaN bin number (zero bin width) is clamped to the last bin, as in the scalar version
+        __m256 bin = _mm256_div_ps(_mm256_sub_ps(val, v_min), v_width);
+        bin = _mm256_min_ps(_mm256_max_ps(v_zero, bin), v_last_bin);
+        _mm256_store_si256((__m256i*)bin_numbers, _mm256_cvttps_epi32(bin));
+        while (mask) {
+            bins[bin_numbers[__builtin_ctz(mask)]]++;
+            mask &= mask - 1;
+        }
+    }
+    FillBinsScalar(data + i, length - i, min_val, max_val, bin_width, num_bins, bins);
+}
+#endif
+
+static FillBinsKernel SelectFillBinsKernel() {
+#ifdef CARTA_X86_SIMD
+    if (GetSimdLevel() >= SimdLevel::Avx) {
+        return FillBinsAVX;
+    }
+#endif
+    return FillBinsScalar;
+}
+
+void Histogram::FillBins(
+    const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins) {
+    static const FillBinsKernel kernel = SelectFillBinsKernel();
+    kernel(data, length, min_val, max_val, bin_width, num_bins, bins);
+}
+
 Histogram::Histogram(int num_bins, float min_value, float max_value, const std::vector<float>& data)
     : _bin_width((max_value - min_value) / num_bins),
       _min_val(min_value),
@@ -47,7 +120,18 @@ bool Histogram::Add(const Histogram& h) {
 
 void Histogram::Fill(const std::vector<float>& data) {
     std::vector<int64_t> temp_bins;
-    const auto num_elements = data.size();
+    const int64_t num_elements = data.size();
+    if (GpuCompute::Use(num_elements)) {
+        temp_bins.resize(GetNbins(), 0);
+        if (GpuCompute::FillBins(data.data(), num_elements, _min_val, _max_val, _bin_width, temp_bins.size(), temp_bins.data())) {
+            for (size_t i = 0; i < temp_bins.size(); i++) {
+                _histogram_bins[i] += temp_bins[i];
+            }
+            return;
+        }
+        temp_bins.clear();
+    }
+    const int64_t num_blocks = (num_elements + HISTOGRAM_FILL_BLOCK_SIZE - 1) / HISTOGRAM_FILL_BLOCK_SIZE;
     const size_t num_bins = GetNbins();
     ThreadManager::ApplyThreadLimit();
 #pragma omp parallel
@@ -57,12 +141,11 @@ void Histogram::Fill(const std::vector<float>& data) {
 #pragma omp single
         { temp_bins.resize(num_bins * num_threads); }
 #pragma omp for
-        for (int64_t i = 0; i < num_elements; i++) {
-            auto val = data[i];
-            if (_min_val <= val && val <= _max_val) {
-                size_t bin_number = std::clamp((size_t)((val - _min_val) / _bin_width), (size_t)0, num_bins - 1);
-                temp_bins[thread_index * num_bins + bin_number]++;
-            }
+        for (int64_t i = 0; i < num_blocks; i++) {
+            int64_t block_start = i * HISTOGRAM_FILL_BLOCK_SIZE;
+            int64_t block_length = std::min((int64_t)HISTOGRAM_FILL_BLOCK_SIZE, num_elements - block_start);
+            auto thread_bins = temp_bins.data() + thread_index * num_bins;
+            FillBins(data.data() + block_start, block_length, _min_val, _max_val, _bin_width, num_bins, thread_bins);
         }
 #pragma omp for
         for (int64_t i = 0; i < num_bins; i++) {
@@ -94,3 +177,19 @@ void Histogram::SetHistogramBins(const std::vector<int>& bins) {
     }
     _histogram_bins = bins;
 }
+
+bool Histogram::Rebin(size_t num_bins, Histogram& histogram) const {
+    if ((num_bins == 0) || (GetNbins() % num_bins)) {
+        return false;
+    }
+    size_t group_size = GetNbins() / num_bins;
+    histogram._min_val = _min_val;
+    histogram._max_val = _max_val;
+    histogram._bin_width = (_max_val - _min_val) / num_bins;
+    histogram._bin_center = _min_val + (histogram._bin_width * 0.5);
+    histogram._histogram_bins.assign(num_bins, 0);
+    for (size_t i = 0; i < _histogram_bins.size(); ++i) {
+        histogram._histogram_bins[i / group_size] += _histogram_bins[i];
+    }
+    return true;
+}
@@ -7,6 +7,7 @@
 #ifndef CARTA_BACKEND_IMAGESTATS_HISTOGRAM_H_
 #define CARTA_BACKEND_IMAGESTATS_HISTOGRAM_H_
 
+#include <cstdint>
 #include <vector>
 
 #include <tbb/blocked_range2d.h>
@@ -52,6 +53,13 @@ public:
     }
 
     void SetHistogramBins(const std::vector<int>&);
+
+    // Histogram of num_bins bins over the same range, each the sum of a group of bins of this one, when num_bins divides the
+    // number of bins. The counts are those of a fill with num_bins bins, except for values within rounding of a bin edge.
+    bool Rebin(size_t num_bins, Histogram& histogram) const;
+
+    // Adds the values in [min_val, max_val] to the bin counts, using the SIMD version selected at run time
+    static void FillBins(const float* data, int64_t length, float min_val, float max_val, float bin_width, size_t num_bins, int64_t* bins);
 };
 
 } // namespace carta
@@ -0,0 +1,183 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# QuantileSketch.cc: KLL sketch for approximate percentiles
+
+#include "QuantileSketch.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "Threading.h"
+
+// Arrays smaller than this are added by a single thread
+#define QUANTILE_SKETCH_MIN_PARALLEL 262144
+
+using namespace carta;
+
+QuantileSketch::QuantileSketch(int k)
+    : _k(std::max(k, 8)),
+      _count(0),
+      _size(0),
+      _min_val(std::numeric_limits<float>::max()),
+      _max_val(std::numeric_limits<float>::lowest()),
+      _levels(1) {
+    UpdateCapacities();
+}
+
+void QuantileSketch::Add(float value) {
+    if (!std::isfinite(value)) {
+        return;
+    }
+
+    _min_val = std::min(_min_val, value);
+    _max_val = std::max(_max_val, value);
+    _levels[0].push_back(value);
+    ++_count;
+    if (++_size >= _max_size) {
+        Compress();
+    }
+}
+
+void QuantileSketch::Add(const float* data, size_t length) {
+    if (length < QUANTILE_SKETCH_MIN_PARALLEL) {
+        for (size_t i = 0; i < length; ++i) {
+            Add(data[i]);
+        }
+        return;
+    }
+
+    // Sketch a contiguous block per thread, then join in thread order so the result does not depend on timing
+    std::vector<QuantileSketch> thread_sketches;
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel
+    {
+        int num_threads = omp_get_num_threads();
+        int thread_index = omp_get_thread_num();
+#pragma omp single
+        thread_sketches.resize(num_threads, QuantileSketch(_k));
+
+        size_t block_size = (length + num_threads - 1) / num_threads;
+        size_t start = std::min(thread_index * block_size, length);
+        size_t end = std::min(start + block_size, length);
+        auto& sketch = thread_sketches[thread_index];
+        for (size_t i = start; i < end; ++i) {
+            sketch.Add(data[i]);
+        }
+    }
+
+    for (auto& sketch : thread_sketches) {
+        join(sketch);
+    }
+}
+
+void QuantileSketch::join(const QuantileSketch& other) {
+    if (other._count == 0) {
+        return;
+    }
+
+    while (_levels.size() < other._levels.size()) {
+        _levels.emplace_back();
+    }
+    for (size_t level = 0; level < other._levels.size(); ++level) {
+        _levels[level].insert(_levels[level].end(), other._levels[level].begin(), other._levels[level].end());
+    }
+    _count += other._count;
+    _size += other._size;
+    _min_val = std::min(_min_val, other._min_val);
+    _max_val = std::max(_max_val, other._max_val);
+
+    UpdateCapacities();
+    while (_size >= _max_size) {
+        Compress();
+    }
+}
+
+float QuantileSketch::Quantile(double fraction) const {
+    return Percentiles({(float)(fraction * 100.0)})[0];
+}
+
+std::vector<float> QuantileSketch::Percentiles(const std::vector<float>& ranks) const {
+    std::vector<float> percentiles(ranks.size(), std::numeric_limits<float>::quiet_NaN());
+    if (_count == 0) {
+        return percentiles;
+    }
+
+    // Retained values are weighted by 2^level; sort them once for all ranks
+    std::vector<std::pair<float, uint64_t>> weighted_values;
+    weighted_values.reserve(_size);
+    for (size_t level = 0; level < _levels.size(); ++level) {
+        for (float value : _levels[level]) {
+            weighted_values.emplace_back(value, (uint64_t)1 << level);
+        }
+    }
+    std::sort(weighted_values.begin(), weighted_values.end());
+
+    std::vector<uint64_t> cumulative_weight(weighted_values.size());
+    uint64_t total_weight(0);
+    for (size_t i = 0; i < weighted_values.size(); ++i) {
+        total_weight += weighted_values[i].second;
+        cumulative_weight[i] = total_weight;
+    }
+
+    for (size_t i = 0; i < ranks.size(); ++i) {
+        if (ranks[i] <= 0.0) {
+            percentiles[i] = _min_val;
+        } else if (ranks[i] >= 100.0) {
+            percentiles[i] = _max_val;
+        } else {
+            uint64_t target = std::ceil(ranks[i] / 100.0 * total_weight);
+            auto it = std::lower_bound(cumulative_weight.begin(), cumulative_weight.end(), target);
+            size_t index = std::min((size_t)(it - cumulative_weight.begin()), weighted_values.size() - 1);
+            percentiles[i] = weighted_values[index].first;
+        }
+    }
+    return percentiles;
+}
+
+void QuantileSketch::UpdateCapacities() {
+    // Capacities shrink geometrically below the top level
+    size_t num_levels = _levels.size();
+    _capacities.resize(num_levels);
+    _num_compactions.resize(num_levels, 0);
+    _max_size = 0;
+    for (size_t level = 0; level < num_levels; ++level) {
+        size_t depth = num_levels - 1 - level;
+        _capacities[level] = std::max((size_t)std::ceil(_k * std::pow(2.0 / 3.0, depth)), (size_t)2);
+        _max_size += _capacities[level];
+    }
+}
+
+void QuantileSketch::Compress() {
+    // Compact the lowest full level, adding a level when the top one is full
+    for (size_t level = 0; level < _levels.size(); ++level) {
+        if (_levels[level].size() >= _capacities[level]) {
+            if (level + 1 == _levels.size()) {
+                _levels.emplace_back();
+                UpdateCapacities();
+            }
+            Compact(level);
+            return;
+        }
+    }
+}
+
+void QuantileSketch::Compact(size_t level) {
+    // Keep every other sorted value at twice the weight; an odd value out stays at this level
+    auto& values = _levels[level];
+    auto& next_values = _levels[level + 1];
+    std::sort(values.begin(), values.end());
+
+    size_t num_paired = values.size() & ~(size_t)1;
+    for (size_t i = (_num_compactions[level]++ & 1); i < num_paired; i += 2) {
+        next_values.push_back(values[i]);
+    }
+    _size -= num_paired / 2;
+    values.erase(values.begin(), values.begin() + num_paired);
+}
@@ -0,0 +1,56 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
+#define CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size of the top compactor; rank error is roughly 1.7/k
+#define QUANTILE_SKETCH_K 256
+
+namespace carta {
+
+// Mergeable KLL quantile sketch of the finite values in a plane or cube, for approximate percentiles
+// when the file has no precomputed values. Sketches of channels are joined like BasicStats.
+class QuantileSketch {
+public:
+    explicit QuantileSketch(int k = QUANTILE_SKETCH_K);
+
+    void Add(float value);
+    void Add(const float* data, size_t length); // multithreaded for large arrays
+    void join(const QuantileSketch& other);     // NOLINT
+
+    uint64_t Count() const {
+        return _count;
+    }
+
+    // Value at fraction (0-1) of the sorted data, NaN if empty
+    float Quantile(double fraction) const;
+    // Values at the given ranks in percent, as for the HDF5 PERCENTILE_RANKS
+    std::vector<float> Percentiles(const std::vector<float>& ranks) const;
+
+private:
+    void UpdateCapacities();
+    void Compress();
+    void Compact(size_t level);
+
+    int _k;
+    uint64_t _count;
+    size_t _size;     // retained values in all levels
+    size_t _max_size; // sum of level capacities
+    float _min_val;
+    float _max_val;
+    std::vector<std::vector<float>> _levels;
+    std::vector<size_t> _capacities;
+    std::vector<size_t> _num_compactions; // alternates which half of a level is kept, to avoid bias
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_IMAGESTATS_QUANTILESKETCH_H_
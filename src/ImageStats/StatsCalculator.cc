@@ -8,13 +8,127 @@
 
 #include "StatsCalculator.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#include <numeric>
 
 #include <casacore/casa/Arrays/ArrayMath.h>
 #include <casacore/images/Images/ImageStatistics.h>
 
+#ifdef _ARM_ARCH_
+#include <sse2neon/sse2neon.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "DataStream/SimdDispatch.h"
+#include "GpuCompute.h"
+#include "Threading.h"
+
+typedef void (*FiniteStatsKernel)(const float*, size_t, float&, float&, size_t&, double&, double&);
+
+static void AccumulateFiniteStatsScalar(
+    const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    float t_min = min_val;
+    float t_max = max_val;
+    for (size_t i = 0; i < length; ++i) {
+        float val = data[i];
+        if (std::isfinite(val)) {
+            if (val < t_min) {
+                t_min = val;
+            }
+            if (val > t_max) {
+                t_max = val;
+            }
+            num_pixels++;
+            sum += val;
+            sum_squares += val * val;
+        }
+    }
+    min_val = t_min;
+    max_val = t_max;
+}
+
+#ifdef CARTA_X86_SIMD
+// Sums are accumulated in double precision, with squares computed in single precision as in the scalar version
+CARTA_TARGET_AVX static void AccumulateFiniteStatsAVX(
+    const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 v_min = _mm256_set1_ps(min_val);
+    __m256 v_max = _mm256_set1_ps(max_val);
+    __m256d v_sum = _mm256_setzero_pd();
+    __m256d v_sum_squares = _mm256_setzero_pd();
+    size_t count = 0;
+
+    const size_t blocked_length = 8 * (length / 8);
+    size_t i = 0;
+    for (; i < blocked_length; i += 8) {
+        __m256 val = _mm256_loadu_ps(data + i);
+        // Ordered comparison is false for NaN as well as infinity
+        __m256 finite = _mm256_cmp_ps(_mm256_and_ps(val, abs_mask), inf, _CMP_LT_OQ);
+        count += __builtin_popcount(_mm256_movemask_ps(finite));
+        v_min = _mm256_blendv_ps(v_min, _mm256_min_ps(v_min, val), finite);
+        v_max = _mm256_blendv_ps(v_max, _mm256_max_ps(v_max, val), finite);
+        val = _mm256_and_ps(val, finite);
+        __m256 val_squared = _mm256_mul_ps(val, val);
+        v_sum = _mm256_add_pd(v_sum, _mm256_cvtps_pd(_mm256_castps256_ps128(val)));
+        v_sum = _mm256_add_pd(v_sum, _mm256_cvtps_pd(_mm256_extractf128_ps(val, 1)));
+        v_sum_squares = _mm256_add_pd(v_sum_squares, _mm256_cvtps_pd(_mm256_castps256_ps128(val_squared)));
+        v_sum_squares = _mm256_add_pd(v_sum_squares, _mm256_cvtps_pd(_mm256_extractf128_ps(val_squared, 1)));
+    }
+
+    alignas(32) float mins[8], maxs[8];
+    alignas(32) double sums[4], sums_squares[4];
+    _mm256_store_ps(mins, v_min);
+    _mm256_store_ps(maxs, v_max);
+    _mm256_store_pd(sums, v_sum);
+    _mm256_store_pd(sums_squares, v_sum_squares);
+    for (int j = 0; j < 8; ++j) {
+        min_val = std::min(min_val, mins[j]);
+        max_val = std::max(max_val, maxs[j]);
+    }
+    for (int j = 0; j < 4; ++j) {
+        sum += sums[j];
+        sum_squares += sums_squares[j];
+    }
+    num_pixels += count;
+    AccumulateFiniteStatsScalar(data + i, length - i, min_val, max_val, num_pixels, sum, sum_squares);
+}
+#endif
+
+static FiniteStatsKernel SelectFiniteStatsKernel() {
+#ifdef CARTA_X86_SIMD
+    if (carta::GetSimdLevel() >= carta::SimdLevel::Avx) {
+        return AccumulateFiniteStatsAVX;
+    }
+#endif
+    return AccumulateFiniteStatsScalar;
+}
+
+void carta::AccumulateFiniteStats(
+    const float* data, size_t length, float& min_val, float& max_val, size_t& num_pixels, double& sum, double& sum_squares) {
+    static const FiniteStatsKernel kernel = SelectFiniteStatsKernel();
+    kernel(data, length, min_val, max_val, num_pixels, sum, sum_squares);
+}
+
 void CalcBasicStats(const std::vector<float>& data, BasicStats<float>& stats) {
+    float min_val, max_val;
+    size_t num_pixels;
+    double sum, sum_squares;
+    if (GpuCompute::FiniteStats(data.data(), data.size(), min_val, max_val, num_pixels, sum, sum_squares)) {
+        // As BasicStatsCalculator::GetStats
+        if (num_pixels > 0) {
+            double stddev = num_pixels > 1 ? sqrt((sum_squares - (sum * sum / num_pixels)) / (num_pixels - 1)) : NAN;
+            double rms = sqrt(sum_squares / num_pixels);
+            stats = BasicStats<float>{num_pixels, sum, sum / num_pixels, stddev, min_val, max_val, rms, sum_squares};
+        } else {
+            stats = BasicStats<float>{num_pixels, sum, NAN, NAN, min_val, max_val, NAN, sum_squares};
+        }
+        return;
+    }
+
     // Calculate stats in BasicStats struct
     BasicStatsCalculator<float> mm(data);
     mm.reduce(0, data.size());
@@ -30,6 +144,141 @@ carta::Histogram CalcHistogram(int num_bins, const BasicStats<float>& stats, con
     }
 }
 
+static bool SampleRange(const std::vector<float>& data, float& min_val, float& max_val) {
+    // Range of the finite values in one run of 16 values out of every FUSED_HISTOGRAM_SAMPLE_STRIDE runs
+    const int64_t sample_step = 16 * FUSED_HISTOGRAM_SAMPLE_STRIDE;
+    const int64_t num_samples = (data.size() + sample_step - 1) / sample_step;
+    const int64_t num_elements = data.size();
+    min_val = std::numeric_limits<float>::max();
+    max_val = std::numeric_limits<float>::lowest();
+
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for reduction(min : min_val) reduction(max : max_val)
+    for (int64_t sample = 0; sample < num_samples; sample++) {
+        int64_t start = sample * sample_step;
+        int64_t end = std::min(start + 16, num_elements);
+        for (int64_t i = start; i < end; i++) {
+            float val = data[i];
+            if (std::isfinite(val)) {
+                min_val = std::min(min_val, val);
+                max_val = std::max(max_val, val);
+            }
+        }
+    }
+    return min_val <= max_val;
+}
+
+void CalcStatsAndHistogram(const std::vector<float>& data, int num_bins, BasicStats<float>& stats, carta::Histogram& hist) {
+    float sample_min, sample_max;
+    if ((data.size() < FUSED_HISTOGRAM_MIN_PIXELS) || GpuCompute::Use(data.size()) || !SampleRange(data, sample_min, sample_max) ||
+        (sample_min == sample_max)) {
+        // Separate passes for small or degenerate data, or on the GPU
+        CalcBasicStats(data, stats);
+        hist = CalcHistogram(num_bins, stats, data);
+        return;
+    }
+
+    // Stats and provisional histogram over the sampled range in one pass, reading each block again while it is in cache.
+    // Finite values outside the sampled range are kept for exact binning once the data range is known.
+    const size_t num_fine_bins = std::min((size_t)num_bins * FUSED_HISTOGRAM_FINE_BINS_PER_BIN, (size_t)FUSED_HISTOGRAM_MAX_FINE_BINS);
+    const float fine_bin_width = (sample_max - sample_min) / num_fine_bins;
+    const int64_t num_elements = data.size();
+    const int64_t num_blocks = (num_elements + BASIC_STATS_BLOCK_SIZE - 1) / BASIC_STATS_BLOCK_SIZE;
+
+    float min_val = std::numeric_limits<float>::max();
+    float max_val = std::numeric_limits<float>::lowest();
+    size_t num_pixels(0);
+    double sum(0), sum_squares(0);
+    std::vector<int64_t> fine_bins(num_fine_bins, 0);
+    std::vector<float> outliers;
+    bool too_many_outliers(false);
+
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel
+    {
+        float t_min = std::numeric_limits<float>::max();
+        float t_max = std::numeric_limits<float>::lowest();
+        size_t t_num_pixels(0);
+        double t_sum(0), t_sum_squares(0);
+        std::vector<int64_t> t_fine_bins(num_fine_bins, 0);
+        std::vector<float> t_outliers;
+        bool t_too_many_outliers(false);
+
+#pragma omp for
+        for (int64_t block = 0; block < num_blocks; block++) {
+            const float* block_data = data.data() + block * BASIC_STATS_BLOCK_SIZE;
+            int64_t block_length = std::min((int64_t)BASIC_STATS_BLOCK_SIZE, num_elements - block * BASIC_STATS_BLOCK_SIZE);
+            float block_min = std::numeric_limits<float>::max();
+            float block_max = std::numeric_limits<float>::lowest();
+            AccumulateFiniteStats(block_data, block_length, block_min, block_max, t_num_pixels, t_sum, t_sum_squares);
+            Histogram::FillBins(block_data, block_length, sample_min, sample_max, fine_bin_width, num_fine_bins, t_fine_bins.data());
+
+            if (((block_min < sample_min) || (block_max > sample_max)) && !t_too_many_outliers) {
+                for (int64_t i = 0; i < block_length; i++) {
+                    float val = block_data[i];
+                    if (std::isfinite(val) && ((val < sample_min) || (val > sample_max))) {
+                        t_outliers.push_back(val);
+                    }
+                }
+                t_too_many_outliers = t_outliers.size() > FUSED_HISTOGRAM_MAX_OUTLIERS;
+            }
+            t_min = std::min(t_min, block_min);
+            t_max = std::max(t_max, block_max);
+        }
+
+#pragma omp critical
+        {
+            min_val = std::min(min_val, t_min);
+            max_val = std::max(max_val, t_max);
+            num_pixels += t_num_pixels;
+            sum += t_sum;
+            sum_squares += t_sum_squares;
+            for (size_t i = 0; i < num_fine_bins; i++) {
+                fine_bins[i] += t_fine_bins[i];
+            }
+            outliers.insert(outliers.end(), t_outliers.begin(), t_outliers.end());
+            too_many_outliers |= t_too_many_outliers;
+        }
+    }
+
+    // Derive mean, sigma and rms as BasicStatsCalculator does
+    stats = BasicStats<float>();
+    BasicStats<float> sums(num_pixels, sum, 0, 0, min_val, max_val, 0, sum_squares);
+    stats.join(sums);
+
+    if (too_many_outliers) {
+        // The sample missed too much of the data range; bin the data directly
+        hist = CalcHistogram(num_bins, stats, data);
+        return;
+    }
+
+    // Rebin: the count below each bin edge is interpolated linearly within the provisional bin containing the edge
+    std::vector<int64_t> cumulative(num_fine_bins + 1, 0);
+    std::partial_sum(fine_bins.begin(), fine_bins.end(), cumulative.begin() + 1);
+    auto count_below = [&](double edge) -> double {
+        double position = (edge - sample_min) / fine_bin_width;
+        if (position <= 0) {
+            return 0;
+        } else if (position >= num_fine_bins) {
+            return cumulative[num_fine_bins];
+        }
+        size_t fine_bin = position;
+        return cumulative[fine_bin] + (position - fine_bin) * fine_bins[fine_bin];
+    };
+
+    // Outliers are binned exactly, then the rebinned provisional counts are added
+    hist = carta::Histogram(num_bins, min_val, max_val, outliers);
+    std::vector<int> bins = hist.GetHistogramBins();
+    const double bin_width = ((double)max_val - min_val) / num_bins;
+    int64_t previous_count(0);
+    for (int i = 0; i < num_bins; i++) {
+        int64_t count = (i == num_bins - 1) ? cumulative[num_fine_bins] : std::llround(count_below(min_val + (i + 1) * bin_width));
+        bins[i] += count - previous_count;
+        previous_count = count;
+    }
+    hist.SetHistogramBins(bins);
+}
+
 bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
     const casacore::ImageInterface<float>& image, bool per_channel) {
     // Use ImageStatistics to fill statistics values according to type;
@@ -171,3 +420,203 @@ bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_valu
 
     return true;
 }
+
+double RegionStatsValue(CARTA::StatsType stats_type, double num_pixels, double sum, double sum_sq, double min_val, double max_val,
+    double beam_area) {
+    // All values are NaN if there are no valid pixels
+    if (!(num_pixels > 0)) {
+        return nan("");
+    }
+
+    switch (stats_type) {
+        case CARTA::StatsType::NumPixels:
+            return num_pixels;
+        case CARTA::StatsType::Sum:
+            return sum;
+        case CARTA::StatsType::FluxDensity:
+            return sum / beam_area;
+        case CARTA::StatsType::Mean:
+            return sum / num_pixels;
+        case CARTA::StatsType::RMS:
+            return sqrt(sum_sq / num_pixels);
+        case CARTA::StatsType::Sigma:
+            return num_pixels > 1 ? sqrt((sum_sq - (sum * sum / num_pixels)) / (num_pixels - 1)) : 0;
+        case CARTA::StatsType::SumSq:
+            return sum_sq;
+        case CARTA::StatsType::Min:
+            return min_val;
+        case CARTA::StatsType::Max:
+            return max_val;
+        case CARTA::StatsType::Extrema:
+            return (fabs(min_val) > fabs(max_val) ? min_val : max_val);
+        default:
+            return nan("");
+    }
+}
+
+// Sums of the finite values in a block, with the first positions of the min and max
+struct RegionStatsBlock {
+    size_t num_pixels = 0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    float min_val = std::numeric_limits<float>::max();
+    float max_val = std::numeric_limits<float>::lowest();
+    size_t min_index = 0;
+    size_t max_index = 0;
+
+    void Accumulate(const std::vector<float>& data, size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i) {
+            float value = data[i];
+            if (std::isfinite(value)) {
+                double dbl_value(value);
+                ++num_pixels;
+                sum += dbl_value;
+                sum_sq += dbl_value * dbl_value;
+                if (value < min_val) {
+                    min_val = value;
+                    min_index = i;
+                }
+                if (value > max_val) {
+                    max_val = value;
+                    max_index = i;
+                }
+            }
+        }
+    }
+
+    void join(const RegionStatsBlock& other) { // NOLINT
+        // Other block follows this one, so ties keep the first position
+        num_pixels += other.num_pixels;
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+        if (other.min_val < min_val) {
+            min_val = other.min_val;
+            min_index = other.min_index;
+        }
+        if (other.max_val > max_val) {
+            max_val = other.max_val;
+            max_index = other.max_index;
+        }
+    }
+};
+
+bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
+    const std::vector<float>& data, const casacore::IPosition& data_shape, const casacore::IPosition& blc, double beam_area,
+    bool per_channel) {
+    // Results match CalcStatsValues for an image: one value per xy plane if per_channel, else one value over all data
+    if (data.empty() || (data_shape.size() < 2) || (data.size() != (size_t)data_shape.product())) {
+        return false;
+    }
+
+    const size_t plane_size = per_channel ? data_shape(0) * data_shape(1) : data.size();
+    const size_t num_planes = data.size() / plane_size;
+    const size_t blocks_per_plane = (plane_size + REGION_STATS_BLOCK_SIZE - 1) / REGION_STATS_BLOCK_SIZE;
+    const int64_t num_blocks = num_planes * blocks_per_plane;
+
+    std::vector<RegionStatsBlock> blocks(num_blocks);
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < num_blocks; ++i) {
+        size_t plane_start = (i / blocks_per_plane) * plane_size;
+        size_t start = plane_start + (i % blocks_per_plane) * REGION_STATS_BLOCK_SIZE;
+        size_t end = std::min(start + REGION_STATS_BLOCK_SIZE, plane_start + plane_size);
+        blocks[i].Accumulate(data, start, end);
+    }
+
+    std::vector<RegionStatsBlock> planes(num_planes);
+    for (size_t plane = 0; plane < num_planes; ++plane) {
+        for (size_t block = 0; block < blocks_per_plane; ++block) {
+            planes[plane].join(blocks[plane * blocks_per_plane + block]);
+        }
+    }
+
+    for (auto carta_stats_type : requested_stats) {
+        std::vector<double> dbl_result;
+        switch (carta_stats_type) {
+            case CARTA::StatsType::Blc: {
+                for (auto value : blc.asStdVector()) {
+                    dbl_result.push_back(value);
+                }
+                break;
+            }
+            case CARTA::StatsType::Trc: {
+                for (auto value : (blc + data_shape - 1).asStdVector()) {
+                    dbl_result.push_back(value);
+                }
+                break;
+            }
+            case CARTA::StatsType::MinPos:
+            case CARTA::StatsType::MaxPos: {
+                if (!per_channel && planes[0].num_pixels) { // only works when no display axes
+                    size_t index = (carta_stats_type == CARTA::StatsType::MinPos ? planes[0].min_index : planes[0].max_index);
+                    for (auto value : (blc + casacore::toIPositionInArray(index, data_shape)).asStdVector()) {
+                        dbl_result.push_back(value);
+                    }
+                }
+                break;
+            }
+            case CARTA::StatsType::NumPixels:
+            case CARTA::StatsType::Sum:
+            case CARTA::StatsType::FluxDensity:
+            case CARTA::StatsType::Mean:
+            case CARTA::StatsType::RMS:
+            case CARTA::StatsType::Sigma:
+            case CARTA::StatsType::SumSq:
+            case CARTA::StatsType::Min:
+            case CARTA::StatsType::Max:
+            case CARTA::StatsType::Extrema: {
+                dbl_result.reserve(num_planes);
+                for (auto& plane : planes) {
+                    dbl_result.push_back(RegionStatsValue(
+                        carta_stats_type, plane.num_pixels, plane.sum, plane.sum_sq, plane.min_val, plane.max_val, beam_area));
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (!dbl_result.empty()) {
+            stats_values.emplace(carta_stats_type, dbl_result);
+        }
+    }
+
+    return true;
+}
+
+bool CalcMaskedStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values,
+    const std::vector<CARTA::StatsType>& requested_stats, const std::vector<float>& data, const casacore::IPosition& data_shape,
+    const casacore::IPosition& data_blc, const carta::RegionSpans& spans, double beam_area) {
+    // Copy the spans from each plane of the data into the bounding box, with NaN outside them
+    if (data_shape.size() < 2) {
+        return false;
+    }
+    int64_t x_offset = spans.X() - data_blc(0);
+    int64_t y_offset = spans.Y() - data_blc(1);
+    if ((x_offset < 0) || (y_offset < 0) || (x_offset + spans.Width() > data_shape(0)) || (y_offset + spans.Height() > data_shape(1))) {
+        return false;
+    }
+
+    const size_t width = spans.Width();
+    const size_t height = spans.Height();
+    const size_t data_width = data_shape(0);
+    const size_t data_plane_size = data_width * data_shape(1);
+    const size_t num_planes = data.size() / data_plane_size;
+    std::vector<float> masked_data(width * height * num_planes, NAN);
+    for (size_t plane = 0; plane < num_planes; ++plane) {
+        const float* plane_data = data.data() + plane * data_plane_size + y_offset * data_width + x_offset;
+        float* masked_plane = masked_data.data() + plane * height * width;
+        for (auto& span : spans.Spans()) {
+            const float* data_row = plane_data + span.y * data_width;
+            std::copy(data_row + span.x_start, data_row + span.x_end, masked_plane + span.y * width + span.x_start);
+        }
+    }
+
+    casacore::IPosition masked_shape(data_shape);
+    masked_shape(0) = width;
+    masked_shape(1) = height;
+    casacore::IPosition blc(data_blc);
+    blc(0) = spans.X();
+    blc(1) = spans.Y();
+    return CalcStatsValues(stats_values, requested_stats, masked_data, masked_shape, blc, beam_area);
+}
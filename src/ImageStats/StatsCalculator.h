@@ -14,16 +14,50 @@
 #include <casacore/images/Images/ImageInterface.h>
 
 #include <carta-protobuf/enums.pb.h>
+#include "../Region/RegionSpans.h"
 #include "BasicStatsCalculator.h"
 #include "Histogram.h"
 
+// Fused stats and histogram: minimum data size, provisional bins per histogram bin (up to a maximum), sampling of the
+// provisional range (one run of 16 values every stride runs), and values outside that range kept per thread
+#define FUSED_HISTOGRAM_MIN_PIXELS 4194304
+#define FUSED_HISTOGRAM_FINE_BINS_PER_BIN 8
+#define FUSED_HISTOGRAM_MAX_FINE_BINS 131072
+#define FUSED_HISTOGRAM_SAMPLE_STRIDE 61
+#define FUSED_HISTOGRAM_MAX_OUTLIERS 65536
+
+// Values per block in the region stats reduction; blocks are joined in order so results do not depend on the threads
+#define REGION_STATS_BLOCK_SIZE 65536
+
 using namespace carta;
 
 void CalcBasicStats(const std::vector<float>& data, BasicStats<float>& stats);
 
 carta::Histogram CalcHistogram(int num_bins, const BasicStats<float>& stats, const std::vector<float>& data);
 
+// Calculates the basic stats and the histogram between the data min and max in one pass over large data. The bins are
+// interpolated from a finer provisional histogram, so counts can differ slightly from CalcHistogram near the bin edges.
+void CalcStatsAndHistogram(const std::vector<float>& data, int num_bins, BasicStats<float>& stats, carta::Histogram& hist);
+
 bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
     const casacore::ImageInterface<float>& image, bool per_channel = true);
 
+// Value of NumPixels, Sum, FluxDensity, Mean, RMS, Sigma, SumSq, Min, Max or Extrema from the count, sums, min and max of the
+// finite values; NaN if there are none
+double RegionStatsValue(CARTA::StatsType stats_type, double num_pixels, double sum, double sum_sq, double min_val, double max_val,
+    double beam_area);
+
+// Calculates the same statistics from the data in the region bounding box, with NaN for pixels outside the region, in one
+// parallel pass. Positions are offset by the box blc; flux density is sum / beam area (in pixels), and is NaN if the beam
+// area is NaN.
+bool CalcStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values, const std::vector<CARTA::StatsType>& requested_stats,
+    const std::vector<float>& data, const casacore::IPosition& data_shape, const casacore::IPosition& blc, double beam_area,
+    bool per_channel = true);
+
+// Calculates the per-z statistics above for the row spans of a 2D region, from data read over a larger box with blc data_blc;
+// pixels outside the spans are excluded. Used to calculate the stats of many regions from one read.
+bool CalcMaskedStatsValues(std::map<CARTA::StatsType, std::vector<double>>& stats_values,
+    const std::vector<CARTA::StatsType>& requested_stats, const std::vector<float>& data, const casacore::IPosition& data_shape,
+    const casacore::IPosition& data_blc, const carta::RegionSpans& spans, double beam_area);
+
 #endif // CARTA_BACKEND_IMAGESTATS_STATSCALCULATOR_H_
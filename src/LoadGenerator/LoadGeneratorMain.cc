@@ -0,0 +1,573 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LoadGeneratorMain.cc: carta_load, which runs concurrent synthetic sessions against a running backend
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <carta-protobuf/animation.pb.h>
+#include <carta-protobuf/error.pb.h>
+#include <carta-protobuf/open_file.pb.h>
+#include <carta-protobuf/raster_tile.pb.h>
+#include <carta-protobuf/region.pb.h>
+#include <carta-protobuf/region_requirements.pb.h>
+#include <carta-protobuf/register_viewer.pb.h>
+#include <carta-protobuf/set_cursor.pb.h>
+#include <carta-protobuf/tiles.pb.h>
+#include <cxxopts/cxxopts.hpp>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "DataStream/Tile.h"
+#include "EventHeader.h"
+#include "WebSocketClient.h"
+
+// Screen size of the simulated frontend, in pixels
+#define LOAD_VIEW_WIDTH 1920
+#define LOAD_VIEW_HEIGHT 1080
+#define LOAD_TILE_SIZE 256
+// Interval of cursor and region drag updates, as the frontend throttles them to the display rate
+#define LOAD_UPDATE_INTERVAL_MS 16
+// Longest wait for a response before a client moves on
+#define LOAD_RESPONSE_TIMEOUT_MS 10000
+#define LOAD_ANIMATION_SECONDS 3
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double Milliseconds(Clock::duration dt) {
+    return std::chrono::duration<double, std::milli>(dt).count();
+}
+
+struct Options {
+    string host = "localhost";
+    int port = 3002;
+    string token;
+    string directory;
+    string file;
+    int clients = 1;
+    int duration = 60;
+    double ramp = 1.0;
+};
+
+// Latencies and received totals of one client, merged after the run
+struct ClientStats {
+    map<string, vector<double>> latencies; // by event type of the request, in milliseconds
+    uint64_t messages_received = 0;
+    uint64_t bytes_received = 0;
+    uint64_t errors = 0;
+
+    void Merge(const ClientStats& other) {
+        for (auto& [name, values] : other.latencies) {
+            auto& merged = latencies[name];
+            merged.insert(merged.end(), values.begin(), values.end());
+        }
+        messages_received += other.messages_received;
+        bytes_received += other.bytes_received;
+        errors += other.errors;
+    }
+};
+
+// One simulated frontend: registers, opens the file, then pans and zooms, moves the cursor, drags a region and animates in turn
+class LoadClient {
+public:
+    LoadClient(const Options& options, int index) : _options(options), _index(index), _random(index + 1) {}
+
+    void Run(Clock::time_point end_time) {
+        std::string error;
+        if (!_socket.Connect(_options.host, _options.port, _options.token, error)) {
+            fmt::print(stderr, "Client {}: {}\n", _index, error);
+            ++_stats.errors;
+            return;
+        }
+        if (!Register() || !OpenFile()) {
+            ++_stats.errors;
+            return;
+        }
+
+        CARTA::SetSpatialRequirements spatial_requirements;
+        spatial_requirements.set_file_id(0);
+        spatial_requirements.set_region_id(0);
+        spatial_requirements.add_spatial_profiles("x");
+        spatial_requirements.add_spatial_profiles("y");
+        Send(CARTA::EventType::SET_SPATIAL_REQUIREMENTS, spatial_requirements);
+        PanZoom(0);
+
+        std::uniform_real_distribution<double> choice(0.0, 1.0);
+        while (Clock::now() < end_time && _socket.Connected()) {
+            double action = choice(_random);
+            if (action < 0.4) {
+                PanZoom(std::uniform_int_distribution<int>(-1, 1)(_random));
+            } else if (action < 0.7) {
+                MoveCursor();
+            } else if (action < 0.85 || _depth < 2) {
+                DragRegion();
+            } else {
+                Animate();
+            }
+        }
+        _socket.Close();
+    }
+
+    const ClientStats& Stats() const {
+        return _stats;
+    }
+
+private:
+    // A request waiting for its response
+    struct Pending {
+        string name;
+        Clock::time_point sent;
+    };
+
+    // Acknowledged requests are timed until the response with their request id
+    uint32_t Send(CARTA::EventType event_type, const google::protobuf::MessageLite& message, bool acknowledged = false) {
+        uint32_t request_id = ++_request_id;
+        std::string data(sizeof(carta::EventHeader) + message.ByteSizeLong(), '\0');
+        auto head = reinterpret_cast<carta::EventHeader*>(data.data());
+        head->type = event_type;
+        head->icd_version = carta::ICD_VERSION;
+        head->request_id = request_id;
+        message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(data.data() + sizeof(carta::EventHeader)));
+        _socket.Send(data);
+        if (acknowledged) {
+            _requests[request_id] = {CARTA::EventType_Name(event_type), Clock::now()};
+        }
+        return request_id;
+    }
+
+    // Receives messages until the predicate accepts one or the timeout passes; returns whether it was accepted
+    bool Pump(int timeout_ms, const std::function<bool(CARTA::EventType, const carta::EventHeader&, const char*, int)>& accept) {
+        auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+        carta::WebSocketClient::Message message;
+        while (true) {
+            int remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (remaining_ms < 0 || !_socket.Receive(message, remaining_ms)) {
+                return false;
+            }
+            if (!message.binary || message.data.size() < sizeof(carta::EventHeader)) {
+                continue;
+            }
+            ++_stats.messages_received;
+            _stats.bytes_received += message.data.size();
+            auto& head = *reinterpret_cast<const carta::EventHeader*>(message.data.data());
+            auto event_type = static_cast<CARTA::EventType>(head.type);
+            const char* payload = message.data.data() + sizeof(carta::EventHeader);
+            int length = message.data.size() - sizeof(carta::EventHeader);
+            Received(event_type, head, payload, length);
+            if (accept && accept(event_type, head, payload, length)) {
+                return true;
+            }
+        }
+    }
+
+    void Wait(int milliseconds) {
+        Pump(milliseconds, nullptr);
+    }
+
+    void WaitForResponses(const std::deque<Pending>& pending) {
+        Pump(LOAD_RESPONSE_TIMEOUT_MS, [&](CARTA::EventType, const carta::EventHeader&, const char*, int) { return pending.empty(); });
+    }
+
+    // Records the latencies completed by a received message
+    void Received(CARTA::EventType event_type, const carta::EventHeader& head, const char* payload, int length) {
+        auto now = Clock::now();
+        switch (event_type) {
+            case CARTA::EventType::RASTER_TILE_SYNC: {
+                CARTA::RasterTileSync sync;
+                if (sync.ParseFromArray(payload, length) && sync.end_sync()) {
+                    if (sync.animation_id()) {
+                        AnimationFrame(sync, now);
+                    } else {
+                        Complete(_pending_tiles, now);
+                    }
+                }
+                return;
+            }
+            case CARTA::EventType::SPATIAL_PROFILE_DATA:
+                Complete(_pending_cursors, now);
+                return;
+            case CARTA::EventType::REGION_STATS_DATA:
+                Complete(_pending_stats, now);
+                return;
+            case CARTA::EventType::ERROR_DATA: {
+                CARTA::ErrorData error_data;
+                if (error_data.ParseFromArray(payload, length) && error_data.severity() >= CARTA::ErrorSeverity::ERROR) {
+                    ++_stats.errors;
+                }
+                return;
+            }
+            default:
+                break;
+        }
+        // Acknowledgements carry the request id
+        auto it = _requests.find(head.request_id);
+        if (head.request_id && it != _requests.end()) {
+            _stats.latencies[it->second.name].push_back(Milliseconds(now - it->second.sent));
+            _requests.erase(it);
+        }
+    }
+
+    // A streamed response completes all outstanding requests of its kind, since newer requests supersede older ones
+    void Complete(std::deque<Pending>& pending, Clock::time_point now) {
+        for (auto& request : pending) {
+            _stats.latencies[request.name].push_back(Milliseconds(now - request.sent));
+        }
+        pending.clear();
+    }
+
+    bool Register() {
+        CARTA::RegisterViewer message;
+        message.set_session_id(0);
+        message.set_client_feature_flags(0);
+        uint32_t request_id = Send(CARTA::EventType::REGISTER_VIEWER, message, true);
+        return Pump(LOAD_RESPONSE_TIMEOUT_MS, [&](CARTA::EventType event_type, const carta::EventHeader& head, const char*, int) {
+            return event_type == CARTA::EventType::REGISTER_VIEWER_ACK && head.request_id == request_id;
+        });
+    }
+
+    bool OpenFile() {
+        CARTA::OpenFile message;
+        message.set_directory(_options.directory);
+        message.set_file(_options.file);
+        message.set_hdu("");
+        message.set_file_id(0);
+        uint32_t request_id = Send(CARTA::EventType::OPEN_FILE, message, true);
+        bool success(false);
+        Pump(LOAD_RESPONSE_TIMEOUT_MS, [&](CARTA::EventType event_type, const carta::EventHeader& head, const char* payload, int length) {
+            if (event_type != CARTA::EventType::OPEN_FILE_ACK || head.request_id != request_id) {
+                return false;
+            }
+            CARTA::OpenFileAck ack;
+            if (ack.ParseFromArray(payload, length) && ack.success()) {
+                auto& info = ack.file_info_extended();
+                _width = info.width();
+                _height = info.height();
+                _depth = std::max<int>(info.depth(), 1);
+                success = _width > 0 && _height > 0;
+            } else {
+                fmt::print(stderr, "Client {}: could not open {}: {}\n", _index, _options.file, ack.message());
+            }
+            return true;
+        });
+        if (success) {
+            double tiles = std::max(ceil((double)_width / LOAD_TILE_SIZE), ceil((double)_height / LOAD_TILE_SIZE));
+            _num_layers = ceil(log2(tiles));
+            // Fit the image to the screen, as the frontend does when it opens a file
+            double zoom_out = std::max((double)_width / LOAD_VIEW_WIDTH, (double)_height / LOAD_VIEW_HEIGHT);
+            _layer = std::clamp((int)floor(_num_layers - log2(zoom_out)), 0, _num_layers);
+            _center_x = _width / 2.0;
+            _center_y = _height / 2.0;
+        }
+        return success;
+    }
+
+    // Tiles of the current view, at the current layer
+    CARTA::AddRequiredTiles ViewTiles() {
+        CARTA::AddRequiredTiles message;
+        message.set_file_id(0);
+        message.set_compression_type(CARTA::CompressionType::ZFP);
+        message.set_compression_quality(11);
+        int mip = Tile::LayerToMip(_layer, _width, _height, LOAD_TILE_SIZE, LOAD_TILE_SIZE);
+        double tile_pixels = (double)LOAD_TILE_SIZE * mip;
+        int max_x = ceil(_width / tile_pixels) - 1;
+        int max_y = ceil(_height / tile_pixels) - 1;
+        int x_min = std::max(0, (int)floor((_center_x - LOAD_VIEW_WIDTH * mip / 2.0) / tile_pixels));
+        int x_max = std::min(max_x, (int)floor((_center_x + LOAD_VIEW_WIDTH * mip / 2.0) / tile_pixels));
+        int y_min = std::max(0, (int)floor((_center_y - LOAD_VIEW_HEIGHT * mip / 2.0) / tile_pixels));
+        int y_max = std::min(max_y, (int)floor((_center_y + LOAD_VIEW_HEIGHT * mip / 2.0) / tile_pixels));
+        for (int y = y_min; y <= y_max; ++y) {
+            for (int x = x_min; x <= x_max; ++x) {
+                message.add_tiles(Tile::Encode(x, y, _layer));
+            }
+        }
+        return message;
+    }
+
+    void PanZoom(int zoom) {
+        _layer = std::clamp(_layer + zoom, 0, _num_layers);
+        int mip = Tile::LayerToMip(_layer, _width, _height, LOAD_TILE_SIZE, LOAD_TILE_SIZE);
+        std::normal_distribution<double> pan(0.0, LOAD_VIEW_WIDTH * mip / 4.0);
+        _center_x = std::clamp(_center_x + pan(_random), 0.0, (double)_width);
+        _center_y = std::clamp(_center_y + pan(_random), 0.0, (double)_height);
+
+        auto message = ViewTiles();
+        if (message.tiles().empty()) {
+            return;
+        }
+        Send(CARTA::EventType::ADD_REQUIRED_TILES, message);
+        _pending_tiles.push_back({"ADD_REQUIRED_TILES", Clock::now()});
+        WaitForResponses(_pending_tiles);
+    }
+
+    void MoveCursor() {
+        std::normal_distribution<double> step(0.0, 20.0);
+        double x = _center_x, y = _center_y;
+        for (int i = 0; i < 30; ++i) {
+            x = std::clamp(x + step(_random), 0.0, _width - 1.0);
+            y = std::clamp(y + step(_random), 0.0, _height - 1.0);
+            CARTA::SetCursor message;
+            message.set_file_id(0);
+            message.mutable_point()->set_x(round(x));
+            message.mutable_point()->set_y(round(y));
+            Send(CARTA::EventType::SET_CURSOR, message);
+            _pending_cursors.push_back({"SET_CURSOR", Clock::now()});
+            Wait(LOAD_UPDATE_INTERVAL_MS);
+        }
+        Wait(100);
+    }
+
+    void DragRegion() {
+        double size = std::min(_width, _height) / 8.0;
+        CARTA::SetRegion message;
+        message.set_file_id(0);
+        message.set_region_id(-1);
+        auto region_info = message.mutable_region_info();
+        region_info->set_region_type(CARTA::RegionType::RECTANGLE);
+        region_info->set_rotation(0);
+        auto center = region_info->add_control_points();
+        center->set_x(_center_x);
+        center->set_y(_center_y);
+        auto extent = region_info->add_control_points();
+        extent->set_x(size);
+        extent->set_y(size);
+
+        uint32_t request_id = Send(CARTA::EventType::SET_REGION, message, true);
+        int region_id(-1);
+        Pump(LOAD_RESPONSE_TIMEOUT_MS, [&](CARTA::EventType event_type, const carta::EventHeader& head, const char* payload, int length) {
+            if (event_type != CARTA::EventType::SET_REGION_ACK || head.request_id != request_id) {
+                return false;
+            }
+            CARTA::SetRegionAck ack;
+            if (ack.ParseFromArray(payload, length) && ack.success()) {
+                region_id = ack.region_id();
+            }
+            return true;
+        });
+        if (region_id < 0) {
+            ++_stats.errors;
+            return;
+        }
+
+        CARTA::SetStatsRequirements stats;
+        stats.set_file_id(0);
+        stats.set_region_id(region_id);
+        for (auto type : {CARTA::StatsType::NumPixels, CARTA::StatsType::Mean, CARTA::StatsType::RMS, CARTA::StatsType::Min,
+                 CARTA::StatsType::Max}) {
+            stats.add_stats(type);
+        }
+        Send(CARTA::EventType::SET_STATS_REQUIREMENTS, stats);
+        _pending_stats.push_back({"REGION_STATS", Clock::now()});
+
+        message.set_region_id(region_id);
+        std::normal_distribution<double> step(0.0, size / 10.0);
+        for (int i = 0; i < 30; ++i) {
+            center->set_x(std::clamp(center->x() + step(_random), 0.0, (double)_width));
+            center->set_y(std::clamp(center->y() + step(_random), 0.0, (double)_height));
+            Send(CARTA::EventType::SET_REGION, message, true);
+            _pending_stats.push_back({"REGION_STATS", Clock::now()});
+            Wait(LOAD_UPDATE_INTERVAL_MS);
+        }
+        WaitForResponses(_pending_stats);
+
+        CARTA::RemoveRegion remove;
+        remove.set_region_id(region_id);
+        Send(CARTA::EventType::REMOVE_REGION, remove);
+        _pending_stats.clear();
+    }
+
+    void Animate() {
+        CARTA::StartAnimation message;
+        message.set_file_id(0);
+        message.mutable_first_frame()->set_channel(0);
+        message.mutable_first_frame()->set_stokes(0);
+        message.mutable_start_frame()->set_channel(0);
+        message.mutable_start_frame()->set_stokes(0);
+        message.mutable_last_frame()->set_channel(_depth - 1);
+        message.mutable_last_frame()->set_stokes(0);
+        message.mutable_delta_frame()->set_channel(1);
+        message.mutable_delta_frame()->set_stokes(0);
+        *message.mutable_required_tiles() = ViewTiles();
+        message.set_frame_rate(10);
+        message.set_looping(true);
+        message.set_reverse(false);
+
+        uint32_t request_id = Send(CARTA::EventType::START_ANIMATION, message, true);
+        Pump(LOAD_RESPONSE_TIMEOUT_MS, [&](CARTA::EventType event_type, const carta::EventHeader& head, const char* payload, int length) {
+            if (event_type != CARTA::EventType::START_ANIMATION_ACK || head.request_id != request_id) {
+                return false;
+            }
+            CARTA::StartAnimationAck ack;
+            _animation_id = ack.ParseFromArray(payload, length) && ack.success() ? ack.animation_id() : 0;
+            return true;
+        });
+        if (!_animation_id) {
+            ++_stats.errors;
+            return;
+        }
+        _last_frame_time = Clock::now();
+        Wait(LOAD_ANIMATION_SECONDS * 1000);
+
+        CARTA::StopAnimation stop;
+        stop.set_file_id(0);
+        stop.mutable_end_frame()->set_channel(_last_channel);
+        stop.mutable_end_frame()->set_stokes(0);
+        Send(CARTA::EventType::STOP_ANIMATION, stop);
+        _animation_id = 0;
+        Wait(200);
+    }
+
+    // Acknowledges a complete animation frame, and records the time since the previous one
+    void AnimationFrame(const CARTA::RasterTileSync& sync, Clock::time_point now) {
+        if (sync.animation_id() != _animation_id) {
+            return;
+        }
+        _stats.latencies["ANIMATION_FRAME"].push_back(Milliseconds(now - _last_frame_time));
+        _last_frame_time = now;
+        _last_channel = sync.channel();
+
+        CARTA::AnimationFlowControl flow_control;
+        flow_control.set_file_id(0);
+        flow_control.mutable_received_frame()->set_channel(sync.channel());
+        flow_control.mutable_received_frame()->set_stokes(sync.stokes());
+        flow_control.set_animation_id(_animation_id);
+        flow_control.set_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        Send(CARTA::EventType::ANIMATION_FLOW_CONTROL, flow_control);
+    }
+
+    const Options& _options;
+    int _index;
+    std::mt19937 _random;
+    carta::WebSocketClient _socket;
+    ClientStats _stats;
+
+    uint32_t _request_id = 0;
+    std::unordered_map<uint32_t, Pending> _requests;
+    std::deque<Pending> _pending_tiles, _pending_cursors, _pending_stats;
+
+    int _width = 0, _height = 0, _depth = 1;
+    int _num_layers = 0, _layer = 0;
+    double _center_x = 0.0, _center_y = 0.0;
+    uint32_t _animation_id = 0;
+    int _last_channel = 0;
+    Clock::time_point _last_frame_time;
+};
+
+double Percentile(std::vector<double>& values, double fraction) {
+    size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    string json_file;
+
+    cxxopts::Options cli("carta_load", "Runs concurrent synthetic sessions against a running CARTA backend");
+    // clang-format off
+    cli.add_options()
+        ("h,help", "print usage")
+        ("host", "host of the backend (default: localhost)", cxxopts::value<string>(options.host), "<host>")
+        ("p,port", "WebSocket port of the backend (default: 3002)", cxxopts::value<int>(options.port), "<port>")
+        ("token", "auth token of the backend (default: CARTA_AUTH_TOKEN)", cxxopts::value<string>(options.token), "<token>")
+        ("c,clients", "number of concurrent sessions (default: 1)", cxxopts::value<int>(options.clients), "<n>")
+        ("d,duration", "seconds each session runs (default: 60)", cxxopts::value<int>(options.duration), "<sec>")
+        ("ramp", "seconds over which the sessions connect (default: 1)", cxxopts::value<double>(options.ramp), "<sec>")
+        ("directory", "folder of the image, relative to the top-level folder of the backend", cxxopts::value<string>(options.directory), "<dir>")
+        ("json", "also write the summary to this file as JSON", cxxopts::value<string>(json_file), "<file>")
+        ("file", "image opened by each session", cxxopts::value<string>(options.file));
+    // clang-format on
+    cli.positional_help("<image>");
+    cli.parse_positional("file");
+
+    try {
+        auto result = cli.parse(argc, argv);
+        if (result.count("help") || options.file.empty()) {
+            cout << cli.help() << endl;
+            return options.file.empty() && !result.count("help");
+        }
+    } catch (const std::exception& err) {
+        cerr << err.what() << endl;
+        return 1;
+    }
+    if (options.token.empty() && getenv("CARTA_AUTH_TOKEN")) {
+        options.token = getenv("CARTA_AUTH_TOKEN");
+    }
+    options.clients = std::max(options.clients, 1);
+
+    std::vector<std::unique_ptr<LoadClient>> clients;
+    std::vector<std::thread> threads;
+    auto start_time = Clock::now();
+    for (int i = 0; i < options.clients; ++i) {
+        clients.push_back(std::make_unique<LoadClient>(options, i));
+        auto ramp_offset = std::chrono::duration<double>(options.ramp * i / options.clients);
+        auto connect_time = start_time + std::chrono::duration_cast<Clock::duration>(ramp_offset);
+        threads.emplace_back([&client = *clients.back(), connect_time, &options]() {
+            std::this_thread::sleep_until(connect_time);
+            client.Run(connect_time + std::chrono::seconds(options.duration));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed_s = Milliseconds(Clock::now() - start_time) / 1000.0;
+
+    ClientStats stats;
+    for (auto& client : clients) {
+        stats.Merge(client->Stats());
+    }
+
+    nlohmann::json summary;
+    summary["clients"] = options.clients;
+    summary["seconds"] = elapsed_s;
+    summary["messages_received"] = stats.messages_received;
+    summary["bytes_received"] = stats.bytes_received;
+    summary["errors"] = stats.errors;
+    fmt::print("{} sessions for {:.1f} s: received {} messages, {:.1f} MB ({:.1f} MB/s, {:.0f} messages/s); {} errors\n\n", options.clients,
+        elapsed_s, stats.messages_received, stats.bytes_received / 1e6, stats.bytes_received / 1e6 / elapsed_s,
+        stats.messages_received / elapsed_s, stats.errors);
+
+    fmt::print("{:<24} {:>8} {:>10} {:>10} {:>10} {:>10}\n", "Request", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (auto& [name, values] : stats.latencies) {
+        if (values.empty()) {
+            continue;
+        }
+        double max_ms = *std::max_element(values.begin(), values.end());
+        nlohmann::json entry{{"count", values.size()}, {"p50_ms", Percentile(values, 0.5)}, {"p90_ms", Percentile(values, 0.9)},
+            {"p99_ms", Percentile(values, 0.99)}, {"max_ms", max_ms}};
+        summary["latency"][name] = entry;
+        fmt::print("{:<24} {:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}\n", name, values.size(), entry["p50_ms"].get<double>(),
+            entry["p90_ms"].get<double>(), entry["p99_ms"].get<double>(), max_ms);
+    }
+
+    if (!json_file.empty()) {
+        std::ofstream out(json_file);
+        out << summary.dump(2) << endl;
+        if (!out) {
+            cerr << "Could not write " << json_file << endl;
+            return 1;
+        }
+    }
+    return stats.errors ? 2 : 0;
+}
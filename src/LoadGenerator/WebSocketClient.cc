@@ -0,0 +1,274 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# WebSocketClient.cc: minimal blocking WebSocket client for the load generator
+
+#include "WebSocketClient.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+
+#include <fmt/format.h>
+
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+// Largest response header of the upgrade
+#define WS_MAX_HANDSHAKE_BYTES 8192
+
+namespace carta {
+
+namespace {
+
+std::string Base64(const uint8_t* data, size_t length) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t value = data[i] << 16;
+        if (i + 1 < length) {
+            value |= data[i + 1] << 8;
+        }
+        if (i + 2 < length) {
+            value |= data[i + 2];
+        }
+        out += alphabet[(value >> 18) & 63];
+        out += alphabet[(value >> 12) & 63];
+        out += i + 1 < length ? alphabet[(value >> 6) & 63] : '=';
+        out += i + 2 < length ? alphabet[value & 63] : '=';
+    }
+    return out;
+}
+
+bool SendAll(int fd, const char* data, size_t length) {
+    while (length) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+} // namespace
+
+WebSocketClient::WebSocketClient() : _fd(-1), _fragment_opcode(0), _mask_random(std::random_device()()) {}
+
+WebSocketClient::~WebSocketClient() {
+    Close();
+}
+
+bool WebSocketClient::Connect(const std::string& host, int port, const std::string& token, std::string& error) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses(nullptr);
+    if (int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses)) {
+        error = fmt::format("Could not resolve {}: {}", host, gai_strerror(status));
+        return false;
+    }
+    for (auto address = addresses; address && _fd < 0; address = address->ai_next) {
+        _fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (_fd >= 0 && connect(_fd, address->ai_addr, address->ai_addrlen) != 0) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (_fd < 0) {
+        error = fmt::format("Could not connect to {}:{}", host, port);
+        return false;
+    }
+    int no_delay = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    uint8_t key[16];
+    for (auto& byte : key) {
+        byte = _mask_random();
+    }
+    std::string request = fmt::format(
+        "GET / HTTP/1.1\r\nHost: {}:{}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: {}\r\n"
+        "Sec-WebSocket-Version: 13\r\n",
+        host, port, Base64(key, sizeof(key)));
+    if (!token.empty()) {
+        request += fmt::format("Authorization: Bearer {}\r\n", token);
+    }
+    request += "\r\n";
+    if (!SendAll(_fd, request.data(), request.size())) {
+        error = "Could not send the WebSocket upgrade";
+        Close();
+        return false;
+    }
+
+    // The accept key is not checked: the backend under test is trusted
+    size_t header_end;
+    while ((header_end = _input.find("\r\n\r\n")) == std::string::npos) {
+        if (_input.size() > WS_MAX_HANDSHAKE_BYTES || !ReadSome(5000)) {
+            error = "No response to the WebSocket upgrade";
+            Close();
+            return false;
+        }
+    }
+    auto status_line = _input.substr(0, _input.find("\r\n"));
+    if (status_line.find(" 101") == std::string::npos) {
+        error = fmt::format("WebSocket upgrade refused: {}", status_line);
+        Close();
+        return false;
+    }
+    _input.erase(0, header_end + 4);
+    return true;
+}
+
+bool WebSocketClient::Send(std::string_view data, bool binary) {
+    return SendFrame(binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT, data);
+}
+
+bool WebSocketClient::SendFrame(uint8_t opcode, std::string_view payload) {
+    if (_fd < 0) {
+        return false;
+    }
+    // Client frames are masked
+    std::string frame;
+    frame.reserve(payload.size() + 14);
+    frame += (char)(0x80 | opcode);
+    if (payload.size() < 126) {
+        frame += (char)(0x80 | payload.size());
+    } else if (payload.size() < 65536) {
+        frame += (char)(0x80 | 126);
+        frame += (char)(payload.size() >> 8);
+        frame += (char)(payload.size() & 0xFF);
+    } else {
+        frame += (char)(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame += (char)((uint64_t)payload.size() >> shift);
+        }
+    }
+    uint32_t mask = _mask_random();
+    const char* mask_bytes = reinterpret_cast<const char*>(&mask);
+    frame.append(mask_bytes, 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame += payload[i] ^ mask_bytes[i % 4];
+    }
+    if (!SendAll(_fd, frame.data(), frame.size())) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool WebSocketClient::ReadSome(int timeout_ms) {
+    pollfd poll_fd{_fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, timeout_ms) <= 0) {
+        return false;
+    }
+    char buffer[65536];
+    ssize_t received = recv(_fd, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+        Close();
+        return false;
+    }
+    _input.append(buffer, received);
+    return true;
+}
+
+bool WebSocketClient::ParseFrame(uint8_t& opcode, bool& fin, std::string& payload) {
+    if (_input.size() < 2) {
+        return false;
+    }
+    auto bytes = reinterpret_cast<const uint8_t*>(_input.data());
+    fin = bytes[0] & 0x80;
+    opcode = bytes[0] & 0x0F;
+    bool masked = bytes[1] & 0x80;
+    uint64_t length = bytes[1] & 0x7F;
+    size_t offset = 2;
+    if (length == 126 || length == 127) {
+        size_t length_bytes = length == 126 ? 2 : 8;
+        if (_input.size() < offset + length_bytes) {
+            return false;
+        }
+        length = 0;
+        for (size_t i = 0; i < length_bytes; ++i) {
+            length = (length << 8) | bytes[offset + i];
+        }
+        offset += length_bytes;
+    }
+    size_t mask_offset = offset;
+    if (masked) {
+        offset += 4;
+    }
+    if (_input.size() < offset + length) {
+        return false;
+    }
+    payload.assign(_input, offset, length);
+    if (masked) {
+        for (size_t i = 0; i < length; ++i) {
+            payload[i] ^= bytes[mask_offset + i % 4];
+        }
+    }
+    _input.erase(0, offset + length);
+    return true;
+}
+
+bool WebSocketClient::Receive(Message& message, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint8_t opcode;
+    bool fin;
+    std::string payload;
+    while (_fd >= 0) {
+        while (ParseFrame(opcode, fin, payload)) {
+            switch (opcode) {
+                case WS_OPCODE_PING:
+                    SendFrame(WS_OPCODE_PONG, payload);
+                    break;
+                case WS_OPCODE_PONG:
+                    break;
+                case WS_OPCODE_CLOSE:
+                    SendFrame(WS_OPCODE_CLOSE, payload.substr(0, 2));
+                    Close();
+                    return false;
+                default:
+                    if (opcode != WS_OPCODE_CONTINUATION) {
+                        _fragment_opcode = opcode;
+                        _fragments.clear();
+                    }
+                    _fragments += payload;
+                    if (fin) {
+                        message.binary = _fragment_opcode == WS_OPCODE_BINARY;
+                        message.data.swap(_fragments);
+                        _fragments.clear();
+                        return true;
+                    }
+            }
+        }
+        int remaining_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining_ms < 0 || !ReadSome(remaining_ms)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void WebSocketClient::Close() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+} // namespace carta
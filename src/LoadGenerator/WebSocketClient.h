@@ -0,0 +1,58 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# WebSocketClient.h: minimal blocking WebSocket client for the load generator
+
+#ifndef CARTA_BACKEND_LOADGENERATOR_WEBSOCKETCLIENT_H_
+#define CARTA_BACKEND_LOADGENERATOR_WEBSOCKETCLIENT_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace carta {
+
+// Client side of RFC 6455 over a plain TCP socket, without extensions, so that the backend sends messages uncompressed. Pings are
+// answered while receiving; fragmented messages are joined. Not thread-safe: each load client owns one.
+class WebSocketClient {
+public:
+    struct Message {
+        bool binary;
+        std::string data;
+    };
+
+    WebSocketClient();
+    ~WebSocketClient();
+    WebSocketClient(const WebSocketClient&) = delete;
+    WebSocketClient& operator=(const WebSocketClient&) = delete;
+
+    // Connects and upgrades; the token is sent as a bearer token if not empty
+    bool Connect(const std::string& host, int port, const std::string& token, std::string& error);
+    bool Send(std::string_view data, bool binary = true);
+    // Waits up to the timeout for a message; false on timeout or when the connection is closed
+    bool Receive(Message& message, int timeout_ms);
+    bool Connected() const {
+        return _fd >= 0;
+    }
+    void Close();
+
+private:
+    bool SendFrame(uint8_t opcode, std::string_view payload);
+    // Takes a complete frame off the front of the input buffer; false if it has not all arrived
+    bool ParseFrame(uint8_t& opcode, bool& fin, std::string& payload);
+    bool ReadSome(int timeout_ms);
+
+    int _fd;
+    std::string _input;
+    std::string _fragments;
+    uint8_t _fragment_opcode;
+    std::mt19937 _mask_random;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_LOADGENERATOR_WEBSOCKETCLIENT_H_
@@ -0,0 +1,189 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "AsyncLogSink.h"
+
+#include <chrono>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "Constants.h"
+
+namespace carta {
+
+AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, size_t queue_size, spdlog::level::level_enum block_level)
+    : _sinks(std::move(sinks)),
+      _enqueue_position(0),
+      _dequeue_position(0),
+      _dropped(0),
+      _writer_waiting(false),
+      _stop(false),
+      _block_level(block_level),
+      _flush_requests(0),
+      _flushes_done(0) {
+    size_t num_slots(2);
+    while (num_slots < queue_size) {
+        num_slots <<= 1;
+    }
+    _slots.reset(new Slot[num_slots]);
+    for (size_t i = 0; i < num_slots; ++i) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _mask = num_slots - 1;
+    _writer = std::thread(&AsyncLogSink::WriteMessages, this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    _stop = true;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake_writer.notify_one();
+    }
+    _writer.join();
+}
+
+void AsyncLogSink::log(const spdlog::details::log_msg& msg) {
+    if (!TryPush(msg)) {
+        if (msg.level < _block_level) {
+            ++_dropped;
+            return;
+        }
+        while (!TryPush(msg)) {
+            if (_stop) {
+                return;
+            }
+            Wake();
+            std::this_thread::yield();
+        }
+    }
+    Wake();
+}
+
+void AsyncLogSink::flush() {
+    ++_flush_requests;
+    Wake();
+}
+
+void AsyncLogSink::set_pattern(const std::string& pattern) {
+    for (auto& sink : _sinks) {
+        sink->set_pattern(pattern);
+    }
+}
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) {
+    for (auto& sink : _sinks) {
+        sink->set_formatter(sink_formatter->clone());
+    }
+}
+
+void AsyncLogSink::Drain() {
+    size_t ticket = ++_flush_requests;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake_writer.notify_one();
+    _flushed.wait(lock, [&]() { return _flushes_done >= ticket; });
+}
+
+bool AsyncLogSink::TryPush(const spdlog::details::log_msg& msg) {
+    // Bounded multi-producer queue: a producer claims a position whose slot has been released by the writer, then publishes the
+    // message with the slot sequence
+    size_t position = _enqueue_position.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = _slots[position & _mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        auto difference = (std::ptrdiff_t)(sequence - position);
+        if (difference == 0) {
+            if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                slot.msg = spdlog::details::log_msg_buffer(msg);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            return false; // full
+        } else {
+            position = _enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLogSink::TryPop(spdlog::details::log_msg_buffer& msg) {
+    // Only the writer pops
+    size_t position = _dequeue_position.load(std::memory_order_relaxed);
+    Slot& slot = _slots[position & _mask];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+        return false;
+    }
+    msg = std::move(slot.msg);
+    slot.sequence.store(position + _mask + 1, std::memory_order_release);
+    _dequeue_position.store(position + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void AsyncLogSink::Wake() {
+    // Producers only take the mutex when the writer is idle; a wakeup missed between its check and its wait is bounded by the timeout
+    if (_writer_waiting.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake_writer.notify_one();
+    }
+}
+
+void AsyncLogSink::WriteMessages() {
+    spdlog::details::log_msg_buffer msg;
+    size_t reported_dropped(0);
+    while (true) {
+        size_t flush_requests = _flush_requests.load();
+        bool stop = _stop.load();
+
+        // Write the queued messages, at most a queue length at a time so that flushes are not held up
+        bool written(false);
+        for (size_t i = 0; (i <= _mask) && TryPop(msg); ++i) {
+            for (auto& sink : _sinks) {
+                if (sink->should_log(msg.level)) {
+                    sink->log(msg);
+                }
+            }
+            written = true;
+        }
+
+        size_t dropped = _dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            auto text = fmt::format("{} log messages were dropped because the log queue was full.", dropped - reported_dropped);
+            spdlog::details::log_msg warning(msg.logger_name, spdlog::level::warn, text);
+            for (auto& sink : _sinks) {
+                sink->log(warning);
+            }
+            reported_dropped = dropped;
+        }
+
+        bool flush_pending;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            flush_pending = _flushes_done < flush_requests;
+        }
+        if (flush_pending || stop) {
+            for (auto& sink : _sinks) {
+                sink->flush();
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _flushes_done = flush_requests;
+            _flushed.notify_all();
+        }
+        if (stop) {
+            break; // messages queued before the stop have been written
+        }
+
+        if (!written) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _writer_waiting = true;
+            _wake_writer.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_WAIT_MS), [&]() {
+                return _stop || (_flush_requests != flush_requests) ||
+                       (_slots[_dequeue_position & _mask].sequence.load(std::memory_order_acquire) == _dequeue_position + 1);
+            });
+            _writer_waiting = false;
+        }
+    }
+}
+
+} // namespace carta
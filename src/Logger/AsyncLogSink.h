@@ -0,0 +1,77 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# AsyncLogSink.h: spdlog sink which queues messages for a writer thread, so that logging threads do not wait for the console or disk
+
+#ifndef CARTA_BACKEND_LOGGER_ASYNCLOGSINK_H_
+#define CARTA_BACKEND_LOGGER_ASYNCLOGSINK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+namespace carta {
+
+// Messages are copied into a bounded lock-free queue and written to the sinks by one thread. When the queue is full, messages below
+// block_level are dropped (and counted in a warning written later), while those at or above it wait for space.
+class AsyncLogSink : public spdlog::sinks::sink {
+public:
+    // The queue size is rounded up to a power of 2
+    AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, size_t queue_size, spdlog::level::level_enum block_level);
+    // Writes the queued messages before stopping the writer
+    ~AsyncLogSink() override;
+
+    void log(const spdlog::details::log_msg& msg) override;
+    // Asks the writer to flush the sinks after the queued messages, without waiting
+    void flush() override;
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+    // Waits until the messages queued before the call are written and the sinks flushed
+    void Drain();
+    size_t Dropped() const {
+        return _dropped;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        spdlog::details::log_msg_buffer msg;
+    };
+
+    bool TryPush(const spdlog::details::log_msg& msg);
+    bool TryPop(spdlog::details::log_msg_buffer& msg);
+    void Wake();
+    void WriteMessages();
+
+    std::vector<spdlog::sink_ptr> _sinks;
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _enqueue_position;
+    alignas(64) std::atomic<size_t> _dequeue_position;
+    std::atomic<size_t> _dropped;
+    std::atomic<bool> _writer_waiting;
+    std::atomic<bool> _stop;
+    spdlog::level::level_enum _block_level;
+
+    // Flush tickets: Drain waits for its ticket to be done
+    std::atomic<size_t> _flush_requests;
+    size_t _flushes_done;
+    std::mutex _mutex;
+    std::condition_variable _wake_writer;
+    std::condition_variable _flushed;
+    std::thread _writer;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_LOGGER_ASYNCLOGSINK_H_
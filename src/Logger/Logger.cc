@@ -5,6 +5,7 @@
 */
 
 #include "Logger.h"
+#include "AsyncLogSink.h"
 #include "Constants.h"
 
 #ifdef _BOOST_FILESYSTEM_
@@ -16,9 +17,21 @@ namespace fs = std::filesystem;
 #endif
 
 static bool log_protocol_messages(false);
+static std::vector<std::shared_ptr<carta::AsyncLogSink>> async_sinks;
 
-void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_protocol_messages_) {
+static std::shared_ptr<spdlog::logger> MakeLogger(const std::string& name, std::vector<spdlog::sink_ptr>& sinks, size_t queue_size) {
+    if (!queue_size) {
+        return std::make_shared<spdlog::logger>(name, std::begin(sinks), std::end(sinks));
+    }
+    // Debug and performance messages are dropped when the queue is full; messages from info up wait for space
+    auto async_sink = std::make_shared<carta::AsyncLogSink>(sinks, queue_size, spdlog::level::info);
+    async_sinks.push_back(async_sink);
+    return std::make_shared<spdlog::logger>(name, async_sink);
+}
+
+void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_protocol_messages_, int log_queue) {
     log_protocol_messages = log_protocol_messages_;
+    size_t queue_size = (log_queue < 0) ? (log_performance ? LOG_QUEUE_SIZE : 0) : log_queue;
 
     // Set the stdout console
     auto stdout_console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
@@ -38,7 +51,7 @@ void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_
     }
 
     // Create the stdout logger
-    auto default_logger = std::make_shared<spdlog::logger>(STDOUT_TAG, std::begin(stdout_sinks), std::end(stdout_sinks));
+    auto default_logger = MakeLogger(STDOUT_TAG, stdout_sinks, queue_size);
 
     // Set flush policy on severity
     default_logger->flush_on(spdlog::level::err);
@@ -99,7 +112,7 @@ void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_
         }
 
         // Create the performance logger
-        auto perf_logger = std::make_shared<spdlog::logger>(PERF_TAG, std::begin(perf_sinks), std::end(perf_sinks));
+        auto perf_logger = MakeLogger(PERF_TAG, perf_sinks, queue_size);
 
         // Set the performance logger level same with the stdout logger
         perf_logger->set_level(default_logger->level());
@@ -138,4 +151,7 @@ void FlushLogFile() {
     if (spdlog::get(PERF_TAG)) {
         spdlog::get(PERF_TAG)->flush();
     }
+    for (auto& async_sink : async_sinks) {
+        async_sink->Drain();
+    }
 }
@@ -25,12 +25,15 @@ constexpr auto performance = [](auto&&... args) {
 };
 } // namespace spdlog
 
-void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_protocol_messages_);
+// A log queue of n > 0 messages writes the logs from a background thread (see AsyncLogSink); 0 writes them synchronously and -1
+// queues LOG_QUEUE_SIZE messages with log_performance
+void InitLogger(bool no_log_file, int verbosity, bool log_performance, bool log_protocol_messages_, int log_queue);
 
 void LogReceivedEventType(const CARTA::EventType& event_type);
 
 void LogSentEventType(const CARTA::EventType& event_type);
 
+// Waits for queued messages to be written, then flushes the log files
 void FlushLogFile();
 
 #endif // CARTA_BACKEND_LOGGER_LOGGER_H_
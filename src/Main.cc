@@ -4,7 +4,9 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <atomic>
 #include <limits> // for numeric limits
+#include <mutex>
 #include <thread>
 #include <tuple>
 #include <vector>
@@ -16,16 +18,36 @@
 #include <uWebSockets/App.h>
 #include <uuid/uuid.h>
 
+#include "CompressionPolicy.h"
+#include "DataStream/Contouring.h"
+#include "DataStream/SimdDispatch.h"
 #include "EventHeader.h"
 #include "FileList/FileListHandler.h"
+#include "FilePreloader.h"
 #include "FileSettings.h"
+#include "GpuCompute.h"
+#include "GrpcServer/CartaDataService.h"
 #include "GrpcServer/CartaGrpcService.h"
+#include "GrpcServer/CartaWorkerService.h"
+#include "GrpcServer/WorkerPool.h"
+#include "ImageData/CasaLoader.h"
+#include "ImageData/Hdf5Loader.h"
+#include "ImageData/SidecarCache.h"
 #include "Logger/Logger.h"
+#include "MemoryBudget.h"
+#include "MessageDispatch.h"
+#include "Moment/MomentGenerator.h"
 #include "OnMessageTask.h"
+#include "Region/RegionHandler.h"
 #include "Session.h"
 #include "SessionManager/ProgramSettings.h"
+#include "SessionRecorder.h"
+#include "SharedMemoryRing.h"
 #include "SimpleFrontendServer/SimpleFrontendServer.h"
 #include "Threading.h"
+#include "Timer/LatencyHistogram.h"
+#include "Timer/SlowRequestLog.h"
+#include "Timer/TraceEvents.h"
 #include "Util.h"
 
 using namespace std;
@@ -34,17 +56,20 @@ using namespace std;
 static FileListHandler* file_list_handler;
 SimpleFrontendServer* http_server;
 
-static uint32_t session_number;
+static std::atomic<uint32_t> session_number;
 
 // grpc server for scripting client
 static std::unique_ptr<CartaGrpcService> carta_grpc_service;
+static std::unique_ptr<CartaDataService> carta_data_service;
+static std::unique_ptr<CartaWorkerService> carta_worker_service;
 static std::unique_ptr<grpc::Server> carta_grpc_server;
 
 static string auth_token = "";
 
 carta::ProgramSettings settings;
-// Sessions map
+// Sessions map, shared by the event loops
 std::unordered_map<uint32_t, Session*> sessions;
+std::mutex sessions_mutex;
 
 // Apply ws->getUserData and return one of these
 struct PerSocketData {
@@ -52,17 +77,25 @@ struct PerSocketData {
     string address;
 };
 
+static Session* FindSession(uint32_t session_id) {
+    std::scoped_lock lock(sessions_mutex);
+    auto it = sessions.find(session_id);
+    return it == sessions.end() ? nullptr : it->second;
+}
+
 void DeleteSession(int session_id) {
-    Session* session = sessions[session_id];
+    Session* session = FindSession(session_id);
     if (session) {
         spdlog::info(
             "Client {} [{}] Deleted. Remaining sessions: {}", session->GetId(), session->GetAddress(), Session::NumberOfSessions());
         session->WaitForTaskCancellation();
+        carta::SessionRecorder::Close(session_id);
         if (carta_grpc_service) {
             carta_grpc_service->RemoveSession(session);
         }
         if (!session->DecreaseRefCount()) {
             delete session;
+            std::scoped_lock lock(sessions_mutex);
             sessions.erase(session_id);
         } else {
             spdlog::warn("Session {} reference count is not 0 ({}) on deletion!", session_id, session->GetRefCount());
@@ -87,11 +120,13 @@ void OnUpgrade(uWS::HttpResponse<false>* http_response, uWS::HttpRequest* http_r
         return;
     }
 
-    session_number++;
     // protect against overflow
-    session_number = max(session_number, 1u);
+    uint32_t session_id = ++session_number;
+    if (!session_id) {
+        session_id = ++session_number;
+    }
 
-    http_response->template upgrade<PerSocketData>({session_number, address}, //
+    http_response->template upgrade<PerSocketData>({session_id, address}, //
         http_request->getHeader("sec-websocket-key"),                         //
         http_request->getHeader("sec-websocket-protocol"),                    //
         http_request->getHeader("sec-websocket-extensions"),                  //
@@ -109,18 +144,22 @@ void OnConnect(uWS::WebSocket<false, true>* ws) {
     uint32_t session_id = socket_data->session_id;
     string address = socket_data->address;
 
-    // get the uWebsockets loop
+    // get the uWebsockets loop of this thread, which sends all messages of the session
     auto* loop = uWS::Loop::get();
 
     // create a Session
-    sessions[session_id] = new Session(ws, loop, session_id, address, settings.top_level_folder, settings.starting_folder,
-        file_list_handler, settings.grpc_port, settings.read_only_mode);
+    auto session = new Session(ws, loop, session_id, address, settings.top_level_folder, settings.starting_folder, file_list_handler,
+        settings.grpc_port, settings.read_only_mode);
+    {
+        std::scoped_lock lock(sessions_mutex);
+        sessions[session_id] = session;
+    }
 
     if (carta_grpc_service) {
-        carta_grpc_service->AddSession(sessions[session_id]);
+        carta_grpc_service->AddSession(session);
     }
 
-    sessions[session_id]->IncreaseRefCount();
+    session->IncreaseRefCount();
 
     spdlog::info("Session {} [{}] Connected. Num sessions: {}", session_id, address, Session::NumberOfSessions());
 }
@@ -147,10 +186,11 @@ void OnDisconnect(uWS::WebSocket<false, true>* ws, int code, std::string_view me
 
 void OnDrain(uWS::WebSocket<false, true>* ws) {
     uint32_t session_id = static_cast<PerSocketData*>(ws->getUserData())->session_id;
-    Session* session = sessions[session_id];
+    Session* session = FindSession(session_id);
     if (session) {
         spdlog::debug("Draining WebSocket backpressure: client {} [{}]. Remaining buffered amount: {} (bytes).", session->GetId(),
             session->GetAddress(), ws->getBufferedAmount());
+        session->SendQueuedMessages();
     } else {
         spdlog::debug("Draining WebSocket backpressure: unknown client. Remaining buffered amount: {} (bytes).", ws->getBufferedAmount());
     }
@@ -159,312 +199,15 @@ void OnDrain(uWS::WebSocket<false, true>* ws) {
 // Forward message requests to session callbacks after parsing message into relevant ProtoBuf message
 void OnMessage(uWS::WebSocket<false, true>* ws, std::string_view sv_message, uWS::OpCode op_code) {
     uint32_t session_id = static_cast<PerSocketData*>(ws->getUserData())->session_id;
-    Session* session = sessions[session_id];
+    Session* session = FindSession(session_id);
     if (!session) {
         spdlog::error("Missing session!");
         return;
     }
 
     if (op_code == uWS::OpCode::BINARY) {
-        if (sv_message.length() >= sizeof(carta::EventHeader)) {
-            session->UpdateLastMessageTimestamp();
-
-            carta::EventHeader head = *reinterpret_cast<const carta::EventHeader*>(sv_message.data());
-            const char* event_buf = sv_message.data() + sizeof(carta::EventHeader);
-            int event_length = sv_message.length() - sizeof(carta::EventHeader);
-            OnMessageTask* tsk = nullptr;
-
-            CARTA::EventType event_type = static_cast<CARTA::EventType>(head.type);
-            LogReceivedEventType(event_type);
-
-            switch (head.type) {
-                case CARTA::EventType::REGISTER_VIEWER: {
-                    CARTA::RegisterViewer message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnRegisterViewer(message, head.icd_version, head.request_id);
-                    } else {
-                        spdlog::warn("Bad REGISTER_VIEWER message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::RESUME_SESSION: {
-                    CARTA::ResumeSession message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnResumeSession(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad RESUME_SESSION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_IMAGE_CHANNELS: {
-                    CARTA::SetImageChannels message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->ImageChannelLock(message.file_id());
-                        if (!session->ImageChannelTaskTestAndSet(message.file_id())) {
-                            tsk = new (tbb::task::allocate_root(session->Context())) SetImageChannelsTask(session, message.file_id());
-                        }
-                        // has its own queue to keep channels in order during animation
-                        session->AddToSetChannelQueue(message, head.request_id);
-                        session->ImageChannelUnlock(message.file_id());
-                    } else {
-                        spdlog::warn("Bad SET_IMAGE_CHANNELS message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_CURSOR: {
-                    CARTA::SetCursor message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->AddCursorSetting(message, head.request_id);
-                        tsk = new (tbb::task::allocate_root(session->Context())) SetCursorTask(session, message.file_id());
-                    } else {
-                        spdlog::warn("Bad SET_CURSOR message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_HISTOGRAM_REQUIREMENTS: {
-                    CARTA::SetHistogramRequirements message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        if (message.histograms_size() == 0) {
-                            session->CancelSetHistRequirements();
-                        } else {
-                            session->ResetHistContext();
-                            tsk = new (tbb::task::allocate_root(session->HistContext()))
-                                SetHistogramRequirementsTask(session, head, event_length, event_buf);
-                        }
-                    } else {
-                        spdlog::warn("Bad SET_HISTOGRAM_REQUIREMENTS message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::CLOSE_FILE: {
-                    CARTA::CloseFile message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnCloseFile(message);
-                    } else {
-                        spdlog::warn("Bad CLOSE_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::START_ANIMATION: {
-                    CARTA::StartAnimation message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->CancelExistingAnimation();
-                        session->BuildAnimationObject(message, head.request_id);
-                        tsk = new (tbb::task::allocate_root(session->AnimationContext())) AnimationTask(session);
-                    } else {
-                        spdlog::warn("Bad START_ANIMATION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::STOP_ANIMATION: {
-                    CARTA::StopAnimation message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->StopAnimation(message.file_id(), message.end_frame());
-                    } else {
-                        spdlog::warn("Bad STOP_ANIMATION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::ANIMATION_FLOW_CONTROL: {
-                    CARTA::AnimationFlowControl message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->HandleAnimationFlowControlEvt(message);
-                    } else {
-                        spdlog::warn("Bad ANIMATION_FLOW_CONTROL message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::FILE_INFO_REQUEST: {
-                    CARTA::FileInfoRequest message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnFileInfoRequest(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad FILE_INFO_REQUEST message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::OPEN_FILE: {
-                    CARTA::OpenFile message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnOpenFile(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad OPEN_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::ADD_REQUIRED_TILES: {
-                    CARTA::AddRequiredTiles message;
-                    message.ParseFromArray(event_buf, event_length);
-                    tsk = new (tbb::task::allocate_root(session->Context())) OnAddRequiredTilesTask(session, message);
-                    break;
-                }
-                case CARTA::EventType::REGION_FILE_INFO_REQUEST: {
-                    CARTA::RegionFileInfoRequest message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnRegionFileInfoRequest(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad REGION_FILE_INFO_REQUEST message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::IMPORT_REGION: {
-                    CARTA::ImportRegion message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnImportRegion(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad IMPORT_REGION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::EXPORT_REGION: {
-                    CARTA::ExportRegion message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnExportRegion(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad EXPORT_REGION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_CONTOUR_PARAMETERS: {
-                    CARTA::SetContourParameters message;
-                    message.ParseFromArray(event_buf, event_length);
-                    tsk = new (tbb::task::allocate_root(session->Context())) OnSetContourParametersTask(session, message);
-                    break;
-                }
-                case CARTA::EventType::SCRIPTING_RESPONSE: {
-                    CARTA::ScriptingResponse message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnScriptingResponse(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad SCRIPTING_RESPONSE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_REGION: {
-                    CARTA::SetRegion message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnSetRegion(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad SET_REGION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::REMOVE_REGION: {
-                    CARTA::RemoveRegion message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnRemoveRegion(message);
-                    } else {
-                        spdlog::warn("Bad REMOVE_REGION message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SET_SPECTRAL_REQUIREMENTS: {
-                    CARTA::SetSpectralRequirements message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnSetSpectralRequirements(message);
-                    } else {
-                        spdlog::warn("Bad SET_SPECTRAL_REQUIREMENTS message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::CATALOG_FILE_INFO_REQUEST: {
-                    CARTA::CatalogFileInfoRequest message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnCatalogFileInfo(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad CATALOG_FILE_INFO_REQUEST message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::OPEN_CATALOG_FILE: {
-                    CARTA::OpenCatalogFile message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnOpenCatalogFile(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad OPEN_CATALOG_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::CLOSE_CATALOG_FILE: {
-                    CARTA::CloseCatalogFile message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnCloseCatalogFile(message);
-                    } else {
-                        spdlog::warn("Bad CLOSE_CATALOG_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::CATALOG_FILTER_REQUEST: {
-                    CARTA::CatalogFilterRequest message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnCatalogFilter(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad CLOSE_CATALOG_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::STOP_MOMENT_CALC: {
-                    CARTA::StopMomentCalc message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnStopMomentCalc(message);
-                    } else {
-                        spdlog::warn("Bad STOP_MOMENT_CALC message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SAVE_FILE: {
-                    CARTA::SaveFile message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnSaveFile(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad SAVE_FILE message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::SPECTRAL_LINE_REQUEST: {
-                    CARTA::SpectralLineRequest message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        tsk =
-                            new (tbb::task::allocate_root(session->Context())) OnSpectralLineRequestTask(session, message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad SPECTRAL_LINE_REQUEST message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::CONCAT_STOKES_FILES: {
-                    CARTA::ConcatStokesFiles message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        session->OnConcatStokesFiles(message, head.request_id);
-                    } else {
-                        spdlog::warn("Bad CONCAT_STOKES_FILES message!");
-                    }
-                    break;
-                }
-                case CARTA::EventType::STOP_FILE_LIST: {
-                    CARTA::StopFileList message;
-                    if (message.ParseFromArray(event_buf, event_length)) {
-                        if (message.file_list_type() == CARTA::Image) {
-                            session->StopImageFileList();
-                        } else {
-                            session->StopCatalogFileList();
-                        }
-                    } else {
-                        spdlog::warn("Bad STOP_FILE_LIST message!");
-                    }
-                    break;
-                }
-                default: {
-                    // Copy memory into new buffer to be used and disposed by MultiMessageTask::execute
-                    char* message_buffer = new char[event_length];
-                    memcpy(message_buffer, event_buf, event_length);
-                    tsk = new (tbb::task::allocate_root(session->Context())) MultiMessageTask(session, head, event_length, message_buffer);
-                }
-            }
-
-            if (tsk) {
-                tbb::task::enqueue(*tsk);
-            }
-        }
+        carta::SessionRecorder::Record(session_id, sv_message);
+        DispatchMessage(session, sv_message);
     } else if (op_code == uWS::OpCode::TEXT) {
         if (sv_message == "PING") {
             auto t_session = session->GetLastMessageTimestamp();
@@ -474,12 +217,44 @@ void OnMessage(uWS::WebSocket<false, true>* ws, std::string_view sv_message, uWS
                 spdlog::warn("Client {} has been idle for {} seconds. Disconnecting..", session->GetId(), dt.count());
                 ws->close();
             } else {
+                if ((settings.idle_session_hibernate_time > 0) && (dt.count() >= settings.idle_session_hibernate_time) &&
+                    !session->Hibernated()) {
+                    session->Hibernate();
+                }
                 ws->send("PONG", uWS::OpCode::TEXT);
             }
         }
     }
 }
 
+// Registers the frontend routes and the WebSocket behavior with the app of an event loop
+void AddRoutes(uWS::App& app) {
+    if (http_server && http_server->CanServeFrontend()) {
+        http_server->RegisterRoutes(app);
+    }
+
+    app.ws<PerSocketData>("/*", (uWS::App::WebSocketBehavior){.compression = uWS::DEDICATED_COMPRESSOR_256KB,
+                                    .maxPayloadLength = 256 * 1024 * 1024,
+                                    .maxBackpressure = MAX_BACKPRESSURE,
+                                    .upgrade = OnUpgrade,
+                                    .open = OnConnect,
+                                    .message = OnMessage,
+                                    .drain = OnDrain,
+                                    .close = OnDisconnect});
+}
+
+// Runs another event loop on the port of the first, sharing its connections with SO_REUSEPORT
+void RunSocketLoop(int port) {
+    auto app = uWS::App();
+    AddRoutes(app);
+    app.listen(settings.host, port, 0, [&](auto* token) {
+        if (!token) {
+            spdlog::warn("Event loop could not listen on port {}.", port);
+        }
+    });
+    app.run();
+}
+
 void GrpcSilentLogger(gpr_log_func_args*) {}
 
 extern void gpr_default_log(gpr_log_func_args* args);
@@ -501,6 +276,10 @@ int StartGrpcService(int grpc_port) {
     // Register and start carta grpc server
     carta_grpc_service = std::unique_ptr<CartaGrpcService>(new CartaGrpcService());
     builder.RegisterService(carta_grpc_service.get());
+    carta_data_service = std::unique_ptr<CartaDataService>(new CartaDataService(*carta_grpc_service));
+    builder.RegisterService(carta_data_service.get());
+    carta_worker_service = std::unique_ptr<CartaWorkerService>(new CartaWorkerService(settings.top_level_folder, settings.read_only_mode));
+    builder.RegisterService(carta_worker_service.get());
     // By default ports can be reused; we don't want this
     builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 0);
     carta_grpc_server = builder.BuildAndStart();
@@ -521,6 +300,9 @@ void ExitBackend(int s) {
     if (carta_grpc_server) {
         carta_grpc_server->Shutdown();
     }
+    if (http_server) {
+        http_server->FlushPreferences();
+    }
     FlushLogFile();
     exit(0);
 }
@@ -541,8 +323,31 @@ int main(int argc, char* argv[]) {
             exit(0);
         }
 
-        InitLogger(settings.no_log, settings.verbosity, settings.log_performance, settings.log_protocol_messages);
+        InitLogger(settings.no_log, settings.verbosity, settings.log_performance, settings.log_protocol_messages, settings.log_queue);
         settings.FlushMessages(); // flush log messages produced during Program Settings setup
+        carta::LatencyHistograms::SetEnabled(settings.log_performance);
+        if (!settings.trace_file.empty()) {
+            if (carta::Tracer::Start(settings.trace_file, std::max(settings.trace_session, 0))) {
+                spdlog::info("Writing trace events to {}", settings.trace_file);
+            } else {
+                spdlog::warn("Could not write trace events to {}", settings.trace_file);
+            }
+        }
+        if (!settings.record_folder.empty() && carta::SessionRecorder::SetFolder(settings.record_folder)) {
+            spdlog::info("Recording received messages of new sessions to {}", settings.record_folder);
+        }
+        if (!settings.slow_request_log.empty()) {
+            std::string thresholds_error;
+            if (!carta::SlowRequestLog::Configure(settings.slow_request_thresholds, settings.slow_request_ms, thresholds_error)) {
+                spdlog::warn("{}; using the default slow request thresholds.", thresholds_error);
+                carta::SlowRequestLog::Configure(DEFAULT_SLOW_REQUEST_THRESHOLDS, SLOW_REQUEST_MS, thresholds_error);
+            }
+            if (carta::SlowRequestLog::Start(settings.slow_request_log)) {
+                spdlog::info("Logging slow requests to {}", settings.slow_request_log);
+            } else {
+                spdlog::warn("Could not write the slow request log {}", settings.slow_request_log);
+            }
+        }
 
         if (settings.wait_time >= 0) {
             Session::SetExitTimeout(settings.wait_time);
@@ -552,6 +357,55 @@ int main(int argc, char* argv[]) {
             Session::SetInitExitTimeout(settings.init_wait_time);
         }
 
+        if (settings.lazy_tile_threshold > 0) {
+            Frame::SetLazyTileThreshold((int64_t)settings.lazy_tile_threshold * 1000000);
+        }
+        if (settings.compact_cache_threshold > 0) {
+            Frame::SetCompactCacheThreshold((int64_t)settings.compact_cache_threshold * 1000000);
+        }
+        if (settings.approximate_spectral_threshold > 0) {
+            carta::RegionHandler::SetApproximateSpectralThreshold((int64_t)settings.approximate_spectral_threshold * 1000000);
+        }
+        if ((settings.gpu_threshold >= 0) && !carta::GpuCompute::Enable((int64_t)settings.gpu_threshold * 1000000)) {
+            spdlog::warn("No GPU available; smoothing, statistics and histograms run on the CPU.");
+        }
+        if (settings.contour_simplification > 0) {
+            SetContourSimplification(settings.contour_simplification);
+        }
+
+        if (!settings.workers.empty()) {
+            std::string workers_error;
+            if (carta::WorkerPool::Global().SetWorkers(settings.workers, workers_error)) {
+                spdlog::info("Sending moments, cube histograms and exports to workers {}", settings.workers);
+            } else {
+                spdlog::warn("{}; running all jobs locally.", workers_error);
+            }
+        }
+
+        carta::Hdf5Loader::SetChunkCacheSize(settings.hdf5_chunk_cache);
+        carta::CasaLoader::SetTileCacheSize(settings.casa_tile_cache);
+        carta::MomentGenerator::SetMemoryLimit(settings.moment_memory);
+        carta::MemoryBudget::Global().SetLimit((size_t)std::max(settings.memory_budget, 0) * 1024 * 1024);
+
+        std::string compression_error;
+        if (!carta::CompressionPolicy::Global().Configure(settings.compression_policy, compression_error)) {
+            spdlog::warn("{}; using the default compression policy.", compression_error);
+        }
+        carta::CompressionPolicy::Global().SetThreshold(std::max(settings.compression_threshold, 0));
+        if (settings.shared_memory > 0) {
+            carta::SharedMemoryRing::Configure((size_t)settings.shared_memory * 1024 * 1024, SHARED_MEMORY_THRESHOLD);
+            spdlog::info("Frontends on this host may receive large messages through {} MB of shared memory.", settings.shared_memory);
+        }
+
+        if (!settings.cache_folder.empty()) {
+            try {
+                fs::create_directories(settings.cache_folder);
+                carta::SidecarCache::SetFolder(settings.cache_folder);
+            } catch (const std::exception& err) {
+                spdlog::warn("Could not create cache folder {}: {}", settings.cache_folder, err.what());
+            }
+        }
+
         std::string executable_path;
         bool have_executable_path(FindExecutablePath(executable_path));
 
@@ -561,6 +415,7 @@ int main(int argc, char* argv[]) {
         }
 
         spdlog::info("{}: Version {}", executable_path, VERSION_ID);
+        spdlog::debug("Using {} kernels for image data", carta::GetSimdLevelName());
 
         if (!CheckFolderPaths(settings.top_level_folder, settings.starting_folder)) {
             FlushLogFile();
@@ -582,6 +437,10 @@ int main(int argc, char* argv[]) {
 
         tbb::task_scheduler_init task_scheduler(TBB_TASK_THREAD_COUNT);
         carta::ThreadManager::SetThreadLimit(settings.omp_thread_count);
+        carta::ThreadManager::SetNumaPinning(settings.numa_pinning);
+
+        // Measures tables and the files to load are read while the services start and the frontend connects
+        carta::FilePreloader::Start(settings.top_level_folder, settings.files);
 
         // One FileListHandler works for all sessions.
         file_list_handler = new FileListHandler(settings.top_level_folder, settings.starting_folder);
@@ -599,7 +458,6 @@ int main(int argc, char* argv[]) {
         curl_global_init(CURL_GLOBAL_ALL);
 
         session_number = 0;
-        auto app = uWS::App();
 
         if (!settings.no_http) {
             fs::path frontend_path;
@@ -617,16 +475,18 @@ int main(int argc, char* argv[]) {
 
             if (!frontend_path.empty()) {
                 http_server = new SimpleFrontendServer(frontend_path, auth_token, settings.read_only_mode);
-                if (http_server->CanServeFrontend()) {
-                    http_server->RegisterRoutes(app);
-                } else {
+                if (!http_server->CanServeFrontend()) {
                     spdlog::warn("Failed to host the CARTA frontend. Please specify a custom location using the frontend_folder argument.");
                 }
             }
         }
 
+        auto app = uWS::App();
+        AddRoutes(app);
+
         bool port_ok(false);
         int port(-1);
+        us_listen_socket_t* listen_socket(nullptr);
 
         if (settings.port.size() == 1) {
             // If the user specifies a valid port, we should not try other ports
@@ -634,6 +494,7 @@ int main(int argc, char* argv[]) {
             app.listen(settings.host, port, LIBUS_LISTEN_EXCLUSIVE_PORT, [&](auto* token) {
                 if (token) {
                     port_ok = true;
+                    listen_socket = token;
                 } else {
                     spdlog::error("Could not listen on port {}!\n", port);
                 }
@@ -652,6 +513,7 @@ int main(int argc, char* argv[]) {
                 app.listen(settings.host, port, LIBUS_LISTEN_EXCLUSIVE_PORT, [&](auto* token) {
                     if (token) {
                         port_ok = true;
+                        listen_socket = token;
                     } else {
                         spdlog::warn("Port {} is already in use. Trying next port.", port);
                         ++port;
@@ -660,6 +522,21 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        // The port is found with an exclusive socket, so that it is not shared with another process; the event loops then listen on
+        // it together, and the kernel balances new connections over them
+        int num_socket_loops = std::max(settings.socket_loops, 1);
+        if (port_ok && num_socket_loops > 1) {
+            us_listen_socket_close(0, listen_socket);
+            port_ok = false;
+            app.listen(settings.host, port, 0, [&](auto* token) {
+                if (token) {
+                    port_ok = true;
+                } else {
+                    spdlog::error("Could not listen on port {} with {} event loops!", port, num_socket_loops);
+                }
+            });
+        }
+
         if (port_ok) {
             string start_info = fmt::format("Listening on port {} with top level folder {}, starting folder {}", port,
                 settings.top_level_folder, settings.starting_folder);
@@ -669,6 +546,9 @@ int main(int argc, char* argv[]) {
                 start_info += fmt::format(". The number of OpenMP worker threads will be handled automatically.");
             }
             spdlog::info(start_info);
+            if (num_socket_loops > 1) {
+                spdlog::info("Sessions are served by {} WebSocket event loops.", num_socket_loops);
+            }
             if (http_server && http_server->CanServeFrontend()) {
                 string default_host_string = settings.host;
                 if (default_host_string.empty() || default_host_string == "0.0.0.0") {
@@ -715,15 +595,15 @@ int main(int argc, char* argv[]) {
                 spdlog::info("CARTA is accessible at {}", frontend_url);
             }
 
-            app.ws<PerSocketData>("/*", (uWS::App::WebSocketBehavior){.compression = uWS::DEDICATED_COMPRESSOR_256KB,
-                                            .maxPayloadLength = 256 * 1024 * 1024,
-                                            .maxBackpressure = MAX_BACKPRESSURE,
-                                            .upgrade = OnUpgrade,
-                                            .open = OnConnect,
-                                            .message = OnMessage,
-                                            .drain = OnDrain,
-                                            .close = OnDisconnect})
-                .run();
+            // Each session stays on the loop which accepted it, which sends its messages and compresses them
+            std::vector<std::thread> socket_loops;
+            for (int i = 1; i < num_socket_loops; i++) {
+                socket_loops.emplace_back(RunSocketLoop, port);
+            }
+            app.run();
+            for (auto& socket_loop : socket_loops) {
+                socket_loop.join();
+            }
         }
     } catch (exception& e) {
         spdlog::critical("{}", e.what());
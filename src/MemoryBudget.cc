@@ -0,0 +1,154 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MemoryBudget.cc: process-wide memory accounting of caches, with cost-aware LRU eviction across caches and sessions
+
+#include "MemoryBudget.h"
+
+#include <algorithm>
+
+#include "Logger/Logger.h"
+
+// Seconds between logs of the cache memory per session
+#define MEMORY_BUDGET_LOG_INTERVAL 10
+
+namespace carta {
+
+MemoryAccount::MemoryAccount(const std::string& name, double cost_per_mb, MemoryConsumer* consumer)
+    : _name(name), _cost_per_mb(std::max(cost_per_mb, 1e-6)), _consumer(consumer), _session_id(0), _usage(0) {
+    MemoryBudget::Global().Register(this);
+}
+
+MemoryAccount::~MemoryAccount() {
+    MemoryBudget::Global().Unregister(this);
+}
+
+void MemoryAccount::SetUsage(size_t bytes) {
+    size_t previous = _usage.exchange(bytes);
+    auto& budget = MemoryBudget::Global();
+    if (bytes >= previous) {
+        budget._usage += bytes - previous;
+    } else {
+        budget._usage -= previous - bytes;
+    }
+}
+
+void MemoryAccount::Enforce() {
+    auto& budget = MemoryBudget::Global();
+    size_t limit = budget.Limit();
+    if (limit && budget.Usage() > limit) {
+        budget.Enforce();
+    }
+}
+
+MemoryBudget::MemoryBudget() : _limit(0), _usage(0) {}
+
+MemoryBudget& MemoryBudget::Global() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+void MemoryBudget::SetLimit(size_t bytes) {
+    _limit = bytes;
+    if (bytes) {
+        spdlog::debug("Cache memory is limited to {} MB", bytes / (1024 * 1024));
+        Enforce();
+    }
+}
+
+void MemoryBudget::Register(MemoryAccount* account) {
+    std::scoped_lock lock(_mutex);
+    _accounts.push_back(account);
+}
+
+void MemoryBudget::Unregister(MemoryAccount* account) {
+    // Waits for an eviction in progress, which may be calling the cache of the account
+    std::scoped_lock lock(_mutex);
+    _accounts.erase(std::remove(_accounts.begin(), _accounts.end(), account), _accounts.end());
+    account->SetUsage(0);
+}
+
+void MemoryBudget::Enforce() {
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+
+    size_t evicted_bytes(0), evicted_entries(0);
+    while (_limit && _usage > _limit) {
+        // The entry which has been unused longest relative to the cost of calculating it again, whichever cache or session it is in
+        auto now = std::chrono::steady_clock::now();
+        MemoryAccount* victim(nullptr);
+        double victim_score(0.0);
+        for (auto account : _accounts) {
+            std::chrono::steady_clock::time_point last_used;
+            if (!account->_consumer || !account->_usage || !account->_consumer->OldestEntry(last_used)) {
+                continue;
+            }
+            double age = std::chrono::duration<double>(now - last_used).count();
+            double score = (age + 1.0) / account->_cost_per_mb;
+            if (!victim || score > victim_score) {
+                victim = account;
+                victim_score = score;
+            }
+        }
+        if (!victim) {
+            break;
+        }
+
+        size_t num_bytes = victim->_consumer->EvictOldest();
+        if (!num_bytes) {
+            break;
+        }
+        evicted_bytes += num_bytes;
+        evicted_entries++;
+    }
+
+    if (evicted_entries) {
+        spdlog::performance("Evicted {} cache entries ({:.1f} MB) to stay within the memory budget", evicted_entries,
+            evicted_bytes / (1024.0 * 1024.0));
+    }
+}
+
+std::map<uint32_t, size_t> MemoryBudget::SessionUsage() {
+    std::scoped_lock lock(_mutex);
+    std::map<uint32_t, size_t> usage;
+    for (auto account : _accounts) {
+        usage[account->_session_id] += account->_usage;
+    }
+    return usage;
+}
+
+std::map<std::string, size_t> MemoryBudget::CacheUsage() {
+    std::scoped_lock lock(_mutex);
+    std::map<std::string, size_t> usage;
+    for (auto account : _accounts) {
+        usage[account->_name] += account->_usage;
+    }
+    return usage;
+}
+
+void MemoryBudget::LogUsage() {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::scoped_lock lock(_mutex);
+        if (_last_log.time_since_epoch().count() && now - _last_log < std::chrono::seconds(MEMORY_BUDGET_LOG_INTERVAL)) {
+            return;
+        }
+        _last_log = now;
+    }
+
+    for (auto& [session_id, num_bytes] : SessionUsage()) {
+        if (session_id) {
+            spdlog::performance("Session {} caches use {:.1f} MB", session_id, num_bytes / (1024.0 * 1024.0));
+        } else {
+            spdlog::performance("Shared caches use {:.1f} MB", num_bytes / (1024.0 * 1024.0));
+        }
+    }
+    spdlog::performance("Caches use {:.1f} MB in total", _usage / (1024.0 * 1024.0));
+}
+
+} // namespace carta
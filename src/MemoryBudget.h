@@ -0,0 +1,102 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MemoryBudget.h: process-wide memory accounting of caches, with cost-aware LRU eviction across caches and sessions
+
+#ifndef CARTA_BACKEND__MEMORYBUDGET_H_
+#define CARTA_BACKEND__MEMORYBUDGET_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace carta {
+
+// A cache with entries which the memory budget may evict, least recently used first
+class MemoryConsumer {
+public:
+    virtual ~MemoryConsumer() = default;
+    // Last use of the least recently used entry; false if there is no entry to evict
+    virtual bool OldestEntry(std::chrono::steady_clock::time_point& last_used) = 0;
+    // Evicts the least recently used entry and returns the bytes freed
+    virtual size_t EvictOldest() = 0;
+};
+
+// Memory used by one cache, charged to the process budget. A cache sets its usage while holding its own lock, and calls Enforce
+// after releasing it, since eviction calls back into the caches. Declared after the cache contents, so that it is unregistered
+// before they are destroyed.
+class MemoryAccount {
+public:
+    // Cost is the estimated seconds to calculate a MB of the cache again; consumer is null for memory which is not evictable
+    MemoryAccount(const std::string& name, double cost_per_mb, MemoryConsumer* consumer = nullptr);
+    ~MemoryAccount();
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    // Session of a per-frame cache, for reporting; 0 for caches shared by all sessions
+    void SetSessionId(uint32_t session_id) {
+        _session_id = session_id;
+    }
+    void SetUsage(size_t bytes);
+    size_t Usage() const {
+        return _usage;
+    }
+    void Enforce();
+
+private:
+    friend class MemoryBudget;
+
+    std::string _name;
+    double _cost_per_mb;
+    MemoryConsumer* _consumer;
+    std::atomic<uint32_t> _session_id;
+    std::atomic<size_t> _usage;
+};
+
+class MemoryBudget {
+public:
+    static MemoryBudget& Global();
+
+    // Limit of the memory of all caches in bytes, 0 for no limit
+    void SetLimit(size_t bytes);
+    size_t Limit() const {
+        return _limit;
+    }
+    size_t Usage() const {
+        return _usage;
+    }
+
+    // Evicts cache entries, the oldest relative to their cost first, until the usage is within the limit. Returns immediately if
+    // another thread is already evicting.
+    void Enforce();
+
+    // Bytes used by the caches of each session; session 0 has the caches shared by all sessions
+    std::map<uint32_t, size_t> SessionUsage();
+    // Bytes used by each kind of cache, by account name
+    std::map<std::string, size_t> CacheUsage();
+    void LogUsage();
+
+private:
+    friend class MemoryAccount;
+
+    MemoryBudget();
+    void Register(MemoryAccount* account);
+    void Unregister(MemoryAccount* account);
+
+    std::mutex _mutex; // held while evicting, so that accounts are not unregistered while their caches are called
+    std::vector<MemoryAccount*> _accounts;
+    std::atomic<size_t> _limit;
+    std::atomic<size_t> _usage;
+    std::chrono::steady_clock::time_point _last_log;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__MEMORYBUDGET_H_
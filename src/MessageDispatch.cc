@@ -0,0 +1,399 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MessageDispatch.cc: parses binary ICD messages and passes them to session handlers and tasks
+
+#include "MessageDispatch.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "Constants.h"
+#include "EventHeader.h"
+#include "Logger/Logger.h"
+#include "Metrics.h"
+#include "OnMessageTask.h"
+#include "Timer/SlowRequestLog.h"
+#include "Timer/TraceEvents.h"
+
+void DispatchMessage(Session* session, std::string_view sv_message) {
+    if (sv_message.length() < sizeof(carta::EventHeader)) {
+        return;
+    }
+
+    session->UpdateLastMessageTimestamp();
+    auto t_start = std::chrono::steady_clock::now();
+
+    carta::EventHeader head = *reinterpret_cast<const carta::EventHeader*>(sv_message.data());
+    const char* event_buf = sv_message.data() + sizeof(carta::EventHeader);
+    int event_length = sv_message.length() - sizeof(carta::EventHeader);
+    OnMessageTask* tsk = nullptr;
+
+    CARTA::EventType event_type = static_cast<CARTA::EventType>(head.type);
+    LogReceivedEventType(event_type);
+
+    // A hibernated session restores its view before the message is handled, unless the frontend resumes the session itself
+    if (session->Hibernated() && (event_type != CARTA::EventType::RESUME_SESSION)) {
+        session->Rehydrate();
+    }
+
+    carta::TraceContext trace_context;
+    trace_context.session_id = session->GetId();
+    trace_context.request_id = head.request_id;
+    carta::TraceScope trace_scope(trace_context);
+    carta::TraceSpan trace_span("receive", "message");
+    if (trace_span.Traced()) {
+        trace_span.SetStart(t_start);
+        trace_span.SetDetail(CARTA::EventType_Name(event_type));
+    }
+
+    // Messages handled here rather than by a task are logged if slow once handled
+    carta::RequestRecord request;
+    request.event_type = event_type;
+    request.session_id = session->GetId();
+    request.request_id = head.request_id;
+    request.start = t_start;
+    carta::RequestScope request_scope(&request);
+
+    switch (head.type) {
+        case CARTA::EventType::REGISTER_VIEWER: {
+            CARTA::RegisterViewer message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnRegisterViewer(message, head.icd_version, head.request_id);
+            } else {
+                spdlog::warn("Bad REGISTER_VIEWER message!");
+            }
+            break;
+        }
+        case CARTA::EventType::RESUME_SESSION: {
+            CARTA::ResumeSession message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnResumeSession(message, head.request_id);
+            } else {
+                spdlog::warn("Bad RESUME_SESSION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_IMAGE_CHANNELS: {
+            CARTA::SetImageChannels message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->ImageChannelLock(message.file_id());
+                if (!session->ImageChannelTaskTestAndSet(message.file_id())) {
+                    tsk = new SetImageChannelsTask(session, message.file_id());
+                }
+                // has its own queue to keep channels in order during animation
+                session->AddToSetChannelQueue(message, head.request_id);
+                session->ImageChannelUnlock(message.file_id());
+            } else {
+                spdlog::warn("Bad SET_IMAGE_CHANNELS message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_CURSOR: {
+            CARTA::SetCursor message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->AddCursorSetting(message, head.request_id);
+                tsk = new SetCursorTask(session, message.file_id());
+            } else {
+                spdlog::warn("Bad SET_CURSOR message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_HISTOGRAM_REQUIREMENTS: {
+            CARTA::SetHistogramRequirements message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                if (message.histograms_size() == 0) {
+                    session->CancelSetHistRequirements();
+                } else {
+                    session->ResetHistCancellation();
+                    tsk = new SetHistogramRequirementsTask(session, head, event_length, event_buf);
+                }
+            } else {
+                spdlog::warn("Bad SET_HISTOGRAM_REQUIREMENTS message!");
+            }
+            break;
+        }
+        case CARTA::EventType::CLOSE_FILE: {
+            CARTA::CloseFile message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnCloseFile(message);
+            } else {
+                spdlog::warn("Bad CLOSE_FILE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::START_ANIMATION: {
+            CARTA::StartAnimation message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->CancelExistingAnimation();
+                session->BuildAnimationObject(message, head.request_id);
+                tsk = new AnimationTask(session);
+            } else {
+                spdlog::warn("Bad START_ANIMATION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::STOP_ANIMATION: {
+            CARTA::StopAnimation message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->StopAnimation(message.file_id(), message.end_frame());
+            } else {
+                spdlog::warn("Bad STOP_ANIMATION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::ANIMATION_FLOW_CONTROL: {
+            CARTA::AnimationFlowControl message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->HandleAnimationFlowControlEvt(message);
+            } else {
+                spdlog::warn("Bad ANIMATION_FLOW_CONTROL message!");
+            }
+            break;
+        }
+        case CARTA::EventType::FILE_INFO_REQUEST: {
+            CARTA::FileInfoRequest message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnFileInfoRequest(message, head.request_id);
+            } else {
+                spdlog::warn("Bad FILE_INFO_REQUEST message!");
+            }
+            break;
+        }
+        case CARTA::EventType::OPEN_FILE: {
+            CARTA::OpenFile message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnOpenFile(message, head.request_id);
+            } else {
+                spdlog::warn("Bad OPEN_FILE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::ADD_REQUIRED_TILES: {
+            auto tiles_task = new OnAddRequiredTilesTask(session);
+            tiles_task->Parse(event_buf, event_length);
+            if (!tiles_task->Message().tiles().empty()) {
+                // A new tile request replaces the previous one, as Session::OnAddRequiredTiles does for a running request
+                tiles_task->SetCancellation(session->SupersedeRequest(event_type, tiles_task->Message().file_id()));
+            }
+            tsk = tiles_task;
+            break;
+        }
+        case SHARED_MEMORY_REQUEST_EVENT_TYPE: {
+            CARTA::data::SharedMemoryRequest message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnSharedMemoryRequest(head.request_id);
+            } else {
+                spdlog::warn("Bad SHARED_MEMORY_REQUEST message!");
+            }
+            break;
+        }
+        case ADD_REQUIRED_CHANNEL_TILES_EVENT_TYPE: {
+            auto tiles_task = new OnAddRequiredChannelTilesTask(session);
+            if (tiles_task->Parse(event_buf, event_length)) {
+                // A new channel-map request replaces the previous one for the file
+                tiles_task->SetCancellation(session->SupersedeRequest(event_type, tiles_task->Message().file_id()));
+                tsk = tiles_task;
+            } else {
+                spdlog::warn("Bad ADD_REQUIRED_CHANNEL_TILES message!");
+                delete tiles_task;
+            }
+            break;
+        }
+        case CARTA::EventType::REGION_FILE_INFO_REQUEST: {
+            CARTA::RegionFileInfoRequest message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnRegionFileInfoRequest(message, head.request_id);
+            } else {
+                spdlog::warn("Bad REGION_FILE_INFO_REQUEST message!");
+            }
+            break;
+        }
+        case CARTA::EventType::IMPORT_REGION: {
+            CARTA::ImportRegion message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnImportRegion(message, head.request_id);
+            } else {
+                spdlog::warn("Bad IMPORT_REGION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::EXPORT_REGION: {
+            CARTA::ExportRegion message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnExportRegion(message, head.request_id);
+            } else {
+                spdlog::warn("Bad EXPORT_REGION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_CONTOUR_PARAMETERS: {
+            auto contour_task = new OnSetContourParametersTask(session);
+            contour_task->Parse(event_buf, event_length);
+            contour_task->SetCancellation(session->SupersedeRequest(event_type, contour_task->Message().file_id()));
+            tsk = contour_task;
+            break;
+        }
+        case CARTA::EventType::SCRIPTING_RESPONSE: {
+            CARTA::ScriptingResponse message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnScriptingResponse(message, head.request_id);
+            } else {
+                spdlog::warn("Bad SCRIPTING_RESPONSE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_REGION: {
+            CARTA::SetRegion message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                if (message.region_id() > CURSOR_REGION_ID) {
+                    // has its own queue so that only the latest update is applied while dragging
+                    if (session->AddToSetRegionQueue(message, head.request_id)) {
+                        tsk = new SetRegionTask(session, message.region_id());
+                    }
+                } else {
+                    session->OnSetRegion(message, head.request_id);
+                }
+            } else {
+                spdlog::warn("Bad SET_REGION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::REMOVE_REGION: {
+            CARTA::RemoveRegion message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnRemoveRegion(message);
+            } else {
+                spdlog::warn("Bad REMOVE_REGION message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_SPATIAL_REQUIREMENTS: {
+            auto spatial_task = new OnSetSpatialRequirementsTask(session);
+            if (spatial_task->Parse(event_buf, event_length)) {
+                auto& message = spatial_task->Message();
+                spatial_task->SetCancellation(session->SupersedeRequest(event_type, message.file_id(), message.region_id()));
+                tsk = spatial_task;
+            } else {
+                delete spatial_task;
+                spdlog::warn("Bad SET_SPATIAL_REQUIREMENTS message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_STATS_REQUIREMENTS: {
+            auto stats_task = new OnSetStatsRequirementsTask(session);
+            if (stats_task->Parse(event_buf, event_length)) {
+                auto& message = stats_task->Message();
+                stats_task->SetCancellation(session->SupersedeRequest(event_type, message.file_id(), message.region_id()));
+                tsk = stats_task;
+            } else {
+                delete stats_task;
+                spdlog::warn("Bad SET_STATS_REQUIREMENTS message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SET_SPECTRAL_REQUIREMENTS: {
+            CARTA::SetSpectralRequirements message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnSetSpectralRequirements(message);
+            } else {
+                spdlog::warn("Bad SET_SPECTRAL_REQUIREMENTS message!");
+            }
+            break;
+        }
+        case CARTA::EventType::CATALOG_FILE_INFO_REQUEST: {
+            CARTA::CatalogFileInfoRequest message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnCatalogFileInfo(message, head.request_id);
+            } else {
+                spdlog::warn("Bad CATALOG_FILE_INFO_REQUEST message!");
+            }
+            break;
+        }
+        case CARTA::EventType::OPEN_CATALOG_FILE: {
+            CARTA::OpenCatalogFile message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnOpenCatalogFile(message, head.request_id);
+            } else {
+                spdlog::warn("Bad OPEN_CATALOG_FILE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::CLOSE_CATALOG_FILE: {
+            CARTA::CloseCatalogFile message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnCloseCatalogFile(message);
+            } else {
+                spdlog::warn("Bad CLOSE_CATALOG_FILE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::CATALOG_FILTER_REQUEST: {
+            CARTA::CatalogFilterRequest message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnCatalogFilter(message, head.request_id);
+            } else {
+                spdlog::warn("Bad CLOSE_CATALOG_FILE message!");
+            }
+            break;
+        }
+        case CARTA::EventType::STOP_MOMENT_CALC: {
+            CARTA::StopMomentCalc message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnStopMomentCalc(message);
+            } else {
+                spdlog::warn("Bad STOP_MOMENT_CALC message!");
+            }
+            break;
+        }
+        case CARTA::EventType::SPECTRAL_LINE_REQUEST: {
+            auto line_task = new OnSpectralLineRequestTask(session, head.request_id);
+            if (line_task->Parse(event_buf, event_length)) {
+                tsk = line_task;
+            } else {
+                delete line_task;
+                spdlog::warn("Bad SPECTRAL_LINE_REQUEST message!");
+            }
+            break;
+        }
+        case CARTA::EventType::CONCAT_STOKES_FILES: {
+            CARTA::ConcatStokesFiles message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                session->OnConcatStokesFiles(message, head.request_id);
+            } else {
+                spdlog::warn("Bad CONCAT_STOKES_FILES message!");
+            }
+            break;
+        }
+        case CARTA::EventType::STOP_FILE_LIST: {
+            CARTA::StopFileList message;
+            if (message.ParseFromArray(event_buf, event_length)) {
+                if (message.file_list_type() == CARTA::Image) {
+                    session->StopImageFileList();
+                } else {
+                    session->StopCatalogFileList();
+                }
+            } else {
+                spdlog::warn("Bad STOP_FILE_LIST message!");
+            }
+            break;
+        }
+        default: {
+            // Copy memory into new buffer to be used and disposed by MultiMessageTask::execute
+            char* message_buffer = new char[event_length];
+            memcpy(message_buffer, event_buf, event_length);
+            tsk = new MultiMessageTask(session, head, event_length, message_buffer);
+        }
+    }
+
+    if (tsk) {
+        tsk->SetRequest(event_type, head.request_id, t_start);
+        TaskScheduler::Enqueue(tsk);
+    } else {
+        carta::Metrics::Global().RecordRequest(event_type, std::chrono::steady_clock::now() - t_start);
+        request_scope.Finish();
+    }
+}
@@ -0,0 +1,20 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# MessageDispatch.h: parses binary ICD messages and passes them to session handlers and tasks
+
+#ifndef CARTA_BACKEND__MESSAGEDISPATCH_H_
+#define CARTA_BACKEND__MESSAGEDISPATCH_H_
+
+#include <string_view>
+
+class Session;
+
+// Handles a binary message of the session, an EventHeader followed by the ProtoBuf payload: it is either handled on the calling
+// thread or queued as a task. Called on the event loop thread of the session, or by the replay tool.
+void DispatchMessage(Session* session, std::string_view sv_message);
+
+#endif // CARTA_BACKEND__MESSAGEDISPATCH_H_
@@ -0,0 +1,257 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# Metrics.cc: process-wide counters of requests, caches and I/O, reported in the Prometheus text format
+
+#include "Metrics.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <carta-protobuf/enums.pb.h>
+
+#include "ImageData/LoaderIoStats.h"
+#include "MemoryBudget.h"
+#include "Session.h"
+#include "TaskScheduler.h"
+#include "Timer/LatencyHistogram.h"
+
+namespace carta {
+
+namespace {
+
+// Upper bounds in seconds of the buckets of the request duration histograms
+constexpr double RequestBuckets[] = {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0, 10.0};
+constexpr int NumRequestBuckets = sizeof(RequestBuckets) / sizeof(RequestBuckets[0]);
+
+const char* CacheName(CacheType cache) {
+    // Names of the caches in the memory budget
+    switch (cache) {
+        case CacheType::Tiles:
+            return "tiles";
+        case CacheType::Contours:
+            return "contours";
+        case CacheType::SmoothedPlanes:
+            return "smoothed planes";
+        case CacheType::ImagePlanes:
+            return "image planes";
+        case CacheType::SpectralLines:
+            return "spectral lines";
+        default:
+            return "";
+    }
+}
+
+const char* PriorityName(int priority) {
+    switch ((TaskPriority)priority) {
+        case TaskPriority::Cursor:
+            return "cursor";
+        case TaskPriority::Tiles:
+            return "tiles";
+        case TaskPriority::RegionData:
+            return "region_data";
+        case TaskPriority::Histograms:
+            return "histograms";
+        case TaskPriority::Background:
+            return "background";
+        default:
+            return "";
+    }
+}
+
+const char* ReadName(int read) {
+    static const char* names[] = {"slice", "cursor_spectral", "region_spectral", "swizzled", "mip"};
+    static_assert(sizeof(names) / sizeof(names[0]) == (int)LoaderRead::Count, "a loader read has no name");
+    return names[read];
+}
+
+const char* ShapeName(int shape) {
+    static const char* names[] = {"point", "row", "column", "plane", "spectrum", "cube"};
+    static_assert(sizeof(names) / sizeof(names[0]) == (int)SliceShape::Count, "a slice shape has no name");
+    return names[shape];
+}
+
+void Header(std::string& out, const char* name, const char* type, const char* help) {
+    out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+std::string LabelValue(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Loader read counters of sets of labels, e.g. session="1",file="a.fits"; each metric is one group of lines
+using LoaderIoSeries = std::vector<std::pair<std::string, LoaderIoStats::Totals>>;
+
+void LoaderIoReads(std::string& out, const LoaderIoSeries& series, const char* name, const char* help,
+    const std::function<double(const LoaderIoStats::ReadCounts&)>& value) {
+    Header(out, name, "counter", help);
+    for (auto& [labels, totals] : series) {
+        for (int read = 0; read < (int)LoaderRead::Count; ++read) {
+            if (totals.reads[read].calls) {
+                out += fmt::format("{}{{{}{}read=\"{}\"}} {}\n", name, labels, labels.empty() ? "" : ",", ReadName(read),
+                    value(totals.reads[read]));
+            }
+        }
+    }
+}
+
+void LoaderIo(std::string& out, const LoaderIoSeries& series) {
+    LoaderIoReads(out, series, "carta_loader_io_reads_total", "File loader reads by read path; spectral reads include the reads they make",
+        [](auto& counts) { return counts.calls; });
+    LoaderIoReads(out, series, "carta_loader_io_bytes_total", "Data returned by file loader reads",
+        [](auto& counts) { return counts.bytes; });
+    LoaderIoReads(out, series, "carta_loader_io_seconds_total", "Time in file loader reads",
+        [](auto& counts) { return counts.time_us * 1e-6; });
+    LoaderIoReads(out, series, "carta_loader_io_repeated_reads_total", "File loader reads of the same data as one of the last reads",
+        [](auto& counts) { return counts.repeated; });
+
+    Header(out, "carta_loader_io_slice_shapes_total", "counter", "Image slices read, by the axes longer than one pixel");
+    for (auto& [labels, totals] : series) {
+        for (int shape = 0; shape < (int)SliceShape::Count; ++shape) {
+            if (totals.shapes[shape]) {
+                out += fmt::format("carta_loader_io_slice_shapes_total{{{}{}shape=\"{}\"}} {}\n", labels, labels.empty() ? "" : ",",
+                    ShapeName(shape), totals.shapes[shape]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+struct Metrics::RequestCounts {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_us{0};
+    std::atomic<uint64_t> buckets[NumRequestBuckets] = {}; // not cumulative
+};
+
+Metrics::Metrics()
+    : _requests(new RequestCounts[CARTA::EventType_ARRAYSIZE]), _open_frames(0), _queued_bytes(0), _bytes_read(0) {}
+
+Metrics::~Metrics() = default;
+
+Metrics& Metrics::Global() {
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::RecordRequest(int event_type, std::chrono::steady_clock::duration duration) {
+    if (event_type < 0 || event_type >= CARTA::EventType_ARRAYSIZE) {
+        return;
+    }
+    auto& counts = _requests[event_type];
+    double seconds = std::chrono::duration<double>(duration).count();
+    counts.count.fetch_add(1, std::memory_order_relaxed);
+    counts.sum_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), std::memory_order_relaxed);
+    for (int i = 0; i < NumRequestBuckets; ++i) {
+        if (seconds <= RequestBuckets[i]) {
+            counts.buckets[i].fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+}
+
+void Metrics::RecordCacheLookup(CacheType cache, bool hit) {
+    auto& counts = _caches[(int)cache];
+    (hit ? counts.hits : counts.misses).fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Metrics::Exposition() {
+    std::string out;
+
+    Header(out, "carta_sessions", "gauge", "Connected sessions");
+    out += fmt::format("carta_sessions {}\n", Session::NumberOfSessions());
+    Header(out, "carta_open_frames", "gauge", "Images open in all sessions");
+    out += fmt::format("carta_open_frames {}\n", _open_frames.load(std::memory_order_relaxed));
+
+    Header(out, "carta_request_duration_seconds", "histogram", "Received messages by event type, until handled");
+    for (int type = 0; type < CARTA::EventType_ARRAYSIZE; ++type) {
+        auto& counts = _requests[type];
+        uint64_t count = counts.count.load(std::memory_order_relaxed);
+        if (!count || !CARTA::EventType_IsValid(type)) {
+            continue;
+        }
+        auto name = CARTA::EventType_Name((CARTA::EventType)type);
+        uint64_t cumulative(0);
+        for (int i = 0; i < NumRequestBuckets; ++i) {
+            cumulative += counts.buckets[i].load(std::memory_order_relaxed);
+            out += fmt::format("carta_request_duration_seconds_bucket{{event_type=\"{}\",le=\"{}\"}} {}\n", name, RequestBuckets[i],
+                cumulative);
+        }
+        out += fmt::format("carta_request_duration_seconds_bucket{{event_type=\"{}\",le=\"+Inf\"}} {}\n", name, count);
+        out += fmt::format("carta_request_duration_seconds_sum{{event_type=\"{}\"}} {}\n", name,
+            counts.sum_us.load(std::memory_order_relaxed) * 1e-6);
+        out += fmt::format("carta_request_duration_seconds_count{{event_type=\"{}\"}} {}\n", name, count);
+    }
+
+    if (LatencyHistograms::Enabled()) {
+        Header(out, "carta_latency_seconds", "summary", "Durations of instrumented calculations");
+        for (int p = 0; p < (int)LatencyPoint::Count; ++p) {
+            auto summary = LatencyHistograms::Snapshot((LatencyPoint)p);
+            if (!summary.count) {
+                continue;
+            }
+            auto name = LatencyHistograms::Name((LatencyPoint)p);
+            out += fmt::format("carta_latency_seconds{{point=\"{}\",quantile=\"0.5\"}} {}\n", name, summary.p50_ms * 1e-3);
+            out += fmt::format("carta_latency_seconds{{point=\"{}\",quantile=\"0.9\"}} {}\n", name, summary.p90_ms * 1e-3);
+            out += fmt::format("carta_latency_seconds{{point=\"{}\",quantile=\"0.99\"}} {}\n", name, summary.p99_ms * 1e-3);
+            out += fmt::format("carta_latency_seconds_sum{{point=\"{}\"}} {}\n", name, summary.mean_ms * 1e-3 * summary.count);
+            out += fmt::format("carta_latency_seconds_count{{point=\"{}\"}} {}\n", name, summary.count);
+        }
+    }
+
+    Header(out, "carta_task_queue_depth", "gauge", "Queued session tasks by priority class");
+    auto depths = TaskScheduler::QueueDepths();
+    for (int priority = 0; priority < (int)depths.size(); ++priority) {
+        out += fmt::format("carta_task_queue_depth{{priority=\"{}\"}} {}\n", PriorityName(priority), depths[priority]);
+    }
+
+    Header(out, "carta_cache_lookups_total", "counter", "Cache lookups by result");
+    for (int cache = 0; cache < (int)CacheType::NumCaches; ++cache) {
+        auto name = CacheName((CacheType)cache);
+        out += fmt::format("carta_cache_lookups_total{{cache=\"{}\",result=\"hit\"}} {}\n", name,
+            _caches[cache].hits.load(std::memory_order_relaxed));
+        out += fmt::format("carta_cache_lookups_total{{cache=\"{}\",result=\"miss\"}} {}\n", name,
+            _caches[cache].misses.load(std::memory_order_relaxed));
+    }
+    Header(out, "carta_cache_bytes", "gauge", "Memory of cached data");
+    for (auto& [name, num_bytes] : MemoryBudget::Global().CacheUsage()) {
+        out += fmt::format("carta_cache_bytes{{cache=\"{}\"}} {}\n", name, num_bytes);
+    }
+
+    Header(out, "carta_outgoing_queued_bytes", "gauge", "Messages queued for sending to all sessions");
+    out += fmt::format("carta_outgoing_queued_bytes {}\n", _queued_bytes.load(std::memory_order_relaxed));
+    Header(out, "carta_loader_read_bytes_total", "counter", "Image data read by file loaders");
+    out += fmt::format("carta_loader_read_bytes_total {}\n", _bytes_read.load(std::memory_order_relaxed));
+
+    // Series without labels are process totals; with a session label, totals of the session including its closed files; with
+    // session and file labels, totals of an open file
+    LoaderIoSeries loader_io{{"", LoaderIoStats::Process()}};
+    for (auto& [session_id, totals] : LoaderIoStats::Sessions()) {
+        loader_io.emplace_back(fmt::format("session=\"{}\"", session_id), totals);
+    }
+    for (auto& file : LoaderIoStats::Files()) {
+        loader_io.emplace_back(fmt::format("session=\"{}\",file=\"{}\"", file.session_id, LabelValue(file.filename)), file.totals);
+    }
+    LoaderIo(out, loader_io);
+
+    return out;
+}
+
+} // namespace carta
@@ -0,0 +1,66 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# Metrics.h: process-wide counters of requests, caches and I/O, reported in the Prometheus text format
+
+#ifndef CARTA_BACKEND__METRICS_H_
+#define CARTA_BACKEND__METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace carta {
+
+enum class CacheType { Tiles, Contours, SmoothedPlanes, ImagePlanes, SpectralLines, NumCaches };
+
+// Counters are relaxed atomics updated where the work is done; gauges of other modules (sessions, task queues, cache memory and
+// latency histograms) are read when the metrics are reported.
+class Metrics {
+public:
+    static Metrics& Global();
+
+    // Received message of an event type, from its arrival until its handler or task finished
+    void RecordRequest(int event_type, std::chrono::steady_clock::duration duration);
+    void RecordCacheLookup(CacheType cache, bool hit);
+    void AddOpenFrames(int delta) {
+        _open_frames.fetch_add(delta, std::memory_order_relaxed);
+    }
+    void AddQueuedBytes(int64_t delta) {
+        _queued_bytes.fetch_add(delta, std::memory_order_relaxed);
+    }
+    void AddBytesRead(uint64_t bytes) {
+        _bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // All metrics in the Prometheus text exposition format
+    std::string Exposition();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    Metrics();
+    ~Metrics();
+
+    struct RequestCounts;
+    struct CacheCounts {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+
+    std::unique_ptr<RequestCounts[]> _requests; // by event type
+    CacheCounts _caches[(int)CacheType::NumCaches];
+    std::atomic<int64_t> _open_frames;
+    std::atomic<int64_t> _queued_bytes;
+    std::atomic<uint64_t> _bytes_read;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__METRICS_H_
@@ -44,6 +44,10 @@
 #include <scimath/Mathematics/VectorKernel.h>
 
 #include <memory>
+#include <vector>
+
+#include "../Cancellation.h"
+#include "PlaneConvolver.h"
 
 namespace carta {
 
@@ -80,6 +84,10 @@ public:
     }
 
     void StopCalculation();
+    // Token checked between planes; shared with the moments calculation
+    void SetCancellationToken(const CancellationToken& token) {
+        _cancel_token = token;
+    }
 
     casacore::uInt GetTotalSteps() {
         return _total_steps;
@@ -102,7 +110,7 @@ private:
     casacore::Quantity _major, _minor, _pa;
     casacore::IPosition _axes;
     casacore::Bool _targetres = casacore::False;
-    volatile bool _stop;                           // used for cancellation
+    CancellationToken _cancel_token;               // used for cancellation
     casa::ImageMomentsProgress* _progress_monitor; // used to report the progress
     mutable casacore::uInt _total_steps = 0;       // total number of steps for the beam convolution
 
@@ -146,6 +154,28 @@ private:
         const std::vector<casacore::Quantity>& targetBeamParms, const casacore::GaussianBeam& inputBeam) const;
 
     void _logBeamInfo(const ImageInfo& imageInfo, const String& desc) const;
+
+    // A plane to convolve with its own kernel or a shared convolver; with neither it is copied
+    struct PlaneJob {
+        casacore::IPosition start;
+        std::vector<float> kernel;
+        int kernel_width = 0, kernel_height = 0;
+        std::shared_ptr<const PlaneConvolver> convolver;
+    };
+
+    // Planes are convolved by PlaneConvolver, in parallel, for float images convolved on the first two axes; otherwise by ImageConvolver
+    casacore::Bool _canConvolvePlanes(const casacore::ImageInterface<T>& imageIn) const;
+
+    // Scaled 2D kernel
+    std::vector<float> _planeKernel(const casacore::Array<Double>& kernel, Double scaleFactor, int& width, int& height) const;
+
+    // Convolve all planes with one kernel
+    void _convolvePlanes(casacore::ImageInterface<T>& imageOut, const casacore::ImageInterface<T>& imageIn,
+        const casacore::Array<Double>& kernel, Double scaleFactor) const;
+
+    // Read, convolve in parallel and write a batch of planes. Masked and NaN pixels are zero before convolution, as ImageConvolver.
+    void _convolvePlaneJobs(
+        casacore::ImageInterface<T>& imageOut, const casacore::ImageInterface<T>& imageIn, const std::vector<PlaneJob>& jobs) const;
 };
 
 } // namespace carta
@@ -10,7 +10,12 @@
 #ifndef CARTA_BACKEND__MOMENT_IMAGE2DCONVOLVER_TCC_
 #define CARTA_BACKEND__MOMENT_IMAGE2DCONVOLVER_TCC_
 
+#include <omp.h>
+#include <limits>
+#include <type_traits>
+
 #include "../Logger/Logger.h"
+#include "../Threading.h"
 #include "../Util.h"
 
 using namespace carta;
@@ -28,7 +33,6 @@ Image2DConvolver<T>::Image2DConvolver(const SPCIIT image, const casacore::Record
       _minor(),
       _pa(),
       _axes(image->coordinates().directionAxesNumbers()),
-      _stop(false),
       _progress_monitor(progress_monitor) {
     this->_construct(true);
 }
@@ -80,8 +84,6 @@ void Image2DConvolver<T>::setKernel(
 
 template <class T>
 SPIIT Image2DConvolver<T>::convolve() {
-    _stop = false; // reset the flag for cancellation
-
     ThrowIf(_axes.nelements() != 2, "You must give two pixel axes to convolve");
 
     auto inc = this->_getImage()->coordinates().increment();
@@ -244,10 +246,14 @@ void Image2DConvolver<T>::_doSingleBeam(ImageInfo& iiOut, Double& kernelVolume,
 
     // Convolve. We have already scaled the convolution kernel (with some trickery cleverer than what ImageConvolver can do) so no more
     // scaling
-    casa::ImageConvolver<T> aic;
-    Array<T> modKernel(kernel.shape());
-    casacore::convertArray(modKernel, scaleFactor * kernel);
-    aic.convolve(*this->_getLog(), *imageOut, imageIn, modKernel, casa::ImageConvolver<T>::NONE, 1.0, true);
+    if (_canConvolvePlanes(imageIn)) {
+        _convolvePlanes(*imageOut, imageIn, kernel, scaleFactor);
+    } else {
+        casa::ImageConvolver<T> aic;
+        Array<T> modKernel(kernel.shape());
+        casacore::convertArray(modKernel, scaleFactor * kernel);
+        aic.convolve(*this->_getLog(), *imageOut, imageIn, modKernel, casa::ImageConvolver<T>::NONE, 1.0, true);
+    }
 
     // Overwrite some bits and pieces in the output image to do with the restoring beam  and image units
     casacore::Bool holdsOneSkyAxis;
@@ -297,6 +303,12 @@ void Image2DConvolver<T>::_doMultipleBeams(ImageInfo& iiOut, Double& kernelVolum
     }
 
     casacore::uInt count = (nChan > 0 && nPol > 0) ? nChan * nPol : nChan > 0 ? nChan : nPol;
+
+    // Planes are queued and convolved in parallel batches
+    auto convolve_planes = _canConvolvePlanes(imageIn) && (end.product() == end(_axes[0]) * end(_axes[1]));
+    std::vector<PlaneJob> plane_jobs;
+    size_t plane_batch_size = 2 * omp_get_max_threads();
+
     if (_progress_monitor) {
         _progress_monitor->init(count * 2); // roughly estimate the total number of steps for the whole moments calculation is twice as the
                                             // number of steps for the beam convolution
@@ -304,7 +316,7 @@ void Image2DConvolver<T>::_doMultipleBeams(ImageInfo& iiOut, Double& kernelVolum
     }
 
     for (casacore::uInt i = 0; i < count; ++i) {
-        if (_stop) { // cancel calculations
+        if (_cancel_token.IsCancelled()) { // cancel calculations
             break;
         }
 
@@ -395,17 +407,30 @@ void Image2DConvolver<T>::_doMultipleBeams(ImageInfo& iiOut, Double& kernelVolum
                 beamOut.setPA(originalParms[2]);
             }
 
-            Array<T> modKernel(kernel.shape());
-            casacore::convertArray(modKernel, scaleFactor * kernel);
-            casa::ImageConvolver<T> aic;
-            aic.convolve(*this->_getLog(), subImageOut, subImage, modKernel, casa::ImageConvolver<T>::NONE, 1.0, true);
+            if (convolve_planes) {
+                PlaneJob job;
+                job.start = start;
+                job.kernel = _planeKernel(kernel, scaleFactor, job.kernel_width, job.kernel_height);
+                plane_jobs.push_back(job);
+            } else {
+                Array<T> modKernel(kernel.shape());
+                casacore::convertArray(modKernel, scaleFactor * kernel);
+                casa::ImageConvolver<T> aic;
+                aic.convolve(*this->_getLog(), subImageOut, subImage, modKernel, casa::ImageConvolver<T>::NONE, 1.0, true);
+            }
         } else {
             brightnessUnitOut = imageIn.units().getName();
             beamOut = inputBeam;
-            subImageOut.put(subImage.get());
+            if (convolve_planes) {
+                PlaneJob job;
+                job.start = start;
+                plane_jobs.push_back(job);
+            } else {
+                subImageOut.put(subImage.get());
+            }
         }
 
-        {
+        if (!convolve_planes) {
             auto doMask = imageOut->isMasked() && imageOut->hasPixelMask();
             Lattice<Bool>* pMaskOut = 0;
             if (doMask) {
@@ -432,6 +457,131 @@ void Image2DConvolver<T>::_doMultipleBeams(ImageInfo& iiOut, Double& kernelVolum
         if (!_targetres) {
             iiOut.setBeam(channel, polarization, beamOut);
         }
+
+        if (!plane_jobs.empty() && ((plane_jobs.size() >= plane_batch_size) || (i == count - 1))) {
+            _convolvePlaneJobs(*imageOut, imageIn, plane_jobs);
+            plane_jobs.clear();
+        }
+    }
+}
+
+template <class T>
+casacore::Bool Image2DConvolver<T>::_canConvolvePlanes(const casacore::ImageInterface<T>& imageIn) const {
+    return std::is_same<T, float>::value && (_axes.nelements() == 2) && (_axes[0] == 0) && (_axes[1] == 1);
+}
+
+template <class T>
+std::vector<float> Image2DConvolver<T>::_planeKernel(
+    const casacore::Array<Double>& kernel, Double scaleFactor, int& width, int& height) const {
+    // The kernel shape is 1 except on the convolution axes, which are the first two
+    width = kernel.shape()(_axes[0]);
+    height = kernel.shape()(_axes[1]);
+    std::vector<float> plane_kernel;
+    plane_kernel.reserve(width * height);
+    for (auto iter = kernel.begin(); iter != kernel.end(); ++iter) {
+        plane_kernel.push_back(*iter * scaleFactor);
+    }
+    return plane_kernel;
+}
+
+template <class T>
+void Image2DConvolver<T>::_convolvePlanes(casacore::ImageInterface<T>& imageOut, const casacore::ImageInterface<T>& imageIn,
+    const casacore::Array<Double>& kernel, Double scaleFactor) const {
+    const auto& shape = imageIn.shape();
+    int kernel_width, kernel_height;
+    auto plane_kernel = _planeKernel(kernel, scaleFactor, kernel_width, kernel_height);
+    auto convolver = std::make_shared<const PlaneConvolver>(plane_kernel, kernel_width, kernel_height, shape(0), shape(1));
+    spdlog::debug("Convolving {} planes with a {}x{} kernel {}", shape.product() / (shape(0) * shape(1)), kernel_width, kernel_height,
+        convolver->UsesFft() ? "by FFT" : "directly");
+
+    casacore::IPosition plane_shape(shape.size(), 1);
+    plane_shape(0) = shape(0);
+    plane_shape(1) = shape(1);
+    casacore::LatticeStepper stepper(shape, plane_shape);
+    size_t batch_size = 2 * omp_get_max_threads();
+    std::vector<PlaneJob> jobs;
+    for (stepper.reset(); !stepper.atEnd() && !_cancel_token.IsCancelled(); stepper++) {
+        PlaneJob job;
+        job.start = stepper.position();
+        job.convolver = convolver;
+        jobs.push_back(job);
+        if (jobs.size() >= batch_size) {
+            _convolvePlaneJobs(imageOut, imageIn, jobs);
+            jobs.clear();
+        }
+    }
+    if (!jobs.empty() && !_cancel_token.IsCancelled()) {
+        _convolvePlaneJobs(imageOut, imageIn, jobs);
+    }
+    imageOut.setMiscInfo(imageIn.miscInfo());
+}
+
+template <class T>
+void Image2DConvolver<T>::_convolvePlaneJobs(
+    casacore::ImageInterface<T>& imageOut, const casacore::ImageInterface<T>& imageIn, const std::vector<PlaneJob>& jobs) const {
+    const auto& shape = imageIn.shape();
+    int width = shape(0);
+    int height = shape(1);
+    size_t plane_size = width * height;
+    casacore::IPosition plane_shape(shape.size(), 1);
+    plane_shape(0) = width;
+    plane_shape(1) = height;
+
+    // Read the planes, with masked pixels to convolve as NaN
+    std::vector<float> input(plane_size * jobs.size());
+    std::vector<float> output(plane_size * jobs.size());
+    auto is_masked = imageIn.isMasked();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        casacore::Slicer slicer(jobs[i].start, plane_shape);
+        casacore::Array<float> plane(plane_shape, input.data() + i * plane_size, casacore::StorageInitPolicy::SHARE);
+        imageIn.getSlice(plane, slicer);
+        if (is_masked && (jobs[i].convolver || !jobs[i].kernel.empty())) {
+            casacore::Array<casacore::Bool> mask;
+            imageIn.getMaskSlice(mask, slicer);
+            size_t index = 0;
+            for (auto iter = mask.begin(); iter != mask.end(); ++iter, ++index) {
+                if (!*iter) {
+                    input[i * plane_size + index] = std::numeric_limits<float>::quiet_NaN();
+                }
+            }
+        }
+    }
+
+    // Planes with the same convolver are convolved in pairs
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].convolver && (i + 1 < jobs.size()) && (jobs[i + 1].convolver == jobs[i].convolver)) {
+            pairs.emplace_back(i, i + 1);
+            ++i;
+        } else {
+            pairs.emplace_back(i, -1);
+        }
+    }
+
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        const auto& job = jobs[pairs[i].first];
+        float* plane_in = input.data() + pairs[i].first * plane_size;
+        float* plane_out = output.data() + pairs[i].first * plane_size;
+        if (job.convolver) {
+            if (pairs[i].second >= 0) {
+                job.convolver->Convolve(
+                    plane_in, plane_out, input.data() + pairs[i].second * plane_size, output.data() + pairs[i].second * plane_size);
+            } else {
+                job.convolver->Convolve(plane_in, plane_out);
+            }
+        } else if (!job.kernel.empty()) {
+            PlaneConvolver convolver(job.kernel, job.kernel_width, job.kernel_height, width, height);
+            convolver.Convolve(plane_in, plane_out);
+        } else {
+            std::copy(plane_in, plane_in + plane_size, plane_out);
+        }
+    }
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        casacore::Array<float> plane(plane_shape, output.data() + i * plane_size, casacore::StorageInitPolicy::SHARE);
+        imageOut.putSlice(plane, jobs[i].start);
     }
 }
 
@@ -742,7 +892,7 @@ void Image2DConvolver<T>::_fillGaussian(Double& maxVal, Double& volume, casacore
 
 template <class T>
 void Image2DConvolver<T>::StopCalculation() {
-    _stop = true;
+    _cancel_token.Cancel();
 }
 
 #endif // CARTA_BACKEND__MOMENT_IMAGE2DCONVOLVER_H_
\ No newline at end of file
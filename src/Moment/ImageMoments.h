@@ -21,6 +21,12 @@
 #include <imageanalysis/ImageAnalysis/MomentsBase.h>
 #include <imageanalysis/ImageAnalysis/SepImageConvolver.h>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Cancellation.h"
 #include "Image2DConvolver.h"
 
 namespace carta {
@@ -65,6 +71,21 @@ public:
 
     // Stop the calculation
     void StopCalculation();
+    // Token of the calculation, checked between chunks; a token of a later request is not cancelled by an earlier stop
+    void SetCancellationToken(const CancellationToken& token) {
+        _cancel_token = token;
+    }
+
+    // Read input tiles with data and mask for a slicer of the image, instead of from the image; false falls back to the image
+    using TileReader = std::function<bool(casacore::Array<T>& data, casacore::Array<casacore::Bool>& mask, const casacore::Slicer& slicer)>;
+    void SetTileReader(const TileReader& reader) {
+        _tile_reader = reader;
+    }
+
+    // Memory ceiling in MB for the temporary images and tile buffers; larger temporary images are written to disk. 0 has no ceiling.
+    void SetMemoryLimit(double megabytes) {
+        _max_memory_mb = megabytes;
+    }
 
 private:
     SPCIIT _image = SPCIIT(nullptr);
@@ -76,6 +97,9 @@ private:
     // casacore::Smooth an image
     SPIIT SmoothImage();
 
+    // Memory in MB for each of num_images temporary images, with a ceiling set
+    casacore::Double TempImageMemory(casacore::uInt num_images);
+
     // Determine the noise by fitting a Gaussian to a histogram of the entire image above the 25% levels. If a plotting device is set, the
     // user can interact with this process.
     void WhatIsTheNoise(T& noise, const casacore::ImageInterface<T>& image);
@@ -84,11 +108,32 @@ private:
     void LineMultiApply(casacore::PtrBlock<casacore::MaskedLattice<T>*>& lattice_out, const casacore::MaskedLattice<T>& lattice_in,
         casacore::LineCollapser<T, T>& collapser, casacore::uInt collapse_axis);
 
-    // Get a suitable chunk shape in order for the iteration
-    casacore::IPosition ChunkShape(casacore::uInt axis, const casacore::MaskedLattice<T>& lattice_in);
+    // Same as LineMultiApply, but collapse tiles in parallel with one collapser per thread; tiles are read and written in order
+    void TileMultiApply(casacore::PtrBlock<casacore::MaskedLattice<T>*>& lattice_out, const casacore::MaskedLattice<T>& lattice_in,
+        std::vector<std::shared_ptr<casa::MomentCalcBase<T>>>& collapsers, casacore::uInt collapse_axis);
+
+    // Collapse the lines of a chunk into result arrays, calling slice_done after each line
+    void CollapseChunk(const casacore::Array<T>& chunk, const casacore::Array<casacore::Bool>& mask_chunk,
+        const casacore::IPosition& chunk_pos, casacore::LineCollapser<T, T>& collapser, casacore::uInt collapse_axis,
+        casacore::Bool use_mask, std::vector<casacore::Array<T>>& result_arrays,
+        std::vector<casacore::Array<casacore::Bool>>& result_array_masks, const std::function<void()>& slice_done);
+
+    // Put the results of a chunk in the output lattices
+    void PutChunkResults(casacore::PtrBlock<casacore::MaskedLattice<T>*>& lattice_out, const casacore::IPosition& chunk_pos,
+        casacore::uInt collapse_axis, casacore::uInt in_ndim, std::vector<casacore::Array<T>>& result_arrays,
+        std::vector<casacore::Array<casacore::Bool>>& result_array_masks);
+
+    // Get a suitable chunk shape in order for the iteration, square on the display axes for tiles from spectral-major data
+    casacore::IPosition ChunkShape(casacore::uInt axis, const casacore::MaskedLattice<T>& lattice_in, bool spectral_tiles = false);
 
     // Stop moment calculation
-    volatile bool _stop;
+    CancellationToken _cancel_token;
+
+    // Memory ceiling in MB, or 0
+    double _max_memory_mb = 0;
+
+    // Input tiles for TileMultiApply
+    TileReader _tile_reader;
 
     // Number of steps have done for the beam convolution
     casacore::uInt _steps_for_beam_convolution = 0;
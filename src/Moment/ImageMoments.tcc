@@ -10,6 +10,9 @@
 #ifndef CARTA_BACKEND__MOMENT_IMAGEMOMENTS_TCC_
 #define CARTA_BACKEND__MOMENT_IMAGEMOMENTS_TCC_
 
+#include <tbb/pipeline.h>
+#include <tbb/task_arena.h>
+
 #include "../Logger/Logger.h"
 #include "../Util.h"
 
@@ -18,7 +21,7 @@ using namespace carta;
 template <class T>
 ImageMoments<T>::ImageMoments(const casacore::ImageInterface<T>& image, casacore::LogIO& os,
     casa::ImageMomentsProgressMonitor* progress_monitor, casacore::Bool over_write_output)
-    : casa::MomentsBase<T>(os, over_write_output, true), _stop(false), _image_2d_convolver(nullptr), _progress_monitor(nullptr) {
+    : casa::MomentsBase<T>(os, over_write_output, true), _image_2d_convolver(nullptr), _progress_monitor(nullptr) {
     SetNewImage(image);
     if (progress_monitor) { // set the progress meter
         _progress_monitor = std::make_unique<casa::ImageMomentsProgress>();
@@ -74,6 +77,7 @@ casacore::Bool ImageMoments<T>::setMomentAxis(const casacore::Int moment_axis) {
 
         // reset the image 2D convolver
         _image_2d_convolver.reset(new carta::Image2DConvolver<casacore::Float>(_image, nullptr, "", "", false, _progress_monitor.get()));
+        _image_2d_convolver->SetCancellationToken(_cancel_token);
 
         // set parameters for the image 2D convolver
         auto dir_axes = _image->coordinates().directionAxesNumbers();
@@ -86,7 +90,7 @@ casacore::Bool ImageMoments<T>::setMomentAxis(const casacore::Int moment_axis) {
 
         // Replace the input image pointer with the convolved image pointer and proceed using the convolved image as if it were the input
         // image
-        if (!_stop) { // check cancellation
+        if (!_cancel_token.IsCancelled()) { // check cancellation
             _image = image_copy;
         }
     }
@@ -194,7 +198,7 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
     }
 
     // check whether the calculation is cancelled
-    if (_stop) {
+    if (_cancel_token.IsCancelled()) {
         return std::vector<std::shared_ptr<casacore::MaskedLattice<T>>>();
     }
 
@@ -206,7 +210,7 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
         this->setMomentAxis(spectralAxis); // this step will do 2D convolve for a per plane beam image
 
         // check whether the calculation is cancelled
-        if (_stop) {
+        if (_cancel_token.IsCancelled()) {
             return std::vector<std::shared_ptr<casacore::MaskedLattice<T>>>();
         }
 
@@ -306,7 +310,7 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
             output_image.reset(new casacore::PagedImage<T>(out_image_shape, out_csys, out_temp_file_name));
 
         } else {
-            output_image.reset(new casacore::TempImage<T>(casacore::TiledShape(out_image_shape), out_csys));
+            output_image.reset(new casacore::TempImage<T>(casacore::TiledShape(out_image_shape), out_csys, TempImageMemory(moments_size)));
         }
 
         ThrowIf(!output_image, "Failed to create output file");
@@ -363,8 +367,18 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
         ptr_blocks[i] = output_images[i].get();
     }
 
-    // Do expensive calculation
-    LineMultiApply(ptr_blocks, *_image, *moment_calculator, momentAxis_p);
+    // Do expensive calculation; the clip method without smoothing reads only the input lattice, so tiles can be collapsed in parallel
+    // with a calculator per thread
+    if (clip_method && !smoothed_image) {
+        std::vector<std::shared_ptr<casa::MomentCalcBase<T>>> moment_calculators = {moment_calculator};
+        int num_threads = tbb::this_task_arena::max_concurrency();
+        for (int i = 1; i < num_threads; ++i) {
+            moment_calculators.emplace_back(new casa::MomentClip<T>(smoothed_image, *this, os_p, output_images.size()));
+        }
+        TileMultiApply(ptr_blocks, *_image, moment_calculators, momentAxis_p);
+    } else {
+        LineMultiApply(ptr_blocks, *_image, *moment_calculator, momentAxis_p);
+    }
 
     if (window_method || fit_method) {
         if (moment_calculator->nFailedFits() != 0) {
@@ -372,7 +386,7 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
         }
     }
 
-    if (_stop) {
+    if (_cancel_token.IsCancelled()) {
         // Reset shared ptrs for output moments images if calculation is cancelled
         for (auto& output_image : output_images) {
             output_image.reset();
@@ -388,6 +402,16 @@ std::vector<std::shared_ptr<casacore::MaskedLattice<T>>> ImageMoments<T>::create
     return output_images;
 }
 
+template <class T>
+casacore::Double ImageMoments<T>::TempImageMemory(casacore::uInt num_images) {
+    // A TempImage larger than this is a PagedArray in a temporary file, to which tiles are written as they are finished; the file is
+    // removed with the image. Negative uses the casacore default.
+    if (_max_memory_mb <= 0) {
+        return -1.0;
+    }
+    return _max_memory_mb / std::max(num_images, (casacore::uInt)1);
+}
+
 // casacore::Smooth image. casacore::Input masked pixels are zeros before smoothing. The output smoothed image is masked as well to reflect
 // the input mask.
 template <class T>
@@ -397,7 +421,7 @@ SPIIT ImageMoments<T>::SmoothImage() {
 
     SPIIT smoothed_image;
     if (smoothOut_p.empty()) {
-        smoothed_image.reset(new casacore::TempImage<T>(_image->shape(), _image->coordinates()));
+        smoothed_image.reset(new casacore::TempImage<T>(casacore::TiledShape(_image->shape()), _image->coordinates(), TempImageMemory(1)));
     } else {
         // This image has already been checked in setSmoothOutName to not exist
         smoothed_image.reset(new casacore::PagedImage<T>(_image->shape(), _image->coordinates(), smoothOut_p));
@@ -533,7 +557,7 @@ void ImageMoments<T>::WhatIsTheNoise(T& sigma, const casacore::ImageInterface<T>
 
 template <class T>
 void ImageMoments<T>::StopCalculation() {
-    _stop = true;
+    _cancel_token.Cancel();
     if (_image_2d_convolver) {
         _image_2d_convolver->StopCalculation();
     }
@@ -547,157 +571,271 @@ void ImageMoments<T>::LineMultiApply(casacore::PtrBlock<casacore::MaskedLattice<
     AlwaysAssert(n_out > 0, AipsError);
 
     const casacore::IPosition out_shape(lattice_out[0]->shape());
-    const casacore::uInt out_dim = out_shape.nelements();
     for (casacore::uInt i = 1; i < n_out; ++i) {
         AlwaysAssert(lattice_out[i]->shape() == out_shape, AipsError);
     }
 
     const casacore::IPosition& in_shape = lattice_in.shape();
-    casacore::IPosition out_pos(out_dim, 0);
 
     // Does the input has a mask? If not, can the collapser handle a null mask.
     casacore::Bool use_mask = lattice_in.isMasked() ? casacore::True : (!collapser.canHandleNullMask());
-    const casacore::uInt in_ndim = in_shape.size();
-    const casacore::IPosition display_axes = IPosition::makeAxisPath(in_ndim).otherAxes(in_ndim, IPosition(1, collapse_axis));
-    const casacore::uInt n_display_axes = display_axes.size();
-
-    casacore::Vector<T> result(n_out);                   // Resulting values for a slice
-    casacore::Vector<casacore::Bool> result_mask(n_out); // Resulting masks for a slice
 
     // Read in larger chunks than before, because that was very inefficient and brought NRAO cluster to a snail's pace, and then do the
     // accounting for the input lines in memory
-    casacore::IPosition chunk_slice_start(in_ndim, 0);
-    casacore::IPosition chunk_slice_end = chunk_slice_start;
-    chunk_slice_end[collapse_axis] = in_shape[collapse_axis] - 1;                    // Position at the end of a collapse axis line
-    const casacore::IPosition chunk_slice_end_at_chunk_iter_begin = chunk_slice_end; // As an increment of a chunk for the lattice iterator
 
     // Get a chunk shape and used it to set the data iterator
-
     casacore::IPosition chunk_shape_init = ChunkShape(collapse_axis, lattice_in);
-
-    casacore::IPosition hdf5_chunk_shape(in_ndim, 1);
-    hdf5_chunk_shape[0] = 512;
-    hdf5_chunk_shape[1] = 512;
-
-    auto nice_shape = lattice_in.niceCursorShape();
-    if (nice_shape == hdf5_chunk_shape) {
-        chunk_shape_init[0] = nice_shape[0];
-        chunk_shape_init[1] = nice_shape[1];
-    }
-
     casacore::LatticeStepper my_stepper(in_shape, chunk_shape_init, LatticeStepper::RESIZE);
     casacore::RO_MaskedLatticeIterator<T> lat_iter(lattice_in, my_stepper);
 
-    casacore::IPosition cur_pos;                           // Current position for the chunk iterator
-    static const casacore::Vector<casacore::Bool> no_mask; // False mask vector
-
     if (_progress_monitor && (_steps_for_beam_convolution == 0)) { // no beam convolution done before, so initialize the progress meter
         casacore::uInt total_slices = in_shape.product() / in_shape[collapse_axis];
         _progress_monitor->init(total_slices);
     }
 
     casacore::uInt n_done = 0; // Number of slices have done
+    auto slice_done = [&]() {
+        // Report the number of slices have done
+        if (_progress_monitor) {
+            ++n_done;
+            _progress_monitor->nstepsDone(n_done + _steps_for_beam_convolution);
+        }
+    };
 
     // Iterate through a cube image, chunk by chunk
     for (lat_iter.reset(); !lat_iter.atEnd(); ++lat_iter) {
         const casacore::IPosition iter_pos = lat_iter.position();
         const casacore::Array<T>& chunk = lat_iter.cursor();
-        casacore::IPosition chunk_shape = chunk.shape();
         const casacore::Array<casacore::Bool> mask_chunk = use_mask ? lat_iter.getMask() : Array<Bool>();
 
-        chunk_slice_start = 0;
-        chunk_slice_end = chunk_slice_end_at_chunk_iter_begin;
-        casacore::IPosition result_array_shape = chunk_shape;
-        result_array_shape[collapse_axis] = 1;
         std::vector<casacore::Array<T>> result_arrays(n_out);                   // Resulting value arrays for a chunk
         std::vector<casacore::Array<casacore::Bool>> result_array_masks(n_out); // Resulting mask arrays for a chunk
+        CollapseChunk(chunk, mask_chunk, iter_pos, collapser, collapse_axis, use_mask, result_arrays, result_array_masks, slice_done);
 
-        // Need to initialize this way rather than doing it in the constructor, because using a single Array in the constructor means that
-        // all Arrays in the vector reference the same Array.
-        for (casacore::uInt k = 0; k < n_out; k++) {
-            result_arrays[k] = Array<T>(result_array_shape);
-            result_array_masks[k] = Array<Bool>(result_array_shape);
+        if (_cancel_token.IsCancelled()) { // Break the iteration in a cube image
+            break;
         }
 
-        // Iterate through a chunk, slice by slice on the output image display axes
-        casacore::Bool done = casacore::False;
-        while (!done) {
-            if (_stop) { // Break the iteration in a chunk
-                break;
-            }
+        // Put partial results in the output lattices (as a chunk size)
+        PutChunkResults(lattice_out, iter_pos, collapse_axis, in_shape.size(), result_arrays, result_array_masks);
+    }
 
-            casacore::Vector<T> data(chunk(chunk_slice_start, chunk_slice_end));
-            casacore::Vector<Bool> mask =
-                use_mask ? casacore::Vector<casacore::Bool>(mask_chunk(chunk_slice_start, chunk_slice_end)) : no_mask;
-            cur_pos = iter_pos + chunk_slice_start;
+    if (_progress_monitor) {
+        _progress_monitor->done();
+    }
+}
 
-            // Do calculations
-            collapser.multiProcess(result, result_mask, data, mask, cur_pos);
+template <class T>
+void ImageMoments<T>::TileMultiApply(casacore::PtrBlock<casacore::MaskedLattice<T>*>& lattice_out,
+    const casacore::MaskedLattice<T>& lattice_in, std::vector<std::shared_ptr<casa::MomentCalcBase<T>>>& collapsers,
+    casacore::uInt collapse_axis) {
+    // Same results as LineMultiApply. Tiles of the display axes with the whole collapse axis are read in order, collapsed in parallel
+    // with a collapser per thread, then written and counted for progress in order.
+    const casacore::uInt n_out = lattice_out.nelements(); // Number of output lattices
+    AlwaysAssert(n_out > 0, AipsError);
+    AlwaysAssert(!collapsers.empty(), AipsError);
 
-            // Fill partial results in a chunk
-            for (uInt k = 0; k < n_out; ++k) {
-                result_arrays[k](chunk_slice_start) = result[k];
-                result_array_masks[k](chunk_slice_start) = result_mask[k];
-            }
+    const casacore::IPosition out_shape(lattice_out[0]->shape());
+    for (casacore::uInt i = 1; i < n_out; ++i) {
+        AlwaysAssert(lattice_out[i]->shape() == out_shape, AipsError);
+    }
 
-            done = True; // The scan of this chunk is complete
+    const casacore::IPosition& in_shape = lattice_in.shape();
+    casacore::Bool use_mask = (lattice_in.isMasked() || _tile_reader) ? casacore::True : (!collapsers[0]->canHandleNullMask());
+    casacore::IPosition chunk_shape = ChunkShape(collapse_axis, lattice_in, (bool)_tile_reader);
+    casacore::LatticeStepper stepper(in_shape, chunk_shape, LatticeStepper::RESIZE);
+    stepper.reset();
 
-            // Report the number of slices have done
-            if (_progress_monitor) {
-                ++n_done;
-                _progress_monitor->nstepsDone(n_done + _steps_for_beam_convolution);
-            }
+    // Tiles in flight, limited so that their buffers fit in the memory ceiling
+    size_t num_tokens = collapsers.size();
+    if (_max_memory_mb > 0) {
+        size_t tile_bytes = chunk_shape.product() * (sizeof(T) + sizeof(casacore::Bool));
+        size_t max_tokens = (_max_memory_mb * 1024 * 1024) / tile_bytes;
+        num_tokens = std::max((size_t)1, std::min(num_tokens, max_tokens));
+    }
 
-            // Proceed to the next slice on the display axes
-            for (casacore::uInt k = 0; k < n_display_axes; ++k) {
-                casacore::uInt dax = display_axes[k];
-                if (chunk_slice_start[dax] < chunk_shape[dax] - 1) {
-                    ++chunk_slice_start[dax];
-                    ++chunk_slice_end[dax];
-                    done = False;
-                    break;
-                } else {
-                    chunk_slice_start[dax] = 0;
-                    chunk_slice_end[dax] = 0;
-                }
+    if (_progress_monitor && (_steps_for_beam_convolution == 0)) { // no beam convolution done before, so initialize the progress meter
+        casacore::uInt total_slices = in_shape.product() / in_shape[collapse_axis];
+        _progress_monitor->init(total_slices);
+    }
+
+    struct MomentTile {
+        casacore::IPosition position;
+        casacore::Array<T> data;
+        casacore::Array<casacore::Bool> mask;
+        std::vector<casacore::Array<T>> result_arrays;
+        std::vector<casacore::Array<casacore::Bool>> result_array_masks;
+        casacore::uInt num_slices = 0;
+    };
+    using MomentTilePtr = std::shared_ptr<MomentTile>;
+
+    std::mutex collapser_mutex;
+    std::vector<casa::MomentCalcBase<T>*> free_collapsers;
+    for (auto& collapser : collapsers) {
+        free_collapsers.push_back(collapser.get());
+    }
+
+    auto read_tile = [&](tbb::flow_control& fc) -> MomentTilePtr {
+        if (_cancel_token.IsCancelled() || stepper.atEnd()) {
+            fc.stop();
+            return nullptr;
+        }
+        auto tile = std::make_shared<MomentTile>();
+        tile->position = stepper.position();
+        casacore::Slicer slicer(stepper.position(), stepper.endPosition(), casacore::Slicer::endIsLast);
+        if (!_tile_reader || !_tile_reader(tile->data, tile->mask, slicer)) {
+            lattice_in.getSlice(tile->data, slicer);
+            if (use_mask) {
+                lattice_in.getMaskSlice(tile->mask, slicer);
             }
         }
+        stepper++;
+        return tile;
+    };
+    auto collapse_tile = [&](MomentTilePtr tile) {
+        std::unique_lock<std::mutex> lock(collapser_mutex);
+        casa::MomentCalcBase<T>* collapser = free_collapsers.back();
+        free_collapsers.pop_back();
+        lock.unlock();
+
+        tile->result_arrays.resize(n_out);
+        tile->result_array_masks.resize(n_out);
+        CollapseChunk(tile->data, tile->mask, tile->position, *collapser, collapse_axis, use_mask, tile->result_arrays,
+            tile->result_array_masks, [&]() { ++tile->num_slices; });
+        tile->data.resize();
+        tile->mask.resize();
+
+        lock.lock();
+        free_collapsers.push_back(collapser);
+        return tile;
+    };
+    casacore::uInt n_done = 0; // Number of slices have done
+    auto write_tile = [&](MomentTilePtr tile) {
+        if (_cancel_token.IsCancelled()) {
+            return;
+        }
+        PutChunkResults(lattice_out, tile->position, collapse_axis, in_shape.size(), tile->result_arrays, tile->result_array_masks);
+        if (_progress_monitor) {
+            n_done += tile->num_slices;
+            _progress_monitor->nstepsDone(n_done + _steps_for_beam_convolution);
+        }
+    };
+    tbb::parallel_pipeline(num_tokens,
+        tbb::make_filter<void, MomentTilePtr>(tbb::filter::serial_in_order, read_tile) &
+            tbb::make_filter<MomentTilePtr, MomentTilePtr>(tbb::filter::parallel, collapse_tile) &
+            tbb::make_filter<MomentTilePtr, void>(tbb::filter::serial_in_order, write_tile));
+
+    if (_progress_monitor) {
+        _progress_monitor->done();
+    }
+}
 
-        if (_stop) { // Break the iteration in a cube image
+template <class T>
+void ImageMoments<T>::CollapseChunk(const casacore::Array<T>& chunk, const casacore::Array<casacore::Bool>& mask_chunk,
+    const casacore::IPosition& chunk_pos, casacore::LineCollapser<T, T>& collapser, casacore::uInt collapse_axis, casacore::Bool use_mask,
+    std::vector<casacore::Array<T>>& result_arrays, std::vector<casacore::Array<casacore::Bool>>& result_array_masks,
+    const std::function<void()>& slice_done) {
+    const casacore::uInt n_out = result_arrays.size();
+    const casacore::IPosition chunk_shape = chunk.shape();
+    const casacore::uInt in_ndim = chunk_shape.size();
+    const casacore::IPosition display_axes = IPosition::makeAxisPath(in_ndim).otherAxes(in_ndim, IPosition(1, collapse_axis));
+    const casacore::uInt n_display_axes = display_axes.size();
+
+    casacore::Vector<T> result(n_out);                   // Resulting values for a slice
+    casacore::Vector<casacore::Bool> result_mask(n_out); // Resulting masks for a slice
+    static const casacore::Vector<casacore::Bool> no_mask; // False mask vector
+
+    casacore::IPosition chunk_slice_start(in_ndim, 0);
+    casacore::IPosition chunk_slice_end = chunk_slice_start;
+    chunk_slice_end[collapse_axis] = chunk_shape[collapse_axis] - 1; // Position at the end of a collapse axis line
+
+    casacore::IPosition result_array_shape = chunk_shape;
+    result_array_shape[collapse_axis] = 1;
+
+    // Need to initialize this way rather than doing it in the constructor, because using a single Array in the constructor means that
+    // all Arrays in the vector reference the same Array.
+    for (casacore::uInt k = 0; k < n_out; k++) {
+        result_arrays[k] = Array<T>(result_array_shape);
+        result_array_masks[k] = Array<Bool>(result_array_shape);
+    }
+
+    // Iterate through a chunk, slice by slice on the output image display axes
+    casacore::Bool done = casacore::False;
+    while (!done) {
+        if (_cancel_token.IsCancelled()) { // Break the iteration in a chunk
             break;
         }
 
-        // Put partial results in the output lattices (as a chunk size)
-        for (casacore::uInt k = 0; k < n_out; ++k) {
-            casacore::IPosition result_pos = in_ndim == out_dim ? iter_pos : iter_pos.removeAxes(casacore::IPosition(1, collapse_axis));
-            casacore::Bool keep_axis = result_arrays[k].ndim() == lattice_out[k]->ndim();
-            if (!keep_axis) {
-                result_arrays[k].removeDegenerate(display_axes);
-            }
-            lattice_out[k]->putSlice(result_arrays[k], result_pos);
-
-            if (lattice_out[k]->hasPixelMask()) {
-                casacore::Lattice<casacore::Bool>& mask_out = lattice_out[k]->pixelMask();
-                if (mask_out.isWritable()) {
-                    if (!keep_axis) {
-                        result_array_masks[k].removeDegenerate(display_axes);
-                    }
-                    mask_out.putSlice(result_array_masks[k], result_pos);
-                }
+        casacore::Vector<T> data(chunk(chunk_slice_start, chunk_slice_end));
+        casacore::Vector<Bool> mask = use_mask ? casacore::Vector<casacore::Bool>(mask_chunk(chunk_slice_start, chunk_slice_end)) : no_mask;
+        casacore::IPosition cur_pos = chunk_pos + chunk_slice_start; // Current position for the chunk iterator
+
+        // Do calculations
+        collapser.multiProcess(result, result_mask, data, mask, cur_pos);
+
+        // Fill partial results in a chunk
+        for (uInt k = 0; k < n_out; ++k) {
+            result_arrays[k](chunk_slice_start) = result[k];
+            result_array_masks[k](chunk_slice_start) = result_mask[k];
+        }
+
+        done = True; // The scan of this chunk is complete
+        slice_done();
+
+        // Proceed to the next slice on the display axes
+        for (casacore::uInt k = 0; k < n_display_axes; ++k) {
+            casacore::uInt dax = display_axes[k];
+            if (chunk_slice_start[dax] < chunk_shape[dax] - 1) {
+                ++chunk_slice_start[dax];
+                ++chunk_slice_end[dax];
+                done = False;
+                break;
+            } else {
+                chunk_slice_start[dax] = 0;
+                chunk_slice_end[dax] = 0;
             }
         }
     }
+}
 
-    if (_progress_monitor) {
-        _progress_monitor->done();
+template <class T>
+void ImageMoments<T>::PutChunkResults(casacore::PtrBlock<casacore::MaskedLattice<T>*>& lattice_out, const casacore::IPosition& chunk_pos,
+    casacore::uInt collapse_axis, casacore::uInt in_ndim, std::vector<casacore::Array<T>>& result_arrays,
+    std::vector<casacore::Array<casacore::Bool>>& result_array_masks) {
+    const casacore::uInt out_dim = lattice_out[0]->shape().nelements();
+    const casacore::IPosition display_axes = IPosition::makeAxisPath(in_ndim).otherAxes(in_ndim, IPosition(1, collapse_axis));
+    for (casacore::uInt k = 0; k < result_arrays.size(); ++k) {
+        casacore::IPosition result_pos = in_ndim == out_dim ? chunk_pos : chunk_pos.removeAxes(casacore::IPosition(1, collapse_axis));
+        casacore::Bool keep_axis = result_arrays[k].ndim() == lattice_out[k]->ndim();
+        if (!keep_axis) {
+            result_arrays[k].removeDegenerate(display_axes);
+        }
+        lattice_out[k]->putSlice(result_arrays[k], result_pos);
+
+        if (lattice_out[k]->hasPixelMask()) {
+            casacore::Lattice<casacore::Bool>& mask_out = lattice_out[k]->pixelMask();
+            if (mask_out.isWritable()) {
+                if (!keep_axis) {
+                    result_array_masks[k].removeDegenerate(display_axes);
+                }
+                mask_out.putSlice(result_array_masks[k], result_pos);
+            }
+        }
     }
 }
 
 template <class T>
-casacore::IPosition ImageMoments<T>::ChunkShape(casacore::uInt axis, const casacore::MaskedLattice<T>& lattice_in) {
+casacore::IPosition ImageMoments<T>::ChunkShape(casacore::uInt axis, const casacore::MaskedLattice<T>& lattice_in, bool spectral_tiles) {
     casacore::uInt ndim = lattice_in.ndim();
     casacore::IPosition chunk_shape(ndim, 1);
     casacore::IPosition lat_in_shape = lattice_in.shape();
+
+    // Use the xy chunks of HDF5 images, unless tiles are read from spectral-major data
+    casacore::IPosition hdf5_chunk_shape(ndim, 1);
+    hdf5_chunk_shape[0] = 512;
+    hdf5_chunk_shape[1] = 512;
+    bool use_hdf5_chunks = !spectral_tiles && (lattice_in.niceCursorShape() == hdf5_chunk_shape);
+
     casacore::uInt axis_length = lat_in_shape[axis];
     chunk_shape[axis] = axis_length;
 
@@ -712,10 +850,20 @@ casacore::IPosition ImageMoments<T>::ChunkShape(casacore::uInt axis, const casac
     const casacore::uInt chunk_size = limit / sub_chunk_size; // Chunk size, i.e., number of pixels on display axes
     if (chunk_size <= 1) {
         // can only go row by row
+        if (use_hdf5_chunks) {
+            chunk_shape[0] = hdf5_chunk_shape[0];
+            chunk_shape[1] = hdf5_chunk_shape[1];
+        }
         return chunk_shape;
     }
 
     ssize_t x = chunk_size;
+    if (spectral_tiles && (axis > 1)) {
+        // Square xy tiles read fewer spectral-major chunks than rows
+        chunk_shape[0] = std::min((ssize_t)std::max(std::sqrt((double)chunk_size), 1.0), lat_in_shape[0]);
+        chunk_shape[1] = std::min((ssize_t)(chunk_size / chunk_shape[0]), lat_in_shape[1]);
+        return chunk_shape;
+    }
     for (casacore::uInt i = 0; i < ndim; ++i) {
         if (i != axis) {
             chunk_shape[i] = std::min(x, lat_in_shape[i]);
@@ -726,6 +874,10 @@ casacore::IPosition ImageMoments<T>::ChunkShape(casacore::uInt axis, const casac
             }
         }
     }
+    if (use_hdf5_chunks) {
+        chunk_shape[0] = hdf5_chunk_shape[0];
+        chunk_shape[1] = hdf5_chunk_shape[1];
+    }
     return chunk_shape;
 }
 
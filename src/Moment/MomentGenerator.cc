@@ -6,6 +6,8 @@
 
 #include "MomentGenerator.h"
 
+#include <cmath>
+
 #include "../Logger/Logger.h"
 
 using namespace carta;
@@ -17,19 +19,21 @@ static const float PROGRESS_REPORT_INTERVAL = 0.1;
 static const float PROCESS_COMPLETED = 1;
 static const int ID_MULTIPLIER = 1000;
 
+int MomentGenerator::_memory_limit_mb = MOMENT_MEMORY_MB;
+
 MomentGenerator::MomentGenerator(const casacore::String& filename, casacore::ImageInterface<float>* image)
-    : _filename(filename), _image(image), _sub_image(nullptr), _image_moments(nullptr), _success(false), _cancel(false) {
+    : _filename(filename), _image(image), _sub_image(nullptr), _image_moments(nullptr), _success(false) {
     SetMomentTypeMaps();
 }
 
 bool MomentGenerator::CalculateMoments(int file_id, const casacore::ImageRegion& image_region, int spectral_axis, int stokes_axis,
     const MomentProgressCallback& progress_callback, const CARTA::MomentRequest& moment_request, CARTA::MomentResponse& moment_response,
-    std::vector<CollapseResult>& collapse_results) {
+    std::vector<CollapseResult>& collapse_results, const CancellationToken& cancel_token) {
     _spectral_axis = spectral_axis;
     _stokes_axis = stokes_axis;
     _progress_callback = progress_callback;
     _success = false;
-    _cancel = false;
+    _cancel_token = cancel_token;
 
     // Set moment axis
     SetMomentAxis(moment_request);
@@ -104,13 +108,6 @@ bool MomentGenerator::CalculateMoments(int file_id, const casacore::ImageRegion&
     return !collapse_results.empty();
 }
 
-void MomentGenerator::StopCalculation() {
-    if (_image_moments) {
-        _image_moments->StopCalculation();
-        _cancel = true;
-    }
-}
-
 void MomentGenerator::SetMomentAxis(const CARTA::MomentRequest& moment_request) {
     if (moment_request.axis() == CARTA::MomentAxis::SPECTRAL) {
         _axis = _spectral_axis;
@@ -189,6 +186,62 @@ void MomentGenerator::ResetImageMoments(const casacore::ImageRegion& image_regio
 
     // Make an ImageMoments object and overwrite the output file if it already exists
     _image_moments.reset(new IM(casacore::SubImage<casacore::Float>(*_sub_image), os, this, true));
+    _image_moments->SetMemoryLimit(_memory_limit_mb);
+    _image_moments->SetCancellationToken(_cancel_token);
+
+    // Spectral-major data has the image spectral axis 2 and stokes axis 3
+    _lattice_region.reset();
+    if (_spectral_tile_reader && (_axis == _spectral_axis) && (_spectral_axis == 2) && (_stokes_axis < 0 || _stokes_axis == 3)) {
+        _lattice_region = std::make_unique<casacore::LatticeRegion>(image_region.toLatticeRegion(_image->coordinates(), _image->shape()));
+        _image_moments->SetTileReader([this](casacore::Array<float>& data, casacore::Array<casacore::Bool>& mask,
+                                          const casacore::Slicer& slicer) { return ReadSpectralTile(data, mask, slicer); });
+    }
+}
+
+bool MomentGenerator::ReadSpectralTile(
+    casacore::Array<float>& data, casacore::Array<casacore::Bool>& mask, const casacore::Slicer& slicer) {
+    // Slicer of the sub-image, which is the region bounding box in the image. Masked like a HDF5 image: NaN or outside the region.
+    const casacore::IPosition start = slicer.start() + _lattice_region->slicer().start();
+    const casacore::IPosition& length = slicer.length();
+    if (length.size() < 3) {
+        return false;
+    }
+    int stokes = (length.size() > 3) ? start(3) : 0;
+    std::vector<float> spectra;
+    if (!_spectral_tile_reader(spectra, stokes, start(0), length(0), start(1), length(1))) {
+        return false;
+    }
+
+    size_t width = length(0);
+    size_t height = length(1);
+    size_t depth = length(2);
+    size_t image_depth = spectra.size() / (width * height);
+    if (start(2) + depth > image_depth) {
+        return false;
+    }
+
+    data.resize(length);
+    mask.resize(length);
+    casacore::Array<casacore::Bool> region_mask;
+    bool has_region_mask = _lattice_region->hasMask();
+    if (has_region_mask) {
+        _lattice_region->getSlice(region_mask, slicer);
+    }
+
+    float* data_ptr = data.data();
+    casacore::Bool* mask_ptr = mask.data();
+    const casacore::Bool* region_mask_ptr = has_region_mask ? region_mask.data() : nullptr;
+    for (size_t x = 0; x < width; ++x) {
+        for (size_t y = 0; y < height; ++y) {
+            const float* spectrum = spectra.data() + (x * height + y) * image_depth + start(2);
+            for (size_t z = 0; z < depth; ++z) {
+                size_t index = x + width * (y + height * z);
+                data_ptr[index] = spectrum[z];
+                mask_ptr[index] = std::isfinite(spectrum[z]) && (!has_region_mask || region_mask_ptr[index]);
+            }
+        }
+    }
+    return true;
 }
 
 int MomentGenerator::GetMomentMode(CARTA::Moment moment) {
@@ -226,7 +279,7 @@ bool MomentGenerator::IsSuccess() const {
 }
 
 bool MomentGenerator::IsCancelled() const {
-    return _cancel;
+    return _cancel_token.IsCancelled();
 }
 
 casacore::String MomentGenerator::GetErrorMessage() const {
@@ -11,7 +11,10 @@
 #include <carta-protobuf/stop_moment_calc.pb.h>
 #include <imageanalysis/ImageAnalysis/ImageMomentsProgressMonitor.h>
 
+#include <casacore/lattices/LRegions/LatticeRegion.h>
+
 #include <chrono>
+#include <functional>
 #include <thread>
 
 #include "../Constants.h"
@@ -34,16 +37,21 @@ struct CollapseResult {
 
 class MomentGenerator : public casa::ImageMomentsProgressMonitor {
 public:
+    // Spectra of a block of image pixels with z fastest then y then x, as FileLoader::GetSpectralTile
+    using SpectralTileReader = std::function<bool(std::vector<float>& data, int stokes, int x, int count_x, int y, int count_y)>;
+
     MomentGenerator(const casacore::String& filename, casacore::ImageInterface<float>* image);
     ~MomentGenerator(){};
 
     // Calculate moments
     bool CalculateMoments(int file_id, const casacore::ImageRegion& image_region, int spectral_axis, int stokes_axis,
         const MomentProgressCallback& progress_callback, const CARTA::MomentRequest& moment_request, CARTA::MomentResponse& moment_response,
-        std::vector<CollapseResult>& collapse_results);
+        std::vector<CollapseResult>& collapse_results, const CancellationToken& cancel_token = CancellationToken());
 
-    // Stop moments calculation
-    void StopCalculation();
+    // Read tiles for moments along the spectral axis from spectral-major data; empty to read the image
+    void SetSpectralTileReader(const SpectralTileReader& reader) {
+        _spectral_tile_reader = reader;
+    }
 
     // Resulting message
     bool IsSuccess() const;
@@ -55,11 +63,19 @@ public:
     void setStepsCompleted(int count);
     void done();
 
+    // Memory ceiling of a calculation in MB; 0 keeps the images in memory
+    static void SetMemoryLimit(int megabytes) {
+        _memory_limit_mb = megabytes;
+    }
+
 private:
+    static int _memory_limit_mb;
+
     void SetMomentAxis(const CARTA::MomentRequest& moment_request);
     void SetMomentTypes(const CARTA::MomentRequest& moment_request);
     void SetPixelRange(const CARTA::MomentRequest& moment_request);
     void ResetImageMoments(const casacore::ImageRegion& image_region);
+    bool ReadSpectralTile(casacore::Array<float>& data, casacore::Array<casacore::Bool>& mask, const casacore::Slicer& slicer);
     int GetMomentMode(CARTA::Moment moment);
     casacore::String GetMomentSuffix(casacore::Int moment);
     casacore::String GetOutputFileName();
@@ -74,13 +90,15 @@ private:
     // Moments settings
     std::unique_ptr<casacore::ImageInterface<casacore::Float>> _sub_image;
     std::unique_ptr<ImageMoments<casacore::Float>> _image_moments;
+    SpectralTileReader _spectral_tile_reader;
+    std::unique_ptr<casacore::LatticeRegion> _lattice_region; // region of the sub-image in the image
     casacore::Vector<casacore::Int> _moments; // Moment types
     int _axis;                                // Moment axis
     casacore::Vector<float> _include_pix;
     casacore::Vector<float> _exclude_pix;
     casacore::String _error_msg;
     bool _success;
-    bool _cancel;
+    CancellationToken _cancel_token;
     std::unordered_map<CARTA::Moment, ImageMoments<casacore::Float>::MomentTypes> _moment_map;
     std::unordered_map<ImageMoments<casacore::Float>::MomentTypes, casacore::String> _moment_suffix_map;
 
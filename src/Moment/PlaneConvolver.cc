@@ -0,0 +1,234 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PlaneConvolver.cc: convolution of image planes with a real kernel, by FFT or directly for small kernels
+
+#include "PlaneConvolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+// The FFT is used when the kernel has more pixels than this times the FFT operations per output pixel
+#define PLANE_CONVOLVER_FFT_COST 4.0
+// Columns transformed together
+#define PLANE_CONVOLVER_COLUMN_BLOCK 16
+
+using namespace carta;
+
+static size_t NextPowerOfTwo(size_t length) {
+    size_t power(1);
+    while (power < length) {
+        power <<= 1;
+    }
+    return power;
+}
+
+FftPlan::FftPlan(size_t length) : _length(length), _twiddles(length / 2), _bit_reverse(length) {
+    for (size_t i = 0; i < length / 2; ++i) {
+        double angle = -2.0 * M_PI * i / length;
+        _twiddles[i] = std::complex<float>(std::cos(angle), std::sin(angle));
+    }
+
+    size_t num_bits(0);
+    while (((size_t)1 << num_bits) < length) {
+        ++num_bits;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        size_t reversed(0);
+        for (size_t bit = 0; bit < num_bits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (num_bits - 1 - bit);
+        }
+        _bit_reverse[i] = reversed;
+    }
+}
+
+std::shared_ptr<const FftPlan> FftPlan::Get(size_t length) {
+    // Plans are kept for the life of the process; there are only a few padded plane sizes
+    static std::mutex plan_mutex;
+    static std::map<size_t, std::shared_ptr<const FftPlan>> plans;
+    std::lock_guard<std::mutex> guard(plan_mutex);
+    auto& plan = plans[length];
+    if (!plan) {
+        plan = std::make_shared<const FftPlan>(length);
+    }
+    return plan;
+}
+
+void FftPlan::Transform(std::complex<float>* data, bool inverse) const {
+    for (size_t i = 0; i < _length; ++i) {
+        if (i < _bit_reverse[i]) {
+            std::swap(data[i], data[_bit_reverse[i]]);
+        }
+    }
+
+    for (size_t half = 1; half < _length; half <<= 1) {
+        size_t step = _length / (2 * half);
+        for (size_t start = 0; start < _length; start += 2 * half) {
+            for (size_t j = 0; j < half; ++j) {
+                // Multiply without the NaN checks of std::complex
+                const std::complex<float>& twiddle = _twiddles[j * step];
+                float twiddle_imag = inverse ? -twiddle.imag() : twiddle.imag();
+                std::complex<float>& even = data[start + j];
+                std::complex<float>& odd = data[start + j + half];
+                float odd_real = odd.real() * twiddle.real() - odd.imag() * twiddle_imag;
+                float odd_imag = odd.real() * twiddle_imag + odd.imag() * twiddle.real();
+                odd = std::complex<float>(even.real() - odd_real, even.imag() - odd_imag);
+                even = std::complex<float>(even.real() + odd_real, even.imag() + odd_imag);
+            }
+        }
+    }
+}
+
+PlaneConvolver::PlaneConvolver(const std::vector<float>& kernel, int kernel_width, int kernel_height, int width, int height)
+    : _kernel(kernel), _kernel_width(kernel_width), _kernel_height(kernel_height), _width(width), _height(height) {
+    // Pad so that the wrapped part of the circular convolution is outside the output
+    int centre_x = kernel_width / 2;
+    int centre_y = kernel_height / 2;
+    _fft_width = NextPowerOfTwo(width + std::max(centre_x, kernel_width - 1 - centre_x));
+    _fft_height = NextPowerOfTwo(height + std::max(centre_y, kernel_height - 1 - centre_y));
+
+    // Two planes are convolved by each pair of 2D transforms
+    double fft_size = (double)_fft_width * _fft_height;
+    double fft_operations = fft_size * std::log2(std::max(fft_size, 2.0)) / (width * (double)height);
+    _use_fft = ((double)kernel_width * kernel_height) > PLANE_CONVOLVER_FFT_COST * fft_operations;
+    if (!_use_fft) {
+        return;
+    }
+
+    _plan_x = FftPlan::Get(_fft_width);
+    _plan_y = FftPlan::Get(_fft_height);
+
+    // The inverse is not normalised, so scale the kernel spectrum instead
+    _kernel_spectrum.assign(_fft_width * _fft_height, 0.0);
+    float scale = 1.0 / fft_size;
+    for (int y = 0; y < kernel_height; ++y) {
+        for (int x = 0; x < kernel_width; ++x) {
+            _kernel_spectrum[y * _fft_width + x] = kernel[y * kernel_width + x] * scale;
+        }
+    }
+    Transform2D(_kernel_spectrum.data(), false);
+}
+
+void PlaneConvolver::Convolve(const float* input, float* output) const {
+    if (_use_fft) {
+        ConvolveFft(input, output, nullptr, nullptr);
+    } else {
+        ConvolveDirect(input, output);
+    }
+}
+
+void PlaneConvolver::Convolve(const float* input, float* output, const float* input2, float* output2) const {
+    if (_use_fft) {
+        ConvolveFft(input, output, input2, output2);
+    } else {
+        ConvolveDirect(input, output);
+        ConvolveDirect(input2, output2);
+    }
+}
+
+void PlaneConvolver::ConvolveDirect(const float* input, float* output) const {
+    int centre_x = _kernel_width / 2;
+    int centre_y = _kernel_height / 2;
+    for (int y = 0; y < _height; ++y) {
+        for (int x = 0; x < _width; ++x) {
+            // Kernel pixels (i, j) that overlap the plane at (x + centre_x - i, y + centre_y - j)
+            int j_min = std::max(0, y + centre_y - _height + 1);
+            int j_max = std::min(_kernel_height - 1, y + centre_y);
+            int i_min = std::max(0, x + centre_x - _width + 1);
+            int i_max = std::min(_kernel_width - 1, x + centre_x);
+            double sum(0.0);
+            for (int j = j_min; j <= j_max; ++j) {
+                const float* kernel_row = _kernel.data() + j * _kernel_width;
+                const float* input_row = input + (y + centre_y - j) * _width + x + centre_x;
+                for (int i = i_min; i <= i_max; ++i) {
+                    float value = input_row[-i];
+                    if (std::isfinite(value)) {
+                        sum += kernel_row[i] * value;
+                    }
+                }
+            }
+            output[y * _width + x] = sum;
+        }
+    }
+}
+
+void PlaneConvolver::ConvolveFft(const float* input, float* output, const float* input2, float* output2) const {
+    // Work buffers are kept by each thread for the next plane
+    thread_local std::vector<std::complex<float>> buffer;
+    buffer.assign(_fft_width * _fft_height, 0.0);
+    for (int y = 0; y < _height; ++y) {
+        for (int x = 0; x < _width; ++x) {
+            size_t index = y * _width + x;
+            float real = std::isfinite(input[index]) ? input[index] : 0.0;
+            float imag = (input2 && std::isfinite(input2[index])) ? input2[index] : 0.0;
+            buffer[y * _fft_width + x] = std::complex<float>(real, imag);
+        }
+    }
+
+    Transform2D(buffer.data(), false);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        const std::complex<float>& k = _kernel_spectrum[i];
+        const std::complex<float>& v = buffer[i];
+        buffer[i] = std::complex<float>(v.real() * k.real() - v.imag() * k.imag(), v.real() * k.imag() + v.imag() * k.real());
+    }
+    Transform2D(buffer.data(), true);
+
+    // The kernel is real, so the real and imaginary parts are the two convolved planes
+    int centre_x = _kernel_width / 2;
+    int centre_y = _kernel_height / 2;
+    for (int y = 0; y < _height; ++y) {
+        const std::complex<float>* row = buffer.data() + (y + centre_y) * _fft_width + centre_x;
+        for (int x = 0; x < _width; ++x) {
+            output[y * _width + x] = row[x].real();
+            if (output2) {
+                output2[y * _width + x] = row[x].imag();
+            }
+        }
+    }
+}
+
+void PlaneConvolver::Transform2D(std::complex<float>* data, bool inverse) const {
+    // Before the forward transform only the rows of the plane or kernel are not zero, and after the inverse only the output rows are
+    // needed, so those rows are transformed on their own
+    size_t first_row = inverse ? _kernel_height / 2 : 0;
+    size_t end_row = inverse ? first_row + _height : std::max(_height, _kernel_height);
+    end_row = std::min(end_row, _fft_height);
+    auto transform_rows = [&]() {
+        for (size_t y = first_row; y < end_row; ++y) {
+            _plan_x->Transform(data + y * _fft_width, inverse);
+        }
+    };
+
+    if (!inverse) {
+        transform_rows();
+    }
+
+    // Columns are copied in blocks, so that whole cache lines of each row are used
+    thread_local std::vector<std::complex<float>> columns;
+    columns.resize(_fft_height * PLANE_CONVOLVER_COLUMN_BLOCK);
+    for (size_t x_start = 0; x_start < _fft_width; x_start += PLANE_CONVOLVER_COLUMN_BLOCK) {
+        size_t num_columns = std::min((size_t)PLANE_CONVOLVER_COLUMN_BLOCK, _fft_width - x_start);
+        for (size_t y = 0; y < _fft_height; ++y) {
+            for (size_t i = 0; i < num_columns; ++i) {
+                columns[i * _fft_height + y] = data[y * _fft_width + x_start + i];
+            }
+        }
+        for (size_t i = 0; i < num_columns; ++i) {
+            _plan_y->Transform(columns.data() + i * _fft_height, inverse);
+        }
+        for (size_t y = 0; y < _fft_height; ++y) {
+            for (size_t i = 0; i < num_columns; ++i) {
+                data[y * _fft_width + x_start + i] = columns[i * _fft_height + y];
+            }
+        }
+    }
+
+    if (inverse) {
+        transform_rows();
+    }
+}
@@ -0,0 +1,70 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PlaneConvolver.h: convolution of image planes with a real kernel, by FFT or directly for small kernels
+
+#ifndef CARTA_BACKEND__MOMENT_PLANECONVOLVER_H_
+#define CARTA_BACKEND__MOMENT_PLANECONVOLVER_H_
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace carta {
+
+// Radix-2 complex FFT of one length; plans are shared by all convolvers through a cache
+class FftPlan {
+public:
+    explicit FftPlan(size_t length);
+
+    static std::shared_ptr<const FftPlan> Get(size_t length);
+
+    size_t Length() const {
+        return _length;
+    }
+    // In place, without normalisation for the inverse
+    void Transform(std::complex<float>* data, bool inverse) const;
+
+private:
+    size_t _length;
+    std::vector<std::complex<float>> _twiddles;
+    std::vector<size_t> _bit_reverse;
+};
+
+// Linear convolution of width x height planes with a kernel centred on pixel (kernel_width / 2, kernel_height / 2), giving planes of
+// the same shape as ImageConvolver. NaN pixels are zero before convolution. Planes are x fastest. Convolve is thread safe: each
+// thread uses its own work buffers.
+class PlaneConvolver {
+public:
+    PlaneConvolver(const std::vector<float>& kernel, int kernel_width, int kernel_height, int width, int height);
+
+    // Convolve one or two planes; planes are transformed in pairs as the real and imaginary parts
+    void Convolve(const float* input, float* output) const;
+    void Convolve(const float* input, float* output, const float* input2, float* output2) const;
+
+    bool UsesFft() const {
+        return _use_fft;
+    }
+
+private:
+    void ConvolveDirect(const float* input, float* output) const;
+    void ConvolveFft(const float* input, float* output, const float* input2, float* output2) const;
+    void Transform2D(std::complex<float>* data, bool inverse) const;
+
+    std::vector<float> _kernel;
+    int _kernel_width, _kernel_height;
+    int _width, _height;
+    bool _use_fft;
+
+    // Padded shape and kernel spectrum for the FFT
+    size_t _fft_width, _fft_height;
+    std::shared_ptr<const FftPlan> _plan_x, _plan_y;
+    std::vector<std::complex<float>> _kernel_spectrum;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__MOMENT_PLANECONVOLVER_H_
@@ -13,32 +13,33 @@
 #include "Logger/Logger.h"
 #include "Util.h"
 
-tbb::task* MultiMessageTask::execute() {
+TaskPriority MultiMessageTask::Priority() const {
     switch (_header.type) {
-        case CARTA::EventType::SET_SPATIAL_REQUIREMENTS: {
-            CARTA::SetSpatialRequirements message;
-            if (message.ParseFromArray(_event_buffer, _event_length)) {
-                _session->OnSetSpatialRequirements(message);
-            } else {
-                spdlog::warn("Bad SET_SPATIAL_REQUIREMENTS message!");
-            }
-            break;
-        }
-        case CARTA::EventType::SET_STATS_REQUIREMENTS: {
-            CARTA::SetStatsRequirements message;
+        case CARTA::EventType::MOMENT_REQUEST:
+            return TaskPriority::Background;
+        default:
+            // File lists
+            return TaskPriority::Tiles;
+    }
+}
+
+OnMessageTask* MultiMessageTask::execute() {
+    switch (_header.type) {
+        case CARTA::EventType::MOMENT_REQUEST: {
+            CARTA::MomentRequest message;
             if (message.ParseFromArray(_event_buffer, _event_length)) {
-                _session->OnSetStatsRequirements(message);
+                _session->OnMomentRequest(message, _header.request_id);
             } else {
-                spdlog::warn("Bad SET_STATS_REQUIREMENTS message!");
+                spdlog::warn("Bad MOMENT_REQUEST message!");
             }
             break;
         }
-        case CARTA::EventType::MOMENT_REQUEST: {
-            CARTA::MomentRequest message;
+        case CARTA::EventType::SAVE_FILE: {
+            CARTA::SaveFile message;
             if (message.ParseFromArray(_event_buffer, _event_length)) {
-                _session->OnMomentRequest(message, _header.request_id);
+                _session->OnSaveFile(message, _header.request_id);
             } else {
-                spdlog::warn("Bad MOMENT_REQUEST message!");
+                spdlog::warn("Bad SAVE_FILE message!");
             }
             break;
         }
@@ -78,7 +79,7 @@ tbb::task* MultiMessageTask::execute() {
     return nullptr;
 }
 
-tbb::task* SetImageChannelsTask::execute() {
+OnMessageTask* SetImageChannelsTask::execute() {
     std::pair<CARTA::SetImageChannels, uint32_t> request_pair;
     bool tester;
 
@@ -94,27 +95,31 @@ tbb::task* SetImageChannelsTask::execute() {
     return nullptr;
 }
 
-tbb::task* SetCursorTask::execute() {
+OnMessageTask* SetRegionTask::execute() {
+    _session->ExecuteSetRegionEvt(_region_id);
+    return nullptr;
+}
+
+OnMessageTask* SetCursorTask::execute() {
     _session->_file_settings.ExecuteOne("SET_CURSOR", _file_id);
     return nullptr;
 }
 
-tbb::task* SetHistogramRequirementsTask::execute() {
+OnMessageTask* SetHistogramRequirementsTask::execute() {
     CARTA::SetHistogramRequirements message;
-    if (message.ParseFromArray(_event_buffer, _event_length)) {
+    if (message.ParseFromArray(_event_buffer.data(), _event_buffer.size())) {
         _session->OnSetHistogramRequirements(message, _header.request_id);
     }
 
     return nullptr;
 }
 
-tbb::task* AnimationTask::execute() {
+OnMessageTask* AnimationTask::execute() {
     if (_session->ExecuteAnimationFrame()) {
         if (_session->CalculateAnimationFlowWindow() > _session->CurrentFlowWindowSize()) {
             _session->SetWaitingTask(true);
         } else {
-            increment_ref_count();
-            recycle_as_safe_continuation();
+            return this;
         }
     } else {
         if (!_session->WaitingFlowEvent()) {
@@ -125,27 +130,47 @@ tbb::task* AnimationTask::execute() {
     return nullptr;
 }
 
-tbb::task* OnAddRequiredTilesTask::execute() {
-    _session->OnAddRequiredTiles(_message, _session->AnimationRunning());
+OnMessageTask* OnAddRequiredTilesTask::execute() {
+    _session->OnAddRequiredTiles(*_message, _session->AnimationRunning());
+    return nullptr;
+}
+
+OnMessageTask* OnAddRequiredChannelTilesTask::execute() {
+    _session->OnAddRequiredChannelTiles(*_message, _cancel_token);
+    return nullptr;
+}
+
+OnMessageTask* OnSetContourParametersTask::execute() {
+    _session->OnSetContourParameters(*_message);
+    return nullptr;
+}
+
+OnMessageTask* ResumeImageDataTask::execute() {
+    _session->ResumeImageData(_file_id, _send_histogram, _contour_settings);
+    return nullptr;
+}
+
+OnMessageTask* OnSetSpatialRequirementsTask::execute() {
+    _session->OnSetSpatialRequirements(*_message);
     return nullptr;
 }
 
-tbb::task* OnSetContourParametersTask::execute() {
-    _session->OnSetContourParameters(_message);
+OnMessageTask* OnSetStatsRequirementsTask::execute() {
+    _session->OnSetStatsRequirements(*_message);
     return nullptr;
 }
 
-tbb::task* RegionDataStreamsTask::execute() {
+OnMessageTask* RegionDataStreamsTask::execute() {
     _session->RegionDataStreams(_file_id, _region_id);
     return nullptr;
 }
 
-tbb::task* SpectralProfileTask::execute() {
+OnMessageTask* SpectralProfileTask::execute() {
     _session->SendSpectralProfileData(_file_id, _region_id);
     return nullptr;
 }
 
-tbb::task* OnSpectralLineRequestTask::execute() {
-    _session->OnSpectralLineRequest(_message, _request_id);
+OnMessageTask* OnSpectralLineRequestTask::execute() {
+    _session->OnSpectralLineRequest(*_message, _request_id);
     return nullptr;
 }
@@ -9,40 +9,90 @@
 #ifndef CARTA_BACKEND__ONMESSAGETASK_H_
 #define CARTA_BACKEND__ONMESSAGETASK_H_
 
+#include <chrono>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include <carta-protobuf/contour.pb.h>
+#include <google/protobuf/arena.h>
 #include <tbb/concurrent_queue.h>
-#include <tbb/task.h>
 
 #include "AnimationObject.h"
 #include "EventHeader.h"
 #include "Session.h"
+#include "TaskScheduler.h"
+#include "Timer/SlowRequestLog.h"
+
+// Inbound message owned by a task, parsed into the task's arena so that the message and its fields are allocated in a few blocks
+// and freed together with the task, instead of being parsed on the heap and copied into the task
+template <class T>
+class ArenaMessage {
+public:
+    ArenaMessage() : _message(google::protobuf::Arena::CreateMessage<T>(&_arena)) {}
+    ArenaMessage(const ArenaMessage&) = delete;
+    ArenaMessage& operator=(const ArenaMessage&) = delete;
+
+    bool Parse(const char* buffer, int length) {
+        return _message->ParseFromArray(buffer, length);
+    }
+    T& operator*() {
+        return *_message;
+    }
+    T* operator->() {
+        return _message;
+    }
+
+private:
+    google::protobuf::Arena _arena;
+    T* _message;
+};
+
+class OnMessageTask {
+    friend class TaskScheduler;
 
-class OnMessageTask : public tbb::task {
 protected:
     Session* _session;
-    tbb::task* execute() override = 0;
+    carta::CancellationToken _cancel_token; // token when the task was made, so that later requests do not revive it
+    carta::RequestRecord _request;          // received message the task handles, for the request metrics and slow request log
+    // Returns a task to run next, or nullptr
+    virtual OnMessageTask* execute() = 0;
 
 public:
-    OnMessageTask(Session* session) {
+    OnMessageTask(Session* session) : OnMessageTask(session, session->Cancellation()) {}
+    OnMessageTask(Session* session, const carta::CancellationToken& cancel_token) {
         _session = session;
+        _cancel_token = cancel_token;
         _session->IncreaseRefCount();
     }
-    ~OnMessageTask() {
+    virtual ~OnMessageTask() {
         if (!_session->DecreaseRefCount())
             delete _session;
         _session = nullptr;
     }
+
+    virtual TaskPriority Priority() const = 0;
+    // Before the task is queued, e.g. with the token of a request which a later request supersedes
+    void SetCancellation(const carta::CancellationToken& cancel_token) {
+        _cancel_token = cancel_token;
+    }
+    bool IsCancelled() const {
+        return _cancel_token.IsCancelled();
+    }
+    // Received message the task handles, measured from its arrival until the task is done
+    void SetRequest(CARTA::EventType event_type, uint32_t request_id, std::chrono::steady_clock::time_point start) {
+        _request.event_type = event_type;
+        _request.session_id = _session->GetId();
+        _request.request_id = request_id;
+        _request.start = start;
+    }
 };
 
 class MultiMessageTask : public OnMessageTask {
     carta::EventHeader _header;
     int _event_length;
     char* _event_buffer;
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
 
 public:
     MultiMessageTask(Session* session_, carta::EventHeader& head, int evt_len, char* event_buf) : OnMessageTask(session_) {
@@ -50,6 +100,7 @@ public:
         _event_length = evt_len;
         _event_buffer = event_buf;
     }
+    TaskPriority Priority() const override;
     ~MultiMessageTask() {
         delete[] _event_buffer;
     };
@@ -57,73 +108,163 @@ public:
 
 class SetImageChannelsTask : public OnMessageTask {
     int fileId;
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
 
 public:
     SetImageChannelsTask(Session* session, int fileId) : OnMessageTask(session), fileId(fileId) {}
+    TaskPriority Priority() const override {
+        return TaskPriority::Tiles;
+    }
     ~SetImageChannelsTask() = default;
 };
 
+class SetRegionTask : public OnMessageTask {
+    int _region_id;
+    OnMessageTask* execute() override;
+
+public:
+    SetRegionTask(Session* session, int region_id) : OnMessageTask(session), _region_id(region_id) {}
+    TaskPriority Priority() const override {
+        return TaskPriority::RegionData;
+    }
+    ~SetRegionTask() = default;
+};
+
 class SetCursorTask : public OnMessageTask {
     int _file_id;
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
 
 public:
     SetCursorTask(Session* session, int file_id) : OnMessageTask(session) {
         _file_id = file_id;
     }
+    TaskPriority Priority() const override {
+        return TaskPriority::Cursor;
+    }
     ~SetCursorTask() = default;
 };
 
 class SetHistogramRequirementsTask : public OnMessageTask {
-    tbb::task* execute();
+    OnMessageTask* execute() override;
     carta::EventHeader _header;
-    int _event_length;
-    const char* _event_buffer;
+    std::string _event_buffer; // copied, as the task may wait behind tasks of higher priority
 
 public:
-    SetHistogramRequirementsTask(Session* session, carta::EventHeader& head, int len, const char* buf) : OnMessageTask(session) {
+    SetHistogramRequirementsTask(Session* session, carta::EventHeader& head, int len, const char* buf)
+        : OnMessageTask(session, session->HistCancellation()) {
         _header = head;
-        _event_length = len;
-        _event_buffer = buf;
+        _event_buffer.assign(buf, len);
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Histograms;
     }
     ~SetHistogramRequirementsTask() = default;
 };
 
 class AnimationTask : public OnMessageTask {
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
 
 public:
     AnimationTask(Session* session) : OnMessageTask(session) {}
+    TaskPriority Priority() const override {
+        return TaskPriority::Tiles;
+    }
     ~AnimationTask() = default;
 };
 
 class OnAddRequiredTilesTask : public OnMessageTask {
-    tbb::task* execute() override;
-    CARTA::AddRequiredTiles _message;
-    int _start, _stride, _end;
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::AddRequiredTiles> _message;
 
 public:
-    OnAddRequiredTilesTask(Session* session, CARTA::AddRequiredTiles message) : OnMessageTask(session) {
-        _message = message;
+    OnAddRequiredTilesTask(Session* session) : OnMessageTask(session) {}
+    // Parses the message from the receive buffer, which is only valid until the task is queued
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    const CARTA::AddRequiredTiles& Message() {
+        return *_message;
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Tiles;
     }
     ~OnAddRequiredTilesTask() = default;
 };
 
+class OnAddRequiredChannelTilesTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::data::AddRequiredChannelTiles> _message;
+
+public:
+    OnAddRequiredChannelTilesTask(Session* session) : OnMessageTask(session) {}
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    const CARTA::data::AddRequiredChannelTiles& Message() {
+        return *_message;
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Tiles;
+    }
+    ~OnAddRequiredChannelTilesTask() = default;
+};
+
 class OnSetContourParametersTask : public OnMessageTask {
-    tbb::task* execute() override;
-    CARTA::SetContourParameters _message;
-    int _start, _stride, _end;
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::SetContourParameters> _message;
 
 public:
-    OnSetContourParametersTask(Session* session, CARTA::SetContourParameters message) : OnMessageTask(session) {
-        _message = message;
+    OnSetContourParametersTask(Session* session) : OnMessageTask(session) {}
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    const CARTA::SetContourParameters& Message() {
+        return *_message;
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Tiles;
     }
     ~OnSetContourParametersTask() = default;
 };
 
+class OnSetSpatialRequirementsTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::SetSpatialRequirements> _message;
+
+public:
+    OnSetSpatialRequirementsTask(Session* session) : OnMessageTask(session) {}
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    const CARTA::SetSpatialRequirements& Message() {
+        return *_message;
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Cursor;
+    }
+    ~OnSetSpatialRequirementsTask() = default;
+};
+
+class OnSetStatsRequirementsTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::SetStatsRequirements> _message;
+
+public:
+    OnSetStatsRequirementsTask(Session* session) : OnMessageTask(session) {}
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    const CARTA::SetStatsRequirements& Message() {
+        return *_message;
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::RegionData;
+    }
+    ~OnSetStatsRequirementsTask() = default;
+};
+
 class RegionDataStreamsTask : public OnMessageTask {
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
     int _file_id, _region_id;
 
 public:
@@ -131,11 +272,29 @@ public:
         _file_id = file_id;
         _region_id = region_id;
     }
+    TaskPriority Priority() const override {
+        return TaskPriority::RegionData;
+    }
     ~RegionDataStreamsTask() = default;
 };
 
+class ResumeImageDataTask : public OnMessageTask {
+    OnMessageTask* execute() override;
+    int _file_id;
+    bool _send_histogram;
+    CARTA::SetContourParameters _contour_settings;
+
+public:
+    ResumeImageDataTask(Session* session, int file_id, bool send_histogram, const CARTA::SetContourParameters& contour_settings)
+        : OnMessageTask(session), _file_id(file_id), _send_histogram(send_histogram), _contour_settings(contour_settings) {}
+    TaskPriority Priority() const override {
+        return TaskPriority::Histograms;
+    }
+    ~ResumeImageDataTask() = default;
+};
+
 class SpectralProfileTask : public OnMessageTask {
-    tbb::task* execute() override;
+    OnMessageTask* execute() override;
     int _file_id, _region_id;
 
 public:
@@ -143,19 +302,27 @@ public:
         _file_id = file_id;
         _region_id = region_id;
     }
+    TaskPriority Priority() const override {
+        return TaskPriority::RegionData;
+    }
     ~SpectralProfileTask() = default;
 };
 
 class OnSpectralLineRequestTask : public OnMessageTask {
-    tbb::task* execute() override;
-    CARTA::SpectralLineRequest _message;
+    OnMessageTask* execute() override;
+    ArenaMessage<CARTA::SpectralLineRequest> _message;
     uint32_t _request_id;
 
 public:
-    OnSpectralLineRequestTask(Session* session, CARTA::SpectralLineRequest message, uint32_t request_id) : OnMessageTask(session) {
-        _message = message;
+    OnSpectralLineRequestTask(Session* session, uint32_t request_id) : OnMessageTask(session) {
         _request_id = request_id;
     }
+    bool Parse(const char* buffer, int length) {
+        return _message.Parse(buffer, length);
+    }
+    TaskPriority Priority() const override {
+        return TaskPriority::Background;
+    }
     ~OnSpectralLineRequestTask() = default;
 };
 
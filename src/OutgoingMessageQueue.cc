@@ -0,0 +1,145 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "OutgoingMessageQueue.h"
+
+#include <algorithm>
+
+#include "Constants.h"
+#include "Metrics.h"
+
+bool OutgoingMessageKey::Supersedes(const OutgoingMessageKey& queued) const {
+    if ((type == CARTA::EventType::EMPTY_EVENT) || (type != queued.type) || (file_id < 0) || (file_id != queued.file_id)) {
+        return false;
+    }
+
+    switch (type) {
+        case CARTA::EventType::SPATIAL_PROFILE_DATA:
+            // Only the latest cursor/point profile of a region is useful
+            return region_id == queued.region_id;
+        case CARTA::EventType::RASTER_TILE_DATA:
+        case CARTA::EventType::CONTOUR_IMAGE_DATA:
+            // Tiles and contour chunks of the current image are all needed; those of an image the client moved away from are not
+            return (channel != queued.channel) || (stokes != queued.stokes);
+        default:
+            return false;
+    }
+}
+
+OutgoingMessageQueue::OutgoingMessageQueue(size_t max_queued_bytes)
+    : _max_queued_bytes(max_queued_bytes), _queued_bytes(0), _stopped(false) {}
+
+OutgoingMessageQueue::~OutgoingMessageQueue() {
+    carta::Metrics::Global().AddQueuedBytes(-(int64_t)_queued_bytes);
+}
+
+bool OutgoingMessageQueue::Push(OutgoingMessage&& message, bool wait) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (wait) {
+        // A message larger than the limit is accepted once the queue is empty
+        _space_available.wait(lock, [&]() {
+            return _stopped || _queued_bytes == 0 || (_queued_bytes + message.data.size() <= _max_queued_bytes);
+        });
+    }
+
+    if (_stopped) {
+        return false;
+    }
+
+    size_t previous_bytes = _queued_bytes;
+    if (message.key.type != CARTA::EventType::EMPTY_EVENT) {
+        auto superseded = std::remove_if(_messages.begin(), _messages.end(), [&](const OutgoingMessage& queued) {
+            if (message.key.Supersedes(queued.key)) {
+                _queued_bytes -= queued.data.size();
+                return true;
+            }
+            return false;
+        });
+        _messages.erase(superseded, _messages.end());
+    }
+
+    _queued_bytes += message.data.size();
+    _messages.push_back(std::move(message));
+    carta::Metrics::Global().AddQueuedBytes((int64_t)_queued_bytes - (int64_t)previous_bytes);
+    return true;
+}
+
+bool OutgoingMessageQueue::TryPop(OutgoingMessage& message) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_messages.empty()) {
+        return false;
+    }
+
+    message = std::move(_messages.front());
+    _messages.pop_front();
+    _queued_bytes -= message.data.size();
+    carta::Metrics::Global().AddQueuedBytes(-(int64_t)message.data.size());
+    lock.unlock();
+    _space_available.notify_all();
+    return true;
+}
+
+void OutgoingMessageQueue::Clear() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _messages.clear();
+    carta::Metrics::Global().AddQueuedBytes(-(int64_t)_queued_bytes);
+    _queued_bytes = 0;
+    lock.unlock();
+    _space_available.notify_all();
+}
+
+void OutgoingMessageQueue::Stop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopped = true;
+    lock.unlock();
+    _space_available.notify_all();
+}
+
+void OutgoingMessageQueue::Reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopped = false;
+}
+
+size_t OutgoingMessageQueue::QueuedBytes() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _queued_bytes;
+}
+
+std::vector<char> OutgoingMessageQueue::AcquireBuffer(size_t size) {
+    std::vector<char> buffer;
+    {
+        // Smallest free buffer large enough, else the largest, which then grows
+        std::unique_lock<std::mutex> lock(_buffer_mutex);
+        if (!_free_buffers.empty()) {
+            auto best = _free_buffers.begin();
+            for (auto it = _free_buffers.begin(); it != _free_buffers.end(); ++it) {
+                size_t capacity = it->capacity();
+                size_t best_capacity = best->capacity();
+                bool better = (best_capacity < size) ? (capacity > best_capacity) : (capacity >= size && capacity < best_capacity);
+                if (better) {
+                    best = it;
+                }
+            }
+            buffer = std::move(*best);
+            *best = std::move(_free_buffers.back());
+            _free_buffers.pop_back();
+        }
+    }
+    // A recycled buffer keeps its size, so only growth is zero-filled; the caller overwrites all of it
+    buffer.resize(size);
+    return buffer;
+}
+
+void OutgoingMessageQueue::RecycleBuffer(std::vector<char>&& buffer) {
+    if (buffer.capacity() == 0 || buffer.capacity() > OUTGOING_BUFFER_POOL_MAX_BYTES) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_buffer_mutex);
+    if (_free_buffers.size() < OUTGOING_BUFFER_POOL_SIZE) {
+        _free_buffers.push_back(std::move(buffer));
+    }
+}
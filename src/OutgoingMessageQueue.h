@@ -0,0 +1,72 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# OutgoingMessageQueue.h: bounded per-session queue of serialized messages waiting to be sent to the client
+
+#ifndef CARTA_BACKEND__OUTGOINGMESSAGEQUEUE_H_
+#define CARTA_BACKEND__OUTGOINGMESSAGEQUEUE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <carta-protobuf/enums.pb.h>
+
+// Identifies the data stream a message belongs to, so that newer data can replace queued data the client no longer needs
+struct OutgoingMessageKey {
+    CARTA::EventType type = CARTA::EventType::EMPTY_EVENT;
+    int32_t file_id = -1;
+    int32_t region_id = -1;
+    int32_t channel = -1;
+    int32_t stokes = -1;
+
+    // Returns true if this (newer) message makes the queued message obsolete
+    bool Supersedes(const OutgoingMessageKey& queued) const;
+};
+
+struct OutgoingMessage {
+    std::vector<char> data;
+    bool compress = false;
+    OutgoingMessageKey key;
+};
+
+class OutgoingMessageQueue {
+public:
+    explicit OutgoingMessageQueue(size_t max_queued_bytes);
+    ~OutgoingMessageQueue();
+
+    // Queue a message, dropping queued messages it supersedes. If wait is set, blocks while the queue is full.
+    // Returns false if the queue is stopped and the message was discarded.
+    bool Push(OutgoingMessage&& message, bool wait);
+    bool TryPop(OutgoingMessage& message);
+    void Clear();
+
+    // Stop accepting messages and release blocked producers; Reset accepts messages again
+    void Stop();
+    void Reset();
+
+    size_t QueuedBytes();
+
+    // Buffers of sent messages are reused for new messages, so that tile rates do not allocate and zero-fill a buffer per message.
+    // An acquired buffer has the requested size; a sent message's buffer is recycled by the loop thread.
+    std::vector<char> AcquireBuffer(size_t size);
+    void RecycleBuffer(std::vector<char>&& buffer);
+
+private:
+    std::deque<OutgoingMessage> _messages;
+    size_t _max_queued_bytes;
+    size_t _queued_bytes;
+    bool _stopped;
+    std::mutex _mutex;
+    std::condition_variable _space_available;
+
+    std::vector<std::vector<char>> _free_buffers;
+    std::mutex _buffer_mutex;
+};
+
+#endif // CARTA_BACKEND__OUTGOINGMESSAGEQUEUE_H_
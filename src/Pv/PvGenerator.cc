@@ -0,0 +1,282 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PvGenerator.cc: position-velocity images sampled along a line or polyline through a cube, from spectra of blocks of pixels
+
+#include "PvGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include <casacore/casa/Quanta/Quantum.h>
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+#include <casacore/coordinates/Coordinates/LinearCoordinate.h>
+#include <casacore/coordinates/Coordinates/SpectralCoordinate.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/lattices/Lattices/ArrayLattice.h>
+#include <tbb/pipeline.h>
+
+#include "../Constants.h"
+
+using namespace carta;
+
+namespace {
+
+// Tile of the path with the weighted sums of the samples which use its pixels
+struct PvTile {
+    int index, x, y, count_x, count_y;
+    std::vector<float> data;
+    std::vector<size_t> samples;       // in order
+    std::vector<double> sums, weights; // z fastest, then sample
+};
+using PvTilePtr = std::shared_ptr<PvTile>;
+
+casacore::LinearCoordinate MakeLinearCoordinate(
+    const casacore::String& name, const casacore::String& unit, double value, double increment) {
+    casacore::Vector<casacore::String> names(1, name), units(1, unit);
+    casacore::Vector<casacore::Double> reference_value(1, value), increments(1, increment), reference_pixel(1, 0.0);
+    casacore::Matrix<casacore::Double> pc(1, 1, 1.0);
+    return casacore::LinearCoordinate(names, units, reference_value, increments, pc, reference_pixel);
+}
+
+} // namespace
+
+PvGenerator::PvGenerator(int width, int height, int tile_depth)
+    : _width(width), _height(height), _tile_depth(tile_depth), _num_samples(0) {}
+
+bool PvGenerator::SetPath(const std::vector<PointXy>& vertices, int line_width, PvInterpolation interpolation) {
+    _num_samples = 0;
+    _tile_weights.clear();
+    if ((vertices.size() < 2) || (line_width < 1)) {
+        return false;
+    }
+
+    // Distance along the path to each vertex
+    std::vector<double> distances(vertices.size(), 0.0);
+    for (size_t i = 1; i < vertices.size(); ++i) {
+        distances[i] = distances[i - 1] + std::hypot(vertices[i].x - vertices[i - 1].x, vertices[i].y - vertices[i - 1].y);
+    }
+    if (!std::isfinite(distances.back())) {
+        return false;
+    }
+    _num_samples = (size_t)std::floor(distances.back()) + 1;
+
+    size_t segment(0);
+    for (size_t sample = 0; sample < _num_samples; ++sample) {
+        double distance(sample);
+        while ((segment + 2 < vertices.size()) && (distance > distances[segment + 1])) {
+            ++segment;
+        }
+        auto& from = vertices[segment];
+        auto& to = vertices[segment + 1];
+        double segment_length = distances[segment + 1] - distances[segment];
+        double dx(0.0), dy(0.0); // unit vector along the segment
+        if (segment_length > 0.0) {
+            dx = (to.x - from.x) / segment_length;
+            dy = (to.y - from.y) / segment_length;
+        }
+        double x = from.x + (distance - distances[segment]) * dx;
+        double y = from.y + (distance - distances[segment]) * dy;
+
+        // Points across the path, centred on it
+        for (int i = 0; i < line_width; ++i) {
+            double across = i - (line_width - 1) / 2.0;
+            AddPoint(sample, x - across * dy, y + across * dx, interpolation);
+        }
+    }
+
+    if (_tile_weights.empty()) {
+        _num_samples = 0;
+        return false;
+    }
+    return true;
+}
+
+void PvGenerator::AddPoint(size_t sample, double x, double y, PvInterpolation interpolation) {
+    if (!(x > -1.0) || !(x < _width) || !(y > -1.0) || !(y < _height)) {
+        return; // no pixel of the image, or NaN
+    }
+    if (interpolation == PvInterpolation::Nearest) {
+        AddPixel(sample, std::lround(x), std::lround(y), 1.0);
+        return;
+    }
+    int x0 = std::floor(x);
+    int y0 = std::floor(y);
+    double fx(x - x0), fy(y - y0);
+    AddPixel(sample, x0, y0, (1.0 - fx) * (1.0 - fy));
+    AddPixel(sample, x0 + 1, y0, fx * (1.0 - fy));
+    AddPixel(sample, x0, y0 + 1, (1.0 - fx) * fy);
+    AddPixel(sample, x0 + 1, y0 + 1, fx * fy);
+}
+
+void PvGenerator::AddPixel(size_t sample, int x, int y, float weight) {
+    if ((weight <= 0.0) || (x < 0) || (y < 0) || (x >= _width) || (y >= _height)) {
+        return;
+    }
+    int tile_x(x / PV_TILE_SIZE), tile_y(y / PV_TILE_SIZE);
+    int num_tiles_x = (_width + PV_TILE_SIZE - 1) / PV_TILE_SIZE;
+    int count_y = std::min(PV_TILE_SIZE, _height - tile_y * PV_TILE_SIZE);
+    int pixel = (x - tile_x * PV_TILE_SIZE) * count_y + (y - tile_y * PV_TILE_SIZE);
+    _tile_weights[tile_y * num_tiles_x + tile_x].push_back({sample, pixel, weight});
+}
+
+bool PvGenerator::Calculate(const SpectralTileReader& read_tile, const AxisRange& z_range, const ProgressCallback& progress_callback,
+    std::vector<float>& pv_data) {
+    int num_z = z_range.to - z_range.from + 1;
+    if (_tile_weights.empty() || (z_range.from < 0) || (num_z < 1) || (z_range.to >= _tile_depth)) {
+        return false;
+    }
+
+    // Weighted sums of the samples, sample fastest then z
+    size_t num_values = _num_samples * num_z;
+    std::vector<double> sums(num_values, 0.0), weights(num_values, 0.0);
+
+    int num_tiles_x = (_width + PV_TILE_SIZE - 1) / PV_TILE_SIZE;
+    size_t tile_mb = ((size_t)PV_TILE_SIZE * PV_TILE_SIZE * _tile_depth * sizeof(float)) / (1024 * 1024);
+    size_t num_tokens = std::max(PV_TILES_MAX_MB / std::max(tile_mb, (size_t)1), (size_t)1);
+    float num_tiles = _tile_weights.size();
+    size_t num_tiles_done(0);
+    std::atomic<bool> failed(false), cancelled(false);
+    auto next_tile = _tile_weights.begin();
+
+    // Read tiles in order, sample them in parallel, then add to the samples in order
+    auto read = [&](tbb::flow_control& fc) -> PvTilePtr {
+        if (failed || cancelled || (next_tile == _tile_weights.end())) {
+            fc.stop();
+            return nullptr;
+        }
+        auto tile = std::make_shared<PvTile>();
+        tile->index = next_tile->first;
+        tile->x = (tile->index % num_tiles_x) * PV_TILE_SIZE;
+        tile->y = (tile->index / num_tiles_x) * PV_TILE_SIZE;
+        tile->count_x = std::min(PV_TILE_SIZE, _width - tile->x);
+        tile->count_y = std::min(PV_TILE_SIZE, _height - tile->y);
+        if (!read_tile(tile->data, tile->x, tile->count_x, tile->y, tile->count_y) ||
+            (tile->data.size() != (size_t)tile->count_x * tile->count_y * _tile_depth)) {
+            failed = true;
+        }
+        ++next_tile;
+        return tile;
+    };
+    auto sample = [&](PvTilePtr tile) {
+        if (failed || cancelled) {
+            return tile;
+        }
+        auto& pixel_weights = _tile_weights.at(tile->index);
+        // The weights were added in sample order
+        for (auto& pixel_weight : pixel_weights) {
+            if (tile->samples.empty() || (tile->samples.back() != pixel_weight.sample)) {
+                tile->samples.push_back(pixel_weight.sample);
+            }
+        }
+        tile->sums.assign(tile->samples.size() * num_z, 0.0);
+        tile->weights.assign(tile->samples.size() * num_z, 0.0);
+
+        size_t index(0);
+        for (auto& pixel_weight : pixel_weights) {
+            if (tile->samples[index] != pixel_weight.sample) {
+                ++index;
+            }
+            const float* spectrum = tile->data.data() + (size_t)pixel_weight.pixel * _tile_depth + z_range.from;
+            double* sample_sums = tile->sums.data() + index * num_z;
+            double* sample_weights = tile->weights.data() + index * num_z;
+            for (int z = 0; z < num_z; ++z) {
+                if (std::isfinite(spectrum[z])) {
+                    sample_sums[z] += pixel_weight.weight * spectrum[z];
+                    sample_weights[z] += pixel_weight.weight;
+                }
+            }
+        }
+        std::vector<float>().swap(tile->data);
+        return tile;
+    };
+    auto add = [&](PvTilePtr tile) {
+        if (failed || cancelled) {
+            return;
+        }
+        for (size_t index = 0; index < tile->samples.size(); ++index) {
+            size_t sample = tile->samples[index];
+            for (int z = 0; z < num_z; ++z) {
+                sums[z * _num_samples + sample] += tile->sums[index * num_z + z];
+                weights[z * _num_samples + sample] += tile->weights[index * num_z + z];
+            }
+        }
+        if (progress_callback && !progress_callback(++num_tiles_done / num_tiles)) {
+            cancelled = true;
+        }
+    };
+    tbb::parallel_pipeline(num_tokens,
+        tbb::make_filter<void, PvTilePtr>(tbb::filter::serial_in_order, read) &
+            tbb::make_filter<PvTilePtr, PvTilePtr>(tbb::filter::parallel, sample) &
+            tbb::make_filter<PvTilePtr, void>(tbb::filter::serial_in_order, add));
+    if (failed || cancelled) {
+        return false;
+    }
+
+    pv_data.resize(num_values);
+    for (size_t i = 0; i < num_values; ++i) {
+        pv_data[i] = (weights[i] > 0.0) ? sums[i] / weights[i] : std::numeric_limits<float>::quiet_NaN();
+    }
+    return true;
+}
+
+std::shared_ptr<casacore::ImageInterface<casacore::Float>> PvGenerator::MakeImage(
+    const casacore::ImageInterface<casacore::Float>& source, int spectral_axis, int z_min, size_t num_samples,
+    std::vector<float>& pv_data) {
+    if (!num_samples || pv_data.empty() || (pv_data.size() % num_samples)) {
+        return nullptr;
+    }
+    const casacore::CoordinateSystem& source_csys = source.coordinates();
+    casacore::CoordinateSystem csys;
+
+    // Samples are one pixel apart; the geometric mean of the pixel sizes for pixels which are not square
+    casacore::String offset_unit("");
+    double offset_increment(1.0);
+    if (source_csys.hasDirectionCoordinate()) {
+        const casacore::DirectionCoordinate& direction = source_csys.directionCoordinate();
+        casacore::Vector<casacore::Double> increment = direction.increment();
+        casacore::Vector<casacore::String> units = direction.worldAxisUnits();
+        double x_increment = casacore::Quantity(std::abs(increment(0)), units(0)).getValue("arcsec");
+        double y_increment = casacore::Quantity(std::abs(increment(1)), units(1)).getValue("arcsec");
+        offset_increment = std::sqrt(x_increment * y_increment);
+        offset_unit = "arcsec";
+    }
+    csys.addCoordinate(MakeLinearCoordinate("Offset", offset_unit, 0.0, offset_increment));
+
+    int coordinate(-1), axis_in_coordinate(-1);
+    if (spectral_axis >= 0) {
+        source_csys.findPixelAxis(coordinate, axis_in_coordinate, spectral_axis);
+    }
+    if ((coordinate >= 0) && (source_csys.type(coordinate) == casacore::Coordinate::SPECTRAL)) {
+        casacore::SpectralCoordinate spectral(source_csys.spectralCoordinate(coordinate));
+        casacore::Vector<casacore::Double> reference_pixel = spectral.referencePixel();
+        reference_pixel(0) -= z_min;
+        spectral.setReferencePixel(reference_pixel);
+        csys.addCoordinate(spectral);
+    } else {
+        csys.addCoordinate(MakeLinearCoordinate("Channel", "", z_min, 1.0));
+    }
+
+    casacore::IPosition shape(2, num_samples, pv_data.size() / num_samples);
+    auto image = std::make_shared<casacore::TempImage<casacore::Float>>(casacore::TiledShape(shape), csys);
+    image->put(casacore::Array<casacore::Float>(shape, pv_data.data(), casacore::SHARE));
+    if (std::any_of(pv_data.begin(), pv_data.end(), [](float value) { return !std::isfinite(value); })) {
+        casacore::Array<casacore::Bool> mask(shape);
+        std::transform(pv_data.begin(), pv_data.end(), mask.begin(), [](float value) { return std::isfinite(value); });
+        image->attachMask(casacore::ArrayLattice<casacore::Bool>(mask));
+    }
+    image->setUnits(source.units());
+
+    // Per-channel beams do not match the channels of the samples
+    casacore::ImageInfo image_info(source.imageInfo());
+    if (image_info.hasMultipleBeams()) {
+        image_info.removeRestoringBeam();
+    }
+    image->setImageInfo(image_info);
+    return image;
+}
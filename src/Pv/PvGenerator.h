@@ -0,0 +1,71 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PvGenerator.h: position-velocity images sampled along a line or polyline through a cube, from spectra of blocks of pixels
+
+#ifndef CARTA_BACKEND_PV_PVGENERATOR_H_
+#define CARTA_BACKEND_PV_PVGENERATOR_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <casacore/images/Images/ImageInterface.h>
+
+#include "../Util.h"
+
+namespace carta {
+
+enum class PvInterpolation { Nearest, Bilinear };
+
+// Samples are one pixel apart along the path, from its first vertex. Each sample is the mean of line_width points one pixel apart
+// across the path, and each point is its nearest pixel or the bilinear weights of its four neighbours; pixels outside the image
+// and NaN pixels are left out of the mean, per channel. Pixels are grouped in blocks of PV_TILE_SIZE, so the spectra of each block
+// are read once however many samples use them, and the blocks are sampled in parallel along the path.
+class PvGenerator {
+public:
+    // Spectra of a block of pixels, for all channels of the tile depth, with z fastest then y then x
+    using SpectralTileReader = std::function<bool(std::vector<float>& data, int x, int count_x, int y, int count_y)>;
+    // Fraction of the path done; returns false to cancel
+    using ProgressCallback = std::function<bool(float progress)>;
+
+    PvGenerator(int width, int height, int tile_depth);
+
+    // Vertices in image pixel coordinates; false if no sample of the path has a pixel in the image
+    bool SetPath(const std::vector<PointXy>& vertices, int line_width, PvInterpolation interpolation);
+    size_t NumSamples() const {
+        return _num_samples;
+    }
+
+    // Values of the channels of the z range of the tiles, with the sample fastest then z, NaN for samples without data in the
+    // channel; false if a read failed or the calculation was cancelled
+    bool Calculate(const SpectralTileReader& read_tile, const AxisRange& z_range, const ProgressCallback& progress_callback,
+        std::vector<float>& pv_data);
+
+    // Image of the values, with an offset axis along the path in arcsec (pixels without a direction coordinate) and the spectral
+    // axis of the source image for channels z_min onwards; units and beam are those of the source image
+    static std::shared_ptr<casacore::ImageInterface<casacore::Float>> MakeImage(const casacore::ImageInterface<casacore::Float>& source,
+        int spectral_axis, int z_min, size_t num_samples, std::vector<float>& pv_data);
+
+private:
+    // Pixel of a tile used by a sample
+    struct PixelWeight {
+        size_t sample;
+        int pixel; // spectrum in the tile data, y fastest
+        float weight;
+    };
+    void AddPixel(size_t sample, int x, int y, float weight);
+    void AddPoint(size_t sample, double x, double y, PvInterpolation interpolation);
+
+    int _width, _height, _tile_depth;
+    size_t _num_samples;
+    std::map<int, std::vector<PixelWeight>> _tile_weights; // key is tile index, y then x, so tiles are read in row order
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_PV_PVGENERATOR_H_
@@ -583,16 +583,18 @@ void CrtfImportExport::ProcessFileLines(std::vector<std::string>& lines) {
     // Import regions defined on each line of file
     casa::AnnotationBase::unitInit(); // enable "pix" unit
 
-    for (auto& line : lines) {
-        if (line.empty() || (line[0] == '#')) {
-            continue; // ignore blank lines and comments
+    // Tokenise lines in parallel, ignoring blank lines and comments; regions are imported in line order since global parameters
+    // apply to the lines after them
+    std::vector<ParsedRegionLine> parsed_lines =
+        ParseRegionLines(lines, [](const std::string& line) { return !line.empty() && (line[0] != '#'); });
+
+    for (auto& parsed_line : parsed_lines) {
+        if (parsed_line.parameters.empty()) {
+            continue;
         }
 
-        // Parse line
-        std::vector<std::string> parameters;
-        std::unordered_map<std::string, std::string> properties;
-        ParseRegionParameters(line, parameters, properties);
-
+        auto& parameters = parsed_line.parameters;
+        auto& properties = parsed_line.properties;
         std::string region(parameters[0]);
         RegionState region_state;
         if (region == "symbol") {
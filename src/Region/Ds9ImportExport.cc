@@ -200,20 +200,18 @@ void Ds9ImportExport::ProcessFileLines(std::vector<std::string>& lines) {
     // Map to check for DS9 keywords and convert to CASA
     InitDs9CoordMap();
 
-    bool ds9_coord_sys_ok(true); // flag for invalid coord sys lines
-    for (auto& line : lines) {
-        // skip blank line
-        if (line.empty()) {
-            continue;
-        }
-
-        // skip comment
-        if (line[0] == '#') {
-            continue;
-        }
+    // Region definitions do not depend on the lines before them until they are converted, so they are tokenised first
+    auto is_region_line = [&](const std::string& line) {
+        // skip blank line, comment, and regions excluded for later analysis (annotation-only)
+        return !line.empty() && (line[0] != '#') && (line[0] != '-') && (line.find("global") == std::string::npos) &&
+               !IsDs9CoordSysKeyword(line);
+    };
+    std::vector<ParsedRegionLine> parsed_lines = ParseRegionLines(lines, is_region_line);
 
-        // skip regions excluded for later analysis (annotation-only)
-        if (line[0] == '-') {
+    bool ds9_coord_sys_ok(true); // flag for invalid coord sys lines
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto& line = lines[i];
+        if (line.empty() || (line[0] == '#') || (line[0] == '-')) {
             continue;
         }
 
@@ -234,7 +232,7 @@ void Ds9ImportExport::ProcessFileLines(std::vector<std::string>& lines) {
         }
 
         if (ds9_coord_sys_ok) { // else skip lines defined in that coord sys
-            SetRegion(line);
+            SetRegion(parsed_lines[i].parameters, parsed_lines[i].properties);
         }
     }
 }
@@ -257,7 +255,7 @@ void Ds9ImportExport::InitDs9CoordMap() {
     _coord_map["linear"] = "UNSUPPORTED";
 }
 
-bool Ds9ImportExport::IsDs9CoordSysKeyword(std::string& input_line) {
+bool Ds9ImportExport::IsDs9CoordSysKeyword(const std::string& input_line) {
     // Check if region file line is coordinate in map
     std::string input_lower(input_line);
     std::transform(input_line.begin(), input_line.end(), input_lower.begin(), ::tolower); // convert to lowercase
@@ -325,12 +323,11 @@ void Ds9ImportExport::SetGlobals(std::string& global_line) {
     }
 }
 
-void Ds9ImportExport::SetRegion(std::string& region_definition) {
-    // Convert ds9 region description into RegionState
-    // Split into region definition, properties
-    std::vector<std::string> parameters;
-    std::unordered_map<std::string, std::string> properties;
-    ParseRegionParameters(region_definition, parameters, properties);
+void Ds9ImportExport::SetRegion(std::vector<std::string>& parameters, std::unordered_map<std::string, std::string>& properties) {
+    // Convert ds9 region description, split into region definition and properties, into RegionState
+    if (parameters.empty()) {
+        return;
+    }
 
     // Process region definition include/exclude and remove indicator
     std::string region_type(parameters[0]);
@@ -53,13 +53,13 @@ private:
 
     // Coordinate system handlers
     void InitDs9CoordMap();
-    bool IsDs9CoordSysKeyword(std::string& input_line);
+    bool IsDs9CoordSysKeyword(const std::string& input_line);
     bool SetFileReferenceFrame(std::string& ds9_coord);
     void SetImageReferenceFrame();
 
     // Import regions
     void SetGlobals(std::string& global_line);
-    void SetRegion(std::string& region_definition);
+    void SetRegion(std::vector<std::string>& parameters, std::unordered_map<std::string, std::string>& properties);
     RegionState ImportPointRegion(std::vector<std::string>& parameters);
     RegionState ImportCircleRegion(std::vector<std::string>& parameters);
     RegionState ImportEllipseRegion(std::vector<std::string>& parameters);
@@ -0,0 +1,222 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PixelTransform.cc: conversion of many pixel positions between the coordinate systems of two images
+
+#include "PixelTransform.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+
+using namespace carta;
+
+PixelTransform::PixelTransform(const casacore::CoordinateSystem& reference_csys, const casacore::CoordinateSystem& output_csys)
+    : _reference_csys(reference_csys), _output_csys(output_csys), _reference_type(casacore::MDirection::J2000) {
+    _direction = reference_csys.hasDirectionCoordinate() && output_csys.hasDirectionCoordinate();
+    _linear = !_direction && reference_csys.hasLinearCoordinate() && output_csys.hasLinearCoordinate();
+    if (_direction) {
+        _reference_type = reference_csys.directionCoordinate().directionType();
+        casacore::MDirection::Types output_type = output_csys.directionCoordinate().directionType();
+        if (_reference_type != output_type) {
+            _direction_converter = std::make_unique<casacore::MDirection::Convert>(
+                casacore::MDirection::Ref(_reference_type), casacore::MDirection::Ref(output_type));
+        }
+    }
+}
+
+bool PixelTransform::Matches(const casacore::CoordinateSystem& reference_csys, const casacore::CoordinateSystem& output_csys) const {
+    return _reference_csys.near(reference_csys) && _output_csys.near(output_csys);
+}
+
+bool PixelTransform::Convert(
+    const std::vector<double>& x, const std::vector<double>& y, std::vector<double>& output_x, std::vector<double>& output_y) {
+    size_t num_points(x.size());
+    output_x.assign(num_points, NAN);
+    output_y.assign(num_points, NAN);
+    if (!_direction && !_linear) {
+        return false;
+    }
+
+    // Reference pixel to world; "extra" pixel axes are 0
+    casacore::Matrix<casacore::Double> pixel(_reference_csys.nPixelAxes(), num_points, 0.0), world;
+    for (size_t i = 0; i < num_points; ++i) {
+        pixel(0, i) = x[i];
+        pixel(1, i) = y[i];
+    }
+    casacore::Vector<casacore::Bool> world_failures, pixel_failures;
+    bool ok = _reference_csys.toWorldMany(world, pixel, world_failures);
+    if (world.ncolumn() != num_points) {
+        return false;
+    }
+    casacore::Vector<casacore::String> reference_units = _reference_csys.worldAxisUnits();
+
+    // Reference world to output world, in the output units
+    casacore::Matrix<casacore::Double> output_world, output_pixel;
+    if (_direction) {
+        const casacore::DirectionCoordinate& output_direction = _output_csys.directionCoordinate();
+        casacore::Vector<casacore::String> output_units = output_direction.worldAxisUnits();
+        output_world.resize(2, num_points);
+        double scale_x = casacore::Quantity(1.0, reference_units(0)).getValue(output_units(0));
+        double scale_y = casacore::Quantity(1.0, reference_units(1)).getValue(output_units(1));
+        for (size_t i = 0; i < num_points; ++i) {
+            if (_direction_converter) {
+                casacore::MDirection direction(casacore::Quantity(world(0, i), reference_units(0)),
+                    casacore::Quantity(world(1, i), reference_units(1)), _reference_type);
+                const casacore::MVDirection& converted = (*_direction_converter)(direction).getValue();
+                output_world(0, i) = converted.getAngle(output_units(0)).getValue()(0);
+                output_world(1, i) = converted.getAngle(output_units(1)).getValue()(1);
+            } else {
+                output_world(0, i) = world(0, i) * scale_x;
+                output_world(1, i) = world(1, i) * scale_y;
+            }
+        }
+        ok = output_direction.toPixelMany(output_pixel, output_world, pixel_failures) && ok;
+    } else {
+        // Other output world axes are at the reference value
+        casacore::Vector<casacore::String> output_units = _output_csys.worldAxisUnits();
+        casacore::Vector<casacore::Double> reference_value = _output_csys.referenceValue();
+        output_world.resize(reference_value.size(), num_points);
+        double scale_x = casacore::Quantity(1.0, reference_units(0)).getValue(output_units(0));
+        double scale_y = casacore::Quantity(1.0, reference_units(1)).getValue(output_units(1));
+        for (size_t i = 0; i < num_points; ++i) {
+            output_world.column(i) = reference_value;
+            output_world(0, i) = world(0, i) * scale_x;
+            output_world(1, i) = world(1, i) * scale_y;
+        }
+        ok = _output_csys.toPixelMany(output_pixel, output_world, pixel_failures) && ok;
+    }
+
+    if (output_pixel.ncolumn() != num_points) {
+        return false;
+    }
+    for (size_t i = 0; i < num_points; ++i) {
+        if (!world_failures(i) && !pixel_failures(i)) {
+            output_x[i] = output_pixel(0, i);
+            output_y[i] = output_pixel(1, i);
+        }
+    }
+    return ok;
+}
+
+PixelTransformGrid::PixelTransformGrid(std::unique_ptr<PixelTransform> transform) : _transform(std::move(transform)) {}
+
+bool PixelTransformGrid::Convert(
+    const std::vector<double>& x, const std::vector<double>& y, std::vector<double>& output_x, std::vector<double>& output_y) {
+    size_t num_points(x.size());
+    output_x.resize(num_points);
+    output_y.resize(num_points);
+
+    // Cells of the points, adding new cells in one conversion
+    std::vector<int64_t> point_cells(num_points);
+    std::vector<int64_t> new_cells;
+    for (size_t i = 0; i < num_points; ++i) {
+        if (!std::isfinite(x[i]) || !std::isfinite(y[i])) {
+            return false;
+        }
+        int64_t cell_x = std::floor(x[i] / PIXEL_TRANSFORM_CELL_SIZE);
+        int64_t cell_y = std::floor(y[i] / PIXEL_TRANSFORM_CELL_SIZE);
+        point_cells[i] = Key(cell_x, cell_y);
+        if (!_cells.count(point_cells[i])) {
+            _cells[point_cells[i]] = false;
+            new_cells.push_back(cell_x);
+            new_cells.push_back(cell_y);
+        }
+    }
+    AddCells(new_cells);
+
+    // Interpolate in the cells; points in other cells are converted together
+    std::vector<size_t> exact_points;
+    std::vector<double> exact_x, exact_y;
+    for (size_t i = 0; i < num_points; ++i) {
+        if (!_cells[point_cells[i]]) {
+            exact_points.push_back(i);
+            exact_x.push_back(x[i]);
+            exact_y.push_back(y[i]);
+            continue;
+        }
+        double grid_x = x[i] / PIXEL_TRANSFORM_CELL_SIZE;
+        double grid_y = y[i] / PIXEL_TRANSFORM_CELL_SIZE;
+        int64_t node_x = std::floor(grid_x);
+        int64_t node_y = std::floor(grid_y);
+        double fx = grid_x - node_x;
+        double fy = grid_y - node_y;
+        const auto& n00 = _nodes[Key(node_x, node_y)];
+        const auto& n10 = _nodes[Key(node_x + 1, node_y)];
+        const auto& n01 = _nodes[Key(node_x, node_y + 1)];
+        const auto& n11 = _nodes[Key(node_x + 1, node_y + 1)];
+        output_x[i] = (1 - fy) * ((1 - fx) * n00.first + fx * n10.first) + fy * ((1 - fx) * n01.first + fx * n11.first);
+        output_y[i] = (1 - fy) * ((1 - fx) * n00.second + fx * n10.second) + fy * ((1 - fx) * n01.second + fx * n11.second);
+    }
+
+    if (exact_points.empty()) {
+        return true;
+    }
+    std::vector<double> converted_x, converted_y;
+    bool ok = _transform->Convert(exact_x, exact_y, converted_x, converted_y);
+    for (size_t k = 0; k < exact_points.size(); ++k) {
+        output_x[exact_points[k]] = converted_x[k];
+        output_y[exact_points[k]] = converted_y[k];
+    }
+    return ok;
+}
+
+void PixelTransformGrid::AddCells(const std::vector<int64_t>& cells) {
+    // Convert the corner nodes not converted yet and the centre of each cell (cells are pairs of x, y indices)
+    if (cells.empty()) {
+        return;
+    }
+    std::vector<int64_t> new_nodes;
+    std::vector<size_t> centres; // index of each cell centre in the points
+    std::vector<double> x, y;
+    for (size_t c = 0; c < cells.size(); c += 2) {
+        for (int64_t j = cells[c + 1]; j <= cells[c + 1] + 1; ++j) {
+            for (int64_t i = cells[c]; i <= cells[c] + 1; ++i) {
+                int64_t key = Key(i, j);
+                if (!_nodes.count(key)) {
+                    _nodes[key] = std::make_pair(NAN, NAN);
+                    new_nodes.push_back(key);
+                    x.push_back(i * PIXEL_TRANSFORM_CELL_SIZE);
+                    y.push_back(j * PIXEL_TRANSFORM_CELL_SIZE);
+                }
+            }
+        }
+        centres.push_back(x.size());
+        x.push_back((cells[c] + 0.5) * PIXEL_TRANSFORM_CELL_SIZE);
+        y.push_back((cells[c + 1] + 0.5) * PIXEL_TRANSFORM_CELL_SIZE);
+    }
+
+    std::vector<double> output_x, output_y;
+    _transform->Convert(x, y, output_x, output_y);
+
+    // Nodes are the points which are not centres, in order
+    size_t node(0);
+    for (size_t point = 0; point < x.size(); ++point) {
+        if (!std::binary_search(centres.begin(), centres.end(), point)) {
+            _nodes[new_nodes[node++]] = std::make_pair(output_x[point], output_y[point]);
+        }
+    }
+
+    for (size_t c = 0; c < cells.size(); c += 2) {
+        int64_t cell_x(cells[c]), cell_y(cells[c + 1]);
+        double centre_x = output_x[centres[c / 2]];
+        double centre_y = output_y[centres[c / 2]];
+
+        // Interpolated centre is the mean of the corners
+        double mean_x(0), mean_y(0);
+        for (int64_t j = cell_y; j <= cell_y + 1; ++j) {
+            for (int64_t i = cell_x; i <= cell_x + 1; ++i) {
+                const auto& corner = _nodes[Key(i, j)];
+                mean_x += corner.first / 4;
+                mean_y += corner.second / 4;
+            }
+        }
+        bool interpolate = std::isfinite(mean_x) && std::isfinite(mean_y) && std::isfinite(centre_x) && std::isfinite(centre_y) &&
+                           (std::hypot(mean_x - centre_x, mean_y - centre_y) <= PIXEL_TRANSFORM_TOLERANCE);
+        _cells[Key(cell_x, cell_y)] = interpolate;
+    }
+}
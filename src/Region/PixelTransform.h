@@ -0,0 +1,76 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PixelTransform.h: conversion of many pixel positions between the coordinate systems of two images
+
+#ifndef CARTA_BACKEND_REGION_PIXELTRANSFORM_H_
+#define CARTA_BACKEND_REGION_PIXELTRANSFORM_H_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <casacore/coordinates/Coordinates/CoordinateSystem.h>
+#include <casacore/measures/Measures/MCDirection.h>
+
+// Size in reference pixels of the interpolation grid cells, and the largest error in output pixels at a cell centre for the cell
+// to be interpolated
+#define PIXEL_TRANSFORM_CELL_SIZE 32
+#define PIXEL_TRANSFORM_TOLERANCE 0.01
+
+namespace carta {
+
+// Reference image pixel to output image pixel through world coordinates, for both direction or both linear coordinate systems. Points
+// are converted together, with one direction conversion for all of them.
+class PixelTransform {
+public:
+    PixelTransform(const casacore::CoordinateSystem& reference_csys, const casacore::CoordinateSystem& output_csys);
+
+    // Whether this transform is for these coordinate systems
+    bool Matches(const casacore::CoordinateSystem& reference_csys, const casacore::CoordinateSystem& output_csys) const;
+
+    // Output pixels are NaN where a point fails; returns false if any point fails
+    bool Convert(const std::vector<double>& x, const std::vector<double>& y, std::vector<double>& output_x, std::vector<double>& output_y);
+
+private:
+    casacore::CoordinateSystem _reference_csys;
+    casacore::CoordinateSystem _output_csys;
+    bool _direction, _linear;
+    casacore::MDirection::Types _reference_type;
+    std::unique_ptr<casacore::MDirection::Convert> _direction_converter; // null for the same frame
+};
+
+// Bilinear interpolation of a PixelTransform in grid cells, for approximate region matching. Grid nodes are converted when a point
+// first falls in their cell, and cells where interpolation at the centre is not within tolerance are converted exactly.
+class PixelTransformGrid {
+public:
+    explicit PixelTransformGrid(std::unique_ptr<PixelTransform> transform);
+
+    bool Matches(const casacore::CoordinateSystem& reference_csys, const casacore::CoordinateSystem& output_csys) const {
+        return _transform->Matches(reference_csys, output_csys);
+    }
+    // For exact conversions
+    PixelTransform& Transform() {
+        return *_transform;
+    }
+
+    bool Convert(const std::vector<double>& x, const std::vector<double>& y, std::vector<double>& output_x, std::vector<double>& output_y);
+
+private:
+    static int64_t Key(int64_t i, int64_t j) {
+        return (int64_t)(((uint64_t)i << 32) ^ ((uint64_t)j & 0xffffffff));
+    }
+    void AddCells(const std::vector<int64_t>& cells);
+
+    std::unique_ptr<PixelTransform> _transform;
+    std::unordered_map<int64_t, std::pair<double, double>> _nodes; // output pixel of grid node
+    std::unordered_map<int64_t, bool> _cells;                     // whether the cell is interpolated
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_REGION_PIXELTRANSFORM_H_
@@ -19,7 +19,6 @@
 #include <casacore/images/Regions/WCPolygon.h>
 #include <casacore/lattices/LRegions/LCBox.h>
 #include <casacore/lattices/LRegions/LCEllipsoid.h>
-#include <casacore/lattices/LRegions/LCExtension.h>
 #include <casacore/lattices/LRegions/LCPolygon.h>
 #include <casacore/measures/Measures/MCDirection.h>
 
@@ -69,6 +68,7 @@ void Region::ResetRegionCache() {
     _reference_region.reset();
     _applied_regions.clear();
     _polygon_regions.clear();
+    _region_spans.clear();
 }
 
 // *************************************************************************
@@ -95,6 +95,14 @@ bool Region::CheckPoints(const std::vector<CARTA::Point>& points, CARTA::RegionT
             points_ok = (npoints > 2) && PointsFinite(points);
             break;
         }
+        case CARTA::LINE: { // [(x1, y1), (x2, y2)]
+            points_ok = (npoints == 2) && PointsFinite(points);
+            break;
+        }
+        case CARTA::POLYLINE: { // any number of (x, y) greater than 1
+            points_ok = (npoints > 1) && PointsFinite(points);
+            break;
+        }
         default:
             break;
     }
@@ -117,14 +125,18 @@ bool Region::PointsFinite(const std::vector<CARTA::Point>& points) {
 // Region connection state (disconnected when region closed)
 
 bool Region::IsConnected() {
-    return _connected;
+    return !_cancellation.Current().IsCancelled();
 }
 
 void Region::WaitForTaskCancellation() { // to interrupt the running jobs in the Region
-    _connected = false;
+    _cancellation.CancelCurrent();
     std::unique_lock lock(GetActiveTaskMutex());
 }
 
+void Region::ConnectCalled() {
+    _cancellation.Replace();
+}
+
 // ******************************************************************************************
 // Apply region to reference image in world coordinates (WCRegion) and save wcs control points
 
@@ -355,7 +367,7 @@ casacore::LCRegion* Region::GetImageRegion(
             // Convert reference WCRegion to LCRegion and cache it
             lc_region = GetConvertedLCRegion(file_id, output_csys, output_shape);
         } else {
-            bool use_polygon = UseApproximatePolygon(output_csys); // check region distortion
+            bool use_polygon = UseApproximatePolygon(file_id, output_csys); // check region distortion
 
             if (!use_polygon) {
                 // No distortion, do direct region conversion if possible.
@@ -383,7 +395,7 @@ casacore::LCRegion* Region::GetImageRegion(
     return lc_region;
 }
 
-bool Region::UseApproximatePolygon(const casacore::CoordinateSystem& output_csys) {
+bool Region::UseApproximatePolygon(int file_id, const casacore::CoordinateSystem& output_csys) {
     // Determine whether to convert region directly, or approximate it as a polygon in the output image.
     CARTA::RegionType region_type = _region_state.type;
 
@@ -416,7 +428,7 @@ bool Region::UseApproximatePolygon(const casacore::CoordinateSystem& output_csys
 
             // convert points to output image pixels
             casacore::Vector<casacore::Double> x, y;
-            if (ConvertPolygonToImage(points, output_csys, x, y)) {
+            if (ConvertPolygonToImage(file_id, points, output_csys, x, y)) {
                 // vector0 is (center, p0), vector1 is (center, p1)
                 auto v0_delta_x = x[0] - x[4];
                 auto v0_delta_y = y[0] - y[4];
@@ -504,7 +516,7 @@ casacore::LCRegion* Region::GetAppliedPolygonRegion(
     }
 
     casacore::Vector<casacore::Double> x, y;
-    if (ConvertPolygonToImage(polygon_points, output_csys, x, y)) {
+    if (ConvertPolygonToImage(file_id, polygon_points, output_csys, x, y, !is_point)) {
         try {
             if (is_point) {
                 // Point is not a polygon (needs at least 3 points), use LCBox instead
@@ -662,36 +674,35 @@ double Region::GetTotalSegmentLength(std::vector<CARTA::Point>& points) {
     return total_length;
 }
 
-bool Region::ConvertPolygonToImage(const std::vector<CARTA::Point>& polygon_points, const casacore::CoordinateSystem& output_csys,
-    casacore::Vector<casacore::Double>& x, casacore::Vector<casacore::Double>& y) {
+bool Region::ConvertPolygonToImage(int file_id, const std::vector<CARTA::Point>& polygon_points,
+    const casacore::CoordinateSystem& output_csys, casacore::Vector<casacore::Double>& x, casacore::Vector<casacore::Double>& y,
+    bool interpolate) {
     // Convert polygon_points (pixel coords in reference image) to pixel coords in output image
     // Coordinates returned in x and y vectors for LCPolygon
-    bool converted(true);
+    bool converted(false);
 
     try {
-        // Convert each polygon pixel point to output csys pixel point
         size_t polygon_npoints(polygon_points.size());
-        x.resize(polygon_npoints);
-        y.resize(polygon_npoints);
-        for (auto i = 0; i < polygon_npoints; ++i) {
-            // Convert pixel to world in reference csys
-            std::vector<casacore::Quantity> world_point; // [x, y]
-            if (ConvertCartaPointToWorld(polygon_points[i], world_point)) {
-                // Convert reference world to output csys pixel
-                casacore::Vector<casacore::Double> pixel_point; // [x, y]
-                if (ConvertWorldToPixel(world_point, output_csys, pixel_point)) {
-                    x(i) = pixel_point(0);
-                    y(i) = pixel_point(1);
-                } else { // world to pixel failed
-                    spdlog::error("Error converting polygon to output pixel coords.");
-                    converted = false;
-                    break;
-                }
-            } else { // pixel to world failed
-                spdlog::error("Error converting polygon to reference world coords.");
-                converted = false;
-                break;
-            }
+        std::vector<double> reference_x(polygon_npoints), reference_y(polygon_npoints), output_x, output_y;
+        for (size_t i = 0; i < polygon_npoints; ++i) {
+            reference_x[i] = polygon_points[i].x();
+            reference_y[i] = polygon_points[i].y();
+        }
+
+        PixelTransformGrid* grid = GetTransformGrid(file_id, output_csys);
+        if (grid) {
+            converted = interpolate ? grid->Convert(reference_x, reference_y, output_x, output_y)
+                                    : grid->Transform().Convert(reference_x, reference_y, output_x, output_y);
+        } else {
+            PixelTransform transform(*_coord_sys, output_csys);
+            converted = transform.Convert(reference_x, reference_y, output_x, output_y);
+        }
+
+        if (converted) {
+            x = casacore::Vector<casacore::Double>(output_x);
+            y = casacore::Vector<casacore::Double>(output_y);
+        } else {
+            spdlog::error("Error converting polygon to output pixel coords.");
         }
     } catch (const casacore::AipsError& err) {
         spdlog::error("Error converting polygon to image: {}", err.getMesg());
@@ -701,40 +712,77 @@ bool Region::ConvertPolygonToImage(const std::vector<CARTA::Point>& polygon_poin
     return converted;
 }
 
-casacore::ArrayLattice<casacore::Bool> Region::GetImageRegionMask(int file_id) {
+PixelTransformGrid* Region::GetTransformGrid(int file_id, const casacore::CoordinateSystem& output_csys) {
+    // Cached transform for the image; called with the approximation lock held. Replaced if the file id is used for another image.
+    if (file_id < 0) {
+        return nullptr;
+    }
+    auto& grid = _transform_grids[file_id];
+    if (!grid || !grid->Matches(*_coord_sys, output_csys)) {
+        grid = std::make_unique<PixelTransformGrid>(std::make_unique<PixelTransform>(*_coord_sys, output_csys));
+    }
+    return grid.get();
+}
+
+bool Region::GetImagePath(int file_id, const casacore::CoordinateSystem& image_csys, std::vector<PointXy>& path) {
+    // Vertices of a line or polyline in image pixel coords, converted together like polygon vertices for other images
+    auto type(_region_state.type);
+    if ((type != CARTA::RegionType::LINE) && (type != CARTA::RegionType::POLYLINE)) {
+        return false;
+    }
+
+    path.clear();
+    if (file_id == _region_state.reference_file_id) {
+        for (auto& point : _region_state.control_points) {
+            path.emplace_back(point.x(), point.y());
+        }
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(_region_approx_mutex);
+    casacore::Vector<casacore::Double> x, y;
+    if (!ConvertPolygonToImage(file_id, _region_state.control_points, image_csys, x, y)) {
+        return false;
+    }
+    for (size_t i = 0; i < x.size(); ++i) {
+        path.emplace_back(x(i), y(i));
+    }
+    return true;
+}
+
+BitMask Region::GetImageRegionMask(int file_id) {
     // Return pixel mask for this region; requires that lcregion for this file id has been set.
-    // Otherwise mask is empty array.
-    casacore::ArrayLattice<casacore::Bool> mask;
-    casacore::LCRegion* lcregion(nullptr);
+    // Otherwise mask is empty.
+    BitMask mask;
+    auto spans = GetImageRegionSpans(file_id);
+    if (spans) {
+        mask = spans->PixelMask();
+    }
+    return mask;
+}
+
+std::shared_ptr<const RegionSpans> Region::GetImageRegionSpans(int file_id) {
+    // Rasterise the region converted to the image once, rather than make a casacore mask for each use
+    std::lock_guard<std::mutex> guard(_region_mutex);
+    if (_region_spans.count(file_id)) {
+        return _region_spans.at(file_id);
+    }
 
+    std::shared_ptr<casacore::LCRegion> lcregion;
     if ((file_id == _region_state.reference_file_id) && _applied_regions.count(file_id)) {
-        if (_applied_regions.at(file_id)) {
-            std::lock_guard<std::mutex> guard(_region_mutex);
-            lcregion = _applied_regions.at(file_id)->cloneRegion();
-        }
+        lcregion = _applied_regions.at(file_id);
     } else if (_polygon_regions.count(file_id)) {
-        if (_polygon_regions.at(file_id)) {
-            std::lock_guard<std::mutex> guard(_region_mutex);
-            lcregion = _polygon_regions.at(file_id)->cloneRegion();
-        }
+        lcregion = _polygon_regions.at(file_id);
     }
 
+    std::shared_ptr<const RegionSpans> spans;
     if (lcregion) {
-        std::lock_guard<std::mutex> guard(_region_mutex);
-        // Region can either be an extension region or a fixed region, depending on whether image is matched or not
-        auto extended_region = dynamic_cast<casacore::LCExtension*>(lcregion);
-        if (extended_region) {
-            auto& fixed_region = static_cast<const casacore::LCRegionFixed&>(extended_region->region());
-            mask = fixed_region.getMask();
-        } else {
-            auto fixed_region = dynamic_cast<casacore::LCRegionFixed*>(lcregion);
-            if (fixed_region) {
-                mask = fixed_region->getMask();
-            }
+        spans = RegionSpans::FromLCRegion(*lcregion);
+        if (spans) {
+            _region_spans[file_id] = spans;
         }
     }
-
-    return mask;
+    return spans;
 }
 
 // ***************************************************************
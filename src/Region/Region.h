@@ -24,6 +24,11 @@
 #include <carta-protobuf/defs.pb.h>
 #include <carta-protobuf/enums.pb.h>
 
+#include "../Cancellation.h"
+#include "../Util.h"
+#include "PixelTransform.h"
+#include "RegionSpans.h"
+
 struct RegionState {
     // struct used for region parameters
     int reference_file_id;
@@ -103,10 +108,16 @@ public:
     // Communication
     bool IsConnected();
     void WaitForTaskCancellation();
+    void ConnectCalled(); // after cancelled tasks finished
 
     // Converted region as approximate LCPolygon and its mask
     casacore::LCRegion* GetImageRegion(int file_id, const casacore::CoordinateSystem& image_csys, const casacore::IPosition& image_shape);
-    casacore::ArrayLattice<casacore::Bool> GetImageRegionMask(int file_id);
+    BitMask GetImageRegionMask(int file_id);
+    // Pixels of the 2D region as row spans, cached until the region changes; requires that lcregion for this file id has been set
+    std::shared_ptr<const RegionSpans> GetImageRegionSpans(int file_id);
+
+    // Vertices of a line or polyline region in pixel coords of the image; false for other region types
+    bool GetImagePath(int file_id, const casacore::CoordinateSystem& image_csys, std::vector<PointXy>& path);
 
     // Converted region in Record for export
     casacore::TableRecord GetImageRegionRecord(
@@ -135,7 +146,7 @@ private:
     bool EllipsePointsToWorld(std::vector<CARTA::Point>& pixel_points, std::vector<casacore::Quantity>& wcs_points, float& rotation);
 
     // Reference region as approximate polygon converted to image coordinates; used for data streams
-    bool UseApproximatePolygon(const casacore::CoordinateSystem& output_csys);
+    bool UseApproximatePolygon(int file_id, const casacore::CoordinateSystem& output_csys);
     std::vector<CARTA::Point> GetRectangleMidpoints();
     casacore::LCRegion* GetCachedPolygonRegion(int file_id);
     casacore::LCRegion* GetAppliedPolygonRegion(
@@ -144,8 +155,10 @@ private:
     std::vector<CARTA::Point> GetApproximatePolygonPoints(int num_vertices);
     std::vector<CARTA::Point> GetApproximateEllipsePoints(int num_vertices);
     double GetTotalSegmentLength(std::vector<CARTA::Point>& points);
-    bool ConvertPolygonToImage(const std::vector<CARTA::Point>& polygon_points, const casacore::CoordinateSystem& output_csys,
-        casacore::Vector<casacore::Double>& x, casacore::Vector<casacore::Double>& y);
+    // Reference pixel points converted together to the output image; interpolated in the cached grid for the polygon approximation
+    bool ConvertPolygonToImage(int file_id, const std::vector<CARTA::Point>& polygon_points, const casacore::CoordinateSystem& output_csys,
+        casacore::Vector<casacore::Double>& x, casacore::Vector<casacore::Double>& y, bool interpolate = false);
+    PixelTransformGrid* GetTransformGrid(int file_id, const casacore::CoordinateSystem& output_csys);
 
     // Region applied to any image; used for export
     casacore::LCRegion* GetCachedLCRegion(int file_id);
@@ -191,14 +204,18 @@ private:
     std::unordered_map<int, std::shared_ptr<casacore::LCRegion>> _applied_regions;
     // Polygon approximation region converted to image; key is file_id
     std::unordered_map<int, std::shared_ptr<casacore::LCRegion>> _polygon_regions;
+    // Pixels of the applied or polygon region; key is file_id
+    std::unordered_map<int, std::shared_ptr<const RegionSpans>> _region_spans;
+    // Reference to image pixel transform, which does not change with the region; key is file_id
+    std::unordered_map<int, std::unique_ptr<PixelTransformGrid>> _transform_grids;
 
     // region flags
     bool _valid;                // RegionState set properly
     bool _region_changed;       // control points or rotation changed
     bool _reference_region_set; // indicates attempt was made; may be null wcregion outside image
 
-    // Communication
-    volatile bool _connected = true;
+    // Communication: cancelled while the region is changed or closed
+    CancellationSlot _cancellation;
 };
 
 } // namespace carta
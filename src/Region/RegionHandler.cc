@@ -8,8 +8,10 @@
 
 #include "RegionHandler.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <limits>
 
 #include <casacore/lattices/LRegions/LCBox.h>
 #include <casacore/lattices/LRegions/LCExtension.h>
@@ -18,12 +20,16 @@
 #include "../Constants.h"
 #include "../ImageStats/StatsCalculator.h"
 #include "../Logger/Logger.h"
+#include "../Threading.h"
+#include "../Timer/LatencyHistogram.h"
 #include "../Util.h"
 #include "CrtfImportExport.h"
 #include "Ds9ImportExport.h"
 
 namespace carta {
 
+int64_t RegionHandler::_approximate_spectral_threshold = -1;
+
 // ********************************************************************
 // Region handling
 
@@ -44,7 +50,15 @@ bool RegionHandler::SetRegion(int& region_id, RegionState& region_state, casacor
     // Set region params for region id; if id < 0, create new id
     bool valid_region(false);
     if (_regions.count(region_id)) {
+        // Stop jobs for the previous region state, and wait for them to finish, before changing it
+        bool cancel_tasks = _regions.at(region_id)->GetRegionState().RegionChanged(region_state);
+        if (cancel_tasks) {
+            _regions.at(region_id)->WaitForTaskCancellation();
+        }
         _regions.at(region_id)->UpdateRegion(region_state);
+        if (cancel_tasks) {
+            _regions.at(region_id)->ConnectCalled();
+        }
         valid_region = _regions.at(region_id)->IsValid();
         if (_regions.at(region_id)->RegionChanged()) {
             UpdateNewSpectralRequirements(region_id); // set all req "new"
@@ -92,6 +106,14 @@ std::shared_ptr<Region> RegionHandler::GetRegion(int region_id) {
     return _regions.at(region_id);
 }
 
+std::unordered_map<int, RegionState> RegionHandler::GetRegionStates() {
+    std::unordered_map<int, RegionState> region_states;
+    for (auto& region : _regions) {
+        region_states[region.first] = region.second->GetRegionState();
+    }
+    return region_states;
+}
+
 bool RegionHandler::RegionSet(int region_id) {
     // Check whether a particular region is set or any regions are set
     if (region_id == ALL_REGIONS) {
@@ -139,16 +161,33 @@ void RegionHandler::ImportRegion(int file_id, std::shared_ptr<Frame> frame, CART
     // Set reference file pointer
     _frames[file_id] = frame;
 
-    // Set Regions from RegionState list and complete message
+    // Create Regions from RegionState list; each region owns a copy of the image coordinate system, cloned in parallel from one
+    // copy rather than taking the image lock for each region
+    std::vector<std::shared_ptr<Region>> regions(region_list.size());
+    casacore::CoordinateSystem* image_csys = frame->CoordinateSystem();
+    int64_t num_regions = region_list.size();
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t i = 0; i < num_regions; ++i) {
+        casacore::CoordinateSystem* region_csys(nullptr);
+        if (image_csys) {
+            region_csys = static_cast<casacore::CoordinateSystem*>(image_csys->clone());
+        }
+        regions[i] = std::shared_ptr<Region>(new Region(region_list[i].state, region_csys));
+    }
+    delete image_csys;
+
+    // Set Regions in file order and complete message
     import_ack.set_success(true);
     import_ack.set_message(error);
     int region_id = GetNextRegionId();
     auto region_info_map = import_ack.mutable_regions();
     auto region_style_map = import_ack.mutable_region_styles();
-    for (auto& imported_region : region_list) {
-        auto region_csys = frame->CoordinateSystem();
-        auto region_state = imported_region.state;
-        auto region = std::shared_ptr<Region>(new Region(region_state, region_csys));
+    _regions.reserve(_regions.size() + region_list.size());
+    for (size_t i = 0; i < region_list.size(); ++i) {
+        auto& imported_region = region_list[i];
+        auto& region_state = imported_region.state;
+        auto& region = regions[i];
 
         if (region && region->IsValid()) {
             _regions[region_id] = std::move(region);
@@ -667,19 +706,27 @@ casacore::LCRegion* RegionHandler::ApplyRegionToFile(int region_id, int file_id)
 
 bool RegionHandler::ApplyRegionToFile(int region_id, int file_id, const AxisRange& z_range, int stokes, casacore::ImageRegion& region) {
     // Returns 3D or 4D image region for region applied to image and extended by z-range and stokes
-    if (!RegionSet(region_id) || !FrameSet(file_id)) {
+    if (!FrameSet(file_id)) {
+        return false;
+    }
+    return ApplyRegionToFrame(region_id, file_id, _frames.at(file_id), z_range, stokes, region);
+}
+
+bool RegionHandler::ApplyRegionToFrame(int region_id, int file_id, const std::shared_ptr<Frame>& frame, const AxisRange& z_range,
+    int stokes, casacore::ImageRegion& region) {
+    if (!RegionSet(region_id) || !frame) {
         return false;
     }
 
     try {
-        casacore::LCRegion* applied_region = ApplyRegionToFile(region_id, file_id);
+        casacore::LCRegion* applied_region = frame->GetImageRegion(file_id, _regions.at(region_id));
         if (applied_region == nullptr) {
             return false;
         }
 
         // Create LCBox with z range and stokes using a slicer
-        casacore::Slicer z_stokes_slicer = _frames.at(file_id)->GetImageSlicer(z_range, stokes);
-        casacore::IPosition image_shape(_frames.at(file_id)->ImageShape());
+        casacore::Slicer z_stokes_slicer = frame->GetImageSlicer(z_range, stokes);
+        casacore::IPosition image_shape(frame->ImageShape());
         casacore::LCBox z_stokes_box(z_stokes_slicer, image_shape);
 
         // Set returned region
@@ -712,6 +759,20 @@ bool RegionHandler::ApplyRegionToFile(int region_id, int file_id, const AxisRang
     return false;
 }
 
+bool RegionHandler::GetRegionPath(int region_id, int file_id, const std::shared_ptr<Frame>& frame, std::vector<PointXy>& path) {
+    if (!RegionSet(region_id) || !frame) {
+        return false;
+    }
+
+    std::unique_ptr<casacore::CoordinateSystem> csys(frame->CoordinateSystem());
+    try {
+        return csys && _regions.at(region_id)->GetImagePath(file_id, *csys, path);
+    } catch (std::out_of_range& range_error) {
+        spdlog::error("Cannot apply region {} to closed file {}", region_id, file_id);
+    }
+    return false;
+}
+
 bool RegionHandler::CalculateMoments(int file_id, int region_id, const std::shared_ptr<Frame>& frame,
     MomentProgressCallback progress_callback, const CARTA::MomentRequest& moment_request, CARTA::MomentResponse& moment_response,
     std::vector<carta::CollapseResult>& collapse_results) {
@@ -737,6 +798,46 @@ bool RegionHandler::CalculateMoments(int file_id, int region_id, const std::shar
 
 // ***** Fill histogram *****
 
+// Region pixels of the innermost RegionDataScope alive on this thread
+static thread_local std::unordered_map<CacheId, std::shared_ptr<const RegionPixels>, CacheIdHash>* scope_region_pixels = nullptr;
+
+RegionHandler::RegionDataScope::RegionDataScope() : _active(scope_region_pixels == nullptr) {
+    // Nested scopes share the outer scope
+    if (_active) {
+        scope_region_pixels = &_pixels;
+    }
+}
+
+RegionHandler::RegionDataScope::~RegionDataScope() {
+    if (_active) {
+        scope_region_pixels = nullptr;
+    }
+}
+
+std::shared_ptr<const RegionPixels> RegionHandler::GetRegionPixels(
+    int region_id, int file_id, int z, int stokes, const casacore::ImageRegion& region) {
+    // Pixels read earlier in the scope are used while the region is unchanged
+    RegionState region_state = _regions.at(region_id)->GetRegionState();
+    CacheId cache_id(file_id, region_id, stokes, z);
+    if (scope_region_pixels && scope_region_pixels->count(cache_id)) {
+        auto pixels = scope_region_pixels->at(cache_id);
+        if (region_state == pixels->region_state) {
+            return pixels;
+        }
+    }
+
+    auto pixels = std::make_shared<RegionPixels>();
+    pixels->region_state = region_state;
+    auto spans = _regions.at(region_id)->GetImageRegionSpans(file_id);
+    if (!_frames.at(file_id)->GetRegionPixels(region, spans.get(), z, stokes, pixels->data, pixels->shape, pixels->blc)) {
+        return nullptr;
+    }
+    if (scope_region_pixels) {
+        (*scope_region_pixels)[cache_id] = pixels;
+    }
+    return pixels;
+}
+
 bool RegionHandler::FillRegionHistogramData(std::function<void(CARTA::RegionHistogramData histogram_data)> cb, int region_id, int file_id) {
     // Fill histogram data for given region and file
     if (!RegionFileIdsValid(region_id, file_id)) {
@@ -824,11 +925,10 @@ bool RegionHandler::GetRegionHistogramData(
     }
 
     // Flags for calculations
-    bool have_region_data(false);
     bool have_basic_stats(false);
 
     // Reuse data and stats for each histogram; results depend on num_bins
-    std::vector<float> data;
+    std::shared_ptr<const RegionPixels> pixels;
     BasicStats<float> stats;
 
     // Key for cache
@@ -864,22 +964,22 @@ bool RegionHandler::GetRegionHistogramData(
 
         // Calculate stats and/or histograms, not in cache
         // Get data in region
-        if (!have_region_data) {
-            have_region_data = _frames.at(file_id)->GetRegionData(region, data);
-            if (!have_region_data) {
+        if (!pixels) {
+            pixels = GetRegionPixels(region_id, file_id, z, stokes, region);
+            if (!pixels) {
                 return false;
             }
         }
 
-        // Calculate and cache stats
-        if (!have_basic_stats) {
-            CalcBasicStats(data, stats);
+        // Calculate and cache histogram for number of bins, and stats in the same pass if not cached
+        Histogram histo;
+        if (have_basic_stats) {
+            histo = CalcHistogram(num_bins, stats, pixels->data);
+        } else {
+            CalcStatsAndHistogram(pixels->data, num_bins, stats, histo);
             _histogram_cache[cache_id].SetBasicStats(stats);
             have_basic_stats = true;
         }
-
-        // Calculate and cache histogram for number of bins
-        Histogram histo = CalcHistogram(num_bins, stats, data);
         _histogram_cache[cache_id].SetHistogram(num_bins, histo);
 
         // Complete Histogram submessage
@@ -916,6 +1016,7 @@ bool RegionHandler::FillSpectralProfileData(
     ulock.unlock();
 
     bool profile_ok(false);
+    std::vector<SpectralProfileJob> profile_jobs;
     // Fill spectral profile for region with file requirement
     for (auto& region_config : region_configs) {
         if (region_config.second.configs.empty()) {
@@ -964,24 +1065,367 @@ bool RegionHandler::FillSpectralProfileData(
                     stokes_index = _frames.at(config_file_id)->CurrentStokes();
                 }
 
-                // Return spectral profile for this requirement
-                profile_ok = GetRegionSpectralData(config_region_id, config_file_id, coordinate, stokes_index, required_stats,
-                    [&](std::map<CARTA::StatsType, std::vector<double>> results, float progress) {
-                        CARTA::SpectralProfileData profile_message;
-                        profile_message.set_file_id(config_file_id);
-                        profile_message.set_region_id(config_region_id);
-                        profile_message.set_stokes(stokes_index);
-                        profile_message.set_progress(progress);
-                        FillSpectralProfileDataMessage(profile_message, coordinate, required_stats, results);
-                        cb(profile_message); // send (partial profile) data
-                    });
+                profile_jobs.push_back({config_region_id, config_file_id, coordinate, stokes_index, required_stats});
+            }
+        }
+    }
+
+    auto send_profile = [&](SpectralProfileJob& job, std::map<CARTA::StatsType, std::vector<double>>& results, float progress) {
+        CARTA::SpectralProfileData profile_message;
+        profile_message.set_file_id(job.file_id);
+        profile_message.set_region_id(job.region_id);
+        profile_message.set_stokes(job.stokes_index);
+        profile_message.set_progress(progress);
+        FillSpectralProfileDataMessage(profile_message, job.coordinate, job.required_stats, results);
+        cb(profile_message); // send (partial profile) data
+    };
+
+    // Profiles for all regions of a file can be calculated together, reading the image once
+    if ((region_id == ALL_REGIONS) && (file_id != ALL_FILES)) {
+        profile_ok |= GetBatchedRegionSpectralData(profile_jobs, send_profile);
+    }
+
+    // Return spectral profile for each remaining requirement
+    for (auto& job : profile_jobs) {
+        if (!job.done) {
+            profile_ok = GetRegionSpectralData(job.region_id, job.file_id, job.coordinate, job.stokes_index, job.required_stats,
+                [&](std::map<CARTA::StatsType, std::vector<double>> results, float progress) { send_profile(job, results, progress); });
+        }
+    }
+
+    return profile_ok;
+}
+
+bool RegionHandler::GetBatchedRegionSpectralData(std::vector<SpectralProfileJob>& jobs,
+    const std::function<void(SpectralProfileJob&, std::map<CARTA::StatsType, std::vector<double>>&, float)>& results_callback) {
+    // Calculate the profiles of regions with the same file and stokes from one read of each block of channels over their combined
+    // bounding box. Profiles which are cached, use loader spectral data or can be updated from a previous mask are left for
+    // GetRegionSpectralData.
+    struct BatchRegion {
+        SpectralProfileJob* job;
+        RegionState region_state;
+        std::shared_ptr<const RegionSpans> spans;
+        std::map<CARTA::StatsType, std::vector<double>> results, cache_results;
+    };
+
+    std::vector<CARTA::StatsType> profile_stats(_spectral_stats);
+    profile_stats.push_back(CARTA::StatsType::NumPixels);
+    std::map<int, std::vector<BatchRegion>> stokes_batches;
+    for (auto& job : jobs) {
+        if (!RegionFileIdsValid(job.region_id, job.file_id) || !_frames.at(job.file_id)->UseMaskedRegionStats(_spectral_stats)) {
+            continue;
+        }
+        CacheId cache_id(job.file_id, job.region_id, job.stokes_index);
+        if (_spectral_cache.count(cache_id) && (!_spectral_cache[cache_id].profiles.empty() || _spectral_cache[cache_id].sums.IsValid())) {
+            continue;
+        }
+        casacore::LCRegion* lcregion = ApplyRegionToFile(job.region_id, job.file_id);
+        if (!lcregion || _frames.at(job.file_id)->UseLoaderSpectralData(lcregion->shape(), job.stokes_index)) {
+            continue;
+        }
+        auto spans = _regions.at(job.region_id)->GetImageRegionSpans(job.file_id);
+        if (!spans) {
+            continue;
+        }
+
+        BatchRegion region;
+        region.job = &job;
+        region.region_state = _regions.at(job.region_id)->GetRegionState();
+        region.spans = spans;
+        stokes_batches[job.stokes_index].push_back(std::move(region));
+    }
+
+    bool profile_ok(false);
+    for (auto& stokes_batch : stokes_batches) {
+        int stokes_index = stokes_batch.first;
+        auto& batch = stokes_batch.second;
+        if (batch.size() < SPECTRAL_BATCH_MIN_REGIONS) {
+            continue;
+        }
+
+        auto t_start_spectral_profile = std::chrono::high_resolution_clock::now();
+        int file_id = batch[0].job->file_id;
+        auto& frame = _frames.at(file_id);
+        std::shared_lock frame_lock(frame->GetActiveTaskMutex());
+        std::vector<std::shared_lock<std::shared_mutex>> region_locks;
+
+        // Combined bounding box of the regions
+        size_t profile_size = frame->Depth();
+        std::vector<double> init_spectral(profile_size, nan(""));
+        int x_min(std::numeric_limits<int>::max()), y_min(std::numeric_limits<int>::max()), x_max(0), y_max(0);
+        for (auto& region : batch) {
+            region_locks.emplace_back(_regions.at(region.job->region_id)->GetActiveTaskMutex());
+            x_min = std::min(x_min, region.spans->X());
+            y_min = std::min(y_min, region.spans->Y());
+            x_max = std::max(x_max, region.spans->X() + region.spans->Width() - 1);
+            y_max = std::max(y_max, region.spans->Y() + region.spans->Height() - 1);
+            for (const auto& stat : region.job->required_stats) {
+                region.results[stat] = init_spectral;
+            }
+            for (const auto& stat : profile_stats) {
+                region.cache_results[stat] = init_spectral;
+            }
+        }
+        AxisRange x_range(x_min, x_max), y_range(y_min, y_max);
+        size_t plane_size = (size_t)(x_max - x_min + 1) * (y_max - y_min + 1);
+        int block_depth = std::max((size_t)1, (size_t)REGION_SPECTRAL_BLOCK_MB * 1024 * 1024 / (plane_size * sizeof(float)));
+        double beam_area = frame->BeamArea();
+
+        // Regions are dropped from the batch (without results) when cancelled
+        auto cancelled = [&](BatchRegion& region) {
+            auto& job = *region.job;
+            return !RegionFileIdsValid(job.region_id, job.file_id) ||
+                   (_regions.at(job.region_id)->GetRegionState() != region.region_state) ||
+                   ((job.coordinate == "z") && (stokes_index != frame->CurrentStokes())) ||
+                   !HasSpectralRequirements(job.region_id, job.file_id, job.coordinate, job.required_stats);
+        };
+        std::vector<char> active(batch.size(), true);
+        for (auto& region : batch) {
+            region.job->done = true;
+        }
+
+        std::vector<float> data;
+        auto t_partial_profile_start = std::chrono::high_resolution_clock::now();
+        for (size_t block_start = 0; block_start < profile_size; block_start += block_depth) {
+            AxisRange z_range(block_start, std::min(block_start + block_depth, profile_size) - 1);
+            casacore::Slicer slicer = frame->GetImageSlicer(x_range, y_range, z_range, stokes_index);
+            if (!frame->GetSlicerData(slicer, data)) {
+                return profile_ok;
+            }
+
+            ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+            for (int64_t i = 0; i < (int64_t)batch.size(); ++i) {
+                if (!active[i]) {
+                    continue;
+                }
+                auto& region = batch[i];
+                std::map<CARTA::StatsType, std::vector<double>> partial_profiles;
+                if (!CalcMaskedStatsValues(
+                        partial_profiles, profile_stats, data, slicer.length(), slicer.start(), *region.spans, beam_area)) {
+                    active[i] = false;
+                    continue;
+                }
+                for (const auto& profile : partial_profiles) {
+                    if (region.results.count(profile.first)) {
+                        std::copy(profile.second.begin(), profile.second.end(), region.results[profile.first].begin() + z_range.from);
+                    }
+                    std::copy(profile.second.begin(), profile.second.end(), region.cache_results[profile.first].begin() + z_range.from);
+                }
+            }
+
+            float progress = (float)(z_range.to + 1) / profile_size;
+            auto t_end = std::chrono::high_resolution_clock::now();
+            auto dt_partial_profile = std::chrono::duration<double, std::milli>(t_end - t_partial_profile_start).count();
+            bool send_partial = (dt_partial_profile > TARGET_PARTIAL_REGION_TIME) || (progress >= PROFILE_COMPLETE);
+            if (send_partial) {
+                t_partial_profile_start = t_end;
+            }
+
+            bool any_active(false);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (active[i] && cancelled(batch[i])) {
+                    active[i] = false;
+                }
+                if (!active[i]) {
+                    continue;
+                }
+                any_active = true;
+                auto& region = batch[i];
+                if (send_partial) {
+                    results_callback(*region.job, region.results, progress);
+                }
+                if (progress >= PROFILE_COMPLETE) {
+                    // cache results for all stats types
+                    CacheId cache_id(file_id, region.job->region_id, stokes_index);
+                    _spectral_cache[cache_id] = SpectralCache(region.cache_results);
+                    SetSpectralSums(*region.spans, region.cache_results, _spectral_cache[cache_id].sums);
+                    profile_ok = true;
+                }
+            }
+            if (!any_active) {
+                break;
             }
         }
+
+        auto t_end_spectral_profile = std::chrono::high_resolution_clock::now();
+        auto dt_spectral_profile =
+            std::chrono::duration_cast<std::chrono::microseconds>(t_end_spectral_profile - t_start_spectral_profile).count();
+        carta::LatencyHistograms::Record(carta::LatencyPoint::SpectralProfile, dt_spectral_profile);
+        spdlog::performance("Fill {} region spectral profiles in {:.3f} ms", batch.size(), dt_spectral_profile * 1e-3);
     }
 
     return profile_ok;
 }
 
+std::vector<size_t> RegionHandler::SpectralProfileOrder(size_t depth) {
+    std::vector<size_t> z_order;
+    z_order.reserve(depth);
+    if (depth < SPECTRAL_PROGRESSIVE_MIN_DEPTH) {
+        for (size_t z = 0; z < depth; ++z) {
+            z_order.push_back(z);
+        }
+        return z_order;
+    }
+
+    // Every stride-th channel first, then halve the stride and add the channels between those done
+    size_t stride(1);
+    while (depth / (2 * stride) >= SPECTRAL_PROGRESSIVE_FIRST_CHANNELS) {
+        stride *= 2;
+    }
+    for (size_t z = 0; z < depth; z += stride) {
+        z_order.push_back(z);
+    }
+    for (stride /= 2; stride >= 1; stride /= 2) {
+        for (size_t z = stride; z < depth; z += 2 * stride) {
+            z_order.push_back(z);
+        }
+    }
+    return z_order;
+}
+
+void RegionHandler::InterpolateProfileGaps(std::vector<double>& profile, const std::vector<bool>& done) {
+    // Linear interpolation between the nearest channels done, holding the edge values
+    int64_t previous(-1);
+    for (int64_t z = 0; z <= (int64_t)profile.size(); ++z) {
+        if (z < (int64_t)profile.size() && !done[z]) {
+            continue;
+        }
+        for (int64_t gap = previous + 1; gap < z; ++gap) {
+            if (previous < 0) {
+                profile[gap] = (z < (int64_t)profile.size()) ? profile[z] : profile[gap];
+            } else if (z == (int64_t)profile.size()) {
+                profile[gap] = profile[previous];
+            } else {
+                double fraction = double(gap - previous) / (z - previous);
+                profile[gap] = profile[previous] + fraction * (profile[z] - profile[previous]);
+            }
+        }
+        previous = z;
+    }
+}
+
+void RegionHandler::SetSpectralSums(
+    const RegionSpans& spans, std::map<CARTA::StatsType, std::vector<double>>& profiles, SpectralSums& sums) {
+    // Keep the mask and the profiles needed for the sums; channels without valid pixels have NaN profiles
+    sums.x = spans.X();
+    sums.y = spans.Y();
+    sums.width = spans.Width();
+    sums.height = spans.Height();
+    sums.mask = spans.Mask();
+
+    size_t depth = profiles[CARTA::StatsType::NumPixels].size();
+    sums.num_pixels.resize(depth);
+    sums.sum.resize(depth);
+    sums.sum_sq.resize(depth);
+    sums.min.resize(depth);
+    sums.max.resize(depth);
+    for (size_t z = 0; z < depth; ++z) {
+        bool has_pixels = profiles[CARTA::StatsType::NumPixels][z] > 0;
+        sums.num_pixels[z] = has_pixels ? profiles[CARTA::StatsType::NumPixels][z] : 0;
+        sums.sum[z] = has_pixels ? profiles[CARTA::StatsType::Sum][z] : 0;
+        sums.sum_sq[z] = has_pixels ? profiles[CARTA::StatsType::SumSq][z] : 0;
+        sums.min[z] = has_pixels ? profiles[CARTA::StatsType::Min][z] : std::numeric_limits<float>::max();
+        sums.max[z] = has_pixels ? profiles[CARTA::StatsType::Max][z] : std::numeric_limits<float>::lowest();
+    }
+}
+
+bool RegionHandler::UpdateSpectralSums(int file_id, int stokes_index, const SpectralSums& previous, const RegionSpans& spans,
+    SpectralSums& sums, std::vector<bool>& z_valid) {
+    // Update the sums for the previous mask with the pixels that entered or left it; returns false if the change is too large.
+    // Min and max are not valid for channels where a value that left the mask was the previous min or max.
+    SpectralSums current;
+    current.x = spans.X();
+    current.y = spans.Y();
+    current.width = spans.Width();
+    current.height = spans.Height();
+    current.mask = spans.Mask();
+
+    // Bounding boxes of the pixels that entered and left the mask
+    int x_start = std::min(previous.x, current.x);
+    int x_end = std::max(previous.x + previous.width, current.x + current.width);
+    int y_start = std::min(previous.y, current.y);
+    int y_end = std::max(previous.y + previous.height, current.y + current.height);
+    int entered_box[4] = {x_end, y_end, x_start - 1, y_start - 1}; // blc, trc
+    int left_box[4] = {x_end, y_end, x_start - 1, y_start - 1};
+    auto extend_box = [](int* box, int x, int y) {
+        box[0] = std::min(box[0], x);
+        box[1] = std::min(box[1], y);
+        box[2] = std::max(box[2], x);
+        box[3] = std::max(box[3], y);
+    };
+    for (int y = y_start; y < y_end; ++y) {
+        for (int x = x_start; x < x_end; ++x) {
+            bool in_previous = previous.InMask(x, y);
+            bool in_current = current.InMask(x, y);
+            if (in_current && !in_previous) {
+                extend_box(entered_box, x, y);
+            } else if (in_previous && !in_current) {
+                extend_box(left_box, x, y);
+            }
+        }
+    }
+
+    auto box_area = [](const int* box) {
+        return (box[2] < box[0]) ? (int64_t)0 : (int64_t)(box[2] - box[0] + 1) * (box[3] - box[1] + 1);
+    };
+    if (box_area(entered_box) + box_area(left_box) > SPECTRAL_INCREMENTAL_MAX_AREA * current.width * current.height) {
+        return false;
+    }
+
+    // Stats of the pixels in a box which are in one mask and not the other, for all channels
+    size_t depth = previous.num_pixels.size();
+    std::vector<CARTA::StatsType> sums_stats = {
+        CARTA::StatsType::NumPixels, CARTA::StatsType::Sum, CARTA::StatsType::SumSq, CARTA::StatsType::Min, CARTA::StatsType::Max};
+    auto get_change_stats = [&](const int* box, const SpectralSums& in_mask, const SpectralSums& out_mask,
+                                std::map<CARTA::StatsType, std::vector<double>>& stats_values) {
+        if (box_area(box) == 0) {
+            return true;
+        }
+        int width = box[2] - box[0] + 1;
+        int height = box[3] - box[1] + 1;
+        std::vector<bool> change_mask((size_t)width * height);
+        for (int y = box[1]; y <= box[3]; ++y) {
+            for (int x = box[0]; x <= box[2]; ++x) {
+                change_mask[(size_t)(y - box[1]) * width + x - box[0]] = in_mask.InMask(x, y) && !out_mask.InMask(x, y);
+            }
+        }
+        auto change_spans = RegionSpans::FromMask(change_mask, box[0], box[1], width, height);
+        return _frames.at(file_id)->GetMaskedRegionStats(*change_spans, AxisRange(0, depth - 1), stokes_index, sums_stats, stats_values);
+    };
+    std::map<CARTA::StatsType, std::vector<double>> entered, left;
+    if (!get_change_stats(entered_box, current, previous, entered) || !get_change_stats(left_box, previous, current, left)) {
+        return false;
+    }
+
+    // Channels of the change stats without valid pixels have NaN values
+    auto change_value = [](std::map<CARTA::StatsType, std::vector<double>>& change, CARTA::StatsType type, size_t z, double value) {
+        return (change.count(type) && (change[CARTA::StatsType::NumPixels][z] > 0)) ? change[type][z] : value;
+    };
+    sums = previous;
+    sums.x = current.x;
+    sums.y = current.y;
+    sums.width = current.width;
+    sums.height = current.height;
+    sums.mask = std::move(current.mask);
+    z_valid.assign(depth, true);
+    for (size_t z = 0; z < depth; ++z) {
+        auto change = [&](CARTA::StatsType type) {
+            return change_value(entered, type, z, 0) - change_value(left, type, z, 0);
+        };
+        sums.num_pixels[z] += change(CARTA::StatsType::NumPixels);
+        sums.sum[z] += change(CARTA::StatsType::Sum);
+        sums.sum_sq[z] += change(CARTA::StatsType::SumSq);
+        if ((change_value(left, CARTA::StatsType::Min, z, INFINITY) <= sums.min[z]) ||
+            (change_value(left, CARTA::StatsType::Max, z, -INFINITY) >= sums.max[z])) {
+            z_valid[z] = false;
+        }
+        sums.min[z] = std::min(sums.min[z], change_value(entered, CARTA::StatsType::Min, z, sums.min[z]));
+        sums.max[z] = std::max(sums.max[z], change_value(entered, CARTA::StatsType::Max, z, sums.max[z]));
+    }
+    return true;
+}
+
 bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::string& coordinate, int stokes_index,
     std::vector<CARTA::StatsType>& required_stats,
     const std::function<void(std::map<CARTA::StatsType, std::vector<double>>, float)>& partial_results_callback) {
@@ -1038,8 +1482,53 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
     // Get initial region info to cancel profile if it changes
     RegionState initial_region_state = _regions.at(region_id)->GetRegionState();
 
+    // Send approximate sum, mean and flux density spectra of a large region first; the partial results below use them for the channels
+    // or pixels not done yet
+    std::map<CARTA::StatsType, std::vector<double>> approximate_profiles;
+    casacore::IPosition region_shape = lcregion->shape();
+    if ((_approximate_spectral_threshold > 0) && (region_shape.size() >= 2) &&
+        ((int64_t)region_shape(0) * region_shape(1) * profile_size > _approximate_spectral_threshold)) {
+        auto approximate_spans = _regions.at(region_id)->GetImageRegionSpans(file_id);
+        std::map<CARTA::StatsType, std::vector<double>> approximate_spectra;
+        std::vector<double> sum_errors;
+        if (approximate_spans &&
+            _frames.at(file_id)->GetApproximateRegionSpectra(*approximate_spans, stokes_index, approximate_spectra, sum_errors)) {
+            for (const auto& stat : required_stats) {
+                if (approximate_spectra.count(stat) && (stat != CARTA::StatsType::NumPixels)) {
+                    approximate_profiles[stat] = approximate_spectra[stat];
+                }
+            }
+        }
+        if (!approximate_profiles.empty()) {
+            double max_relative_error(0);
+            auto& sums = approximate_spectra[CARTA::StatsType::Sum];
+            for (size_t z = 0; z < sum_errors.size(); ++z) {
+                if (std::isfinite(sum_errors[z]) && (sums[z] != 0)) {
+                    max_relative_error = std::max(max_relative_error, sum_errors[z] / std::fabs(sums[z]));
+                }
+            }
+            spdlog::debug("Approximate spectra of region {} sent, with relative error of the sum up to {:.3g}", region_id,
+                max_relative_error);
+            std::map<CARTA::StatsType, std::vector<double>> approximate_results(results);
+            for (auto& profile : approximate_profiles) {
+                approximate_results[profile.first] = profile.second;
+            }
+            partial_results_callback(approximate_results, 0.0);
+        }
+    }
+    auto use_approximate_profiles = [&](std::map<CARTA::StatsType, std::vector<double>>& partial_results, const std::vector<bool>* done) {
+        for (auto& profile : approximate_profiles) {
+            auto& partial_profile = partial_results[profile.first];
+            for (size_t z = 0; z < partial_profile.size(); ++z) {
+                if (!done || !(*done)[z]) {
+                    partial_profile[z] = profile.second[z];
+                }
+            }
+        }
+    };
+
     // Use loader swizzled data for efficiency
-    if (_frames.at(file_id)->UseLoaderSpectralData(lcregion->shape())) {
+    if (_frames.at(file_id)->UseLoaderSpectralData(lcregion->shape(), stokes_index)) {
         // Use cursor spectral profile for point region
         if (initial_region_state.type == CARTA::RegionType::POINT) {
             casacore::IPosition origin = lcregion->boundingBox().start();
@@ -1063,8 +1552,8 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
         casacore::IPosition xy_origin = origin.keepAxes(casacore::IPosition(2, 0, 1)); // keep first two axes only
 
         // Get mask; LCRegion for file id is cached
-        casacore::ArrayLattice<casacore::Bool> mask = _regions[region_id]->GetImageRegionMask(file_id);
-        if (!mask.shape().empty()) {
+        BitMask mask = _regions[region_id]->GetImageRegionMask(file_id);
+        if (!mask.Empty()) {
             // start the timer
             auto t_start = std::chrono::high_resolution_clock::now();
             auto t_latest = t_start;
@@ -1106,8 +1595,14 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
                         // restart timer
                         t_latest = t_end;
 
-                        // send partial result
-                        partial_results_callback(results, progress);
+                        // send partial result; sums of the pixels done so far are replaced by the approximate spectra
+                        if (!approximate_profiles.empty() && (progress < PROFILE_COMPLETE)) {
+                            std::map<CARTA::StatsType, std::vector<double>> approximate_results(results);
+                            use_approximate_profiles(approximate_results, nullptr);
+                            partial_results_callback(approximate_results, progress);
+                        } else {
+                            partial_results_callback(results, progress);
+                        }
                     }
                 } else {
                     return false;
@@ -1117,6 +1612,7 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
             auto t_end_spectral_profile = std::chrono::high_resolution_clock::now();
             auto dt_spectral_profile =
                 std::chrono::duration_cast<std::chrono::microseconds>(t_end_spectral_profile - t_start_spectral_profile).count();
+            carta::LatencyHistograms::Record(carta::LatencyPoint::SpectralProfile, dt_spectral_profile);
             spdlog::performance("Fill spectral profile in {:.3f} ms", dt_spectral_profile * 1e-3);
             return true;
         }
@@ -1128,9 +1624,65 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
         cache_results[stat] = init_spectral;
     }
 
+    // Read channel blocks of the region bounding box and apply the region mask, rather than make a casacore subimage per block
+    std::shared_ptr<const RegionSpans> spans;
+    bool use_masked_stats = _frames.at(file_id)->UseMaskedRegionStats(_spectral_stats);
+    if (use_masked_stats) {
+        spans = _regions.at(region_id)->GetImageRegionSpans(file_id);
+        use_masked_stats = (spans != nullptr);
+    }
+
+    // Masked stats include the pixel count, to keep the sums for updating the profile when the region changes
+    std::vector<CARTA::StatsType> profile_stats(_spectral_stats);
+    if (use_masked_stats) {
+        profile_stats.push_back(CARTA::StatsType::NumPixels);
+        cache_results[CARTA::StatsType::NumPixels] = init_spectral;
+    }
+    auto cache_profiles = [&]() {
+        // TODO: cache and load partial profiles
+        _spectral_cache[cache_id] = SpectralCache(cache_results);
+        if (use_masked_stats) {
+            SetSpectralSums(*spans, cache_results, _spectral_cache[cache_id].sums);
+        }
+    };
+
+    // Update the previous profile from the pixels that entered or left the mask, and calculate only the channels where its min or
+    // max left the mask. Otherwise calculate all channels, coarse to fine for large cubes.
+    std::vector<size_t> z_order;
+    bool progressive(false);
+    std::vector<bool> z_done(profile_size, false);
+    SpectralSums updated_sums;
+    if (use_masked_stats && _spectral_cache.count(cache_id) && _spectral_cache[cache_id].sums.IsValid() &&
+        UpdateSpectralSums(file_id, stokes_index, _spectral_cache[cache_id].sums, *spans, updated_sums, z_done)) {
+        double beam_area = _frames.at(file_id)->BeamArea();
+        for (size_t z = 0; z < profile_size; ++z) {
+            if (!z_done[z]) {
+                z_order.push_back(z);
+                continue;
+            }
+            for (auto& result : cache_results) {
+                result.second[z] = RegionStatsValue(result.first, updated_sums.num_pixels[z], updated_sums.sum[z], updated_sums.sum_sq[z],
+                    updated_sums.min[z], updated_sums.max[z], beam_area);
+                if (results.count(result.first)) {
+                    results[result.first][z] = result.second[z];
+                }
+            }
+        }
+        spdlog::debug("Updated region {} spectral profile, {} of {} channels calculated", region_id, z_order.size(), profile_size);
+    } else {
+        z_order = SpectralProfileOrder(profile_size);
+        progressive = (profile_size >= SPECTRAL_PROGRESSIVE_MIN_DEPTH);
+    }
+
+    if (z_order.empty()) {
+        progress = PROFILE_COMPLETE;
+        partial_results_callback(results, progress);
+        cache_profiles();
+    }
+
     // Calculate and cache profiles
-    size_t start_z(0), count(0), end_z(0);
-    int delta_z = INIT_DELTA_Z;        // the increment of z for each step
+    size_t num_done(0);
+    int delta_z = INIT_DELTA_Z;        // the number of channels for each step
     int dt_target = TARGET_DELTA_TIME; // the target time elapse for each step, in the unit of milliseconds
     auto t_partial_profile_start = std::chrono::high_resolution_clock::now();
 
@@ -1139,35 +1691,53 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
         // start the timer
         auto t_start = std::chrono::high_resolution_clock::now();
 
-        end_z = (start_z + delta_z > profile_size ? profile_size - 1 : start_z + delta_z - 1);
-        count = end_z - start_z + 1;
-
-        // Get region for z range only and stokes_index
-        AxisRange z_range(start_z, end_z);
-        casacore::ImageRegion region;
-        if (!ApplyRegionToFile(region_id, file_id, z_range, stokes_index, region)) {
-            return false;
-        }
+        // Calculate the next channels of the order, in runs of consecutive channels
+        size_t step_end = std::min(num_done + (size_t)delta_z, z_order.size());
+        for (size_t run_start = num_done; run_start < step_end;) {
+            size_t run_end = run_start + 1;
+            while (run_end < step_end && z_order[run_end] == z_order[run_end - 1] + 1) {
+                ++run_end;
+            }
+            size_t start_z = z_order[run_start];
+            size_t end_z = z_order[run_end - 1];
+
+            // Get per-z stats data for region for all stats (for cache)
+            AxisRange z_range(start_z, end_z);
+            std::map<CARTA::StatsType, std::vector<double>> partial_profiles;
+            if (use_masked_stats) {
+                if (!_frames.at(file_id)->GetMaskedRegionStats(*spans, z_range, stokes_index, profile_stats, partial_profiles)) {
+                    return false;
+                }
+            } else {
+                // Get region for z range only and stokes_index
+                casacore::ImageRegion region;
+                if (!ApplyRegionToFile(region_id, file_id, z_range, stokes_index, region)) {
+                    return false;
+                }
 
-        // Get per-z stats data for region for all stats (for cache)
-        bool per_z(true);
-        std::map<CARTA::StatsType, std::vector<double>> partial_profiles;
-        if (!_frames.at(file_id)->GetRegionStats(region, _spectral_stats, per_z, partial_profiles)) {
-            return false;
-        }
+                bool per_z(true);
+                if (!_frames.at(file_id)->GetRegionStats(region, _spectral_stats, per_z, partial_profiles)) {
+                    return false;
+                }
+            }
 
-        // Copy partial profile to results and cache_results (all stats)
-        for (const auto& profile : partial_profiles) {
-            auto stats_type = profile.first;
-            const std::vector<double>& stats_data = profile.second;
-            if (results.count(stats_type)) {
-                memcpy(&results[stats_type][start_z], &stats_data[0], stats_data.size() * sizeof(double));
+            // Copy partial profile to results and cache_results (all stats)
+            for (const auto& profile : partial_profiles) {
+                auto stats_type = profile.first;
+                const std::vector<double>& stats_data = profile.second;
+                if (results.count(stats_type)) {
+                    memcpy(&results[stats_type][start_z], &stats_data[0], stats_data.size() * sizeof(double));
+                }
+                memcpy(&cache_results[stats_type][start_z], &stats_data[0], stats_data.size() * sizeof(double));
             }
-            memcpy(&cache_results[stats_type][start_z], &stats_data[0], stats_data.size() * sizeof(double));
+            for (size_t z = start_z; z <= end_z; ++z) {
+                z_done[z] = true;
+            }
+            run_start = run_end;
         }
 
-        start_z += count;
-        progress = (float)start_z / profile_size;
+        num_done = step_end;
+        progress = (float)num_done / z_order.size();
 
         // get the time elapse for this step
         auto t_end = std::chrono::high_resolution_clock::now();
@@ -1201,11 +1771,22 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
         // send partial result by the callback function
         if (dt_partial_profile > TARGET_PARTIAL_REGION_TIME || progress >= PROFILE_COMPLETE) {
             t_partial_profile_start = std::chrono::high_resolution_clock::now();
-            partial_results_callback(results, progress);
+            if ((progressive || !approximate_profiles.empty()) && progress < PROFILE_COMPLETE) {
+                // Approximate the full spectrum from the approximate spectra, or from the channels done so far
+                std::map<CARTA::StatsType, std::vector<double>> approximate_results(results);
+                if (progressive) {
+                    for (auto& result : approximate_results) {
+                        InterpolateProfileGaps(result.second, z_done);
+                    }
+                }
+                use_approximate_profiles(approximate_results, &z_done);
+                partial_results_callback(approximate_results, progress);
+            } else {
+                partial_results_callback(results, progress);
+            }
             if (progress >= PROFILE_COMPLETE) {
                 // cache results for all stats types
-                // TODO: cache and load partial profiles
-                _spectral_cache[cache_id] = SpectralCache(cache_results);
+                cache_profiles();
             }
         }
     }
@@ -1213,6 +1794,7 @@ bool RegionHandler::GetRegionSpectralData(int region_id, int file_id, std::strin
     auto t_end_spectral_profile = std::chrono::high_resolution_clock::now();
     auto dt_spectral_profile =
         std::chrono::duration_cast<std::chrono::microseconds>(t_end_spectral_profile - t_start_spectral_profile).count();
+    carta::LatencyHistograms::Record(carta::LatencyPoint::SpectralProfile, dt_spectral_profile);
     spdlog::performance("Fill spectral profile in {:.3f} ms", dt_spectral_profile * 1e-3);
 
     return true;
@@ -1317,10 +1899,17 @@ bool RegionHandler::GetRegionStatsData(
         return true;
     }
 
-    // calculate stats
+    // calculate stats, from the region pixels shared with the histograms unless they need the casacore image
     bool per_z(false);
     std::map<CARTA::StatsType, std::vector<double>> stats_map;
-    if (_frames.at(file_id)->GetRegionStats(region, required_stats, per_z, stats_map)) {
+    bool stats_ok(false);
+    if (_frames.at(file_id)->UseNativeChannelStats(required_stats)) {
+        auto pixels = GetRegionPixels(region_id, file_id, z, stokes, region);
+        stats_ok = pixels && _frames.at(file_id)->GetRegionStats(pixels->data, pixels->shape, pixels->blc, required_stats, stats_map);
+    } else {
+        stats_ok = _frames.at(file_id)->GetRegionStats(region, required_stats, per_z, stats_map);
+    }
+    if (stats_ok) {
         // convert vector to single value in map
         std::map<CARTA::StatsType, double> stats_results;
         for (auto& value : stats_map) {
@@ -1334,6 +1923,7 @@ bool RegionHandler::GetRegionStatsData(
 
         auto t_end_region_stats = std::chrono::high_resolution_clock::now();
         auto dt_region_stats = std::chrono::duration_cast<std::chrono::microseconds>(t_end_region_stats - t_start_region_stats).count();
+        carta::LatencyHistograms::Record(carta::LatencyPoint::RegionStats, dt_region_stats);
         spdlog::performance("Fill region stats in {:.3f} ms", dt_region_stats * 1e-3);
 
         return true;
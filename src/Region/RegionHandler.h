@@ -38,17 +38,60 @@ struct RegionProperties {
     RegionStyle style;
 };
 
+// Spectral profile to calculate for a region, file and stokes, see RegionHandler::FillSpectralProfileData
+struct SpectralProfileJob {
+    int region_id;
+    int file_id;
+    std::string coordinate;
+    int stokes_index;
+    std::vector<CARTA::StatsType> required_stats;
+    bool done = false;
+};
+
+// Pixels of a region in one channel, see RegionHandler::RegionDataScope
+struct RegionPixels {
+    RegionState region_state; // when the pixels were read
+    std::vector<float> data;  // bounding box of the region, NaN outside
+    casacore::IPosition shape;
+    casacore::IPosition blc;
+};
+
 namespace carta {
 
 class RegionHandler {
 public:
     RegionHandler() = default;
 
+    // Region spectral profiles over more pixels of the region bounding box times channels than the threshold first send approximate
+    // sum, mean and flux density spectra from the loader mipmaps, then refine them as the exact profile is calculated
+    static void SetApproximateSpectralThreshold(int64_t num_pixels) {
+        _approximate_spectral_threshold = num_pixels;
+    }
+
+    // While a scope is alive on a thread, the stats and histograms calculated on that thread for the current channel of a region and
+    // file share one read of the region pixels; used for the data streams of one region update
+    class RegionDataScope {
+    public:
+        RegionDataScope();
+        ~RegionDataScope();
+
+    private:
+        std::unordered_map<CacheId, std::shared_ptr<const RegionPixels>, CacheIdHash> _pixels;
+        bool _active;
+    };
+
     // Regions
     bool SetRegion(int& region_id, RegionState& region_state, casacore::CoordinateSystem* csys);
     bool RegionChanged(int region_id);
     void RemoveRegion(int region_id);
     std::shared_ptr<Region> GetRegion(int region_id);
+    // Parameters of all regions, by region id
+    std::unordered_map<int, RegionState> GetRegionStates();
+    // Region applied to the image of a frame and extended by z range and stokes, whether or not the frame has region requirements
+    bool ApplyRegionToFrame(int region_id, int file_id, const std::shared_ptr<Frame>& frame, const AxisRange& z_range, int stokes,
+        casacore::ImageRegion& region);
+    // Vertices of a line or polyline region in pixel coords of the image of a frame
+    bool GetRegionPath(int region_id, int file_id, const std::shared_ptr<Frame>& frame, std::vector<PointXy>& path);
 
     // Region Import/Export
     void ImportRegion(int file_id, std::shared_ptr<Frame> frame, CARTA::FileType region_file_type, const std::string& region_file,
@@ -101,11 +144,25 @@ private:
     bool RegionFileIdsValid(int region_id, int file_id);
     casacore::LCRegion* ApplyRegionToFile(int region_id, int file_id);
     bool ApplyRegionToFile(int region_id, int file_id, const AxisRange& z_range, int stokes, casacore::ImageRegion& region);
+    // Region pixels of a channel, read once within a RegionDataScope; null if they cannot be read
+    std::shared_ptr<const RegionPixels> GetRegionPixels(int region_id, int file_id, int z, int stokes, const casacore::ImageRegion& region);
     bool GetRegionHistogramData(
         int region_id, int file_id, std::vector<HistogramConfig>& configs, CARTA::RegionHistogramData& histogram_message);
     bool GetRegionSpectralData(int region_id, int file_id, std::string& coordinate, int stokes_index,
         std::vector<CARTA::StatsType>& required_stats,
         const std::function<void(std::map<CARTA::StatsType, std::vector<double>>, float)>& partial_results_callback);
+    // Profiles of many regions for the same file and stokes from one read of each block of channels; sets done for the jobs
+    // calculated, cancelled or failed, and returns true if any profile was completed
+    bool GetBatchedRegionSpectralData(std::vector<SpectralProfileJob>& jobs,
+        const std::function<void(SpectralProfileJob&, std::map<CARTA::StatsType, std::vector<double>>&, float)>& results_callback);
+    // Channel order for region spectral profiles, coarse to fine for large depths
+    static std::vector<size_t> SpectralProfileOrder(size_t depth);
+    // Fills channels not done yet from the channels done, for approximate partial profiles
+    static void InterpolateProfileGaps(std::vector<double>& profile, const std::vector<bool>& done);
+    // Sums for a mask from its complete profiles, and sums updated from the pixels that entered or left the previous mask
+    static void SetSpectralSums(const RegionSpans& spans, std::map<CARTA::StatsType, std::vector<double>>& profiles, SpectralSums& sums);
+    bool UpdateSpectralSums(int file_id, int stokes_index, const SpectralSums& previous, const RegionSpans& spans, SpectralSums& sums,
+        std::vector<bool>& z_valid);
     bool GetRegionStatsData(
         int region_id, int file_id, std::vector<CARTA::StatsType>& required_stats, CARTA::RegionStatsData& stats_message);
 
@@ -129,6 +186,8 @@ private:
     std::vector<CARTA::StatsType> _spectral_stats = {CARTA::StatsType::Sum, CARTA::StatsType::FluxDensity, CARTA::StatsType::Mean,
         CARTA::StatsType::RMS, CARTA::StatsType::Sigma, CARTA::StatsType::SumSq, CARTA::StatsType::Min, CARTA::StatsType::Max,
         CARTA::StatsType::Extrema};
+
+    static int64_t _approximate_spectral_threshold;
 };
 
 } // namespace carta
@@ -12,6 +12,7 @@
 #include <imageanalysis/Annotations/AnnotationBase.h>
 
 #include "../Logger/Logger.h"
+#include "../Threading.h"
 #include "../Util.h"
 
 using namespace carta;
@@ -190,6 +191,21 @@ void RegionImportExport::ParseRegionParameters(
     }
 }
 
+std::vector<ParsedRegionLine> RegionImportExport::ParseRegionLines(
+    std::vector<std::string>& lines, const std::function<bool(const std::string&)>& parse_line) {
+    // Tokenising only reads the line and the parser delimiters, so lines are independent; regions are converted in line order after
+    std::vector<ParsedRegionLine> parsed_lines(lines.size());
+    int64_t num_lines = lines.size();
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic, REGION_IMPORT_PARSE_CHUNK) if (num_lines > REGION_IMPORT_PARSE_CHUNK)
+    for (int64_t i = 0; i < num_lines; ++i) {
+        if (parse_line(lines[i])) {
+            ParseRegionParameters(lines[i], parsed_lines[i].parameters, parsed_lines[i].properties);
+        }
+    }
+    return parsed_lines;
+}
+
 bool RegionImportExport::ConvertPointToPixels(
     std::string& region_frame, std::vector<casacore::Quantity>& point, casacore::Vector<casacore::Double>& pixel_coords) {
     if (point.size() != 2) {
@@ -228,7 +244,7 @@ bool RegionImportExport::ConvertPointToPixels(
         // Convert to image direction
         if (region_direction_type != image_direction_type) {
             try {
-                direction = casacore::MDirection::Convert(direction, image_direction_type)();
+                direction = DirectionConverter(region_direction_type, image_direction_type)(direction);
             } catch (casacore::AipsError& err) {
                 _import_errors.append("Conversion of region parameters to image coordinate system failed.\n");
                 return false;
@@ -246,6 +262,17 @@ bool RegionImportExport::ConvertPointToPixels(
     return false;
 }
 
+casacore::MDirection::Convert& RegionImportExport::DirectionConverter(
+    casacore::MDirection::Types region_type, casacore::MDirection::Types image_type) {
+    // The image frame is fixed, so the converter only changes with the region frame
+    if (!_direction_converter || (_converter_region_type != region_type)) {
+        _direction_converter = std::make_unique<casacore::MDirection::Convert>(
+            casacore::MDirection::Ref(region_type), casacore::MDirection::Ref(image_type));
+        _converter_region_type = region_type;
+    }
+    return *_direction_converter;
+}
+
 double RegionImportExport::WorldToPixelLength(casacore::Quantity world_length, unsigned int pixel_axis) {
     // world->pixel conversion of ellipse radius or box width.
     // The opposite of casacore::CoordinateSystem::toWorldLength for pixel->world conversion.
@@ -9,14 +9,27 @@
 #ifndef CARTA_BACKEND_REGION_REGIONIMPORTEXPORT_H_
 #define CARTA_BACKEND_REGION_REGIONIMPORTEXPORT_H_
 
+#include <functional>
+#include <memory>
+
 #include <carta-protobuf/defs.pb.h>
 #include <casacore/casa/Arrays/IPosition.h>
 #include <casacore/coordinates/Coordinates/CoordinateSystem.h>
+#include <casacore/measures/Measures/MCDirection.h>
 
 #include "RegionHandler.h"
 
+// File lines tokenised by each thread at a time
+#define REGION_IMPORT_PARSE_CHUNK 1024
+
 namespace carta {
 
+// Region file line split into region parameters and properties (keyword=value)
+struct ParsedRegionLine {
+    std::vector<std::string> parameters;
+    std::unordered_map<std::string, std::string> properties;
+};
+
 class RegionImportExport {
 public:
     RegionImportExport() {}
@@ -50,6 +63,9 @@ protected:
     }
     virtual void ParseRegionParameters(
         std::string& region_definition, std::vector<std::string>& parameters, std::unordered_map<std::string, std::string>& properties);
+    // Tokenise the lines accepted by parse_line in parallel chunks, in line order; other lines are left empty
+    std::vector<ParsedRegionLine> ParseRegionLines(
+        std::vector<std::string>& lines, const std::function<bool(const std::string&)>& parse_line);
 
     virtual bool AddExportRegion(const RegionState& region_state, const RegionStyle& region_style,
         const std::vector<casacore::Quantity>& control_points, const casacore::Quantity& rotation) = 0;
@@ -57,6 +73,8 @@ protected:
     // Convert wcs -> pixel
     bool ConvertPointToPixels(
         std::string& region_frame, std::vector<casacore::Quantity>& point, casacore::Vector<casacore::Double>& pixel_coords);
+    // Conversion from a region direction frame to the image frame, kept for the next point in that frame
+    casacore::MDirection::Convert& DirectionConverter(casacore::MDirection::Types region_type, casacore::MDirection::Types image_type);
     double WorldToPixelLength(casacore::Quantity world_length, unsigned int pixel_axis);
 
     // Format hex string e.g. "10161a" -> "#10161A"
@@ -74,6 +92,10 @@ protected:
     std::vector<std::string> _export_regions;
 
 private:
+    // Setting up a direction conversion is much slower than converting a point
+    std::unique_ptr<casacore::MDirection::Convert> _direction_converter;
+    casacore::MDirection::Types _converter_region_type;
+
     // Return control_points and qrotation Quantity for region type
     bool ConvertRecordToPoint(
         const casacore::RecordInterface& region_record, bool pixel_coord, std::vector<casacore::Quantity>& control_points);
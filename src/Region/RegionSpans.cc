@@ -0,0 +1,260 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# RegionSpans.cc: 2D region pixels as runs of pixels in each row
+
+#include "RegionSpans.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <casacore/lattices/LRegions/LCBox.h>
+#include <casacore/lattices/LRegions/LCEllipsoid.h>
+#include <casacore/lattices/LRegions/LCExtension.h>
+#include <casacore/lattices/LRegions/LCPolygon.h>
+#include <casacore/lattices/LRegions/LCRegionFixed.h>
+
+using namespace carta;
+
+// Pixel intervals [start, end] of a row, merged into spans
+using RowIntervals = std::vector<std::pair<int, int>>;
+
+static void AddRowSpans(RowIntervals& intervals, int y, int width, std::vector<RegionSpan>& spans) {
+    // Overlapping or adjacent intervals are one span
+    std::sort(intervals.begin(), intervals.end());
+    size_t row_begin = spans.size();
+    for (auto& interval : intervals) {
+        int start = std::max(interval.first, 0);
+        int end = std::min(interval.second, width - 1) + 1;
+        if (start >= end) {
+            continue;
+        }
+        if ((spans.size() > row_begin) && (start <= spans.back().x_end)) {
+            spans.back().x_end = std::max(spans.back().x_end, end);
+        } else {
+            spans.push_back({y, start, end});
+        }
+    }
+    intervals.clear();
+}
+
+static std::vector<RegionSpan> BoxSpans(int width, int height) {
+    std::vector<RegionSpan> spans;
+    spans.reserve(height);
+    for (int y = 0; y < height; ++y) {
+        spans.push_back({y, 0, width});
+    }
+    return spans;
+}
+
+static std::vector<RegionSpan> EllipseSpans(
+    double center_x, double center_y, double radius_a, double radius_b, double theta, int width, int height) {
+    // Pixels with centre inside the ellipse, with major axis a at angle theta from the x axis; centre is relative to the blc
+    double cos_theta = std::cos(theta);
+    double sin_theta = std::sin(theta);
+    double a2 = radius_a * radius_a;
+    double b2 = radius_b * radius_b;
+    auto inside = [&](int x, double dy) {
+        double dx = x - center_x;
+        double major = dx * cos_theta + dy * sin_theta;
+        double minor = dy * cos_theta - dx * sin_theta;
+        return (major * major / a2 + minor * minor / b2) <= 1.0;
+    };
+
+    // Each row of the ellipse is one interval, from the roots of the quadratic in dx; the ends are checked with the pixel test
+    double quad_a = cos_theta * cos_theta / a2 + sin_theta * sin_theta / b2;
+    std::vector<RegionSpan> spans;
+    RowIntervals intervals;
+    for (int y = 0; y < height; ++y) {
+        double dy = y - center_y;
+        double quad_b = 2.0 * dy * cos_theta * sin_theta * (1.0 / a2 - 1.0 / b2);
+        double quad_c = dy * dy * (sin_theta * sin_theta / a2 + cos_theta * cos_theta / b2) - 1.0;
+        double discriminant = quad_b * quad_b - 4.0 * quad_a * quad_c;
+        double root = std::sqrt(std::max(discriminant, 0.0));
+        int start = std::ceil(center_x + (-quad_b - root) / (2.0 * quad_a));
+        int end = std::floor(center_x + (-quad_b + root) / (2.0 * quad_a));
+        start = std::max(start, 0);
+        end = std::min(end, width - 1);
+        while (start > 0 && inside(start - 1, dy)) {
+            --start;
+        }
+        while (start <= end && !inside(start, dy)) {
+            ++start;
+        }
+        while (end < width - 1 && inside(end + 1, dy)) {
+            ++end;
+        }
+        while (end >= start && !inside(end, dy)) {
+            --end;
+        }
+        if (start <= end) {
+            intervals.emplace_back(start, end);
+            AddRowSpans(intervals, y, width, spans);
+        }
+    }
+    return spans;
+}
+
+static std::vector<RegionSpan> PolygonSpans(const std::vector<double>& x, const std::vector<double>& y, int width, int height) {
+    // Scanlines through the pixel centres, with vertices relative to the blc. Pixels between pairs of edge crossings are inside,
+    // with the crossings themselves; pixels on horizontal edges and on vertices are added, so that all pixels on the edges are included.
+    size_t num_vertices = x.size();
+    std::vector<RowIntervals> edge_intervals(height);
+    std::vector<std::vector<size_t>> edge_starts(height); // edges by first row they cross
+    for (size_t i = 0; i < num_vertices; ++i) {
+        size_t j = (i + 1) % num_vertices;
+        double y_min = std::min(y[i], y[j]);
+        double y_max = std::max(y[i], y[j]);
+        if (y_min == y_max) {
+            if ((y_min == std::floor(y_min)) && (y_min >= 0) && (y_min < height)) {
+                int start = std::ceil(std::min(x[i], x[j]));
+                int end = std::floor(std::max(x[i], x[j]));
+                edge_intervals[(int)y_min].emplace_back(start, end);
+            }
+            continue;
+        }
+        // Rows y_min <= row < y_max, so each vertex is crossed once per scanline through it
+        int first_row = std::max((int)std::ceil(y_min), 0);
+        int last_row = std::min((int)std::ceil(y_max) - 1, height - 1);
+        if (first_row <= last_row) {
+            edge_starts[first_row].push_back(i);
+        }
+    }
+    for (size_t i = 0; i < num_vertices; ++i) {
+        if ((x[i] == std::floor(x[i])) && (y[i] == std::floor(y[i])) && (y[i] >= 0) && (y[i] < height)) {
+            edge_intervals[(int)y[i]].emplace_back(x[i], x[i]);
+        }
+    }
+
+    std::vector<RegionSpan> spans;
+    std::vector<size_t> active_edges;
+    std::vector<double> crossings;
+    for (int row = 0; row < height; ++row) {
+        // Drop edges ending below this row and add edges starting in it
+        active_edges.erase(std::remove_if(active_edges.begin(), active_edges.end(),
+                               [&](size_t i) { return std::max(y[i], y[(i + 1) % num_vertices]) <= row; }),
+            active_edges.end());
+        active_edges.insert(active_edges.end(), edge_starts[row].begin(), edge_starts[row].end());
+
+        crossings.clear();
+        for (size_t i : active_edges) {
+            size_t j = (i + 1) % num_vertices;
+            crossings.push_back(x[i] + (row - y[i]) * (x[j] - x[i]) / (y[j] - y[i]));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        RowIntervals& intervals = edge_intervals[row];
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2) {
+            intervals.emplace_back(std::ceil(crossings[k]), std::floor(crossings[k + 1]));
+        }
+        AddRowSpans(intervals, row, width, spans);
+    }
+    return spans;
+}
+
+RegionSpans::RegionSpans(int x, int y, int width, int height, std::vector<RegionSpan>&& spans)
+    : _x(x), _y(y), _width(width), _height(height), _num_pixels(0), _spans(std::move(spans)), _row_offsets(height + 1, 0) {
+    for (auto& span : _spans) {
+        _num_pixels += span.x_end - span.x_start;
+        ++_row_offsets[span.y + 1];
+    }
+    for (int row = 0; row < height; ++row) {
+        _row_offsets[row + 1] += _row_offsets[row];
+    }
+}
+
+std::shared_ptr<RegionSpans> RegionSpans::FromLCRegion(const casacore::LCRegion& region) {
+    // Region can either be an extension region or a fixed region, depending on whether image is matched or not
+    const casacore::LCRegion* fixed_region(&region);
+    auto extended_region = dynamic_cast<const casacore::LCExtension*>(&region);
+    if (extended_region) {
+        fixed_region = &extended_region->region();
+    }
+
+    casacore::Slicer bounding_box = fixed_region->boundingBox();
+    if (bounding_box.ndim() != 2) {
+        return nullptr;
+    }
+    int x = bounding_box.start()(0);
+    int y = bounding_box.start()(1);
+    int width = bounding_box.length()(0);
+    int height = bounding_box.length()(1);
+
+    if (dynamic_cast<const casacore::LCBox*>(fixed_region)) {
+        return std::make_shared<RegionSpans>(x, y, width, height, BoxSpans(width, height));
+    }
+
+    auto ellipse = dynamic_cast<const casacore::LCEllipsoid*>(fixed_region);
+    if (ellipse) {
+        const auto& center = ellipse->center();
+        const auto& radii = ellipse->radii();
+        return std::make_shared<RegionSpans>(
+            x, y, width, height, EllipseSpans(center(0) - x, center(1) - y, radii(0), radii(1), ellipse->theta(), width, height));
+    }
+
+    auto polygon = dynamic_cast<const casacore::LCPolygon*>(fixed_region);
+    if (polygon) {
+        const auto& polygon_x = polygon->x();
+        const auto& polygon_y = polygon->y();
+        std::vector<double> vertex_x(polygon_x.size()), vertex_y(polygon_y.size());
+        for (size_t i = 0; i < vertex_x.size(); ++i) {
+            vertex_x[i] = polygon_x(i) - x;
+            vertex_y[i] = polygon_y(i) - y;
+        }
+        return std::make_shared<RegionSpans>(x, y, width, height, PolygonSpans(vertex_x, vertex_y, width, height));
+    }
+
+    auto other_region = dynamic_cast<const casacore::LCRegionFixed*>(fixed_region);
+    if (other_region) {
+        return FromMask(other_region->getMask().tovector(), x, y, width, height);
+    }
+    return nullptr;
+}
+
+std::shared_ptr<RegionSpans> RegionSpans::FromMask(const std::vector<bool>& mask, int x, int y, int width, int height) {
+    std::vector<RegionSpan> spans;
+    for (int row = 0; row < height; ++row) {
+        size_t row_start = (size_t)row * width;
+        int span_start(-1);
+        for (int column = 0; column <= width; ++column) {
+            bool in_mask = (column < width) && mask[row_start + column];
+            if (in_mask && span_start < 0) {
+                span_start = column;
+            } else if (!in_mask && span_start >= 0) {
+                spans.push_back({row, span_start, column});
+                span_start = -1;
+            }
+        }
+    }
+    return std::make_shared<RegionSpans>(x, y, width, height, std::move(spans));
+}
+
+void RegionSpans::MaskRow(int y, float* row) const {
+    int x(0);
+    for (const RegionSpan* span = RowBegin(y); span != RowEnd(y); ++span) {
+        std::fill(row + x, row + span->x_start, NAN);
+        x = span->x_end;
+    }
+    std::fill(row + x, row + _width, NAN);
+}
+
+std::vector<bool> RegionSpans::Mask() const {
+    std::vector<bool> mask((size_t)_width * _height, false);
+    for (auto& span : _spans) {
+        size_t row_start = (size_t)span.y * _width;
+        std::fill(mask.begin() + row_start + span.x_start, mask.begin() + row_start + span.x_end, true);
+    }
+    return mask;
+}
+
+BitMask RegionSpans::PixelMask() const {
+    BitMask mask(casacore::IPosition(2, _width, _height));
+    for (auto& span : _spans) {
+        mask.SetRange((size_t)span.y * _width + span.x_start, (size_t)span.y * _width + span.x_end);
+    }
+    return mask;
+}
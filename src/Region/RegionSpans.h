@@ -0,0 +1,85 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# RegionSpans.h: 2D region pixels as runs of pixels in each row
+
+#ifndef CARTA_BACKEND_REGION_REGIONSPANS_H_
+#define CARTA_BACKEND_REGION_REGIONSPANS_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <casacore/lattices/LRegions/LCRegion.h>
+
+#include "../ImageStats/BitMask.h"
+
+namespace carta {
+
+// Pixels [x_start, x_end) of row y, relative to the region bounding box
+struct RegionSpan {
+    int y;
+    int x_start;
+    int x_end;
+};
+
+// The pixels of a 2D region in its bounding box, as spans sorted by row then x. Boxes, ellipses and polygons (including rotated
+// boxes) are rasterised directly, with the pixels casacore includes (centre inside, or on a polygon edge); other regions are
+// converted from their mask.
+class RegionSpans {
+public:
+    RegionSpans(int x, int y, int width, int height, std::vector<RegionSpan>&& spans);
+
+    // Spans of the fixed 2D region, or of the region extended by an LCExtension; null for other regions
+    static std::shared_ptr<RegionSpans> FromLCRegion(const casacore::LCRegion& region);
+    // Spans of a width x height mask, x fastest, with blc (x, y)
+    static std::shared_ptr<RegionSpans> FromMask(const std::vector<bool>& mask, int x, int y, int width, int height);
+
+    // Image pixel of the bounding box blc
+    int X() const {
+        return _x;
+    }
+    int Y() const {
+        return _y;
+    }
+    int Width() const {
+        return _width;
+    }
+    int Height() const {
+        return _height;
+    }
+    size_t NumPixels() const {
+        return _num_pixels;
+    }
+    const std::vector<RegionSpan>& Spans() const {
+        return _spans;
+    }
+
+    // Spans in a row are [RowBegin(y), RowEnd(y))
+    const RegionSpan* RowBegin(int y) const {
+        return _spans.data() + _row_offsets[y];
+    }
+    const RegionSpan* RowEnd(int y) const {
+        return _spans.data() + _row_offsets[y + 1];
+    }
+
+    // Set the values of a row of the bounding box outside the spans to NaN
+    void MaskRow(int y, float* row) const;
+
+    // Dense mask of the bounding box, x fastest
+    std::vector<bool> Mask() const;
+    BitMask PixelMask() const;
+
+private:
+    int _x, _y, _width, _height;
+    size_t _num_pixels;
+    std::vector<RegionSpan> _spans;
+    std::vector<size_t> _row_offsets; // index of the first span of each row, and the number of spans
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_REGION_REGIONSPANS_H_
@@ -0,0 +1,299 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# ReplayMain.cc: carta_replay, which drives a session without a connection from a log recorded with --record_folder
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cxxopts/cxxopts.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/fmt/fmt.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "Constants.h"
+#include "EventHeader.h"
+#include "FileList/FileListHandler.h"
+#include "Logger/Logger.h"
+#include "MessageDispatch.h"
+#include "Session.h"
+#include "SessionRecorder.h"
+#include "Threading.h"
+#include "Timer/LatencyHistogram.h"
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// A replayed request, answered by the sent messages with its request id
+struct Request {
+    uint32_t request_id;
+    CARTA::EventType type;
+    Clock::time_point received;
+    Clock::time_point first_response;
+    Clock::time_point last_response;
+    int responses = 0;
+};
+
+struct SentTotals {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+};
+
+// Collects the messages sent by the session, which may come from any thread
+class SentMessages {
+public:
+    void Received(uint32_t request_id, CARTA::EventType type) {
+        std::scoped_lock lock(_mutex);
+        if (request_id && !_requests.count(request_id)) {
+            _order.push_back(request_id);
+            _requests[request_id] = {request_id, type, Clock::now()};
+        }
+    }
+
+    void Sent(std::string_view message) {
+        if (message.size() < sizeof(carta::EventHeader)) {
+            return;
+        }
+        auto head = reinterpret_cast<const carta::EventHeader*>(message.data());
+        auto now = Clock::now();
+        std::scoped_lock lock(_mutex);
+        auto& totals = _sent[static_cast<CARTA::EventType>(head->type)];
+        ++totals.messages;
+        totals.bytes += message.size();
+        auto it = _requests.find(head->request_id);
+        if (head->request_id && it != _requests.end()) {
+            auto& request = it->second;
+            if (!request.responses++) {
+                request.first_response = now;
+            }
+            request.last_response = now;
+        }
+    }
+
+    std::vector<Request> Requests() {
+        std::scoped_lock lock(_mutex);
+        std::vector<Request> requests;
+        for (auto request_id : _order) {
+            requests.push_back(_requests[request_id]);
+        }
+        return requests;
+    }
+
+    std::map<CARTA::EventType, SentTotals> Totals() {
+        std::scoped_lock lock(_mutex);
+        return _sent;
+    }
+
+private:
+    std::mutex _mutex;
+    std::unordered_map<uint32_t, Request> _requests;
+    std::vector<uint32_t> _order;
+    std::map<CARTA::EventType, SentTotals> _sent;
+};
+
+double Milliseconds(Clock::duration dt) {
+    return std::chrono::duration<double, std::milli>(dt).count();
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+double Seconds(const timeval& time) {
+    return time.tv_sec + time.tv_usec * 1e-6;
+}
+
+// Waits until the session has no tasks, or until the deadline
+bool WaitForIdle(Session* session, Clock::time_point deadline) {
+    while (session->GetRefCount() > 1) {
+        if (Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    string log_file, json_file, top_level_folder("/"), starting_folder;
+    bool realtime(false);
+    int omp_threads(-1), verbosity(3), drain_timeout(30);
+
+    cxxopts::Options options("carta_replay", "Replays a session log recorded by the CARTA backend with --record_folder");
+    // clang-format off
+    options.add_options()
+        ("h,help", "print usage")
+        ("realtime", "send messages at their recorded times; by default each message is sent when the tasks of earlier messages are done, or at its recorded time if they take longer", cxxopts::value<bool>(realtime))
+        ("top_level_folder", "top-level folder of the recorded backend, against which the recorded file paths are resolved (default: /)", cxxopts::value<string>(top_level_folder), "<dir>")
+        ("starting_folder", "starting folder of the recorded backend (default: top-level folder)", cxxopts::value<string>(starting_folder), "<dir>")
+        ("t,omp_threads", "manually set OpenMP thread pool count", cxxopts::value<int>(omp_threads), "<threads>")
+        ("verbosity", "display verbose logging from this level", cxxopts::value<int>(verbosity), "<level>")
+        ("drain_timeout", "longest wait for the tasks of the last message (default: 30)", cxxopts::value<int>(drain_timeout), "<sec>")
+        ("json", "also write the summary to this file as JSON, for comparing builds", cxxopts::value<string>(json_file), "<file>")
+        ("log", "session log to replay", cxxopts::value<string>(log_file));
+    // clang-format on
+    options.positional_help("<session log>");
+    options.parse_positional("log");
+
+    try {
+        auto result = options.parse(argc, argv);
+        if (result.count("help") || log_file.empty()) {
+            cout << options.help() << endl;
+            return log_file.empty() && !result.count("help");
+        }
+    } catch (const std::exception& err) {
+        cerr << err.what() << endl;
+        return 1;
+    }
+    if (starting_folder.empty()) {
+        starting_folder = top_level_folder;
+    }
+
+    InitLogger(true, verbosity, false, false, 0);
+    carta::LatencyHistograms::SetEnabled(true);
+
+    std::vector<carta::RecordedMessage> messages;
+    std::string error;
+    if (!carta::SessionRecorder::Read(log_file, messages, error)) {
+        spdlog::error(error);
+        return 1;
+    }
+
+    tbb::task_scheduler_init task_scheduler(TBB_TASK_THREAD_COUNT);
+    carta::ThreadManager::SetThreadLimit(omp_threads);
+    FileListHandler file_list_handler(top_level_folder, starting_folder);
+
+    // The session replaces the socket with the message sink, so that it needs neither a connection nor an event loop
+    SentMessages sent;
+    auto session = new Session(nullptr, nullptr, 1, "replay", top_level_folder, starting_folder, &file_list_handler);
+    session->IncreaseRefCount();
+    session->SetMessageSink([&sent](std::string_view message) { sent.Sent(message); });
+
+    rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+    auto replay_start = Clock::now();
+
+    auto last_dispatch = replay_start;
+    int64_t last_time_us(0);
+    for (auto& message : messages) {
+        if (realtime) {
+            std::this_thread::sleep_until(replay_start + std::chrono::microseconds(message.time_us));
+        } else {
+            // Waits at most the recorded gap, e.g. while an animation runs until the recorded STOP_ANIMATION
+            WaitForIdle(session, last_dispatch + std::chrono::microseconds(message.time_us - last_time_us));
+        }
+        last_dispatch = Clock::now();
+        last_time_us = message.time_us;
+        if (message.data.size() >= sizeof(carta::EventHeader)) {
+            auto head = reinterpret_cast<const carta::EventHeader*>(message.data.data());
+            sent.Received(head->request_id, static_cast<CARTA::EventType>(head->type));
+        }
+        DispatchMessage(session, message.data);
+    }
+
+    if (!WaitForIdle(session, Clock::now() + std::chrono::seconds(drain_timeout))) {
+        spdlog::warn("Tasks of the session were still running after {} seconds", drain_timeout);
+    }
+    auto replay_time = Clock::now() - replay_start;
+    getrusage(RUSAGE_SELF, &usage_end);
+
+    session->WaitForTaskCancellation();
+    WaitForIdle(session, Clock::now() + std::chrono::seconds(drain_timeout));
+    if (!session->DecreaseRefCount()) {
+        delete session;
+    }
+
+    // Summary
+    nlohmann::json summary;
+    summary["log"] = log_file;
+    summary["messages_received"] = messages.size();
+    summary["wall_s"] = Milliseconds(replay_time) / 1000.0;
+    summary["cpu_user_s"] = Seconds(usage_end.ru_utime) - Seconds(usage_start.ru_utime);
+    summary["cpu_system_s"] = Seconds(usage_end.ru_stime) - Seconds(usage_start.ru_stime);
+    fmt::print("Replayed {} messages of {} in {:.3f} s; CPU time {:.3f} s user, {:.3f} s system\n", messages.size(), log_file,
+        summary["wall_s"].get<double>(), summary["cpu_user_s"].get<double>(), summary["cpu_system_s"].get<double>());
+
+    auto requests = sent.Requests();
+    std::map<CARTA::EventType, std::pair<std::vector<double>, std::vector<double>>> request_latencies;
+    for (auto& request : requests) {
+        nlohmann::json entry{{"request_id", request.request_id}, {"type", CARTA::EventType_Name(request.type)},
+            {"responses", request.responses}};
+        if (request.responses) {
+            double first_ms = Milliseconds(request.first_response - request.received);
+            double last_ms = Milliseconds(request.last_response - request.received);
+            entry["first_response_ms"] = first_ms;
+            entry["last_response_ms"] = last_ms;
+            request_latencies[request.type].first.push_back(first_ms);
+            request_latencies[request.type].second.push_back(last_ms);
+        }
+        summary["requests"].push_back(entry);
+    }
+
+    fmt::print("\n{:<32} {:>8} {:>12} {:>12} {:>12} {:>12}\n", "Request", "answered", "first p50", "first p99", "last p50", "last p99");
+    for (auto& [type, latencies] : request_latencies) {
+        auto& [first, last] = latencies;
+        nlohmann::json entry{{"count", first.size()}, {"first_p50_ms", Percentile(first, 0.5)}, {"first_p99_ms", Percentile(first, 0.99)},
+            {"last_p50_ms", Percentile(last, 0.5)}, {"last_p99_ms", Percentile(last, 0.99)}};
+        summary["request_types"][CARTA::EventType_Name(type)] = entry;
+        fmt::print("{:<32} {:>8} {:>9.3f} ms {:>9.3f} ms {:>9.3f} ms {:>9.3f} ms\n", CARTA::EventType_Name(type), first.size(),
+            entry["first_p50_ms"].get<double>(), entry["first_p99_ms"].get<double>(), entry["last_p50_ms"].get<double>(),
+            entry["last_p99_ms"].get<double>());
+    }
+
+    uint64_t bytes_sent(0);
+    fmt::print("\n{:<32} {:>10} {:>14}\n", "Sent", "messages", "bytes");
+    for (auto& [type, totals] : sent.Totals()) {
+        summary["sent"][CARTA::EventType_Name(type)] = {{"messages", totals.messages}, {"bytes", totals.bytes}};
+        bytes_sent += totals.bytes;
+        fmt::print("{:<32} {:>10} {:>14}\n", CARTA::EventType_Name(type), totals.messages, totals.bytes);
+    }
+    summary["bytes_sent"] = bytes_sent;
+
+    // Time spent in each phase of the image data pipeline, on all threads
+    fmt::print("\n{:<32} {:>10} {:>12} {:>12} {:>12}\n", "Phase", "count", "total", "p50", "p99");
+    for (int i = 0; i < (int)carta::LatencyPoint::Count; ++i) {
+        auto point = static_cast<carta::LatencyPoint>(i);
+        auto latency = carta::LatencyHistograms::Snapshot(point);
+        if (!latency.count) {
+            continue;
+        }
+        double total_ms = latency.count * latency.mean_ms;
+        summary["phases"][carta::LatencyHistograms::Name(point)] = {
+            {"count", latency.count}, {"total_ms", total_ms}, {"p50_ms", latency.p50_ms}, {"p99_ms", latency.p99_ms}};
+        fmt::print("{:<32} {:>10} {:>9.1f} ms {:>9.3f} ms {:>9.3f} ms\n", carta::LatencyHistograms::Name(point), latency.count, total_ms,
+            latency.p50_ms, latency.p99_ms);
+    }
+
+    if (!json_file.empty()) {
+        std::ofstream out(json_file);
+        out << summary.dump(2) << endl;
+        if (!out) {
+            spdlog::error("Could not write {}", json_file);
+            return 1;
+        }
+    }
+
+    FlushLogFile();
+    return 0;
+}
@@ -7,6 +7,10 @@
 #ifndef CARTA_BACKEND__REQUIREMENTSCACHE_H_
 #define CARTA_BACKEND__REQUIREMENTSCACHE_H_
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "ImageStats/Histogram.h"
 
 struct ConfigId {
@@ -71,7 +75,7 @@ struct RegionHistogramConfig {
 
 struct HistogramCache {
     carta::BasicStats<float> stats;
-    std::unordered_map<int, carta::Histogram> histograms; // key is num_bins
+    std::unordered_map<int, carta::Histogram> histograms; // key is num_bins; coarser bin counts are derived from these
 
     HistogramCache() {}
 
@@ -92,6 +96,12 @@ struct HistogramCache {
             histogram_ = histograms.at(num_bins_);
             return true;
         }
+        // The stats, and so the range, are the same for all histograms of the cache
+        for (auto& histogram : histograms) {
+            if (histogram.second.Rebin(num_bins_, histogram_)) {
+                return true;
+            }
+        }
         return false;
     }
 
@@ -107,6 +117,38 @@ struct HistogramCache {
 
 // -------------------------------
 
+// Cursor spatial profile "x" or "y". The optional viewport form "x:start:end:width" requests pixels [start, end), as a min/max
+// envelope of width bins if the range has more than twice that many pixels.
+struct SpatialConfig {
+    std::string coordinate;
+    int start = 0;
+    int end = 0;   // 0 for the end of the image
+    int width = 0; // 0 for full resolution
+
+    SpatialConfig(const std::string& profile) {
+        std::vector<std::string> parts;
+        size_t pos(0), next;
+        while ((next = profile.find(':', pos)) != std::string::npos) {
+            parts.push_back(profile.substr(pos, next - pos));
+            pos = next + 1;
+        }
+        parts.push_back(profile.substr(pos));
+
+        coordinate = parts[0];
+        if (parts.size() == 4) {
+            try {
+                start = std::max(std::stoi(parts[1]), 0);
+                end = std::max(std::stoi(parts[2]), 0);
+                width = std::max(std::stoi(parts[3]), 0);
+            } catch (std::exception&) {
+                start = end = width = 0;
+            }
+        }
+    }
+};
+
+// -------------------------------
+
 struct SpectralConfig {
     std::string coordinate;
     std::vector<CARTA::StatsType> all_stats;
@@ -144,8 +186,30 @@ struct RegionSpectralConfig {
     std::vector<SpectralConfig> configs;
 };
 
+// Per-z count, sums, min and max of the finite values in the region mask a spectral profile was calculated from. They are kept
+// when the region changes, so the next profile can add and subtract the pixels that entered or left the mask.
+struct SpectralSums {
+    int x, y, width, height; // mask bounding box
+    std::vector<bool> mask;
+    std::vector<double> num_pixels, sum, sum_sq, min, max;
+
+    SpectralSums() : x(0), y(0), width(0), height(0) {}
+
+    bool IsValid() const {
+        return !mask.empty();
+    }
+
+    bool InMask(int mask_x, int mask_y) const {
+        // Image pixel position
+        mask_x -= x;
+        mask_y -= y;
+        return (mask_x >= 0) && (mask_x < width) && (mask_y >= 0) && (mask_y < height) && mask[mask_y * width + mask_x];
+    }
+};
+
 struct SpectralCache {
     std::map<CARTA::StatsType, std::vector<double>> profiles;
+    SpectralSums sums;
 
     SpectralCache() {}
     SpectralCache(std::map<CARTA::StatsType, std::vector<double>>& profiles_) : profiles(profiles_) {}
@@ -159,7 +223,7 @@ struct SpectralCache {
     }
 
     void ClearProfiles() {
-        // when region changes
+        // when region changes; the sums are replaced when the new profiles are complete
         profiles.clear();
     }
 };
@@ -18,23 +18,32 @@
 #include <casacore/casa/OS/File.h>
 #include <tbb/parallel_for.h>
 #include <tbb/task_group.h>
-#include <zstd.h>
 
 #include <carta-protobuf/contour_image.pb.h>
 #include <carta-protobuf/defs.pb.h>
 #include <carta-protobuf/error.pb.h>
 #include <carta-protobuf/raster_tile.pb.h>
 
+#include "CompressionPolicy.h"
 #include "Constants.h"
 #include "DataStream/Compression.h"
 #include "EventHeader.h"
+#include "FilePreloader.h"
+#include "FileList/FileExtInfoCache.h"
 #include "FileList/FileExtInfoLoader.h"
 #include "FileList/FileInfoLoader.h"
+#include "FileList/FileListCache.h"
 #include "FileList/FitsHduList.h"
+#include "GrpcServer/WorkerPool.h"
+#include "ImageData/LoaderIoStats.h"
 #include "Logger/Logger.h"
+#include "MemoryBudget.h"
 #include "OnMessageTask.h"
 #include "SpectralLine/SpectralLineCrawler.h"
 #include "Threading.h"
+#include "Timer/LatencyHistogram.h"
+#include "Timer/SlowRequestLog.h"
+#include "Timer/TraceEvents.h"
 #include "Timer/Timer.h"
 #include "Util.h"
 
@@ -44,7 +53,7 @@
 #include <xmmintrin.h>
 #endif
 
-int Session::_num_sessions = 0;
+std::atomic<int> Session::_num_sessions(0);
 int Session::_exit_after_num_seconds = 5;
 bool Session::_exit_when_all_sessions_closed = false;
 
@@ -63,14 +72,16 @@ Session::Session(uWS::WebSocket<false, true>* ws, uWS::Loop* loop, uint32_t id,
       _region_handler(nullptr),
       _file_list_handler(file_list_handler),
       _animation_id(0),
-      _file_settings(this) {
+      _file_settings(this),
+      _out_msgs(MAX_OUTGOING_QUEUE_MB * 1024 * 1024),
+      _loop_thread_id(std::this_thread::get_id()) {
     _histogram_progress = HISTOGRAM_COMPLETE;
     _ref_count = 0;
     _animation_object = nullptr;
     _connected = true;
-    ++_num_sessions;
+    int num_sessions = ++_num_sessions;
     UpdateLastMessageTimestamp();
-    spdlog::debug("{} ::Session ({})", fmt::ptr(this), _num_sessions);
+    spdlog::debug("{} ::Session ({})", fmt::ptr(this), num_sessions);
 }
 
 static int __exit_backend_timer = 0;
@@ -94,9 +105,11 @@ void ExitNoSessions(int s) {
 }
 
 Session::~Session() {
-    --_num_sessions;
-    spdlog::debug("{} ~Session {}", fmt::ptr(this), _num_sessions);
-    if (!_num_sessions) {
+    int num_sessions = --_num_sessions;
+    spdlog::debug("{} ~Session {}", fmt::ptr(this), num_sessions);
+    carta::LatencyHistograms::Log();
+    carta::LoaderIoStats::EndSession(_id);
+    if (!num_sessions) {
         spdlog::info("No remaining sessions.");
         if (_exit_when_all_sessions_closed) {
             if (_exit_after_num_seconds == 0) {
@@ -127,12 +140,17 @@ void Session::SetInitExitTimeout(int secs) {
 }
 
 void Session::WaitForTaskCancellation() {
-    _connected = false;
+    {
+        // Waiting scripting calls give up
+        std::scoped_lock lock(_scripting_mutex);
+        _connected = false;
+    }
+    _scripting_response_received.notify_all();
+    _out_msgs.Stop(); // release producers waiting for queue space before waiting for their tasks
     for (auto& frame : _frames) {
         frame.second->WaitForTaskCancellation(); // call to stop Frame's jobs and wait for jobs finished
     }
-    _base_context.cancel_group_execution();
-    _histogram_context.cancel_group_execution();
+    _cancellation.CancelCurrent(); // also cancels histogram and animation tokens
     if (_animation_object) {
         if (!_animation_object->_stop_called) {
             _animation_object->_stop_called = true; // stop the animation
@@ -143,10 +161,11 @@ void Session::WaitForTaskCancellation() {
 
 void Session::ConnectCalled() {
     _connected = true;
-    _base_context.reset();
-    _histogram_context.reset();
+    _out_msgs.Reset();
+    _cancellation.Replace();
+    _histogram_cancellation.Replace();
     if (_animation_object) {
-        _animation_object->ResetContext();
+        _animation_object->ResetCancellation();
     }
 }
 
@@ -175,16 +194,26 @@ bool Session::FillExtendedFileInfo(std::map<std::string, CARTA::FileInfoExtended
             return file_info_ok;
         }
 
+        // HDU lists and extended file info are shared by all sessions for each version of the file
+        int64_t modify_time(0), size(0);
+        bool has_status = FileListCache::FileStatus(full_name, modify_time, size);
+        auto& ext_info_cache = FileExtInfoCache::GetInstance();
+
         // Extended file info in response is map<hdu_key, FileInfoExtended>
         std::vector<std::string> hdu_list;
         if (hdu_key.empty()) {
             if (file_info.type() == CARTA::FileType::FITS) {
                 // Get list of HDUs for file info response map
-                FitsHduList fits_hdu_list = FitsHduList(full_name);
-                fits_hdu_list.GetHduList(hdu_list, message);
+                if (!has_status || !ext_info_cache.GetHduList(full_name, modify_time, size, hdu_list)) {
+                    FitsHduList fits_hdu_list = FitsHduList(full_name);
+                    fits_hdu_list.GetHduList(hdu_list, message);
 
-                if (hdu_list.empty()) { // FitsHduList failed
-                    return file_info_ok;
+                    if (hdu_list.empty()) { // FitsHduList failed
+                        return file_info_ok;
+                    }
+                    if (has_status) {
+                        ext_info_cache.PutHduList(full_name, modify_time, size, hdu_list);
+                    }
                 }
             } else if (file_info.hdu_list_size() > 0) {
                 hdu_list.push_back(file_info.hdu_list(0)); // use first
@@ -193,28 +222,39 @@ bool Session::FillExtendedFileInfo(std::map<std::string, CARTA::FileInfoExtended
             hdu_list.push_back(hdu_key);
         }
 
-        _loader.reset(carta::FileLoader::GetLoader(full_name));
+        // Keep the loader of an info request for the same version of the file, with its image and coordinates already set up, to
+        // open the file
+        std::string loader_file_key = has_status ? fmt::format("{}:{}:{}", full_name, modify_time, size) : "";
+        if (!_loader || loader_file_key.empty() || loader_file_key != _loader_file_key) {
+            _loader.reset(carta::FilePreloader::TakeLoader(loader_file_key));
+            if (!_loader) {
+                _loader.reset(carta::FileLoader::GetLoader(full_name));
+            }
+            _loader_file_key = loader_file_key;
+        }
         FileExtInfoLoader ext_info_loader = FileExtInfoLoader(_loader.get());
 
         // FileInfoExtended for each hdu
         for (auto& hdu : hdu_list) {
             CARTA::FileInfoExtended file_info_ext;
 
-            if (hdu.empty()) {
-                if (ext_info_loader.FillFileExtInfo(file_info_ext, filename, hdu, message)) {
-                    hdu_info_map[hdu] = file_info_ext;
-                    file_info_ok = true;
-                }
-            } else {
-                // split hdu_name number and ext name (if any)
+            // split hdu_name number and ext name (if any)
+            std::string hdunum;
+            if (!hdu.empty()) {
                 std::vector<std::string> hdunum_extname;
                 SplitString(hdu, ':', hdunum_extname);
-                std::string hdunum = hdunum_extname[0];
+                hdunum = hdunum_extname[0];
+            }
 
-                // Add info to map
-                if (ext_info_loader.FillFileExtInfo(file_info_ext, filename, hdunum, message)) {
-                    hdu_info_map[hdunum] = file_info_ext;
-                    file_info_ok = true;
+            // Add info to map
+            if (has_status && ext_info_cache.GetExtInfo(full_name, hdunum, modify_time, size, file_info_ext)) {
+                hdu_info_map[hdunum] = file_info_ext;
+                file_info_ok = true;
+            } else if (ext_info_loader.FillFileExtInfo(file_info_ext, filename, hdunum, message)) {
+                hdu_info_map[hdunum] = file_info_ext;
+                file_info_ok = true;
+                if (has_status) {
+                    ext_info_cache.PutExtInfo(full_name, hdunum, modify_time, size, file_info_ext);
                 }
             }
         }
@@ -245,6 +285,7 @@ bool Session::FillExtendedFileInfo(CARTA::FileInfoExtended& extended_info, std::
     bool file_info_ok(false);
     try {
         _loader.reset(carta::FileLoader::GetLoader(image));
+        _loader_file_key.clear();
         FileExtInfoLoader ext_info_loader = FileExtInfoLoader(_loader.get());
         file_info_ok = ext_info_loader.FillFileExtInfo(extended_info, filename, "", message);
     } catch (casacore::AipsError& err) {
@@ -295,6 +336,9 @@ void Session::OnRegisterViewer(const CARTA::RegisterViewer& message, uint16_t ic
         feature_flags |= CARTA::ServerFeatureFlags::GRPC_SCRIPTING;
         ack_message.set_grpc_port(_grpc_port);
     }
+    // 64-bit tile keys are used if the frontend asks for them; the server flag tells it that they are understood
+    _tile_keys_64 = (message.client_feature_flags() & TILE_KEYS_64_FEATURE_FLAG);
+    feature_flags |= TILE_KEYS_64_FEATURE_FLAG;
     ack_message.set_server_feature_flags(feature_flags);
     SendEvent(CARTA::EventType::REGISTER_VIEWER_ACK, request_id, ack_message);
 }
@@ -390,6 +434,15 @@ bool Session::OnOpenFile(const CARTA::OpenFile& message, uint32_t request_id, bo
             _frames[file_id] = move(frame);
             lock.unlock();
 
+            CARTA::ImageProperties source;
+            source.set_directory(directory);
+            source.set_file(filename);
+            source.set_hdu(hdu);
+            source.set_file_id(file_id);
+            std::unique_lock<std::mutex> state_lock(_view_state_mutex);
+            _image_sources[file_id] = source;
+            state_lock.unlock();
+
             // copy file info, extended file info
             CARTA::FileInfo response_file_info = CARTA::FileInfo();
             response_file_info.set_name(file_info.name());
@@ -428,6 +481,7 @@ bool Session::OnOpenFile(const CARTA::OpenFile& message, uint32_t request_id, bo
             std::string message = fmt::format("Image histogram for file id {} failed", file_id);
             SendLogEvent(message, {"open_file"}, CARTA::ErrorSeverity::ERROR);
         }
+        carta::MemoryBudget::Global().LogUsage();
     }
     return success;
 }
@@ -488,6 +542,25 @@ void Session::OnCloseFile(const CARTA::CloseFile& message) {
     DeleteFrame(message.file_id());
 }
 
+carta::CancellationToken Session::SupersedeRequest(CARTA::EventType event_type, int file_id, int region_id) {
+    std::unique_lock<std::mutex> lock(_latest_request_mutex);
+    auto latest = _latest_requests.try_emplace(std::make_tuple(event_type, file_id, region_id), &_cancellation).first;
+    return latest->second.Replace();
+}
+
+void Session::CancelSupersededRequests(int file_id) {
+    // Requests queued for a closed file are not run
+    std::unique_lock<std::mutex> lock(_latest_request_mutex);
+    for (auto it = _latest_requests.begin(); it != _latest_requests.end();) {
+        if ((file_id == ALL_FILES) || (std::get<1>(it->first) == file_id)) {
+            it->second.CancelCurrent();
+            it = _latest_requests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void Session::DeleteFrame(int file_id) {
     // call destructor and erase from map
     std::unique_lock<std::mutex> lock(_frame_mutex);
@@ -509,6 +582,8 @@ void Session::DeleteFrame(int file_id) {
     if (_region_handler) {
         _region_handler->RemoveFrame(file_id);
     }
+    CancelSupersededRequests(file_id);
+    RemoveFileViewState(file_id);
 }
 
 void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool skip_data) {
@@ -535,31 +610,69 @@ void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool sk
         start_message.set_end_sync(false);
         SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_SYNC, 0, start_message);
 
-        int num_tiles = message.tiles_size();
+        auto frame = _frames.at(file_id);
+        int tile_request_id = frame->StartTileRequest();
         CARTA::CompressionType compression_type = message.compression_type();
         float compression_quality = message.compression_quality();
+        if (compression_type == static_cast<CARTA::CompressionType>(QUANTIZED_COMPRESSION_TYPE)) {
+            // Quantized tiles use the channel min/max; calculate the stats before the tile workers read them
+            carta::BasicStats<float> stats;
+            frame->GetBasicStats(z, stokes, stats);
+        }
+        bool delta_tiles(false);
+        if (compression_type == static_cast<CARTA::CompressionType>(DELTA_COMPRESSION_TYPE)) {
+            // Delta tiles are for animation only; other tiles are ZFP-compressed and the next animation starts with keyframes
+            delta_tiles = (animation_id > 0);
+            if (delta_tiles) {
+                frame->StartDeltaTiles(animation_id);
+            } else {
+                frame->ResetDeltaTiles();
+                compression_type = CARTA::CompressionType::ZFP;
+            }
+        }
+
+        std::vector<Tile> tiles;
+        if (!Tile::DecodeTiles(message.tiles(), _tile_keys_64, tiles)) {
+            spdlog::warn("Session {}: incomplete 64-bit tile key in tile request", _id);
+        }
+        Tile::SortByPriority(tiles);
+        int num_tiles = tiles.size();
 
         auto t_start_get_tile_data = std::chrono::high_resolution_clock::now();
 
+        // Workers take tiles in priority order, and stop when the request has been superseded
+        std::atomic<int> next_tile(0);
+
         ThreadManager::ApplyThreadLimit();
 #pragma omp parallel
         {
             int num_threads = omp_get_num_threads();
-            int stride = std::min(num_tiles, std::min(num_threads, MAX_TILING_TASKS));
+            int num_workers = std::min(num_tiles, std::min(num_threads, MAX_TILING_TASKS));
 #pragma omp for
-            for (int j = 0; j < stride; j++) {
-                for (int i = j; i < num_tiles; i += stride) {
-                    const auto& encoded_coordinate = message.tiles(i);
+            for (int j = 0; j < num_workers; j++) {
+                int i;
+                while ((i = next_tile++) < num_tiles) {
+                    if (!frame->IsTileRequestCurrent(tile_request_id) || !frame->IsConnected()) {
+                        break;
+                    }
+
+                    const auto& tile = tiles[i];
                     CARTA::RasterTileData raster_tile_data;
                     raster_tile_data.set_file_id(file_id);
                     raster_tile_data.set_animation_id(animation_id);
-                    auto tile = Tile::Decode(encoded_coordinate);
-                    if (_frames.count(file_id) &&
-                        _frames.at(file_id)->FillRasterTileData(raster_tile_data, tile, z, stokes, compression_type, compression_quality)) {
+                    bool tile_ok;
+                    if (delta_tiles) {
+                        tile_ok = frame->FillDeltaRasterTileData(raster_tile_data, tile, z, stokes, compression_quality);
+                    } else {
+                        tile_ok =
+                            frame->GetCachedRasterTileData(raster_tile_data, tile, z, stokes, compression_type, compression_quality) ||
+                            frame->FillRasterTileData(raster_tile_data, tile, z, stokes, compression_type, compression_quality);
+                    }
+                    if (tile_ok) {
                         // Only use deflate on outgoing message if the raster image compression type is NONE
                         SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_DATA, 0, raster_tile_data,
                             compression_type == CARTA::CompressionType::NONE);
-                    } else {
+                    } else if (frame->IsTileRequestCurrent(tile_request_id)) {
                         spdlog::error("Problem getting tile layer={}, x={}, y={}", tile.layer, tile.x, tile.y);
                     }
                 }
@@ -582,6 +695,63 @@ void Session::OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool sk
     }
 }
 
+void Session::OnAddRequiredChannelTiles(
+    const CARTA::data::AddRequiredChannelTiles& message, const carta::CancellationToken& cancel_token) {
+    auto file_id = message.file_id();
+    if (!_frames.count(file_id) || message.tiles().empty() || message.channels().empty()) {
+        return;
+    }
+    auto frame = _frames.at(file_id);
+    int stokes = (message.stokes() == CURRENT_STOKES) ? frame->CurrentStokes() : message.stokes();
+    auto compression_type = static_cast<CARTA::CompressionType>(message.compression_type());
+    float compression_quality = message.compression_quality();
+
+    std::vector<Tile> tiles;
+    if (!Tile::DecodeTiles(message.tiles(), _tile_keys_64, tiles)) {
+        spdlog::warn("Session {}: incomplete 64-bit tile key in channel tile request", _id);
+    }
+    Tile::SortByPriority(tiles);
+
+    auto send_sync = [&](const AxisRange& z_range, bool end_sync) {
+        for (int z = z_range.from; z <= z_range.to; ++z) {
+            CARTA::RasterTileSync sync_message;
+            sync_message.set_file_id(file_id);
+            sync_message.set_channel(z);
+            sync_message.set_stokes(stokes);
+            sync_message.set_animation_id(0);
+            sync_message.set_end_sync(end_sync);
+            SendFileEvent(file_id, CARTA::EventType::RASTER_TILE_SYNC, 0, sync_message);
+        }
+    };
+    auto send_tile = [&](CARTA::RasterTileData& raster_tile_data) {
+        raster_tile_data.set_file_id(file_id);
+        raster_tile_data.set_animation_id(0);
+        // Only use deflate on outgoing message if the raster image compression type is NONE
+        SendFileEvent(
+            file_id, CARTA::EventType::RASTER_TILE_DATA, 0, raster_tile_data, compression_type == CARTA::CompressionType::NONE);
+    };
+
+    auto t_start_channel_tiles = std::chrono::high_resolution_clock::now();
+    std::vector<int> channels(message.channels().begin(), message.channels().end());
+    for (const auto& z_range : frame->GetChannelTileBlocks(channels, tiles)) {
+        if (cancel_token.IsCancelled() || !frame->IsConnected()) {
+            return;
+        }
+        send_sync(z_range, false);
+        if (!frame->FillChannelTiles(z_range, stokes, tiles, compression_type, compression_quality, send_tile, cancel_token)) {
+            if (!cancel_token.IsCancelled()) {
+                spdlog::error("Problem getting tiles of channels {}-{}", z_range.from, z_range.to);
+            }
+            return;
+        }
+        send_sync(z_range, true);
+    }
+
+    auto t_end_channel_tiles = std::chrono::high_resolution_clock::now();
+    auto dt_channel_tiles = std::chrono::duration_cast<std::chrono::microseconds>(t_end_channel_tiles - t_start_channel_tiles).count();
+    spdlog::performance("Get tile data of {} channels in {:.3f} ms", channels.size(), dt_channel_tiles * 1e-3);
+}
+
 void Session::OnSetImageChannels(const CARTA::SetImageChannels& message) {
     auto file_id(message.file_id());
     if (_frames.count(file_id)) {
@@ -672,17 +842,67 @@ bool Session::OnSetRegion(const CARTA::SetRegion& message, uint32_t request_id,
 
     // update data streams if requirements set and region changed
     if (success && _region_handler->RegionChanged(region_id)) {
-        OnMessageTask* tsk = new (tbb::task::allocate_root(this->Context())) RegionDataStreamsTask(this, ALL_FILES, region_id);
-        tbb::task::enqueue(*tsk);
+        OnMessageTask* tsk = new RegionDataStreamsTask(this, ALL_FILES, region_id);
+        TaskScheduler::Enqueue(tsk);
     }
 
     return success;
 }
 
+bool Session::AddToSetRegionQueue(const CARTA::SetRegion& message, uint32_t request_id) {
+    // Latest update wins; a pending update is acknowledged without being applied
+    std::lock_guard<std::mutex> guard(_set_region_mutex);
+    auto region_id(message.region_id());
+    std::pair<CARTA::SetRegion, uint32_t> stale_request;
+    while (_set_region_queues[region_id].try_pop(stale_request)) {
+        CARTA::SetRegionAck ack;
+        ack.set_region_id(region_id);
+        ack.set_success(true);
+        ack.set_message("Region update superseded");
+        SendEvent(CARTA::EventType::SET_REGION_ACK, stale_request.second, ack);
+    }
+    _set_region_queues[region_id].push(std::make_pair(message, request_id));
+
+    bool new_task = !_set_region_task_active[region_id];
+    _set_region_task_active[region_id] = true;
+    return new_task;
+}
+
+void Session::ExecuteSetRegionEvt(int region_id) {
+    // Apply the latest update until none arrived while applying it, so that updates for a region are not applied concurrently
+    std::pair<CARTA::SetRegion, uint32_t> request;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(_set_region_mutex);
+            if (!_set_region_queues[region_id].try_pop(request)) {
+                _set_region_task_active[region_id] = false;
+                return;
+            }
+        }
+        OnSetRegion(request.first, request.second);
+    }
+}
+
 void Session::OnRemoveRegion(const CARTA::RemoveRegion& message) {
+    {
+        // Drop a pending update, which would set the region again
+        std::lock_guard<std::mutex> guard(_set_region_mutex);
+        std::pair<CARTA::SetRegion, uint32_t> request;
+        if (message.region_id() == ALL_REGIONS) {
+            for (auto& queue : _set_region_queues) {
+                while (queue.second.try_pop(request)) {
+                }
+            }
+        } else if (_set_region_queues.count(message.region_id())) {
+            while (_set_region_queues[message.region_id()].try_pop(request)) {
+            }
+        }
+    }
+
     if (_region_handler) {
         _region_handler->RemoveRegion(message.region_id());
     }
+    RemoveRegionViewState(message.region_id());
 }
 
 void Session::OnImportRegion(const CARTA::ImportRegion& message, uint32_t request_id) {
@@ -786,7 +1006,7 @@ void Session::OnExportRegion(const CARTA::ExportRegion& message, uint32_t reques
     }
 }
 
-void Session::OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& message) {
+void Session::OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& message, bool silent) {
     auto file_id(message.file_id());
     if (_frames.count(file_id)) {
         auto region_id = message.region_id();
@@ -796,7 +1016,10 @@ void Session::OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& mess
         } else {
             if (_frames.at(file_id)->SetSpatialRequirements(
                     region_id, std::vector<std::string>(message.spatial_profiles().begin(), message.spatial_profiles().end()))) {
-                SendSpatialProfileData(file_id, region_id);
+                RecordViewMessage(CARTA::EventType::SET_SPATIAL_REQUIREMENTS, file_id, region_id, message);
+                if (!silent) {
+                    SendSpatialProfileData(file_id, region_id);
+                }
             } else {
                 string error = fmt::format("Spatial profiles not valid for region id {}", region_id);
                 SendLogEvent(error, {"spatial"}, CARTA::ErrorSeverity::ERROR);
@@ -808,7 +1031,7 @@ void Session::OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& mess
     }
 }
 
-void Session::OnSetHistogramRequirements(const CARTA::SetHistogramRequirements& message, uint32_t request_id) {
+void Session::OnSetHistogramRequirements(const CARTA::SetHistogramRequirements& message, uint32_t request_id, bool silent) {
     auto file_id(message.file_id());
     auto region_id = message.region_id();
     bool requirements_set(false);
@@ -817,10 +1040,13 @@ void Session::OnSetHistogramRequirements(const CARTA::SetHistogramRequirements&
         // Catch cube histogram cancel here
         if ((region_id == CUBE_REGION_ID) && (message.histograms_size() == 0)) { // cancel!
             _histogram_progress = HISTOGRAM_CANCEL;
-            _histogram_context.cancel_group_execution();
+            _histogram_cancellation.CancelCurrent();
             SendLogEvent("Histogram cancelled", {"histogram"}, CARTA::ErrorSeverity::INFO);
             return;
         }
+        if (region_id == CUBE_REGION_ID) {
+            _histogram_cancellation.Replace(); // stop a cube histogram still calculated for previous requirements
+        }
 
         std::vector<CARTA::SetHistogramRequirements_HistogramConfig> requirements = {
             message.histograms().begin(), message.histograms().end()};
@@ -837,7 +1063,10 @@ void Session::OnSetHistogramRequirements(const CARTA::SetHistogramRequirements&
         }
 
         if (requirements_set) {
-            if ((message.histograms_size() > 0) && !SendRegionHistogramData(file_id, region_id)) {
+            if (region_id != CUBE_REGION_ID) {
+                RecordViewMessage(CARTA::EventType::SET_HISTOGRAM_REQUIREMENTS, file_id, region_id, message);
+            }
+            if ((message.histograms_size() > 0) && !silent && !SendRegionHistogramData(file_id, region_id)) {
                 std::string message = fmt::format("Histogram calculation for region {} failed", region_id);
                 SendLogEvent(message, {"histogram"}, CARTA::ErrorSeverity::WARNING);
             }
@@ -852,7 +1081,7 @@ void Session::OnSetHistogramRequirements(const CARTA::SetHistogramRequirements&
     }
 }
 
-void Session::OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& message) {
+void Session::OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& message, bool silent) {
     auto file_id(message.file_id());
     auto region_id = message.region_id();
     bool requirements_set(false);
@@ -879,9 +1108,13 @@ void Session::OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& me
         }
 
         if (requirements_set) {
-            // RESPONSE
-            OnMessageTask* tsk = new (tbb::task::allocate_root(this->Context())) SpectralProfileTask(this, file_id, region_id);
-            tbb::task::enqueue(*tsk);
+            RecordViewMessage(CARTA::EventType::SET_SPECTRAL_REQUIREMENTS, file_id, region_id, message);
+            if (!silent) {
+                // RESPONSE
+                OnMessageTask* tsk = new SpectralProfileTask(this, file_id, region_id);
+                tsk->SetCancellation(SupersedeRequest(CARTA::EventType::SET_SPECTRAL_REQUIREMENTS, file_id, region_id));
+                TaskScheduler::Enqueue(tsk);
+            }
         } else if (region_id != IMAGE_REGION_ID) { // not sure why frontend sends this
             string error = fmt::format("Spectral requirements not valid for region id {}", region_id);
             SendLogEvent(error, {"spectral"}, CARTA::ErrorSeverity::ERROR);
@@ -892,7 +1125,7 @@ void Session::OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& me
     }
 }
 
-void Session::OnSetStatsRequirements(const CARTA::SetStatsRequirements& message) {
+void Session::OnSetStatsRequirements(const CARTA::SetStatsRequirements& message, bool silent) {
     auto file_id(message.file_id());
     auto region_id = message.region_id();
     bool requirements_set(false);
@@ -915,7 +1148,8 @@ void Session::OnSetStatsRequirements(const CARTA::SetStatsRequirements& message)
         }
 
         if (requirements_set) {
-            if ((message.stats_size() > 0) && !SendRegionStatsData(file_id, region_id)) {
+            RecordViewMessage(CARTA::EventType::SET_STATS_REQUIREMENTS, file_id, region_id, message);
+            if ((message.stats_size() > 0) && !silent && !SendRegionStatsData(file_id, region_id)) {
                 std::string error = fmt::format("Statistics calculation for region {} failed", region_id);
                 SendLogEvent(error, {"stats"}, CARTA::ErrorSeverity::ERROR);
             }
@@ -932,8 +1166,11 @@ void Session::OnSetStatsRequirements(const CARTA::SetStatsRequirements& message)
 void Session::OnSetContourParameters(const CARTA::SetContourParameters& message, bool silent) {
     if (_frames.count(message.file_id())) {
         const int num_levels = message.levels_size();
-        if (_frames.at(message.file_id())->SetContourParameters(message) && num_levels && !silent) {
-            SendContourData(message.file_id());
+        if (_frames.at(message.file_id())->SetContourParameters(message)) {
+            RecordViewMessage(CARTA::EventType::SET_CONTOUR_PARAMETERS, message.file_id(), 0, message);
+            if (num_levels && !silent) {
+                SendContourData(message.file_id());
+            }
         }
     }
 }
@@ -941,17 +1178,16 @@ void Session::OnSetContourParameters(const CARTA::SetContourParameters& message,
 void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t request_id) {
     bool success(true);
     spdlog::info("Client {} [{}] Resumed.", GetId(), GetAddress());
-
-    // Error messages
     std::string err_message;
-    std::string err_file_ids = "Problem loading files: ";
-    std::string err_region_ids = "Problem loading regions: ";
+
+    // The frontend restores its own view, so a hibernated view is dropped
+    _hibernated_view.reset();
 
     // Stop the streaming spectral profile, cube histogram and animation processes
     WaitForTaskCancellation();
 
     // Clear the message queue
-    _out_msgs.clear();
+    _out_msgs.Clear();
 
     // Reconnect the session
     ConnectCalled();
@@ -963,8 +1199,53 @@ void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t requ
 
     auto t_start_resume = std::chrono::high_resolution_clock::now();
 
-    // Open images
-    for (int i = 0; i < message.images_size(); ++i) {
+    // Histograms and contours are not needed for the ack, and are sent after it
+    std::vector<std::pair<int, bool>> resumed_images; // image index, whether to send the image histogram
+    success = ResumeImages(message, request_id, false, resumed_images, err_message);
+
+    // Open Catalog files
+    for (int i = 0; i < message.catalog_files_size(); ++i) {
+        const CARTA::OpenCatalogFile& open_catalog_file_msg = message.catalog_files(i);
+        OnOpenCatalogFile(open_catalog_file_msg, request_id, true);
+    }
+
+    // Measure duration for resume
+    auto t_end_resume = std::chrono::high_resolution_clock::now();
+    auto dt_resume = std::chrono::duration_cast<std::chrono::microseconds>(t_end_resume - t_start_resume).count();
+    spdlog::performance("Resume in {:.3f} ms", dt_resume * 1e-3);
+
+    // RESPONSE
+    CARTA::ResumeSessionAck ack;
+    ack.set_success(success);
+    if (!success) {
+        ack.set_message(err_message);
+    }
+    SendEvent(CARTA::EventType::RESUME_SESSION_ACK, request_id, ack);
+
+    for (auto& [index, send_histogram] : resumed_images) {
+        const CARTA::ImageProperties& image = message.images(index);
+        TaskScheduler::Enqueue(new ResumeImageDataTask(this, image.file_id(), send_histogram, image.contour_settings()));
+    }
+}
+
+bool Session::ResumeImages(const CARTA::ResumeSession& message, uint32_t request_id, bool silent,
+    std::vector<std::pair<int, bool>>& resumed_images, std::string& err_message) {
+    bool success(true);
+    std::string err_file_ids = "Problem loading files: ";
+    std::string err_region_ids = "Problem loading regions: ";
+
+    // Open the images concurrently, so that the resume takes as long as the slowest; frames of the same file share their planes.
+    // Concatenated stokes files are opened with the session's connector below.
+    int num_images(message.images_size());
+    std::vector<std::shared_ptr<Frame>> resumed_frames(num_images);
+    tbb::parallel_for(0, num_images, [&](int i) {
+        if (message.images(i).stokes_files_size() <= 1) {
+            carta::ThreadManager::BusyScope busy;
+            resumed_frames[i] = OpenResumedFrame(message.images(i));
+        }
+    });
+
+    for (int i = 0; i < num_images; ++i) {
         const CARTA::ImageProperties& image = message.images(i);
         bool file_ok(true);
 
@@ -974,24 +1255,30 @@ void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t requ
             *concat_stokes_files_msg.mutable_stokes_files() = image.stokes_files();
 
             // Open a concatenated stokes file
-            if (!OnConcatStokesFiles(concat_stokes_files_msg, request_id)) {
+            if (OnConcatStokesFiles(concat_stokes_files_msg, request_id, silent)) {
+                resumed_images.emplace_back(i, false);
+            } else {
                 success = false;
                 file_ok = false;
                 err_file_ids.append(std::to_string(image.file_id()) + " ");
             }
+        } else if (resumed_frames[i]) {
+            std::unique_lock<std::mutex> lock(_frame_mutex); // open/close lock
+            _frames[image.file_id()] = move(resumed_frames[i]);
+            lock.unlock();
+            CARTA::ImageProperties source;
+            source.set_directory(image.directory());
+            source.set_file(image.file());
+            source.set_hdu(image.hdu());
+            source.set_file_id(image.file_id());
+            std::unique_lock<std::mutex> state_lock(_view_state_mutex);
+            _image_sources[image.file_id()] = source;
+            state_lock.unlock();
+            resumed_images.emplace_back(i, true);
         } else {
-            CARTA::OpenFile open_file_msg;
-            open_file_msg.set_directory(image.directory());
-            open_file_msg.set_file(image.file());
-            open_file_msg.set_hdu(image.hdu());
-            open_file_msg.set_file_id(image.file_id());
-
-            // Open a file
-            if (!OnOpenFile(open_file_msg, request_id, true)) {
-                success = false;
-                file_ok = false;
-                err_file_ids.append(std::to_string(image.file_id()) + " ");
-            }
+            success = false;
+            file_ok = false;
+            err_file_ids.append(std::to_string(image.file_id()) + " ");
         }
 
         if (file_ok) {
@@ -1008,6 +1295,7 @@ void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t requ
                 if (region_id_info.first == 0) {
                     CARTA::Point cursor = region_id_info.second.control_points(0);
                     CARTA::SetCursor set_cursor_msg;
+                    set_cursor_msg.set_file_id(image.file_id());
                     *set_cursor_msg.mutable_point() = cursor;
                     OnSetCursor(set_cursor_msg, request_id);
                 } else {
@@ -1023,33 +1311,211 @@ void Session::OnResumeSession(const CARTA::ResumeSession& message, uint32_t requ
                     }
                 }
             }
+        }
+    }
+
+    if (!success) {
+        err_message = err_file_ids + err_region_ids;
+    }
+    return success;
+}
 
-            // Set contours
-            if (image.contour_settings().levels_size()) {
-                OnSetContourParameters(image.contour_settings(), true);
+bool Session::Hibernate() {
+    if (_hibernated_view || (GetRefCount() > 1) || AnimationRunning()) {
+        return false;
+    }
+
+    auto view = std::make_unique<HibernatedView>();
+    std::unique_lock<std::mutex> lock(_frame_mutex);
+    if (_frames.empty()) {
+        return false;
+    }
+    std::unordered_map<int, RegionState> region_states;
+    if (_region_handler) {
+        region_states = _region_handler->GetRegionStates();
+    }
+
+    std::unique_lock<std::mutex> state_lock(_view_state_mutex);
+    for (auto& [file_id, frame] : _frames) {
+        if (!_image_sources.count(file_id)) {
+            // Images generated in memory cannot be opened again
+            return false;
+        }
+        auto* image = view->images.add_images();
+        *image = _image_sources.at(file_id);
+        image->set_channel(frame->CurrentZ());
+        image->set_stokes(frame->CurrentStokes());
+
+        auto cursor = frame->GetCursor();
+        CARTA::Point* cursor_point = (*image->mutable_regions())[CURSOR_REGION_ID].add_control_points();
+        cursor_point->set_x(cursor.x);
+        cursor_point->set_y(cursor.y);
+        for (auto& [region_id, region_state] : region_states) {
+            if (region_state.reference_file_id == file_id) {
+                CARTA::RegionInfo& region_info = (*image->mutable_regions())[region_id];
+                region_info.set_region_type(region_state.type);
+                *region_info.mutable_control_points() = {region_state.control_points.begin(), region_state.control_points.end()};
+                region_info.set_rotation(region_state.rotation);
             }
         }
     }
+    view->messages = _view_messages;
+    state_lock.unlock();
+    lock.unlock();
 
-    // Open Catalog files
-    for (int i = 0; i < message.catalog_files_size(); ++i) {
-        const CARTA::OpenCatalogFile& open_catalog_file_msg = message.catalog_files(i);
-        OnOpenCatalogFile(open_catalog_file_msg, request_id, true);
+    // Closing the images releases their loaders and the caches of the frames and regions
+    int num_images(view->images.images_size());
+    CARTA::CloseFile close_file_msg;
+    close_file_msg.set_file_id(ALL_FILES);
+    OnCloseFile(close_file_msg);
+    _loader.reset();
+    _loader_file_key.clear();
+    _hibernated_view = std::move(view);
+
+    spdlog::info("Session {} [{}] hibernated: closed {} images.", GetId(), GetAddress(), num_images);
+    carta::MemoryBudget::Global().LogUsage();
+    return true;
+}
+
+void Session::Rehydrate() {
+    if (!_hibernated_view) {
+        return;
     }
+    auto view = std::move(_hibernated_view);
+    auto t_start_rehydrate = std::chrono::high_resolution_clock::now();
 
-    // Measure duration for resume
-    auto t_end_resume = std::chrono::high_resolution_clock::now();
-    auto dt_resume = std::chrono::duration_cast<std::chrono::microseconds>(t_end_resume - t_start_resume).count();
-    spdlog::performance("Resume in {:.3f} ms", dt_resume * 1e-3);
+    // The frontend still has the data of its view, so nothing is sent for the restored state
+    std::vector<std::pair<int, bool>> resumed_images;
+    std::string err_message;
+    bool success = ResumeImages(view->images, 0, true, resumed_images, err_message);
+
+    for (auto& [key, serialized_message] : view->messages) {
+        switch (std::get<0>(key)) {
+            case CARTA::EventType::SET_SPATIAL_REQUIREMENTS: {
+                CARTA::SetSpatialRequirements message;
+                if (message.ParseFromString(serialized_message)) {
+                    OnSetSpatialRequirements(message, true);
+                }
+                break;
+            }
+            case CARTA::EventType::SET_HISTOGRAM_REQUIREMENTS: {
+                CARTA::SetHistogramRequirements message;
+                if (message.ParseFromString(serialized_message)) {
+                    OnSetHistogramRequirements(message, 0, true);
+                }
+                break;
+            }
+            case CARTA::EventType::SET_SPECTRAL_REQUIREMENTS: {
+                CARTA::SetSpectralRequirements message;
+                if (message.ParseFromString(serialized_message)) {
+                    OnSetSpectralRequirements(message, true);
+                }
+                break;
+            }
+            case CARTA::EventType::SET_STATS_REQUIREMENTS: {
+                CARTA::SetStatsRequirements message;
+                if (message.ParseFromString(serialized_message)) {
+                    OnSetStatsRequirements(message, true);
+                }
+                break;
+            }
+            case CARTA::EventType::SET_CONTOUR_PARAMETERS: {
+                CARTA::SetContourParameters message;
+                if (message.ParseFromString(serialized_message)) {
+                    OnSetContourParameters(message, true);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
 
-    // RESPONSE
-    CARTA::ResumeSessionAck ack;
-    ack.set_success(success);
+    auto t_end_rehydrate = std::chrono::high_resolution_clock::now();
+    auto dt_rehydrate = std::chrono::duration_cast<std::chrono::microseconds>(t_end_rehydrate - t_start_rehydrate).count();
+    spdlog::info("Session {} [{}] woke from hibernation.", GetId(), GetAddress());
+    spdlog::performance("Rehydrate in {:.3f} ms", dt_rehydrate * 1e-3);
     if (!success) {
-        err_message = err_file_ids + err_region_ids;
-        ack.set_message(err_message);
+        SendLogEvent(err_message, {"resume_session"}, CARTA::ErrorSeverity::ERROR);
+    }
+}
+
+void Session::RecordViewMessage(CARTA::EventType event_type, int file_id, int region_id, const google::protobuf::MessageLite& message) {
+    std::unique_lock<std::mutex> lock(_view_state_mutex);
+    _view_messages[std::make_tuple(event_type, file_id, region_id)] = message.SerializeAsString();
+}
+
+void Session::RemoveFileViewState(int file_id) {
+    std::unique_lock<std::mutex> lock(_view_state_mutex);
+    for (auto it = _view_messages.begin(); it != _view_messages.end();) {
+        if ((file_id == ALL_FILES) || (std::get<1>(it->first) == file_id)) {
+            it = _view_messages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (file_id == ALL_FILES) {
+        _image_sources.clear();
+    } else {
+        _image_sources.erase(file_id);
+    }
+}
+
+void Session::RemoveRegionViewState(int region_id) {
+    std::unique_lock<std::mutex> lock(_view_state_mutex);
+    for (auto it = _view_messages.begin(); it != _view_messages.end();) {
+        int message_region_id = std::get<2>(it->first);
+        if ((region_id == ALL_REGIONS) ? (message_region_id > CURSOR_REGION_ID) : (message_region_id == region_id)) {
+            it = _view_messages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Session::OnSharedMemoryRequest(uint32_t request_id) {
+    CARTA::data::SharedMemoryAck ack;
+    std::string error;
+    if (_message_sink) {
+        error = "Shared memory needs a socket.";
+    } else if (!_shared_memory) {
+        _shared_memory = carta::SharedMemoryRing::Create(_id, error);
+    }
+
+    if (_shared_memory) {
+        ack.set_success(true);
+        ack.set_name(_shared_memory->Name());
+        ack.set_capacity(_shared_memory->Capacity());
+        ack.set_threshold(carta::SharedMemoryRing::Threshold());
+        spdlog::info("Session {} may receive large messages through shared memory {}.", _id, _shared_memory->Name());
+    } else {
+        ack.set_success(false);
+        ack.set_message(error);
+        spdlog::debug("Session {} shared memory request refused: {}", _id, error);
+    }
+    SendEvent(static_cast<CARTA::EventType>(SHARED_MEMORY_ACK_EVENT_TYPE), request_id, ack, false);
+}
+
+std::shared_ptr<Frame> Session::OpenResumedFrame(const CARTA::ImageProperties& image) {
+    casacore::String full_name(GetResolvedFilename(_top_level_folder, image.directory(), image.file()));
+    if (full_name.empty()) {
+        spdlog::error("Session {}: file {} does not exist.", _id, image.file());
+        return nullptr;
+    }
+
+    // Frame owns loader
+    auto frame = std::make_shared<Frame>(_id, carta::FileLoader::GetLoader(full_name), image.hdu());
+    return frame->IsValid() ? frame : nullptr;
+}
+
+void Session::ResumeImageData(int file_id, bool send_histogram, const CARTA::SetContourParameters& contour_settings) {
+    if (send_histogram && !SendRegionHistogramData(file_id, IMAGE_REGION_ID)) {
+        std::string message = fmt::format("Image histogram for file id {} failed", file_id);
+        SendLogEvent(message, {"resume_session"}, CARTA::ErrorSeverity::ERROR);
+    }
+    if (contour_settings.levels_size()) {
+        OnSetContourParameters(contour_settings, true);
     }
-    SendEvent(CARTA::EventType::RESUME_SESSION_ACK, request_id, ack);
 }
 
 void Session::OnCatalogFileList(CARTA::CatalogListRequest file_list_request, uint32_t request_id) {
@@ -1161,7 +1627,7 @@ void Session::OnSaveFile(const CARTA::SaveFile& save_file, uint32_t request_id)
             }
         } else {
             // Save full image
-            _frames.at(file_id)->SaveFile(_top_level_folder, save_file, save_file_ack, nullptr);
+            active_frame->SaveFile(_top_level_folder, save_file, save_file_ack, nullptr);
         }
 
         // Send response message
@@ -1172,14 +1638,19 @@ void Session::OnSaveFile(const CARTA::SaveFile& save_file, uint32_t request_id)
     }
 }
 
-void Session::OnSpectralLineRequest(CARTA::SpectralLineRequest spectral_line_request, uint32_t request_id) {
-    CARTA::SpectralLineResponse spectral_line_response;
-    carta::SpectralLineCrawler::SendRequest(
-        spectral_line_request.frequency_range(), spectral_line_request.line_intensity_lower_limit(), spectral_line_response);
-    SendEvent(CARTA::EventType::SPECTRAL_LINE_RESPONSE, request_id, spectral_line_response);
+void Session::OnSpectralLineRequest(const CARTA::SpectralLineRequest& spectral_line_request, uint32_t request_id) {
+    // The response may be sent from the query thread, after the task is done
+    IncreaseRefCount();
+    carta::SpectralLineCrawler::SendRequest(spectral_line_request.frequency_range(), spectral_line_request.line_intensity_lower_limit(),
+        [this, request_id](CARTA::SpectralLineResponse& spectral_line_response) {
+            SendEvent(CARTA::EventType::SPECTRAL_LINE_RESPONSE, request_id, spectral_line_response);
+            if (!DecreaseRefCount()) {
+                delete this;
+            }
+        });
 }
 
-bool Session::OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint32_t request_id) {
+bool Session::OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint32_t request_id, bool silent) {
     bool success(false);
     if (!_stokes_files_connector) {
         _stokes_files_connector = std::make_unique<StokesFilesConnector>(_top_level_folder);
@@ -1192,6 +1663,12 @@ bool Session::OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint3
     if (_stokes_files_connector->DoConcat(message, response, concatenated_image, concatenated_name)) {
         auto* open_file_ack = response.mutable_open_file_ack();
         if (OnOpenFile(message.file_id(), concatenated_name, concatenated_image, open_file_ack)) {
+            CARTA::ImageProperties source;
+            *source.mutable_stokes_files() = message.stokes_files();
+            source.set_file_id(message.file_id());
+            std::unique_lock<std::mutex> state_lock(_view_state_mutex);
+            _image_sources[message.file_id()] = source;
+            state_lock.unlock();
             success = true;
         } else {
             spdlog::error("Fail to open the concatenated stokes image!");
@@ -1200,7 +1677,9 @@ bool Session::OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint3
         spdlog::error("Fail to concatenate stokes files!");
     }
 
-    SendEvent(CARTA::EventType::CONCAT_STOKES_FILES_ACK, request_id, response);
+    if (!silent) {
+        SendEvent(CARTA::EventType::CONCAT_STOKES_FILES_ACK, request_id, response);
+    }
     return success;
 }
 
@@ -1222,25 +1701,16 @@ bool Session::CalculateCubeHistogram(int file_id, CARTA::RegionHistogramData& cu
             auto num_bins = cube_histogram_config.num_bins;
 
             // To send periodic updates
+            auto cancel_token = _histogram_cancellation.Current();
             _histogram_progress = HISTOGRAM_START;
             auto t_start = std::chrono::high_resolution_clock::now();
             int request_id(0);
             size_t depth(_frames.at(file_id)->Depth());
             size_t total_z(depth * 2); // for progress; go through z twice, for stats then histogram
 
-            // stats for entire cube
-            carta::BasicStats<float> cube_stats;
-            for (size_t z = 0; z < depth; ++z) {
-                // stats for this z
-                carta::BasicStats<float> z_stats;
-                if (!_frames.at(file_id)->GetBasicStats(z, stokes, z_stats)) {
-                    return calculated;
-                }
-                cube_stats.join(z_stats);
-
-                // check for cancel
-                if (_histogram_context.is_group_execution_cancelled()) {
-                    break;
+            auto send_progress = [&](float progress) {
+                if (cancel_token.IsCancelled()) {
+                    return false;
                 }
 
                 // check for progress update
@@ -1248,70 +1718,73 @@ bool Session::CalculateCubeHistogram(int file_id, CARTA::RegionHistogramData& cu
                 auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
                 if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS) {
                     // send progress
-                    float this_z(z);
-                    float progress = this_z / total_z;
                     CARTA::RegionHistogramData progress_msg;
                     CreateCubeHistogramMessage(progress_msg, file_id, stokes, progress);
-                    auto message_histogram = progress_msg.add_histograms();
+                    progress_msg.add_histograms();
                     SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, progress_msg);
                     t_start = t_end;
                 }
-            }
+                return true;
+            };
+
+            // A worker calculates the stats and histogram if the worker pool has workers; otherwise the stats for entire cube, where
+            // channels are calculated in parallel and cached, so a cancelled calculation resumes
+            carta::BasicStats<float> cube_stats;
+            carta::Histogram cube_histogram;
+            auto remote_job =
+                _frames.at(file_id)->CalculateRemoteCubeHistogram(stokes, num_bins, cube_stats, cube_histogram, send_progress);
+            bool remote(remote_job != carta::RemoteJob::Unavailable);
+            auto stats_progress = [&](size_t num_z_done) { return send_progress((float)num_z_done / total_z); };
+            bool have_stats = remote ? (remote_job == carta::RemoteJob::Done)
+                                     : _frames.at(file_id)->CalculateCubeStats(stokes, cube_stats, stats_progress);
 
             // check cancel and proceed
-            if (!_histogram_context.is_group_execution_cancelled()) {
+            if (have_stats && !cancel_token.IsCancelled()) {
                 _frames.at(file_id)->CacheCubeStats(stokes, cube_stats);
 
-                // send progress message: half done
-                float progress = 0.50;
-                CARTA::RegionHistogramData half_progress;
-                CreateCubeHistogramMessage(half_progress, file_id, stokes, progress);
-                half_progress.add_histograms();
-                SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, half_progress);
-
-                // get histogram bins for each z and accumulate bin counts in cube_bins
-                carta::Histogram z_histogram; // histogram for each z using cube stats
-                carta::Histogram cube_histogram;
-                for (size_t z = 0; z < depth; ++z) {
-                    if (!_frames.at(file_id)->CalculateHistogram(CUBE_REGION_ID, z, stokes, num_bins, cube_stats, z_histogram)) {
-                        return calculated; // z histogram failed
-                    }
-
-                    if (z == 0) {
-                        cube_histogram = std::move(z_histogram);
-                    } else {
-                        cube_histogram.Add(z_histogram);
-                    }
+                bool have_histogram(remote);
+                if (!remote) {
+                    // send progress message: half done
+                    float progress = 0.50;
+                    CARTA::RegionHistogramData half_progress;
+                    CreateCubeHistogramMessage(half_progress, file_id, stokes, progress);
+                    half_progress.add_histograms();
+                    SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, half_progress);
+
+                    // accumulate histogram bins for each z using cube stats; partial histogram is kept by Frame if cancelled
+                    auto histogram_progress = [&](size_t num_z_done, const carta::Histogram& partial_histogram) {
+                        if (cancel_token.IsCancelled()) {
+                            return false;
+                        }
 
-                    // check for cancel
-                    if (_histogram_context.is_group_execution_cancelled()) {
-                        break;
-                    }
+                        auto t_end = std::chrono::high_resolution_clock::now();
+                        auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
+                        if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS) {
+                            // Send progress update
+                            float progress = 0.5 + ((float)num_z_done / total_z);
+                            CARTA::RegionHistogramData progress_msg;
+                            CreateCubeHistogramMessage(progress_msg, file_id, stokes, progress);
+                            auto message_histogram = progress_msg.add_histograms();
+                            message_histogram->set_channel(ALL_Z);
+                            message_histogram->set_num_bins(partial_histogram.GetNbins());
+                            message_histogram->set_bin_width(partial_histogram.GetBinWidth());
+                            message_histogram->set_first_bin_center(partial_histogram.GetBinCenter());
+                            message_histogram->set_mean(cube_stats.mean);
+                            message_histogram->set_std_dev(cube_stats.stdDev);
+                            auto& bins = partial_histogram.GetHistogramBins();
+                            *message_histogram->mutable_bins() = {bins.begin(), bins.end()};
+                            SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, progress_msg);
+                            t_start = t_end;
+                        }
+                        return true;
+                    };
 
-                    auto t_end = std::chrono::high_resolution_clock::now();
-                    auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count();
-                    if ((dt / 1e6) > UPDATE_HISTOGRAM_PROGRESS_PER_SECONDS) {
-                        // Send progress update
-                        float this_z(z);
-                        progress = 0.5 + (this_z / total_z);
-                        CARTA::RegionHistogramData progress_msg;
-                        CreateCubeHistogramMessage(progress_msg, file_id, stokes, progress);
-                        auto message_histogram = progress_msg.add_histograms();
-                        message_histogram->set_channel(ALL_Z);
-                        message_histogram->set_num_bins(cube_histogram.GetNbins());
-                        message_histogram->set_bin_width(cube_histogram.GetBinWidth());
-                        message_histogram->set_first_bin_center(cube_histogram.GetBinCenter());
-                        message_histogram->set_mean(cube_stats.mean);
-                        message_histogram->set_std_dev(cube_stats.stdDev);
-                        auto& bins = cube_histogram.GetHistogramBins();
-                        *message_histogram->mutable_bins() = {bins.begin(), bins.end()};
-                        SendFileEvent(file_id, CARTA::EventType::REGION_HISTOGRAM_DATA, request_id, progress_msg);
-                        t_start = t_end;
-                    }
+                    have_histogram =
+                        _frames.at(file_id)->CalculateCubeHistogram(stokes, num_bins, cube_stats, cube_histogram, histogram_progress);
                 }
 
                 // set completed cube histogram
-                if (!_histogram_context.is_group_execution_cancelled()) {
+                if (have_histogram && !cancel_token.IsCancelled()) {
                     cube_histogram_message.set_file_id(file_id);
                     cube_histogram_message.set_region_id(CUBE_REGION_ID);
                     cube_histogram_message.set_stokes(stokes);
@@ -1334,6 +1807,7 @@ bool Session::CalculateCubeHistogram(int file_id, CARTA::RegionHistogramData& cu
                     auto t_end_cube_histogram = std::chrono::high_resolution_clock::now();
                     auto dt_cube_histogram =
                         std::chrono::duration_cast<std::chrono::microseconds>(t_end_cube_histogram - t_start_cube_histogram).count();
+                    carta::LatencyHistograms::Record(carta::LatencyPoint::Histogram, dt_cube_histogram);
                     spdlog::performance("Fill cube histogram in {:.3f} ms at {:.3f} MPix/s", dt_cube_histogram * 1e-3,
                         (float)cube_stats.num_pixels / dt_cube_histogram);
 
@@ -1511,58 +1985,45 @@ bool Session::SendContourData(int file_id, bool ignore_empty) {
             }
         }
 
-        int64_t total_vertices = 0;
+        // Resend contours calculated before for this channel, by the session or the prefetcher
+        int z(frame->CurrentZ()), stokes(frame->CurrentStokes());
+        // Only use deflate compression if contours don't have ZSTD compression
+        bool deflate(ContourCompressionLevel(settings) < 1);
+        std::vector<CARTA::ContourImageData> messages;
+        if (frame->GetContourCache().Get(z, stokes, settings, messages)) {
+            for (auto& message : messages) {
+                message.set_file_id(file_id);
+                SendFileEvent(file_id, CARTA::EventType::CONTOUR_IMAGE_DATA, 0, message, deflate);
+            }
+            return true;
+        }
 
+        std::mutex messages_mutex;
         auto callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int>& indices) {
             CARTA::ContourImageData partial_response;
             partial_response.set_file_id(file_id);
-            // Currently only supports identical reference file IDs
-            partial_response.set_reference_file_id(settings.reference_file_id);
-            partial_response.set_channel(frame->CurrentZ());
-            partial_response.set_stokes(frame->CurrentStokes());
-            partial_response.set_progress(progress);
-
-            std::vector<char> compression_buffer;
-            const float pixel_rounding = std::max(1, std::min(32, settings.decimation));
-#if _DISABLE_CONTOUR_COMPRESSION_
-            const int compression_level = 0;
-#else
-            const int compression_level = std::max(0, std::min(20, settings.compression_level));
-#endif
-            // Fill contour set
-            auto contour_set = partial_response.add_contour_sets();
-            contour_set->set_level(level);
-
-            const int N = vertices.size();
-            total_vertices += N;
-
-            if (N) {
-                if (compression_level < 1) {
-                    contour_set->set_raw_coordinates(vertices.data(), N * sizeof(float));
-                    contour_set->set_uncompressed_coordinates_size(N * sizeof(float));
-                    contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
-                    contour_set->set_decimation_factor(0);
-                } else {
-                    std::vector<int32_t> vertices_shuffled;
-                    RoundAndEncodeVertices(vertices, vertices_shuffled, pixel_rounding);
-
-                    // Compress using Zstd library
-                    const size_t src_size = N * sizeof(int32_t);
-                    compression_buffer.resize(ZSTD_compressBound(src_size));
-                    size_t compressed_size = ZSTD_compress(
-                        compression_buffer.data(), compression_buffer.size(), vertices_shuffled.data(), src_size, compression_level);
-
-                    contour_set->set_raw_coordinates(compression_buffer.data(), compressed_size);
-                    contour_set->set_raw_start_indices(indices.data(), indices.size() * sizeof(int32_t));
-                    contour_set->set_uncompressed_coordinates_size(src_size);
-                    contour_set->set_decimation_factor(pixel_rounding);
-                }
-            }
-            // Only use deflate compression if contours don't have ZSTD compression
-            SendFileEvent(partial_response.file_id(), CARTA::EventType::CONTOUR_IMAGE_DATA, 0, partial_response, compression_level < 1);
+            FillContourData(partial_response, z, stokes, level, progress, vertices, indices, settings);
+            SendFileEvent(partial_response.file_id(), CARTA::EventType::CONTOUR_IMAGE_DATA, 0, partial_response, deflate);
+            std::unique_lock<std::mutex> lock(messages_mutex);
+            messages.push_back(std::move(partial_response));
         };
 
-        if (frame->ContourImage(callback)) {
+        // Coarse contours are sent first, with progress 0 so the frontend can replace them with the refined ones
+        auto preview_callback = [&](double level, double progress, const std::vector<float>& vertices, const std::vector<int>& indices) {
+            CARTA::ContourImageData preview_response;
+            preview_response.set_file_id(file_id);
+            FillContourData(preview_response, z, stokes, level, 0.0, vertices, indices, settings);
+            SendFileEvent(preview_response.file_id(), CARTA::EventType::CONTOUR_IMAGE_DATA, 0, preview_response, deflate);
+        };
+
+        ContourCallback preview_contour_callback(preview_callback);
+        auto cancel_token = frame->NewContourRequest();
+        bool contoured = frame->ContourImage(cancel_token, callback, &preview_contour_callback);
+        if (cancel_token.IsCancelled()) {
+            return false; // replaced by a later request, or the file was closed; partial contours are not cached
+        }
+        if (contoured) {
+            frame->GetContourCache().Put(z, stokes, settings, std::move(messages));
             return true;
         }
         SendLogEvent("Error processing contours", {"contours"}, CARTA::ErrorSeverity::WARNING);
@@ -1591,6 +2052,8 @@ void Session::UpdateImageData(int file_id, bool send_image_histogram, bool z_cha
 
 void Session::UpdateRegionData(int file_id, int region_id, bool z_changed, bool stokes_changed) {
     // Send updated data for user-set regions with requirements when z, stokes, or region changes.
+    // Region stats and histograms of the current channel share one read of the region pixels.
+    carta::RegionHandler::RegionDataScope region_data_scope;
     if (stokes_changed) {
         SendSpectralProfileData(file_id, region_id, stokes_changed);
     }
@@ -1623,47 +2086,133 @@ void Session::RegionDataStreams(int file_id, int region_id) {
 // SEND uWEBSOCKET MESSAGES
 
 // Sends an event to the client with a given event name (padded/concatenated to 32 characters) and a given ProtoBuf message
-void Session::SendEvent(CARTA::EventType event_type, uint32_t event_id, const google::protobuf::MessageLite& message, bool compress) {
+void Session::SendEvent(CARTA::EventType event_type, uint32_t event_id, const google::protobuf::MessageLite& message, bool compress,
+    const OutgoingMessageKey& key) {
     LogSentEventType(event_type);
+    carta::TraceContext trace_context;
+    trace_context.session_id = _id;
+    trace_context.file_id = key.file_id;
+    trace_context.region_id = key.region_id;
+    trace_context.request_id = event_id;
+    carta::TraceSpan trace_span("send", "message", trace_context);
+    if (trace_span.Traced()) {
+        trace_span.SetDetail(CARTA::EventType_Name(event_type));
+    }
+    carta::PhaseScope send_phase(carta::RequestPhase::Send);
+    if (auto request = carta::SlowRequestLog::ThreadRecord()) {
+        // Requests such as SET_CURSOR name their file only in the messages sent in reply
+        if (request->file_id < 0) {
+            request->file_id = key.file_id;
+            request->region_id = key.region_id;
+        }
+        request->last_send = std::chrono::steady_clock::now();
+    }
 
+    // Header and message are written in place in a pooled buffer, which is moved through the queue to the socket
     size_t message_length = message.ByteSizeLong();
     size_t required_size = message_length + sizeof(carta::EventHeader);
-    std::pair<std::vector<char>, bool> msg_vs_compress;
-    std::vector<char>& msg = msg_vs_compress.first;
-    msg.resize(required_size, 0);
+    OutgoingMessage out_msg;
+    out_msg.data = _out_msgs.AcquireBuffer(required_size);
+    std::vector<char>& msg = out_msg.data;
     carta::EventHeader* head = (carta::EventHeader*)msg.data();
 
     head->type = event_type;
     head->icd_version = carta::ICD_VERSION;
     head->request_id = event_id;
-    message.SerializeToArray(msg.data() + sizeof(carta::EventHeader), message_length);
-    // Skip compression on files smaller than 1 kB
-    msg_vs_compress.second = compress && required_size > 1024;
-    _out_msgs.push(msg_vs_compress);
+    // Sizes were cached by ByteSizeLong, so the message is not sized again
+    message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(msg.data() + sizeof(carta::EventHeader)));
+    // Messages compressed already, such as ZFP tiles, are not deflated again
+    out_msg.compress = compress && carta::CompressionPolicy::Global().Deflate(event_type, required_size);
+    out_msg.key = key;
+    _queued_bytes_total += required_size;
+
+    if (_message_sink) {
+        // Without a socket, the message is passed on from the producing thread
+        _message_sink(std::string_view(msg.data(), required_size));
+        _out_msgs.RecycleBuffer(std::move(out_msg.data));
+        return;
+    }
+
+    // Producers on worker threads wait while the queue is full; the loop thread must never block since it drains the queue
+    bool wait = std::this_thread::get_id() != _loop_thread_id;
+    if (!_out_msgs.Push(std::move(out_msg), wait)) {
+        return;
+    }
 
     // uWS::Loop::defer(function) is the only thread-safe function, use it to defer the calling of a function to the thread that runs the
     // Loop.
-    _loop->defer([&]() {
-        std::pair<std::vector<char>, bool> msg;
-        if (_connected) {
-            while (_out_msgs.try_pop(msg)) {
-                auto expected_buffered_amount = msg.first.size() + _socket->getBufferedAmount();
-                if (expected_buffered_amount > MAX_BACKPRESSURE) {
-                    spdlog::warn("Exceeded maximum backpressure: client {} [{}]. Buffered amount: {} (bytes). May lose some messages.",
-                        GetId(), GetAddress(), expected_buffered_amount);
-                }
-                std::string_view sv(msg.first.data(), msg.first.size());
-                _socket->send(sv, uWS::OpCode::BINARY, msg.second);
-            }
+    _loop->defer([this]() { SendQueuedMessages(); });
+}
+
+void Session::SendQueuedMessages() {
+    // Called on the loop thread, when messages are queued and when the socket drains
+    if (!_connected) {
+        return;
+    }
+
+    OutgoingMessage msg;
+    while (_socket->getBufferedAmount() < OUTGOING_BUFFER_HIGH_WATER && _out_msgs.TryPop(msg)) {
+        auto expected_buffered_amount = msg.data.size() + _socket->getBufferedAmount();
+        if (expected_buffered_amount > MAX_BACKPRESSURE) {
+            spdlog::warn("Exceeded maximum backpressure: client {} [{}]. Buffered amount: {} (bytes). May lose some messages.", GetId(),
+                GetAddress(), expected_buffered_amount);
         }
-    });
+        if (!SendSharedMemoryHandle(msg)) {
+            std::string_view sv(msg.data.data(), msg.data.size());
+            _socket->send(sv, uWS::OpCode::BINARY, msg.compress);
+        }
+        _out_msgs.RecycleBuffer(std::move(msg.data)); // uWS has written or buffered the data
+    }
+}
+
+bool Session::SendSharedMemoryHandle(const OutgoingMessage& msg) {
+    uint64_t position;
+    if (!_shared_memory || (msg.data.size() <= carta::SharedMemoryRing::Threshold()) ||
+        !_shared_memory->Write(msg.data.data(), msg.data.size(), position)) {
+        return false;
+    }
+
+    // The handle keeps the request id of the message, so the client can pass the message on as if it came on the socket
+    CARTA::data::SharedMemoryHandle handle;
+    handle.set_position(position);
+    handle.set_length(msg.data.size());
+    std::vector<char> handle_msg(sizeof(carta::EventHeader) + handle.ByteSizeLong());
+    carta::EventHeader* head = (carta::EventHeader*)handle_msg.data();
+    head->type = SHARED_MEMORY_MESSAGE_EVENT_TYPE;
+    head->icd_version = carta::ICD_VERSION;
+    head->request_id = reinterpret_cast<const carta::EventHeader*>(msg.data.data())->request_id;
+    handle.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(handle_msg.data() + sizeof(carta::EventHeader)));
+    _socket->send(std::string_view(handle_msg.data(), handle_msg.size()), uWS::OpCode::BINARY, false);
+    return true;
 }
 
 void Session::SendFileEvent(
     int32_t file_id, CARTA::EventType event_type, uint32_t event_id, google::protobuf::MessageLite& message, bool compress) {
     // do not send if file is closed
     if (_frames.count(file_id)) {
-        SendEvent(event_type, event_id, message, compress);
+        // Tag image data streams so that newer data can replace queued data
+        OutgoingMessageKey key;
+        switch (event_type) {
+            case CARTA::EventType::RASTER_TILE_DATA: {
+                auto& tile_message = static_cast<CARTA::RasterTileData&>(message);
+                key = {event_type, tile_message.file_id(), -1, tile_message.channel(), tile_message.stokes()};
+                break;
+            }
+            case CARTA::EventType::SPATIAL_PROFILE_DATA: {
+                auto& profile_message = static_cast<CARTA::SpatialProfileData&>(message);
+                key = {event_type, profile_message.file_id(), profile_message.region_id(), profile_message.channel(),
+                    profile_message.stokes()};
+                break;
+            }
+            case CARTA::EventType::CONTOUR_IMAGE_DATA: {
+                auto& contour_message = static_cast<CARTA::ContourImageData&>(message);
+                key = {event_type, contour_message.file_id(), -1, contour_message.channel(), contour_message.stokes()};
+                break;
+            }
+            default:
+                break;
+        }
+        SendEvent(event_type, event_id, message, compress, key);
     }
 }
 
@@ -1702,7 +2251,7 @@ void Session::BuildAnimationObject(CARTA::StartAnimation& msg, uint32_t request_
     if (_frames.count(file_id)) {
         _frames.at(file_id)->SetAnimationViewSettings(msg.required_tiles());
         _animation_object = std::unique_ptr<AnimationObject>(new AnimationObject(file_id, start_frame, first_frame, last_frame, delta_frame,
-            msg.matched_frames(), frame_rate, looping, reverse_at_end, always_wait));
+            msg.matched_frames(), frame_rate, looping, reverse_at_end, always_wait, &_cancellation));
         ack_message.set_success(true);
         ack_message.set_animation_id(_animation_id);
         ack_message.set_message("Starting animation");
@@ -1727,7 +2276,7 @@ void Session::ExecuteAnimationFrameInner() {
             auto active_frame_z = curr_frame.channel();
             auto active_frame_stokes = curr_frame.stokes();
 
-            if ((_animation_object->_tbb_context).is_group_execution_cancelled()) {
+            if (_animation_object->IsCancelled()) {
                 return;
             }
 
@@ -1857,7 +2406,9 @@ bool Session::ExecuteAnimationFrame() {
         }
 
         curr_frame = _animation_object->_next_frame;
+        size_t start_bytes = _queued_bytes_total;
         ExecuteAnimationFrameInner();
+        _animation_object->FrameSent(curr_frame, start_bytes, _queued_bytes_total);
 
         CARTA::AnimationFrame tmp_frame;
         CARTA::AnimationFrame delta_frame = _animation_object->_delta_frame;
@@ -1900,6 +2451,13 @@ bool Session::ExecuteAnimationFrame() {
             }
         }
         _animation_object->_t_last = std::chrono::high_resolution_clock::now();
+
+        // Read the upcoming channels in the background while this frame is being sent
+        auto file_id(_animation_object->_file_id);
+        if (recycle_task && _frames.count(file_id)) {
+            _frames.at(file_id)->PrefetchChannels(
+                _animation_object->NextChannels(ANIMATION_PREFETCH_CHANNELS), _animation_object->_next_frame.stokes());
+        }
     }
     return recycle_task;
 }
@@ -1916,6 +2474,9 @@ void Session::StopAnimation(int file_id, const CARTA::AnimationFrame& frame) {
     }
 
     _animation_object->_stop_called = true;
+    if (_frames.count(file_id)) {
+        _frames.at(file_id)->PrefetchChannels({}, frame.stokes());
+    }
 }
 
 int Session::CalculateAnimationFlowWindow() {
@@ -1942,14 +2503,15 @@ void Session::HandleAnimationFlowControlEvt(CARTA::AnimationFlowControl& message
     int gap;
 
     _animation_object->_last_flow_frame = message.received_frame();
+    _animation_object->FrameReceived(message.received_frame());
 
     gap = CalculateAnimationFlowWindow();
 
     if (_animation_object->_waiting_flow_event) {
         if (gap <= CurrentFlowWindowSize()) {
             _animation_object->_waiting_flow_event = false;
-            OnMessageTask* tsk = new (tbb::task::allocate_root(_animation_context)) AnimationTask(this);
-            tbb::task::enqueue(*tsk);
+            OnMessageTask* tsk = new AnimationTask(this);
+            TaskScheduler::Enqueue(tsk);
         }
     }
 }
@@ -1971,6 +2533,12 @@ void Session::CancelExistingAnimation() {
 
 void Session::SendScriptingRequest(
     uint32_t scripting_request_id, std::string target, std::string action, std::string parameters, bool async) {
+    {
+        // Pending before it is sent, so that the response is kept however soon it arrives
+        std::scoped_lock lock(_scripting_mutex);
+        _scripting_responses[scripting_request_id].reset();
+    }
+
     CARTA::ScriptingRequest message;
     message.set_scripting_request_id(scripting_request_id);
     message.set_target(target);
@@ -1981,28 +2549,60 @@ void Session::SendScriptingRequest(
 }
 
 void Session::OnScriptingResponse(const CARTA::ScriptingResponse& message, uint32_t request_id) {
-    // Save response to scripting request
-    int scripting_request_id(message.scripting_request_id());
-    std::unique_lock<std::mutex> lock(_scripting_mutex);
-    _scripting_response[scripting_request_id] = message;
+    // Save response to scripting request, unless its call has given up
+    {
+        std::scoped_lock lock(_scripting_mutex);
+        auto pending = _scripting_responses.find(message.scripting_request_id());
+        if (pending == _scripting_responses.end()) {
+            spdlog::debug("Session {}: dropped late response to scripting request {}", _id, message.scripting_request_id());
+            return;
+        }
+        pending->second = message;
+    }
+    _scripting_response_received.notify_all();
 }
 
-// TODO: return pointer to original response type and copy in grpc service
-bool Session::GetScriptingResponse(uint32_t scripting_request_id, CARTA::script::ActionReply* reply) {
+bool Session::WaitForScriptingResponse(
+    uint32_t scripting_request_id, std::chrono::system_clock::time_point deadline, CARTA::script::ActionReply* reply) {
     std::unique_lock<std::mutex> lock(_scripting_mutex);
-    auto scripting_response = _scripting_response.find(scripting_request_id);
-    if (scripting_response == _scripting_response.end()) {
+    auto pending = _scripting_responses.find(scripting_request_id);
+    if (pending == _scripting_responses.end()) {
         return false;
-    } else {
-        auto msg = scripting_response->second;
-        reply->set_success(msg.success());
-        reply->set_message(msg.message());
-        reply->set_response(msg.response());
+    }
+    // Responses to the other waiting calls also wake this one. References to map elements stay valid when other requests are
+    // added, unlike iterators.
+    auto& response = pending->second;
+    _scripting_response_received.wait_until(lock, deadline, [&]() { return response || !_connected; });
+    bool received(response);
+    if (received) {
+        reply->set_success(response->success());
+        reply->set_message(response->message());
+        reply->set_response(response->response());
+    }
+    _scripting_responses.erase(scripting_request_id);
+    return received;
+}
 
-        _scripting_response.erase(scripting_request_id);
+std::shared_ptr<Frame> Session::GetFrame(int file_id) {
+    std::unique_lock<std::mutex> lock(_frame_mutex);
+    auto it = _frames.find(file_id);
+    return (it == _frames.end() ? nullptr : it->second);
+}
 
-        return true;
+bool Session::GetRegionImage(int file_id, int region_id, const AxisRange& z_range, int stokes, casacore::ImageRegion& region) {
+    auto frame = GetFrame(file_id);
+    if (!frame) {
+        return false;
+    }
+    if (region_id <= 0) {
+        return frame->GetImageRegion(file_id, z_range, stokes, region);
     }
+    return _region_handler && _region_handler->ApplyRegionToFrame(region_id, file_id, frame, z_range, stokes, region);
+}
+
+bool Session::GetRegionPath(int file_id, int region_id, std::vector<PointXy>& path) {
+    auto frame = GetFrame(file_id);
+    return frame && _region_handler && _region_handler->GetRegionPath(region_id, file_id, frame, path);
 }
 
 void Session::StopImageFileList() {
@@ -10,10 +10,17 @@
 #define CARTA_BACKEND__SESSION_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -44,15 +51,19 @@
 #include <carta-protobuf/stop_moment_calc.pb.h>
 #include <carta-protobuf/tiles.pb.h>
 
+#include <carta-data/carta_data.pb.h>
 #include <carta-scripting-grpc/carta_service.grpc.pb.h>
 
 #include "AnimationObject.h"
+#include "Cancellation.h"
 #include "EventHeader.h"
 #include "FileList/FileListHandler.h"
 #include "FileSettings.h"
 #include "Frame.h"
+#include "OutgoingMessageQueue.h"
 #include "ImageData/StokesFilesConnector.h"
 #include "Region/RegionHandler.h"
+#include "SharedMemoryRing.h"
 #include "Table/TableController.h"
 #include "Util.h"
 
@@ -71,32 +82,37 @@ public:
         CARTA::OpenFileAck* open_file_ack);
     void OnCloseFile(const CARTA::CloseFile& message);
     void OnAddRequiredTiles(const CARTA::AddRequiredTiles& message, bool skip_data = false);
+    // Tiles of several channels for channel-map views, in blocks of channels read at once; stops when superseded
+    void OnAddRequiredChannelTiles(const CARTA::data::AddRequiredChannelTiles& message, const carta::CancellationToken& cancel_token);
     void OnSetImageChannels(const CARTA::SetImageChannels& message);
     void OnSetCursor(const CARTA::SetCursor& message, uint32_t request_id);
     bool OnSetRegion(const CARTA::SetRegion& message, uint32_t request_id, bool silent = false);
     void OnRemoveRegion(const CARTA::RemoveRegion& message);
     void OnImportRegion(const CARTA::ImportRegion& message, uint32_t request_id);
     void OnExportRegion(const CARTA::ExportRegion& message, uint32_t request_id);
-    void OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& message);
-    void OnSetHistogramRequirements(const CARTA::SetHistogramRequirements& message, uint32_t request_id);
-    void OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& message);
-    void OnSetStatsRequirements(const CARTA::SetStatsRequirements& message);
+    // Requirements set silently do not send data for them
+    void OnSetSpatialRequirements(const CARTA::SetSpatialRequirements& message, bool silent = false);
+    void OnSetHistogramRequirements(const CARTA::SetHistogramRequirements& message, uint32_t request_id, bool silent = false);
+    void OnSetSpectralRequirements(const CARTA::SetSpectralRequirements& message, bool silent = false);
+    void OnSetStatsRequirements(const CARTA::SetStatsRequirements& message, bool silent = false);
     void OnSetContourParameters(const CARTA::SetContourParameters& message, bool silent = false);
     void OnRegionListRequest(const CARTA::RegionListRequest& request, uint32_t request_id);
     void OnRegionFileInfoRequest(const CARTA::RegionFileInfoRequest& request, uint32_t request_id);
     void OnResumeSession(const CARTA::ResumeSession& message, uint32_t request_id);
+    // Maps a shared memory ring for the large messages of a frontend on the same host, if enabled; on the loop thread
+    void OnSharedMemoryRequest(uint32_t request_id);
     void OnCatalogFileList(CARTA::CatalogListRequest file_list_request, uint32_t request_id);
     void OnCatalogFileInfo(CARTA::CatalogFileInfoRequest file_info_request, uint32_t request_id);
     void OnOpenCatalogFile(CARTA::OpenCatalogFile open_file_request, uint32_t request_id, bool silent = false);
     void OnCloseCatalogFile(CARTA::CloseCatalogFile close_file_request);
     void OnCatalogFilter(CARTA::CatalogFilterRequest filter_request, uint32_t request_id);
-    void OnSpectralLineRequest(CARTA::SpectralLineRequest spectral_line_request, uint32_t request_id);
+    void OnSpectralLineRequest(const CARTA::SpectralLineRequest& spectral_line_request, uint32_t request_id);
     void OnMomentRequest(const CARTA::MomentRequest& moment_request, uint32_t request_id);
     void OnStopMomentCalc(const CARTA::StopMomentCalc& stop_moment_calc);
     void OnSaveFile(const CARTA::SaveFile& save_file, uint32_t request_id);
-    bool OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint32_t request_id);
+    bool OnConcatStokesFiles(const CARTA::ConcatStokesFiles& message, uint32_t request_id, bool silent = false);
 
-    void AddToSetChannelQueue(CARTA::SetImageChannels message, uint32_t request_id) {
+    void AddToSetChannelQueue(const CARTA::SetImageChannels& message, uint32_t request_id) {
         std::pair<CARTA::SetImageChannels, uint32_t> rp;
         // Empty current queue first.
         while (_set_channel_queues[message.file_id()].try_pop(rp)) {
@@ -104,21 +120,27 @@ public:
         _set_channel_queues[message.file_id()].push(std::make_pair(message, request_id));
     }
 
+    // Region updates for a region are coalesced while its task is pending, e.g. during a drag; returns whether a task is needed
+    bool AddToSetRegionQueue(const CARTA::SetRegion& message, uint32_t request_id);
+
     // Task handling
+    void ExecuteSetRegionEvt(int region_id);
+    // Image histogram and contours of a resumed image, sent after the resume ack
+    void ResumeImageData(int file_id, bool send_histogram, const CARTA::SetContourParameters& contour_settings);
     void ExecuteSetChannelEvt(std::pair<CARTA::SetImageChannels, uint32_t> request) {
         OnSetImageChannels(request.first);
     }
     void CancelSetHistRequirements() {
-        _histogram_context.cancel_group_execution();
-    }
-    void ResetHistContext() {
-        _histogram_context.reset();
+        _histogram_cancellation.CancelCurrent();
     }
-    tbb::task_group_context& HistContext() {
-        return _histogram_context;
+    // A histogram request after a cancel gets a new token
+    void ResetHistCancellation() {
+        if (_histogram_cancellation.Current().IsCancelled()) {
+            _histogram_cancellation.Replace();
+        }
     }
-    tbb::task_group_context& AnimationContext() {
-        return _animation_context;
+    carta::CancellationToken HistCancellation() const {
+        return _histogram_cancellation.Current();
     }
     void CancelAnimation() {
         _animation_object->CancelExecution();
@@ -129,13 +151,17 @@ public:
     void StopAnimation(int file_id, const ::CARTA::AnimationFrame& frame);
     void HandleAnimationFlowControlEvt(CARTA::AnimationFlowControl& message);
     int CurrentFlowWindowSize() {
-        return _animation_object->CurrentFlowWindowSize();
+        return _animation_object->CurrentFlowWindowSize(_out_msgs.QueuedBytes());
     }
     void CancelExistingAnimation();
     void CheckCancelAnimationOnFileClose(int file_id);
-    void AddCursorSetting(CARTA::SetCursor message, uint32_t request_id) {
+    void AddCursorSetting(const CARTA::SetCursor& message, uint32_t request_id) {
         _file_settings.AddCursorSetting(message, request_id);
     }
+    // Latest-wins requests: the token of a new request cancels the queued or running request of the same event type, file and
+    // region, so that only the newest of a burst of slider updates is run
+    carta::CancellationToken SupersedeRequest(CARTA::EventType event_type, int file_id, int region_id = -1);
+    void CancelSupersededRequests(int file_id);
     void ImageChannelLock(int fileId) {
         _image_channel_mutexes[fileId].lock();
     }
@@ -164,11 +190,18 @@ public:
     }
     void WaitForTaskCancellation();
     void ConnectCalled();
+    void SendQueuedMessages();
+    // Writes the message to the shared memory ring and sends its handle on the socket; false to send the message itself
+    bool SendSharedMemoryHandle(const OutgoingMessage& msg);
+    // Receives each sent message, EventHeader and payload, in place of the socket; for sessions replayed without a connection
+    void SetMessageSink(std::function<void(std::string_view)> sink) {
+        _message_sink = std::move(sink);
+    }
     static int NumberOfSessions() {
         return _num_sessions;
     }
-    tbb::task_group_context& Context() {
-        return _base_context;
+    carta::CancellationToken Cancellation() const {
+        return _cancellation.Current();
     }
     void SetWaitingTask(bool set_wait) {
         _animation_object->_waiting_flow_event = set_wait;
@@ -201,9 +234,20 @@ public:
     FileSettings _file_settings;
     std::unordered_map<int, tbb::concurrent_queue<std::pair<CARTA::SetImageChannels, uint32_t>>> _set_channel_queues;
 
+    // Scripting requests of the gRPC service; any number may be in flight
     void SendScriptingRequest(uint32_t scripting_request_id, std::string target, std::string action, std::string parameters, bool async);
     void OnScriptingResponse(const CARTA::ScriptingResponse& message, uint32_t request_id);
-    bool GetScriptingResponse(uint32_t scripting_request_id, CARTA::script::ActionReply* reply);
+    // Waits for the response to a request sent with SendScriptingRequest; false if the deadline passed or the session disconnected
+    // first, and the response is then dropped if it arrives
+    bool WaitForScriptingResponse(
+        uint32_t scripting_request_id, std::chrono::system_clock::time_point deadline, CARTA::script::ActionReply* reply);
+
+    // Data of open files for the gRPC data service, which runs outside the session's tasks
+    std::shared_ptr<Frame> GetFrame(int file_id);
+    // Region applied to the image of a file and extended by z range and stokes; the whole image for region_id <= 0
+    bool GetRegionImage(int file_id, int region_id, const AxisRange& z_range, int stokes, casacore::ImageRegion& region);
+    // Vertices of a line or polyline region in pixel coords of the image of a file
+    bool GetRegionPath(int file_id, int region_id, std::vector<PointXy>& path);
 
     void StopImageFileList();
     void StopCatalogFileList();
@@ -211,10 +255,29 @@ public:
     void UpdateLastMessageTimestamp();
     std::chrono::high_resolution_clock::time_point GetLastMessageTimestamp();
 
+    // Hibernation of idle sessions, on the loop thread: the images are closed and their caches released, keeping only the view
+    // (images, channels, cursors, regions, requirements and contour settings), which is restored before the next message is handled.
+    // Sessions with running tasks or animations, or with images generated in memory, are not hibernated.
+    bool Hibernate();
+    bool Hibernated() const {
+        return _hibernated_view != nullptr;
+    }
+    void Rehydrate();
+
 private:
     // File info for file list (extended info for each hdu_name)
     bool FillExtendedFileInfo(std::map<std::string, CARTA::FileInfoExtended>& hdu_info_map, CARTA::FileInfo& file_info,
         const std::string& folder, const std::string& filename, const std::string& hdu_name, std::string& message);
+    // Opens the images of a resumed session, with their channels, cursors and regions; the images resumed, by index in the message,
+    // and whether each needs its image histogram
+    bool ResumeImages(const CARTA::ResumeSession& message, uint32_t request_id, bool silent,
+        std::vector<std::pair<int, bool>>& resumed_images, std::string& err_message);
+    // View state for hibernation: the source of each image opened from a file, and the latest requirements and contour settings, as
+    // serialized messages by event type, file and region; removed with their file or region
+    void RecordViewMessage(CARTA::EventType event_type, int file_id, int region_id, const google::protobuf::MessageLite& message);
+    void RemoveFileViewState(int file_id);
+    void RemoveRegionViewState(int region_id);
+
     // File info for open file
     bool FillExtendedFileInfo(CARTA::FileInfoExtended& extended_info, CARTA::FileInfo& file_info, const std::string& folder,
         const std::string& filename, const std::string& hdu_name, std::string& message);
@@ -222,6 +285,9 @@ private:
     bool FillExtendedFileInfo(CARTA::FileInfoExtended& extended_info, std::shared_ptr<casacore::ImageInterface<float>> image,
         const std::string& filename, std::string& message);
 
+    // Frame of a resumed image, opened without changing the session so that images are opened concurrently; null if invalid
+    std::shared_ptr<Frame> OpenResumedFrame(const CARTA::ImageProperties& image);
+
     // Delete Frame(s)
     void DeleteFrame(int file_id);
 
@@ -238,7 +304,8 @@ private:
     void UpdateRegionData(int file_id, int region_id, bool z_changed, bool stokes_changed);
 
     // Send protobuf messages
-    void SendEvent(CARTA::EventType event_type, u_int32_t event_id, const google::protobuf::MessageLite& message, bool compress = true);
+    void SendEvent(CARTA::EventType event_type, u_int32_t event_id, const google::protobuf::MessageLite& message, bool compress = true,
+        const OutgoingMessageKey& key = OutgoingMessageKey());
     void SendFileEvent(
         int file_id, CARTA::EventType event_type, u_int32_t event_id, google::protobuf::MessageLite& message, bool compress = true);
     void SendLogEvent(const std::string& message, std::vector<std::string> tags, CARTA::ErrorSeverity severity);
@@ -253,12 +320,14 @@ private:
     std::string _starting_folder;
     int _grpc_port;
     bool _read_only_mode;
+    std::atomic<bool> _tile_keys_64{false}; // tiles of requests have 64-bit keys, negotiated in RegisterViewer
 
     // File browser
     FileListHandler* _file_list_handler;
 
-    // Loader for reading image from disk
+    // Loader for reading image from disk, and the file path, modification time and size it was created for
     std::unique_ptr<carta::FileLoader> _loader;
+    std::string _loader_file_key;
 
     // Frame; key is file_id; shared with RegionHandler for data streams
     std::unordered_map<int, std::shared_ptr<Frame>> _frames;
@@ -279,30 +348,54 @@ private:
     std::unordered_map<int, std::mutex> _image_channel_mutexes;
     std::unordered_map<int, bool> _image_channel_task_active;
 
+    // Manage region updates; key is region id
+    std::unordered_map<int, tbb::concurrent_queue<std::pair<CARTA::SetRegion, uint32_t>>> _set_region_queues;
+    std::unordered_map<int, bool> _set_region_task_active;
+    std::mutex _set_region_mutex;
+
     // Cube histogram progress: 0.0 to 1.0 (complete)
     float _histogram_progress;
 
-    // message queue <msg, compress>
-    tbb::concurrent_queue<std::pair<std::vector<char>, bool>> _out_msgs;
+    // Bounded queue of messages waiting for the socket
+    OutgoingMessageQueue _out_msgs;
+    std::atomic<size_t> _queued_bytes_total{0}; // bytes of all messages queued, for measuring the throughput of the link
+    std::thread::id _loop_thread_id;
+    std::function<void(std::string_view)> _message_sink;
+    // Large messages are written here instead of the socket once the client has attached; used only on the loop thread
+    std::unique_ptr<carta::SharedMemoryRing> _shared_memory;
 
-    // TBB context that enables all tasks associated with a session to be cancelled.
-    tbb::task_group_context _base_context;
+    // Token that enables all tasks associated with a session to be cancelled; replaced when the session reconnects.
+    carta::CancellationSlot _cancellation;
 
-    // TBB context to cancel histogram calculations.
-    tbb::task_group_context _histogram_context;
+    // Token to cancel histogram calculations, a child of the session token.
+    carta::CancellationSlot _histogram_cancellation{&_cancellation};
 
-    tbb::task_group_context _animation_context;
+    // Tokens of the latest supersedable requests, by event type, file and region
+    std::map<std::tuple<CARTA::EventType, int, int>, carta::CancellationSlot> _latest_requests;
+    std::mutex _latest_request_mutex;
 
-    int _ref_count;
+    std::atomic<int> _ref_count; // held by tasks and by gRPC scripting calls, on other threads than the event loop
     int _animation_id;
     bool _connected;
-    static int _num_sessions;
+    static std::atomic<int> _num_sessions; // sessions of all event loops
     static int _exit_after_num_seconds;
     static bool _exit_when_all_sessions_closed;
 
-    // Scripting responses from the client
-    std::unordered_map<int, CARTA::ScriptingResponse> _scripting_response;
+    // Scripting requests waiting for the client, with their responses once received
+    std::unordered_map<uint32_t, std::optional<CARTA::ScriptingResponse>> _scripting_responses;
     std::mutex _scripting_mutex;
+    std::condition_variable _scripting_response_received; // also notified on disconnect
+
+    // View state for hibernation; see RecordViewMessage
+    using ViewMessages = std::map<std::tuple<CARTA::EventType, int, int>, std::string>;
+    std::unordered_map<int, CARTA::ImageProperties> _image_sources;
+    ViewMessages _view_messages;
+    std::mutex _view_state_mutex;
+    struct HibernatedView {
+        CARTA::ResumeSession images;
+        ViewMessages messages;
+    };
+    std::unique_ptr<HibernatedView> _hibernated_view; // used only on the loop thread
 
     // Timestamp for the last protobuf message
     std::chrono::high_resolution_clock::time_point _last_message_timestamp;
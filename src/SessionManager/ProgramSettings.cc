@@ -182,8 +182,9 @@ void ProgramSettings::ApplyCommandLineSettings(int argc, char** argv) {
         ("verbosity", "display verbose logging from this level",
          cxxopts::value<int>()->default_value(to_string(verbosity)), "<level>")
         ("no_log", "do not log output to a log file", cxxopts::value<bool>())
-        ("log_performance", "enable performance debug logs", cxxopts::value<bool>())
+        ("log_performance", "enable performance debug logs and latency histograms", cxxopts::value<bool>())
         ("log_protocol_messages", "enable protocol message debug logs", cxxopts::value<bool>())
+        ("log_queue", fmt::format("write logs from a background thread through a queue of this many messages, dropping debug messages when it is full; 0 writes them synchronously (default: {} with --log_performance, otherwise 0)", LOG_QUEUE_SIZE), cxxopts::value<int>(), "<messages>")
         ("no_http", "disable frontend HTTP server", cxxopts::value<bool>())
         ("no_browser", "don't open the frontend URL in a browser on startup", cxxopts::value<bool>())
         ("browser", "[experimental] custom browser command", cxxopts::value<string>(), "<browser>")
@@ -191,12 +192,35 @@ void ProgramSettings::ApplyCommandLineSettings(int argc, char** argv) {
         ("p,port", fmt::format("manually set the HTTP and WebSocket port (default: {} or nearest available port)", DEFAULT_SOCKET_PORT), cxxopts::value<std::vector<int>>(), "<port>")
         ("g,grpc_port", "set gRPC service port", cxxopts::value<int>(), "<port>")
         ("t,omp_threads", "manually set OpenMP thread pool count", cxxopts::value<int>(), "<threads>")
+        ("numa_pinning", "pin task threads to NUMA nodes in turn, with the OpenMP threads they start (Linux only)", cxxopts::value<bool>())
+        ("trace_file", "write spans of message handling, tasks, loader reads, compression and sent messages to this file as Chrome trace events, for chrome://tracing or Perfetto (default: disabled)", cxxopts::value<string>(), "<file>")
+        ("trace_session", "only trace this session; 0 traces all sessions (default: 0)", cxxopts::value<int>(), "<id>")
+        ("record_folder", "record the messages received by each session to a log in this folder, for replaying with carta_replay; logs contain the names of opened files (default: disabled)", cxxopts::value<string>(), "<dir>")
+        ("slow_request_log", "append requests slower than their threshold to this file as JSON lines, with the time spent queued, waiting for locks, reading, compressing, sending and computing (default: disabled)", cxxopts::value<string>(), "<file>")
+        ("slow_request_thresholds", fmt::format("comma-separated event types with the duration in milliseconds above which their requests are logged (default: {})", DEFAULT_SLOW_REQUEST_THRESHOLDS), cxxopts::value<string>(), "<thresholds>")
+        ("slow_request_ms", fmt::format("requests of other event types are logged above this duration (default: {})", SLOW_REQUEST_MS), cxxopts::value<int>(), "<ms>")
+        ("workers", "comma-separated host:port gRPC addresses of backends which calculate moments, cube histograms and exports of files; the workers must see the files and export folders at the same paths, and jobs run locally if no worker can run them (default: none)", cxxopts::value<string>(), "<addresses>")
         ("top_level_folder", "set top-level folder for data files", cxxopts::value<string>(), "<dir>")
         ("frontend_folder", "set folder from which frontend files are served", cxxopts::value<string>(), "<dir>")
         ("exit_timeout", "number of seconds to stay alive after last session exits", cxxopts::value<int>(), "<sec>")
         ("initial_timeout", "number of seconds to stay alive at start if no clients connect", cxxopts::value<int>(), "<sec>")
         ("idle_timeout", "number of seconds to keep idle sessions alive", cxxopts::value<int>(), "<sec>")
+        ("hibernate_timeout", "number of seconds after which idle sessions close their images and release their caches, keeping the view to restore on the next message", cxxopts::value<int>(), "<sec>")
         ("read_only_mode", "disable write requests", cxxopts::value<bool>())
+        ("lazy_tile_threshold", "read raster tiles on demand instead of caching whole channels for images larger than this number of megapixels", cxxopts::value<int>(), "<mpix>")
+        ("compact_cache_threshold", "cache channels as 16-bit values scaled per block of pixels for images larger than this number of megapixels; statistics still use exact values", cxxopts::value<int>(), "<mpix>")
+        ("approximate_spectral_threshold", "first send sum, mean and flux density spectra approximated from the HDF5 mipmaps for regions whose bounding box has more than this number of megapixels over all channels, then refine them", cxxopts::value<int>(), "<mpix>")
+        ("gpu_threshold", "run the Gaussian smoothing, statistics and histograms of images of at least this number of megapixels on the GPU, if the backend is built with CUDA", cxxopts::value<int>(), "<mpix>")
+        ("contour_simplification", "drop contour vertices which are within this many steps of the vertex rounding (1 / decimation pixels) of the simplified lines; 0 sends all traced vertices (default: 0)", cxxopts::value<int>(), "<steps>")
+        ("hdf5_chunk_cache", fmt::format("maximum HDF5 chunk cache per dataset, sized to the chunks read by plane and spectral reads; 0 uses the HDF5 default (default: {})", HDF5_CHUNK_CACHE_MB), cxxopts::value<int>(), "<MB>")
+        ("casa_tile_cache", fmt::format("maximum tile cache per CASA image, sized to the tiles of the plane, spectral, region or moment reads within the memory budget; 0 uses the casacore default (default: {})", CASA_TILE_CACHE_MB), cxxopts::value<int>(), "<MB>")
+        ("moment_memory", fmt::format("memory ceiling of a moment calculation; larger moment and smoothed images are streamed to temporary files; 0 leaves them in memory (default: {})", MOMENT_MEMORY_MB), cxxopts::value<int>(), "<MB>")
+        ("memory_budget", fmt::format("memory ceiling of the tile, contour and image plane caches of all sessions; the entries unused longest relative to their cost are evicted first; 0 for no limit (default: {})", MEMORY_BUDGET_MB), cxxopts::value<int>(), "<MB>")
+        ("socket_loops", fmt::format("number of WebSocket event loop threads sharing the port, each serving the sessions it accepts; connections are balanced by the kernel on Linux (default: {})", DEFAULT_SOCKET_LOOPS), cxxopts::value<int>(), "<threads>")
+        ("shared_memory", fmt::format("size of a shared memory ring per session, through which messages larger than {} bytes reach frontends on the same host that ask for it, with only a handle sent on the WebSocket; 0 disables it (default: {})", SHARED_MEMORY_THRESHOLD, DEFAULT_SHARED_MEMORY_MB), cxxopts::value<int>(), "<MB>")
+        ("compression_threshold", fmt::format("outgoing messages up to this size are not compressed (default: {})", DEFLATE_THRESHOLD), cxxopts::value<int>(), "<bytes>")
+        ("compression_policy", fmt::format("comma-separated event types with the compression of their messages, none or deflate; other messages are deflated (default: {})", DEFAULT_COMPRESSION_POLICY), cxxopts::value<string>(), "<policy>")
+        ("cache_folder", "keep spectral-major copies and per-channel statistics of FITS, CASA and MIRIAD images in this folder, shared by all sessions (default: disabled)", cxxopts::value<string>(), "<dir>")
         ("files", "files to load", cxxopts::value<vector<string>>(positional_arguments))
         ("no_user_config", "ignore user configuration file", cxxopts::value<bool>())
         ("no_system_config", "ignore system configuration file", cxxopts::value<bool>());
@@ -274,6 +298,7 @@ end.
     debug_no_auth = result["debug_no_auth"].as<bool>();
     no_browser = result["no_browser"].as<bool>();
     read_only_mode = result["read_only_mode"].as<bool>();
+    numa_pinning = result["numa_pinning"].as<bool>();
 
     no_user_config = result.count("no_user_config") ? true : false;
     no_system_config = result.count("no_system_config") ? true : false;
@@ -289,9 +314,32 @@ end.
 
     applyOptionalArgument(omp_thread_count, "omp_threads", result);
 
+    applyOptionalArgument(log_queue, "log_queue", result);
     applyOptionalArgument(wait_time, "exit_timeout", result);
     applyOptionalArgument(init_wait_time, "initial_timeout", result);
     applyOptionalArgument(idle_session_wait_time, "idle_timeout", result);
+    applyOptionalArgument(idle_session_hibernate_time, "hibernate_timeout", result);
+    applyOptionalArgument(lazy_tile_threshold, "lazy_tile_threshold", result);
+    applyOptionalArgument(compact_cache_threshold, "compact_cache_threshold", result);
+    applyOptionalArgument(approximate_spectral_threshold, "approximate_spectral_threshold", result);
+    applyOptionalArgument(gpu_threshold, "gpu_threshold", result);
+    applyOptionalArgument(contour_simplification, "contour_simplification", result);
+    applyOptionalArgument(hdf5_chunk_cache, "hdf5_chunk_cache", result);
+    applyOptionalArgument(casa_tile_cache, "casa_tile_cache", result);
+    applyOptionalArgument(moment_memory, "moment_memory", result);
+    applyOptionalArgument(memory_budget, "memory_budget", result);
+    applyOptionalArgument(socket_loops, "socket_loops", result);
+    applyOptionalArgument(shared_memory, "shared_memory", result);
+    applyOptionalArgument(compression_threshold, "compression_threshold", result);
+    applyOptionalArgument(compression_policy, "compression_policy", result);
+    applyOptionalArgument(cache_folder, "cache_folder", result);
+    applyOptionalArgument(trace_file, "trace_file", result);
+    applyOptionalArgument(trace_session, "trace_session", result);
+    applyOptionalArgument(record_folder, "record_folder", result);
+    applyOptionalArgument(slow_request_log, "slow_request_log", result);
+    applyOptionalArgument(slow_request_thresholds, "slow_request_thresholds", result);
+    applyOptionalArgument(slow_request_ms, "slow_request_ms", result);
+    applyOptionalArgument(workers, "workers", result);
 
     applyOptionalArgument(browser, "browser", result);
 
@@ -36,11 +36,35 @@ struct ProgramSettings {
     bool no_log = false;
     bool log_performance = false;
     bool log_protocol_messages = false;
+    int log_queue = -1;
     int verbosity = 4;
     int wait_time = -1;
     int init_wait_time = -1;
     int idle_session_wait_time = -1;
+    int idle_session_hibernate_time = -1;
+    int lazy_tile_threshold = -1;
+    int compact_cache_threshold = -1;
+    int approximate_spectral_threshold = -1;
+    int gpu_threshold = -1;
+    int contour_simplification = -1;
+    int hdf5_chunk_cache = HDF5_CHUNK_CACHE_MB;
+    int casa_tile_cache = CASA_TILE_CACHE_MB;
+    int moment_memory = MOMENT_MEMORY_MB;
+    int memory_budget = MEMORY_BUDGET_MB;
+    int socket_loops = DEFAULT_SOCKET_LOOPS;
+    int shared_memory = DEFAULT_SHARED_MEMORY_MB;
+    int compression_threshold = DEFLATE_THRESHOLD;
+    std::string compression_policy = DEFAULT_COMPRESSION_POLICY;
+    std::string cache_folder;
     bool read_only_mode = false;
+    bool numa_pinning = false;
+    std::string trace_file;
+    int trace_session = 0;
+    std::string record_folder;
+    std::string slow_request_log;
+    std::string slow_request_thresholds = DEFAULT_SLOW_REQUEST_THRESHOLDS;
+    int slow_request_ms = SLOW_REQUEST_MS;
+    std::string workers;
 
     std::string browser;
 
@@ -54,11 +78,27 @@ struct ProgramSettings {
     // clang-format off
     std::unordered_map<std::string, int*> int_keys_map{
         {"verbosity", &verbosity},
+        {"log_queue", &log_queue},
         {"grpc_port", &grpc_port},
         {"omp_threads", &omp_thread_count},
         {"exit_timeout", &wait_time},
         {"initial_timeout", &init_wait_time},
-        {"idle_timeout", &idle_session_wait_time}
+        {"idle_timeout", &idle_session_wait_time},
+        {"hibernate_timeout", &idle_session_hibernate_time},
+        {"lazy_tile_threshold", &lazy_tile_threshold},
+        {"compact_cache_threshold", &compact_cache_threshold},
+        {"approximate_spectral_threshold", &approximate_spectral_threshold},
+        {"gpu_threshold", &gpu_threshold},
+        {"contour_simplification", &contour_simplification},
+        {"hdf5_chunk_cache", &hdf5_chunk_cache},
+        {"casa_tile_cache", &casa_tile_cache},
+        {"moment_memory", &moment_memory},
+        {"memory_budget", &memory_budget},
+        {"socket_loops", &socket_loops},
+        {"shared_memory", &shared_memory},
+        {"compression_threshold", &compression_threshold},
+        {"trace_session", &trace_session},
+        {"slow_request_ms", &slow_request_ms}
     };
 
     std::unordered_map<std::string, bool*> bool_keys_map{
@@ -67,14 +107,22 @@ struct ProgramSettings {
         {"log_protocol_messages", &log_protocol_messages},
         {"no_http", &no_http},
         {"no_browser", &no_browser},
-        {"read_only_mode", &read_only_mode}
+        {"read_only_mode", &read_only_mode},
+        {"numa_pinning", &numa_pinning}
     };
 
     std::unordered_map<std::string, std::string*> strings_keys_map{
         {"host", &host},
         {"top_level_folder", &top_level_folder},
         {"frontend_folder", &frontend_folder},
-        {"browser", &browser}
+        {"browser", &browser},
+        {"cache_folder", &cache_folder},
+        {"compression_policy", &compression_policy},
+        {"trace_file", &trace_file},
+        {"record_folder", &record_folder},
+        {"slow_request_log", &slow_request_log},
+        {"slow_request_thresholds", &slow_request_thresholds},
+        {"workers", &workers}
     };
 
     std::unordered_map<std::string, std::vector<int>*> vector_int_keys_map {
@@ -90,8 +138,11 @@ struct ProgramSettings {
 
     auto GetTuple() const {
         return std::tie(help, version, port, grpc_port, omp_thread_count, top_level_folder, starting_folder, host, files, frontend_folder,
-            no_http, no_browser, no_log, log_performance, log_protocol_messages, debug_no_auth, verbosity, wait_time, init_wait_time,
-            idle_session_wait_time);
+            no_http, no_browser, no_log, log_performance, log_protocol_messages, log_queue, debug_no_auth, verbosity, wait_time,
+            init_wait_time, idle_session_wait_time, idle_session_hibernate_time, lazy_tile_threshold, compact_cache_threshold,
+            approximate_spectral_threshold, gpu_threshold, contour_simplification, hdf5_chunk_cache, casa_tile_cache, moment_memory,
+            memory_budget, socket_loops, shared_memory, compression_threshold, compression_policy, cache_folder, numa_pinning, trace_file,
+            trace_session, record_folder, slow_request_log, slow_request_thresholds, slow_request_ms, workers);
     }
     bool operator!=(const ProgramSettings& rhs) const;
     bool operator==(const ProgramSettings& rhs) const;
@@ -0,0 +1,155 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SessionRecorder.cc: logs of the messages received by sessions, for replaying them without a connection
+
+#include "SessionRecorder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+#define SESSION_LOG_MAGIC "CARTALOG"
+#define SESSION_LOG_VERSION 1
+
+namespace carta {
+
+namespace {
+
+struct SessionLog {
+    FILE* file;
+    std::chrono::steady_clock::time_point start;
+};
+
+struct Recorder {
+    std::mutex mutex;
+    std::string folder;
+    std::unordered_map<uint32_t, SessionLog> logs;
+
+    static Recorder& Global() {
+        static Recorder recorder;
+        return recorder;
+    }
+};
+
+} // namespace
+
+std::atomic<bool> SessionRecorder::_enabled{false};
+
+bool SessionRecorder::SetFolder(const std::string& folder) {
+    auto& recorder = Recorder::Global();
+    std::scoped_lock lock(recorder.mutex);
+    if (!folder.empty()) {
+        try {
+            fs::create_directories(folder);
+        } catch (const std::exception& err) {
+            spdlog::warn("Could not create session log folder {}: {}", folder, err.what());
+            return false;
+        }
+    }
+    recorder.folder = folder;
+    _enabled = !folder.empty();
+    return true;
+}
+
+void SessionRecorder::Record(uint32_t session_id, std::string_view message) {
+    if (!_enabled) {
+        return;
+    }
+
+    auto& recorder = Recorder::Global();
+    std::scoped_lock lock(recorder.mutex);
+    auto now = std::chrono::steady_clock::now();
+    auto it = recorder.logs.find(session_id);
+    if (it == recorder.logs.end()) {
+        if (recorder.folder.empty()) {
+            return;
+        }
+        auto filename = (fs::path(recorder.folder) / fmt::format("session_{}_{}.carta-log", session_id, std::time(nullptr))).string();
+        FILE* file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            spdlog::warn("Could not record session {} to {}", session_id, filename);
+        } else {
+            uint32_t version = SESSION_LOG_VERSION;
+            fwrite(SESSION_LOG_MAGIC, 1, 8, file);
+            fwrite(&version, sizeof(version), 1, file);
+            spdlog::info("Recording session {} to {}", session_id, filename);
+        }
+        // A session which could not be recorded keeps a null file, so that it is not tried again for every message
+        it = recorder.logs.emplace(session_id, SessionLog{file, now}).first;
+    }
+
+    auto& log = it->second;
+    if (log.file) {
+        int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(now - log.start).count();
+        uint32_t length = message.size();
+        fwrite(&time_us, sizeof(time_us), 1, log.file);
+        fwrite(&length, sizeof(length), 1, log.file);
+        fwrite(message.data(), 1, length, log.file);
+        // Received messages are few, so each is flushed to keep the log of a crashed backend
+        fflush(log.file);
+    }
+}
+
+void SessionRecorder::Close(uint32_t session_id) {
+    auto& recorder = Recorder::Global();
+    std::scoped_lock lock(recorder.mutex);
+    auto it = recorder.logs.find(session_id);
+    if (it != recorder.logs.end()) {
+        if (it->second.file) {
+            fclose(it->second.file);
+        }
+        recorder.logs.erase(it);
+    }
+}
+
+bool SessionRecorder::Read(const std::string& filename, std::vector<RecordedMessage>& messages, std::string& error) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = fmt::format("Could not open {}", filename);
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version(0);
+    bool ok = fread(magic, 1, 8, file) == 8 && !memcmp(magic, SESSION_LOG_MAGIC, 8) && fread(&version, sizeof(version), 1, file) == 1;
+    if (!ok || version != SESSION_LOG_VERSION) {
+        error = fmt::format("{} is not a session log of version {}", filename, SESSION_LOG_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    messages.clear();
+    RecordedMessage message;
+    uint32_t length;
+    while (fread(&message.time_us, sizeof(message.time_us), 1, file) == 1 && fread(&length, sizeof(length), 1, file) == 1) {
+        message.data.resize(length);
+        if (fread(message.data.data(), 1, length, file) != length) {
+            // The backend stopped while writing the last message
+            spdlog::warn("Ignoring a truncated message at the end of {}", filename);
+            break;
+        }
+        messages.push_back(message);
+    }
+    fclose(file);
+    return true;
+}
+
+} // namespace carta
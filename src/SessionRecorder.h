@@ -0,0 +1,45 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SessionRecorder.h: logs of the messages received by sessions, for replaying them without a connection
+
+#ifndef CARTA_BACKEND__SESSIONRECORDER_H_
+#define CARTA_BACKEND__SESSIONRECORDER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace carta {
+
+// A received message of a recorded session
+struct RecordedMessage {
+    int64_t time_us;  // since the first message of the session
+    std::string data; // EventHeader and payload as received
+};
+
+// Writes the binary messages received by each session to session_<id>_<time>.carta-log in a folder. A log starts with the
+// 8-byte magic CARTALOG and a uint32 version; each message follows as an int64 time in microseconds, a uint32 length and the
+// message. Logs contain the paths and names of the files a user opened.
+class SessionRecorder {
+public:
+    // Starts recording new sessions, or stops if the folder is empty
+    static bool SetFolder(const std::string& folder);
+    static void Record(uint32_t session_id, std::string_view message);
+    // Called when the session is deleted
+    static void Close(uint32_t session_id);
+
+    static bool Read(const std::string& filename, std::vector<RecordedMessage>& messages, std::string& error);
+
+private:
+    static std::atomic<bool> _enabled;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__SESSIONRECORDER_H_
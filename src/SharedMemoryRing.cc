@@ -0,0 +1,123 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SharedMemoryRing.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <spdlog/fmt/fmt.h>
+
+namespace carta {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Positions shared with the client must be lock-free");
+
+// The ring starts on a cache line after the header
+static constexpr size_t RING_OFFSET = 64;
+static_assert(sizeof(SharedMemoryRingHeader) <= RING_OFFSET, "Ring header is larger than its space");
+
+size_t SharedMemoryRing::_default_capacity = 0;
+size_t SharedMemoryRing::_threshold = 0;
+
+void SharedMemoryRing::Configure(size_t capacity, size_t threshold) {
+    _default_capacity = capacity;
+    _threshold = threshold;
+}
+
+bool SharedMemoryRing::Enabled() {
+    return _default_capacity > 0;
+}
+
+size_t SharedMemoryRing::Threshold() {
+    return _threshold;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(uint32_t session_id, std::string& error) {
+    if (!Enabled()) {
+        error = "Shared memory transport is disabled.";
+        return nullptr;
+    }
+
+    // The random part keeps other processes from guessing the name before the client opens it
+    std::random_device random;
+    std::string name = fmt::format("/carta-{}-{}-{:08x}", getpid(), session_id, random());
+    size_t mapped_size = RING_OFFSET + _default_capacity;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        error = fmt::format("Could not create shared memory {}: {}", name, strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(fd, mapped_size) != 0) {
+        error = fmt::format("Could not size shared memory {}: {}", name, strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the memory
+    if (memory == MAP_FAILED) {
+        error = fmt::format("Could not map shared memory {}: {}", name, strerror(errno));
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    return std::unique_ptr<SharedMemoryRing>(new SharedMemoryRing(name, memory, mapped_size, _default_capacity));
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string& name, void* memory, size_t mapped_size, size_t capacity)
+    : _name(name), _memory(memory), _mapped_size(mapped_size), _capacity(capacity) {
+    // New shared memory is zero-filled; the atomics are constructed in place before the magic tells the client the ring is ready
+    _header = new (memory) SharedMemoryRingHeader();
+    _header->version = VERSION;
+    _header->capacity = capacity;
+    _header->write_position.store(0);
+    _header->read_position.store(0);
+    _header->client_attached.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    _header->magic = MAGIC;
+    _ring = static_cast<char*>(memory) + RING_OFFSET;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    munmap(_memory, _mapped_size);
+    shm_unlink(_name.c_str());
+}
+
+bool SharedMemoryRing::ClientAttached() const {
+    return _header->client_attached.load(std::memory_order_acquire) != 0;
+}
+
+bool SharedMemoryRing::Write(const char* data, size_t length, uint64_t& position) {
+    if ((length == 0) || (length > _capacity) || !ClientAttached()) {
+        return false;
+    }
+
+    uint64_t start = _header->write_position.load(std::memory_order_relaxed);
+    size_t offset = start % _capacity;
+    if (offset + length > _capacity) {
+        // Skip the end of the ring rather than wrap the message
+        start += _capacity - offset;
+        offset = 0;
+    }
+    uint64_t end = start + length;
+    if (end - _header->read_position.load(std::memory_order_acquire) > _capacity) {
+        return false; // the client still has messages in the space needed
+    }
+
+    memcpy(_ring + offset, data, length);
+    _header->write_position.store(end, std::memory_order_release);
+    position = start;
+    return true;
+}
+
+} // namespace carta
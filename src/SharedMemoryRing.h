@@ -0,0 +1,77 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SharedMemoryRing.h: ring buffer in POSIX shared memory through which large outgoing messages reach a frontend on the same host
+
+#ifndef CARTA_BACKEND__SHAREDMEMORYRING_H_
+#define CARTA_BACKEND__SHAREDMEMORYRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace carta {
+
+// Start of the shared memory, followed by the ring. Positions count the bytes of the stream of messages written, so the message at
+// position p starts at offset p % capacity of the ring; a message never wraps, the backend skips to the start of the ring instead.
+struct SharedMemoryRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint64_t> write_position;  // end of the last message written, by the backend
+    std::atomic<uint64_t> read_position;   // end of the last message the client has finished with, by the client
+    std::atomic<uint32_t> client_attached; // set by the client once it has mapped the ring; until then messages go on the socket
+};
+
+// Messages are written whole, with their EventHeader, as they would be sent on the socket. The socket then carries only a handle of
+// the message, in order with the other messages, and the client releases the ring up to the end of each message it has handled.
+// Only the loop thread of the session writes to the ring.
+class SharedMemoryRing {
+public:
+    static constexpr uint32_t MAGIC = 0x43524e47; // "CRNG"
+    static constexpr uint32_t VERSION = 1;
+
+    // Process-wide settings, from the program settings before sessions are created; a capacity of 0 disables the transport
+    static void Configure(size_t capacity, size_t threshold);
+    static bool Enabled();
+    static size_t Threshold();
+
+    // New ring with a unique name, readable and writable only by the user running the backend; nullptr with the error on failure
+    static std::unique_ptr<SharedMemoryRing> Create(uint32_t session_id, std::string& error);
+    // Unmaps and unlinks the shared memory; a client which has mapped it keeps its mapping
+    ~SharedMemoryRing();
+
+    const std::string& Name() const {
+        return _name;
+    }
+    size_t Capacity() const {
+        return _capacity;
+    }
+    bool ClientAttached() const;
+
+    // Copies the message into the ring, unless the client is not attached or has not released enough of the ring; position is where
+    // the client reads it
+    bool Write(const char* data, size_t length, uint64_t& position);
+
+private:
+    SharedMemoryRing(const std::string& name, void* memory, size_t mapped_size, size_t capacity);
+
+    std::string _name;
+    void* _memory;
+    size_t _mapped_size;
+    size_t _capacity;
+    SharedMemoryRingHeader* _header;
+    char* _ring;
+
+    static size_t _default_capacity;
+    static size_t _threshold;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND__SHAREDMEMORYRING_H_
@@ -0,0 +1,221 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PreferenceStore.cc: user preferences and layouts held in memory and written to the config folder in the background
+
+#include "PreferenceStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <regex>
+
+#include <unistd.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "Logger/Logger.h"
+
+using json = nlohmann::json;
+
+namespace carta {
+
+PreferenceStore::PreferenceStore(fs::path config_folder, int write_delay_ms)
+    : _preferences_path(config_folder / "preferences.json"),
+      _layouts_folder(config_folder / "layouts"),
+      _write_delay_ms(write_delay_ms),
+      _layouts(json::object()),
+      _preferences_loaded(false),
+      _layouts_loaded(false),
+      _preferences_changed(false),
+      _stop(false) {}
+
+PreferenceStore::~PreferenceStore() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _changed.notify_all();
+    if (_writer.joinable()) {
+        _writer.join(); // after writing pending changes
+    }
+}
+
+json PreferenceStore::Preferences() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    LoadPreferences();
+    return _preferences;
+}
+
+void PreferenceStore::SetPreferences(const json& preferences) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _preferences = preferences;
+    _preferences_loaded = true;
+    _preferences_changed = true;
+    ScheduleWrite();
+}
+
+json PreferenceStore::Layouts() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    LoadLayouts();
+    return _layouts;
+}
+
+void PreferenceStore::SetLayout(const std::string& name, const json& layout) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    LoadLayouts();
+    _layouts[name] = layout;
+    _changed_layouts.insert(name);
+    ScheduleWrite();
+}
+
+bool PreferenceStore::RemoveLayout(const std::string& name) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    LoadLayouts();
+    if (!_layouts.erase(name)) {
+        return false;
+    }
+    _changed_layouts.insert(name);
+    ScheduleWrite();
+    return true;
+}
+
+void PreferenceStore::Flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    WritePending(lock);
+}
+
+void PreferenceStore::LoadPreferences() {
+    if (_preferences_loaded) {
+        return;
+    }
+    _preferences_loaded = true;
+    if (!fs::exists(_preferences_path)) {
+        _preferences = {{"version", 1}};
+        return;
+    }
+
+    try {
+        std::ifstream file(_preferences_path.string());
+        std::string json_string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        _preferences = json::parse(json_string);
+    } catch (const std::exception&) {
+        _preferences = json();
+    }
+}
+
+void PreferenceStore::LoadLayouts() {
+    if (_layouts_loaded) {
+        return;
+    }
+    _layouts_loaded = true;
+    if (!fs::exists(_layouts_folder)) {
+        return;
+    }
+
+    std::regex layout_regex(R"(^(.+)\.json$)");
+    for (auto& p : fs::directory_iterator(_layouts_folder)) {
+        try {
+            std::string filename = p.path().filename().string();
+            std::smatch sm;
+            if (fs::is_regular_file(p) && std::regex_search(filename, sm, layout_regex) && sm.size() == 2) {
+                std::ifstream file(p.path().string());
+                std::string json_string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                _layouts[sm[1].str()] = json::parse(json_string);
+            }
+        } catch (const std::exception& e) {
+            spdlog::warn(e.what());
+        }
+    }
+}
+
+void PreferenceStore::ScheduleWrite() {
+    if (!_writer.joinable()) {
+        _writer = std::thread(&PreferenceStore::RunWriter, this);
+    }
+    _changed.notify_all();
+}
+
+void PreferenceStore::RunWriter() {
+    auto pending = [&]() { return _preferences_changed || !_changed_layouts.empty(); };
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _changed.wait(lock, [&]() { return _stop || pending(); });
+        if (!_stop) {
+            // Gather the changes of a burst of requests into one write of each file
+            _changed.wait_for(lock, std::chrono::milliseconds(_write_delay_ms), [&]() { return _stop; });
+        }
+        WritePending(lock);
+        if (_stop && !pending()) {
+            return;
+        }
+    }
+}
+
+void PreferenceStore::WritePending(std::unique_lock<std::mutex>& lock) {
+    // Only one thread writes the files, so that the temporary files are not shared
+    lock.unlock();
+    std::unique_lock<std::mutex> write_lock(_write_mutex);
+    lock.lock();
+
+    std::optional<std::string> preferences;
+    if (_preferences_changed) {
+        preferences = _preferences.dump(4);
+        _preferences_changed = false;
+    }
+    std::map<std::string, std::optional<std::string>> layouts; // nullopt to remove
+    for (auto& name : _changed_layouts) {
+        auto it = _layouts.find(name);
+        layouts[name] = (it == _layouts.end() ? std::nullopt : std::optional<std::string>(it->dump(4)));
+    }
+    _changed_layouts.clear();
+    lock.unlock();
+
+    if (preferences) {
+        WriteFile(_preferences_path, *preferences);
+    }
+    for (auto& [name, layout] : layouts) {
+        auto layout_path = _layouts_folder / (name + ".json");
+        if (layout) {
+            WriteFile(layout_path, *layout);
+        } else {
+            try {
+                fs::remove(layout_path);
+            } catch (const std::exception& e) {
+                spdlog::warn("Could not remove layout file {}: {}", layout_path.string(), e.what());
+            }
+        }
+    }
+
+    write_lock.unlock();
+    lock.lock();
+}
+
+bool PreferenceStore::WriteFile(const fs::path& path, const std::string& content) {
+    auto temp_path = path;
+    temp_path += fmt::format(".{}.tmp", getpid());
+    try {
+        fs::create_directories(path.parent_path());
+        {
+            std::ofstream file(temp_path.string(), std::ios::trunc);
+            file << content;
+            file.close();
+            if (!file) {
+                throw std::runtime_error("write failed");
+            }
+        }
+        fs::rename(temp_path, path);
+        return true;
+    } catch (const std::exception& e) {
+        spdlog::warn("Could not write {}: {}", path.string(), e.what());
+        std::remove(temp_path.string().c_str());
+        return false;
+    }
+}
+
+} // namespace carta
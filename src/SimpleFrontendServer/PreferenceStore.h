@@ -0,0 +1,84 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# PreferenceStore.h: user preferences and layouts held in memory and written to the config folder in the background
+
+#ifndef CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_PREFERENCESTORE_H_
+#define CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_PREFERENCESTORE_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+// Changes made within this time of the first are written together
+#define PREFERENCES_WRITE_DELAY_MS 500
+
+namespace carta {
+
+// The files are read on first use and then only written, so that no file I/O is done by the event loops after the first request.
+// Each file is written to a temporary file which is renamed over it, so that a crash never leaves a partly written file.
+class PreferenceStore {
+public:
+    explicit PreferenceStore(fs::path config_folder, int write_delay_ms = PREFERENCES_WRITE_DELAY_MS);
+    // Writes any pending changes
+    ~PreferenceStore();
+    PreferenceStore(const PreferenceStore&) = delete;
+    PreferenceStore& operator=(const PreferenceStore&) = delete;
+
+    // Empty if the preferences file is invalid
+    nlohmann::json Preferences();
+    void SetPreferences(const nlohmann::json& preferences);
+
+    // Object of layouts by name
+    nlohmann::json Layouts();
+    void SetLayout(const std::string& name, const nlohmann::json& layout);
+    // False if there is no such layout
+    bool RemoveLayout(const std::string& name);
+
+    // Writes pending changes now, e.g. before exit
+    void Flush();
+
+private:
+    void LoadPreferences();
+    void LoadLayouts();
+    void ScheduleWrite(); // with the mutex held
+    void RunWriter();
+    void WritePending(std::unique_lock<std::mutex>& lock);
+    static bool WriteFile(const fs::path& path, const std::string& content);
+
+    fs::path _preferences_path;
+    fs::path _layouts_folder;
+    int _write_delay_ms;
+
+    std::mutex _mutex;
+    std::mutex _write_mutex; // held while files are written
+    nlohmann::json _preferences;
+    nlohmann::json _layouts;
+    bool _preferences_loaded;
+    bool _layouts_loaded;
+    bool _preferences_changed;
+    std::set<std::string> _changed_layouts; // written, or removed if not in _layouts
+
+    std::thread _writer; // started by the first change
+    std::condition_variable _changed;
+    bool _stop;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_PREFERENCESTORE_H_
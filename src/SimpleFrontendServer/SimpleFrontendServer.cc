@@ -7,12 +7,11 @@
 #include "SimpleFrontendServer.h"
 
 #include <fstream>
-#include <regex>
 #include <vector>
 
 #include "Constants.h"
 #include "Logger/Logger.h"
-#include "MimeTypes.h"
+#include "Metrics.h"
 #include "Util.h"
 
 using namespace std;
@@ -23,7 +22,12 @@ namespace carta {
 const string success_string = json({{"success", true}}).dump();
 
 SimpleFrontendServer::SimpleFrontendServer(fs::path root_folder, string auth_token, bool read_only_mode)
-    : _http_root_folder(root_folder), _auth_token(auth_token), _read_only_mode(read_only_mode) {
+    : _http_root_folder(root_folder),
+      _asset_cache(root_folder),
+      _config_folder(fs::path(getenv("HOME")) / CARTA_USER_FOLDER_PREFIX / "config"),
+      _preference_store(_config_folder),
+      _auth_token(auth_token),
+      _read_only_mode(read_only_mode) {
     _frontend_found = IsValidFrontendFolder(root_folder);
 
     if (_frontend_found) {
@@ -32,7 +36,6 @@ SimpleFrontendServer::SimpleFrontendServer(fs::path root_folder, string auth_tok
         spdlog::warn("Could not find CARTA frontend files in directory {}.", _http_root_folder.string());
     }
 
-    _config_folder = fs::path(getenv("HOME")) / CARTA_USER_FOLDER_PREFIX / "config";
 }
 
 void SimpleFrontendServer::RegisterRoutes(uWS::App& app) {
@@ -44,6 +47,7 @@ void SimpleFrontendServer::RegisterRoutes(uWS::App& app) {
     app.put("/api/database/layout", [&](auto res, auto req) { HandleSetLayout(res, req); });
     app.del("/api/database/layout", [&](auto res, auto req) { HandleClearLayout(res, req); });
     app.get("/config", [&](auto res, auto req) { HandleGetConfig(res, req); });
+    app.get("/metrics", [&](auto res, auto req) { HandleGetMetrics(res, req); });
 
     // Static routes for all other files
     app.get("/*", [&](Res* res, Req* req) { HandleStaticRequest(res, req); });
@@ -55,59 +59,58 @@ void SimpleFrontendServer::HandleGetConfig(Res* res, Req* _req) {
     res->writeStatus(HTTP_200)->end(runtime_config.dump());
 }
 
+void SimpleFrontendServer::HandleGetMetrics(Res* res, Req* req) {
+    if (!IsAuthenticated(req)) {
+        res->writeStatus(HTTP_403)->end();
+        return;
+    }
+    AddNoCacheHeaders(res);
+    res->writeHeader("Content-Type", "text/plain; version=0.0.4");
+    res->writeStatus(HTTP_200)->end(Metrics::Global().Exposition());
+}
+
 void SimpleFrontendServer::HandleStaticRequest(Res* res, Req* req) {
     string_view url = req->getUrl();
-    fs::path path = _http_root_folder;
+    string path;
     if (url.empty() || url == "/") {
-        path /= "index.html";
+        path = "index.html";
     } else {
         // Trim leading '/'
         if (url[0] == '/') {
             url = url.substr(1);
         }
-        path /= string(url);
+        path = string(url);
     }
 
-    // Check if we can serve a gzip-compressed alternative
-    auto req_encoding_header = req->getHeader("accept-encoding");
-    bool accepts_gzip = req_encoding_header.find("gzip") != string_view::npos;
-    bool gzip_compressed = false;
-    auto gzip_path = path;
-    gzip_path += ".gz";
-    if (accepts_gzip && fs::exists(gzip_path) && fs::is_regular_file(gzip_path)) {
-        gzip_compressed = true;
-        path = gzip_path;
+    // Serve the best compressed variant the client accepts
+    auto asset = _asset_cache.Get(path);
+    ContentEncoding encoding;
+    if (!asset || !asset->SelectEncoding(req->getHeader("accept-encoding"), encoding)) {
+        res->writeStatus(HTTP_404)->end();
+        return;
     }
 
-    if (fs::exists(path) && fs::is_regular_file(path)) {
-        // Check file size
-        ifstream file(path.string(), ios::binary | ios::ate);
-        streamsize size = file.tellg();
-        file.seekg(0, ios::beg);
-
-        vector<char> buffer(size);
-        if (size && file.read(buffer.data(), size)) {
-            res->writeStatus(HTTP_200);
-
-            if (gzip_compressed) {
-                res->writeHeader("Content-Encoding", "gzip");
-            }
-            auto extension = path.extension();
-            auto it = MimeTypes.find(extension.string());
-            if (it != MimeTypes.end()) {
-                auto val = it->second;
-                res->writeHeader("Content-Type", it->second);
-            }
+    auto etag = asset->ETag(encoding);
+    bool not_modified = StaticAssetCache::MatchesETag(req->getHeader("if-none-match"), etag);
+    res->writeStatus(not_modified ? HTTP_304 : HTTP_200);
+    res->writeHeader("ETag", etag);
+    res->writeHeader("Vary", "Accept-Encoding");
+    // Hashed assets never change; other files, such as index.html, are revalidated with their ETag
+    res->writeHeader("Cache-Control", asset->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+    if (not_modified) {
+        res->end();
+        return;
+    }
 
-            string_view sv(buffer.data(), buffer.size());
-            res->write(sv);
-        } else {
-            res->writeStatus(HTTP_500);
-        }
-    } else {
-        res->writeStatus(HTTP_404);
+    if (encoding == ContentEncoding::Gzip) {
+        res->writeHeader("Content-Encoding", "gzip");
+    } else if (encoding == ContentEncoding::Brotli) {
+        res->writeHeader("Content-Encoding", "br");
+    }
+    if (!asset->content_type.empty()) {
+        res->writeHeader("Content-Type", asset->content_type);
     }
-    res->end();
+    res->end(asset->Content(encoding));
 }
 
 bool SimpleFrontendServer::IsValidFrontendFolder(fs::path folder) {
@@ -136,18 +139,7 @@ void SimpleFrontendServer::AddNoCacheHeaders(Res* res) {
 }
 
 json SimpleFrontendServer::GetExistingPreferences() {
-    auto preferences_path = _config_folder / "preferences.json";
-    if (!fs::exists(preferences_path)) {
-        return {{"version", 1}};
-    }
-
-    try {
-        ifstream file(preferences_path.string());
-        string json_string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        return json::parse(json_string);
-    } catch (exception) {
-        return {};
-    }
+    return _preference_store.Preferences();
 }
 
 bool SimpleFrontendServer::WritePreferencesFile(nlohmann::json& obj) {
@@ -156,21 +148,11 @@ bool SimpleFrontendServer::WritePreferencesFile(nlohmann::json& obj) {
         return false;
     }
 
-    auto preferences_path = _config_folder / "preferences.json";
-
-    try {
-        fs::create_directories(preferences_path.parent_path().string());
-        ofstream file(preferences_path.string());
-        // Ensure correct schema and version values are written
-        obj["$schema"] = CARTA_PREFERENCES_SCHEMA_URL;
-        obj["version"] = 1;
-        auto json_string = obj.dump(4);
-        file << json_string;
-        return true;
-    } catch (exception e) {
-        spdlog::warn(e.what());
-        return false;
-    }
+    // Ensure correct schema and version values are written
+    obj["$schema"] = CARTA_PREFERENCES_SCHEMA_URL;
+    obj["version"] = 1;
+    _preference_store.SetPreferences(obj);
+    return true;
 }
 
 void SimpleFrontendServer::WaitForData(Res* res, Req* req, const std::function<void(const string&)>& callback) {
@@ -207,6 +189,7 @@ void SimpleFrontendServer::HandleGetPreferences(Res* res, Req* req) {
 std::string_view SimpleFrontendServer::UpdatePreferencesFromString(const string& buffer) {
     try {
         json update_data = json::parse(buffer);
+        std::scoped_lock lock(_preferences_mutex);
         json existing_data = GetExistingPreferences();
 
         // Update each preference key-value pair
@@ -256,6 +239,7 @@ std::string_view SimpleFrontendServer::ClearPreferencesFromString(const string&
         json post_data = json::parse(buffer);
         auto keys_array = post_data["keys"];
         if (keys_array.is_array() && keys_array.size()) {
+            std::scoped_lock lock(_preferences_mutex);
             json existing_data = GetExistingPreferences();
             int modified_key_count = 0;
             if (!existing_data.empty()) {
@@ -355,27 +339,7 @@ void SimpleFrontendServer::HandleClearLayout(Res* res, Req* req) {
 }
 
 nlohmann::json SimpleFrontendServer::GetExistingLayouts() {
-    auto layout_folder = _config_folder / "layouts";
-    json layouts = json::object();
-    if (fs::exists(layout_folder)) {
-        for (auto& p : fs::directory_iterator(layout_folder)) {
-            try {
-                string filename = p.path().filename().string();
-                regex layout_regex(R"(^(.+)\.json$)");
-                smatch sm;
-                if (fs::is_regular_file(p) && regex_search(filename, sm, layout_regex) && sm.size() == 2) {
-                    string layout_name = sm[1];
-                    ifstream file(p.path().string());
-                    string json_string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                    json layout = json::parse(json_string);
-                    layouts[layout_name] = layout;
-                }
-            } catch (exception e) {
-                spdlog::warn(e.what());
-            }
-        }
-    }
-    return layouts;
+    return _preference_store.Layouts();
 }
 
 bool SimpleFrontendServer::WriteLayoutFile(const string& layout_name, nlohmann::json& obj) {
@@ -384,20 +348,10 @@ bool SimpleFrontendServer::WriteLayoutFile(const string& layout_name, nlohmann::
         return false;
     }
 
-    auto layout_path = _config_folder / "layouts" / (layout_name + ".json");
-
-    try {
-        fs::create_directories(layout_path.parent_path());
-        ofstream file(layout_path.string());
-        // Ensure correct schema value is written
-        obj["$schema"] = CARTA_LAYOUT_SCHEMA_URL;
-        auto json_string = obj.dump(4);
-        file << json_string;
-        return true;
-    } catch (exception e) {
-        spdlog::warn(e.what());
-        return false;
-    }
+    // Ensure correct schema value is written
+    obj["$schema"] = CARTA_LAYOUT_SCHEMA_URL;
+    _preference_store.SetLayout(layout_name, obj);
+    return true;
 }
 
 std::string_view SimpleFrontendServer::SetLayoutFromString(const string& buffer) {
@@ -430,12 +384,8 @@ std::string_view SimpleFrontendServer::ClearLayoutFromString(const string& buffe
         json post_data = json::parse(buffer);
         if (post_data["layoutName"].is_string()) {
             string layout_name = post_data["layoutName"];
-            if (!layout_name.empty()) {
-                auto layout_path = _config_folder / "layouts" / (layout_name + ".json");
-                if (fs::exists(layout_path) && fs::is_regular_file(layout_path)) {
-                    fs::remove(layout_path);
-                    return HTTP_200;
-                }
+            if (!layout_name.empty() && _preference_store.RemoveLayout(layout_name)) {
+                return HTTP_200;
             }
         }
         return HTTP_400;
@@ -7,11 +7,15 @@
 #ifndef CARTA_BACKEND_SRC_HTTPSERVER_SIMPLEFRONTENDSERVER_H_
 #define CARTA_BACKEND_SRC_HTTPSERVER_SIMPLEFRONTENDSERVER_H_
 
+#include <mutex>
 #include <string>
 
 #include <uWebSockets/App.h>
 #include <nlohmann/json.hpp>
 
+#include "PreferenceStore.h"
+#include "StaticAssetCache.h"
+
 #ifdef _BOOST_FILESYSTEM_
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -22,6 +26,7 @@ namespace fs = std::filesystem;
 
 namespace carta {
 #define HTTP_200 "200 OK"
+#define HTTP_304 "304 Not Modified"
 #define HTTP_400 "400 Bad Request"
 #define HTTP_404 "404 Not Found"
 #define HTTP_403 "403 Forbidden"
@@ -39,6 +44,10 @@ public:
     }
 
     void RegisterRoutes(uWS::App& app);
+    // Preferences and layouts are written in the background; writes the pending changes now
+    void FlushPreferences() {
+        _preference_store.Flush();
+    }
 
 protected:
     nlohmann::json GetExistingPreferences();
@@ -59,6 +68,7 @@ private:
 
     void HandleStaticRequest(Res* res, Req* req);
     void HandleGetConfig(Res* res, Req* req);
+    void HandleGetMetrics(Res* res, Req* req);
     void HandleGetPreferences(Res* res, Req* req);
     void HandleSetPreferences(Res* res, Req* req);
     void HandleClearPreferences(Res* res, Req* req);
@@ -67,10 +77,13 @@ private:
     void HandleClearLayout(Res* res, Req* req);
 
     fs::path _http_root_folder;
+    StaticAssetCache _asset_cache;
     fs::path _config_folder;
+    PreferenceStore _preference_store;
     bool _frontend_found;
     std::string _auth_token;
     bool _read_only_mode;
+    std::mutex _preferences_mutex; // routes are served by each event loop
 };
 
 } // namespace carta
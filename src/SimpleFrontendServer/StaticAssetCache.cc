@@ -0,0 +1,243 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# StaticAssetCache.cc: frontend files held in memory with their compressed variants and ETags
+
+#include "StaticAssetCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <zlib.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include "Logger/Logger.h"
+#include "MimeTypes.h"
+
+namespace carta {
+
+namespace {
+
+std::string_view Trim(std::string_view value) {
+    while (!value.empty() && std::isspace((unsigned char)value.front())) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && std::isspace((unsigned char)value.back())) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// Calls the function with each trimmed, non-empty item of a comma-separated header list
+template <typename Function>
+void ForEachListItem(std::string_view list, Function function) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        auto item = Trim(list.substr(0, comma));
+        if (!item.empty()) {
+            function(item);
+        }
+        list = (comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1));
+    }
+}
+
+bool ReadFile(const fs::path& path, std::string& content) {
+    if (!fs::exists(path) || !fs::is_regular_file(path)) {
+        return false;
+    }
+    std::ifstream file(path.string(), std::ios::binary);
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    if (file.bad()) {
+        return false;
+    }
+    content = buffer.str();
+    return true;
+}
+
+bool Compressible(const std::string& content_type) {
+    return content_type.rfind("text/", 0) == 0 || content_type == "application/json" || content_type == "image/svg+xml" ||
+           content_type == "application/wasm";
+}
+
+bool Gzip(const std::string& input, std::string& output) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) { // 16: gzip wrapper
+        return false;
+    }
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = (Bytef*)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef*)output.data();
+    stream.avail_out = output.size();
+    bool done = (deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return done;
+}
+
+std::string ContentHash(const std::string& content) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : content) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return fmt::format("{:016x}{:08x}", hash, (uint32_t)content.size());
+}
+
+} // namespace
+
+bool StaticAsset::SelectEncoding(std::string_view accept_encoding, ContentEncoding& encoding) const {
+    // Quality values of the codings, -1 if not listed
+    float brotli_q(-1), gzip_q(-1), identity_q(-1), any_q(-1);
+    ForEachListItem(accept_encoding, [&](std::string_view item) {
+        auto semicolon = item.find(';');
+        auto coding = Trim(item.substr(0, semicolon));
+        float q(1);
+        if (semicolon != std::string_view::npos) {
+            auto parameter = Trim(item.substr(semicolon + 1));
+            if (parameter.rfind("q=", 0) == 0) {
+                q = std::strtof(std::string(parameter.substr(2)).c_str(), nullptr);
+            }
+        }
+        std::string name(coding);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (name == "br") {
+            brotli_q = q;
+        } else if (name == "gzip") {
+            gzip_q = q;
+        } else if (name == "identity") {
+            identity_q = q;
+        } else if (name == "*") {
+            any_q = q;
+        }
+    });
+
+    auto accepted = [&](float q) { return q > 0 || (q < 0 && any_q > 0); };
+    if (!brotli.empty() && accepted(brotli_q)) {
+        encoding = ContentEncoding::Brotli;
+    } else if (!gzip.empty() && accepted(gzip_q)) {
+        encoding = ContentEncoding::Gzip;
+    } else if (has_identity && (identity_q != 0) && !(identity_q < 0 && any_q == 0)) {
+        encoding = ContentEncoding::Identity;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const std::string& StaticAsset::Content(ContentEncoding encoding) const {
+    switch (encoding) {
+        case ContentEncoding::Brotli:
+            return brotli;
+        case ContentEncoding::Gzip:
+            return gzip;
+        default:
+            return identity;
+    }
+}
+
+std::string StaticAsset::ETag(ContentEncoding encoding) const {
+    switch (encoding) {
+        case ContentEncoding::Brotli:
+            return fmt::format("\"{}-br\"", etag);
+        case ContentEncoding::Gzip:
+            return fmt::format("\"{}-gzip\"", etag);
+        default:
+            return fmt::format("\"{}\"", etag);
+    }
+}
+
+StaticAssetCache::StaticAssetCache(fs::path root_folder) : _root_folder(root_folder) {}
+
+std::shared_ptr<const StaticAsset> StaticAssetCache::Get(const std::string& relative_path) {
+    fs::path path(relative_path);
+    for (auto& component : path) {
+        if (component == "..") {
+            return nullptr;
+        }
+    }
+
+    // Loaded while locked, so that a burst of requests for a file reads it once
+    std::scoped_lock lock(_mutex);
+    auto it = _assets.find(relative_path);
+    if (it != _assets.end()) {
+        return it->second;
+    }
+
+    auto asset = Load(_root_folder / path);
+    if (asset && (asset->identity.size() + asset->gzip.size() + asset->brotli.size() <= STATIC_ASSET_MAX_BYTES)) {
+        _assets[relative_path] = asset;
+    }
+    return asset;
+}
+
+std::shared_ptr<const StaticAsset> StaticAssetCache::Load(const fs::path& path) {
+    auto asset = std::make_shared<StaticAsset>();
+    asset->has_identity = ReadFile(path, asset->identity);
+    fs::path gzip_path(path), brotli_path(path);
+    gzip_path += ".gz";
+    brotli_path += ".br";
+    ReadFile(gzip_path, asset->gzip);
+    ReadFile(brotli_path, asset->brotli);
+    if (!asset->has_identity && asset->gzip.empty() && asset->brotli.empty()) {
+        return nullptr;
+    }
+
+    auto it = MimeTypes.find(path.extension().string());
+    if (it != MimeTypes.end()) {
+        asset->content_type = it->second;
+    }
+    asset->immutable = IsHashedFileName(path.filename().string());
+
+    if (asset->gzip.empty() && Compressible(asset->content_type) && asset->identity.size() >= STATIC_ASSET_MIN_COMPRESS_BYTES) {
+        std::string gzip;
+        if (Gzip(asset->identity, gzip) && gzip.size() < asset->identity.size()) {
+            asset->gzip = std::move(gzip);
+        }
+    }
+
+    asset->etag = ContentHash(asset->has_identity ? asset->identity : (asset->gzip.empty() ? asset->brotli : asset->gzip));
+    spdlog::debug("Loaded frontend file {}: {} bytes, gzip {} bytes, brotli {} bytes", path.string(), asset->identity.size(),
+        asset->gzip.size(), asset->brotli.size());
+    return asset;
+}
+
+bool StaticAssetCache::MatchesETag(std::string_view if_none_match, const std::string& etag) {
+    bool matches(false);
+    ForEachListItem(if_none_match, [&](std::string_view item) {
+        if (item.rfind("W/", 0) == 0) {
+            item.remove_prefix(2);
+        }
+        matches = matches || item == "*" || item == etag;
+    });
+    return matches;
+}
+
+bool StaticAssetCache::IsHashedFileName(const std::string& filename) {
+    // A segment between dots of at least 8 hex digits, as added by the frontend build
+    std::string_view rest(filename);
+    size_t dot = rest.find('.');
+    while (dot != std::string_view::npos) {
+        rest.remove_prefix(dot + 1);
+        dot = rest.find('.');
+        if (dot == std::string_view::npos) {
+            break;
+        }
+        auto segment = rest.substr(0, dot);
+        if (segment.size() >= 8 && std::all_of(segment.begin(), segment.end(), [](unsigned char c) { return std::isxdigit(c); })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace carta
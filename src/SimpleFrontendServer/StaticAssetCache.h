@@ -0,0 +1,75 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# StaticAssetCache.h: frontend files held in memory with their compressed variants and ETags
+
+#ifndef CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_STATICASSETCACHE_H_
+#define CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_STATICASSETCACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+// Files larger than this are read from disk for each request
+#define STATIC_ASSET_MAX_BYTES 64 * 1024 * 1024
+// Smaller files are not worth compressing
+#define STATIC_ASSET_MIN_COMPRESS_BYTES 1024
+
+namespace carta {
+
+enum class ContentEncoding { Identity, Gzip, Brotli };
+
+struct StaticAsset {
+    std::string content_type;
+    // Hashed file names, e.g. main.3f2a9c1e.chunk.js, never change content and may be cached by browsers indefinitely
+    bool immutable = false;
+    // Variants of the content; empty if not available. The gzip variant is the .gz file on disk or compressed when loaded; the
+    // brotli variant is only the .br file on disk. There is no identity variant if only a precompressed file exists.
+    bool has_identity = false;
+    std::string identity;
+    std::string gzip;
+    std::string brotli;
+    std::string etag; // of the identity content; each variant has its own strong ETag with a suffix
+
+    // Best variant accepted by the client, or false if it accepts none
+    bool SelectEncoding(std::string_view accept_encoding, ContentEncoding& encoding) const;
+    const std::string& Content(ContentEncoding encoding) const;
+    std::string ETag(ContentEncoding encoding) const;
+};
+
+class StaticAssetCache {
+public:
+    explicit StaticAssetCache(fs::path root_folder);
+
+    // File at a path relative to the root folder, loaded on first use; null if there is none. Files are not reloaded if they
+    // change on disk, as the frontend folder is part of the installation.
+    std::shared_ptr<const StaticAsset> Get(const std::string& relative_path);
+
+    // Whether an If-None-Match header matches an ETag, by weak comparison
+    static bool MatchesETag(std::string_view if_none_match, const std::string& etag);
+    static bool IsHashedFileName(const std::string& filename);
+
+private:
+    std::shared_ptr<const StaticAsset> Load(const fs::path& path);
+
+    fs::path _root_folder;
+    std::unordered_map<std::string, std::shared_ptr<const StaticAsset>> _assets;
+    std::mutex _mutex; // routes are served by each event loop
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_SRC_SIMPLEFRONTENDSERVER_STATICASSETCACHE_H_
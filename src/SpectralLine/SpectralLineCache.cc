@@ -0,0 +1,486 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralLineCache.cc: parsed Splatalogue line tables shared by all sessions, queried without blocking the task threads
+
+#include "SpectralLineCache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "../Constants.h"
+#include "../ImageData/SidecarCache.h"
+#include "../Logger/Logger.h"
+#include "../Metrics.h"
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+#define INTENSITY_LIMIT_WORKAROUND 0.000001
+#define NUM_HEADERS 18
+#define QUERY_ROW_LIMIT 100000
+#define REST_FREQUENCY_INDEX 2
+#define MEASURED_FREQUENCY_INDEX 4
+#define TABLE_FILE_EXTENSION ".lines"
+
+using namespace carta;
+
+namespace {
+
+const std::string Headers[] = {"Species", "Chemical Name", "Freq-MHz(rest frame,redshifted)", "Freq Err(rest frame,redshifted)",
+    "Meas Freq-MHz(rest frame,redshifted)", "Meas Freq Err(rest frame,redshifted)", "Resolved QNs", "Unresolved Quantum Numbers",
+    "CDMS/JPL Intensity", "S<sub>ij</sub>&#956;<sup>2</sup> (D<sup>2</sup>)", "S<sub>ij</sub>", "Log<sub>10</sub> (A<sub>ij</sub>)",
+    "Lovas/AST Intensity", "E_L (cm^-1)", "E_L (K)", "E_U (cm^-1)", "E_U (K)", "Linelist"};
+
+bool SameIntensityLimit(double a, double b) {
+    return (std::isnan(a) && std::isnan(b)) || (a == b);
+}
+
+bool ParseFrequency(const std::string& value, double& frequency) {
+    char* end(nullptr);
+    frequency = std::strtod(value.c_str(), &end);
+    return end != value.c_str();
+}
+
+size_t WriteMemoryCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    ((std::string*)userp)->append((char*)contents, size * nmemb);
+    return size * nmemb;
+}
+
+} // namespace
+
+SpectralLineCache::SpectralLineCache(size_t capacity_bytes, const std::string& url, const std::string& folder)
+    : _capacity_bytes(capacity_bytes),
+      _url(url),
+      _folder(folder),
+      _folder_loaded(false),
+      _memory_usage(0),
+      _multi_handle(curl_multi_init()),
+      _stop(false),
+      _memory_account("spectral lines", SPECTRAL_LINE_CACHE_COST, this) {}
+
+SpectralLineCache::~SpectralLineCache() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    if (_query_thread.joinable()) {
+        curl_multi_wakeup(_multi_handle);
+        _query_thread.join();
+    }
+    if (_multi_handle) {
+        curl_multi_cleanup(_multi_handle);
+    }
+}
+
+SpectralLineCache& SpectralLineCache::Global() {
+#ifdef SPLATALOGUE_URL
+    static const std::string url = SPLATALOGUE_URL;
+#else
+    static const std::string url = "https://splatalogue.online";
+#endif
+    static SpectralLineCache cache((size_t)SPECTRAL_LINE_CACHE_MB * 1024 * 1024, url,
+        SidecarCache::Enabled() ? (fs::path(SidecarCache::Folder()) / "spectral_lines").string() : "");
+    return cache;
+}
+
+void SpectralLineCache::Get(double freq_min, double freq_max, double intensity_limit, Callback callback) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    LoadFolder();
+    Table table;
+    auto it = FindEntry(freq_min, freq_max, intensity_limit);
+    if (it != _entries.end()) {
+        table = LoadTable(*it);
+        if (!table) {
+            _entries.erase(it);
+        }
+    }
+    Metrics::Global().RecordCacheLookup(CacheType::SpectralLines, table != nullptr);
+
+    if (table) {
+        lock.unlock();
+        _memory_account.Enforce(); // if loaded from the cache folder
+        callback(table, "");
+        return;
+    }
+
+    if (!_multi_handle) {
+        lock.unlock();
+        callback(nullptr, "Init curl failed.");
+        return;
+    }
+
+    auto url = QueryUrl(freq_min, freq_max, intensity_limit);
+    auto& query = _queries[url];
+    if (!query) {
+        query = std::make_shared<Query>(Query{freq_min, freq_max, intensity_limit, url, "", {}});
+        _new_queries.push_back(query);
+        if (!_query_thread.joinable()) {
+            _query_thread = std::thread(&SpectralLineCache::RunQueries, this);
+        }
+        curl_multi_wakeup(_multi_handle);
+    }
+    query->callbacks.push_back(std::move(callback));
+}
+
+IndexList SpectralLineCache::RowsInRange(const SpectralLineTable& table, double freq_min, double freq_max) {
+    IndexList rows;
+    for (size_t i = 0; i < table.frequencies.size(); ++i) {
+        if (table.frequencies[i] >= freq_min && table.frequencies[i] <= freq_max) {
+            rows.push_back(i);
+        }
+    }
+    return rows;
+}
+
+bool SpectralLineCache::Parse(const std::string& result, SpectralLineTable& table, std::string& error) {
+    std::istringstream line_stream(result);
+    std::string line, token;
+
+    // Extracting header part: fill in [Species, Chemical Name, ...]
+    table.headers.clear();
+    std::getline(line_stream, line, '\n');
+    std::istringstream header_token_stream(line);
+    while (std::getline(header_token_stream, token, '\t')) {
+        table.headers.push_back(token);
+    }
+
+    // Checking extracted header numbers & common headers, [0] = "Species", [1] = "Chemical Name"
+    if (table.headers.size() != NUM_HEADERS || table.headers[0] != Headers[0] || table.headers[1] != Headers[1]) {
+        error = "Received incorrect headers from splatalogue.";
+        return false;
+    }
+
+    // Parsing data part: parsing each line & fill in data columns, with empty values for missing ones so that columns align by row
+    std::vector<std::vector<std::string>> data_columns(NUM_HEADERS);
+    table.num_rows = 0;
+    while (std::getline(line_stream, line, '\n')) {
+        std::istringstream data_token_stream(line);
+        size_t column_index = 0;
+        while (std::getline(data_token_stream, token, '\t') && column_index < NUM_HEADERS) {
+            data_columns[column_index++].push_back(token);
+        }
+        for (; column_index < NUM_HEADERS; ++column_index) {
+            data_columns[column_index].push_back("");
+        }
+        table.num_rows++;
+    }
+
+    table.frequencies.resize(table.num_rows);
+    for (size_t row = 0; row < table.num_rows; ++row) {
+        double frequency;
+        if (!ParseFrequency(data_columns[REST_FREQUENCY_INDEX][row], frequency) &&
+            !ParseFrequency(data_columns[MEASURED_FREQUENCY_INDEX][row], frequency)) {
+            frequency = NAN;
+        }
+        table.frequencies[row] = frequency;
+    }
+
+    table.columns.clear();
+    for (size_t column_index = 0; column_index < NUM_HEADERS; ++column_index) {
+        table.columns.push_back(Column::FromValues(data_columns[column_index], table.headers[column_index]));
+    }
+
+    // Parsed values are at most the size of the text, plus the string objects
+    table.num_bytes = result.size() + table.num_rows * (NUM_HEADERS * sizeof(std::string) + sizeof(double));
+    return true;
+}
+
+std::string SpectralLineCache::QueryUrl(double freq_min, double freq_max, double intensity_limit) const {
+    // TODO: assemble parameters when frontend offers split settings
+    std::string base = "/c_export.php?&sid%5B%5D=&data_version=v3.0&lill=on";
+    std::string intensityLimit =
+        std::isnan(intensity_limit)
+            ? ""
+            : fmt::format("&lill_cdms_jpl={}", intensity_limit == 0 ? INTENSITY_LIMIT_WORKAROUND : intensity_limit);
+    std::string lineListParameters =
+        "&displayJPL=displayJPL&displayCDMS=displayCDMS&displayLovas=displayLovas"
+        "&displaySLAIM=displaySLAIM&displayToyaMA=displayToyaMA&displayOSU=displayOSU"
+        "&displayRecomb=displayRecomb&displayLisa=displayLisa&displayRFI=displayRFI";
+    std::string lineStrengthParameters = "&ls1=ls1&ls2=ls2&ls3=ls3&ls4=ls4&ls5=ls5";
+    std::string energyLevelParameters = "&el1=el1&el2=el2&el3=el3&el4=el4";
+    std::string miscellaneousParameters = fmt::format(
+        "&show_unres_qn=show_unres_qn&submit=Export&export_type=current&export_delimiter=tab"
+        "&offset=0&limit={}&range=on",
+        QUERY_ROW_LIMIT);
+    // workaround to fix splatalogue frequency range parameter bug
+    auto freqMinString = fmt::format(freq_min == std::floor(freq_min) ? "{:.0f}" : "{}", freq_min);
+    auto freqMaxString = fmt::format(freq_max == std::floor(freq_max) ? "{:.0f}" : "{}", freq_max);
+    std::string frequencyRangeStr = fmt::format("&frequency_units=MHz&from={}&to={}", freqMinString, freqMaxString);
+    return _url + base + intensityLimit + lineListParameters + lineStrengthParameters + energyLevelParameters + miscellaneousParameters +
+           frequencyRangeStr;
+}
+
+void SpectralLineCache::LoadFolder() {
+    // Caller holds the mutex. Only the ranges are read; the tables are read when used.
+    if (_folder_loaded) {
+        return;
+    }
+    _folder_loaded = true;
+    if (_folder.empty() || !fs::exists(_folder)) {
+        return;
+    }
+
+    try {
+        for (auto& file : fs::directory_iterator(_folder)) {
+            if (file.path().extension() != TABLE_FILE_EXTENSION) {
+                continue;
+            }
+            std::ifstream stream(file.path().string());
+            std::string line;
+            Entry entry;
+            int complete(0);
+            if (std::getline(stream, line) && std::sscanf(line.c_str(), "%lf\t%lf\t%lf\t%d", &entry.freq_min, &entry.freq_max,
+                                                  &entry.intensity_limit, &complete) == 4) {
+                entry.complete = complete;
+                entry.filename = file.path().string();
+                _entries.push_back(entry);
+            }
+        }
+    } catch (const std::exception& e) {
+        spdlog::warn("Could not read the spectral line cache folder {}: {}", _folder, e.what());
+    }
+}
+
+SpectralLineCache::EntryIter SpectralLineCache::FindEntry(double freq_min, double freq_max, double intensity_limit) {
+    // Caller holds the mutex. The query of the range itself, or else the narrowest complete table which includes it.
+    auto found = _entries.end();
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (!SameIntensityLimit(it->intensity_limit, intensity_limit) || it->freq_min > freq_min || it->freq_max < freq_max) {
+            continue;
+        }
+        if (it->freq_min == freq_min && it->freq_max == freq_max) {
+            found = it;
+            break;
+        }
+        if (it->complete && (found == _entries.end() || (it->freq_max - it->freq_min) < (found->freq_max - found->freq_min))) {
+            found = it;
+        }
+    }
+
+    if (found != _entries.end()) {
+        // Move entry to the front of the LRU list
+        _entries.splice(_entries.begin(), _entries, found);
+        found->last_used = std::chrono::steady_clock::now();
+    }
+    return found;
+}
+
+SpectralLineCache::Table SpectralLineCache::LoadTable(Entry& entry) {
+    // Caller holds the mutex. Table files are small enough to read while locked, and are read once.
+    if (entry.table) {
+        return entry.table;
+    }
+
+    auto table = std::make_shared<SpectralLineTable>();
+    table->freq_min = entry.freq_min;
+    table->freq_max = entry.freq_max;
+    table->intensity_limit = entry.intensity_limit;
+    table->complete = entry.complete;
+    std::ifstream stream(entry.filename);
+    std::string line;
+    std::getline(stream, line); // range
+    std::string result((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    std::string error;
+    if (!Parse(result, *table, error)) {
+        spdlog::warn("Removing invalid spectral line cache file {}: {}", entry.filename, error);
+        std::remove(entry.filename.c_str());
+        entry.filename.clear();
+        return nullptr;
+    }
+
+    entry.table = table;
+    _memory_usage += table->num_bytes;
+    Evict();
+    _memory_account.SetUsage(_memory_usage);
+    return table;
+}
+
+void SpectralLineCache::AddTable(Table table, const std::string& url, const std::string& result) {
+    // Written under a temporary name and renamed, so that other backends only see complete files
+    std::string filename;
+    if (!_folder.empty()) {
+        filename = fmt::format("{}/{:016x}{}", _folder, std::hash<std::string>()(url), TABLE_FILE_EXTENSION);
+        auto temp_filename = fmt::format("{}.{}.tmp", filename, getpid());
+        try {
+            fs::create_directories(_folder);
+            std::ofstream stream(temp_filename, std::ios::trunc);
+            stream << fmt::format("{}\t{}\t{}\t{}\n", table->freq_min, table->freq_max, table->intensity_limit, table->complete ? 1 : 0);
+            stream << result;
+            stream.close();
+            if (!stream) {
+                throw std::runtime_error("write failed");
+            }
+            fs::rename(temp_filename, filename);
+        } catch (const std::exception& e) {
+            spdlog::warn("Could not write spectral line cache file {}: {}", filename, e.what());
+            std::remove(temp_filename.c_str());
+            filename.clear();
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _entries.remove_if([&](const Entry& entry) {
+            bool same = SameIntensityLimit(entry.intensity_limit, table->intensity_limit) && entry.freq_min == table->freq_min &&
+                        entry.freq_max == table->freq_max;
+            if (same && entry.table) {
+                _memory_usage -= entry.table->num_bytes;
+            }
+            return same;
+        });
+        _entries.push_front(Entry{table->freq_min, table->freq_max, table->intensity_limit, table->complete, filename, table,
+            std::chrono::steady_clock::now()});
+        _memory_usage += table->num_bytes;
+        Evict();
+        _memory_account.SetUsage(_memory_usage);
+    }
+    _memory_account.Enforce();
+}
+
+void SpectralLineCache::Evict() {
+    // Caller holds the mutex. Tables in the cache folder keep their entries, to be read again.
+    auto it = _entries.end();
+    while (_memory_usage > _capacity_bytes && it != _entries.begin()) {
+        --it;
+        if (it->table) {
+            _memory_usage -= it->table->num_bytes;
+            it->table.reset();
+        }
+        if (it->filename.empty()) {
+            it = _entries.erase(it);
+        }
+    }
+}
+
+bool SpectralLineCache::OldestEntry(std::chrono::steady_clock::time_point& last_used) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto it = _entries.rbegin(); it != _entries.rend(); ++it) {
+        if (it->table) {
+            last_used = it->last_used;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SpectralLineCache::EvictOldest() {
+    // Sessions keep their own references to tables being sent
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto it = _entries.rbegin(); it != _entries.rend(); ++it) {
+        if (it->table) {
+            size_t num_bytes = it->table->num_bytes;
+            _memory_usage -= num_bytes;
+            it->table.reset();
+            if (it->filename.empty()) {
+                _entries.erase(std::next(it).base());
+            }
+            _memory_account.SetUsage(_memory_usage);
+            return num_bytes;
+        }
+    }
+    return 0;
+}
+
+void SpectralLineCache::RunQueries() {
+    std::unordered_map<CURL*, std::shared_ptr<Query>> transfers;
+    while (true) {
+        std::vector<std::shared_ptr<Query>> new_queries;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_stop) {
+                break;
+            }
+            new_queries.swap(_new_queries);
+        }
+
+        for (auto& query : new_queries) {
+            CURL* handle = curl_easy_init();
+            if (!handle) {
+                FinishQuery(query, "Init curl failed.");
+                continue;
+            }
+            curl_easy_setopt(handle, CURLOPT_URL, query->url.c_str());
+            curl_easy_setopt(handle, CURLOPT_WRITEDATA, &query->result);
+            curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+            curl_easy_setopt(handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+            curl_easy_setopt(handle, CURLOPT_TIMEOUT, (long)SPECTRAL_LINE_QUERY_TIMEOUT);
+            curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+            curl_multi_add_handle(_multi_handle, handle);
+            transfers[handle] = query;
+        }
+
+        int num_running(0);
+        curl_multi_perform(_multi_handle, &num_running);
+        int num_messages(0);
+        while (CURLMsg* message = curl_multi_info_read(_multi_handle, &num_messages)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL* handle = message->easy_handle;
+            std::string error;
+            long http_status(0);
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_status);
+            if (message->data.result != CURLE_OK) {
+                error = fmt::format("Spectral line query failed: {}", curl_easy_strerror(message->data.result));
+            } else if (http_status >= 400) {
+                error = fmt::format("Spectral line query failed: HTTP status {}", http_status);
+            }
+            auto query = transfers[handle];
+            transfers.erase(handle);
+            curl_multi_remove_handle(_multi_handle, handle);
+            curl_easy_cleanup(handle);
+            FinishQuery(query, error);
+        }
+
+        // Until a transfer has data, or a query is added
+        curl_multi_poll(_multi_handle, nullptr, 0, 1000, nullptr);
+    }
+
+    for (auto& [handle, query] : transfers) {
+        curl_multi_remove_handle(_multi_handle, handle);
+        curl_easy_cleanup(handle);
+    }
+}
+
+void SpectralLineCache::FinishQuery(std::shared_ptr<Query> query, const std::string& error) {
+    Table table;
+    std::string message(error);
+    if (message.empty()) {
+        auto parsed_table = std::make_shared<SpectralLineTable>();
+        parsed_table->freq_min = query->freq_min;
+        parsed_table->freq_max = query->freq_max;
+        parsed_table->intensity_limit = query->intensity_limit;
+        if (Parse(query->result, *parsed_table, message)) {
+            parsed_table->complete = (parsed_table->num_rows < QUERY_ROW_LIMIT);
+            table = parsed_table;
+            AddTable(table, query->url, query->result);
+        }
+    }
+    std::string().swap(query->result);
+
+    std::vector<Callback> callbacks;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _queries.erase(query->url);
+        callbacks.swap(query->callbacks);
+    }
+    for (auto& callback : callbacks) {
+        callback(table, message);
+    }
+}
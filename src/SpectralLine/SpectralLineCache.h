@@ -0,0 +1,118 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SpectralLineCache.h: parsed Splatalogue line tables shared by all sessions, queried without blocking the task threads
+
+#ifndef CARTA_BACKEND_SPECTRALLINE_SPECTRALLINECACHE_H_
+#define CARTA_BACKEND_SPECTRALLINE_SPECTRALLINECACHE_H_
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "../MemoryBudget.h"
+#include "../Table/Columns.h"
+
+namespace carta {
+
+// Lines of a Splatalogue query, as columns of the tab-separated result
+struct SpectralLineTable {
+    double freq_min; // MHz
+    double freq_max;
+    double intensity_limit; // CDMS/JPL intensity lower limit, NaN for none
+    // False if the query reached the row limit, so that the lines of a sub-range may be missing
+    bool complete;
+    std::vector<std::string> headers;
+    std::vector<std::unique_ptr<Column>> columns; // for each header; null if the values could not be parsed
+    std::vector<double> frequencies;              // of each line, rest or else measured; NaN if neither
+    size_t num_rows;
+    size_t num_bytes;
+};
+
+// Tables are kept in memory until evicted, and written to a folder so that they are reused by later backends. A range is answered
+// from a cached table of the same intensity limit which includes it. Queries run on one thread with a curl multi handle, which reuses
+// the connections to Splatalogue; a query for a range already being queried waits for it.
+class SpectralLineCache : private MemoryConsumer {
+public:
+    using Table = std::shared_ptr<const SpectralLineTable>;
+    // Table of a range which includes the requested range, or null with an error message
+    using Callback = std::function<void(Table table, const std::string& error)>;
+
+    // Tables are written to the folder unless it is empty
+    SpectralLineCache(size_t capacity_bytes, const std::string& url, const std::string& folder);
+    ~SpectralLineCache();
+    SpectralLineCache(const SpectralLineCache&) = delete;
+    SpectralLineCache& operator=(const SpectralLineCache&) = delete;
+
+    // Process-wide cache of the Splatalogue server, written to the sidecar cache folder if it is set
+    static SpectralLineCache& Global();
+
+    // Calls back on this thread if the range is cached, or else from the query thread when the query is done
+    void Get(double freq_min, double freq_max, double intensity_limit, Callback callback);
+
+    // Rows of the table with frequencies in a range
+    static IndexList RowsInRange(const SpectralLineTable& table, double freq_min, double freq_max);
+    static bool Parse(const std::string& result, SpectralLineTable& table, std::string& error);
+
+private:
+    struct Entry {
+        double freq_min;
+        double freq_max;
+        double intensity_limit;
+        bool complete;
+        std::string filename; // empty if not in the cache folder
+        Table table;          // null if only in the cache folder
+        std::chrono::steady_clock::time_point last_used;
+    };
+    struct Query {
+        double freq_min;
+        double freq_max;
+        double intensity_limit;
+        std::string url;
+        std::string result;
+        std::vector<Callback> callbacks;
+    };
+    using EntryIter = std::list<Entry>::iterator;
+
+    std::string QueryUrl(double freq_min, double freq_max, double intensity_limit) const;
+    void LoadFolder();
+    EntryIter FindEntry(double freq_min, double freq_max, double intensity_limit);
+    Table LoadTable(Entry& entry);
+    void AddTable(Table table, const std::string& url, const std::string& result);
+    void Evict();
+    bool OldestEntry(std::chrono::steady_clock::time_point& last_used) override;
+    size_t EvictOldest() override;
+
+    void RunQueries();
+    void FinishQuery(std::shared_ptr<Query> query, const std::string& error);
+
+    size_t _capacity_bytes;
+    std::string _url;
+    std::string _folder; // empty if tables are not written
+
+    std::mutex _mutex;
+    std::list<Entry> _entries; // most recently used first
+    bool _folder_loaded;
+    size_t _memory_usage;
+    std::unordered_map<std::string, std::shared_ptr<Query>> _queries; // by URL, until done
+    std::vector<std::shared_ptr<Query>> _new_queries;                  // not yet started by the query thread
+    CURLM* _multi_handle;
+    std::thread _query_thread; // started by the first query
+    bool _stop;
+    MemoryAccount _memory_account;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_SPECTRALLINE_SPECTRALLINECACHE_H_
@@ -6,26 +6,11 @@
 
 #include "SpectralLineCrawler.h"
 
-#include <curl/curl.h>
-#include <spdlog/fmt/fmt.h>
-
-#include <cstdlib>
-#include <iostream>
-#include <sstream>
-#include <string>
-
-#include "../Table/Columns.h"
+#include "SpectralLineCache.h"
 
 using namespace carta;
 
 #define REST_FREQUENCY_COLUMN_INDEX 2
-#define INTENSITY_LIMIT_WORKAROUND 0.000001
-#define NUM_HEADERS 18
-
-const std::string SpectralLineCrawler::Headers[] = {"Species", "Chemical Name", "Freq-MHz(rest frame,redshifted)",
-    "Freq Err(rest frame,redshifted)", "Meas Freq-MHz(rest frame,redshifted)", "Meas Freq Err(rest frame,redshifted)", "Resolved QNs",
-    "Unresolved Quantum Numbers", "CDMS/JPL Intensity", "S<sub>ij</sub>&#956;<sup>2</sup> (D<sup>2</sup>)", "S<sub>ij</sub>",
-    "Log<sub>10</sub> (A<sub>ij</sub>)", "Lovas/AST Intensity", "E_L (cm^-1)", "E_L (K)", "E_U (cm^-1)", "E_U (K)", "Linelist"};
 
 const std::unordered_map<std::string, std::string> SpectralLineCrawler::HeaderTypeMap = {{"Species", "string"}, {"Chemical Name", "string"},
     {"Shifted Frequency", "number"}, {"Freq-MHz(rest frame,redshifted)", "number"}, {"Freq Err(rest frame,redshifted)", "number"},
@@ -39,127 +24,50 @@ SpectralLineCrawler::SpectralLineCrawler() {}
 
 SpectralLineCrawler::~SpectralLineCrawler() {}
 
-/*
-    References:
-    1. curl example https://curl.haxx.se/libcurl/c/getinmemory.html
-    2. c++ example https://gist.github.com/alghanmi/c5d7b761b2c9ab199157
-*/
-void SpectralLineCrawler::SendRequest(const CARTA::DoubleBounds& frequencyRange, const double line_intensity_lower_limit,
-    CARTA::SpectralLineResponse& spectral_line_response) {
-    /* init the curl session */
-    CURL* curl_handle = curl_easy_init();
-    if (curl_handle == nullptr) {
-        spectral_line_response.set_success(false);
-        spectral_line_response.set_message("Init curl failed.");
-        return;
-    }
-    std::string readBuffer;
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &readBuffer);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, SpectralLineCrawler::WriteMemoryCallback);
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
-
-    /* specify URL to get */
-    // TODO: assemble parameters when frontend offers split settings
-#ifdef SPLATALOGUE_URL
-    std::string splatalog_url = SPLATALOGUE_URL;
-#else
-    std::string splatalog_url = "https://splatalogue.online";
-#endif
-    std::string base = "/c_export.php?&sid%5B%5D=&data_version=v3.0&lill=on";
-    std::string intensityLimit =
-        std::isnan(line_intensity_lower_limit)
-            ? ""
-            : fmt::format("&lill_cdms_jpl={}", line_intensity_lower_limit == 0 ? INTENSITY_LIMIT_WORKAROUND : line_intensity_lower_limit);
-    std::string lineListParameters =
-        "&displayJPL=displayJPL&displayCDMS=displayCDMS&displayLovas=displayLovas"
-        "&displaySLAIM=displaySLAIM&displayToyaMA=displayToyaMA&displayOSU=displayOSU"
-        "&displayRecomb=displayRecomb&displayLisa=displayLisa&displayRFI=displayRFI";
-    std::string lineStrengthParameters = "&ls1=ls1&ls2=ls2&ls3=ls3&ls4=ls4&ls5=ls5";
-    std::string energyLevelParameters = "&el1=el1&el2=el2&el3=el3&el4=el4";
-    std::string miscellaneousParameters =
-        "&show_unres_qn=show_unres_qn&submit=Export&export_type=current&export_delimiter=tab"
-        "&offset=0&limit=100000&range=on";
-    double freqMin = frequencyRange.min();
-    double freqMax = frequencyRange.max();
-    // workaround to fix splatalogue frequency range parameter bug
-    auto freqMinString = fmt::format(freqMin == std::floor(freqMin) ? "{:.0f}" : "{}", freqMin);
-    auto freqMaxString = fmt::format(freqMax == std::floor(freqMax) ? "{:.0f}" : "{}", freqMax);
-    std::string frequencyRangeStr = fmt::format("&frequency_units=MHz&from={}&to={}", freqMinString, freqMaxString);
-    std::string URL = splatalog_url + base + intensityLimit + lineListParameters + lineStrengthParameters + energyLevelParameters +
-                      miscellaneousParameters + frequencyRangeStr;
-    curl_easy_setopt(curl_handle, CURLOPT_URL, URL.c_str());
-
-    /* fetch data & parse */
-    CURLcode res = curl_easy_perform(curl_handle);
-    if (res == CURLE_OK) {
-        SpectralLineCrawler::ParseQueryResult(readBuffer, spectral_line_response);
-    } else {
-        spectral_line_response.set_success(false);
-        spectral_line_response.set_message(fmt::format("curl_easy_perform() failed: {}", curl_easy_strerror(res)));
-    }
-
-    /* cleanup curl stuff */
-    curl_easy_cleanup(curl_handle);
-
-    return;
-}
-
-size_t SpectralLineCrawler::WriteMemoryCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
-    return size * nmemb;
+void SpectralLineCrawler::SendRequest(
+    const CARTA::DoubleBounds& frequencyRange, const double line_intensity_lower_limit, const ResponseCallback& callback) {
+    double freq_min = frequencyRange.min();
+    double freq_max = frequencyRange.max();
+    SpectralLineCache::Global().Get(
+        freq_min, freq_max, line_intensity_lower_limit, [=](SpectralLineCache::Table table, const std::string& error) {
+            CARTA::SpectralLineResponse spectral_line_response;
+            if (table) {
+                SpectralLineCrawler::FillResponse(*table, freq_min, freq_max, spectral_line_response);
+            } else {
+                spectral_line_response.set_success(false);
+                spectral_line_response.set_message(error);
+            }
+            callback(spectral_line_response);
+        });
 }
 
-void SpectralLineCrawler::ParseQueryResult(const std::string& results, CARTA::SpectralLineResponse& spectral_line_response) {
-    std::vector<std::string> headers;
-    std::vector<std::vector<std::string>> data_columns;
-    int num_data_rows = 0;
-    std::istringstream line_stream(results);
-    std::string line, token;
-
-    // Extracting header part: fill in [Species, Chemical Name, ...] & create empty data columns
-    std::getline(line_stream, line, '\n');
-    std::istringstream header_token_stream(line);
-    while (std::getline(header_token_stream, token, '\t')) {
-        headers.push_back(token);
-        data_columns.push_back(std::vector<std::string>());
-    }
-
-    // Checking extracted header numbers & common headers, [0] = "Species", [1] = "Chemical Name"
-    if (headers.size() != NUM_HEADERS || headers[0] != SpectralLineCrawler::Headers[0] || headers[1] != SpectralLineCrawler::Headers[1]) {
-        spectral_line_response.set_success(false);
-        spectral_line_response.set_message("Received incorrect headers from splatalogue.");
-        return;
-    }
-
-    // Parsing data part: parsing each line & fill in data columns
-    while (std::getline(line_stream, line, '\n')) {
-        std::istringstream data_token_stream(line);
-        int column_index = 0;
-        while (std::getline(data_token_stream, token, '\t')) {
-            if (column_index < headers.size()) {
-                (data_columns[column_index]).push_back(token);
-            }
-            column_index++;
-        }
-        num_data_rows++;
+void SpectralLineCrawler::FillResponse(
+    const SpectralLineTable& table, double freq_min, double freq_max, CARTA::SpectralLineResponse& spectral_line_response) {
+    // Lines of the range, if the table is of a wider range
+    bool fill_subset = (freq_min != table.freq_min || freq_max != table.freq_max);
+    IndexList rows;
+    if (fill_subset) {
+        rows = SpectralLineCache::RowsInRange(table, freq_min, freq_max);
     }
+    int64_t num_data_rows = fill_subset ? rows.size() : table.num_rows;
 
     // Fill in response's headers & column data,
     // insert additional rest frequency in index REST_FREQUENCY_COLUMN_INDEX
+    const auto& headers = table.headers;
     auto response_headers = spectral_line_response.mutable_headers();
     auto response_columns = spectral_line_response.mutable_spectral_line_data();
     for (auto column_index = 0; column_index < headers.size() + 1; column_index++) {
         std::string column_name;
-        std::unique_ptr<Column> column;
+        const Column* column;
         if (column_index < REST_FREQUENCY_COLUMN_INDEX) {
             column_name = headers[column_index];
-            column = Column::FromValues(data_columns[column_index], column_name);
+            column = table.columns[column_index].get();
         } else if (column_index == REST_FREQUENCY_COLUMN_INDEX) { // insert shifted frequency column
             column_name = "Shifted Frequency";
-            column = Column::FromValues(data_columns[column_index], column_name);
+            column = table.columns[column_index].get();
         } else {
             column_name = headers[column_index - 1];
-            column = Column::FromValues(data_columns[column_index - 1], column_name);
+            column = table.columns[column_index - 1].get();
         }
 
         // headers
@@ -174,13 +82,11 @@ void SpectralLineCrawler::ParseQueryResult(const std::string& results, CARTA::Sp
         auto carta_column = CARTA::ColumnData();
         carta_column.set_data_type(CARTA::String);
         if (column) {
-            column->FillColumnData(carta_column, false, IndexList(), 0, num_data_rows);
+            column->FillColumnData(carta_column, fill_subset, rows, 0, num_data_rows);
         }
         (*response_columns)[column_index] = carta_column;
     }
 
     spectral_line_response.set_data_size(num_data_rows);
     spectral_line_response.set_success(true);
-
-    return;
 }
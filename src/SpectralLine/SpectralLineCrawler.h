@@ -8,21 +8,27 @@
 #define CARTA_BACKEND_SPECTRAL_LINE_CRAWLER_H_
 
 #include <carta-protobuf/spectral_line_request.pb.h>
+#include <functional>
 #include <string>
+#include <unordered_map>
 
 namespace carta {
+struct SpectralLineTable;
+
 class SpectralLineCrawler {
 public:
+    using ResponseCallback = std::function<void(CARTA::SpectralLineResponse& spectral_line_response)>;
+
     SpectralLineCrawler();
     ~SpectralLineCrawler();
-    static void SendRequest(const CARTA::DoubleBounds& frequencyRange, const double line_intensity_lower_limit,
-        CARTA::SpectralLineResponse& spectral_line_response);
+    // Calls back at once if the lines are cached, or else from the query thread when Splatalogue responds
+    static void SendRequest(
+        const CARTA::DoubleBounds& frequencyRange, const double line_intensity_lower_limit, const ResponseCallback& callback);
 
 private:
-    static const std::string Headers[];
     static const std::unordered_map<std::string, std::string> HeaderTypeMap;
-    static size_t WriteMemoryCallback(void* contents, size_t size, size_t nmemb, void* userp);
-    static void ParseQueryResult(const std::string& results, CARTA::SpectralLineResponse& spectral_line_response);
+    static void FillResponse(
+        const SpectralLineTable& table, double freq_min, double freq_max, CARTA::SpectralLineResponse& spectral_line_response);
 };
 } // namespace carta
 
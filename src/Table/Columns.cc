@@ -6,6 +6,7 @@
 
 #include "Columns.h"
 
+#include <algorithm>
 #include <memory>
 
 #include <fitsio.h>
@@ -24,6 +25,11 @@ Column::Column(const string& name_chr) {
     data_offset = 0;
 }
 
+void Column::MapBuffer(const std::shared_ptr<const uint8_t>& buffer, int num_rows, size_t stride) {
+    Resize(num_rows);
+    FillFromBuffer(buffer.get(), num_rows, stride);
+}
+
 std::unique_ptr<Column> Column::FromField(const pugi::xml_node& field) {
     auto data_type = field.attribute("datatype");
     string name = field.attribute("name").as_string();
@@ -81,6 +87,35 @@ std::unique_ptr<Column> Column::FromValues(const std::vector<string>& values, st
     return data_column_ptr;
 }
 
+std::unique_ptr<Column> Column::FromDataType(CARTA::ColumnType data_type, const string& name) {
+    switch (data_type) {
+        case CARTA::String:
+            return make_unique<DataColumn<string>>(name);
+        case CARTA::Uint8:
+            return make_unique<DataColumn<uint8_t>>(name);
+        case CARTA::Int8:
+            return make_unique<DataColumn<int8_t>>(name);
+        case CARTA::Uint16:
+            return make_unique<DataColumn<uint16_t>>(name);
+        case CARTA::Int16:
+            return make_unique<DataColumn<int16_t>>(name);
+        case CARTA::Uint32:
+            return make_unique<DataColumn<uint32_t>>(name);
+        case CARTA::Int32:
+            return make_unique<DataColumn<int32_t>>(name);
+        case CARTA::Uint64:
+            return make_unique<DataColumn<uint64_t>>(name);
+        case CARTA::Int64:
+            return make_unique<DataColumn<int64_t>>(name);
+        case CARTA::Float:
+            return make_unique<DataColumn<float>>(name);
+        case CARTA::Double:
+            return make_unique<DataColumn<double>>(name);
+        default:
+            return make_unique<Column>(name);
+    }
+}
+
 void TrimSpaces(string& str) {
     str.erase(str.find_last_not_of(' ') + 1);
 }
@@ -206,6 +241,23 @@ void DataColumn<string>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t
     }
 }
 
+template <>
+bool DataColumn<string>::StringFilterBitmap(SelectionBitmap& bitmap, string search_string, bool case_insensitive) const {
+    // Distinct values are compared instead of each row, and only those with all trigrams of the search string
+    unique_lock<mutex> index_lock(_string_index_mutex);
+    if (!_string_index) {
+        _string_index = make_unique<StringIndex>();
+    }
+    if (_string_index->NumRows() != entries.size()) {
+        if (_string_index->NumRows() > entries.size()) {
+            _string_index = make_unique<StringIndex>();
+        }
+        _string_index->Update(entries);
+    }
+    _string_index->Filter(search_string, case_insensitive, bitmap);
+    return true;
+}
+
 // Specialisation for strings because they don't support std::isnan
 template <>
 void DataColumn<string>::SortIndices(IndexList& indices, bool ascending) const {
@@ -9,6 +9,8 @@
 
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -19,9 +21,11 @@
 #include <carta-protobuf/defs.pb.h>
 #include <carta-protobuf/enums.pb.h>
 
+#include "SelectionBitmap.h"
+#include "StringIndex.h"
+
 namespace carta {
 
-typedef std::vector<int64_t> IndexList;
 template <class T>
 class DataColumn;
 
@@ -29,9 +33,11 @@ class Column {
 public:
     Column(const std::string& name_chr);
     virtual ~Column() = default;
-    virtual void SetFromText(const pugi::xml_text& text, size_t index){};
+    virtual void SetFromString(const std::string& text, size_t index){};
     virtual void SetEmpty(size_t index){};
     virtual void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride){};
+    // Uses the values in a memory-mapped table buffer in place if supported, otherwise copies them like FillFromBuffer
+    virtual void MapBuffer(const std::shared_ptr<const uint8_t>& buffer, int num_rows, size_t stride);
     virtual void Resize(size_t capacity){};
     virtual size_t NumEntries() const {
         return 0;
@@ -39,6 +45,19 @@ public:
     virtual void SortIndices(IndexList& indices, bool ascending) const {};
     virtual void FilterIndices(IndexList& existing_indices, bool is_subset, CARTA::ComparisonOperator comparison_operator, double value,
         double secondary_value = 0.0) const {}
+    // Sets the bits of the rows which pass the comparison, for all rows; false if the column type cannot be compared
+    virtual bool FilterBitmap(
+        SelectionBitmap& bitmap, CARTA::ComparisonOperator comparison_operator, double value, double secondary_value = 0.0) const {
+        return false;
+    }
+    // Sets the bits of the rows containing the search string; false for columns which are not strings
+    virtual bool StringFilterBitmap(SelectionBitmap& bitmap, std::string search_string, bool case_insensitive = false) const {
+        return false;
+    }
+    // All values of a numeric column as doubles; false for other columns
+    virtual bool NumericValues(std::vector<double>& values) const {
+        return false;
+    }
 
     virtual void FillColumnData(
         CARTA::ColumnData& column_data, bool fill_subset, const IndexList& indices, int64_t start, int64_t end) const {};
@@ -48,6 +67,8 @@ public:
     static std::unique_ptr<Column> FromFitsPtr(fitsfile* fits_ptr, int column_index, size_t& data_offset);
     // Factory for constructing a column from a data(string) vector
     static std::unique_ptr<Column> FromValues(const std::vector<std::string>& values, const std::string name);
+    // Factory for constructing an empty column of a data type; unsupported types and bool give a column without data
+    static std::unique_ptr<Column> FromDataType(CARTA::ColumnType data_type, const std::string& name);
 
     CARTA::ColumnType data_type;
     std::string name;
@@ -65,15 +86,22 @@ public:
     std::vector<T> entries;
     DataColumn(const std::string& name_chr);
     virtual ~DataColumn() = default;
-    void SetFromText(const pugi::xml_text& text, size_t index) override;
+    void SetFromString(const std::string& text, size_t index) override;
     void SetFromValue(T value, size_t index);
     void SetEmpty(size_t index) override;
     void FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) override;
+    void MapBuffer(const std::shared_ptr<const uint8_t>& buffer, int num_rows, size_t stride) override;
     void Resize(size_t capacity) override;
     size_t NumEntries() const override;
     void SortIndices(IndexList& indices, bool ascending) const override;
     void FilterIndices(IndexList& existing_indices, bool is_subset, CARTA::ComparisonOperator comparison_operator, double value,
         double secondary_value = 0.0) const override;
+    bool FilterBitmap(SelectionBitmap& bitmap, CARTA::ComparisonOperator comparison_operator, double value,
+        double secondary_value = 0.0) const override;
+    bool StringFilterBitmap(SelectionBitmap& bitmap, std::string search_string, bool case_insensitive = false) const override;
+    bool NumericValues(std::vector<double>& values) const override;
+    // Value of a row, from entries or from the mapped buffer
+    T Value(size_t index) const;
     std::vector<T> GetColumnData(bool fill_subset, const IndexList& indices, int64_t start, int64_t end) const;
     void FillColumnData(
         CARTA::ColumnData& column_data, bool fill_subset, const IndexList& indices, int64_t start, int64_t end) const override;
@@ -86,7 +114,19 @@ public:
     }
 
 protected:
-    T FromText(const pugi::xml_text& text);
+    T FromString(const std::string& text);
+    static T FromBigEndian(const uint8_t* ptr);
+    // All values in a vector, decoded in one pass if the column is mapped
+    const std::vector<T>& AllValues(std::vector<T>& decoded_values) const;
+
+    // Big-endian values of a mapped FITS table, used instead of entries when set; strided by the table row length
+    std::shared_ptr<const uint8_t> _mapped_data;
+    size_t _mapped_stride = 0;
+    size_t _num_mapped_rows = 0;
+
+    // Search index of a string column, made by the first search and extended when rows are added
+    mutable std::unique_ptr<StringIndex> _string_index;
+    mutable std::mutex _string_index_mutex;
 };
 } // namespace carta
 
@@ -9,6 +9,9 @@
 
 #include "Columns.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 #include "Threading.h"
@@ -67,26 +70,32 @@ DataColumn<T>::DataColumn(const std::string& name_chr) : Column(name_chr) {
 }
 
 template <class T>
-T DataColumn<T>::FromText(const pugi::xml_text& text) {
-    // Parse properly based on template type or traits
+T DataColumn<T>::FromString(const std::string& text) {
+    // Parse properly based on template type or traits, with the defaults for empty or invalid text
     if constexpr (std::is_same_v<T, std::string>) {
-        return text.as_string();
-    } else if constexpr (std::is_same_v<T, double>) {
-        return text.as_double(std::numeric_limits<T>::quiet_NaN());
+        return text;
     } else if constexpr (std::is_floating_point_v<T>) {
-        return text.as_float(std::numeric_limits<T>::quiet_NaN());
-    } else if constexpr (std::is_same_v<T, int64_t>) {
-        return text.as_llong(0);
+        char* end;
+        double value = std::strtod(text.c_str(), &end);
+        return (end == text.c_str()) ? std::numeric_limits<T>::quiet_NaN() : value;
     } else if constexpr (std::is_arithmetic_v<T>) {
-        return text.as_int(0);
+        // Decimal or hexadecimal, clamped to int unless the type is int64
+        auto start = text.find_first_not_of(" \t\r\n");
+        bool hex = (start != std::string::npos) && (text.compare(start + (text[start] == '-' || text[start] == '+'), 2, "0x") == 0);
+        long long value = std::strtoll(text.c_str(), nullptr, hex ? 16 : 10);
+        if constexpr (std::is_same_v<T, int64_t>) {
+            return value;
+        } else {
+            return (int)clamp(value, (long long)std::numeric_limits<int>::min(), (long long)std::numeric_limits<int>::max());
+        }
     } else {
         return T();
     }
 }
 
 template <class T>
-void DataColumn<T>::SetFromText(const pugi::xml_text& text, size_t index) {
-    entries[index] = FromText(text);
+void DataColumn<T>::SetFromString(const std::string& text, size_t index) {
+    entries[index] = FromString(text);
 }
 
 template <class T>
@@ -103,38 +112,84 @@ void DataColumn<T>::SetEmpty(size_t index) {
     }
 }
 
+template <class T>
+T DataColumn<T>::FromBigEndian(const uint8_t* ptr) {
+    // Convert from big-endian to little-endian if the data type holds multiple bytes.
+    // The constexpr qualifier means that the if statements will be evaluated at compile-time to avoid branching
+    if constexpr (!std::is_arithmetic_v<T>) {
+        return T();
+    } else if constexpr (sizeof(T) == 2) {
+        uint16_t temp_val;
+        memcpy(&temp_val, ptr, sizeof(T));
+        temp_val = __builtin_bswap16(temp_val);
+        return *((T*)&temp_val);
+    } else if constexpr (sizeof(T) == 4) {
+        uint32_t temp_val;
+        memcpy(&temp_val, ptr, sizeof(T));
+        temp_val = __builtin_bswap32(temp_val);
+        return *((T*)&temp_val);
+    } else if constexpr (sizeof(T) == 8) {
+        uint64_t temp_val;
+        memcpy(&temp_val, ptr, sizeof(T));
+        temp_val = __builtin_bswap64(temp_val);
+        return *((T*)&temp_val);
+    } else {
+        T val;
+        memcpy(&val, ptr, sizeof(T));
+        return val;
+    }
+}
+
 template <class T>
 void DataColumn<T>::FillFromBuffer(const uint8_t* ptr, int num_rows, size_t stride) {
     // Shifts by the column's offset
     ptr += data_offset;
-    T* val_ptr = entries.data();
 
     if (!stride || !data_type_size || num_rows > entries.size()) {
         return;
     }
 
-    // Convert from big-endian to little-endian if the data type holds multiple bytes.
-    // The constexpr qualifier means that the if statements will be evaluated at compile-time to avoid branching
     for (auto i = 0; i < num_rows; i++) {
-        if constexpr (sizeof(T) == 2) {
-            uint16_t temp_val;
-            memcpy(&temp_val, ptr + stride * i, sizeof(T));
-            temp_val = __builtin_bswap16(temp_val);
-            entries[i] = *((T*)&temp_val);
-        } else if constexpr (sizeof(T) == 4) {
-            uint32_t temp_val;
-            memcpy(&temp_val, ptr + stride * i, sizeof(T));
-            temp_val = __builtin_bswap32(temp_val);
-            entries[i] = *((T*)&temp_val);
-        } else if constexpr (sizeof(T) == 8) {
-            uint64_t temp_val;
-            memcpy(&temp_val, ptr + stride * i, sizeof(T));
-            temp_val = __builtin_bswap64(temp_val);
-            entries[i] = *((T*)&temp_val);
-        } else {
-            memcpy(val_ptr + i, ptr + stride * i, sizeof(T));
+        entries[i] = FromBigEndian(ptr + stride * i);
+    }
+}
+
+template <class T>
+void DataColumn<T>::MapBuffer(const std::shared_ptr<const uint8_t>& buffer, int num_rows, size_t stride) {
+    // Numeric values are read in place and swapped when used; other types are copied
+    if constexpr (std::is_arithmetic_v<T>) {
+        if (stride && data_type_size) {
+            // Shares ownership of the buffer, shifted by the column's offset
+            _mapped_data = std::shared_ptr<const uint8_t>(buffer, buffer.get() + data_offset);
+            _mapped_stride = stride;
+            _num_mapped_rows = num_rows;
+            return;
         }
     }
+    Column::MapBuffer(buffer, num_rows, stride);
+}
+
+template <class T>
+T DataColumn<T>::Value(size_t index) const {
+    if (_mapped_data) {
+        return FromBigEndian(_mapped_data.get() + _mapped_stride * index);
+    }
+    return entries[index];
+}
+
+template <class T>
+const std::vector<T>& DataColumn<T>::AllValues(std::vector<T>& decoded_values) const {
+    if (!_mapped_data) {
+        return entries;
+    }
+
+    decoded_values.resize(_num_mapped_rows);
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)_num_mapped_rows; i++) {
+        decoded_values[i] = FromBigEndian(_mapped_data.get() + _mapped_stride * i);
+    }
+    return decoded_values;
 }
 
 template <class T>
@@ -144,20 +199,24 @@ void DataColumn<T>::Resize(size_t capacity) {
 
 template <class T>
 size_t DataColumn<T>::NumEntries() const {
-    return entries.size();
+    return _mapped_data ? _num_mapped_rows : entries.size();
 }
 
 template <class T>
 void DataColumn<T>::SortIndices(IndexList& indices, bool ascending) const {
-    if (indices.empty() || entries.empty()) {
+    if (indices.empty() || !NumEntries()) {
         return;
     }
 
+    // Values are compared many times, so a mapped column is decoded once
+    std::vector<T> decoded_values;
+    const std::vector<T>& values = AllValues(decoded_values);
+
     // Perform ascending or descending sort
     if (ascending) {
         parallel_sort(indices.begin(), indices.end(), [&](int64_t a, int64_t b) {
-            auto val_a = entries[a];
-            auto val_b = entries[b];
+            auto val_a = values[a];
+            auto val_b = values[b];
             if (std::isnan(val_a)) {
                 return false;
             } else if (std::isnan(val_b)) {
@@ -168,8 +227,8 @@ void DataColumn<T>::SortIndices(IndexList& indices, bool ascending) const {
         });
     } else {
         parallel_sort(indices.begin(), indices.end(), [&](int64_t a, int64_t b) {
-            auto val_a = entries[a];
-            auto val_b = entries[b];
+            auto val_a = values[a];
+            auto val_b = values[b];
             if (std::isnan(val_a)) {
                 return false;
             } else if (std::isnan(val_b)) {
@@ -190,7 +249,7 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
         T typed_secondary_value = secondary_value;
 
         IndexList matching_indices;
-        size_t num_entries = entries.size();
+        size_t num_entries = NumEntries();
 
         if (is_subset) {
             for (auto i : existing_indices) {
@@ -198,7 +257,7 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
                 if (i < 0 || i >= num_entries) {
                     continue;
                 }
-                T val = entries[i];
+                T val = Value(i);
                 bool filter_pass = (comparison_operator == CARTA::Equal && val == typed_value) ||
                                    (comparison_operator == CARTA::NotEqual && val != typed_value) ||
                                    (comparison_operator == CARTA::Lesser && val < typed_value) ||
@@ -213,7 +272,7 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
             }
         } else {
             for (auto i = 0; i < num_entries; i++) {
-                T val = entries[i];
+                T val = Value(i);
                 bool filter_pass = (comparison_operator == CARTA::Equal && val == typed_value) ||
                                    (comparison_operator == CARTA::NotEqual && val != typed_value) ||
                                    (comparison_operator == CARTA::Lesser && val < typed_value) ||
@@ -231,6 +290,95 @@ void DataColumn<T>::FilterIndices(IndexList& existing_indices, bool is_subset, C
     }
 }
 
+template <class T>
+bool DataColumn<T>::FilterBitmap(
+    SelectionBitmap& bitmap, CARTA::ComparisonOperator comparison_operator, double value, double secondary_value) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        T typed_value = value;
+        T typed_secondary_value = secondary_value;
+        size_t num_entries = NumEntries();
+        bitmap = SelectionBitmap(num_entries);
+        uint64_t* words = bitmap.Words();
+        int64_t num_words = bitmap.NumWords();
+
+        // Each word is set from a block of 64 values with the same comparison, so that the comparisons can be vectorised
+        auto fill_words = [&](auto filter_pass) {
+            ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(static)
+            for (int64_t w = 0; w < num_words; w++) {
+                size_t first_row = w * 64;
+                size_t block_size = std::min((size_t)64, num_entries - first_row);
+                T block[64];
+                const T* block_values = block;
+                if constexpr (!std::is_same_v<T, bool>) {
+                    if (!_mapped_data) {
+                        block_values = entries.data() + first_row;
+                    }
+                }
+                if (block_values == block) {
+                    for (size_t k = 0; k < block_size; k++) {
+                        block[k] = Value(first_row + k);
+                    }
+                }
+                uint64_t bits(0);
+                for (size_t k = 0; k < block_size; k++) {
+                    bits |= (uint64_t)filter_pass(block_values[k]) << k;
+                }
+                words[w] = bits;
+            }
+        };
+
+        switch (comparison_operator) {
+            case CARTA::Equal:
+                fill_words([&](T val) { return val == typed_value; });
+                break;
+            case CARTA::NotEqual:
+                fill_words([&](T val) { return val != typed_value; });
+                break;
+            case CARTA::Lesser:
+                fill_words([&](T val) { return val < typed_value; });
+                break;
+            case CARTA::Greater:
+                fill_words([&](T val) { return val > typed_value; });
+                break;
+            case CARTA::LessorOrEqual:
+                fill_words([&](T val) { return val <= typed_value; });
+                break;
+            case CARTA::GreaterOrEqual:
+                fill_words([&](T val) { return val >= typed_value; });
+                break;
+            case CARTA::RangeClosed:
+                fill_words([&](T val) { return val >= typed_value && val <= typed_secondary_value; });
+                break;
+            case CARTA::RangeOpen:
+                fill_words([&](T val) { return val > typed_value && val < typed_secondary_value; });
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+    return false;
+}
+
+template <class T>
+bool DataColumn<T>::StringFilterBitmap(SelectionBitmap& bitmap, std::string search_string, bool case_insensitive) const {
+    return false;
+}
+
+template <class T>
+bool DataColumn<T>::NumericValues(std::vector<double>& values) const {
+    // only apply to template types that are arithmetic
+    if constexpr (std::is_arithmetic_v<T>) {
+        std::vector<T> decoded_values;
+        const std::vector<T>& typed_values = AllValues(decoded_values);
+        values.assign(typed_values.begin(), typed_values.end());
+        return true;
+    }
+    return false;
+}
+
 template <class T>
 std::vector<T> DataColumn<T>::GetColumnData(bool fill_subset, const IndexList& indices, int64_t start, int64_t end) const {
     if (fill_subset) {
@@ -246,17 +394,25 @@ std::vector<T> DataColumn<T>::GetColumnData(bool fill_subset, const IndexList& i
         std::vector<T> values;
         values.reserve(std::distance(begin_it, end_it));
         for (auto it = begin_it; it != end_it; it++) {
-            values.push_back(entries[*it]);
+            values.push_back(Value(*it));
         }
         return values;
     } else {
-        int64_t N = entries.size();
+        int64_t N = NumEntries();
         int64_t begin_index = clamp(start, (int64_t)0, N);
         if (end < 0) {
             end = N;
         }
         int64_t end_index = clamp(end, begin_index, N);
 
+        if (_mapped_data) {
+            std::vector<T> values(end_index - begin_index);
+            for (int64_t i = begin_index; i < end_index; i++) {
+                values[i - begin_index] = Value(i);
+            }
+            return values;
+        }
+
         auto begin_it = entries.begin() + begin_index;
         auto end_it = entries.begin() + end_index;
         return std::vector<T>(begin_it, end_it);
@@ -0,0 +1,107 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "PositionIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace carta {
+
+PositionIndex::PositionIndex(const std::vector<double>& x, const std::vector<double>& y)
+    : _num_rows(std::min(x.size(), y.size())),
+      _x_start(0),
+      _y_start(0),
+      _cell_width(1),
+      _cell_height(1),
+      _num_cells_x(1),
+      _num_cells_y(1) {
+    // Grid over the extent of the finite positions
+    double x_min(INFINITY), x_max(-INFINITY), y_min(INFINITY), y_max(-INFINITY);
+    size_t num_positions(0);
+    for (size_t i = 0; i < _num_rows; i++) {
+        if (std::isfinite(x[i]) && std::isfinite(y[i])) {
+            x_min = std::min(x_min, x[i]);
+            x_max = std::max(x_max, x[i]);
+            y_min = std::min(y_min, y[i]);
+            y_max = std::max(y_max, y[i]);
+            num_positions++;
+        }
+    }
+    if (num_positions) {
+        int64_t num_cells = std::ceil(std::sqrt((double)num_positions / POSITION_INDEX_CELL_ROWS));
+        num_cells = std::min(std::max(num_cells, (int64_t)1), (int64_t)POSITION_INDEX_MAX_CELLS);
+        _num_cells_x = _num_cells_y = num_cells;
+        _x_start = x_min;
+        _y_start = y_min;
+        _cell_width = x_max > x_min ? (x_max - x_min) / num_cells : 1;
+        _cell_height = y_max > y_min ? (y_max - y_min) / num_cells : 1;
+    }
+
+    // Positions are counted into their cells, then placed in cell order
+    auto cell_of = [&](size_t i) {
+        int64_t cell_x = std::min((int64_t)((x[i] - _x_start) / _cell_width), _num_cells_x - 1);
+        int64_t cell_y = std::min((int64_t)((y[i] - _y_start) / _cell_height), _num_cells_y - 1);
+        return cell_y * _num_cells_x + cell_x;
+    };
+    _cell_offsets.assign(_num_cells_x * _num_cells_y + 1, 0);
+    for (size_t i = 0; i < _num_rows; i++) {
+        if (std::isfinite(x[i]) && std::isfinite(y[i])) {
+            _cell_offsets[cell_of(i) + 1]++;
+        }
+    }
+    for (size_t cell = 1; cell < _cell_offsets.size(); cell++) {
+        _cell_offsets[cell] += _cell_offsets[cell - 1];
+    }
+
+    std::vector<size_t> next(_cell_offsets.begin(), _cell_offsets.end() - 1);
+    _rows.resize(num_positions);
+    _x.resize(num_positions);
+    _y.resize(num_positions);
+    for (size_t i = 0; i < _num_rows; i++) {
+        if (std::isfinite(x[i]) && std::isfinite(y[i])) {
+            size_t position = next[cell_of(i)]++;
+            _rows[position] = i;
+            _x[position] = x[i];
+            _y[position] = y[i];
+        }
+    }
+}
+
+void PositionIndex::Select(double x_min, double x_max, double y_min, double y_max, SelectionBitmap& bitmap) const {
+    bitmap = SelectionBitmap(_num_rows);
+    if (_rows.empty() || !(x_min <= x_max) || !(y_min <= y_max)) {
+        return;
+    }
+
+    // Cells overlapping the box
+    auto cell_index = [](double value, double start, double size, int64_t num_cells) {
+        return (int64_t)std::clamp(std::floor((value - start) / size), 0.0, (double)(num_cells - 1));
+    };
+    int64_t cell_x_begin = cell_index(x_min, _x_start, _cell_width, _num_cells_x);
+    int64_t cell_x_end = cell_index(x_max, _x_start, _cell_width, _num_cells_x);
+    int64_t cell_y_begin = cell_index(y_min, _y_start, _cell_height, _num_cells_y);
+    int64_t cell_y_end = cell_index(y_max, _y_start, _cell_height, _num_cells_y);
+
+    uint64_t* words = bitmap.Words();
+    for (int64_t cell_y = cell_y_begin; cell_y <= cell_y_end; cell_y++) {
+        // Positions in cells between the first and last cells are inside the box, as they are binned like the box edges
+        bool inside_y = cell_y > cell_y_begin && cell_y < cell_y_end;
+        for (int64_t cell_x = cell_x_begin; cell_x <= cell_x_end; cell_x++) {
+            bool inside_x = cell_x > cell_x_begin && cell_x < cell_x_end;
+            size_t cell = cell_y * _num_cells_x + cell_x;
+            for (size_t position = _cell_offsets[cell]; position < _cell_offsets[cell + 1]; position++) {
+                if ((inside_x && inside_y) ||
+                    (_x[position] >= x_min && _x[position] <= x_max && _y[position] >= y_min && _y[position] <= y_max)) {
+                    int64_t row = _rows[position];
+                    words[row / 64] |= (uint64_t)1 << (row % 64);
+                }
+            }
+        }
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,46 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TABLE_POSITIONINDEX_H_
+#define CARTA_BACKEND_TABLE_POSITIONINDEX_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "SelectionBitmap.h"
+
+// Mean number of positions in a grid cell, and the largest number of cells on each axis
+#define POSITION_INDEX_CELL_ROWS 16
+#define POSITION_INDEX_MAX_CELLS 4096
+
+namespace carta {
+
+// Rows of a table bucketed by the grid cell of their position in two columns, so that the rows in a box are found from the cells
+// overlapping it: rows in cells inside the box are taken without comparing their positions. Rows with NaN positions are not
+// indexed.
+class PositionIndex {
+public:
+    PositionIndex(const std::vector<double>& x, const std::vector<double>& y);
+
+    size_t NumRows() const {
+        return _num_rows;
+    }
+
+    // Sets the bits of the rows with x_min <= x <= x_max and y_min <= y <= y_max
+    void Select(double x_min, double x_max, double y_min, double y_max, SelectionBitmap& bitmap) const;
+
+private:
+    size_t _num_rows;
+    double _x_start, _y_start, _cell_width, _cell_height;
+    int64_t _num_cells_x, _num_cells_y;
+    std::vector<size_t> _cell_offsets; // first position of each cell, and the number of positions
+    std::vector<int64_t> _rows;        // row of each position, by cell
+    std::vector<double> _x, _y;        // positions, by cell
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TABLE_POSITIONINDEX_H_
@@ -0,0 +1,64 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "SelectionBitmap.h"
+
+#include <algorithm>
+
+namespace carta {
+
+SelectionBitmap::SelectionBitmap(size_t num_rows) : _num_rows(num_rows), _words((num_rows + 63) / 64, 0) {}
+
+size_t SelectionBitmap::Count() const {
+    size_t count(0);
+    for (auto word : _words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+void SelectionBitmap::And(const SelectionBitmap& other) {
+    size_t num_words = std::min(_words.size(), other._words.size());
+    for (size_t i = 0; i < num_words; i++) {
+        _words[i] &= other._words[i];
+    }
+    std::fill(_words.begin() + num_words, _words.end(), 0);
+}
+
+IndexList SelectionBitmap::Indices(int64_t start, int64_t end) const {
+    IndexList indices;
+    start = std::max(start, (int64_t)0);
+    if (end >= 0 && end <= start) {
+        return indices;
+    }
+    if (end >= 0) {
+        indices.reserve(end - start);
+    }
+
+    // Whole words before the start are skipped by their counts
+    int64_t count(0);
+    for (size_t i = 0; i < _words.size(); i++) {
+        uint64_t word = _words[i];
+        int64_t word_count = __builtin_popcountll(word);
+        if (count + word_count <= start) {
+            count += word_count;
+            continue;
+        }
+        while (word) {
+            int bit = __builtin_ctzll(word);
+            word &= word - 1;
+            if (count++ >= start) {
+                indices.push_back(i * 64 + bit);
+                if (count == end) {
+                    return indices;
+                }
+            }
+        }
+    }
+    return indices;
+}
+
+} // namespace carta
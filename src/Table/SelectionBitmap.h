@@ -0,0 +1,48 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TABLE_SELECTIONBITMAP_H_
+#define CARTA_BACKEND_TABLE_SELECTIONBITMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace carta {
+
+typedef std::vector<int64_t> IndexList;
+
+// Selected rows of a table as one bit per row, 64 rows to a word
+class SelectionBitmap {
+public:
+    explicit SelectionBitmap(size_t num_rows = 0);
+
+    size_t NumRows() const {
+        return _num_rows;
+    }
+    size_t NumWords() const {
+        return _words.size();
+    }
+    uint64_t* Words() {
+        return _words.data();
+    }
+    const uint64_t* Words() const {
+        return _words.data();
+    }
+
+    size_t Count() const;
+    void And(const SelectionBitmap& other);
+    // Indices of the selected rows from the start-th to before the end-th selected row; end -1 for all
+    IndexList Indices(int64_t start = 0, int64_t end = -1) const;
+
+private:
+    size_t _num_rows;
+    std::vector<uint64_t> _words;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TABLE_SELECTIONBITMAP_H_
@@ -0,0 +1,106 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "StringIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+#include "Threading.h"
+
+namespace carta {
+
+std::string StringIndex::ToLower(const std::string& text) {
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    return lower;
+}
+
+void StringIndex::Update(const std::vector<std::string>& entries) {
+    std::vector<uint32_t> trigrams;
+    for (size_t i = _codes.size(); i < entries.size(); i++) {
+        auto result = _value_codes.emplace(entries[i], _values.size());
+        uint32_t code = result.first->second;
+        _codes.push_back(code);
+        if (!result.second) {
+            continue;
+        }
+
+        // New value; each trigram is listed once
+        _values.push_back(entries[i]);
+        _lower_values.push_back(ToLower(entries[i]));
+        const std::string& lower = _lower_values.back();
+        trigrams.clear();
+        for (size_t pos = 0; pos + 3 <= lower.size(); pos++) {
+            trigrams.push_back(Trigram(lower, pos));
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        for (auto trigram : trigrams) {
+            _trigram_values[trigram].push_back(code);
+        }
+    }
+}
+
+void StringIndex::Filter(const std::string& search_string, bool case_insensitive, SelectionBitmap& bitmap) const {
+    std::string lower_search = ToLower(search_string);
+
+    // Candidate values contain all trigrams of the search string; its case is checked against the values themselves
+    std::vector<uint32_t> candidates;
+    bool all_candidates = lower_search.size() < 3;
+    if (!all_candidates) {
+        std::vector<const std::vector<uint32_t>*> lists;
+        for (size_t pos = 0; pos + 3 <= lower_search.size(); pos++) {
+            auto it = _trigram_values.find(Trigram(lower_search, pos));
+            if (it == _trigram_values.end()) {
+                lists.clear();
+                break;
+            }
+            lists.push_back(&it->second);
+        }
+        if (!lists.empty()) {
+            std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+            candidates = *lists[0];
+            std::vector<uint32_t> intersection;
+            for (size_t k = 1; k < lists.size() && !candidates.empty(); k++) {
+                intersection.clear();
+                std::set_intersection(
+                    candidates.begin(), candidates.end(), lists[k]->begin(), lists[k]->end(), std::back_inserter(intersection));
+                candidates.swap(intersection);
+            }
+        }
+    }
+
+    std::vector<uint8_t> value_matches(_values.size(), 0);
+    int64_t num_candidates = all_candidates ? _values.size() : candidates.size();
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(static)
+    for (int64_t k = 0; k < num_candidates; k++) {
+        uint32_t code = all_candidates ? k : candidates[k];
+        if (case_insensitive) {
+            value_matches[code] = _lower_values[code].find(lower_search) != std::string::npos;
+        } else {
+            value_matches[code] = _values[code].find(search_string) != std::string::npos;
+        }
+    }
+
+    size_t num_rows = _codes.size();
+    bitmap = SelectionBitmap(num_rows);
+    uint64_t* words = bitmap.Words();
+    ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(static)
+    for (int64_t w = 0; w < (int64_t)bitmap.NumWords(); w++) {
+        size_t end_row = std::min(num_rows, (size_t)(w + 1) * 64);
+        uint64_t bits(0);
+        for (size_t i = w * 64; i < end_row; i++) {
+            bits |= (uint64_t)value_matches[_codes[i]] << (i - w * 64);
+        }
+        words[w] = bits;
+    }
+}
+
+} // namespace carta
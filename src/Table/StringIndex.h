@@ -0,0 +1,54 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TABLE_STRINGINDEX_H_
+#define CARTA_BACKEND_TABLE_STRINGINDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SelectionBitmap.h"
+
+namespace carta {
+
+// Dictionary encoding of a string column for substring searches. Each distinct value is stored once, with its lower-case form,
+// and the values containing each trigram of lower-case characters are listed, so that only values with all trigrams of the
+// search string are compared.
+class StringIndex {
+public:
+    StringIndex() = default;
+
+    size_t NumRows() const {
+        return _codes.size();
+    }
+    size_t NumValues() const {
+        return _values.size();
+    }
+
+    // Add the rows of the column from NumRows() to the end
+    void Update(const std::vector<std::string>& entries);
+    // Sets the bits of the rows containing the search string
+    void Filter(const std::string& search_string, bool case_insensitive, SelectionBitmap& bitmap) const;
+
+    static std::string ToLower(const std::string& text);
+
+private:
+    static uint32_t Trigram(const std::string& text, size_t pos) {
+        return ((uint32_t)(uint8_t)text[pos] << 16) | ((uint32_t)(uint8_t)text[pos + 1] << 8) | (uint8_t)text[pos + 2];
+    }
+
+    std::vector<uint32_t> _codes; // value of each row
+    std::vector<std::string> _values;
+    std::vector<std::string> _lower_values;
+    std::unordered_map<std::string, uint32_t> _value_codes;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> _trigram_values; // values containing the trigram, in code order
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TABLE_STRINGINDEX_H_
@@ -9,11 +9,16 @@
 #include <fstream>
 #include <iostream>
 
+#include <fcntl.h>
 #include <fitsio.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
+#include "../ImageData/SidecarCache.h"
 #include "../Logger/Logger.h"
 #include "../Util.h"
 #include "DataColumn.tcc"
+#include "TableCache.h"
 #include "Threading.h"
 
 #ifdef _BOOST_FILESYSTEM_
@@ -27,7 +32,8 @@ namespace fs = std::filesystem;
 namespace carta {
 using namespace std;
 
-Table::Table(const string& filename, bool header_only) : _valid(false), _filename(filename), _num_rows(0), _available_rows(0) {
+Table::Table(const string& filename, bool header_only, bool map_columns, int64_t max_rows)
+    : _valid(false), _filename(filename), _num_rows(0), _available_rows(0), _loading(false), _stop_loading(false) {
     fs::path file_path(filename);
 
     if (!fs::exists(file_path)) {
@@ -35,53 +41,73 @@ Table::Table(const string& filename, bool header_only) : _valid(false), _filenam
         return;
     }
 
+    // Catalogs which were parsed before are loaded from the cache, with all rows
+    if (!header_only && TableCache::Load(*this)) {
+        _valid = true;
+        return;
+    }
+
     auto magic_number = GetMagicNumber(filename);
     if (magic_number == FITS_MAGIC_NUMBER) {
-        _valid = ConstructFromFITS(header_only);
+        _valid = ConstructFromFITS(header_only, map_columns);
         _file_type = CARTA::FITSTable;
     } else if (magic_number == XML_MAGIC_NUMBER) {
-        _valid = ConstructFromXML(header_only);
+        _valid = ConstructFromXML(header_only, max_rows);
         _file_type = CARTA::VOTable;
     } else {
     }
+
+    // VOTables with rows left to read are cached when the rows are loaded in the background
+    if (_valid && !header_only && !_row_reader) {
+        WriteCacheInBackground();
+    }
+}
+
+Table::~Table() {
+    _stop_loading = true;
+    if (_load_thread.joinable()) {
+        _load_thread.join();
+    }
 }
 
-string Table::GetHeader(const string& filename) {
+string Table::GetHeader(const string& filename, bool whole_header) {
     ifstream in(filename);
     string header_string;
     // Measure entire file size to ensure we don't read past EOF
     in.seekg(0, ios_base::end);
-    size_t header_size = min(size_t(in.tellg()), size_t(MAX_HEADER_SIZE));
-    header_string.resize(header_size);
-    in.seekg(0, ios_base::beg);
-    in.read(&header_string[0], header_string.size());
+    size_t file_size = in.tellg();
+    size_t header_size = min(file_size, size_t(MAX_HEADER_SIZE));
+    size_t data_index = string::npos;
+    while (true) {
+        // Read more of the file until the <DATA> tag is found
+        size_t read_start = header_string.size();
+        header_string.resize(header_size);
+        in.seekg(read_start, ios_base::beg);
+        in.read(&header_string[read_start], header_size - read_start);
+        data_index = header_string.find("<DATA>", read_start < 6 ? 0 : read_start - 6);
+        if (data_index != string::npos || !whole_header || header_size == file_size) {
+            break;
+        }
+        header_size = min(file_size, 2 * header_size);
+    }
     in.close();
 
     // Resize to exclude the start of the <DATA> tag
-    auto data_index = header_string.find("<DATA>");
     if (data_index != string::npos) {
         header_string.resize(data_index);
     }
     return header_string;
 }
 
-bool Table::ConstructFromXML(bool header_only) {
+bool Table::ConstructFromXML(bool header_only, int64_t max_rows) {
     pugi::xml_document doc;
 
-    // read the first 64K only and construct a header from this
-    if (header_only) {
-        string header_string = GetHeader(_filename);
-        auto result = doc.load_string(header_string.c_str(), pugi::parse_default | pugi::parse_fragment);
-        if (!result && result.status != pugi::status_end_element_mismatch) {
-            spdlog::error(result.description());
-            return false;
-        }
-    } else {
-        auto result = doc.load_file(_filename.c_str(), pugi::parse_default | pugi::parse_embed_pcdata);
-        if (!result) {
-            spdlog::error(result.description());
-            return false;
-        }
+    // Construct a header from the first 64K only, or from the whole header before the rows are streamed
+    string header_string = GetHeader(_filename, !header_only);
+    auto result = doc.load_string(header_string.c_str(), pugi::parse_default | pugi::parse_fragment);
+    if (!result && result.status != pugi::status_end_element_mismatch) {
+        spdlog::error(result.description());
+        return false;
     }
     auto votable = doc.child("VOTABLE");
 
@@ -116,16 +142,20 @@ bool Table::ConstructFromXML(bool header_only) {
         return false;
     }
 
+    auto num_rows_attribute = table_node.attribute("nrows");
+    if (num_rows_attribute) {
+        _available_rows = num_rows_attribute.as_int();
+    }
+
     // Once fields are populated, stop parsing
     if (header_only) {
-        auto num_rows_attribute = table_node.attribute("nrows");
-        if (num_rows_attribute) {
-            _available_rows = num_rows_attribute.as_int();
-        }
         return true;
     }
 
-    if (!PopulateRows(table_node)) {
+    // Rows are read from the DATA element following the header
+    _row_reader = make_unique<VOTableRowReader>(_filename, header_string.size());
+    if (!_row_reader->IsValid() || !LoadRows(max_rows)) {
+        _row_reader.reset();
         _parse_error_message = "Cannot parse table data!";
         return false;
     }
@@ -208,51 +238,118 @@ bool Table::PopulateFields(const pugi::xml_node& table) {
     return !_columns.empty();
 }
 
-bool Table::PopulateRows(const pugi::xml_node& table) {
-    auto data = table.child("DATA");
-    auto table_data = data.child("TABLEDATA");
-    if (!table_data) {
-        return false;
+bool Table::LoadRows(int64_t max_rows) {
+    // Rows are parsed in blocks, then added to the columns
+    std::vector<VOTableRow> rows;
+    int64_t num_loaded(0);
+    bool more_rows(true);
+    while (more_rows && (max_rows < 0 || num_loaded < max_rows) && !_stop_loading) {
+        size_t block_size = (max_rows < 0) ? VOTABLE_ROW_BLOCK : min(max_rows - num_loaded, (int64_t)VOTABLE_ROW_BLOCK);
+        rows.clear();
+        more_rows = _row_reader->ReadRows(block_size, rows);
+        if (_row_reader->Failed()) {
+            return false;
+        }
+        AddRows(rows);
+        num_loaded += rows.size();
     }
 
-    // VOTable standard specifies TABLEDATA element contains only TR children, which contain only TD children
-    auto row_nodes = table_data.children();
+    if (!more_rows) {
+        _row_reader.reset();
+    }
+    return true;
+}
 
-    std::vector<pugi::xml_node> rows;
-    for (auto& row : row_nodes) {
-        rows.push_back(row);
+void Table::AddRows(const std::vector<VOTableRow>& rows) {
+    if (rows.empty()) {
+        return;
     }
 
-    _num_rows = rows.size();
+    // Views read the columns with the lock shared, and the column sizes are their numbers of rows, so the new rows are filled with
+    // it held; blocks are small enough that filter requests are not held up for long
+    int64_t first_row = _num_rows;
+    int64_t num_new_rows = rows.size();
+    std::unique_lock rows_lock(_rows_mutex);
     for (auto& column : _columns) {
-        column->Resize(_num_rows);
+        column->Resize(first_row + num_new_rows);
     }
 
     ThreadManager::ApplyThreadLimit();
-#pragma omp parallel for schedule(static) default(none) shared(_num_rows, rows)
-    for (auto i = 0; i < _num_rows; i++) {
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_new_rows; i++) {
         auto& row = rows[i];
-        auto column_iterator = _columns.begin();
-        auto column_nodes = row.children();
-        for (auto& td : column_nodes) {
-            if (column_iterator == _columns.end()) {
-                break;
-            }
-            (*column_iterator)->SetFromText(td.text(), i);
-            column_iterator++;
+        size_t num_cells = min(row.size(), _columns.size());
+        for (size_t j = 0; j < num_cells; j++) {
+            _columns[j]->SetFromString(row[j], first_row + i);
         }
 
         // Fill remaining / missing columns
-        while (column_iterator != _columns.end()) {
-            (*column_iterator)->SetEmpty(i);
-            column_iterator++;
+        for (size_t j = num_cells; j < _columns.size(); j++) {
+            _columns[j]->SetEmpty(first_row + i);
         }
     }
 
-    return true;
+    _num_rows += num_new_rows;
+    _available_rows = max(_available_rows, _num_rows);
+}
+
+void Table::LoadRowsInBackground() {
+    if (!_row_reader || _load_thread.joinable()) {
+        return;
+    }
+
+    _loading = true;
+    _load_thread = std::thread([this]() {
+        if (!LoadRows(-1)) {
+            spdlog::error("Cannot parse table data of {}", _filename);
+        }
+        _loading = false;
+        if (!_row_reader) {
+            TableCache::Write(*this, _stop_loading);
+        }
+    });
+}
+
+void Table::WriteCacheInBackground() {
+    if (!SidecarCache::Enabled() || _load_thread.joinable()) {
+        return;
+    }
+    _load_thread = std::thread([this]() { TableCache::Write(*this, _stop_loading); });
+}
+
+bool Table::IsLoading() const {
+    return _loading;
 }
 
-bool Table::ConstructFromFITS(bool header_only) {
+std::shared_mutex& Table::RowsMutex() const {
+    return _rows_mutex;
+}
+
+std::shared_ptr<const uint8_t> Table::MapFileData(const string& filename, size_t data_offset, size_t data_size) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const uint8_t> data;
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    if ((file_size > 0) && (data_offset + data_size <= (size_t)file_size)) {
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            std::shared_ptr<const uint8_t> file_data(
+                static_cast<const uint8_t*>(mapping), [file_size](const uint8_t* ptr) { munmap((void*)ptr, file_size); });
+            data = std::shared_ptr<const uint8_t>(file_data, file_data.get() + data_offset);
+        } else {
+            spdlog::debug("Could not map {}, reading table data.", filename);
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    return data;
+}
+
+bool Table::ConstructFromFITS(bool header_only, bool map_columns) {
     fitsfile* file_ptr = nullptr;
     int status = 0;
     // Attempt to open the first table HDU. status = 0 means no error
@@ -291,16 +388,31 @@ bool Table::ConstructFromFITS(bool header_only) {
     size_t col_offset = 0;
     for (auto i = 1; i <= num_cols; i++) {
         auto& column = _columns.emplace_back(Column::FromFitsPtr(file_ptr, i, col_offset));
-        // Resize column's entries vector to contain all rows
-        column->Resize(_num_rows);
         // Add columns to map
         if (!column->name.empty()) {
             _column_name_map[column->name] = column.get();
         }
     }
     if (_num_rows) {
-        // Read entire table into a memory buffer
         std::size_t size_bytes = total_width * _num_rows;
+        if (map_columns) {
+            // Columns keep the mapping, which is only possible for an uncompressed file
+            LONGLONG header_start(0), data_start(0), data_end(0);
+            std::shared_ptr<const uint8_t> mapped_data;
+            if (!fits_get_hduaddrll(file_ptr, &header_start, &data_start, &data_end, &status)) {
+                mapped_data = MapFileData(_filename, data_start, size_bytes);
+            }
+            status = 0;
+            if (mapped_data) {
+                fits_close_file(file_ptr, &status);
+                for (auto& column : _columns) {
+                    column->MapBuffer(mapped_data, _num_rows, total_width);
+                }
+                return true;
+            }
+        }
+
+        // Read entire table into a memory buffer
         auto buffer = make_unique<uint8_t[]>(size_bytes);
         fits_read_tblbytes(file_ptr, 1, 1, size_bytes, buffer.get(), &status);
         // File is no longer needed after table is read
@@ -310,6 +422,8 @@ bool Table::ConstructFromFITS(bool header_only) {
         ThreadManager::ApplyThreadLimit();
 #pragma omp parallel for default(none) schedule(dynamic) shared(num_cols, buffer, _num_rows, total_width)
         for (auto i = 0; i < num_cols; i++) {
+            // Resize column's entries vector to contain all rows
+            _columns[i]->Resize(_num_rows);
             _columns[i]->FillFromBuffer(buffer.get(), _num_rows, total_width);
         }
     } else {
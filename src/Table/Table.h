@@ -7,14 +7,21 @@
 #ifndef VOTABLE_TEST__TABLE_H_
 #define VOTABLE_TEST__TABLE_H_
 
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "Columns.h"
 #include "TableView.h"
+#include "VOTableRowReader.h"
 
 #define MAX_HEADER_SIZE (64 * 1024)
+// VOTable rows parsed before they are added to the columns
+#define VOTABLE_ROW_BLOCK 10000
 
 namespace carta {
 
@@ -28,7 +35,10 @@ struct TableParam {
 
 class Table {
 public:
-    Table(const std::string& filename, bool header_only = false);
+    // FITS tables can be memory-mapped, with numeric columns read in place instead of copied. For VOTables, max_rows limits the rows
+    // read by the constructor (-1 for all); the rest can be read with LoadRowsInBackground.
+    Table(const std::string& filename, bool header_only = false, bool map_columns = false, int64_t max_rows = -1);
+    ~Table();
     bool IsValid() const;
     std::string ParseError() const;
     const Column* GetColumnByName(const std::string& name) const;
@@ -42,17 +52,29 @@ public:
     const CARTA::Coosys& Coosys() const;
     TableView View() const;
 
+    // Read the remaining VOTable rows in a thread, adding them to the columns in blocks. Hold the rows mutex shared while using
+    // the columns or views of the table, so that rows are not added at the same time.
+    void LoadRowsInBackground();
+    bool IsLoading() const;
+    std::shared_mutex& RowsMutex() const;
+
     const Column* operator[](size_t i) const;
     const Column* operator[](const std::string& name_or_id) const;
 
 protected:
-    bool ConstructFromXML(bool header_only = false);
+    bool ConstructFromXML(bool header_only = false, int64_t max_rows = -1);
     bool PopulateCoosys(const pugi::xml_node& votable);
     bool PopulateParams(const pugi::xml_node& table);
     bool PopulateFields(const pugi::xml_node& table);
-    bool PopulateRows(const pugi::xml_node& table);
+    // Reads up to max_rows rows (-1 for all); returns false if the table data cannot be parsed
+    bool LoadRows(int64_t max_rows);
+    void AddRows(const std::vector<VOTableRow>& rows);
 
-    bool ConstructFromFITS(bool header_only = false);
+    bool ConstructFromFITS(bool header_only = false, bool map_columns = false);
+    // Write the catalog cache of a completely read table in the load thread
+    void WriteCacheInBackground();
+    // Map a whole file read-only, pointing to the data; null if the file cannot be mapped
+    static std::shared_ptr<const uint8_t> MapFileData(const std::string& filename, size_t data_offset, size_t data_size);
 
     bool _valid;
     CARTA::CatalogFileType _file_type;
@@ -66,7 +88,15 @@ protected:
     std::vector<std::unique_ptr<Column>> _columns;
     std::unordered_map<std::string, Column*> _column_name_map;
     std::unordered_map<std::string, Column*> _column_id_map;
-    static std::string GetHeader(const std::string& filename);
+    std::unique_ptr<VOTableRowReader> _row_reader; // set while there are rows to read
+    std::thread _load_thread;
+    std::atomic<bool> _loading;
+    std::atomic<bool> _stop_loading;
+    mutable std::shared_mutex _rows_mutex;
+    // The first 64K, or all of the header if whole_header, up to the start of the <DATA> tag
+    static std::string GetHeader(const std::string& filename, bool whole_header = false);
+
+    friend class TableCache;
 };
 } // namespace carta
 #endif // VOTABLE_TEST__TABLE_H_
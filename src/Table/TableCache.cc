@@ -0,0 +1,334 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "TableCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "../ImageData/SidecarCache.h"
+#include "../Logger/Logger.h"
+#include "DataColumn.tcc"
+#include "Table.h"
+
+#define TABLE_CACHE_MAGIC "CARTACAT"
+#define TABLE_CACHE_VERSION 1
+// Values encoded at a time while writing a numeric column
+#define TABLE_CACHE_WRITE_BLOCK 65536
+
+namespace carta {
+using namespace std;
+
+// Calls f with a null pointer of the column's value type; false for unsupported columns. Tables have no bool columns.
+template <class F>
+static bool ForColumnType(CARTA::ColumnType data_type, F&& f) {
+    switch (data_type) {
+        case CARTA::String:
+            return f((string*)nullptr);
+        case CARTA::Uint8:
+            return f((uint8_t*)nullptr);
+        case CARTA::Int8:
+            return f((int8_t*)nullptr);
+        case CARTA::Uint16:
+            return f((uint16_t*)nullptr);
+        case CARTA::Int16:
+            return f((int16_t*)nullptr);
+        case CARTA::Uint32:
+            return f((uint32_t*)nullptr);
+        case CARTA::Int32:
+            return f((int32_t*)nullptr);
+        case CARTA::Uint64:
+            return f((uint64_t*)nullptr);
+        case CARTA::Int64:
+            return f((int64_t*)nullptr);
+        case CARTA::Float:
+            return f((float*)nullptr);
+        case CARTA::Double:
+            return f((double*)nullptr);
+        default:
+            return false;
+    }
+}
+
+template <class T>
+static void WriteValue(ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void WriteString(ofstream& out, const string& value) {
+    WriteValue<uint64_t>(out, value.size());
+    out.write(value.data(), value.size());
+}
+
+// Reads values from the header file contents
+class CacheReader {
+public:
+    CacheReader(const string& data) : _ptr(data.data()), _end(data.data() + data.size()) {}
+
+    template <class T>
+    bool Read(T& value) {
+        if (_end - _ptr < (ptrdiff_t)sizeof(T)) {
+            return false;
+        }
+        memcpy(&value, _ptr, sizeof(T));
+        _ptr += sizeof(T);
+        return true;
+    }
+
+    bool ReadString(string& value) {
+        uint64_t size;
+        if (!Read(size) || (uint64_t)(_end - _ptr) < size) {
+            return false;
+        }
+        value.assign(_ptr, size);
+        _ptr += size;
+        return true;
+    }
+
+private:
+    const char* _ptr;
+    const char* _end;
+};
+
+static string TemporaryFilename(const string& filename) {
+    // Unique for each writer, in any session
+    return fmt::format("{}.{}.{:x}.tmp", filename, getpid(), hash<thread::id>()(this_thread::get_id()));
+}
+
+template <class T>
+static bool WriteColumnValues(const Column* column, ofstream& out) {
+    auto data_column = DataColumn<T>::TryCast(column);
+    if (!data_column) {
+        return false;
+    }
+
+    if constexpr (is_same_v<T, string>) {
+        // Offsets of the strings and the end of the last one, then the characters
+        uint64_t offset(0);
+        for (auto& value : data_column->entries) {
+            WriteValue(out, offset);
+            offset += value.size();
+        }
+        WriteValue(out, offset);
+        for (auto& value : data_column->entries) {
+            out.write(value.data(), value.size());
+        }
+    } else {
+        size_t num_rows = data_column->NumEntries();
+        vector<uint8_t> block;
+        block.reserve(TABLE_CACHE_WRITE_BLOCK * sizeof(T));
+        for (size_t start = 0; start < num_rows; start += TABLE_CACHE_WRITE_BLOCK) {
+            block.clear();
+            size_t end = min(num_rows, start + TABLE_CACHE_WRITE_BLOCK);
+            for (size_t i = start; i < end; i++) {
+                T value = data_column->Value(i);
+                uint8_t bytes[sizeof(T)];
+                memcpy(bytes, &value, sizeof(T));
+                reverse_copy(bytes, bytes + sizeof(T), back_inserter(block));
+            }
+            out.write(reinterpret_cast<const char*>(block.data()), block.size());
+        }
+    }
+    return true;
+}
+
+bool TableCache::Write(const Table& table, const atomic<bool>& stop) {
+    if (!SidecarCache::Enabled() || !table._valid) {
+        return false;
+    }
+
+    string header_filename = SidecarCache::Filename(table._filename, "", "catalog");
+    if (access(header_filename.c_str(), F_OK) == 0) {
+        return true;
+    }
+
+    vector<string> temporary_filenames;
+    auto remove_temporary_files = [&]() {
+        for (auto& filename : temporary_filenames) {
+            remove(filename.c_str());
+        }
+    };
+
+    // Column files first, so that they are complete when the header is found
+    int64_t num_rows = table._num_rows;
+    for (size_t i = 0; i < table._columns.size(); i++) {
+        const Column* column = table._columns[i].get();
+        if (column->data_type == CARTA::UnsupportedType) {
+            continue;
+        }
+        if (stop) {
+            remove_temporary_files();
+            return false;
+        }
+
+        string column_filename = SidecarCache::Filename(table._filename, "", fmt::format("catalog{}", i));
+        temporary_filenames.push_back(TemporaryFilename(column_filename));
+        ofstream out(temporary_filenames.back(), ios::binary | ios::trunc);
+        bool written = ForColumnType(column->data_type, [&](auto* type) {
+            using T = remove_pointer_t<decltype(type)>;
+            return WriteColumnValues<T>(column, out);
+        });
+        out.close();
+        if (!written || !out || (column->NumEntries() != (size_t)num_rows) ||
+            (rename(temporary_filenames.back().c_str(), column_filename.c_str()) != 0)) {
+            spdlog::warn("Could not write catalog cache for {}", table._filename);
+            remove_temporary_files();
+            return false;
+        }
+        temporary_filenames.pop_back();
+    }
+
+    temporary_filenames.push_back(TemporaryFilename(header_filename));
+    ofstream out(temporary_filenames.back(), ios::binary | ios::trunc);
+    out.write(TABLE_CACHE_MAGIC, 8);
+    WriteValue<uint32_t>(out, TABLE_CACHE_VERSION);
+    WriteValue<int32_t>(out, table._file_type);
+    WriteValue<int64_t>(out, num_rows);
+    WriteString(out, table._description);
+    WriteString(out, table._coosys.epoch());
+    WriteString(out, table._coosys.equinox());
+    WriteString(out, table._coosys.system());
+    WriteValue<uint64_t>(out, table._params.size());
+    for (auto& param : table._params) {
+        WriteString(out, param.name);
+        WriteString(out, param.description);
+        WriteString(out, param.value);
+    }
+    WriteValue<uint64_t>(out, table._columns.size());
+    for (auto& column : table._columns) {
+        WriteValue<int32_t>(out, column->data_type);
+        WriteValue<uint64_t>(out, column->data_type_size);
+        WriteString(out, column->name);
+        WriteString(out, column->id);
+        WriteString(out, column->unit);
+        WriteString(out, column->ucd);
+        WriteString(out, column->description);
+    }
+    out.close();
+    if (!out || (rename(temporary_filenames.back().c_str(), header_filename.c_str()) != 0)) {
+        spdlog::warn("Could not write catalog cache for {}", table._filename);
+        remove_temporary_files();
+        return false;
+    }
+    spdlog::debug("Wrote catalog cache for {}", table._filename);
+    return true;
+}
+
+bool TableCache::Load(Table& table) {
+    if (!SidecarCache::Enabled()) {
+        return false;
+    }
+
+    string header_filename = SidecarCache::Filename(table._filename, "", "catalog");
+    ifstream in(header_filename, ios::binary);
+    if (!in) {
+        return false;
+    }
+    string header((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+
+    CacheReader reader(header);
+    char magic[8];
+    uint32_t version;
+    int32_t file_type;
+    int64_t num_rows;
+    string description, epoch, equinox, system;
+    uint64_t num_params, num_columns;
+    bool ok = reader.Read(magic) && (strncmp(magic, TABLE_CACHE_MAGIC, 8) == 0) && reader.Read(version) &&
+              (version == TABLE_CACHE_VERSION) && reader.Read(file_type) && reader.Read(num_rows) && (num_rows >= 0) &&
+              reader.ReadString(description) && reader.ReadString(epoch) && reader.ReadString(equinox) && reader.ReadString(system) &&
+              reader.Read(num_params);
+
+    vector<TableParam> params;
+    for (uint64_t i = 0; ok && i < num_params; i++) {
+        TableParam param;
+        ok = reader.ReadString(param.name) && reader.ReadString(param.description) && reader.ReadString(param.value);
+        params.push_back(param);
+    }
+
+    vector<unique_ptr<Column>> columns;
+    ok = ok && reader.Read(num_columns);
+    for (uint64_t i = 0; ok && i < num_columns; i++) {
+        int32_t data_type;
+        uint64_t data_type_size;
+        string name;
+        ok = reader.Read(data_type) && reader.Read(data_type_size) && reader.ReadString(name);
+        if (!ok) {
+            break;
+        }
+
+        auto column = Column::FromDataType((CARTA::ColumnType)data_type, name);
+        ok = reader.ReadString(column->id) && reader.ReadString(column->unit) && reader.ReadString(column->ucd) &&
+             reader.ReadString(column->description);
+        if (!ok || column->data_type == CARTA::UnsupportedType) {
+            columns.push_back(move(column));
+            continue;
+        }
+
+        // Numeric columns are used from the mapped file; strings are copied
+        string column_filename = SidecarCache::Filename(table._filename, "", fmt::format("catalog{}", i));
+        if (column->data_type == CARTA::String) {
+            auto string_column = dynamic_cast<DataColumn<string>*>(column.get());
+            ifstream column_in(column_filename, ios::binary);
+            vector<uint64_t> offsets(num_rows + 1);
+            column_in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+            string values(column_in ? offsets.back() : 0, '\0');
+            column_in.read(values.data(), values.size());
+            ok = column_in && (column_in.peek() == EOF);
+            column->Resize(num_rows);
+            for (int64_t row = 0; ok && row < num_rows; row++) {
+                ok = (offsets[row] <= offsets[row + 1]) && (offsets[row + 1] <= values.size());
+                if (ok) {
+                    string_column->entries[row].assign(values, offsets[row], offsets[row + 1] - offsets[row]);
+                }
+            }
+        } else if (num_rows) {
+            size_t data_size = num_rows * column->data_type_size;
+            auto data = Table::MapFileData(column_filename, 0, data_size);
+            ok = data != nullptr;
+            if (ok) {
+                column->MapBuffer(data, num_rows, column->data_type_size);
+            }
+        }
+        column->data_type_size = data_type_size;
+        columns.push_back(move(column));
+    }
+
+    if (!ok) {
+        spdlog::warn("Ignoring invalid catalog cache {}", header_filename);
+        return false;
+    }
+
+    table._file_type = (CARTA::CatalogFileType)file_type;
+    table._num_rows = num_rows;
+    table._available_rows = num_rows;
+    table._description = description;
+    table._coosys.set_epoch(epoch);
+    table._coosys.set_equinox(equinox);
+    table._coosys.set_system(system);
+    table._params = move(params);
+    table._columns = move(columns);
+    for (auto& column : table._columns) {
+        if (!column->name.empty()) {
+            table._column_name_map[column->name] = column.get();
+        }
+        if (!column->id.empty()) {
+            table._column_id_map[column->id] = column.get();
+        }
+    }
+    return true;
+}
+
+} // namespace carta
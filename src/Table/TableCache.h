@@ -0,0 +1,31 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TABLE_TABLECACHE_H_
+#define CARTA_BACKEND_TABLE_TABLECACHE_H_
+
+#include <atomic>
+#include <string>
+
+namespace carta {
+
+class Table;
+
+// Parsed catalogs in the sidecar cache folder, so that a catalog is parsed once for each version of its file. A header file holds the
+// table metadata and columns, and each column has a file of its values: numeric values are big-endian like a FITS table, so that the
+// columns are memory-mapped and read in place, and string values follow their offsets. Files are written under temporary names and
+// renamed, the header last, so that sessions only see complete caches.
+class TableCache {
+public:
+    // Loads all rows of the table from the cache; returns false if there is no valid cache for the file
+    static bool Load(Table& table);
+    // Writes the cache for a table with all of its rows, unless stopped
+    static bool Write(const Table& table, const std::atomic<bool>& stop);
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TABLE_TABLECACHE_H_
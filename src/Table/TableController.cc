@@ -6,9 +6,16 @@
 
 #include "TableController.h"
 
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <shared_mutex>
+#include <tuple>
+
 #include <sys/stat.h>
 
 #include "Logger/Logger.h"
+#include "Threading.h"
 #include "Timer/ListProgressReporter.h"
 #include "Util.h"
 
@@ -42,7 +49,9 @@ void TableController::OnOpenFileRequest(const CARTA::OpenCatalogFile& open_file_
         _tables.erase(file_id);
         _view_cache.erase(file_id);
     }
-    _tables.emplace(file_id, file_path.string());
+    // FITS numeric columns are read in place from the mapped file, and VOTable rows after the first are read in the background
+    _tables.emplace(std::piecewise_construct, std::forward_as_tuple(file_id),
+        std::forward_as_tuple(file_path.string(), false, true, TABLE_INITIAL_ROWS));
     Table& table = _tables.at(file_id);
 
     if (!table.IsValid()) {
@@ -86,8 +95,9 @@ void TableController::OnOpenFileRequest(const CARTA::OpenCatalogFile& open_file_
     }
 
     // Cache view
-    _view_cache.emplace(file_id, TableViewCache{view, std::vector<CARTA::FilterConfig>(), "", CARTA::Ascending});
+    _view_cache.emplace(file_id, TableViewCache{view, std::vector<CARTA::FilterConfig>(), "", CARTA::Ascending, table.NumRows()});
     open_file_response.set_success(true);
+    table.LoadRowsInBackground();
 }
 
 void TableController::OnCloseFileRequest(const CARTA::CloseCatalogFile& close_file_request) {
@@ -104,24 +114,33 @@ void TableController::OnFilterRequest(
 
     if (_tables.count(file_id)) {
         Table& table = _tables.at(file_id);
+        // Rows still loading are added after the response; the view is filtered again when there are more rows
+        std::shared_lock rows_lock(table.RowsMutex());
         auto& cache = _view_cache.at(file_id);
         auto& view = cache.view;
         std::vector<CARTA::FilterConfig> new_filter_configs = {
             filter_request.filter_configs().begin(), filter_request.filter_configs().end()};
         string sort_column_name = filter_request.sort_column();
         CARTA::SortingType sorting_type = filter_request.sorting_type();
-        if (TableController::FilterParamsChanged(new_filter_configs, sort_column_name, sorting_type, cache)) {
+        if (TableController::FilterParamsChanged(new_filter_configs, sort_column_name, sorting_type, cache) ||
+            !ImageBoundsEqual(cache.image_bounds, filter_request.image_bounds()) || (cache.num_rows != table.NumRows())) {
             cache.filter_configs = new_filter_configs;
             cache.sort_column = sort_column_name;
             cache.sorting_type = sorting_type;
-            view.Reset();
-
-            for (auto& config : filter_request.filter_configs()) {
-                ApplyFilter(config, view);
+            cache.image_bounds = filter_request.image_bounds();
+            if (cache.num_rows != table.NumRows()) {
+                cache.filter_bitmaps.clear();
+                cache.sort_permutations.clear();
+                cache.position_index.reset();
+                cache.num_rows = table.NumRows();
             }
+            view.Reset();
+            ApplyFilters(new_filter_configs, cache);
             if (!sort_column_name.empty()) {
-                auto sort_column = table[sort_column_name];
-                view.SortByColumn(sort_column, filter_request.sorting_type() == CARTA::Ascending);
+                auto permutation = SortPermutation(sort_column_name, sorting_type == CARTA::Ascending, cache);
+                if (permutation) {
+                    view.SortByPermutation(*permutation);
+                }
             }
         }
 
@@ -136,10 +155,13 @@ void TableController::OnFilterRequest(
         int response_size = min(num_rows, num_results - start_index);
         filter_response.set_request_end_index(start_index + response_size);
 
-        auto num_columns = filter_request.column_indices_size();
+        // Columns are encoded in parallel, each into its own entry of the response
+        std::vector<int> column_indices = {filter_request.column_indices().begin(), filter_request.column_indices().end()};
+        std::sort(column_indices.begin(), column_indices.end());
+        column_indices.erase(std::unique(column_indices.begin(), column_indices.end()), column_indices.end());
         auto column_data = filter_response.mutable_columns();
 
-        int max_chunk_size = 100000;
+        int max_chunk_size = TABLE_FIRST_CHUNK_ROWS;
         int num_remaining_rows = response_size;
         int sent_rows = 0;
         int chunk_start_index = start_index;
@@ -154,19 +176,30 @@ void TableController::OnFilterRequest(
         }
 
         while (num_remaining_rows > 0) {
+            auto chunk_start_time = std::chrono::steady_clock::now();
             int chunk_size = min(num_remaining_rows, max_chunk_size);
             int chunk_end_index = chunk_start_index + chunk_size;
             filter_response.set_subset_data_size(chunk_size);
             filter_response.set_subset_end_index(chunk_end_index);
 
-            for (auto i = 0; i < num_columns; i++) {
-                auto index = filter_request.column_indices()[i];
+            std::vector<std::pair<const Column*, int>> chunk_columns;
+            for (auto index : column_indices) {
                 auto col = table[index];
                 if (col && col->data_type != CARTA::UnsupportedType) {
                     (*column_data)[index] = CARTA::ColumnData();
-                    view.FillValues(col, (*column_data)[index], chunk_start_index, chunk_end_index);
+                    chunk_columns.emplace_back(col, index);
                 }
             }
+            std::vector<CARTA::ColumnData*> chunk_column_data;
+            for (auto& chunk_column : chunk_columns) {
+                chunk_column_data.push_back(&(*column_data)[chunk_column.second]);
+            }
+
+            ThreadManager::ApplyThreadLimit();
+#pragma omp parallel for schedule(dynamic)
+            for (int64_t i = 0; i < (int64_t)chunk_columns.size(); i++) {
+                view.FillValues(chunk_columns[i].first, *chunk_column_data[i], chunk_start_index, chunk_end_index);
+            }
 
             sent_rows += chunk_size;
             chunk_start_index += chunk_size;
@@ -177,7 +210,11 @@ void TableController::OnFilterRequest(
                 filter_response.set_progress(sent_rows / float(response_size));
             }
 
+            // The callback waits while the outgoing queue is full, so the chunk time includes the time for the socket to send
+            size_t chunk_bytes = filter_response.ByteSizeLong();
             partial_results_callback(filter_response);
+            std::chrono::duration<double> chunk_time = std::chrono::steady_clock::now() - chunk_start_time;
+            max_chunk_size = NextChunkSize(chunk_size, chunk_bytes, chunk_time.count());
         }
     }
 }
@@ -211,12 +248,12 @@ void TableController::OnFileListRequest(
         auto total_files = total_regular_files + total_directories;
 
         // initialize variables for the progress report and the interruption option
-        _stop_getting_file_list = false;
+        auto cancel_token = _file_list_cancellation.Replace();
         _first_report_made = false;
         ListProgressReporter progress_reporter(total_files, _progress_callback);
 
         for (const auto& entry : fs::directory_iterator(file_path)) {
-            if (_stop_getting_file_list) {
+            if (cancel_token.IsCancelled()) {
                 file_list_response.set_cancel(true);
                 break;
             }
@@ -332,19 +369,84 @@ void TableController::OnFileInfoRequest(
     file_info_response.set_success(true);
 }
 
-void TableController::ApplyFilter(const CARTA::FilterConfig& filter_config, TableView& view) {
+std::shared_ptr<const SelectionBitmap> TableController::FilterBitmap(const CARTA::FilterConfig& filter_config, const Table& table) {
     string column_name = filter_config.column_name();
-    auto column = view.GetTable()[column_name];
+    auto column = table[column_name];
     if (!column) {
         spdlog::error("Could not filter on non-existing column \"{}\"", column_name);
-        return;
+        return nullptr;
     }
 
-    // Perform subset string filter
+    auto bitmap = std::make_shared<SelectionBitmap>();
+    bool filtered;
     if (column->data_type == CARTA::String) {
-        view.StringFilter(column, filter_config.sub_string());
+        filtered = column->StringFilterBitmap(*bitmap, filter_config.sub_string());
     } else {
-        view.NumericFilter(column, filter_config.comparison_operator(), filter_config.value(), filter_config.secondary_value());
+        filtered =
+            column->FilterBitmap(*bitmap, filter_config.comparison_operator(), filter_config.value(), filter_config.secondary_value());
+    }
+    return filtered ? bitmap : nullptr;
+}
+
+std::shared_ptr<SelectionBitmap> TableController::BoundsBitmap(TableViewCache& cache) {
+    // Bounds are not applied without both columns, or when they are all zero
+    const auto& bounds = cache.image_bounds;
+    const auto& box = bounds.image_bounds();
+    if (bounds.x_column_name().empty() || bounds.y_column_name().empty() ||
+        (box.x_min() == 0 && box.x_max() == 0 && box.y_min() == 0 && box.y_max() == 0)) {
+        return nullptr;
+    }
+
+    // The positions are indexed once for each pair of columns, so that the rows in the box are found without a scan
+    auto position_columns = std::make_pair(bounds.x_column_name(), bounds.y_column_name());
+    if (!cache.position_index || cache.position_columns != position_columns) {
+        const Table& table = cache.view.GetTable();
+        auto x_column = table[position_columns.first];
+        auto y_column = table[position_columns.second];
+        std::vector<double> x, y;
+        if (!x_column || !y_column || !x_column->NumericValues(x) || !y_column->NumericValues(y)) {
+            spdlog::error("Could not apply image bounds on columns \"{}\" and \"{}\"", position_columns.first, position_columns.second);
+            return nullptr;
+        }
+        cache.position_index = std::make_shared<PositionIndex>(x, y);
+        cache.position_columns = position_columns;
+    }
+
+    auto bitmap = std::make_shared<SelectionBitmap>();
+    cache.position_index->Select(box.x_min(), box.x_max(), box.y_min(), box.y_max(), *bitmap);
+    return bitmap;
+}
+
+void TableController::ApplyFilters(const std::vector<CARTA::FilterConfig>& filter_configs, TableViewCache& cache) {
+    // The view is the rows in the image bounds passing all filters; filters which were already applied are not evaluated again
+    std::vector<std::pair<CARTA::FilterConfig, std::shared_ptr<const SelectionBitmap>>> filter_bitmaps;
+    std::shared_ptr<SelectionBitmap> selection = BoundsBitmap(cache);
+    for (auto& config : filter_configs) {
+        std::shared_ptr<const SelectionBitmap> bitmap;
+        for (auto& cached_filter : cache.filter_bitmaps) {
+            if (FilterConfigsEqual(cached_filter.first, config)) {
+                bitmap = cached_filter.second;
+                break;
+            }
+        }
+        if (!bitmap) {
+            bitmap = FilterBitmap(config, cache.view.GetTable());
+        }
+        if (!bitmap) {
+            continue;
+        }
+
+        filter_bitmaps.emplace_back(config, bitmap);
+        if (selection) {
+            selection->And(*bitmap);
+        } else {
+            selection = std::make_shared<SelectionBitmap>(*bitmap);
+        }
+    }
+
+    cache.filter_bitmaps = std::move(filter_bitmaps);
+    if (selection) {
+        cache.view.SetSelection(selection);
     }
 }
 
@@ -378,17 +480,54 @@ bool TableController::FilterParamsChanged(const std::vector<CARTA::FilterConfig>
     }
 
     for (auto i = 0; i < filter_configs.size(); i++) {
-        auto& lhs = cached_config.filter_configs[i];
-        auto& rhs = filter_configs[i];
-        if (lhs.column_name() != rhs.column_name() || lhs.sub_string() != rhs.sub_string() ||
-            lhs.comparison_operator() != rhs.comparison_operator() || lhs.value() != rhs.value() ||
-            lhs.secondary_value() != rhs.secondary_value()) {
+        if (!FilterConfigsEqual(cached_config.filter_configs[i], filter_configs[i])) {
             return true;
         }
     }
 
     return false;
 }
+
+std::shared_ptr<const IndexList> TableController::SortPermutation(const std::string& column_name, bool ascending, TableViewCache& cache) {
+    // The table is sorted once for each column and direction, and filtered views take their order from it
+    auto& permutation = cache.sort_permutations[std::make_pair(column_name, ascending)];
+    if (!permutation) {
+        const Table& table = cache.view.GetTable();
+        auto column = table[column_name];
+        if (!column || column->data_type == CARTA::UnsupportedType) {
+            cache.sort_permutations.erase(std::make_pair(column_name, ascending));
+            return nullptr;
+        }
+        auto indices = std::make_shared<IndexList>(table.NumRows());
+        std::iota(indices->begin(), indices->end(), 0);
+        column->SortIndices(*indices, ascending);
+        permutation = indices;
+    }
+    return permutation;
+}
+
+bool TableController::ImageBoundsEqual(const CARTA::CatalogImageBounds& lhs, const CARTA::CatalogImageBounds& rhs) {
+    const auto& lhs_box = lhs.image_bounds();
+    const auto& rhs_box = rhs.image_bounds();
+    return lhs.x_column_name() == rhs.x_column_name() && lhs.y_column_name() == rhs.y_column_name() &&
+           lhs_box.x_min() == rhs_box.x_min() && lhs_box.x_max() == rhs_box.x_max() && lhs_box.y_min() == rhs_box.y_min() &&
+           lhs_box.y_max() == rhs_box.y_max();
+}
+
+int TableController::NextChunkSize(int chunk_size, size_t chunk_bytes, double chunk_seconds) {
+    // Rows which would take the target time at the rate of the last chunk
+    double rows_per_second = chunk_size / std::max(chunk_seconds, 1e-3);
+    double bytes_per_row = std::max((double)chunk_bytes / std::max(chunk_size, 1), 1.0);
+    double next_size = std::min({rows_per_second * TABLE_CHUNK_TARGET_SECONDS, (double)chunk_size * TABLE_CHUNK_MAX_GROWTH,
+        TABLE_CHUNK_MAX_BYTES / bytes_per_row});
+    return std::max((int)next_size, TABLE_FIRST_CHUNK_ROWS);
+}
+
+bool TableController::FilterConfigsEqual(const CARTA::FilterConfig& lhs, const CARTA::FilterConfig& rhs) {
+    return lhs.column_name() == rhs.column_name() && lhs.sub_string() == rhs.sub_string() &&
+           lhs.comparison_operator() == rhs.comparison_operator() && lhs.value() == rhs.value() &&
+           lhs.secondary_value() == rhs.secondary_value();
+}
 fs::path TableController::GetPath(std::string directory, std::string name) {
     fs::path file_path(_top_level_folder);
     if (directory == "$BASE") {
@@ -8,17 +8,30 @@
 #define CARTA_BACKEND_TABLE_TABLECONTROLLER_H_
 
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <carta-protobuf/catalog_file_info.pb.h>
 #include <carta-protobuf/catalog_filter.pb.h>
 #include <carta-protobuf/catalog_list.pb.h>
 #include <carta-protobuf/open_catalog_file.pb.h>
 
+#include "../Cancellation.h"
+#include "PositionIndex.h"
 #include "Table.h"
 
 #define TABLE_PREVIEW_ROWS 50
+// VOTable rows read before the file is opened; the rest are read in the background
+#define TABLE_INITIAL_ROWS 100000
+// Filter response chunks: rows in the first chunk, time to encode and send later chunks, and limits on their size and growth
+#define TABLE_FIRST_CHUNK_ROWS 1000
+#define TABLE_CHUNK_TARGET_SECONDS 0.25
+#define TABLE_CHUNK_MAX_BYTES (16 * 1024 * 1024)
+#define TABLE_CHUNK_MAX_GROWTH 4
 
 #ifdef _BOOST_FILESYSTEM_
 #include <boost/filesystem.hpp>
@@ -35,6 +48,15 @@ struct TableViewCache {
     std::vector<CARTA::FilterConfig> filter_configs;
     std::string sort_column;
     CARTA::SortingType sorting_type;
+    size_t num_rows; // rows of the table when the view was filtered
+    // Rows passing each filter, reused while the filter is applied and the table rows do not change
+    std::vector<std::pair<CARTA::FilterConfig, std::shared_ptr<const SelectionBitmap>>> filter_bitmaps;
+    // All rows sorted by column name and direction (true for ascending), kept while the table rows do not change
+    std::map<std::pair<std::string, bool>, std::shared_ptr<const IndexList>> sort_permutations;
+    // Box restriction on two position columns, and the index of the positions in those columns
+    CARTA::CatalogImageBounds image_bounds;
+    std::shared_ptr<const PositionIndex> position_index;
+    std::pair<std::string, std::string> position_columns;
 };
 
 class TableController {
@@ -48,7 +70,7 @@ public:
         std::function<void(const CARTA::CatalogFilterResponse&)> partial_results_callback);
 
     void StopGettingFileList() {
-        _stop_getting_file_list = true;
+        _file_list_cancellation.CancelCurrent();
     }
     void SetProgressCallBack(const std::function<void(CARTA::ListProgress)>& progress_callback) {
         _progress_callback = progress_callback;
@@ -56,7 +78,13 @@ public:
 
 protected:
     void PopulateHeaders(google::protobuf::RepeatedPtrField<CARTA::CatalogHeader>* headers, const Table& table);
-    void ApplyFilter(const CARTA::FilterConfig& filter_config, TableView& view);
+    std::shared_ptr<const SelectionBitmap> FilterBitmap(const CARTA::FilterConfig& filter_config, const Table& table);
+    std::shared_ptr<SelectionBitmap> BoundsBitmap(TableViewCache& cache);
+    void ApplyFilters(const std::vector<CARTA::FilterConfig>& filter_configs, TableViewCache& cache);
+    std::shared_ptr<const IndexList> SortPermutation(const std::string& column_name, bool ascending, TableViewCache& cache);
+    static int NextChunkSize(int chunk_size, size_t chunk_bytes, double chunk_seconds);
+    static bool FilterConfigsEqual(const CARTA::FilterConfig& lhs, const CARTA::FilterConfig& rhs);
+    static bool ImageBoundsEqual(const CARTA::CatalogImageBounds& lhs, const CARTA::CatalogImageBounds& rhs);
     static bool FilterParamsChanged(const std::vector<CARTA::FilterConfig>& filter_configs, std::string sort_column,
         CARTA::SortingType sorting_type, const TableViewCache& cached_config);
     fs::path GetPath(std::string directory, std::string name = "");
@@ -66,7 +94,7 @@ protected:
     std::unordered_map<int, TableViewCache> _view_cache;
 
 private:
-    volatile bool _stop_getting_file_list;
+    CancellationSlot _file_list_cancellation;
     volatile bool _first_report_made;
     std::function<void(CARTA::ListProgress)> _progress_callback;
 };
@@ -16,20 +16,46 @@ namespace carta {
 
 using namespace std;
 
-TableView::TableView(const Table& table) : _table(table) {
+TableView::TableView(const Table& table) : _table(table), _num_selected(0) {
     _is_subset = false;
     _ordered = true;
 }
 
 TableView::TableView(const Table& table, const IndexList& index_list, bool ordered)
-    : _table(table), _subset_indices(index_list), _ordered(ordered) {
+    : _table(table), _num_selected(0), _subset_indices(index_list), _ordered(ordered) {
     _is_subset = true;
 }
 
+void TableView::SetSelection(std::shared_ptr<const SelectionBitmap> selection) {
+    _selection = selection;
+    _num_selected = selection ? selection->Count() : 0;
+    _is_subset = bool(selection);
+    _ordered = true;
+    _subset_indices.clear();
+}
+
+void TableView::SelectionToIndices() {
+    if (_selection) {
+        _subset_indices = _selection->Indices();
+        _selection.reset();
+    }
+}
+
+IndexList TableView::RowIndices(int64_t start, int64_t end) const {
+    // Indices [start, end) of the view rows in the selection
+    int64_t num_rows = NumRows();
+    start = min(max(start, (int64_t)0), num_rows);
+    if (end < 0 || end > num_rows) {
+        end = num_rows;
+    }
+    return _selection->Indices(start, max(start, end));
+}
+
 bool TableView::NumericFilter(const Column* column, CARTA::ComparisonOperator comparison_operator, double value, double secondary_value) {
     if (!column) {
         return false;
     }
+    SelectionToIndices();
 
     // Only filter for arithmetic types
     if (column->data_type == CARTA::UnsupportedType || column->data_type == CARTA::String) {
@@ -50,7 +76,7 @@ bool TableView::NumericFilter(const Column* column, CARTA::ComparisonOperator co
 }
 
 bool TableView::StringFilter(const Column* column, string search_string, bool case_insensitive) {
-    IndexList matching_indices;
+    SelectionToIndices();
 
     auto string_column = DataColumn<string>::TryCast(column);
     if (!string_column) {
@@ -59,50 +85,23 @@ bool TableView::StringFilter(const Column* column, string search_string, bool ca
     }
     size_t num_entries = string_column->entries.size();
 
-    if (case_insensitive) {
-        // If case-insensitive, must transform strings to lower-case while iterating
-        transform(search_string.begin(), search_string.end(), search_string.begin(), ::tolower);
-        if (_is_subset) {
-            for (auto i : _subset_indices) {
-                // Skip invalid entries
-                if (i < 0 || i >= num_entries) {
-                    continue;
-                }
-                auto val = string_column->entries[i];
-                transform(val.begin(), val.end(), val.begin(), ::tolower);
-                if (val.find(search_string) != string::npos) {
-                    matching_indices.push_back(i);
-                }
+    // Matching rows come from the column's search index
+    SelectionBitmap matches;
+    string_column->StringFilterBitmap(matches, search_string, case_insensitive);
+    const uint64_t* words = matches.Words();
+    IndexList matching_indices;
+    if (_is_subset) {
+        for (auto i : _subset_indices) {
+            // Skip invalid entries
+            if (i < 0 || i >= num_entries) {
+                continue;
             }
-        } else {
-            for (auto i = 0; i < num_entries; i++) {
-                auto val = string_column->entries[i];
-                transform(val.begin(), val.end(), val.begin(), ::tolower);
-                if (val.find(search_string) != string::npos) {
-                    matching_indices.push_back(i);
-                }
+            if ((words[i / 64] >> (i % 64)) & 1) {
+                matching_indices.push_back(i);
             }
         }
     } else {
-        if (_is_subset) {
-            for (auto i : _subset_indices) {
-                // Skip invalid entries
-                if (i < 0 || i >= num_entries) {
-                    continue;
-                }
-                auto& val = string_column->entries[i];
-                if (val.find(search_string) != string::npos) {
-                    matching_indices.push_back(i);
-                }
-            }
-        } else {
-            for (auto i = 0; i < num_entries; i++) {
-                auto& val = string_column->entries[i];
-                if (val.find(search_string) != string::npos) {
-                    matching_indices.push_back(i);
-                }
-            }
-        }
+        matching_indices = matches.Indices();
     }
 
     if (matching_indices.size() == num_entries) {
@@ -117,6 +116,7 @@ bool TableView::StringFilter(const Column* column, string search_string, bool ca
 
 bool TableView::Invert() {
     IndexList inverted_indices;
+    SelectionToIndices();
     auto total_row_count = _table.NumRows();
 
     if (_is_subset) {
@@ -158,6 +158,7 @@ bool TableView::Invert() {
 }
 
 void TableView::Reset() {
+    _selection.reset();
     _is_subset = false;
     _subset_indices.clear();
     _ordered = true;
@@ -168,6 +169,7 @@ bool TableView::Combine(const TableView& second) {
     if (&_table != &second._table) {
         return false;
     }
+    SelectionToIndices();
     // If either table is not a subset, the combined table is not a subset
     if (!(_is_subset && second._is_subset)) {
         _is_subset = false;
@@ -180,8 +182,9 @@ bool TableView::Combine(const TableView& second) {
     }
 
     IndexList combined_indices;
-    set_union(_subset_indices.begin(), _subset_indices.end(), second._subset_indices.begin(), second._subset_indices.end(),
-        back_inserter(combined_indices));
+    const IndexList& second_indices = second._selection ? second._selection->Indices() : second._subset_indices;
+    set_union(
+        _subset_indices.begin(), _subset_indices.end(), second_indices.begin(), second_indices.end(), back_inserter(combined_indices));
     if (combined_indices.size() == _table.NumRows()) {
         _subset_indices.clear();
         _is_subset = false;
@@ -198,7 +201,11 @@ bool TableView::FillValues(const Column* column, CARTA::ColumnData& column_data,
         return false;
     }
 
-    column->FillColumnData(column_data, _is_subset, _subset_indices, start, end);
+    if (_selection) {
+        column->FillColumnData(column_data, true, RowIndices(start, end), 0, -1);
+    } else {
+        column->FillColumnData(column_data, _is_subset, _subset_indices, start, end);
+    }
     return true;
 }
 
@@ -212,6 +219,7 @@ bool TableView::SortByColumn(const Column* column, bool ascending) {
     }
 
     // If we're sorting an entire column, we first need to populate the indices
+    SelectionToIndices();
     if (!_is_subset) {
         _subset_indices.resize(_table.NumRows());
         std::iota(_subset_indices.begin(), _subset_indices.end(), 0);
@@ -224,6 +232,47 @@ bool TableView::SortByColumn(const Column* column, bool ascending) {
     return true;
 }
 
+bool TableView::SortByPermutation(const IndexList& permutation) {
+    size_t num_rows = _table.NumRows();
+    if (permutation.size() != num_rows) {
+        return false;
+    }
+
+    if (!_is_subset) {
+        _subset_indices = permutation;
+        _is_subset = true;
+        _ordered = false;
+        return true;
+    }
+
+    // Rows of the view are kept in permutation order, looked up in a bitmap of the view
+    std::shared_ptr<const SelectionBitmap> selection = _selection;
+    if (!selection) {
+        auto subset_bitmap = std::make_shared<SelectionBitmap>(num_rows);
+        uint64_t* words = subset_bitmap->Words();
+        for (auto i : _subset_indices) {
+            if (i >= 0 && (size_t)i < num_rows) {
+                words[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+        }
+        selection = subset_bitmap;
+    }
+
+    IndexList sorted_indices;
+    sorted_indices.reserve(NumRows());
+    const uint64_t* words = selection->Words();
+    for (auto i : permutation) {
+        if ((words[i / 64] >> (i % 64)) & 1) {
+            sorted_indices.push_back(i);
+        }
+    }
+
+    _selection.reset();
+    _subset_indices = std::move(sorted_indices);
+    _ordered = false;
+    return true;
+}
+
 bool TableView::SortByIndex() {
     if (!_ordered) {
         parallel_sort(_subset_indices.begin(), _subset_indices.end());
@@ -233,6 +282,9 @@ bool TableView::SortByIndex() {
 }
 
 size_t TableView::NumRows() const {
+    if (_selection) {
+        return _num_selected;
+    }
     if (_is_subset) {
         return _subset_indices.size();
     }
@@ -7,8 +7,11 @@
 #ifndef VOTABLE_TEST__TABLEVIEW_H_
 #define VOTABLE_TEST__TABLEVIEW_H_
 
+#include <memory>
+
 #include <carta-protobuf/defs.pb.h>
 
+#include "SelectionBitmap.h"
 #include "Table.h"
 
 namespace carta {
@@ -24,12 +27,17 @@ public:
     bool NumericFilter(const Column* column, CARTA::ComparisonOperator comparison_operator, double value, double secondary_value = 0.0);
     bool StringFilter(const Column* column, std::string search_string, bool case_insensitive = false);
 
+    // Rows selected by a bitmap of filtered rows; indices are only made for the rows retrieved, or when the view is changed
+    void SetSelection(std::shared_ptr<const SelectionBitmap> selection);
+
     bool Invert();
     void Reset();
     bool Combine(const TableView& second);
 
     // Sorting
     bool SortByColumn(const Column* column, bool ascending = true);
+    // Order the rows of the view as in a sorted permutation of all table rows
+    bool SortByPermutation(const IndexList& permutation);
     bool SortByIndex();
 
     // Retrieving data
@@ -42,6 +50,12 @@ public:
     bool FillValues(const Column* column, CARTA::ColumnData& column_data, int64_t start = -1, int64_t end = -1) const;
 
 protected:
+    // Replace the selection by its subset indices
+    void SelectionToIndices();
+    IndexList RowIndices(int64_t start, int64_t end) const;
+
+    std::shared_ptr<const SelectionBitmap> _selection;
+    size_t _num_selected;
     bool _is_subset;
     bool _ordered;
     IndexList _subset_indices;
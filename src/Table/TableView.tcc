@@ -14,9 +14,12 @@ namespace carta {
 template <class T>
 std::vector<T> TableView::Values(const Column* column, int64_t start, int64_t end) const {
     auto data_column = DataColumn<T>::TryCast(column);
-    if (!data_column || data_column->entries.empty()) {
+    if (!data_column || !data_column->NumEntries()) {
         return std::vector<T>();
     }
+    if (_selection) {
+        return data_column->GetColumnData(true, RowIndices(start, end), 0, -1);
+    }
     return data_column->GetColumnData(_is_subset, _subset_indices, start, end);
 }
 
@@ -0,0 +1,245 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include "VOTableRowReader.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace carta {
+using namespace std;
+
+VOTableRowReader::VOTableRowReader(const string& filename, size_t data_offset)
+    : _file(filename, ios::binary),
+      _buffer(VOTABLE_READ_BUFFER_SIZE),
+      _buffer_pos(0),
+      _buffer_end(0),
+      _valid(false),
+      _finished(true),
+      _failed(false) {
+    if (!_file) {
+        return;
+    }
+    _file.seekg(data_offset);
+
+    // Find the TABLEDATA element in the DATA element; other serializations are not supported
+    string tag;
+    while (NextTag(tag)) {
+        string name = TagName(tag);
+        if (name == "TABLEDATA") {
+            _valid = true;
+            _finished = IsSelfClosing(tag);
+            break;
+        } else if (name == "/DATA" || name == "BINARY" || name == "BINARY2" || name == "FITS") {
+            break;
+        }
+    }
+}
+
+bool VOTableRowReader::IsValid() const {
+    return _valid;
+}
+
+bool VOTableRowReader::Failed() const {
+    return _failed;
+}
+
+bool VOTableRowReader::ReadRows(size_t max_rows, vector<VOTableRow>& rows) {
+    // VOTable standard specifies TABLEDATA element contains only TR children, which contain only TD children
+    string tag;
+    size_t num_rows(0);
+    while (!_finished && num_rows < max_rows) {
+        if (!NextTag(tag)) {
+            _failed = _finished = true;
+            break;
+        }
+
+        string name = TagName(tag);
+        if (name == "TR") {
+            auto& row = rows.emplace_back();
+            if (!IsSelfClosing(tag) && !ReadRow(row)) {
+                _failed = _finished = true;
+            }
+            num_rows++;
+        } else if (name == "/TABLEDATA") {
+            _finished = true;
+        }
+    }
+    return !_finished;
+}
+
+bool VOTableRowReader::ReadRow(VOTableRow& row) {
+    string tag;
+    while (NextTag(tag)) {
+        string name = TagName(tag);
+        if (name == "TD") {
+            auto& cell = row.emplace_back();
+            if (!IsSelfClosing(tag) && !ReadCell(cell)) {
+                return false;
+            }
+        } else if (name == "/TR") {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VOTableRowReader::ReadCell(string& cell) {
+    string text, tag;
+    while (ReadText(&text)) {
+        AppendUnescaped(text, cell);
+        text.clear();
+        if (!ReadTag(tag)) {
+            return false;
+        }
+        if (tag.compare(0, 8, "![CDATA[") == 0) {
+            cell.append(tag, 8, tag.size() - 10);
+        } else if (TagName(tag) == "/TD") {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VOTableRowReader::ReadChar(char& c) {
+    if (_buffer_pos == _buffer_end) {
+        _file.read(_buffer.data(), _buffer.size());
+        _buffer_pos = 0;
+        _buffer_end = _file.gcount();
+        if (!_buffer_end) {
+            return false;
+        }
+    }
+    c = _buffer[_buffer_pos++];
+    return true;
+}
+
+bool VOTableRowReader::ReadText(string* text) {
+    // Search the buffer for the end of the text, refilling it as needed
+    while (true) {
+        const char* start = _buffer.data() + _buffer_pos;
+        auto end = static_cast<const char*>(memchr(start, '<', _buffer_end - _buffer_pos));
+        if (end) {
+            if (text) {
+                text->append(start, end);
+            }
+            _buffer_pos += end - start + 1;
+            return true;
+        }
+        if (text) {
+            text->append(start, _buffer_end - _buffer_pos);
+        }
+        _buffer_pos = _buffer_end;
+
+        char c;
+        if (!ReadChar(c)) {
+            return false;
+        }
+        --_buffer_pos;
+    }
+}
+
+bool VOTableRowReader::ReadTag(string& tag) {
+    tag.clear();
+    char c, quote(0);
+    while (ReadChar(c)) {
+        if (c == '>' && !quote) {
+            // Comments and CDATA may contain '>'
+            bool in_comment = (tag.compare(0, 3, "!--") == 0) && ((tag.size() < 5) || (tag.compare(tag.size() - 2, 2, "--") != 0));
+            bool in_cdata = (tag.compare(0, 8, "![CDATA[") == 0) && ((tag.size() < 10) || (tag.compare(tag.size() - 2, 2, "]]") != 0));
+            if (!in_comment && !in_cdata) {
+                return true;
+            }
+        } else if ((c == '"' || c == '\'') && (tag.empty() || tag[0] != '!')) {
+            // Attribute values may contain '>'
+            quote = (quote == c) ? 0 : (quote ? quote : c);
+        }
+        tag += c;
+    }
+    return false;
+}
+
+bool VOTableRowReader::NextTag(string& tag) {
+    return ReadText(nullptr) && ReadTag(tag);
+}
+
+string VOTableRowReader::TagName(const string& tag) {
+    size_t end = tag.find_first_of(" \t\r\n/", (!tag.empty() && tag[0] == '/') ? 1 : 0);
+    return tag.substr(0, end);
+}
+
+bool VOTableRowReader::IsSelfClosing(const string& tag) {
+    return !tag.empty() && tag.back() == '/';
+}
+
+static void AppendUtf8(unsigned long code, string& output) {
+    if (code < 0x80) {
+        output += static_cast<char>(code);
+    } else if (code < 0x800) {
+        output += static_cast<char>(0xc0 | (code >> 6));
+        output += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        output += static_cast<char>(0xe0 | (code >> 12));
+        output += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        output += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        output += static_cast<char>(0xf0 | (code >> 18));
+        output += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        output += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        output += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+void VOTableRowReader::AppendUnescaped(const string& text, string& output) {
+    // Entity and character references, and line endings normalised to '\n'
+    if (text.find_first_of("&\r") == string::npos) {
+        output += text;
+        return;
+    }
+
+    static const pair<const char*, char> entities[] = {{"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}, {"&quot;", '"'}, {"&apos;", '\''}};
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\r') {
+            output += '\n';
+            if (i + 1 < text.size() && text[i + 1] == '\n') {
+                i++;
+            }
+            continue;
+        } else if (c != '&') {
+            output += c;
+            continue;
+        }
+
+        bool replaced(false);
+        if (text.compare(i, 2, "&#") == 0) {
+            bool hex = (i + 2 < text.size()) && (text[i + 2] == 'x');
+            const char* start = text.c_str() + i + (hex ? 3 : 2);
+            char* end;
+            unsigned long code = strtoul(start, &end, hex ? 16 : 10);
+            if (end != start && *end == ';' && code > 0 && code <= 0x10ffff) {
+                AppendUtf8(code, output);
+                i = end - text.c_str();
+                replaced = true;
+            }
+        } else {
+            for (auto& entity : entities) {
+                size_t length = strlen(entity.first);
+                if (text.compare(i, length, entity.first) == 0) {
+                    output += entity.second;
+                    i += length - 1;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) {
+            output += c;
+        }
+    }
+}
+
+} // namespace carta
@@ -0,0 +1,56 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TABLE_VOTABLEROWREADER_H_
+#define CARTA_BACKEND_TABLE_VOTABLEROWREADER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define VOTABLE_READ_BUFFER_SIZE (1024 * 1024)
+
+namespace carta {
+
+typedef std::vector<std::string> VOTableRow;
+
+// Streaming reader for the TABLEDATA rows of a VOTable, which reads the file in blocks instead of parsing it into a DOM. Cell text
+// is unescaped as by pugixml; CDATA sections are kept, and comments and unexpected elements are skipped.
+class VOTableRowReader {
+public:
+    // Reads the table data from the start of the DATA element at data_offset
+    VOTableRowReader(const std::string& filename, size_t data_offset);
+
+    // Whether the data has a TABLEDATA element
+    bool IsValid() const;
+    // Appends up to max_rows rows of cell text; returns false when the end of the table data is reached
+    bool ReadRows(size_t max_rows, std::vector<VOTableRow>& rows);
+    // Whether the file ended before the table data did
+    bool Failed() const;
+
+private:
+    bool ReadChar(char& c);
+    // Appends text up to the next '<', which is skipped
+    bool ReadText(std::string* text);
+    // Reads the tag after '<', without the brackets; comments and CDATA are read whole
+    bool ReadTag(std::string& tag);
+    bool NextTag(std::string& tag);
+    bool ReadRow(VOTableRow& row);
+    bool ReadCell(std::string& cell);
+
+    static std::string TagName(const std::string& tag);
+    static bool IsSelfClosing(const std::string& tag);
+    static void AppendUnescaped(const std::string& text, std::string& output);
+
+    std::ifstream _file;
+    std::vector<char> _buffer;
+    size_t _buffer_pos, _buffer_end;
+    bool _valid, _finished, _failed;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TABLE_VOTABLEROWREADER_H_
@@ -0,0 +1,161 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TaskScheduler.cc: runs session tasks by priority class
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+
+#include "Constants.h"
+#include "Metrics.h"
+#include "OnMessageTask.h"
+#include "Threading.h"
+#include "Timer/SlowRequestLog.h"
+#include "Timer/TraceEvents.h"
+
+TaskScheduler::TaskScheduler()
+    : _arena(TBB_TASK_THREAD_COUNT, 0),
+      _max_workers(TBB_TASK_THREAD_COUNT),
+      _num_workers(0),
+      _max_heavy_tasks(std::max(1, TBB_TASK_THREAD_COUNT / 2)),
+      _num_heavy_tasks(0) {}
+
+TaskScheduler& TaskScheduler::GetInstance() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+void TaskScheduler::Enqueue(OnMessageTask* task) {
+    auto& scheduler = GetInstance();
+    std::scoped_lock lock(scheduler._mutex);
+    scheduler.Push(task);
+
+    // Workers keep running queued tasks, so a new one is only needed while some are idle
+    if (scheduler._num_workers < scheduler._max_workers) {
+        scheduler._num_workers++;
+        scheduler._arena.enqueue([&scheduler]() { scheduler.Work(); });
+    }
+}
+
+std::vector<size_t> TaskScheduler::QueueDepths() {
+    auto& scheduler = GetInstance();
+    std::scoped_lock lock(scheduler._mutex);
+    std::vector<size_t> depths;
+    for (auto& queue : scheduler._queues) {
+        size_t depth(0);
+        for (auto& [session, tasks] : queue.session_tasks) {
+            depth += tasks.size();
+        }
+        depths.push_back(depth);
+    }
+    return depths;
+}
+
+void TaskScheduler::Push(OnMessageTask* task) {
+    auto& queue = _queues[(int)task->Priority()];
+    Session* session = task->_session;
+    auto& tasks = queue.session_tasks[session];
+    if (tasks.empty()) {
+        queue.sessions.push_back(session);
+    }
+    tasks.push_back({task, std::chrono::steady_clock::now()});
+}
+
+OnMessageTask* TaskScheduler::Pop() {
+    // Highest class with a task which may run, unless a task of another class has waited too long
+    auto now = std::chrono::steady_clock::now();
+    auto longest_wait = std::chrono::steady_clock::duration(std::chrono::milliseconds(TASK_SCHEDULER_MAX_WAIT_MS));
+    int selected(-1);
+    for (int priority = 0; priority < (int)TaskPriority::NumPriorities; priority++) {
+        auto& queue = _queues[priority];
+        if (queue.sessions.empty() || (IsHeavy(priority) && _num_heavy_tasks >= _max_heavy_tasks)) {
+            continue;
+        }
+        if (selected < 0) {
+            selected = priority;
+        }
+        for (auto& [session, tasks] : queue.session_tasks) {
+            auto wait = now - tasks.front().queued_time;
+            if (wait > longest_wait) {
+                longest_wait = wait;
+                selected = priority;
+            }
+        }
+    }
+    if (selected < 0) {
+        return nullptr;
+    }
+
+    // Next session in turn
+    auto& queue = _queues[selected];
+    Session* session = queue.sessions.front();
+    queue.sessions.pop_front();
+    auto& tasks = queue.session_tasks[session];
+    OnMessageTask* task = tasks.front().task;
+    tasks.pop_front();
+    if (tasks.empty()) {
+        queue.session_tasks.erase(session);
+    } else {
+        queue.sessions.push_back(session);
+    }
+    return task;
+}
+
+void TaskScheduler::Work() {
+    carta::ThreadManager::PinToNumaNode();
+
+    std::unique_lock lock(_mutex);
+    while (OnMessageTask* task = Pop()) {
+        bool heavy = IsHeavy((int)task->Priority());
+        if (heavy) {
+            _num_heavy_tasks++;
+        }
+        lock.unlock();
+
+        // Spans of the task, and of loader reads and messages it sends, are in the context of its request
+        carta::TraceContext trace_context;
+        trace_context.session_id = task->_session->GetId();
+        trace_context.request_id = task->_request.request_id;
+        carta::TraceScope trace_scope(trace_context);
+        carta::RequestScope request_scope(!task->IsCancelled() && task->_request.event_type >= 0 ? &task->_request : nullptr);
+
+        // A task may return itself to run again, after other queued tasks
+        OnMessageTask* next_task(nullptr);
+        bool run = !task->IsCancelled();
+        if (run) {
+            carta::TraceSpan trace_span("task", "task");
+            if (trace_span.Traced() && task->_request.event_type >= 0) {
+                auto event_name = CARTA::EventType_Name((CARTA::EventType)task->_request.event_type);
+                carta::Tracer::Complete(
+                    "queued", "task", task->_request.start, std::chrono::steady_clock::now(), trace_context, event_name);
+                trace_span.SetDetail(event_name);
+            }
+
+            // Its OpenMP teams share the thread budget with those of the other running tasks
+            carta::ThreadManager::BusyScope busy;
+            next_task = task->execute();
+        }
+        if (next_task != task) {
+            // Requests are measured until the task which handles them is done, not counting requests cancelled before running
+            if (run && task->_request.event_type >= 0) {
+                carta::Metrics::Global().RecordRequest(
+                    task->_request.event_type, std::chrono::steady_clock::now() - task->_request.start);
+                request_scope.Finish();
+            }
+            delete task;
+        }
+
+        lock.lock();
+        if (heavy) {
+            _num_heavy_tasks--;
+        }
+        if (next_task) {
+            Push(next_task);
+        }
+    }
+    _num_workers--;
+}
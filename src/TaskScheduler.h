@@ -0,0 +1,75 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TaskScheduler.h: runs session tasks by priority class
+
+#ifndef CARTA_BACKEND__TASKSCHEDULER_H_
+#define CARTA_BACKEND__TASKSCHEDULER_H_
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/task_arena.h>
+
+// Longest wait of a task before it runs ahead of tasks with a higher priority
+#define TASK_SCHEDULER_MAX_WAIT_MS 2000
+
+class OnMessageTask;
+class Session;
+
+// Priority classes of session tasks, highest first
+enum class TaskPriority { Cursor, Tiles, RegionData, Histograms, Background, NumPriorities };
+
+// Runs session tasks in a task arena, highest priority class first. Within a class, sessions take turns, so that one session's
+// queued tasks do not delay another's; tasks which have waited longer than TASK_SCHEDULER_MAX_WAIT_MS run first, so that lower
+// classes are not starved. Histogram and background tasks run on at most half of the workers, leaving the others for interactive
+// tasks of all sessions.
+class TaskScheduler {
+public:
+    // Queues a task; it is deleted after it runs, or without running if its context is cancelled first
+    static void Enqueue(OnMessageTask* task);
+    // Numbers of queued tasks by priority class
+    static std::vector<size_t> QueueDepths();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+private:
+    TaskScheduler();
+    static TaskScheduler& GetInstance();
+
+    struct QueuedTask {
+        OnMessageTask* task;
+        std::chrono::steady_clock::time_point queued_time;
+    };
+
+    struct PriorityQueue {
+        std::unordered_map<Session*, std::deque<QueuedTask>> session_tasks;
+        std::deque<Session*> sessions; // sessions with queued tasks, in turn order
+    };
+
+    static bool IsHeavy(int priority) {
+        return priority >= (int)TaskPriority::Histograms;
+    }
+
+    // Called with the mutex held
+    void Push(OnMessageTask* task);
+    OnMessageTask* Pop();
+
+    // Runs queued tasks until there are none it may run
+    void Work();
+
+    std::mutex _mutex;
+    PriorityQueue _queues[(int)TaskPriority::NumPriorities];
+    tbb::task_arena _arena;
+    int _max_workers, _num_workers;
+    int _max_heavy_tasks, _num_heavy_tasks;
+};
+
+#endif // CARTA_BACKEND__TASKSCHEDULER_H_
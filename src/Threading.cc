@@ -6,8 +6,22 @@
 
 #include "Threading.h"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "Logger/Logger.h"
+
 namespace carta {
 int ThreadManager::_omp_thread_count = 0;
+std::atomic<int> ThreadManager::_busy_threads(0);
+bool ThreadManager::_numa_pinning = false;
 
 void ThreadManager::ApplyThreadLimit() {
     // Skip application if we are already inside an OpenMP parallel block
@@ -15,15 +29,78 @@ void ThreadManager::ApplyThreadLimit() {
         return;
     }
 
-    if (_omp_thread_count > 0) {
-        omp_set_num_threads(_omp_thread_count);
-    } else {
-        omp_set_num_threads(omp_get_num_procs());
-    }
+    int busy_threads = std::max(_busy_threads.load(), 1);
+    omp_set_num_threads(std::max(ThreadBudget() / busy_threads, 1));
 }
 
 void ThreadManager::SetThreadLimit(int count) {
     _omp_thread_count = count;
     ApplyThreadLimit();
 }
-} // namespace carta
\ No newline at end of file
+
+int ThreadManager::ThreadBudget() {
+    return _omp_thread_count > 0 ? _omp_thread_count : omp_get_num_procs();
+}
+
+#ifdef __linux__
+// CPUs of each NUMA node, from a list such as "0-15,32-47"
+static std::vector<std::vector<int>> NumaNodeCpus() {
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; node++) {
+        std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!cpulist || !std::getline(cpulist, list)) {
+            break;
+        }
+
+        std::vector<int> cpus;
+        std::istringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            try {
+                auto dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            } catch (const std::exception&) {
+                break;
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(cpus);
+        }
+    }
+    return nodes;
+}
+#endif
+
+void ThreadManager::PinToNumaNode() {
+#ifdef __linux__
+    static thread_local bool pinned(false);
+    if (!_numa_pinning || pinned) {
+        return;
+    }
+    pinned = true;
+
+    static const std::vector<std::vector<int>> nodes = NumaNodeCpus();
+    static std::atomic<int> next_node(0);
+    if (nodes.size() < 2) {
+        return;
+    }
+
+    int node = next_node++ % nodes.size();
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : nodes[node]) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        spdlog::debug("Task thread pinned to NUMA node {}", node);
+    } else {
+        spdlog::warn("Could not pin task thread to NUMA node {}", node);
+    }
+#endif
+}
+} // namespace carta
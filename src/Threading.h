@@ -7,6 +7,8 @@
 #ifndef __THREADING_H__
 #define __THREADING_H__
 
+#include <atomic>
+
 #include <omp.h>
 
 #define MAX_TILING_TASKS 8
@@ -22,12 +24,39 @@
 #endif
 
 namespace carta {
+// One budget of worker threads for the OpenMP teams started by all task threads: each calculation running concurrently gets an
+// equal share, so that busy sessions do not oversubscribe the machine.
 class ThreadManager {
     static int _omp_thread_count;
+    static std::atomic<int> _busy_threads;
+    static bool _numa_pinning;
 
 public:
+    // Sets the OpenMP team size of the calling thread to its share of the budget
     static void ApplyThreadLimit();
     static void SetThreadLimit(int count);
+    static int ThreadBudget();
+
+    // Counts the calling thread as running a calculation while in scope
+    class BusyScope {
+    public:
+        BusyScope() {
+            ++_busy_threads;
+        }
+        ~BusyScope() {
+            --_busy_threads;
+        }
+        BusyScope(const BusyScope&) = delete;
+        BusyScope& operator=(const BusyScope&) = delete;
+    };
+
+    // Pins the calling thread to the CPUs of a NUMA node, taking the nodes in turn, if enabled. OpenMP teams which the thread starts
+    // stay on its node, so that the image data they fill is first touched, and allocated, there. Linux only; no effect with a
+    // single node.
+    static void PinToNumaNode();
+    static void SetNumaPinning(bool enable) {
+        _numa_pinning = enable;
+    }
 };
 } // namespace carta
 
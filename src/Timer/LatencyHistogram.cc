@@ -0,0 +1,211 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LatencyHistogram.cc: per-thread latency histograms of fixed instrumentation points, with percentile snapshots
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Logger/Logger.h"
+
+// Sub-buckets per power of two, as a power of two
+#define LATENCY_SUB_BUCKET_BITS 4
+// Largest power of two of a duration in microseconds (about 38 hours); longer durations are counted in the last bucket
+#define LATENCY_MAX_EXPONENT 36
+
+namespace carta {
+
+namespace {
+
+constexpr int NumPoints = (int)LatencyPoint::Count;
+constexpr uint64_t SubBuckets = 1 << LATENCY_SUB_BUCKET_BITS;
+constexpr int NumBuckets = SubBuckets * (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 2);
+
+// Durations below SubBuckets have a bucket each; above, each power of two is split into SubBuckets buckets
+int BucketIndex(uint64_t value) {
+    if (value < SubBuckets) {
+        return value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > LATENCY_MAX_EXPONENT) {
+        return NumBuckets - 1;
+    }
+    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    return SubBuckets * (shift + 1) + ((value >> shift) & (SubBuckets - 1));
+}
+
+// Middle of the range of durations of a bucket
+double BucketValue(int index) {
+    if (index < (int)SubBuckets) {
+        return index;
+    }
+    int shift = index / SubBuckets - 1;
+    uint64_t lower = (SubBuckets + index % SubBuckets) << shift;
+    return lower + ((1ull << shift) - 1) / 2.0;
+}
+
+struct Counts {
+    std::atomic<uint64_t> buckets[NumBuckets] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+// Only the owning thread writes its counts, so increments are a load and a store rather than a locked read-modify-write
+void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+struct ThreadHistograms {
+    Counts points[NumPoints];
+    ThreadHistograms();
+    ~ThreadHistograms();
+};
+
+class Registry {
+public:
+    static Registry& Global() {
+        // Never destroyed, since threads may exit after static destruction
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    void Add(ThreadHistograms* thread) {
+        std::scoped_lock lock(_mutex);
+        _threads.push_back(thread);
+    }
+
+    // Keeps the counts of an exiting thread
+    void Remove(ThreadHistograms* thread) {
+        std::scoped_lock lock(_mutex);
+        for (int p = 0; p < NumPoints; ++p) {
+            Merge(_retired[p], thread->points[p]);
+        }
+        _threads.erase(std::remove(_threads.begin(), _threads.end(), thread), _threads.end());
+    }
+
+    void Sum(LatencyPoint point, std::vector<uint64_t>& buckets, uint64_t& count, uint64_t& sum, uint64_t& max) {
+        std::scoped_lock lock(_mutex);
+        buckets.assign(NumBuckets, 0);
+        count = sum = max = 0;
+        auto add = [&](const Counts& counts) {
+            for (int i = 0; i < NumBuckets; ++i) {
+                buckets[i] += counts.buckets[i].load(std::memory_order_relaxed);
+            }
+            count += counts.count.load(std::memory_order_relaxed);
+            sum += counts.sum.load(std::memory_order_relaxed);
+            max = std::max(max, counts.max.load(std::memory_order_relaxed));
+        };
+        add(_retired[(int)point]);
+        for (auto thread : _threads) {
+            add(thread->points[(int)point]);
+        }
+    }
+
+private:
+    static void Merge(Counts& to, const Counts& from) {
+        for (int i = 0; i < NumBuckets; ++i) {
+            Increment(to.buckets[i], from.buckets[i].load(std::memory_order_relaxed));
+        }
+        Increment(to.count, from.count.load(std::memory_order_relaxed));
+        Increment(to.sum, from.sum.load(std::memory_order_relaxed));
+        auto max = std::max(to.max.load(std::memory_order_relaxed), from.max.load(std::memory_order_relaxed));
+        to.max.store(max, std::memory_order_relaxed);
+    }
+
+    std::mutex _mutex;
+    std::vector<ThreadHistograms*> _threads;
+    Counts _retired[NumPoints];
+};
+
+ThreadHistograms::ThreadHistograms() {
+    Registry::Global().Add(this);
+}
+
+ThreadHistograms::~ThreadHistograms() {
+    Registry::Global().Remove(this);
+}
+
+} // namespace
+
+std::atomic<bool> LatencyHistograms::_enabled{false};
+
+void LatencyHistograms::RecordThread(LatencyPoint point, int64_t microseconds) {
+    thread_local ThreadHistograms histograms;
+    uint64_t value = std::max<int64_t>(microseconds, 0);
+    auto& counts = histograms.points[(int)point];
+    Increment(counts.buckets[BucketIndex(value)], 1);
+    Increment(counts.count, 1);
+    Increment(counts.sum, value);
+    if (value > counts.max.load(std::memory_order_relaxed)) {
+        counts.max.store(value, std::memory_order_relaxed);
+    }
+}
+
+LatencySummary LatencyHistograms::Snapshot(LatencyPoint point) {
+    std::vector<uint64_t> buckets;
+    LatencySummary summary = {};
+    uint64_t sum, max;
+    Registry::Global().Sum(point, buckets, summary.count, sum, max);
+    if (!summary.count) {
+        return summary;
+    }
+
+    summary.mean_ms = sum * 1e-3 / summary.count;
+    summary.max_ms = max * 1e-3;
+    double* percentiles[] = {&summary.p50_ms, &summary.p90_ms, &summary.p99_ms};
+    const double ranks[] = {0.5, 0.9, 0.99};
+    uint64_t cumulative(0);
+    int p(0);
+    for (int i = 0; i < NumBuckets && p < 3; ++i) {
+        cumulative += buckets[i];
+        while (p < 3 && cumulative >= ranks[p] * summary.count) {
+            *percentiles[p++] = (i == NumBuckets - 1) ? summary.max_ms : std::min(BucketValue(i) * 1e-3, summary.max_ms);
+        }
+    }
+    return summary;
+}
+
+const char* LatencyHistograms::Name(LatencyPoint point) {
+    switch (point) {
+        case LatencyPoint::TileFill:
+            return "Tile fill";
+        case LatencyPoint::TileCompress:
+            return "Tile compress";
+        case LatencyPoint::ChannelLoad:
+            return "Channel load";
+        case LatencyPoint::Contour:
+            return "Contour";
+        case LatencyPoint::Histogram:
+            return "Histogram";
+        case LatencyPoint::RegionStats:
+            return "Region stats";
+        case LatencyPoint::SpectralProfile:
+            return "Spectral profile";
+        default:
+            return "";
+    }
+}
+
+void LatencyHistograms::Log() {
+    if (!Enabled()) {
+        return;
+    }
+    for (int p = 0; p < NumPoints; ++p) {
+        auto point = (LatencyPoint)p;
+        auto summary = Snapshot(point);
+        if (summary.count) {
+            spdlog::performance("{} latency: {} count, mean {:.3f} ms, p50 {:.3f} ms, p90 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+                Name(point), summary.count, summary.mean_ms, summary.p50_ms, summary.p90_ms, summary.p99_ms, summary.max_ms);
+        }
+    }
+}
+
+} // namespace carta
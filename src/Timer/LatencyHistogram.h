@@ -0,0 +1,84 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# LatencyHistogram.h: per-thread latency histograms of fixed instrumentation points, with percentile snapshots
+
+#ifndef CARTA_BACKEND_TIMER_LATENCYHISTOGRAM_H_
+#define CARTA_BACKEND_TIMER_LATENCYHISTOGRAM_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace carta {
+
+enum class LatencyPoint { TileFill, TileCompress, ChannelLoad, Contour, Histogram, RegionStats, SpectralProfile, Count };
+
+struct LatencySummary {
+    uint64_t count;
+    double mean_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+// Durations in microseconds are counted in log-linear buckets (16 per power of two, so within about 6%) of a histogram owned by
+// the recording thread: recording is a few relaxed atomic stores, without locks or contention. Snapshots add the histograms of all
+// threads, including threads which have exited. Disabled unless performance logging is on, when Record only loads a flag.
+class LatencyHistograms {
+public:
+    static void SetEnabled(bool enabled) {
+        _enabled.store(enabled, std::memory_order_relaxed);
+    }
+    static bool Enabled() {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    static void Record(LatencyPoint point, int64_t microseconds) {
+        if (Enabled()) {
+            RecordThread(point, microseconds);
+        }
+    }
+
+    static LatencySummary Snapshot(LatencyPoint point);
+    static const char* Name(LatencyPoint point);
+
+    // Logs a summary of each point with measurements to the performance log
+    static void Log();
+
+private:
+    static void RecordThread(LatencyPoint point, int64_t microseconds);
+
+    static std::atomic<bool> _enabled;
+};
+
+// Records the duration of the scope, if latency histograms are enabled when it starts
+class LatencyScope {
+public:
+    explicit LatencyScope(LatencyPoint point) : _point(point), _enabled(LatencyHistograms::Enabled()) {
+        if (_enabled) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+    ~LatencyScope() {
+        if (_enabled) {
+            auto dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+            LatencyHistograms::Record(_point, dt);
+        }
+    }
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+
+private:
+    LatencyPoint _point;
+    bool _enabled;
+    std::chrono::steady_clock::time_point _start;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TIMER_LATENCYHISTOGRAM_H_
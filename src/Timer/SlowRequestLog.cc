@@ -0,0 +1,180 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SlowRequestLog.cc: requests slower than a threshold for their event type, logged as JSON records with a breakdown by phase
+
+#include "SlowRequestLog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#include <carta-protobuf/enums.pb.h>
+#include <fmt/format.h>
+
+namespace carta {
+
+namespace {
+
+struct LogFile {
+    std::mutex mutex;
+    FILE* file = nullptr;
+    std::vector<int64_t> thresholds_us; // by event type
+    int64_t default_threshold_us = 0;
+
+    static LogFile& Global() {
+        // Never destroyed, since tasks may finish after static destruction
+        static LogFile* log_file = new LogFile();
+        return *log_file;
+    }
+};
+
+thread_local RequestRecord* thread_record = nullptr;
+thread_local PhaseScope* thread_phase = nullptr;
+
+const char* PhaseName(int phase) {
+    static const char* names[] = {"image_lock_ms", "cache_lock_ms", "spectral_lock_ms", "io_ms", "compress_ms", "send_ms"};
+    static_assert(sizeof(names) / sizeof(names[0]) == (int)RequestPhase::Count, "a phase has no name");
+    return names[phase];
+}
+
+double Milliseconds(std::chrono::steady_clock::duration dt) {
+    return std::chrono::duration<double, std::milli>(dt).count();
+}
+
+} // namespace
+
+std::atomic<bool> SlowRequestLog::_active{false};
+
+bool SlowRequestLog::Start(const std::string& filename) {
+    auto& log_file = LogFile::Global();
+    std::scoped_lock lock(log_file.mutex);
+    if (log_file.file) {
+        return false;
+    }
+    log_file.file = fopen(filename.c_str(), "a");
+    _active = log_file.file != nullptr;
+    return _active;
+}
+
+bool SlowRequestLog::Configure(const std::string& thresholds, int default_ms, std::string& error) {
+    std::vector<int64_t> thresholds_us(CARTA::EventType_MAX + 1, (int64_t)default_ms * 1000);
+    std::istringstream entries(thresholds);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry.erase(0, entry.find_first_not_of(' '));
+        entry.erase(entry.find_last_not_of(' ') + 1);
+        if (entry.empty()) {
+            continue;
+        }
+
+        auto separator = entry.find('=');
+        CARTA::EventType event_type;
+        if (separator == std::string::npos || !CARTA::EventType_Parse(entry.substr(0, separator), &event_type)) {
+            error = fmt::format("Invalid slow request threshold {}", entry);
+            return false;
+        }
+        try {
+            thresholds_us[event_type] = std::stoll(entry.substr(separator + 1)) * 1000;
+        } catch (const std::exception&) {
+            error = fmt::format("Invalid slow request threshold {}", entry);
+            return false;
+        }
+    }
+
+    auto& log_file = LogFile::Global();
+    std::scoped_lock lock(log_file.mutex);
+    log_file.thresholds_us = thresholds_us;
+    log_file.default_threshold_us = (int64_t)default_ms * 1000;
+    return true;
+}
+
+RequestRecord* SlowRequestLog::ThreadRecord() {
+    return thread_record;
+}
+
+void SlowRequestLog::Finish(const RequestRecord& record) {
+    auto end = std::max(record.last_send, record.handling_start + record.handling);
+    auto total = end - record.start;
+    auto& log_file = LogFile::Global();
+    auto threshold_us = (record.event_type >= 0 && record.event_type < (int)log_file.thresholds_us.size())
+                            ? log_file.thresholds_us[record.event_type]
+                            : log_file.default_threshold_us;
+    if (std::chrono::duration_cast<std::chrono::microseconds>(total).count() < threshold_us) {
+        return;
+    }
+
+    auto compute = record.handling;
+    for (auto& phase : record.phases) {
+        compute -= phase;
+    }
+    double unix_time = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string line = fmt::format(R"({{"time":{:.3f},"event":"{}","session_id":{},"request_id":{})", unix_time,
+        CARTA::EventType_Name((CARTA::EventType)record.event_type), record.session_id, record.request_id);
+    if (record.file_id >= 0) {
+        line += fmt::format(R"(,"file_id":{})", record.file_id);
+    }
+    if (record.region_id >= 0) {
+        line += fmt::format(R"(,"region_id":{})", record.region_id);
+    }
+    line += fmt::format(
+        R"(,"total_ms":{:.3f},"queued_ms":{:.3f})", Milliseconds(total), Milliseconds(record.handling_start - record.start));
+    for (int i = 0; i < (int)RequestPhase::Count; ++i) {
+        line += fmt::format(R"(,"{}":{:.3f})", PhaseName(i), Milliseconds(record.phases[i]));
+    }
+    line += fmt::format(R"(,"compute_ms":{:.3f}}})", Milliseconds(std::max(compute, std::chrono::steady_clock::duration::zero())));
+    line += '\n';
+
+    std::scoped_lock lock(log_file.mutex);
+    if (log_file.file) {
+        fputs(line.c_str(), log_file.file);
+        fflush(log_file.file);
+    }
+}
+
+RequestScope::RequestScope(RequestRecord* record) : _record(SlowRequestLog::Active() ? record : nullptr), _previous(nullptr) {
+    if (_record) {
+        _previous = thread_record;
+        thread_record = _record;
+        _start = std::chrono::steady_clock::now();
+        if (_record->handling_start == std::chrono::steady_clock::time_point()) {
+            _record->handling_start = _start;
+        }
+    }
+}
+
+RequestScope::~RequestScope() {
+    if (_record) {
+        thread_record = _previous;
+    }
+}
+
+void RequestScope::Finish() {
+    if (_record) {
+        _record->handling += std::chrono::steady_clock::now() - _start;
+        SlowRequestLog::Finish(*_record);
+    }
+}
+
+PhaseScope::PhaseScope(RequestPhase phase) : _phase(phase), _record(thread_record), _parent(nullptr) {
+    if (_record) {
+        _parent = thread_phase;
+        thread_phase = this;
+        _start = std::chrono::steady_clock::now();
+    }
+}
+
+void PhaseScope::Stop() {
+    auto duration = std::chrono::steady_clock::now() - _start;
+    _record->phases[(int)_phase] += duration - _nested;
+    if (_parent) {
+        _parent->_nested += duration;
+    }
+    thread_phase = _parent;
+}
+
+} // namespace carta
@@ -0,0 +1,120 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# SlowRequestLog.h: requests slower than a threshold for their event type, logged as JSON records with a breakdown by phase
+
+#ifndef CARTA_BACKEND_TIMER_SLOWREQUESTLOG_H_
+#define CARTA_BACKEND_TIMER_SLOWREQUESTLOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace carta {
+
+// Phases measured on the thread handling a request; compute is the rest of its handling time
+enum class RequestPhase { ImageLock, CacheLock, SpectralLock, Io, Compress, Send, Count };
+
+// A received message, from its arrival until its handler or task is done
+struct RequestRecord {
+    int event_type = -1;
+    uint32_t session_id = 0;
+    int32_t file_id = -1; // of the first file or region message sent, if the request does not say
+    int32_t region_id = -1;
+    uint32_t request_id = 0;
+    std::chrono::steady_clock::time_point start;          // arrival
+    std::chrono::steady_clock::time_point handling_start; // when its handler or task first ran
+    std::chrono::steady_clock::time_point last_send;
+    std::chrono::steady_clock::duration handling{0}; // total time its handler or task ran, over all runs
+    std::chrono::steady_clock::duration phases[(int)RequestPhase::Count] = {};
+};
+
+// Each request over the threshold for its event type is appended to the log as one line of JSON, with the time it waited in the
+// task queue and the time of each phase. Phases are only measured while the log is open, at the cost of a thread-local load
+// otherwise.
+class SlowRequestLog {
+public:
+    static bool Start(const std::string& filename);
+    // Comma-separated event type names with thresholds in milliseconds, e.g. "SET_CURSOR=100,ADD_REQUIRED_TILES=500"; other event
+    // types use the default threshold. False with the error for invalid thresholds, which are not applied.
+    static bool Configure(const std::string& thresholds, int default_ms, std::string& error);
+
+    static bool Active() {
+        return _active.load(std::memory_order_relaxed);
+    }
+    // Record of the request handled by the thread, or nullptr
+    static RequestRecord* ThreadRecord();
+    static void Finish(const RequestRecord& record);
+
+private:
+    static std::atomic<bool> _active;
+};
+
+// Makes the record that of the thread's request while the scope lasts, if the log is open
+class RequestScope {
+public:
+    explicit RequestScope(RequestRecord* record);
+    ~RequestScope();
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+    // The request is done: adds the time it ran and logs it if it was slow
+    void Finish();
+
+private:
+    RequestRecord* _record;
+    RequestRecord* _previous;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Adds the duration of the scope to a phase of the thread's request. Time in a nested phase, such as a lock wait during a read, is
+// counted only in the nested phase.
+class PhaseScope {
+public:
+    explicit PhaseScope(RequestPhase phase);
+    ~PhaseScope() {
+        if (_record) {
+            Stop();
+        }
+    }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    void Stop();
+
+    RequestPhase _phase;
+    RequestRecord* _record;
+    PhaseScope* _parent;
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::duration _nested{0};
+};
+
+// Locks the mutex, adding the wait to the phase if it is contended
+template <typename Mutex>
+std::unique_lock<Mutex> TimedLock(Mutex& mutex, RequestPhase phase) {
+    std::unique_lock<Mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        PhaseScope wait(phase);
+        lock.lock();
+    }
+    return lock;
+}
+
+// Acquires a scoped lock of a reader-writer mutex such as tbb::queuing_rw_mutex, adding the wait to the phase if it is contended
+template <typename ScopedLock, typename Mutex>
+void TimedAcquire(ScopedLock& lock, Mutex& mutex, bool write, RequestPhase phase) {
+    if (!lock.try_acquire(mutex, write)) {
+        PhaseScope wait(phase);
+        lock.acquire(mutex, write);
+    }
+}
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TIMER_SLOWREQUESTLOG_H_
@@ -0,0 +1,177 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TraceEvents.cc: spans of request handling written as Chrome trace events, for chrome://tracing or Perfetto
+
+#include "TraceEvents.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Size of the events buffered by a thread before they are written
+#define TRACE_BUFFER_BYTES 65536
+// Longest time buffered events wait before they are written, if the thread records another span
+#define TRACE_FLUSH_INTERVAL_MS 1000
+
+namespace carta {
+
+namespace {
+
+struct ThreadBuffer;
+
+struct TraceFile {
+    std::mutex mutex; // also held while buffers are added and removed
+    FILE* file = nullptr;
+    std::chrono::steady_clock::time_point epoch;
+    std::vector<ThreadBuffer*> buffers;
+    int pid = 0;
+    int thread_count = 0;
+
+    static TraceFile& Global() {
+        // Never destroyed, since threads may exit after static destruction
+        static TraceFile* trace_file = new TraceFile();
+        return *trace_file;
+    }
+};
+
+struct ThreadBuffer {
+    std::mutex mutex; // only contended while the trace is stopped
+    std::string data;
+    std::chrono::steady_clock::time_point last_write;
+    TraceContext context;
+    int tid;
+
+    ThreadBuffer() {
+        auto& trace_file = TraceFile::Global();
+        std::scoped_lock lock(trace_file.mutex);
+        tid = ++trace_file.thread_count;
+        trace_file.buffers.push_back(this);
+    }
+    ~ThreadBuffer() {
+        auto& trace_file = TraceFile::Global();
+        std::scoped_lock lock(trace_file.mutex);
+        std::scoped_lock buffer_lock(mutex);
+        Write(trace_file);
+        trace_file.buffers.erase(std::remove(trace_file.buffers.begin(), trace_file.buffers.end(), this), trace_file.buffers.end());
+    }
+
+    // Called with the trace file mutex and the buffer mutex held
+    void Write(TraceFile& trace_file) {
+        if (trace_file.file && !data.empty()) {
+            fwrite(data.data(), 1, data.size(), trace_file.file);
+            fflush(trace_file.file);
+        }
+        data.clear();
+        last_write = std::chrono::steady_clock::now();
+    }
+};
+
+ThreadBuffer& GetThreadBuffer() {
+    thread_local ThreadBuffer buffer;
+    return buffer;
+}
+
+void AppendEscaped(std::string& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c >= 0x20) {
+            out += c;
+        }
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::_active{false};
+std::atomic<uint32_t> Tracer::_session_id{0};
+
+bool Tracer::Start(const std::string& filename, uint32_t session_id) {
+    auto& trace_file = TraceFile::Global();
+    std::scoped_lock lock(trace_file.mutex);
+    if (trace_file.file) {
+        return false;
+    }
+    trace_file.file = fopen(filename.c_str(), "w");
+    if (!trace_file.file) {
+        return false;
+    }
+    fputs("[\n", trace_file.file);
+    trace_file.epoch = std::chrono::steady_clock::now();
+    trace_file.pid = getpid();
+    _session_id = session_id;
+    _active = true;
+
+    static bool stop_at_exit = (std::atexit(Stop) == 0);
+    (void)stop_at_exit;
+    return true;
+}
+
+void Tracer::Stop() {
+    _active = false;
+    auto& trace_file = TraceFile::Global();
+    std::scoped_lock lock(trace_file.mutex);
+    for (auto buffer : trace_file.buffers) {
+        std::scoped_lock buffer_lock(buffer->mutex);
+        buffer->Write(trace_file);
+    }
+    if (trace_file.file) {
+        fclose(trace_file.file);
+        trace_file.file = nullptr;
+    }
+}
+
+TraceContext& Tracer::ThreadContext() {
+    return GetThreadBuffer().context;
+}
+
+void Tracer::Complete(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end, const TraceContext& context, const std::string& detail) {
+    auto& trace_file = TraceFile::Global();
+    auto& buffer = GetThreadBuffer();
+    std::unique_lock buffer_lock(buffer.mutex);
+    if (!Active()) {
+        return;
+    }
+
+    auto& out = buffer.data;
+    double ts = std::chrono::duration<double, std::micro>(start - trace_file.epoch).count();
+    double dur = std::chrono::duration<double, std::micro>(end - start).count();
+    out += fmt::format(R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{},"args":{{"session_id":{})", name,
+        category, ts, dur, trace_file.pid, buffer.tid, context.session_id);
+    if (context.file_id >= 0) {
+        out += fmt::format(R"(,"file_id":{})", context.file_id);
+    }
+    if (context.region_id >= 0) {
+        out += fmt::format(R"(,"region_id":{})", context.region_id);
+    }
+    if (context.request_id) {
+        out += fmt::format(R"(,"request_id":{})", context.request_id);
+    }
+    if (!detail.empty()) {
+        out += R"(,"detail":")";
+        AppendEscaped(out, detail);
+        out += '"';
+    }
+    out += "}},\n";
+
+    if (out.size() >= TRACE_BUFFER_BYTES || end - buffer.last_write > std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS)) {
+        // The file mutex is taken before the buffer mutex, as when the trace is stopped
+        buffer_lock.unlock();
+        std::scoped_lock lock(trace_file.mutex, buffer.mutex);
+        buffer.Write(trace_file);
+    }
+}
+
+} // namespace carta
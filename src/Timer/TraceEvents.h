@@ -0,0 +1,132 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+//# TraceEvents.h: spans of request handling written as Chrome trace events, for chrome://tracing or Perfetto
+
+#ifndef CARTA_BACKEND_TIMER_TRACEEVENTS_H_
+#define CARTA_BACKEND_TIMER_TRACEEVENTS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace carta {
+
+// Request a span belongs to; spans on a thread take the context of the task or message it is handling
+struct TraceContext {
+    uint32_t session_id = 0;
+    int32_t file_id = -1;
+    int32_t region_id = -1;
+    uint32_t request_id = 0;
+};
+
+// Writes complete events of the traced session (or of all sessions) to a file in the JSON array format. Events are buffered per
+// thread and appended in blocks, so tracing one session costs little for the others: a span of another session only loads two
+// atomics. The array is left open, which the trace viewers accept, so that a trace can be read while the backend runs.
+class Tracer {
+public:
+    // Session 0 traces all sessions
+    static bool Start(const std::string& filename, uint32_t session_id);
+    static void Stop();
+
+    static bool Active() {
+        return _active.load(std::memory_order_relaxed);
+    }
+    static bool Traced(uint32_t session_id) {
+        if (!Active()) {
+            return false;
+        }
+        uint32_t traced_session = _session_id.load(std::memory_order_relaxed);
+        return !traced_session || traced_session == session_id;
+    }
+
+    static TraceContext& ThreadContext();
+
+    static void Complete(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end, const TraceContext& context, const std::string& detail);
+
+private:
+    static std::atomic<bool> _active;
+    static std::atomic<uint32_t> _session_id;
+};
+
+// Sets the trace context of the thread for its lifetime
+class TraceScope {
+public:
+    explicit TraceScope(const TraceContext& context) : _active(Tracer::Active()) {
+        if (_active) {
+            _previous = Tracer::ThreadContext();
+            Tracer::ThreadContext() = context;
+        }
+    }
+    ~TraceScope() {
+        if (_active) {
+            Tracer::ThreadContext() = _previous;
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    bool _active;
+    TraceContext _previous;
+};
+
+// Span from construction to destruction, in the given context or that of the thread. Active if its session is traced; a detail,
+// such as an event type or a shape, should only be formatted if it is.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category) : _name(name), _category(category), _traced(false) {
+        if (Tracer::Active()) {
+            Begin(Tracer::ThreadContext());
+        }
+    }
+    TraceSpan(const char* name, const char* category, const TraceContext& context)
+        : _name(name), _category(category), _traced(false) {
+        if (Tracer::Active()) {
+            Begin(context);
+        }
+    }
+    ~TraceSpan() {
+        if (_traced) {
+            Tracer::Complete(_name, _category, _start, std::chrono::steady_clock::now(), _context, _detail);
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    bool Traced() const {
+        return _traced;
+    }
+    // Start of the span, if it began before it could be constructed, e.g. when a message was received
+    void SetStart(std::chrono::steady_clock::time_point start) {
+        _start = start;
+    }
+    void SetDetail(const std::string& detail) {
+        _detail = detail;
+    }
+
+private:
+    void Begin(const TraceContext& context) {
+        if (Tracer::Traced(context.session_id)) {
+            _traced = true;
+            _context = context;
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    const char* _name;
+    const char* _category;
+    bool _traced;
+    TraceContext _context;
+    std::chrono::steady_clock::time_point _start;
+    std::string _detail;
+};
+
+} // namespace carta
+
+#endif // CARTA_BACKEND_TIMER_TRACEEVENTS_H_
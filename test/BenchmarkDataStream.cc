@@ -0,0 +1,180 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkImages.h"
+#include "DataStream/Compression.h"
+#include "DataStream/Contouring.h"
+#include "DataStream/SimdDispatch.h"
+#include "DataStream/Smoothing.h"
+#include "DataStream/Tile.h"
+
+// Tile width and height of the frontend
+#define TILE_SIZE 256
+
+using namespace std;
+
+typedef bool (*BlockSmoothFunction)(const float*, float*, int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, int);
+
+// Arguments: image size, downsampling factor
+static void BlockSmoothBenchmark(benchmark::State& state, BlockSmoothFunction block_smooth) {
+    int64_t size = state.range(0);
+    int factor = state.range(1);
+    auto& image = BenchmarkImages::Synthetic(size, size, 0.05);
+    int64_t dest_size = ceil(size / (float)factor);
+    vector<float> dest(dest_size * dest_size);
+    for (auto _ : state) {
+        block_smooth(image.data(), dest.data(), size, size, dest_size, dest_size, 0, 0, factor);
+        benchmark::DoNotOptimize(dest.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+
+static void BM_BlockSmoothScalar(benchmark::State& state) {
+    BlockSmoothBenchmark(state, BlockSmoothScalar);
+}
+static void BM_BlockSmoothSSE(benchmark::State& state) {
+    BlockSmoothBenchmark(state, BlockSmoothSSE);
+}
+BENCHMARK(BM_BlockSmoothScalar)->ArgsProduct({{2048, 4096}, {2, 4, 16}});
+BENCHMARK(BM_BlockSmoothSSE)->ArgsProduct({{2048, 4096}, {2, 4, 16}});
+
+#ifdef CARTA_X86_SIMD
+static void BM_BlockSmoothAVX(benchmark::State& state) {
+    if (carta::GetSimdLevel() < carta::SimdLevel::Avx) {
+        state.SkipWithError("AVX is not supported by this CPU");
+        return;
+    }
+    BlockSmoothBenchmark(state, BlockSmoothAVX);
+}
+BENCHMARK(BM_BlockSmoothAVX)->ArgsProduct({{2048, 4096}, {2, 4, 16}});
+#endif
+
+// Arguments: image size, downsampling factor
+static void BM_NearestNeighbor(benchmark::State& state) {
+    int64_t size = state.range(0);
+    int factor = state.range(1);
+    auto& image = BenchmarkImages::Synthetic(size, size, 0.05);
+    int64_t dest_size = size / factor;
+    vector<float> dest(dest_size * dest_size);
+    for (auto _ : state) {
+        NearestNeighbor(image.data(), dest.data(), size, dest_size, dest_size, 0, 0, factor);
+        benchmark::DoNotOptimize(dest.data());
+    }
+    state.SetItemsProcessed(state.iterations() * dest_size * dest_size);
+}
+BENCHMARK(BM_NearestNeighbor)->ArgsProduct({{2048, 4096}, {2, 4, 16}});
+
+// Arguments: image size, smoothing factor; larger factors use the recursive filter
+static void BM_GaussianSmooth(benchmark::State& state) {
+    int64_t size = state.range(0);
+    int factor = state.range(1);
+    auto& image = BenchmarkImages::Synthetic(size, size, 0.05);
+    int64_t dest_size = size - 2 * (factor - 1);
+    vector<float> dest(dest_size * dest_size);
+    for (auto _ : state) {
+        GaussianSmooth(image.data(), dest.data(), size, size, dest_size, dest_size, factor);
+        benchmark::DoNotOptimize(dest.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_GaussianSmooth)->ArgsProduct({{1024, 2048}, {2, 4, 8, 24}})->Unit(benchmark::kMillisecond);
+
+// Arguments: precision; tiles are 256 x 256
+static void BM_Compress(benchmark::State& state) {
+    uint32_t precision = state.range(0);
+    auto& tile = BenchmarkImages::Synthetic(TILE_SIZE, TILE_SIZE, 0.05);
+    vector<char> buffer;
+    size_t compressed_size(0);
+    for (auto _ : state) {
+        // Compression replaces NaNs in the tile, so each iteration compresses a copy
+        state.PauseTiming();
+        vector<float> data(tile);
+        state.ResumeTiming();
+        Compress(data, 0, buffer, compressed_size, TILE_SIZE, TILE_SIZE, precision);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * TILE_SIZE * TILE_SIZE * sizeof(float));
+    state.counters["ratio"] = (double)(TILE_SIZE * TILE_SIZE * sizeof(float)) / compressed_size;
+}
+BENCHMARK(BM_Compress)->Arg(8)->Arg(12)->Arg(16)->Arg(24)->Arg(32);
+
+// Arguments: fraction of NaNs in percent
+static void BM_GetNanEncodingsBlock(benchmark::State& state) {
+    auto& tile = BenchmarkImages::Synthetic(TILE_SIZE, TILE_SIZE, state.range(0) / 100.0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        vector<float> data(tile);
+        state.ResumeTiming();
+        auto encodings = GetNanEncodingsBlock(data, 0, TILE_SIZE, TILE_SIZE);
+        benchmark::DoNotOptimize(encodings.data());
+    }
+    state.SetItemsProcessed(state.iterations() * TILE_SIZE * TILE_SIZE);
+}
+BENCHMARK(BM_GetNanEncodingsBlock)->Arg(0)->Arg(5)->Arg(50);
+
+// Arguments: image size, number of levels
+static void BM_TraceContours(benchmark::State& state) {
+    int64_t size = state.range(0);
+    int num_levels = state.range(1);
+    auto& image = BenchmarkImages::Smooth(size, size);
+    vector<double> levels;
+    for (int i = 0; i < num_levels; ++i) {
+        levels.push_back(-1.0 + 2.0 * (i + 1) / (num_levels + 1));
+    }
+    ContourCallback callback = [](double, double, const vector<float>&, const vector<int32_t>&) {};
+    for (auto _ : state) {
+        vector<vector<float>> vertex_data;
+        vector<vector<int32_t>> index_data;
+        TraceContours(image.data(), size, size, 1.0, 0.0, levels, vertex_data, index_data, 100000, callback);
+        benchmark::DoNotOptimize(vertex_data.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size * size * num_levels);
+}
+BENCHMARK(BM_TraceContours)->ArgsProduct({{1024, 4096}, {1, 10}})->Unit(benchmark::kMillisecond);
+
+static void BM_TileEncode(benchmark::State& state) {
+    for (auto _ : state) {
+        int32_t sum(0);
+        for (int32_t layer = 0; layer <= 12; ++layer) {
+            int32_t width = 1 << std::min(layer, 6);
+            for (int32_t y = 0; y < width; ++y) {
+                for (int32_t x = 0; x < width; ++x) {
+                    sum += Tile::Encode(x, y, layer);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_TileEncode);
+
+static void BM_TileDecode(benchmark::State& state) {
+    vector<int32_t> encoded;
+    for (int32_t layer = 0; layer <= 12; ++layer) {
+        int32_t width = 1 << std::min(layer, 6);
+        for (int32_t y = 0; y < width; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                encoded.push_back(Tile::Encode(x, y, layer));
+            }
+        }
+    }
+    for (auto _ : state) {
+        int32_t sum(0);
+        for (auto value : encoded) {
+            auto tile = Tile::Decode(value);
+            sum += tile.x + tile.y + tile.layer;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_TileDecode);
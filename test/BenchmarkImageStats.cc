@@ -0,0 +1,78 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkImages.h"
+#include "ImageData/FileLoader.h"
+#include "ImageStats/Histogram.h"
+#include "ImageStats/StatsCalculator.h"
+
+using namespace std;
+
+// Arguments: image size
+static void BM_CalcBasicStats(benchmark::State& state) {
+    int64_t size = state.range(0);
+    auto& image = BenchmarkImages::Synthetic(size, size, 0.05);
+    for (auto _ : state) {
+        carta::BasicStats<float> stats;
+        CalcBasicStats(image, stats);
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_CalcBasicStats)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+// Arguments: image size, number of bins
+static void BM_HistogramFill(benchmark::State& state) {
+    int64_t size = state.range(0);
+    int num_bins = state.range(1);
+    auto& image = BenchmarkImages::Synthetic(size, size, 0.05);
+    carta::BasicStats<float> stats;
+    CalcBasicStats(image, stats);
+    for (auto _ : state) {
+        carta::Histogram histogram(num_bins, stats.min_val, stats.max_val, image);
+        benchmark::DoNotOptimize(histogram);
+    }
+    state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_HistogramFill)->ArgsProduct({{1024, 4096}, {64, 4096}})->Unit(benchmark::kMillisecond);
+
+// Reads the test image through its loader and calculates its statistics and histogram, as for a new channel
+static void BM_TestImageStats(benchmark::State& state) {
+    unique_ptr<carta::FileLoader> loader(carta::FileLoader::GetLoader(BenchmarkImages::DataPath("images/fits/M17_SWex_unittest.fits")));
+    if (!loader) {
+        state.SkipWithError("Test image not found");
+        return;
+    }
+    loader->OpenFile("0");
+    casacore::IPosition shape;
+    if (!loader->GetShape(shape)) {
+        state.SkipWithError("Test image could not be opened");
+        return;
+    }
+    casacore::IPosition start(shape.size(), 0);
+    casacore::IPosition length(shape);
+    for (size_t i = 2; i < shape.size(); ++i) {
+        length(i) = 1; // first plane
+    }
+    casacore::Slicer slicer(start, length);
+
+    for (auto _ : state) {
+        casacore::Array<float> data;
+        loader->GetSlice(data, slicer);
+        vector<float> plane = data.tovector();
+        carta::BasicStats<float> stats;
+        CalcBasicStats(plane, stats);
+        carta::Histogram histogram(sqrt(plane.size()), stats.min_val, stats.max_val, plane);
+        benchmark::DoNotOptimize(histogram);
+    }
+    state.SetItemsProcessed(state.iterations() * length.product());
+}
+BENCHMARK(BM_TestImageStats);
@@ -0,0 +1,76 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#ifndef CARTA_BACKEND_TEST_BENCHMARKIMAGES_H_
+#define CARTA_BACKEND_TEST_BENCHMARKIMAGES_H_
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Util.h"
+
+#ifdef _BOOST_FILESYSTEM_
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+// Images shared by the benchmarks, made once per size with a fixed seed so that runs are comparable
+class BenchmarkImages {
+public:
+    // Gaussian noise with a fraction of NaNs
+    static const std::vector<float>& Synthetic(int64_t width, int64_t height, double nan_fraction) {
+        static std::map<std::tuple<int64_t, int64_t, double>, std::vector<float>> images;
+        auto& image = images[{width, height, nan_fraction}];
+        if (image.empty()) {
+            std::mt19937 mt(width * 31 + height);
+            std::normal_distribution<float> noise(0.0f, 1.0f);
+            std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+            image.resize(width * height);
+            for (auto& value : image) {
+                value = uniform(mt) < nan_fraction ? NAN : noise(mt);
+            }
+        }
+        return image;
+    }
+
+    // Overlapping waves in [-1, 1] with a little noise, so that contours are long lines rather than noise
+    static const std::vector<float>& Smooth(int64_t width, int64_t height) {
+        static std::map<std::tuple<int64_t, int64_t>, std::vector<float>> images;
+        auto& image = images[{width, height}];
+        if (image.empty()) {
+            std::mt19937 mt(width * 31 + height);
+            std::normal_distribution<float> noise(0.0f, 0.02f);
+            image.resize(width * height);
+            for (int64_t y = 0; y < height; ++y) {
+                for (int64_t x = 0; x < width; ++x) {
+                    image[y * width + x] = 0.5f * (sin(x * 0.02) * cos(y * 0.015) + sin((x + y) * 0.005)) + noise(mt);
+                }
+            }
+        }
+        return image;
+    }
+
+    // Path of a file in the test data folder, which is copied next to the executable
+    static std::string DataPath(const std::string& relative_path) {
+        std::string path_string;
+        fs::path path;
+        if (FindExecutablePath(path_string)) {
+            path = fs::path(path_string).parent_path();
+        } else {
+            path = fs::current_path();
+        }
+        return (path / "data" / relative_path).string();
+    }
+};
+
+#endif // CARTA_BACKEND_TEST_BENCHMARKIMAGES_H_
@@ -0,0 +1,99 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include "BenchmarkImages.h"
+#include "Table/Table.h"
+
+using namespace std;
+using namespace carta;
+
+// Catalogue of random sources written as a VOTable once per size, since the test tables have only a few rows
+static const Table& SyntheticTable(int64_t num_rows) {
+    static map<int64_t, unique_ptr<Table>> tables;
+    auto& table = tables[num_rows];
+    if (!table) {
+        auto filename = (fs::temp_directory_path() / fmt::format("carta_benchmark_{}.xml", num_rows)).string();
+        ofstream file(filename);
+        file << R"(<?xml version="1.0" encoding="UTF-8"?>
+<VOTABLE version="1.4" xmlns="http://www.ivoa.net/xml/VOTable/v1.3">
+<RESOURCE><TABLE>
+<FIELD name="RA" ID="col1" datatype="double" unit="deg"/>
+<FIELD name="Dec" ID="col2" datatype="double" unit="deg"/>
+<FIELD name="Name" ID="col3" datatype="char" arraysize="*"/>
+<FIELD name="Flux" ID="col4" datatype="float" unit="Jy"/>
+<DATA><TABLEDATA>
+)";
+        mt19937 mt(num_rows);
+        uniform_real_distribution<double> ra(0.0, 360.0), dec(-90.0, 90.0);
+        exponential_distribution<float> flux(1.0f);
+        for (int64_t i = 0; i < num_rows; ++i) {
+            file << fmt::format(
+                "<TR><TD>{:.6f}</TD><TD>{:.6f}</TD><TD>J{:07d}</TD><TD>{:.4f}</TD></TR>\n", ra(mt), dec(mt), mt() % 10000000, flux(mt));
+        }
+        file << "</TABLEDATA></DATA></TABLE></RESOURCE></VOTABLE>\n";
+        file.close();
+        table = make_unique<Table>(filename);
+        fs::remove(filename);
+    }
+    return *table;
+}
+
+// Arguments: number of rows
+static void BM_TableNumericFilter(benchmark::State& state) {
+    auto& table = SyntheticTable(state.range(0));
+    for (auto _ : state) {
+        auto view = table.View();
+        view.NumericFilter(table["RA"], CARTA::RangeClosed, 100.0, 200.0);
+        benchmark::DoNotOptimize(view.NumRows());
+    }
+    state.SetItemsProcessed(state.iterations() * table.NumRows());
+}
+BENCHMARK(BM_TableNumericFilter)->Arg(10000)->Arg(1000000);
+
+static void BM_TableStringFilter(benchmark::State& state) {
+    auto& table = SyntheticTable(state.range(0));
+    for (auto _ : state) {
+        auto view = table.View();
+        view.StringFilter(table["Name"], "J12", true);
+        benchmark::DoNotOptimize(view.NumRows());
+    }
+    state.SetItemsProcessed(state.iterations() * table.NumRows());
+}
+BENCHMARK(BM_TableStringFilter)->Arg(10000)->Arg(1000000);
+
+// Arguments: number of rows, sort a string (1) or numeric (0) column
+static void BM_TableSort(benchmark::State& state) {
+    auto& table = SyntheticTable(state.range(0));
+    auto column = state.range(1) ? table["Name"] : table["Flux"];
+    for (auto _ : state) {
+        auto view = table.View();
+        view.SortByColumn(column);
+        benchmark::DoNotOptimize(view.NumRows());
+    }
+    state.SetItemsProcessed(state.iterations() * table.NumRows());
+}
+BENCHMARK(BM_TableSort)->ArgsProduct({{10000, 1000000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// Filter then sort, as for a catalogue request from the frontend
+static void BM_TableFilterSort(benchmark::State& state) {
+    auto& table = SyntheticTable(state.range(0));
+    for (auto _ : state) {
+        auto view = table.View();
+        view.NumericFilter(table["Dec"], CARTA::GreaterOrEqual, 0.0);
+        view.SortByColumn(table["Flux"], false);
+        benchmark::DoNotOptimize(view.NumRows());
+    }
+    state.SetItemsProcessed(state.iterations() * table.NumRows());
+}
+BENCHMARK(BM_TableFilterSort)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
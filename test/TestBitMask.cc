@@ -0,0 +1,57 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <vector>
+
+#include <casacore/casa/Arrays/ArrayLogical.h>
+#include <gtest/gtest.h>
+
+#include "ImageStats/BitMask.h"
+
+using namespace carta;
+
+TEST(BitMaskTest, SetRangeAcrossWords) {
+    BitMask mask(casacore::IPosition(2, 100, 3));
+    mask.SetRange(60, 200);
+    mask.SetRange(250, 251);
+    EXPECT_EQ(mask.Count(), (size_t)141);
+    EXPECT_FALSE(mask.Get(59));
+    EXPECT_TRUE(mask.Get(60));
+    EXPECT_TRUE(mask.Get(199));
+    EXPECT_FALSE(mask.Get(200));
+    EXPECT_TRUE(mask.Get(250));
+
+    std::vector<size_t> set;
+    mask.ForEachSet(190, 300, [&](size_t index) { set.push_back(index); });
+    std::vector<size_t> expected = {190, 191, 192, 193, 194, 195, 196, 197, 198, 199, 250};
+    EXPECT_EQ(set, expected);
+}
+
+TEST(BitMaskTest, FullMaskHasNoBitsPastTheEnd) {
+    BitMask mask(casacore::IPosition(3, 7, 5, 3), true);
+    EXPECT_EQ(mask.Count(), (size_t)105);
+    EXPECT_EQ(mask.Words().size(), (size_t)2);
+}
+
+TEST(BitMaskTest, ArrayConversionsAndSlices) {
+    casacore::IPosition shape(3, 10, 4, 3);
+    casacore::Array<bool> array(shape);
+    for (size_t i = 0; i < array.nelements(); ++i) {
+        array.data()[i] = (i % 3 == 0) || (i % 7 == 0);
+    }
+
+    BitMask mask = BitMask::FromArray(array);
+    EXPECT_TRUE(casacore::allEQ(mask.ToArray(), array));
+
+    casacore::Slicer section(casacore::IPosition(3, 1, 1, 1), casacore::IPosition(3, 4, 2, 2), casacore::IPosition(3, 2, 1, 1));
+    casacore::Array<bool> slice;
+    mask.GetSlice(slice, section);
+    EXPECT_TRUE(casacore::allEQ(slice, array(section)));
+
+    BitMaskLattice lattice(std::make_shared<BitMask>(mask));
+    EXPECT_EQ(lattice.shape(), shape);
+    EXPECT_TRUE(casacore::allEQ(lattice.getSlice(section), array(section)));
+}
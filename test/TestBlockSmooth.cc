@@ -4,6 +4,7 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <cmath>
 #include <random>
 #include <vector>
 
@@ -11,6 +12,8 @@
 #include <casa/Arrays/Matrix.h>
 #include <gtest/gtest.h>
 
+#include "DataStream/CompactPlane.h"
+#include "DataStream/MipPyramid.h"
 #include "DataStream/Smoothing.h"
 
 #ifdef COMPILE_PERFORMANCE_TESTS
@@ -27,6 +30,9 @@
 #define NUM_ITERS 10
 #define MAX_DOWNSAMPLE_FACTOR 256
 
+// The recursive Gaussian has no kernel cutoff, so it differs slightly from the kernel version
+#define MAX_GAUSSIAN_ERROR 5.0e-2f
+
 typedef casacore::Matrix<float> Matrix2F;
 
 using namespace std;
@@ -64,6 +70,18 @@ public:
         return std::move(m);
     }
 
+    // Smooth field of amplitude 1, so that the Gaussian versions are compared rather than the noise they remove
+    Matrix2F SmoothMatrix(size_t rows, size_t columns, float nan_fraction) {
+        Matrix2F m(rows, columns);
+        float* data = m.data();
+        for (auto y = 0; y < rows; y++) {
+            for (auto x = 0; x < columns; x++) {
+                data[y * columns + x] = float_random(mt) < nan_fraction ? NAN : sin(x / 40.0) * cos(y / 50.0);
+            }
+        }
+        return std::move(m);
+    }
+
     bool IsNAN(const Matrix2F& m) {
         for (auto i = 0; i < m.nrow(); i++) {
             for (auto j = 0; j < m.ncolumn(); j++) {
@@ -134,7 +152,18 @@ public:
         return std::move(scalar_result);
     }
 
-#ifdef __AVX__
+    Matrix2F GaussianSmoothTile(const Matrix2F& m, int smoothing_factor, bool recursive) {
+        int apron = smoothing_factor - 1;
+        Matrix2F result(m.nrow() - 2 * apron, m.ncolumn() - 2 * apron);
+        if (recursive) {
+            RecursiveGaussianSmooth(m.data(), result.data(), m.ncolumn(), m.nrow(), result.ncolumn(), result.nrow(), smoothing_factor);
+        } else {
+            KernelGaussianSmooth(m.data(), result.data(), m.ncolumn(), m.nrow(), result.ncolumn(), result.nrow(), smoothing_factor);
+        }
+        return std::move(result);
+    }
+
+#ifdef CARTA_X86_SIMD
     Matrix2F DownsampleTileAVX(const Matrix2F& m, int downsample_factor) {
         int result_rows = ceil(m.nrow() / (float)(downsample_factor));
         int result_columns = ceil(m.ncolumn() / (float)(downsample_factor));
@@ -186,6 +215,98 @@ TEST_F(BlockSmoothingTest, TestSSEAccuracy) {
     }
 }
 
+TEST_F(BlockSmoothingTest, TestMipPyramidAccuracy) {
+    for (auto nan_fraction : nan_fractions) {
+        for (auto i = 0; i < NUM_ITERS; i++) {
+            auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
+            MipPyramid pyramid;
+            pyramid.Reset(m1.ncolumn(), m1.nrow());
+            for (auto j = MIP_PYRAMID_BASE_MIP; j <= MAX_DOWNSAMPLE_FACTOR; j *= 2) {
+                auto smoothed_scalar = DownsampleTileScalar(m1, j);
+                Matrix2F smoothed_pyramid(smoothed_scalar.nrow(), smoothed_scalar.ncolumn());
+                ASSERT_TRUE(pyramid.BlockMean(
+                    m1.data(), smoothed_pyramid.data(), smoothed_pyramid.ncolumn(), smoothed_pyramid.nrow(), 0, 0, j));
+                Matrix2F abs_diff = abs(smoothed_scalar - smoothed_pyramid);
+                auto sum_error = nansum(abs_diff);
+                auto max_error = nanmax(abs_diff);
+                EXPECT_EQ(MatchingNANs(smoothed_scalar, smoothed_pyramid), true);
+                if (isfinite(sum_error)) {
+                    EXPECT_LE(sum_error, MAX_SUM_ERROR);
+                    EXPECT_LE(max_error, MAX_ABS_ERROR);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(BlockSmoothingTest, TestCompactPlaneAccuracy) {
+    for (auto nan_fraction : nan_fractions) {
+        auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
+        std::vector<float> values(m1.data(), m1.data() + m1.size());
+        CompactPlane plane(values);
+        EXPECT_LE(plane.MemoryUsage(), values.size() * sizeof(float) * 0.6);
+
+        // Decoded from an unaligned start; values are in [-0.5, 0.5), so the error is at most half of 1/65535
+        Matrix2F decoded(m1.nrow(), m1.ncolumn());
+        plane.Decode(0, 3, decoded.data());
+        plane.Decode(3, values.size() - 3, decoded.data() + 3);
+        EXPECT_EQ(MatchingNANs(m1, decoded), true);
+        Matrix2F abs_diff = abs(m1 - decoded);
+        auto max_error = nanmax(abs_diff);
+        if (isfinite(max_error)) {
+            EXPECT_LE(max_error, 1.0f / 131070 + 1.0e-7f);
+        }
+        for (size_t i = 0; i < values.size(); i += 97) {
+            float value = plane.Value(i);
+            EXPECT_TRUE(isfinite(values[i]) ? fabs(value - decoded.data()[i]) < 1.0e-7f : isnan(value));
+        }
+    }
+}
+
+TEST_F(BlockSmoothingTest, TestRecursiveGaussianAccuracy) {
+    for (auto nan_fraction : {0.0f, 0.1f, 0.5f}) {
+        auto m1 = SmoothMatrix(size_random(mt), size_random(mt), nan_fraction);
+        for (auto smoothing_factor : {GAUSSIAN_IIR_MIN_SMOOTHING_FACTOR, 24}) {
+            auto smoothed_kernel = GaussianSmoothTile(m1, smoothing_factor, false);
+            auto smoothed_recursive = GaussianSmoothTile(m1, smoothing_factor, true);
+            Matrix2F abs_diff = abs(smoothed_kernel - smoothed_recursive);
+            EXPECT_EQ(MatchingNANs(smoothed_kernel, smoothed_recursive), true);
+            EXPECT_LE(nanmax(abs_diff), MAX_GAUSSIAN_ERROR);
+        }
+    }
+}
+
+TEST_F(BlockSmoothingTest, TestMinMaxEnvelope) {
+    for (auto nan_fraction : nan_fractions) {
+        auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
+        int64_t width = m1.ncolumn();
+        int64_t height = m1.nrow();
+        for (auto num_bins : {1, 7, 100}) {
+            // Column profile, read with the row stride
+            std::vector<float> envelope;
+            MinMaxEnvelope(m1.data() + 3, width, height, num_bins, envelope);
+            ASSERT_EQ(envelope.size(), (size_t)(2 * num_bins));
+            for (auto bin = 0; bin < num_bins; bin++) {
+                float min_val = std::numeric_limits<float>::max();
+                float max_val = std::numeric_limits<float>::lowest();
+                for (auto i = bin * height / num_bins; i < (bin + 1) * height / num_bins; i++) {
+                    float val = m1.data()[i * width + 3];
+                    if (isfinite(val)) {
+                        min_val = min(min_val, val);
+                        max_val = max(max_val, val);
+                    }
+                }
+                if (min_val > max_val) {
+                    EXPECT_TRUE(isnan(envelope[2 * bin]) && isnan(envelope[2 * bin + 1]));
+                } else {
+                    EXPECT_EQ(min(envelope[2 * bin], envelope[2 * bin + 1]), min_val);
+                    EXPECT_EQ(max(envelope[2 * bin], envelope[2 * bin + 1]), max_val);
+                }
+            }
+        }
+    }
+}
+
 #ifdef COMPILE_PERFORMANCE_TESTS
 TEST_F(BlockSmoothingTest, TestSSEPerformance) {
     Timer t;
@@ -207,9 +328,12 @@ TEST_F(BlockSmoothingTest, TestSSEPerformance) {
 }
 #endif
 
-#ifdef __AVX__
+#ifdef CARTA_X86_SIMD
 
 TEST_F(BlockSmoothingTest, TestAVXAccuracy) {
+    if (carta::GetSimdLevel() < carta::SimdLevel::Avx) {
+        GTEST_SKIP() << "AVX is not supported by this CPU";
+    }
     for (auto nan_fraction : nan_fractions) {
         for (auto i = 0; i < NUM_ITERS; i++) {
             auto m1 = RandomMatrix(size_random(mt), size_random(mt), nan_fraction);
@@ -232,6 +356,9 @@ TEST_F(BlockSmoothingTest, TestAVXAccuracy) {
 
 #ifdef COMPILE_PERFORMANCE_TESTS
 TEST_F(BlockSmoothingTest, TestAVXPerformance) {
+    if (carta::GetSimdLevel() < carta::SimdLevel::Avx) {
+        GTEST_SKIP() << "AVX is not supported by this CPU";
+    }
     Timer t;
     for (auto i = 0; i < NUM_ITERS; i++) {
         auto m1 = RandomMatrix(size_random(mt), size_random(mt), 0);
@@ -0,0 +1,79 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Constants.h"
+#include "ImageData/ComputedStokes.h"
+
+#define MAX_ABS_ERROR 1.0e-4
+
+using namespace carta;
+
+class ComputedStokesTest : public ::testing::Test {
+public:
+    // Odd length so that the vector kernels also leave values for the scalar loop
+    static constexpr size_t length = 21;
+
+    void SetUp() override {
+        for (size_t n = 0; n < length; ++n) {
+            i.push_back(10.0 + n);
+            q.push_back(1.0 - 0.2 * n);
+            u.push_back(0.5 + 0.1 * n);
+            v.push_back(-0.3 * n);
+        }
+        q[7] = NAN;
+    }
+
+    std::vector<float> Compute(int stokes, const std::vector<const float*>& components) {
+        std::vector<float> result(length);
+        ComputeStokes(stokes, components, result.data(), length);
+        return result;
+    }
+
+    std::vector<float> i, q, u, v;
+};
+
+TEST_F(ComputedStokesTest, Components) {
+    EXPECT_TRUE(IsComputedStokes(COMPUTE_STOKES_PTOTAL));
+    EXPECT_TRUE(IsComputedStokes(COMPUTE_STOKES_PANGLE));
+    EXPECT_FALSE(IsComputedStokes(0));
+    EXPECT_EQ(ComputedStokesComponents(COMPUTE_STOKES_PFLINEAR).size(), 3);
+    EXPECT_TRUE(ComputedStokesComponents(0).empty());
+
+    int stokes;
+    ASSERT_TRUE(ComputedStokesCoordinate("Panglez", stokes));
+    EXPECT_EQ(stokes, COMPUTE_STOKES_PANGLE);
+    EXPECT_FALSE(ComputedStokesCoordinate("Iz", stokes));
+}
+
+TEST_F(ComputedStokesTest, PolarizedIntensity) {
+    auto ptotal = Compute(COMPUTE_STOKES_PTOTAL, {q.data(), u.data(), v.data()});
+    auto pflinear = Compute(COMPUTE_STOKES_PFLINEAR, {i.data(), q.data(), u.data()});
+    for (size_t n = 0; n < length; ++n) {
+        if (n == 7) {
+            EXPECT_TRUE(std::isnan(ptotal[n]));
+            EXPECT_TRUE(std::isnan(pflinear[n]));
+            continue;
+        }
+        EXPECT_NEAR(ptotal[n], std::sqrt(q[n] * q[n] + u[n] * u[n] + v[n] * v[n]), MAX_ABS_ERROR);
+        EXPECT_NEAR(pflinear[n], 100.0 * std::sqrt(q[n] * q[n] + u[n] * u[n]) / i[n], MAX_ABS_ERROR);
+    }
+}
+
+TEST_F(ComputedStokesTest, PolarizationAngle) {
+    auto pangle = Compute(COMPUTE_STOKES_PANGLE, {q.data(), u.data()});
+    for (size_t n = 0; n < length; ++n) {
+        if (n == 7) {
+            EXPECT_TRUE(std::isnan(pangle[n]));
+            continue;
+        }
+        EXPECT_NEAR(pangle[n], std::atan2(u[n], q[n]) * 90.0 / M_PI, MAX_ABS_ERROR);
+    }
+}
@@ -5,6 +5,9 @@
 */
 #include <gtest/gtest.h>
 
+#include <numeric>
+
+#include "Table/PositionIndex.h"
 #include "Table/Table.h"
 #include "Util.h"
 
@@ -267,6 +270,47 @@ TEST_F(FitsTableTest, NumericFilterRange) {
     EXPECT_EQ(view.NumRows(), 0);
 }
 
+TEST_F(FitsTableTest, BitmapFilterMatchesIndexFilter) {
+    Table table(ImagePath("ivoa_example.fits"));
+
+    auto view = table.View();
+    view.NumericFilter(table["RA"], CARTA::GreaterOrEqual, 11);
+    view.StringFilter(table["Name"], "n 6744", true);
+
+    auto numeric_bitmap = make_shared<SelectionBitmap>();
+    SelectionBitmap string_bitmap;
+    EXPECT_TRUE(table["RA"]->FilterBitmap(*numeric_bitmap, CARTA::GreaterOrEqual, 11));
+    EXPECT_TRUE(table["Name"]->StringFilterBitmap(string_bitmap, "n 6744", true));
+    EXPECT_FALSE(table["Name"]->FilterBitmap(string_bitmap, CARTA::GreaterOrEqual, 11));
+    EXPECT_EQ(numeric_bitmap->Count(), 2);
+    numeric_bitmap->And(string_bitmap);
+
+    auto bitmap_view = table.View();
+    bitmap_view.SetSelection(numeric_bitmap);
+    EXPECT_EQ(bitmap_view.NumRows(), view.NumRows());
+    EXPECT_EQ(bitmap_view.Values<string>(table["Name"]), view.Values<string>(table["Name"]));
+    EXPECT_EQ(bitmap_view.Values<float>(table["RA"]), view.Values<float>(table["RA"]));
+}
+
+TEST_F(FitsTableTest, PositionIndexMatchesRangeFilters) {
+    Table table(ImagePath("ivoa_example.fits"));
+
+    vector<double> ra, dec;
+    EXPECT_TRUE(table["RA"]->NumericValues(ra));
+    EXPECT_TRUE(table["Dec"]->NumericValues(dec));
+    EXPECT_FALSE(table["Name"]->NumericValues(ra));
+    PositionIndex index(ra, dec);
+    EXPECT_EQ(index.NumRows(), 3);
+
+    auto view = table.View();
+    view.NumericFilter(table["RA"], CARTA::RangeClosed, 11, 300);
+    view.NumericFilter(table["Dec"], CARTA::RangeClosed, -90, 0);
+    SelectionBitmap bitmap;
+    index.Select(11, 300, -90, 0, bitmap);
+    EXPECT_EQ(bitmap.Count(), view.NumRows());
+    EXPECT_EQ(bitmap.Indices(), IndexList(1, 1));
+}
+
 TEST_F(FitsTableTest, FailSortMissingColummn) {
     Table table(ImagePath("ivoa_example.fits"));
 
@@ -308,6 +352,23 @@ TEST_F(FitsTableTest, SortNumericSubset) {
     EXPECT_FLOAT_EQ(vals[1], 287.43f);
 }
 
+TEST_F(FitsTableTest, SortSubsetByPermutation) {
+    Table table(ImagePath("ivoa_example.fits"));
+
+    IndexList permutation(table.NumRows());
+    iota(permutation.begin(), permutation.end(), 0);
+    table["RA"]->SortIndices(permutation, false);
+
+    auto view = table.View();
+    EXPECT_FALSE(view.SortByPermutation(IndexList(1, 0)));
+    view.NumericFilter(table["RA"], CARTA::RangeClosed, 11, 300);
+    EXPECT_TRUE(view.SortByPermutation(permutation));
+    auto vals = view.Values<float>(table["RA"]);
+    ASSERT_EQ(vals.size(), 2);
+    EXPECT_FLOAT_EQ(vals[0], 287.43f);
+    EXPECT_FLOAT_EQ(vals[1], 23.48f);
+}
+
 TEST_F(FitsTableTest, SortStringAscending) {
     Table table(ImagePath("ivoa_example.fits"));
 
@@ -368,4 +429,26 @@ TEST_F(FitsTableTest, CorrectScalarData) {
     EXPECT_FLOAT_EQ(scalar2_vals[0], 2.0f);
     EXPECT_FLOAT_EQ(scalar2_vals[1], 4.0f);
     EXPECT_FLOAT_EQ(scalar2_vals[2], 6.0f);
-}
\ No newline at end of file
+}
+TEST_F(FitsTableTest, MappedColumnsMatchCopiedColumns) {
+    Table table(ImagePath("ivoa_example.fits"));
+    Table mapped_table(ImagePath("ivoa_example.fits"), false, true);
+    EXPECT_TRUE(mapped_table.IsValid());
+    EXPECT_EQ(mapped_table.NumRows(), table.NumRows());
+    EXPECT_EQ(mapped_table["RA"]->NumEntries(), 3);
+    EXPECT_TRUE(DataColumn<float>::TryCast(mapped_table["RA"])->entries.empty());
+
+    auto view = table.View();
+    auto mapped_view = mapped_table.View();
+    EXPECT_EQ(mapped_view.Values<float>(mapped_table["RA"]), view.Values<float>(table["RA"]));
+    EXPECT_EQ(mapped_view.Values<int16_t>(mapped_table["e_RVel"]), view.Values<int16_t>(table["e_RVel"]));
+    EXPECT_EQ(mapped_view.Values<string>(mapped_table["Name"]), view.Values<string>(table["Name"]));
+
+    view.NumericFilter(table["RA"], CARTA::GreaterOrEqual, 11);
+    mapped_view.NumericFilter(mapped_table["RA"], CARTA::GreaterOrEqual, 11);
+    EXPECT_EQ(mapped_view.NumRows(), 2);
+    EXPECT_TRUE(view.SortByColumn(table["RA"], false));
+    EXPECT_TRUE(mapped_view.SortByColumn(mapped_table["RA"], false));
+    EXPECT_EQ(mapped_view.Values<float>(mapped_table["RA"]), view.Values<float>(table["RA"]));
+    EXPECT_EQ(mapped_view.Values<string>(mapped_table["Name"]), view.Values<string>(table["Name"]));
+}
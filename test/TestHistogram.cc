@@ -4,12 +4,21 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <random>
 #include <vector>
 
+#include <casacore/casa/Arrays/ArrayLogical.h>
+#include <casacore/coordinates/Coordinates/CoordinateUtil.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/lattices/Lattices/ArrayLattice.h>
 #include <gtest/gtest.h>
 
 #include "ImageStats/Histogram.h"
+#include "ImageStats/QuantileSketch.h"
+#include "ImageStats/StatsCalculator.h"
 #include "Threading.h"
 
 #ifdef COMPILE_PERFORMANCE_TESTS
@@ -114,6 +123,20 @@ TEST_F(HistogramTest, TestHistogramAdd) {
     EXPECT_FALSE(hist.Add(hist3));
 }
 
+TEST_F(HistogramTest, TestHistogramRebin) {
+    std::vector<float> data(1024 * 1024);
+    std::for_each(data.begin(), data.end(), [&](float& v) { v = float_random(mt); });
+    carta::Histogram fine(1024, 0.0f, 1.0f, data);
+    carta::Histogram coarse(256, 0.0f, 1.0f, data);
+    carta::Histogram rebinned;
+    EXPECT_TRUE(fine.Rebin(256, rebinned));
+    EXPECT_TRUE(CompareResults(coarse, rebinned));
+    EXPECT_FLOAT_EQ(rebinned.GetBinWidth(), coarse.GetBinWidth());
+    EXPECT_FLOAT_EQ(rebinned.GetBinCenter(), coarse.GetBinCenter());
+    EXPECT_FALSE(fine.Rebin(300, rebinned));
+    EXPECT_FALSE(fine.Rebin(0, rebinned));
+}
+
 TEST_F(HistogramTest, TestSingleThreading) {
     std::vector<float> data(1024 * 1024);
     for (auto& v : data) {
@@ -141,6 +164,107 @@ TEST_F(HistogramTest, TestMultithreading) {
         EXPECT_TRUE(CompareResults(hist_st, hist_mt));
     }
 }
+
+TEST_F(HistogramTest, TestFusedStatsAndHistogram) {
+    std::vector<float> data(FUSED_HISTOGRAM_MIN_PIXELS);
+    std::normal_distribution<float> normal_random(0.0f, 1.0f);
+    for (auto i = 0; i < data.size(); i++) {
+        data[i] = (i % 1000 == 0) ? NAN : normal_random(mt);
+    }
+    // Bright values which the sampled range is likely to miss
+    for (auto i = 0; i < 100; i++) {
+        data[(i * 7919) % data.size()] = 50.0f + i;
+    }
+
+    BasicStats<float> stats, fused_stats;
+    CalcBasicStats(data, stats);
+    carta::Histogram hist = CalcHistogram(1024, stats, data);
+    carta::Histogram fused_hist;
+    CalcStatsAndHistogram(data, 1024, fused_stats, fused_hist);
+
+    EXPECT_EQ(fused_stats.num_pixels, stats.num_pixels);
+    EXPECT_EQ(fused_stats.min_val, stats.min_val);
+    EXPECT_EQ(fused_stats.max_val, stats.max_val);
+    EXPECT_NEAR(fused_stats.mean, stats.mean, 1e-9);
+    EXPECT_NEAR(fused_stats.stdDev, stats.stdDev, 1e-9);
+    EXPECT_EQ(fused_hist.GetNbins(), hist.GetNbins());
+    EXPECT_EQ(fused_hist.GetMinVal(), hist.GetMinVal());
+    EXPECT_EQ(fused_hist.GetMaxVal(), hist.GetMaxVal());
+
+    // Interpolated bins are close, and keep the total count
+    const auto& bins = hist.GetHistogramBins();
+    const auto& fused_bins = fused_hist.GetHistogramBins();
+    EXPECT_EQ(accumulate(fused_bins.begin(), fused_bins.end(), 0), accumulate(bins.begin(), bins.end(), 0));
+    for (auto i = 0; i < bins.size(); i++) {
+        EXPECT_LE(abs(fused_bins[i] - bins[i]), std::max(bins[i] / 100, 10));
+    }
+}
+
+TEST_F(HistogramTest, TestQuantileSketch) {
+    std::vector<float> data(1000000);
+    std::normal_distribution<float> normal_random(0.0f, 1.0f);
+    for (auto i = 0; i < data.size(); i++) {
+        data[i] = (i % 1000 == 0) ? NAN : normal_random(mt);
+    }
+
+    // Sketches of parts of the data are joined
+    carta::QuantileSketch sketch, part_sketch;
+    sketch.Add(data.data(), data.size() / 2);
+    part_sketch.Add(data.data() + data.size() / 2, data.size() - data.size() / 2);
+    sketch.join(part_sketch);
+
+    std::vector<float> sorted;
+    std::copy_if(data.begin(), data.end(), std::back_inserter(sorted), [](float value) { return std::isfinite(value); });
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(sketch.Count(), sorted.size());
+
+    std::vector<float> ranks = {0.0, 0.5, 1.0, 10.0, 50.0, 90.0, 99.0, 99.5, 100.0};
+    auto percentiles = sketch.Percentiles(ranks);
+    EXPECT_EQ(percentiles.front(), sorted.front());
+    EXPECT_EQ(percentiles.back(), sorted.back());
+    for (auto i = 0; i < ranks.size(); i++) {
+        double rank = 100.0 * (std::lower_bound(sorted.begin(), sorted.end(), percentiles[i]) - sorted.begin()) / sorted.size();
+        EXPECT_NEAR(rank, ranks[i], 1.0);
+    }
+
+    EXPECT_TRUE(std::isnan(carta::QuantileSketch().Quantile(0.5)));
+}
+
+TEST_F(HistogramTest, TestNativeRegionStats) {
+    casacore::IPosition shape(3, 300, 200, 3);
+    casacore::TempImage<float> image(casacore::TiledShape(shape), casacore::CoordinateUtil::defaultCoords3D());
+    std::vector<float> data(shape.product());
+    std::normal_distribution<float> normal_random(0.0f, 1.0f);
+    for (auto i = 0; i < data.size(); i++) {
+        // Last plane has no valid pixels
+        data[i] = ((i % 37 == 0) || (i >= 2 * shape(0) * shape(1))) ? NAN : normal_random(mt);
+    }
+    casacore::Array<float> image_data(shape, data.data(), casacore::StorageInitPolicy::SHARE);
+    image.put(image_data);
+    image.attachMask(casacore::ArrayLattice<bool>(casacore::isFinite(image_data))); // as for NaN in FITS images
+
+    std::vector<CARTA::StatsType> stats_types = {CARTA::StatsType::NumPixels, CARTA::StatsType::Sum, CARTA::StatsType::Mean,
+        CARTA::StatsType::RMS, CARTA::StatsType::Sigma, CARTA::StatsType::SumSq, CARTA::StatsType::Min, CARTA::StatsType::Max,
+        CARTA::StatsType::Extrema, CARTA::StatsType::Blc, CARTA::StatsType::Trc, CARTA::StatsType::MinPos, CARTA::StatsType::MaxPos};
+    for (bool per_channel : {true, false}) {
+        std::map<CARTA::StatsType, std::vector<double>> expected, native;
+        ASSERT_TRUE(CalcStatsValues(expected, stats_types, image, per_channel));
+        ASSERT_TRUE(CalcStatsValues(native, stats_types, data, shape, casacore::IPosition(3, 0), NAN, per_channel));
+        ASSERT_EQ(native.size(), expected.size());
+        for (auto& result : expected) {
+            auto& native_values = native[result.first];
+            ASSERT_EQ(native_values.size(), result.second.size());
+            for (auto i = 0; i < native_values.size(); i++) {
+                if (std::isnan(result.second[i])) {
+                    EXPECT_TRUE(std::isnan(native_values[i]));
+                } else {
+                    EXPECT_NEAR(native_values[i], result.second[i], 1e-9 * std::max(fabs(result.second[i]), 1.0));
+                }
+            }
+        }
+    }
+}
+
 #ifdef COMPILE_PERFORMANCE_TESTS
 
 TEST_F(HistogramTest, TestMultithreadingPerformance) {
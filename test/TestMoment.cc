@@ -6,8 +6,12 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <limits>
+
 #include "Logger/Logger.h"
 #include "Moment/ImageMoments.h"
+#include "Moment/PlaneConvolver.h"
 #include "Util.h"
 
 #include <casacore/images/Images/PagedImage.h>
@@ -87,7 +91,7 @@ public:
     }
 
     static void CompareImageData(std::shared_ptr<const casacore::ImageInterface<casacore::Float>> image1,
-        std::shared_ptr<const casacore::ImageInterface<casacore::Float>> image2) {
+        std::shared_ptr<const casacore::ImageInterface<casacore::Float>> image2, float tolerance) {
         std::vector<float> data1;
         std::vector<float> data2;
         GetImageData(image1, data1);
@@ -95,13 +99,24 @@ public:
         EXPECT_EQ(data1.size(), data2.size());
 
         if (data1.size() == data2.size()) {
+            // Tolerance is relative to the largest value, or 0 for equal floats
+            float max_abs(0);
+            for (float value : data1) {
+                if (std::isfinite(value)) {
+                    max_abs = std::max(max_abs, std::fabs(value));
+                }
+            }
             for (int i = 0; i < data1.size(); ++i) {
-                EXPECT_FLOAT_EQ(data1[i], data2[i]);
+                if (tolerance > 0) {
+                    EXPECT_NEAR(data1[i], data2[i], tolerance * max_abs);
+                } else {
+                    EXPECT_FLOAT_EQ(data1[i], data2[i]);
+                }
             }
         }
     }
 
-    static void GenerateMoments(const std::shared_ptr<casacore::ImageInterface<float>>& image, int moments_axis) {
+    static void GenerateMoments(const std::shared_ptr<casacore::ImageInterface<float>>& image, int moments_axis, float tolerance = 0) {
         // create casa/carta moments generators
         casacore::LogOrigin casa_log("casa::ImageMoment", "createMoments", WHERE);
         casacore::LogIO casa_os(casa_log);
@@ -152,7 +167,7 @@ public:
             auto carta_moment_image = dynamic_pointer_cast<casacore::ImageInterface<casacore::Float>>(carta_results[i]);
 
             EXPECT_EQ(casa_moment_image->shape().size(), carta_moment_image->shape().size());
-            CompareImageData(casa_moment_image, carta_moment_image);
+            CompareImageData(casa_moment_image, carta_moment_image, tolerance);
         }
     }
 };
@@ -175,8 +190,47 @@ TEST_F(MomentTest, CheckConsistencyForBeamConvolutions) {
     int moment_axis(2);
 
     if (OpenImage(image, file_name)) {
-        GenerateMoments(image, moment_axis);
+        // Per-plane beams are convolved by PlaneConvolver rather than casacore
+        GenerateMoments(image, moment_axis, 1e-4);
     } else {
         spdlog::warn("Fail to open the file {}! Ignore the Moment test.", file_name);
     }
 }
+
+TEST_F(MomentTest, PlaneConvolverFftMatchesDirect) {
+    // A kernel large enough for the FFT, compared with direct convolution including a NaN pixel and the edges
+    int width(40), height(30), kernel_width(25), kernel_height(21);
+    std::vector<float> kernel(kernel_width * kernel_height), plane(width * height), plane2(width * height);
+    for (size_t i = 0; i < kernel.size(); ++i) {
+        kernel[i] = std::cos(0.1 * i);
+    }
+    for (size_t i = 0; i < plane.size(); ++i) {
+        plane[i] = std::sin(0.3 * i);
+        plane2[i] = std::cos(0.7 * i);
+    }
+    plane[5] = std::numeric_limits<float>::quiet_NaN();
+
+    carta::PlaneConvolver convolver(kernel, kernel_width, kernel_height, width, height);
+    ASSERT_TRUE(convolver.UsesFft());
+    std::vector<float> output(plane.size()), output2(plane.size());
+    convolver.Convolve(plane.data(), output.data(), plane2.data(), output2.data());
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            double expected(0), expected2(0);
+            for (int j = 0; j < kernel_height; ++j) {
+                for (int i = 0; i < kernel_width; ++i) {
+                    int xx = x + kernel_width / 2 - i;
+                    int yy = y + kernel_height / 2 - j;
+                    if ((xx >= 0) && (xx < width) && (yy >= 0) && (yy < height)) {
+                        float value = plane[yy * width + xx];
+                        expected += std::isfinite(value) ? kernel[j * kernel_width + i] * value : 0;
+                        expected2 += kernel[j * kernel_width + i] * plane2[yy * width + xx];
+                    }
+                }
+            }
+            EXPECT_NEAR(output[y * width + x], expected, 1e-3);
+            EXPECT_NEAR(output2[y * width + x], expected2, 1e-3);
+        }
+    }
+}
@@ -65,6 +65,7 @@ TEST_F(ProgramSettingsTest, DefaultConstructor) {
     EXPECT_FALSE(settings.no_browser);
     EXPECT_FALSE(settings.debug_no_auth);
     EXPECT_FALSE(settings.read_only_mode);
+    EXPECT_FALSE(settings.numa_pinning);
 
     EXPECT_TRUE(settings.frontend_folder.empty());
     EXPECT_TRUE(settings.files.empty());
@@ -79,6 +80,8 @@ TEST_F(ProgramSettingsTest, DefaultConstructor) {
     EXPECT_EQ(settings.wait_time, -1);
     EXPECT_EQ(settings.init_wait_time, -1);
     EXPECT_EQ(settings.idle_session_wait_time, -1);
+    EXPECT_EQ(settings.idle_session_hibernate_time, -1);
+    EXPECT_EQ(settings.contour_simplification, -1);
 }
 
 TEST_F(ProgramSettingsTest, EmptyArugments) {
@@ -0,0 +1,129 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cmath>
+#include <vector>
+
+#include <casacore/coordinates/Coordinates/CoordinateUtil.h>
+#include <casacore/images/Images/TempImage.h>
+#include <gtest/gtest.h>
+
+#include "Pv/PvGenerator.h"
+
+#define MAX_ABS_ERROR 1.0e-3
+
+using namespace carta;
+
+class PvTest : public ::testing::Test {
+public:
+    // Pixel values are linear in x, y and z, so bilinear interpolation is exact; one pixel is NaN
+    static constexpr int width = 40, height = 37, depth = 5, nan_x = 3, nan_y = 20;
+
+    static float Value(double x, double y, int z) {
+        return x + 100 * y + 10000 * z;
+    }
+
+    static bool ReadTile(std::vector<float>& data, int x, int count_x, int y, int count_y) {
+        data.resize(count_x * count_y * depth);
+        size_t index(0);
+        for (int i = x; i < x + count_x; ++i) {
+            for (int j = y; j < y + count_y; ++j) {
+                for (int z = 0; z < depth; ++z) {
+                    data[index++] = ((i == nan_x) && (j == nan_y)) ? NAN : Value(i, j, z);
+                }
+            }
+        }
+        return true;
+    }
+};
+
+TEST_F(PvTest, NearestAlongLine) {
+    PvGenerator pv_generator(width, height, depth);
+    ASSERT_TRUE(pv_generator.SetPath({{1, 2}, {30, 2}}, 1, PvInterpolation::Nearest));
+    ASSERT_EQ(pv_generator.NumSamples(), 30);
+
+    std::vector<float> pv_data;
+    ASSERT_TRUE(pv_generator.Calculate(ReadTile, AxisRange(1, 3), nullptr, pv_data));
+    ASSERT_EQ(pv_data.size(), 30 * 3);
+    for (int z = 1; z <= 3; ++z) {
+        for (int sample = 0; sample < 30; ++sample) {
+            EXPECT_FLOAT_EQ(pv_data[(z - 1) * 30 + sample], Value(1 + sample, 2, z));
+        }
+    }
+}
+
+TEST_F(PvTest, BilinearAlongPolyline) {
+    PvGenerator pv_generator(width, height, depth);
+    ASSERT_TRUE(pv_generator.SetPath({{0.5, 0.5}, {20.5, 0.5}, {20.5, 30.5}}, 1, PvInterpolation::Bilinear));
+    size_t num_samples = pv_generator.NumSamples();
+    ASSERT_EQ(num_samples, 51);
+
+    std::vector<float> pv_data;
+    ASSERT_TRUE(pv_generator.Calculate(ReadTile, AxisRange(0, depth - 1), nullptr, pv_data));
+    for (int z = 0; z < depth; ++z) {
+        for (size_t sample = 0; sample < num_samples; ++sample) {
+            double x = (sample <= 20) ? 0.5 + sample : 20.5;
+            double y = (sample <= 20) ? 0.5 : 0.5 + (sample - 20);
+            EXPECT_NEAR(pv_data[z * num_samples + sample], Value(x, y, z), MAX_ABS_ERROR);
+        }
+    }
+}
+
+TEST_F(PvTest, WidthSkipsNanPixels) {
+    PvGenerator pv_generator(width, height, depth);
+    ASSERT_TRUE(pv_generator.SetPath({{nan_x, 10}, {nan_x, 30}}, 3, PvInterpolation::Nearest));
+
+    std::vector<float> pv_data;
+    ASSERT_TRUE(pv_generator.Calculate(ReadTile, AxisRange(0, 0), nullptr, pv_data));
+    // Mean of the pixels either side of the path, and of the NaN pixel's neighbours only
+    EXPECT_NEAR(pv_data[0], Value(nan_x, 10, 0), MAX_ABS_ERROR);
+    EXPECT_NEAR(pv_data[nan_y - 10], Value(nan_x, nan_y, 0), MAX_ABS_ERROR);
+}
+
+TEST_F(PvTest, PathOutsideImage) {
+    PvGenerator pv_generator(width, height, depth);
+    EXPECT_FALSE(pv_generator.SetPath({{-10, -10}, {-5, -5}}, 1, PvInterpolation::Bilinear));
+
+    // Samples outside the image are NaN
+    ASSERT_TRUE(pv_generator.SetPath({{-3, 5}, {2, 5}}, 1, PvInterpolation::Nearest));
+    std::vector<float> pv_data;
+    ASSERT_TRUE(pv_generator.Calculate(ReadTile, AxisRange(0, 0), nullptr, pv_data));
+    EXPECT_TRUE(std::isnan(pv_data[0]));
+    EXPECT_FLOAT_EQ(pv_data[5], Value(2, 5, 0));
+}
+
+TEST_F(PvTest, Cancel) {
+    PvGenerator pv_generator(width, height, depth);
+    ASSERT_TRUE(pv_generator.SetPath({{0, 0}, {39, 36}}, 1, PvInterpolation::Bilinear));
+    std::vector<float> pv_data;
+    EXPECT_FALSE(pv_generator.Calculate(ReadTile, AxisRange(0, 0), [](float) { return false; }, pv_data));
+}
+
+TEST_F(PvTest, MakeImage) {
+    casacore::CoordinateSystem csys = casacore::CoordinateUtil::defaultCoords3D();
+    casacore::TempImage<casacore::Float> source(casacore::TiledShape(casacore::IPosition(3, width, height, depth)), csys);
+    source.setUnits(casacore::Unit("Jy/beam"));
+
+    PvGenerator pv_generator(width, height, depth);
+    ASSERT_TRUE(pv_generator.SetPath({{1, 2}, {30, 2}}, 1, PvInterpolation::Nearest));
+    std::vector<float> pv_data;
+    ASSERT_TRUE(pv_generator.Calculate(ReadTile, AxisRange(2, 4), nullptr, pv_data));
+    auto pv_image = PvGenerator::MakeImage(source, 2, 2, pv_generator.NumSamples(), pv_data);
+    ASSERT_TRUE(pv_image);
+    EXPECT_EQ(pv_image->shape(), casacore::IPosition(2, 30, 3));
+    EXPECT_EQ(pv_image->units().getName(), "Jy/beam");
+
+    // Spectral axis starts at the first channel of the z range
+    auto& pv_csys = pv_image->coordinates();
+    ASSERT_TRUE(pv_csys.hasSpectralAxis());
+    casacore::Vector<casacore::Double> source_world, pv_world;
+    casacore::Vector<casacore::Double> source_pixel(3, 0.0), pv_pixel(2, 0.0);
+    source_pixel(2) = 2;
+    csys.toWorld(source_world, source_pixel);
+    pv_csys.toWorld(pv_world, pv_pixel);
+    EXPECT_NEAR(pv_world(1), source_world(2), 1.0e-6 * std::abs(source_world(2)));
+    EXPECT_EQ(pv_csys.worldAxisUnits()(0), "arcsec");
+}
@@ -63,7 +63,7 @@ public:
     json example_layout;
 
     RestApiTest() {
-        // InitLogger(true, 0, false, false);
+        // InitLogger(true, 0, false, false, 0);
         preferences_path = fs::path(getenv("HOME")) / CARTA_USER_FOLDER_PREFIX / "config/preferences.json";
         layouts_path = fs::path(getenv("HOME")) / CARTA_USER_FOLDER_PREFIX / "config/layouts";
         example_options = R"({
@@ -111,6 +111,10 @@ public:
     }
 
     void TearDown() {
+        // Pending writes are done when the servers are destroyed
+        _frontend_server.reset();
+        _frontend_server_read_only_mode.reset();
+
         // Remove .carta-unit-tests/config/preferences (and empty dirs)
         fs::remove(preferences_path);
         fs::remove_all(layouts_path);
@@ -279,4 +283,45 @@ TEST_F(RestApiTest, SetLayoutReadOnly) {
     body = {{"layoutName", "test_layout"}};
     status = _frontend_server_read_only_mode->ClearLayoutFromString(body.dump());
     EXPECT_EQ(status, HTTP_400);
-}
\ No newline at end of file
+}
+TEST(StaticAssetCacheTest, CompressedVariantsAndETags) {
+    auto root = fs::temp_directory_path() / "carta-static-asset-test";
+    fs::create_directories(root / "static/js");
+    {
+        ofstream index_file((root / "index.html").string());
+        for (int i = 0; i < 200; ++i) {
+            index_file << "<p>CARTA</p>\n";
+        }
+        ofstream chunk_file((root / "static/js/main.3f2a9c1e.chunk.js").string());
+        chunk_file << "console.log(1);";
+    }
+
+    carta::StaticAssetCache cache(root);
+    auto index = cache.Get("index.html");
+    ASSERT_TRUE(index);
+    EXPECT_EQ(index, cache.Get("index.html"));
+    EXPECT_FALSE(index->immutable);
+    EXPECT_FALSE(index->gzip.empty());
+    EXPECT_LT(index->gzip.size(), index->identity.size());
+
+    carta::ContentEncoding encoding;
+    EXPECT_TRUE(index->SelectEncoding("gzip, deflate, br", encoding));
+    EXPECT_EQ(encoding, carta::ContentEncoding::Gzip);
+    EXPECT_TRUE(index->SelectEncoding("gzip;q=0", encoding));
+    EXPECT_EQ(encoding, carta::ContentEncoding::Identity);
+    EXPECT_FALSE(index->SelectEncoding("identity;q=0", encoding));
+
+    auto etag = index->ETag(carta::ContentEncoding::Gzip);
+    EXPECT_NE(etag, index->ETag(carta::ContentEncoding::Identity));
+    EXPECT_TRUE(carta::StaticAssetCache::MatchesETag("\"other\", W/" + etag, etag));
+    EXPECT_FALSE(carta::StaticAssetCache::MatchesETag(index->ETag(carta::ContentEncoding::Identity), etag));
+
+    auto chunk = cache.Get("static/js/main.3f2a9c1e.chunk.js");
+    ASSERT_TRUE(chunk);
+    EXPECT_TRUE(chunk->immutable);
+    EXPECT_TRUE(chunk->gzip.empty()); // too small to compress
+
+    EXPECT_FALSE(cache.Get("missing.js"));
+    EXPECT_FALSE(cache.Get("../carta-static-asset-test/index.html"));
+    fs::remove_all(root);
+}
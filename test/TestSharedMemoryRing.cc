@@ -0,0 +1,110 @@
+/* This file is part of the CARTA Image Viewer: https://github.com/CARTAvis/carta-backend
+   Copyright 2018, 2019, 2020, 2021 Academia Sinica Institute of Astronomy and Astrophysics (ASIAA),
+   Associated Universities, Inc. (AUI) and the Inter-University Institute for Data Intensive Astronomy (IDIA)
+   SPDX-License-Identifier: GPL-3.0-or-later
+*/
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "SharedMemoryRing.h"
+
+#define RING_CAPACITY 1000
+#define RING_OFFSET 64
+
+using namespace carta;
+
+class SharedMemoryRingTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        SharedMemoryRing::Configure(RING_CAPACITY, 100);
+    }
+    void TearDown() override {
+        SharedMemoryRing::Configure(0, 0);
+    }
+
+    // Maps the ring as the client does
+    static char* MapRing(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return nullptr;
+        }
+        void* memory = mmap(nullptr, RING_OFFSET + RING_CAPACITY, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return (memory == MAP_FAILED) ? nullptr : static_cast<char*>(memory);
+    }
+
+    static std::vector<char> Message(size_t length, char value) {
+        return std::vector<char>(length, value);
+    }
+};
+
+TEST_F(SharedMemoryRingTest, Disabled) {
+    SharedMemoryRing::Configure(0, 0);
+    std::string error;
+    EXPECT_FALSE(SharedMemoryRing::Create(1, error));
+    EXPECT_FALSE(error.empty());
+}
+
+TEST_F(SharedMemoryRingTest, WriteAfterAttach) {
+    std::string error;
+    auto ring = SharedMemoryRing::Create(1, error);
+    ASSERT_TRUE(ring) << error;
+    char* client = MapRing(ring->Name());
+    ASSERT_TRUE(client);
+    auto* header = reinterpret_cast<SharedMemoryRingHeader*>(client);
+    EXPECT_EQ(header->magic, SharedMemoryRing::MAGIC);
+    EXPECT_EQ(header->capacity, RING_CAPACITY);
+
+    // Messages go on the socket until the client has attached
+    auto message = Message(300, 'a');
+    uint64_t position;
+    EXPECT_FALSE(ring->Write(message.data(), message.size(), position));
+    header->client_attached = 1;
+    ASSERT_TRUE(ring->Write(message.data(), message.size(), position));
+    EXPECT_EQ(position, 0);
+    EXPECT_EQ(memcmp(client + RING_OFFSET, message.data(), message.size()), 0);
+    EXPECT_EQ(header->write_position, 300);
+    munmap(client, RING_OFFSET + RING_CAPACITY);
+}
+
+TEST_F(SharedMemoryRingTest, FullAndWrap) {
+    std::string error;
+    auto ring = SharedMemoryRing::Create(2, error);
+    ASSERT_TRUE(ring) << error;
+    char* client = MapRing(ring->Name());
+    ASSERT_TRUE(client);
+    auto* header = reinterpret_cast<SharedMemoryRingHeader*>(client);
+    header->client_attached = 1;
+
+    uint64_t position;
+    auto message = Message(400, 'b');
+    ASSERT_TRUE(ring->Write(message.data(), message.size(), position));
+    ASSERT_TRUE(ring->Write(message.data(), message.size(), position));
+    EXPECT_EQ(position, 400);
+    // No space for a third message at the end of the ring, nor at its start until the client releases the first
+    EXPECT_FALSE(ring->Write(message.data(), message.size(), position));
+    header->read_position = 400;
+    auto wrapped = Message(400, 'c');
+    ASSERT_TRUE(ring->Write(wrapped.data(), wrapped.size(), position));
+    EXPECT_EQ(position, RING_CAPACITY);
+    EXPECT_EQ(memcmp(client + RING_OFFSET + position % RING_CAPACITY, wrapped.data(), wrapped.size()), 0);
+    EXPECT_FALSE(ring->Write(message.data(), RING_CAPACITY + 1, position));
+    munmap(client, RING_OFFSET + RING_CAPACITY);
+}
+
+TEST_F(SharedMemoryRingTest, UnlinkedWhenClosed) {
+    std::string error;
+    auto ring = SharedMemoryRing::Create(3, error);
+    ASSERT_TRUE(ring) << error;
+    std::string name = ring->Name();
+    ring.reset();
+    EXPECT_EQ(shm_open(name.c_str(), O_RDWR, 0), -1);
+}
@@ -4,12 +4,19 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <random>
 
 #include <gtest/gtest.h>
 
+#include "DataStream/Compression.h"
+#include "DataStream/Contouring.h"
 #include "DataStream/Tile.h"
+#include "DataStream/TileDelta.h"
+#include "DataStream/TileSummary.h"
 
 using namespace std;
 
@@ -51,6 +58,218 @@ TEST(TileEncodingTest, RoundTrip) {
     }
 }
 
+TEST(TileEncodingTest, RoundTrip64) {
+    mt19937 mt(42);
+    uniform_int_distribution<> layer_random(0, 28);
+    uniform_real_distribution<double> double_random(0, 1);
+
+    // Layer can be from 0 to 28, with coordinates from 0 to 2^layer - 1
+    ASSERT_EQ(Tile::Encode64(0, 0, 29), -1);
+    ASSERT_EQ(Tile::Encode64(1 << 20, 0, 20), -1);
+    ASSERT_EQ(Tile::Encode64(0, -1, 20), -1);
+
+    for (auto i = 0; i < 10000; i++) {
+        int32_t layer = layer_random(mt);
+        int64_t layer_width = (int64_t)1 << layer;
+        int32_t x = floor(double_random(mt) * layer_width);
+        int32_t y = floor(double_random(mt) * layer_width);
+
+        int64_t encoded_value = Tile::Encode64(x, y, layer);
+        auto tile = Tile::Decode64(encoded_value);
+        ASSERT_EQ(tile.x, x);
+        ASSERT_EQ(tile.y, y);
+        ASSERT_EQ(tile.layer, layer);
+
+        // Sent as two int32 values, the high word first
+        vector<int32_t> encoded_tiles = {(int32_t)(encoded_value >> 32), (int32_t)(uint32_t)encoded_value};
+        vector<Tile> tiles;
+        ASSERT_TRUE(Tile::DecodeTiles(encoded_tiles, true, tiles));
+        ASSERT_EQ(tiles.size(), 1);
+        ASSERT_EQ(tiles[0].x, x);
+        ASSERT_EQ(tiles[0].y, y);
+        ASSERT_EQ(tiles[0].layer, layer);
+    }
+
+    vector<Tile> tiles;
+    ASSERT_FALSE(Tile::DecodeTiles(vector<int32_t>{1}, true, tiles));
+    ASSERT_TRUE(Tile::DecodeTiles(vector<int32_t>{Tile::Encode(3, 4, 5)}, false, tiles));
+    ASSERT_EQ(tiles.size(), 1);
+    ASSERT_EQ(tiles[0].x, 3);
+    ASSERT_EQ(tiles[0].y, 4);
+    ASSERT_EQ(tiles[0].layer, 5);
+}
+
+TEST(TileEncodingTest, NanRunLengthsMatchScalar) {
+    mt19937 mt(42);
+    uniform_real_distribution<float> float_random(0, 1);
+    const vector<float> nan_fractions = {0.0f, 0.05f, 0.5f, 0.95f, 1.0f};
+    // Lengths that are not multiples of the SSE/AVX/AVX-512 widths exercise the remainder loops
+    const vector<int> lengths = {1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 256, 1021};
+
+    for (auto nan_fraction : nan_fractions) {
+        for (auto length : lengths) {
+            vector<float> data(length);
+            for (auto& v : data) {
+                v = float_random(mt) < nan_fraction ? NAN : float_random(mt);
+            }
+
+            vector<int32_t> scalar_runs, sse_runs;
+            GetNanRunLengthsScalar(data.data(), length, scalar_runs);
+            GetNanRunLengthsSSE(data.data(), length, sse_runs);
+            ASSERT_EQ(sse_runs, scalar_runs);
+#ifdef CARTA_X86_SIMD
+            if (carta::GetSimdLevel() >= carta::SimdLevel::Avx) {
+                vector<int32_t> avx_runs;
+                GetNanRunLengthsAVX(data.data(), length, avx_runs);
+                ASSERT_EQ(avx_runs, scalar_runs);
+            }
+            if (carta::GetSimdLevel() >= carta::SimdLevel::Avx512) {
+                vector<int32_t> avx512_runs;
+                GetNanRunLengthsAVX512(data.data(), length, avx512_runs);
+                ASSERT_EQ(avx512_runs, scalar_runs);
+            }
+#endif
+            vector<int32_t> dispatched_runs;
+            GetNanRunLengths(data.data(), length, dispatched_runs);
+            ASSERT_EQ(dispatched_runs, scalar_runs);
+
+            // NaNs are replaced by the preceding valid value, or the first valid value for a leading NaN run
+            vector<float> filled = data;
+            auto encodings = GetNanEncodingsSimple(filled, 0, length);
+            ASSERT_EQ(encodings, scalar_runs);
+            float prev_valid = 0;
+            auto first_valid = find_if(data.begin(), data.end(), [](float v) { return !isnan(v); });
+            if (first_valid != data.end()) {
+                prev_valid = *first_valid;
+            }
+            for (auto i = 0; i < length; i++) {
+                if (isnan(data[i])) {
+                    ASSERT_EQ(filled[i], prev_valid);
+                } else {
+                    ASSERT_EQ(filled[i], data[i]);
+                    prev_valid = data[i];
+                }
+            }
+        }
+    }
+}
+
+TEST(TileEncodingTest, VertexEncodingMatchesScalar) {
+    mt19937 mt(42);
+    uniform_real_distribution<float> float_random(-2000, 2000);
+    // Odd lengths leave an unpaired value; the largest lengths are encoded in parallel chunks
+    const vector<int> lengths = {0, 1, 2, 3, 4, 6, 9, 1022, VERTEX_ENCODING_MIN_PARALLEL, VERTEX_ENCODING_MIN_PARALLEL * 3 + 7};
+
+    for (auto length : lengths) {
+        vector<float> vertices(length);
+        for (auto& v : vertices) {
+            v = float_random(mt);
+        }
+        for (auto rounding_factor : {1.0f, 4.0f, 32.0f}) {
+            vector<int32_t> scalar_encoded, encoded;
+            RoundAndEncodeVerticesScalar(vertices, scalar_encoded, rounding_factor);
+            RoundAndEncodeVertices(vertices, encoded, rounding_factor);
+            ASSERT_EQ(encoded, scalar_encoded);
+        }
+    }
+}
+
+TEST(TileEncodingTest, LosslessRoundTrip) {
+    mt19937 mt(42);
+    uniform_real_distribution<float> float_random(-1.0e6f, 1.0e6f);
+    // Lengths which are not multiples of the 16-value shuffle blocks, and NaNs with a payload
+    for (auto size : {make_pair(1, 1), make_pair(7, 3), make_pair(256, 256), make_pair(255, 129)}) {
+        vector<float> data(size.first * size.second);
+        for (auto& v : data) {
+            v = float_random(mt);
+        }
+        uint32_t nan_bits(0x7fc01234);
+        memcpy(&data[data.size() / 2], &nan_bits, sizeof(float));
+
+        vector<uint8_t> shuffled(data.size() * sizeof(float)), scalar_shuffled(data.size() * sizeof(float));
+        ShuffleBytes(data.data(), data.size(), shuffled.data());
+        ShuffleBytesScalar(data.data(), data.size(), scalar_shuffled.data());
+        ASSERT_EQ(shuffled, scalar_shuffled);
+
+        vector<char> compression_buffer;
+        size_t compressed_size;
+        ASSERT_EQ(CompressLossless(data, 0, size.first, size.second, LOSSLESS_ZSTD_LEVEL, compression_buffer, compressed_size), 0);
+        vector<float> decompressed;
+        ASSERT_EQ(DecompressLossless(compression_buffer.data(), compressed_size, decompressed, size.first, size.second), 0);
+        ASSERT_EQ(decompressed.size(), data.size());
+        EXPECT_EQ(memcmp(decompressed.data(), data.data(), data.size() * sizeof(float)), 0);
+    }
+}
+
+TEST(TileEncodingTest, ContourSimplification) {
+    // A straight line with sub-tolerance jitter, a line with a corner, and a two-vertex line
+    vector<float> vertices, simplified_vertices;
+    vector<int32_t> indices, simplified_indices;
+    indices.push_back(vertices.size());
+    for (int i = 0; i <= 100; ++i) {
+        vertices.insert(vertices.end(), {(float)i, (i % 2) ? 0.05f : -0.05f});
+    }
+    indices.push_back(vertices.size());
+    for (int i = 0; i <= 10; ++i) {
+        vertices.insert(vertices.end(), {(float)i, (float)min(i, 5)});
+    }
+    indices.push_back(vertices.size());
+    vertices.insert(vertices.end(), {3.0f, 3.0f, 4.0f, 4.0f});
+
+    SimplifyContours(vertices, indices, 0.25f, simplified_vertices, simplified_indices);
+    ASSERT_EQ(simplified_indices, vector<int32_t>({0, 4, 10}));
+    EXPECT_EQ(simplified_vertices,
+        vector<float>({0.0f, -0.05f, 100.0f, -0.05f, 0.0f, 0.0f, 5.0f, 5.0f, 10.0f, 5.0f, 3.0f, 3.0f, 4.0f, 4.0f}));
+
+    // A tolerance below the jitter keeps every vertex of the first line
+    SimplifyContours(vertices, indices, 0.01f, simplified_vertices, simplified_indices);
+    EXPECT_EQ(simplified_indices[1], 202);
+}
+
+TEST(TileEncodingTest, DeltaTilesFollowFrames) {
+    const int width = 64, height = 48, precision = 16;
+    Tile tile{1, 2, 3};
+    TileDeltaEncoder encoder;
+    encoder.StartFrame(1);
+    vector<float> client_values;
+
+    for (int z = 0; z < DELTA_KEYFRAME_INTERVAL + 2; ++z) {
+        vector<float> tile_data(width * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                tile_data[y * width + x] = 100.0f + sin(0.1f * x) * cos(0.07f * y) + 0.01f * z;
+            }
+        }
+        vector<float> expected(tile_data);
+        auto nan_encodings = GetNanEncodingsBlock(tile_data, 0, width, height);
+        TileDeltaResult result;
+        ASSERT_TRUE(encoder.Encode(tile, z, 0, tile_data, width, height, nan_encodings, precision, result));
+        EXPECT_EQ(result.keyframe, (z % DELTA_KEYFRAME_INTERVAL) == 0) << "channel " << z;
+
+        // Decode as the frontend does
+        if (result.keyframe) {
+            ASSERT_EQ(Decompress(result.data.data(), result.data.size(), client_values, width, height, precision), 0);
+        } else {
+            int32_t reference_z;
+            memcpy(&reference_z, result.data.data(), sizeof(int32_t));
+            EXPECT_EQ(reference_z, z - 1);
+            vector<float> residual;
+            ASSERT_EQ(Decompress(result.data.data() + sizeof(int32_t), result.data.size() - sizeof(int32_t), residual, width, height,
+                          precision, result.tolerance),
+                0);
+            for (size_t i = 0; i < client_values.size(); ++i) {
+                client_values[i] += residual[i];
+            }
+        }
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_NEAR(client_values[i], expected[i], 0.05);
+        }
+    }
+    EXPECT_EQ(encoder.Size(), 1);
+    encoder.StartFrame(2);
+    EXPECT_EQ(encoder.Size(), 0);
+}
+
 #ifdef COMPILE_PERFORMANCE_TESTS
 
 TEST(TileEncoding, PerformanceTestEncoding) {
@@ -90,4 +309,31 @@ TEST(TileEncoding, PerformanceTestDecoding) {
     ASSERT_LT(dt, 2.0f);
 }
 
-#endif
\ No newline at end of file
+#endif
+
+TEST(TileEncodingTest, TileSummaryUniformValue) {
+    // A blank column of tiles, a constant column, and a partial column with one finite pixel
+    int width(600), height(300);
+    vector<float> plane(width * height, NAN);
+    for (int y = 0; y < height; ++y) {
+        fill(plane.begin() + y * width + 256, plane.begin() + y * width + 512, 2.5f);
+    }
+    plane[10 * width + 520] = 1.0f;
+    TileSummary summary(plane.data(), width, height, 256);
+
+    float value;
+    ASSERT_TRUE(summary.UniformValue(0, 0, 256, 256, value));
+    EXPECT_TRUE(isnan(value));
+    ASSERT_TRUE(summary.UniformValue(256, 0, 256, 256, value));
+    EXPECT_EQ(value, 2.5f);
+    ASSERT_TRUE(summary.UniformValue(256, 256, 256, 44, value));
+    EXPECT_EQ(value, 2.5f);
+    ASSERT_TRUE(summary.UniformValue(512, 256, 88, 44, value));
+    EXPECT_TRUE(isnan(value));
+    EXPECT_FALSE(summary.UniformValue(512, 0, 88, 256, value));
+    EXPECT_FALSE(summary.UniformValue(0, 0, 512, 256, value));
+
+    // Regions which are not aligned to the blocks
+    EXPECT_FALSE(summary.UniformValue(100, 0, 156, 256, value));
+    EXPECT_FALSE(summary.UniformValue(0, 0, 200, 256, value));
+}
@@ -4,8 +4,12 @@
    SPDX-License-Identifier: GPL-3.0-or-later
 */
 
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
 
+#include "ImageData/SidecarCache.h"
 #include "Table/Table.h"
 #include "Util.h"
 
@@ -415,4 +419,53 @@ TEST_F(VoTableTest, CorrectScalarData) {
     EXPECT_FLOAT_EQ(scalar2_vals[0], 2.0f);
     EXPECT_FLOAT_EQ(scalar2_vals[1], 4.0f);
     EXPECT_FLOAT_EQ(scalar2_vals[2], 6.0f);
-}
\ No newline at end of file
+}
+TEST_F(VoTableTest, LoadRemainingRowsInBackground) {
+    Table table(ImagePath("ivoa_example.xml"), false, false, 2);
+    EXPECT_TRUE(table.IsValid());
+    EXPECT_EQ(table.NumRows(), 2);
+
+    table.LoadRowsInBackground();
+    while (table.IsLoading()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(table.NumRows(), 3);
+    EXPECT_EQ(table.AvailableRows(), 3);
+
+    auto& col1_vals = DataColumn<float>::TryCast(table["col1"])->entries;
+    EXPECT_EQ(col1_vals.size(), 3);
+    EXPECT_FLOAT_EQ(col1_vals[2], 23.48f);
+    auto& col3_vals = DataColumn<string>::TryCast(table["col3"])->entries;
+    EXPECT_EQ(col3_vals[0], "N 224");
+    EXPECT_EQ(col3_vals[2], "N 598");
+}
+
+TEST_F(VoTableTest, LoadFromCatalogCache) {
+    fs::path cache_folder = fs::temp_directory_path() / "carta_table_cache_test";
+    fs::remove_all(cache_folder);
+    fs::create_directories(cache_folder);
+    SidecarCache::SetFolder(cache_folder.string());
+
+    {
+        // The cache is written by the table's load thread, which is joined when the table is destroyed
+        Table table(ImagePath("ivoa_example.xml"));
+        EXPECT_TRUE(table.IsValid());
+    }
+    EXPECT_FALSE(fs::is_empty(cache_folder));
+
+    Table table(ImagePath("ivoa_example.xml"));
+    SidecarCache::SetFolder("");
+    fs::remove_all(cache_folder);
+    EXPECT_TRUE(table.IsValid());
+    EXPECT_EQ(table.Type(), CARTA::VOTable);
+    EXPECT_EQ(table.NumRows(), 3);
+    EXPECT_EQ(table.NumColumns(), 6);
+    EXPECT_EQ(table["col1"]->unit, "deg");
+
+    auto col1 = DataColumn<float>::TryCast(table["col1"]);
+    ASSERT_NE(col1, nullptr);
+    EXPECT_FLOAT_EQ(col1->Value(2), 23.48f);
+    auto& col3_vals = DataColumn<string>::TryCast(table["col3"])->entries;
+    EXPECT_EQ(col3_vals[0], "N 224");
+    EXPECT_EQ(col3_vals[2], "N 598");
+}